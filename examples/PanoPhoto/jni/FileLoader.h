@@ -21,6 +21,8 @@ class App;
 class PanoPhoto;
 
 void InitFileQueue( App * app, PanoPhoto * photos);
+// Stops the queue threads and waits for them, pending loads are dropped
+void ShutdownFileQueue();
 
 extern VEventLoop		Queue1;
 
@@ -32,14 +32,13 @@ pthread_mutex_t QueueMutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t	QueueWake = PTHREAD_COND_INITIALIZER;
 bool			QueueHasCleared = true;
 
-void *Queue1Thread(void *)
-{
-	int result = pthread_setname_np( pthread_self(), "FileQueue1" );
-	if ( result != 0 )
-	{
-		vInfo("InitFileQueue: pthread_setname_np failed" << strerror( result ));
-	}
+static const int NUM_QUEUE_THREADS = 2;
+static VThread *	QueueThreads[NUM_QUEUE_THREADS];
+// The queue threads return when this is set, ShutdownFileQueue() wakes them to see it
+static VLockless<bool>	QueueShutdown;
 
+int Queue1Thread(void *)
+{
 	// Process incoming messages until queue is empty
 	for ( ; ; )
 	{
@@ -47,13 +46,18 @@ void *Queue1Thread(void *)
 
 		// If Queue3 hasn't finished our last output, sleep until it has.
 		pthread_mutex_lock( &QueueMutex );
-		while ( !QueueHasCleared )
+		while ( !QueueHasCleared && !QueueShutdown.state() )
 		{
 			// Atomically unlock the mutex and block until we get a message.
 			pthread_cond_wait( &QueueWake, &QueueMutex );
 		}
 		pthread_mutex_unlock( &QueueMutex );
 
+		if ( QueueShutdown.state() )
+		{
+			break;
+		}
+
         Queue1.wait();
         VEvent event = Queue1.next();
         VString filename = event.data.toString();
@@ -116,20 +120,18 @@ void *Queue1Thread(void *)
             queue->post(event.name, args);
 		}
 	}
-	return NULL;
+	return 0;
 }
 
-void * Queue3Thread( void * v )
+int Queue3Thread( void * v )
 {
-	int result = pthread_setname_np( pthread_self(), "FileQueue3" );
-	if ( result != 0 )
-	{
-		vInfo("InitFileQueue: pthread_setname_np failed" << strerror( result ));
-	}
-
 	// Process incoming messages until queue is empty
     forever {
 		Queue3.wait();
+		if ( QueueShutdown.state() )
+		{
+			break;
+		}
         VEvent event = Queue3.next();
 
         vInfo("Queue3 msg =" << event.name);
@@ -222,38 +224,55 @@ void * Queue3Thread( void * v )
 			}
 		}
 	}
-	return NULL;
+	return 0;
 }
 
-static const int NUM_QUEUE_THREADS = 2;
-
 void InitFileQueue( App * app, VRLauncher * photos )
 {
-    // spawn the queue threads
-	void * (*funcs[NUM_QUEUE_THREADS])( void *) = { Queue1Thread, Queue3Thread };
+    QueueShutdown.setState( false );
+
+    // spawn the queue threads, they run until ShutdownFileQueue()
+    const VThread::Function funcs[NUM_QUEUE_THREADS] = { Queue1Thread, Queue3Thread };
+    void * const args[NUM_QUEUE_THREADS] = { app, photos };
+    const char * const names[NUM_QUEUE_THREADS] = { "FileQueue1", "FileQueue3" };
+
+    for ( int i = 0; i < NUM_QUEUE_THREADS; i++ )
+    {
+        QueueThreads[ i ] = new VThread( funcs[ i ], args[ i ] );
+        QueueThreads[ i ]->setName( names[ i ] );
+        // the stack pthread gives by default on Android, which they always ran with
+        QueueThreads[ i ]->setStackSize( 1024 * 1024 );
+        if ( !QueueThreads[ i ]->start() )
+        {
+            vInfo("loadingThread: failed to start" << names[ i ]);
+        }
+    }
+}
 
-	for ( int i = 0; i < NUM_QUEUE_THREADS; i++ )
-	{
-		pthread_attr_t loadingThreadAttr;
-		pthread_attr_init( &loadingThreadAttr );
-		sched_param sparam;
-        sparam.sched_priority = VThread::GetOSPriority(VThread::NormalPriority);
-		pthread_attr_setschedparam( &loadingThreadAttr, &sparam );
-		pthread_t	loadingThread;
-		int createLoadingThreadErr = -1;
-		if ( i == 1 )
-		{
-			createLoadingThreadErr = pthread_create( &loadingThread, &loadingThreadAttr, funcs[ i ], ( void * )photos );
-		}
-		else
-		{
-			createLoadingThreadErr = pthread_create( &loadingThread, &loadingThreadAttr, funcs[ i ], ( void * )app );
-		}
-		if ( createLoadingThreadErr != 0 )
-		{
-			vInfo("loadingThread: pthread_create returned" << createLoadingThreadErr);
-		}
-	}
+void ShutdownFileQueue()
+{
+    QueueShutdown.setState( true );
+
+    // Wake the threads wherever they wait, a full queue doesn't block them anyway
+    Queue1.post( "quit" );
+    Queue3.post( "quit" );
+    pthread_mutex_lock( &QueueMutex );
+    pthread_cond_broadcast( &QueueWake );
+    pthread_mutex_unlock( &QueueMutex );
+
+    for ( int i = 0; i < NUM_QUEUE_THREADS; i++ )
+    {
+        if ( QueueThreads[ i ] != NULL )
+        {
+            QueueThreads[ i ]->wait();
+            delete QueueThreads[ i ];
+            QueueThreads[ i ] = NULL;
+        }
+    }
+
+    Queue1.clear();
+    Queue3.clear();
+    QueueHasCleared = true;
 }
 
 NV_NAMESPACE_END
@@ -21,6 +21,8 @@ class App;
 class VRLauncher;
 
 void InitFileQueue( App * app, VRLauncher * photos);
+// Stops the queue threads and waits for them, pending loads are dropped
+void ShutdownFileQueue();
 
 extern VEventLoop		Queue1;
 
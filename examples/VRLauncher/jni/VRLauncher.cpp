@@ -96,6 +96,7 @@ VRLauncher::VRLauncher(JNIEnv *jni, jclass activityClass, jobject activityObject
     , m_useOverlay( true )
     , m_useSrgb( true )
     , m_backgroundCommands( 100 )
+    , m_loadingThread( nullptr )
     , m_eglClientVersion( 0 )
     , m_eglDisplay( 0 )
     , m_eglConfig( 0 )
@@ -200,17 +201,13 @@ void VRLauncher::init(const VString &, const VString &, const VString &)
     }
 
     // spawn the background loading thread with the command list
-    pthread_attr_t loadingThreadAttr;
-    pthread_attr_init( &loadingThreadAttr );
-    sched_param sparam;
-    sparam.sched_priority = VThread::GetOSPriority(VThread::NormalPriority);
-    pthread_attr_setschedparam( &loadingThreadAttr, &sparam );
-
-    pthread_t loadingThread;
-    const int createErr = pthread_create( &loadingThread, &loadingThreadAttr, &BackgroundGLLoadThread, this );
-    if ( createErr != 0 )
+    m_loadingThread = new VThread( &BackgroundGLLoadThread, this );
+    m_loadingThread->setName( "BackgrndGLLoad" );
+    // the stack pthread gives by default on Android, which it always ran with
+    m_loadingThread->setStackSize( 1024 * 1024 );
+    if ( !m_loadingThread->start() )
     {
-        vInfo("pthread_create returned" << createErr);
+        vInfo("Failed to start the background loading thread");
     }
 
     // We might want to save the view state and position for perfect recall
@@ -275,8 +272,15 @@ void VRLauncher::shutdown()
     // This is called by the VR thread, not the java UI thread.
     vInfo("--------------- PanoPhoto OneTimeShutdown ---------------");
 
-    // Shut down background loader
+    // Stop the file queue first, it feeds the background loader
+    ShutdownFileQueue();
+
+    // Shut down background loader, the event wakes it up to see the request
     m_shutdownRequest.setState( true );
+    m_backgroundCommands.post( "quit" );
+    m_loadingThread->wait();
+    delete m_loadingThread;
+    m_loadingThread = nullptr;
 
     m_globe.destroy();
 
@@ -289,10 +293,8 @@ void VRLauncher::shutdown()
     }
 }
 
-void * VRLauncher::BackgroundGLLoadThread( void * v )
+int VRLauncher::BackgroundGLLoadThread( void * v )
 {
-    pthread_setname_np( pthread_self(), "BackgrndGLLoad" );
-
     VRLauncher * photos = ( VRLauncher * )v;
 
     // Create a new GL context on this thread, sharing it with the main thread context
@@ -417,7 +419,7 @@ void * VRLauncher::BackgroundGLLoadThread( void * v )
     {
         vFatal("BackgroundGLLoadThread eglDestroyContext: shutdown failed");
     }
-    return NULL;
+    return 0;
 }
 
 void VRLauncher::command(const VEvent &event )
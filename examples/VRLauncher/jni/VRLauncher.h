@@ -7,6 +7,8 @@
 
 NV_NAMESPACE_BEGIN
 
+class VThread;
+
 class VRLauncher : public VMainActivity
 {
 public:
@@ -68,7 +70,7 @@ public:
 
 private:
 	// Background textures loaded into GL by background thread using shared context
-	static void *BackgroundGLLoadThread( void * v );
+	static int BackgroundGLLoadThread( void * v );
     void startBackgroundPanoLoad(const VString &filename );
     void loadRgbaCubeMap( const int resolution, const uchar * const rgba[ 6 ], const bool useSrgbFormat );
     void loadRgbaTexture( const uchar * data, int width, int height, const bool useSrgbFormat );
@@ -101,6 +103,9 @@ private:
 	// The background loader loop will exit when this is set true.
     VLockless<bool>		m_shutdownRequest;
 
+	// Joined and deleted by shutdown()
+    VThread *			m_loadingThread;
+
 	// BackgroundGLLoadThread private GL context used for loading background textures
     EGLint				m_eglClientVersion;
     EGLDisplay			m_eglDisplay;
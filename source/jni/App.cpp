@@ -36,6 +36,7 @@
 #include "VTexture.h"
 #include "VGui.h"
 #include "VModel.h"
+#include "VEventDispatcher.h"
 
 //#define TEST_TIMEWARP_WATCHDOG
 #define EGL_PROTECTED_CONTENT_EXT 0x32c0
@@ -158,6 +159,7 @@ struct App::Private
 
     // Most calls in from java should communicate through this.
     VEventLoop eventLoop;
+    VEventDispatcher dispatcher;
 
     // Egl context and surface for rendering
     VEglDriver m_glStatus;
@@ -306,6 +308,7 @@ struct App::Private
         , gui(new VGui)
         , modules(VModule::List())
     {
+        bindInputEvents();
     }
 
     ~Private()
@@ -617,43 +620,42 @@ struct App::Private
         }
     }
 
-    void command(const VEvent &event)
+    void bindInputEvents()
     {
-        // Always include the space in MatchesHead to prevent problems
-        // with commands that have matching prefixes.
-
-        if (event.name == "joy") {
-            vAssert(event.data.isArray());
-            joypad.sticks[0][0] = event.data.at(0).toFloat();
-            joypad.sticks[0][1] = event.data.at(1).toFloat();
-            joypad.sticks[1][0] = event.data.at(2).toFloat();
-            joypad.sticks[1][1] = event.data.at(3).toFloat();
-            return;
-        }
-
-        if (event.name == "touch") {
-            vAssert(event.data.isArray());
-            int	action = event.data.at(0).toInt();
-            float x = event.data.at(1).toFloat();
-            float y = event.data.at(2).toFloat();
-            joypad.touch.x = event.data.at(1).toFloat();
-            joypad.touch.y = event.data.at(2).toFloat();
-            if (action == 0) {
+        dispatcher.bind(VEventId("joy"), [this](const VEvent &event) {
+            const VJoyAxisInput &input = event.payload<VJoyAxisInput>();
+            joypad.sticks[0][0] = input.sticks[0][0];
+            joypad.sticks[0][1] = input.sticks[0][1];
+            joypad.sticks[1][0] = input.sticks[1][0];
+            joypad.sticks[1][1] = input.sticks[1][1];
+        });
+
+        dispatcher.bind(VEventId("touch"), [this](const VEvent &event) {
+            const VTouchInput &input = event.payload<VTouchInput>();
+            joypad.touch.x = input.x;
+            joypad.touch.y = input.y;
+            if (input.action == 0) {
                 joypad.buttonState |= BUTTON_TOUCH;
             }
-            if (action == 1) {
+            if (input.action == 1) {
                 joypad.buttonState &= ~BUTTON_TOUCH;
             }
-            gui->onTouchEvent(action, x, y);
-            return;
-        }
+            gui->onTouchEvent(input.action, input.x, input.y);
+        });
 
-        if (event.name == "key") {
-            vAssert(event.data.isArray());
-            int	key = event.data.at(0).toInt();
-            int down = event.data.at(1).toInt();
-            int repeatCount = event.data.at(2).toInt();
-            onKeyEvent(key, down, repeatCount);
+        dispatcher.bind(VEventId("key"), [this](const VEvent &event) {
+            const VKeyInput &input = event.payload<VKeyInput>();
+            onKeyEvent(input.key, input.down, input.repeatCount);
+        });
+    }
+
+    void command(const VEvent &event)
+    {
+        // Always include the space in MatchesHead to prevent problems
+        // with commands that have matching prefixes.
+
+        // Per-frame input events are dispatched by id
+        if (dispatcher.dispatch(event)) {
             return;
         }
 
@@ -959,14 +961,9 @@ struct App::Private
         {
             //SPAM("FRAME START");
             // Process incoming messages until queue is empty
-            forever {
-                VEvent event = eventLoop.next();
-                if (!event.isValid()) {
-                    break;
-                }
+            eventLoop.drain([this](const VEvent &event) {
                 command(event);
-
-            }
+            });
 
             // If we don't have a surface yet, or we are paused, sleep until
             // something shows up on the message queue.
@@ -1343,6 +1340,7 @@ App::App(JNIEnv *jni, jobject activityObject, VMainActivity *activity)
 
     d->kernel = VKernel::instance();
     d->storagePaths = new VStandardPath(jni, activityObject);
+    VLensDistortion::cacheDirectory = d->storagePaths->findFolder(VStandardPath::InternalStorage, VStandardPath::CacheFolder, "");
 
 	//WaitForDebuggerToAttach();
 
@@ -1374,6 +1372,7 @@ App::App(JNIEnv *jni, jobject activityObject, VMainActivity *activity)
         d->run();
         return 0;
     }, d);
+    d->renderThread->setName("VrThread");
 }
 
 App::~App()
@@ -0,0 +1,452 @@
+#include "VDistortionMesh.h"
+#include "VDevice.h"
+#include "VBinaryStream.h"
+#include "VFile.h"
+#include "VLog.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+NV_NAMESPACE_BEGIN
+
+namespace {
+
+const char Magic[4] = {'V', 'D', 'M', 'S'};
+const uint Version = 1;
+
+// Segments of the spline of VLensDistortion::kArray
+const int NumSegments = 11;
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+
+typedef float32x4_t Float4;
+inline Float4 Set4(float f) { return vdupq_n_f32(f); }
+inline Float4 Load4(const float *p) { return vld1q_f32(p); }
+inline void Store4(float *p, Float4 v) { vst1q_f32(p, v); }
+inline Float4 Add4(Float4 a, Float4 b) { return vaddq_f32(a, b); }
+inline Float4 Sub4(Float4 a, Float4 b) { return vsubq_f32(a, b); }
+inline Float4 Mul4(Float4 a, Float4 b) { return vmulq_f32(a, b); }
+inline Float4 Min4(Float4 a, Float4 b) { return vminq_f32(a, b); }
+// Truncates v, which is positive, into index and returns it as floats
+inline Float4 Floor4(Float4 v, int *index)
+{
+    const int32x4_t truncated = vcvtq_s32_f32(v);
+    vst1q_s32(index, truncated);
+    return vcvtq_f32_s32(truncated);
+}
+
+#elif defined(__SSE2__)
+
+typedef __m128 Float4;
+inline Float4 Set4(float f) { return _mm_set1_ps(f); }
+inline Float4 Load4(const float *p) { return _mm_loadu_ps(p); }
+inline void Store4(float *p, Float4 v) { _mm_storeu_ps(p, v); }
+inline Float4 Add4(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+inline Float4 Sub4(Float4 a, Float4 b) { return _mm_sub_ps(a, b); }
+inline Float4 Mul4(Float4 a, Float4 b) { return _mm_mul_ps(a, b); }
+inline Float4 Min4(Float4 a, Float4 b) { return _mm_min_ps(a, b); }
+inline Float4 Floor4(Float4 v, int *index)
+{
+    const __m128i truncated = _mm_cvttps_epi32(v);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(index), truncated);
+    return _mm_cvtepi32_ps(truncated);
+}
+
+#else
+
+struct Float4 { float v[4]; };
+inline Float4 Set4(float f) { Float4 r = {{f, f, f, f}}; return r; }
+inline Float4 Load4(const float *p) { Float4 r = {{p[0], p[1], p[2], p[3]}}; return r; }
+inline void Store4(float *p, Float4 v) { p[0] = v.v[0]; p[1] = v.v[1]; p[2] = v.v[2]; p[3] = v.v[3]; }
+inline Float4 Add4(Float4 a, Float4 b) { Float4 r = {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}}; return r; }
+inline Float4 Sub4(Float4 a, Float4 b) { Float4 r = {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}}; return r; }
+inline Float4 Mul4(Float4 a, Float4 b) { Float4 r = {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}}; return r; }
+inline Float4 Min4(Float4 a, Float4 b) { Float4 r = {{std::min(a.v[0], b.v[0]), std::min(a.v[1], b.v[1]), std::min(a.v[2], b.v[2]), std::min(a.v[3], b.v[3])}}; return r; }
+inline Float4 Floor4(Float4 v, int *index)
+{
+    Float4 r;
+    for (int i = 0; i < 4; i++) {
+        index[i] = (int) v.v[i];
+        r.v[i] = (float) index[i];
+    }
+    return r;
+}
+
+#endif
+
+// The Catmull-Rom spline through kArray, as a cubic in t for each segment
+struct SplineSegments
+{
+    float c[4][NumSegments];
+
+    SplineSegments(const float *K)
+    {
+        for (int k = 0; k < NumSegments; k++) {
+            float p0, p1, m0, m1;
+            if (k == 0) {
+                p0 = 1.0f;
+                m0 = K[1] - K[0];
+                p1 = K[1];
+                m1 = 0.5f * (K[2] - K[0]);
+            } else if (k < NumSegments - 2) {
+                p0 = K[k];
+                m0 = 0.5f * (K[k + 1] - K[k - 1]);
+                p1 = K[k + 1];
+                m1 = 0.5f * (K[k + 2] - K[k]);
+            } else if (k == NumSegments - 2) {
+                p0 = K[k];
+                m0 = 0.5f * (K[k + 1] - K[k - 1]);
+                p1 = K[k + 1];
+                m1 = K[k + 1] - K[k];
+            } else {
+                p0 = K[k];
+                m0 = K[k] - K[k - 1];
+                p1 = p0 + m0;
+                m1 = m0;
+            }
+            // The Hermite basis expanded
+            c[0][k] = p0;
+            c[1][k] = m0;
+            c[2][k] = -3.0f * p0 - 2.0f * m0 + 3.0f * p1 - m1;
+            c[3][k] = 2.0f * p0 + m0 - 2.0f * p1 + m1;
+        }
+    }
+
+    Float4 coefficient(int i, const int *k) const
+    {
+        const float lanes[4] = {c[i][k[0]], c[i][k[1]], c[i][k[2]], c[i][k[3]]};
+        return Load4(lanes);
+    }
+};
+
+// FNV-1a
+struct KeyHash
+{
+    vuint64 hash;
+
+    KeyHash() : hash(14695981039346656037ull) {}
+
+    void add(const void *data, uint size)
+    {
+        const uchar *bytes = static_cast<const uchar *>(data);
+        for (uint i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    }
+
+    template<typename T>
+    void add(const T &value) { add(&value, sizeof(value)); }
+};
+
+bool VectorHitsCursor(float x, float y)
+{
+    return fabs(y) <= 0.017f && fabs(x) <= 0.070f;
+}
+
+}
+
+VDistortionMesh::Parms::Parms()
+    : lensDistance(0.059f)
+    , widthbyMeters(0.12f)
+    , widthbyPixels(2560)
+    , heightbyPixels(1440)
+    , xxOffsetbyMeters(0.0f)
+{
+    lens.initDistortionParmsByMobileType();
+}
+
+VDistortionMesh::Parms::Parms(const VDevice *device)
+    : lens(device->lens)
+    , lensDistance(device->lensDistance)
+    , widthbyMeters(device->widthbyMeters)
+    , widthbyPixels(device->widthbyPixels)
+    , heightbyPixels(device->heightbyPixels)
+    , xxOffsetbyMeters(device->xxOffsetbyMeters)
+{
+}
+
+void VDistortionMesh::WarpTexCoords(const Parms &parms, int gridX, int gridY, float *texCoords)
+{
+    const VLensDistortion &lens = parms.lens;
+    const SplineSegments spline(lens.kArray);
+
+    const float aspect = parms.widthbyPixels * 0.5 / parms.heightbyPixels;
+
+    const float horizontalShiftLeftMeters = -((parms.lensDistance / 2) - (parms.widthbyMeters / 4)) + parms.xxOffsetbyMeters;
+    const float horizontalShiftRightMeters = ((parms.lensDistance / 2) - (parms.widthbyMeters / 4)) + parms.xxOffsetbyMeters;
+    const float horizontalShiftViewLeft = 2 * aspect * horizontalShiftLeftMeters / parms.widthbyMeters;
+    const float horizontalShiftViewRight = 2 * aspect * horizontalShiftRightMeters / parms.widthbyMeters;
+
+    // From texture coordinates to tan angles
+    const float metersPerUnit = parms.heightbyPixels * 0.5f * parms.widthbyMeters / parms.widthbyPixels;
+    const float tanAnglePerUnit = metersPerUnit / lens.centMetersPerTanAngler;
+
+    const Float4 scaleRsq = Set4((float) (NumSegments - 1) / (lens.maxR * lens.maxR));
+    const Float4 lastSegment = Set4((float) (NumSegments - 1));
+    const Float4 redOffset = Set4(1.0f + lens.chromaticAberration[0]);
+    const Float4 redSlope = Set4(lens.chromaticAberration[1]);
+    const Float4 blueOffset = Set4(1.0f + lens.chromaticAberration[2]);
+    const Float4 blueSlope = Set4(lens.chromaticAberration[3]);
+
+    const int rowSize = gridX + 1;
+    for (int y = 0; y <= gridY; y++) {
+        const float yf = (float) y / (float) gridY;
+        const float thetaY = 2.0f * (yf - 0.5f) * tanAnglePerUnit;
+        const Float4 ty = Set4(thetaY);
+        for (int eye = 0; eye < 2; eye++) {
+            const float shift = eye ? horizontalShiftViewLeft : horizontalShiftViewRight;
+            float *row = texCoords + (y * rowSize * 2 + eye * rowSize) * 6;
+            for (int x = 0; x < rowSize; x += 4) {
+                float thetaX[4];
+                for (int i = 0; i < 4; i++) {
+                    const float xf = (float) (x + i) / (float) gridX;
+                    const float unit = shift + xf * aspect + (1.0f - aspect) * 0.5f;
+                    thetaX[i] = 2.0f * (unit - 0.5f) * tanAnglePerUnit;
+                }
+                const Float4 tx = Load4(thetaX);
+                const Float4 rsq = Add4(Mul4(tx, tx), Mul4(ty, ty));
+
+                // The spline at rsq, clamped to its last segment, which it extends past maxR
+                const Float4 scaled = Mul4(rsq, scaleRsq);
+                int segment[4];
+                const Float4 t = Sub4(scaled, Floor4(Min4(scaled, lastSegment), segment));
+                Float4 scale = spline.coefficient(3, segment);
+                scale = Add4(Mul4(scale, t), spline.coefficient(2, segment));
+                scale = Add4(Mul4(scale, t), spline.coefficient(1, segment));
+                scale = Add4(Mul4(scale, t), spline.coefficient(0, segment));
+
+                const Float4 red = Mul4(scale, Add4(redOffset, Mul4(rsq, redSlope)));
+                const Float4 blue = Mul4(scale, Add4(blueOffset, Mul4(rsq, blueSlope)));
+
+                float lanes[6][4];
+                Store4(lanes[0], Mul4(red, tx));
+                Store4(lanes[1], Mul4(red, ty));
+                Store4(lanes[2], Mul4(scale, tx));
+                Store4(lanes[3], Mul4(scale, ty));
+                Store4(lanes[4], Mul4(blue, tx));
+                Store4(lanes[5], Mul4(blue, ty));
+                const int count = std::min(4, rowSize - x);
+                for (int i = 0; i < count; i++) {
+                    float *v = row + (x + i) * 6;
+                    for (int j = 0; j < 6; j++) {
+                        v[j] = lanes[j][i];
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool VDistortionMesh::generate(const Parms &parms, int gridX, int gridY, int numSlicesPerEye, float fovScale, bool cursorOnly)
+{
+    vertices.clear();
+    indices.clear();
+    if (gridX < 1 || gridY < 1 || numSlicesPerEye < 1) {
+        return false;
+    }
+    if (gridX > MaxGridSize || gridY > MaxGridSize) {
+        vWarn("VDistortionMesh: a grid of" << gridX << "x" << gridY << "is too large");
+        return false;
+    }
+
+    const int totalX = (gridX + 1) * 2;
+    VArray<float> bufferVerts;
+    bufferVerts.resize(totalX * (gridY + 1) * 6);
+    WarpTexCoords(parms, gridX, gridY, bufferVerts.data());
+
+    // Identify which verts would be inside the cursor plane
+    VArray<uchar> vertInCursor;
+    if (cursorOnly) {
+        vertInCursor.resize(totalX * (gridY + 1));
+        for (uint i = 0; i < vertInCursor.size(); i++) {
+            vertInCursor[i] = VectorHitsCursor(fovScale * bufferVerts[i * 6], fovScale * bufferVerts[i * 6 + 1]);
+        }
+    }
+
+    if (numSlicesPerEye > gridX) {
+        vWarn("VDistortionMesh: can't split" << gridX << "columns into" << numSlicesPerEye << "slices");
+        return false;
+    }
+
+    const int sliceTess = gridX / numSlicesPerEye;
+
+    //Each slice repeats the column it shares with the next one
+    const int vertexCount = 2 * numSlicesPerEye * (sliceTess + 1) * (gridY + 1);
+    if (vertexCount > MaxVertexCount) {
+        vWarn("VDistortionMesh: a grid of" << gridX << "x" << gridY << "in" << numSlicesPerEye << "slices has too many vertices");
+        return false;
+    }
+    vertices.resize(vertexCount * AttribCount);
+    indices.reserve(2 * gridX * gridY * 6);
+
+    int verts = 0;
+    for (int eye = 0; eye < 2; eye++) {
+        for (int slice = 0; slice < numSlicesPerEye; slice++) {
+            const int vertBase = verts;
+
+            for (int y = 0; y <= gridY; y++) {
+                const float yf = (float) y / (float) gridY;
+                for (int x = 0; x <= sliceTess; x++) {
+                    const int sx = slice * sliceTess + x;
+                    const float xf = (float) sx / (float) gridX;
+                    float *v = &vertices[AttribCount * (vertBase + y * (sliceTess + 1) + x)];
+                    v[0] = -1.0f + eye + xf;
+                    v[1] = yf * 2.0f - 1.0f;
+
+                    // Copy the offsets from the file
+                    const float *offsets = &bufferVerts[(y * totalX + sx + eye * (gridX + 1)) * 6];
+                    for (int i = 0; i < 6; i++) {
+                        v[2 + i] = fovScale * offsets[i];
+                    }
+
+                    v[8] = (float) x / sliceTess;
+                    v[9] = 1.0f;
+                }
+            }
+            verts += (gridY + 1) * (sliceTess + 1);
+
+            for (int x = 0; x < sliceTess; x++) {
+                for (int y = 0; y < gridY; y++) {
+                    if (cursorOnly) {
+                        // skip this quad if none of the verts are in the cursor region
+                        const int xx = x + eye * (gridX + 1) + slice * sliceTess;
+                        if (0 == vertInCursor[y * totalX + xx]
+                                + vertInCursor[y * totalX + xx + 1]
+                                + vertInCursor[(y + 1) * totalX + xx]
+                                + vertInCursor[(y + 1) * totalX + xx + 1]) {
+                            continue;
+                        }
+                    }
+
+                    const ushort topLeft = vertBase + y * (sliceTess + 1) + x;
+                    const ushort topRight = topLeft + 1;
+                    const ushort bottomLeft = topLeft + sliceTess + 1;
+                    const ushort bottomRight = bottomLeft + 1;
+                    if ((slice * sliceTess + x < gridX / 2) ^ (y < (gridY / 2))) {
+                        indices.append(topLeft);
+                        indices.append(topRight);
+                        indices.append(bottomRight);
+
+                        indices.append(topLeft);
+                        indices.append(bottomRight);
+                        indices.append(bottomLeft);
+                    } else {
+                        indices.append(topLeft);
+                        indices.append(topRight);
+                        indices.append(bottomLeft);
+
+                        indices.append(bottomLeft);
+                        indices.append(topRight);
+                        indices.append(bottomRight);
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+vuint64 VDistortionMesh::Key(const Parms &parms, int gridX, int gridY, int numSlicesPerEye, float fovScale, bool cursorOnly)
+{
+    const VLensDistortion &lens = parms.lens;
+    KeyHash hash;
+    hash.add(Version);
+    hash.add(gridX);
+    hash.add(gridY);
+    hash.add(numSlicesPerEye);
+    hash.add(fovScale);
+    hash.add(cursorOnly);
+    hash.add(lens.kArray);
+    hash.add(lens.maxR);
+    hash.add(lens.centMetersPerTanAngler);
+    hash.add(lens.chromaticAberration);
+    hash.add(parms.lensDistance);
+    hash.add(parms.widthbyMeters);
+    hash.add(parms.widthbyPixels);
+    hash.add(parms.heightbyPixels);
+    hash.add(parms.xxOffsetbyMeters);
+    return hash.hash;
+}
+
+bool VDistortionMesh::save(VIODevice *device, vuint64 key) const
+{
+    VBinaryStream stream(device);
+    stream.setByteOrder(VBinaryStream::LittleEndian);
+    stream.writeRawData(Magic, sizeof(Magic));
+    stream << Version << key << vertices.size() << indices.size();
+    stream.write(vertices);
+    stream.write(indices);
+    return stream.status() == VBinaryStream::Ok;
+}
+
+bool VDistortionMesh::load(VIODevice *device, vuint64 key)
+{
+    VBinaryStream stream(device);
+    stream.setByteOrder(VBinaryStream::LittleEndian);
+    char magic[sizeof(Magic)];
+    uint version = 0;
+    vuint64 savedKey = 0;
+    uint floatCount = 0;
+    uint indexCount = 0;
+    if (!stream.readRawData(magic, sizeof(magic)) || memcmp(magic, Magic, sizeof(Magic)) != 0) {
+        return false;
+    }
+    stream >> version >> savedKey >> floatCount >> indexCount;
+    if (stream.status() != VBinaryStream::Ok || version != Version || savedKey != key
+            || floatCount % AttribCount != 0 || floatCount / AttribCount > MaxVertexCount) {
+        return false;
+    }
+    bool valid = stream.read(vertices, floatCount) && stream.read(indices, indexCount);
+    const int count = vertexCount();
+    for (uint i = 0; valid && i < indices.size(); i++) {
+        valid = indices[i] < count;
+    }
+    if (!valid) {
+        vertices.clear();
+        indices.clear();
+    }
+    return valid;
+}
+
+bool VDistortionMesh::create(const Parms &parms, int gridX, int gridY, int numSlicesPerEye, float fovScale, bool cursorOnly,
+                             const VString &cacheDirectory)
+{
+    if (cacheDirectory.isEmpty()) {
+        return generate(parms, gridX, gridY, numSlicesPerEye, fovScale, cursorOnly);
+    }
+
+    const vuint64 key = Key(parms, gridX, gridY, numSlicesPerEye, fovScale, cursorOnly);
+    VString path = cacheDirectory;
+    if (!path.endsWith('/')) {
+        path.append('/');
+    }
+    path.sprintf("distortion-%016llx.mesh", key);
+
+    VFile file;
+    if (file.open(path, VFile::ReadOnly)) {
+        const bool loaded = load(&file, key);
+        file.close();
+        if (loaded) {
+            return true;
+        }
+        vWarn("VDistortionMesh: ignoring" << path);
+    }
+
+    if (!generate(parms, gridX, gridY, numSlicesPerEye, fovScale, cursorOnly)) {
+        return false;
+    }
+    if (!file.open(path, VFile::WriteOnly | VFile::Truncate) || !save(&file, key)) {
+        vWarn("VDistortionMesh: can't write" << path);
+    }
+    return true;
+}
+
+NV_NAMESPACE_END
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "VLensDistortion.h"
+
+NV_NAMESPACE_BEGIN
+
+class VDevice;
+class VIODevice;
+
+// The mesh VLensDistortion warps the eye buffers with, generated without GL so that it can be
+// tested and cached on disk. Each eye is a grid of gridX * gridY quads, split into slices for
+// the sliced warp, and each vertex holds AttribCount floats: the position, the tan angles of the
+// red, green and blue samples, the fraction of the slice and the fade.
+class VDistortionMesh
+{
+public:
+    enum { AttribCount = 10 };
+    enum { MaxGridSize = 128 };
+    // What ushort indices can address, a grid within MaxGridSize may still need more
+    enum { MaxVertexCount = 65535 };
+
+    // What the mesh depends on of the VDevice
+    struct Parms
+    {
+        // The lens of VDevice in front of a 2560x1440 screen
+        Parms();
+        explicit Parms(const VDevice *device);
+
+        VLensDistortion lens;
+        float lensDistance;
+        float widthbyMeters;
+        int widthbyPixels;
+        int heightbyPixels;
+        float xxOffsetbyMeters;
+    };
+
+    bool generate(const Parms &parms, int gridX, int gridY, int numSlicesPerEye, float fovScale, bool cursorOnly);
+
+    // Loads the mesh from cacheDirectory if it was generated from the same parameters before,
+    // otherwise generates it and saves it there. An empty cacheDirectory only generates it.
+    bool create(const Parms &parms, int gridX, int gridY, int numSlicesPerEye, float fovScale, bool cursorOnly,
+                const VString &cacheDirectory);
+
+    // Identifies the device, lens and grid parameters a mesh is generated from
+    static vuint64 Key(const Parms &parms, int gridX, int gridY, int numSlicesPerEye, float fovScale, bool cursorOnly);
+
+    bool save(VIODevice *device, vuint64 key) const;
+    // Fails if the mesh saved isn't the one of key, or indexes vertices it doesn't have
+    bool load(VIODevice *device, vuint64 key);
+
+    // The red, green and blue tan angles of the (gridX + 1) * (gridY + 1) vertices of both eyes,
+    // 6 floats each, rows interleaved by eye. The spline of the lens is evaluated four vertices
+    // at a time.
+    static void WarpTexCoords(const Parms &parms, int gridX, int gridY, float *texCoords);
+
+    int vertexCount() const { return vertices.size() / AttribCount; }
+
+    VArray<float> vertices;
+    VArray<ushort> indices;
+};
+
+NV_NAMESPACE_END
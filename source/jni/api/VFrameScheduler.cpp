@@ -0,0 +1,373 @@
+#include "VFrameScheduler.h"
+#include "VJson.h"
+#include "VLocklessRing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <math.h>
+#include <string.h>
+
+NV_NAMESPACE_BEGIN
+
+// async	drawn by an independent thread
+// sync		drawn by the same thread that draws the eye buffers
+//
+// frontBuffer	drawn directly to the front buffer with danger of tearing
+// swappedBuffer drawn to a swapped buffer with danger of missing a flip
+//
+// portrait		display scans the left eye completely before scanning the right
+// landscape	display scans both eyes simultaneously (DK1, not any of the mobile displays)
+//
+// Note that the OpenGL buffer may be rotated by hardware, and does not
+// necessarily match the scanning orientation -- a landscape Android app is still
+// displayed on a portrait scanned display.
+
+// We will need additional swapPrograms for global shutter low-persistence displays
+// with the same prediction value used for all points.
+
+// The values reported by the latency tester will tend to be
+// 8 milliseconds longer than the prediction values used here,
+// because the tester event pulse will happen at some random point
+// during the frame previous to the sensor sampling to render
+// an eye.  The IMU updates 500 or 1000 times a second, so there
+// is only a millisecond or so of jitter.
+
+// The target vsync will always go up by at least one after each
+// warp, which should prevent the swapped versions from ever falling into
+// triple buffering and getting an additional frame of latency.
+//
+// It may need to go up by more than one if warping is falling behind
+// the video rate, otherwise front buffer rendering could happen
+// prematurely, or swapped rendering could go into triple buffering.
+//
+// On entry to WarpToScreen()
+// nextVsync = floor( currentVsync ) + 1.0
+
+// If we have reliable GPU scheduling and front buffer rendering,
+// try to warp each eye exactly half a frame ahead.
+const swapProgram_t spAsyncFrontBufferPortrait = {
+        false, false, {0.5, 1.0}, {{1.0, 1.5}, {1.5, 2.0}}// //zx_note vivo反向刷屏修改
+};
+
+// If we have reliable GPU scheduling, but don't have front
+// buffer rendering, the warp thread should still wait until
+// mid frame before rendering the second eye, reducing latency.
+const swapProgram_t spAsyncSwappedBufferPortrait = {
+        false, false, {0.0, 0.5}, {{1.0, 1.5}, {1.5, 2.0}}
+};
+
+// If a single thread of control is doing the warping as well
+// as the eye rendering, we will usually already be in the second half
+// of the scanout, but we may still need to wait for it if the eye
+// rendering was unusually quick.  We will then need to wait for
+// vsync to start the right eye rendering.
+const swapProgram_t spSyncFrontBufferPortrait = {
+        true, false, {0.5, 1.0}, {{1.0, 1.5}, {1.5, 2.0}}
+};
+
+// If we are drawing to a swapped buffer, we don't want to wait at all,
+// for fear of missing the swap point and dropping the frame.
+// The true prediction timings for android would be 3,3.5,3.5,4, but
+// that is way too much prediction.
+const swapProgram_t spSyncSwappedBufferPortrait = {
+        true, false, {0.0, 0.0}, {{2.0, 2.5}, {2.5, 3.0}}
+};
+
+VSimulatedFrameClock::VSimulatedFrameClock(double refreshRate)
+    : m_seconds(1.0)
+    , m_period(1.0 / refreshRate)
+{
+}
+
+VsyncState VSimulatedFrameClock::vsyncState()
+{
+    VsyncState state;
+    state.vsyncCount = static_cast<long long>(floor(m_seconds / m_period));
+    state.vsyncPeriodNano = m_period * 1e9;
+    state.vsyncBaseNano = state.vsyncCount * m_period * 1e9;
+    return state;
+}
+
+void VSimulatedFrameClock::sleepUntil(double seconds, bool)
+{
+    m_seconds = std::max(m_seconds, seconds);
+}
+
+struct VFrameScheduler::Private
+{
+    VFrameClock *clock;
+
+    // SwapVsync at return from last WarpSwap(), only used by the main thread
+    long long lastSwapVsyncCount;
+
+    VLocklessRing<FrameTiming> log;
+    // Frames before this one were cleared
+    std::atomic<vint64> logBegin;
+
+    // The frame being warped and the previous one, only used by the warp thread
+    FrameTiming frame;
+    long long lastBufferNum;
+
+    Private(VFrameClock *clock, uint logSize)
+        : clock(clock)
+        , lastSwapVsyncCount(0)
+        , log(logSize)
+        , logBegin(0)
+        , lastBufferNum(0)
+    {
+        memset(&frame, 0, sizeof(frame));
+    }
+};
+
+VFrameScheduler::Percentiles VFrameScheduler::Percentile(VArray<float> &values)
+{
+    Percentiles percentiles = {0.0f, 0.0f, 0.0f, 0.0f};
+    if (values.isEmpty()) {
+        return percentiles;
+    }
+    std::sort(values.begin(), values.end());
+    const uint last = values.size() - 1;
+    percentiles.p50 = values[last * 50 / 100];
+    percentiles.p90 = values[last * 90 / 100];
+    percentiles.p99 = values[last * 99 / 100];
+    percentiles.max = values[last];
+    return percentiles;
+}
+
+VFrameScheduler::VFrameScheduler(VFrameClock *clock, uint logSize)
+    : d(new Private(clock, logSize))
+{
+}
+
+VFrameScheduler::~VFrameScheduler()
+{
+    delete d;
+}
+
+VFrameClock *VFrameScheduler::clock() const
+{
+    return d->clock;
+}
+
+double VFrameScheduler::fractionalVsync() const
+{
+    const VsyncState state = d->clock->vsyncState();
+
+    const double t = d->clock->seconds() * 1e9;
+    if (state.vsyncBaseNano == 0) {
+        return 0;
+    }
+    const double vsync =
+            (double) state.vsyncCount + (t - state.vsyncBaseNano) / state.vsyncPeriodNano;
+    return vsync;
+}
+
+double VFrameScheduler::framePointTimeInSeconds(const double framePoint) const
+{
+    const VsyncState state = d->clock->vsyncState();
+    const double seconds =
+            (state.vsyncBaseNano + (framePoint - state.vsyncCount) * state.vsyncPeriodNano) * 1e-9;
+    return seconds;
+}
+
+float VFrameScheduler::sleepUntilTimePoint(const double targetSeconds, const bool busyWait)
+{
+    const float sleepSeconds = targetSeconds - d->clock->seconds();
+    if (sleepSeconds > 0) {
+        d->clock->sleepUntil(targetSeconds, busyWait);
+    }
+    return sleepSeconds;
+}
+
+double VFrameScheduler::sleepUntilEye(const double vsyncBase, const swapProgram_t &swap, int eye)
+{
+    const double sleepTargetVsync = vsyncBase + swap.deltaVsync[eye];
+    const double sleepTargetTime = framePointTimeInSeconds(sleepTargetVsync);
+    sleepUntilTimePoint(sleepTargetTime, true);
+    return sleepTargetTime;
+}
+
+double VFrameScheduler::predictionTime(const double vsyncBase, const swapProgram_t &swap, int eye, int scan) const
+{
+    return framePointTimeInSeconds(vsyncBase + swap.predictionPoints[eye][scan]);
+}
+
+long long VFrameScheduler::selectEyeBuffers(long long latest, long long &considered, const std::function<BufferStatus(long long)> &status) const
+{
+    considered = 0;
+    for (int back = 0; back < MAX_WARP_SOURCES - 1; back++) {
+        considered = latest - back;
+        if (considered <= 0) {
+            // just starting, and we don't have any eye buffers to use
+            break;
+        }
+        switch (status(considered)) {
+        case BufferReady:
+            return considered;
+        case BufferPending:
+        case BufferTooNew:
+            continue;
+        case BufferInvalid:
+            return 0;
+        }
+    }
+    return 0;
+}
+
+long long VFrameScheduler::minimumVsync(int minimumVsyncs) const
+{
+    // don't use it if from same frame to avoid problems with very fast frames
+    return d->lastSwapVsyncCount + 2 * minimumVsyncs;
+}
+
+bool VFrameScheduler::latch(const SwapState &state, long long lastBufferCount, int minimumVsyncs)
+{
+    if (state.EyeBufferCount < lastBufferCount) {
+        return false;
+    }
+    // If MinimumVsyncs was increased dynamically, it is necessary
+    // to skip one or more vsyncs just as the change happens.
+    d->lastSwapVsyncCount = std::max(state.VsyncCount, d->lastSwapVsyncCount + minimumVsyncs);
+    return true;
+}
+
+void VFrameScheduler::beginFrame(long long vsync, long long bufferNum, double poseTime)
+{
+    FrameTiming &frame = d->frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.vsync = vsync;
+    frame.bufferNum = bufferNum;
+    frame.skipped = bufferNum == 0 || bufferNum == d->lastBufferNum;
+    if (bufferNum > 0) {
+        frame.poseLatencySeconds = framePointTimeInSeconds(vsync) - poseTime;
+    }
+    d->lastBufferNum = bufferNum;
+}
+
+void VFrameScheduler::eyeWarped(int eye, double sleepTarget, double issued, double completed, double predictedTime)
+{
+    FrameTiming &frame = d->frame;
+    frame.issueFinish[eye] = issued - sleepTarget;
+    frame.completeFinish[eye] = completed - sleepTarget;
+    frame.predictionSeconds[eye] = predictedTime - sleepTarget;
+}
+
+void VFrameScheduler::endFrame()
+{
+    d->log.append(d->frame);
+}
+
+VArray<VFrameScheduler::FrameTiming> VFrameScheduler::frames() const
+{
+    VArray<FrameTiming> frames;
+    const vint64 end = d->log.count();
+    vint64 index = std::max(d->log.first(), d->logBegin.load(std::memory_order_acquire));
+    frames.reserve(end - index);
+    for (; index < end; index++) {
+        //Frames overwritten meanwhile are left out
+        FrameTiming frame;
+        if (d->log.at(index, frame)) {
+            frames.append(frame);
+        }
+    }
+    return frames;
+}
+
+VFrameScheduler::Stats VFrameScheduler::stats() const
+{
+    const VArray<FrameTiming> frames = this->frames();
+    const float halfFrame = d->clock->vsyncState().vsyncPeriodNano * 0.5e-9;
+
+    Stats stats;
+    stats.frames = frames.size();
+    stats.skipped = 0;
+    stats.late = 0;
+    VArray<float> poseLatency;
+    VArray<float> completeFinish;
+    VArray<float> prediction;
+    for (const FrameTiming &frame : frames) {
+        if (frame.skipped) {
+            stats.skipped++;
+        }
+        if (frame.bufferNum == 0) {
+            continue;
+        }
+        poseLatency.append(frame.poseLatencySeconds);
+        const float complete = std::max(frame.completeFinish[0], frame.completeFinish[1]);
+        completeFinish.append(complete);
+        if (halfFrame > 0.0f && complete > halfFrame) {
+            stats.late++;
+        }
+        prediction.append(frame.predictionSeconds[0]);
+        prediction.append(frame.predictionSeconds[1]);
+    }
+    stats.poseLatency = Percentile(poseLatency);
+    stats.completeFinish = Percentile(completeFinish);
+    stats.prediction = Percentile(prediction);
+    return stats;
+}
+
+void VFrameScheduler::clearLog()
+{
+    d->logBegin.store(d->log.count(), std::memory_order_release);
+}
+
+void VFrameScheduler::writeCsv(std::ostream &out) const
+{
+    out << "vsync,bufferNum,skipped,issueFinish0,issueFinish1,completeFinish0,completeFinish1,poseLatency,prediction0,prediction1\n";
+    for (const FrameTiming &frame : frames()) {
+        out << frame.vsync << ',' << frame.bufferNum << ',' << (frame.skipped ? 1 : 0) << ','
+            << frame.issueFinish[0] << ',' << frame.issueFinish[1] << ','
+            << frame.completeFinish[0] << ',' << frame.completeFinish[1] << ','
+            << frame.poseLatencySeconds << ','
+            << frame.predictionSeconds[0] << ',' << frame.predictionSeconds[1] << '\n';
+    }
+}
+
+VJson VFrameScheduler::toJson() const
+{
+    auto percentiles = [](const Percentiles &values) {
+        VJsonObject object;
+        object["p50"] = VJson(values.p50);
+        object["p90"] = VJson(values.p90);
+        object["p99"] = VJson(values.p99);
+        object["max"] = VJson(values.max);
+        return VJson(object);
+    };
+
+    auto eyes = [](const float values[2]) {
+        VJsonArray array;
+        array.append(VJson(values[0]));
+        array.append(VJson(values[1]));
+        return VJson(std::move(array));
+    };
+
+    const Stats stats = this->stats();
+    VJsonObject summary;
+    summary["frames"] = VJson(stats.frames);
+    summary["skipped"] = VJson(stats.skipped);
+    summary["late"] = VJson(stats.late);
+    summary["poseLatency"] = percentiles(stats.poseLatency);
+    summary["completeFinish"] = percentiles(stats.completeFinish);
+    summary["prediction"] = percentiles(stats.prediction);
+
+    VJsonArray frames;
+    for (const FrameTiming &frame : this->frames()) {
+        VJsonObject object;
+        object["vsync"] = VJson(static_cast<double>(frame.vsync));
+        object["bufferNum"] = VJson(static_cast<double>(frame.bufferNum));
+        object["skipped"] = VJson(frame.skipped);
+        object["issueFinish"] = eyes(frame.issueFinish);
+        object["completeFinish"] = eyes(frame.completeFinish);
+        object["poseLatency"] = VJson(frame.poseLatencySeconds);
+        object["prediction"] = eyes(frame.predictionSeconds);
+        frames.append(VJson(std::move(object)));
+    }
+
+    VJsonObject trace;
+    trace["stats"] = VJson(std::move(summary));
+    trace["frames"] = VJson(std::move(frames));
+    return VJson(std::move(trace));
+}
+
+NV_NAMESPACE_END
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "VArray.h"
+
+#include <functional>
+#include <ostream>
+
+NV_NAMESPACE_BEGIN
+
+class VJson;
+
+class VsyncState {
+public:
+    long long vsyncCount;
+    double vsyncPeriodNano;
+    double vsyncBaseNano;
+};
+
+struct swapProgram_t {
+    // When a single thread is doing both the eye rendering and
+    // the warping, we will want to do the sensor read for the
+    // next frame on the second eye instead of the first.
+    bool singleThread;
+
+    // The eye 0 texture will be used for both window eyes.
+    bool dualMonoDisplay;
+
+    // Ensure that at least these Fractions of a frame have scanned
+    // before starting the eye warps.
+    float deltaVsync[2];
+
+    // Use prediction values in frames from the same
+    // base vsync as deltaVsync, so they can be
+    // scaled by frame times to get milliseconds, allowing
+    // 60 / 90 / 120 hz displays.
+    //
+    // For a global shutter low persistence display, all of these
+    // values should be the same.
+    //
+    // If the single thread rendering rate can drop below the vsync
+    // rate, all of the values should also be the same, because it
+    // would stay on screen without changing.
+    //
+    // For an incrementally displayed landscape scanned display,
+    // The left and right values will be the same.
+    float predictionPoints[2][2];    // [left/right][start/stop]
+};
+
+extern const swapProgram_t spAsyncFrontBufferPortrait;
+extern const swapProgram_t spAsyncSwappedBufferPortrait;
+extern const swapProgram_t spSyncFrontBufferPortrait;
+extern const swapProgram_t spSyncSwappedBufferPortrait;
+
+// This is communicated from the VFrameSmooth thread to the VrThread at
+// vsync time.
+struct SwapState {
+    SwapState() : VsyncCount(0), EyeBufferCount(0) { }
+
+    long long VsyncCount;
+    long long EyeBufferCount;
+};
+
+// The time and the vsync as the warp thread sees them: the display's on the device, a simulated
+// one to replay scheduling off the device.
+class VFrameClock
+{
+public:
+    virtual ~VFrameClock() {}
+
+    //Seconds of the monotonic clock
+    virtual double seconds() = 0;
+    //The last vsync reported, vsyncBaseNano is 0 until the first one
+    virtual VsyncState vsyncState() = 0;
+    virtual void sleepUntil(double seconds, bool busyWait) = 0;
+};
+
+// A display refreshing at a steady rate, whose time starts a second in and only goes forward when
+// it is slept on or advanced
+class VSimulatedFrameClock : public VFrameClock
+{
+public:
+    VSimulatedFrameClock(double refreshRate = 60.0);
+
+    double seconds() override { return m_seconds; }
+    VsyncState vsyncState() override;
+    void sleepUntil(double seconds, bool busyWait) override;
+
+    void advance(double seconds) { m_seconds += seconds; }
+    double period() const { return m_period; }
+
+private:
+    double m_seconds;
+    double m_period;
+};
+
+// When the warp thread wakes up for each eye, which eye buffers it warps and how far ahead it
+// predicts the head pose, independently of GL so that it can run on a simulated clock. It logs
+// the timing of the last frames, which can be queried from any thread.
+class VFrameScheduler
+{
+public:
+    static const int MAX_WARP_SOURCES = 4;
+
+    // What eyeLog_t used to hold, for one frame
+    struct FrameTiming
+    {
+        long long vsync;
+
+        // The eye buffers warped, 0 if there were none
+        long long bufferNum;
+
+        // If there were no eye buffers or they hadn't changed from the previous
+        // frame, the main thread dropped a frame.
+        bool skipped;
+
+        // Time relative to the sleep point for each eye.  Both should
+        // be below half a frame to avoid tearing.
+        float issueFinish[2];
+        float completeFinish[2];
+
+        // The delta from the time used to calculate the eye rendering pose
+        // to the top of this frame.  Should be one frame period plus sensor jitter
+        // if running synchronously at the video frame rate.
+        float poseLatencySeconds;
+
+        // How far ahead of the warp the pose was predicted, at the start of each eye's scan
+        float predictionSeconds[2];
+    };
+
+    struct Percentiles
+    {
+        float p50;
+        float p90;
+        float p99;
+        float max;
+    };
+
+    struct Stats
+    {
+        int frames;
+        int skipped;
+        // Frames an eye of which completed after half a frame, which tears on a front buffer
+        int late;
+        Percentiles poseLatency;
+        Percentiles completeFinish;
+        Percentiles prediction;
+    };
+
+    enum BufferStatus
+    {
+        BufferReady,
+        // Still rendering
+        BufferPending,
+        // Finished within the frame it was submitted in, held back to avoid stuttering
+        BufferTooNew,
+        BufferInvalid
+    };
+
+    // Sorts the values
+    static Percentiles Percentile(VArray<float> &values);
+
+    // The clock has to outlive the scheduler
+    VFrameScheduler(VFrameClock *clock, uint logSize = 512);
+    ~VFrameScheduler();
+
+    VFrameClock *clock() const;
+
+    double fractionalVsync() const;
+    double framePointTimeInSeconds(const double framePoint) const;
+    float sleepUntilTimePoint(const double targetSeconds, const bool busyWait);
+
+    // Sleeps until it's time to warp the eye, returns the time slept until
+    double sleepUntilEye(const double vsyncBase, const swapProgram_t &swap, int eye);
+    double predictionTime(const double vsyncBase, const swapProgram_t &swap, int eye, int scan) const;
+
+    // The newest of the eye buffers submitted up to latest that can be warped now, 0 if none.
+    // considered is the last one looked at, which is what the main thread waits for.
+    long long selectEyeBuffers(long long latest, long long &considered, const std::function<BufferStatus(long long)> &status) const;
+
+    // For the main thread: the first vsync eye buffers submitted now may be shown at, and
+    // whether the warp thread latched the previous ones and it can go on rendering.
+    long long minimumVsync(int minimumVsyncs) const;
+    bool latch(const SwapState &state, long long lastBufferCount, int minimumVsyncs);
+
+    // For the warp thread, around the warp of each frame
+    void beginFrame(long long vsync, long long bufferNum, double poseTime);
+    void eyeWarped(int eye, double sleepTarget, double issued, double completed, double predictedTime);
+    void endFrame();
+
+    // The frames logged, oldest first
+    VArray<FrameTiming> frames() const;
+    Stats stats() const;
+    void clearLog();
+
+    void writeCsv(std::ostream &out) const;
+    VJson toJson() const;
+
+private:
+    NV_DECLARE_PRIVATE
+    NV_DISABLE_COPY(VFrameScheduler)
+};
+
+NV_NAMESPACE_END
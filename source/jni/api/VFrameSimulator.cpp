@@ -0,0 +1,225 @@
+#include "VFrameSimulator.h"
+
+#include <algorithm>
+#include <math.h>
+#include <random>
+
+NV_NAMESPACE_BEGIN
+
+VFrameSimulator::Settings::Settings()
+    : refreshRate(60.0)
+    , swap(spAsyncFrontBufferPortrait)
+    , frontBuffer(true)
+    , minimumVsyncs(1)
+    , cpuSeconds(0.008)
+    , jitterSeconds(0.001)
+    , spikeProbability(0.01)
+    , spikeSeconds(0.02)
+    , gpuSeconds(0.005)
+    , warpIssueSeconds(0.0005)
+    , warpGpuSeconds(0.002)
+    , frames(600)
+    , seed(1)
+{
+}
+
+struct VFrameSimulator::Private
+{
+    // Eye buffers submitted by the application
+    struct Buffer
+    {
+        long long minimumVsync;
+        double poseTime;
+        double completeTime;
+    };
+
+    Settings settings;
+    VSimulatedFrameClock clock;
+    VFrameScheduler scheduler;
+    std::mt19937 random;
+
+    // buffers[bufferNum - 1]
+    VArray<Buffer> buffers;
+
+    // The application samples the pose when its frame starts, submits the eye buffers, then
+    // waits for the warp thread to latch the previous ones, as in VFrameSmooth::doSmooth()
+    double frameStart;
+    double submitTime;
+    bool waiting;
+    long long lastBufferCount;
+
+    VArray<float> predictionErrors;
+
+    Private(const Settings &settings)
+        : settings(settings)
+        , clock(settings.refreshRate)
+        , scheduler(&clock, settings.frames + 1)
+        , random(settings.seed)
+        , frameStart(0.0)
+        , submitTime(0.0)
+        , waiting(false)
+        , lastBufferCount(0)
+    {
+    }
+
+    double cpuTime()
+    {
+        double seconds = settings.cpuSeconds;
+        if (settings.jitterSeconds > 0.0) {
+            std::normal_distribution<double> jitter(0.0, settings.jitterSeconds);
+            seconds += jitter(random);
+        }
+        std::uniform_real_distribution<double> spike(0.0, 1.0);
+        if (spike(random) < settings.spikeProbability) {
+            seconds += settings.spikeSeconds;
+        }
+        return std::max(seconds, 0.0);
+    }
+
+    void startFrame(double now)
+    {
+        frameStart = now;
+        submitTime = now + cpuTime();
+        waiting = false;
+    }
+
+    // Runs the application up to the time given
+    void runApplication(double until)
+    {
+        if (waiting || submitTime > until) {
+            return;
+        }
+        Buffer buffer;
+        buffer.minimumVsync = scheduler.minimumVsync(settings.minimumVsyncs);
+        buffer.poseTime = frameStart;
+        buffer.completeTime = submitTime + settings.gpuSeconds;
+        lastBufferCount = buffers.size();
+        buffers.append(buffer);
+        waiting = true;
+    }
+
+    void sleepUntil(double seconds)
+    {
+        runApplication(seconds);
+        scheduler.sleepUntilTimePoint(seconds, false);
+    }
+
+    double vsyncAt(double seconds)
+    {
+        const VsyncState state = clock.vsyncState();
+        return state.vsyncCount + (seconds * 1e9 - state.vsyncBaseNano) / state.vsyncPeriodNano;
+    }
+
+    // The warp of a frame, as VFrameSmooth::Private::warpToScreen() schedules it
+    void warp(const double vsyncBase)
+    {
+        const swapProgram_t &swap = settings.swap;
+        bool warped = false;
+        double predicted[2];
+        double completed[2];
+        for (int eye = 0; eye <= 1; eye++) {
+            runApplication(scheduler.framePointTimeInSeconds(vsyncBase + swap.deltaVsync[eye]));
+            const double sleepTargetTime = scheduler.sleepUntilEye(vsyncBase, swap, eye);
+
+            if (eye == 0) {
+                const double now = clock.seconds();
+                long long considered = 0;
+                const long long bufferNum = scheduler.selectEyeBuffers(buffers.size(), considered,
+                                                                       [&](long long testBufferNum) {
+                    const Buffer &buffer = buffers[testBufferNum - 1];
+                    if (buffer.minimumVsync > vsyncBase) {
+                        return VFrameScheduler::BufferTooNew;
+                    }
+                    if (buffer.completeTime > now) {
+                        return VFrameScheduler::BufferPending;
+                    }
+                    return VFrameScheduler::BufferReady;
+                });
+                scheduler.beginFrame((long long) vsyncBase, bufferNum,
+                                     bufferNum > 0 ? buffers[bufferNum - 1].poseTime : 0.0);
+
+                SwapState state;
+                state.VsyncCount = (long long) vsyncBase;
+                state.EyeBufferCount = considered;
+                if (waiting && scheduler.latch(state, lastBufferCount, settings.minimumVsyncs)) {
+                    startFrame(now);
+                }
+
+                if (bufferNum == 0) {
+                    sleepUntil(scheduler.framePointTimeInSeconds(vsyncBase + swap.deltaVsync[eye] + 1.0));
+                    break;
+                }
+                warped = true;
+            }
+
+            const double issued = clock.seconds() + settings.warpIssueSeconds;
+            sleepUntil(issued);
+            completed[eye] = issued + settings.warpGpuSeconds;
+            if (settings.frontBuffer) {
+                // glFinish()
+                sleepUntil(completed[eye]);
+            }
+            predicted[eye] = scheduler.predictionTime(vsyncBase, swap, eye, 0);
+            scheduler.eyeWarped(eye, sleepTargetTime, issued, clock.seconds(), predicted[eye]);
+        }
+        scheduler.endFrame();
+
+        if (!warped) {
+            return;
+        }
+        // A portrait display scans the left eye in the first half of each refresh and the right
+        // eye in the second. The front buffer shows an eye from the first scan of it after the
+        // warp completed, a swapped buffer from the vsync after both completed.
+        for (int eye = 0; eye <= 1; eye++) {
+            double scanStart;
+            if (settings.frontBuffer) {
+                scanStart = ceil(vsyncAt(completed[eye]) - eye * 0.5) + eye * 0.5;
+            } else {
+                scanStart = ceil(vsyncAt(std::max(completed[0], completed[1]))) + eye * 0.5;
+            }
+            const double error = predicted[eye] - scheduler.framePointTimeInSeconds(scanStart);
+            predictionErrors.append(fabs(error));
+        }
+    }
+};
+
+VFrameSimulator::VFrameSimulator(const Settings &settings)
+    : d(new Private(settings))
+{
+    d->startFrame(d->clock.seconds());
+}
+
+VFrameSimulator::~VFrameSimulator()
+{
+    delete d;
+}
+
+VFrameSimulator::Result VFrameSimulator::run()
+{
+    d->scheduler.clearLog();
+    d->predictionErrors.clear();
+    const uint firstBuffer = d->buffers.size();
+
+    //The warp thread's loop in VFrameSmooth::Private::threadFunction()
+    double vsync = 0;
+    for (int frame = 0; frame < d->settings.frames; frame++, vsync++) {
+        const double current = ceil(d->scheduler.fractionalVsync());
+        if (fabs(current - vsync) > 2.0) {
+            vsync = current;
+        }
+        d->warp(vsync);
+    }
+
+    Result result;
+    result.stats = d->scheduler.stats();
+    result.predictionError = VFrameScheduler::Percentile(d->predictionErrors);
+    result.submitted = d->buffers.size() - firstBuffer;
+    return result;
+}
+
+const VFrameScheduler &VFrameSimulator::scheduler() const
+{
+    return d->scheduler;
+}
+
+NV_NAMESPACE_END
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "VFrameScheduler.h"
+
+NV_NAMESPACE_BEGIN
+
+// Runs the warp thread's scheduling against a simulated display and an application submitting
+// eye buffers, without GL, to compare swap programs and prediction settings off the device.
+// Only the asynchronous swap programs are simulated, the warp running on its own thread.
+class VFrameSimulator
+{
+public:
+    struct Settings
+    {
+        Settings();
+
+        double refreshRate;
+        swapProgram_t swap;
+        // Whether the warp draws to the front buffer, or to a buffer swapped at the next vsync
+        bool frontBuffer;
+        int minimumVsyncs;
+
+        // The application's frames: cpu time until it submits the eye buffers, with gaussian
+        // jitter and occasional spikes, then gpu time until they are complete
+        double cpuSeconds;
+        double jitterSeconds;
+        double spikeProbability;
+        double spikeSeconds;
+        double gpuSeconds;
+
+        // Time to issue the warp of an eye, then for the gpu to finish it
+        double warpIssueSeconds;
+        double warpGpuSeconds;
+
+        int frames;
+        uint seed;
+    };
+
+    struct Result
+    {
+        VFrameScheduler::Stats stats;
+        // How far off the predicted time was from the time the scan of each eye started
+        VFrameScheduler::Percentiles predictionError;
+        // Eye buffers the application submitted
+        int submitted;
+    };
+
+    VFrameSimulator(const Settings &settings = Settings());
+    ~VFrameSimulator();
+
+    // Simulates settings.frames more frames, the scheduler's log holding only those
+    Result run();
+
+    const VFrameScheduler &scheduler() const;
+
+private:
+    NV_DECLARE_PRIVATE
+    NV_DISABLE_COPY(VFrameSimulator)
+};
+
+NV_NAMESPACE_END
@@ -1,4 +1,3 @@
-#include <sys/syscall.h>
 #include <sched.h>
 #include <unistd.h>
 
@@ -15,12 +14,14 @@
 
 #include "VMutex.h"
 #include "VWaitCondition.h"
+#include "VThread.h"
 #include "VFrameSmooth.h"
 #include "android/JniUtils.h"
 #include "VLensDistortion.h"
 #include "../core/VString.h"
 #include "VTimer.h"
 #include "VRotationSensor.h"
+#include "VFrameScheduler.h"
 
 #include "../core/VLockless.h"
 #include "VGlGeometry.h"
@@ -33,13 +34,6 @@ NV_NAMESPACE_BEGIN
 
 extern JavaVM *VrLibJavaVM;
 
-class VsyncState {
-public:
-    long long vsyncCount;
-    double vsyncPeriodNano;
-    double vsyncBaseNano;
-};
-
 namespace {
     VLockless<VsyncState> UpdatedVsyncState;
 }
@@ -60,6 +54,35 @@ void Java_com_vrseen_VrLib_nativeVsync(JNIEnv *, jclass, jlong frameTimeNanos) {
 }
 }
 
+// The display's vsync, as Java reports it
+class SystemFrameClock : public VFrameClock
+{
+public:
+    double seconds() override { return VTimer::Seconds(); }
+
+    VsyncState vsyncState() override { return UpdatedVsyncState.state(); }
+
+    void sleepUntil(double targetSeconds, bool busyWait) override
+    {
+        if (busyWait) {
+            while (targetSeconds - VTimer::Seconds() > 0) {
+            }
+        }
+        else {
+            // I'm assuming we will never sleep more than one full second.
+            const float sleepSeconds = targetSeconds - VTimer::Seconds();
+            timespec t, rem;
+            t.tv_sec = 0;
+            t.tv_nsec = sleepSeconds * 1e9;
+            nanosleep(&t, &rem);
+            const double overSleep = VTimer::Seconds() - targetSeconds;
+            if (overSleep > 0.001) {
+                //			vInfo("Overslept " << overSleep << " seconds");
+            }
+        }
+    }
+};
+
 struct warpSource_t {
     longlong MinimumVsync;                // Never pick up a source if it is from the current vsync.
     longlong FirstDisplayedVsync[2];        // External velocity is added after this vsync.
@@ -73,129 +96,6 @@ struct warpSource_t {
     }
 };
 
-struct swapProgram_t {
-    // When a single thread is doing both the eye rendering and
-    // the warping, we will want to do the sensor read for the
-    // next frame on the second eye instead of the first.
-    bool singleThread;
-
-    // The eye 0 texture will be used for both window eyes.
-    bool dualMonoDisplay;
-
-    // Ensure that at least these Fractions of a frame have scanned
-    // before starting the eye warps.
-    float deltaVsync[2];
-
-    // Use prediction values in frames from the same
-    // base vsync as deltaVsync, so they can be
-    // scaled by frame times to get milliseconds, allowing
-    // 60 / 90 / 120 hz displays.
-    //
-    // For a global shutter low persistence display, all of these
-    // values should be the same.
-    //
-    // If the single thread rendering rate can drop below the vsync
-    // rate, all of the values should also be the same, because it
-    // would stay on screen without changing.
-    //
-    // For an incrementally displayed landscape scanned display,
-    // The left and right values will be the same.
-    float predictionPoints[2][2];    // [left/right][start/stop]
-};
-
-// This is communicated from the VFrameSmooth thread to the VrThread at
-// vsync time.
-struct SwapState {
-    SwapState() : VsyncCount(0), EyeBufferCount(0) { }
-
-    long long VsyncCount;
-    long long EyeBufferCount;
-};
-
-struct eyeLog_t {
-    // If we dropped an entire frame, this will be true for both eyes.
-    bool skipped;
-
-    // if this hasn't changed from the previous frame, the main thread
-    // dropped a frame.
-    int bufferNum;
-
-    // Time relative to the sleep point for this eye.  Both should
-    // be below 0.008 to avoid tearing.
-    float issueFinish;
-    float completeFinish;
-
-    // The delta from the time used to calculate the eye rendering pose
-    // to the top of this frame.  Should be one frame period plus sensor jitter
-    // if running synchronously at the video frame rate.
-    float poseLatencySeconds;
-};
-
-// async	drawn by an independent thread
-// sync		drawn by the same thread that draws the eye buffers
-//
-// frontBuffer	drawn directly to the front buffer with danger of tearing
-// swappedBuffer drawn to a swapped buffer with danger of missing a flip
-//
-// portrait		display scans the left eye completely before scanning the right
-// landscape	display scans both eyes simultaneously (DK1, not any of the mobile displays)
-//
-// Note that the OpenGL buffer may be rotated by hardware, and does not
-// necessarily match the scanning orientation -- a landscape Android app is still
-// displayed on a portrait scanned display.
-
-// We will need additional swapPrograms for global shutter low-persistence displays
-// with the same prediction value used for all points.
-
-// The values reported by the latency tester will tend to be
-// 8 milliseconds longer than the prediction values used here,
-// because the tester event pulse will happen at some random point
-// during the frame previous to the sensor sampling to render
-// an eye.  The IMU updates 500 or 1000 times a second, so there
-// is only a millisecond or so of jitter.
-
-// The target vsync will always go up by at least one after each
-// warp, which should prevent the swapped versions from ever falling into
-// triple buffering and getting an additional frame of latency.
-//
-// It may need to go up by more than one if warping is falling behind
-// the video rate, otherwise front buffer rendering could happen
-// prematurely, or swapped rendering could go into triple buffering.
-//
-// On entry to WarpToScreen()
-// nextVsync = floor( currentVsync ) + 1.0
-
-// If we have reliable GPU scheduling and front buffer rendering,
-// try to warp each eye exactly half a frame ahead.
-swapProgram_t spAsyncFrontBufferPortrait = {
-        false, false, {0.5, 1.0}, {{1.0, 1.5}, {1.5, 2.0}}// //zx_note vivo反向刷屏修改
-};
-
-// If we have reliable GPU scheduling, but don't have front
-// buffer rendering, the warp thread should still wait until
-// mid frame before rendering the second eye, reducing latency.
-swapProgram_t spAsyncSwappedBufferPortrait = {
-        false, false, {0.0, 0.5}, {{1.0, 1.5}, {1.5, 2.0}}
-};
-
-// If a single thread of control is doing the warping as well
-// as the eye rendering, we will usually already be in the second half
-// of the scanout, but we may still need to wait for it if the eye
-// rendering was unusually quick.  We will then need to wait for
-// vsync to start the right eye rendering.
-swapProgram_t spSyncFrontBufferPortrait = {
-        true, false, {0.5, 1.0}, {{1.0, 1.5}, {1.5, 2.0}}
-};
-
-// If we are drawing to a swapped buffer, we don't want to wait at all,
-// for fear of missing the swap point and dropping the frame.
-// The true prediction timings for android would be 3,3.5,3.5,4, but
-// that is way too much prediction.
-swapProgram_t spSyncSwappedBufferPortrait = {
-        true, false, {0.0, 0.0}, {{2.0, 2.5}, {2.5, 3.0}}
-};
-
-
 //=========================================================================================
 
 // If lensCentered, the coordinates will be square and extend past the left and
@@ -310,10 +210,8 @@ struct VFrameSmooth::Private {
             m_eglClientVersion(0),
             m_eglShareContext(0),
             m_contextPriority(0),
-            m_eyeLog(),
-            m_lastEyeLog(0),
-            m_warpThread(0),
-            m_lastSwapVsyncCount(0),
+            m_scheduler(&m_clock),
+            m_warpThread(nullptr),
             m_mutex(false),
             m_flags(0),
             m_direction(direction) {
@@ -333,7 +231,7 @@ struct VFrameSmooth::Private {
         m_lastWarpSwapTimeInSeconds.setState(VTimer::Seconds());
 
         // If this isn't set, Shutdown() doesn't need to kill the thread
-        m_warpThread = 0;
+        m_warpThread = nullptr;
 
         m_device = VDevice::instance();
 
@@ -391,10 +289,13 @@ struct VFrameSmooth::Private {
         // able to exit until we do the pthread_cond_wait
         pthread_mutex_lock(&m_swapMutex);
 
-        // spawn the warp thread
-        const int createErr = pthread_create(&m_warpThread, NULL, &ThreadStarter, this);
-        if (createErr != 0) {
-            vFatal("pthread_create returned ");
+        // spawn the warp thread, it pins itself to the first core
+        m_warpThread = new VThread(&ThreadStarter, this);
+        m_warpThread->setName("TimeWarp");
+        //The stack pthread gives by default on Android, which it always ran with
+        m_warpThread->setStackSize(1024 * 1024);
+        if (!m_warpThread->start()) {
+            vFatal("Failed to start the warp thread");
         }
 
         // Atomically unlock the mutex and block until the warp thread
@@ -408,17 +309,13 @@ struct VFrameSmooth::Private {
 
     void destroy() {
         //VInfo( "---------------- ~VFrameSmooth() Start ----------------" );
-        if (m_warpThread != 0) {
+        if (m_warpThread != nullptr) {
             // Get the background thread to kill itself.
             m_shutdownRequest.setState(true);
 
-            //VInfo( "pthread_join() called");
-            void *data;
-            pthread_join(m_warpThread, &data);
-
-            //VInfo( "pthread_join() returned");
-
-            m_warpThread = 0;
+            m_warpThread->wait();
+            delete m_warpThread;
+            m_warpThread = nullptr;
 
             eglMakeCurrent(EGL_NO_DISPLAY, EGL_NO_SURFACE, EGL_NO_SURFACE, m_eglStatus.m_context);
             // Destroy the pbuffer surface that was attached to the calling context.
@@ -439,8 +336,8 @@ struct VFrameSmooth::Private {
         }
     }
 
-    // POSIX thread launching shim, just calls WarpThread()
-    static void *ThreadStarter(void *parm);
+    // VThread launching shim, just calls WarpThread()
+    static int ThreadStarter(void *parm);
 
     void threadFunction();
 
@@ -472,11 +369,11 @@ struct VFrameSmooth::Private {
     void drawFrameworkGraphicsToWindow(const int eye, const int swapOptions);
 
     //用于管理同步的函数
-    double getFractionalVsync();
+    double getFractionalVsync() const { return m_scheduler.fractionalVsync(); }
 
-    double framePointTimeInSeconds(const double framePoint) const;
+    double framePointTimeInSeconds(const double framePoint) const { return m_scheduler.framePointTimeInSeconds(framePoint); }
 
-    float sleepUntilTimePoint(const double targetSeconds, const bool busyWait);
+    float sleepUntilTimePoint(const double targetSeconds, const bool busyWait) { return m_scheduler.sleepUntilTimePoint(targetSeconds, busyWait); }
 
     VDevice *m_device;
 
@@ -503,6 +400,10 @@ struct VFrameSmooth::Private {
 
     void warpToScreenSliced(const double vsyncBase, const swapProgram_t &swap);
 
+    // Picks the newest eye buffers that can be warped at vsyncBase and releases the VR thread
+    // if it is waiting for them. currentWarpSource is left empty if there are none.
+    void latchWarpSource(const double vsyncBase, const int eye, warpSource_t &currentWarpSource);
+
     bool isSumsungDevice();
 
     const VGlShader &programForParms(const VTimeWarpParms &parms,
@@ -533,16 +434,15 @@ struct VFrameSmooth::Private {
     // Our private context, only used for warping to the screen.
     GLuint m_contextPriority;
 
-    // Data for timing graph
-    static const int EYE_LOG_COUNT = 512;
-    eyeLog_t m_eyeLog[EYE_LOG_COUNT];
-    long long m_lastEyeLog;    // eyeLog[(lastEyeLog-1)&(EYE_LOG_COUNT-1)] has valid data
+    // When to warp and which eye buffers, and the timing of the last frames
+    SystemFrameClock m_clock;
+    VFrameScheduler m_scheduler;
 
     // The warp loop will exit when this is set true.
     VLockless<bool> m_shutdownRequest;
 
-    // If this is 0, we don't have a thread running.
-    pthread_t m_warpThread;        // posix pthread
+    // If this is null, we don't have a thread running.
+    VThread *m_warpThread;
 
     // Used to allow the VrThread to sleep until next vsync.
     pthread_mutex_t m_swapMutex;
@@ -556,14 +456,12 @@ struct VFrameSmooth::Private {
     //
     // WarpSwap will not continue until the previous buffer set has completed,
     // to prevent GPU latency pileup.
-    static const int MAX_WARP_SOURCES = 4;
+    static const int MAX_WARP_SOURCES = VFrameScheduler::MAX_WARP_SOURCES;
     VLockless<long long> m_eyeBufferCount;    // only set by WarpSwap()
     warpSource_t m_warpSources[MAX_WARP_SOURCES];
 
     VLockless<SwapState> m_swapVsync;        // Set by WarpToScreen(), read by WarpSwap()
 
-    long long m_lastSwapVsyncCount;            // SwapVsync at return from last WarpSwap()
-
     VMutex m_mutex;
     int32_t m_flags;                    // flags defined above
     VWaitCondition m_cond_suspended;
@@ -572,63 +470,18 @@ struct VFrameSmooth::Private {
     VFrameSmooth::HardwareRefreshDirection m_direction;
 };
 
-double    VFrameSmooth::Private::getFractionalVsync() {
-    const VsyncState state = UpdatedVsyncState.state();
-
-    const jlong t = VTimer::TicksNanos();
-    if (state.vsyncBaseNano == 0) {
-        return 0;
-    }
-    const double vsync =
-            (double) state.vsyncCount + (double) (t - state.vsyncBaseNano) / state.vsyncPeriodNano;
-    return vsync;
-}
-
-double    VFrameSmooth::Private::framePointTimeInSeconds(const double framePoint) const {
-    const VsyncState state = UpdatedVsyncState.state();
-    const double seconds =
-            (state.vsyncBaseNano + (framePoint - state.vsyncCount) * state.vsyncPeriodNano) * 1e-9;
-    return seconds;
-}
-
-float    VFrameSmooth::Private::sleepUntilTimePoint(const double targetSeconds,
-                                                    const bool busyWait) {
-    const float sleepSeconds = targetSeconds - VTimer::Seconds();
-    if (sleepSeconds > 0) {
-        if (busyWait) {
-            while (targetSeconds - VTimer::Seconds() > 0) {
-            }
-        }
-        else {
-            // I'm assuming we will never sleep more than one full second.
-            timespec t, rem;
-            t.tv_sec = 0;
-            t.tv_nsec = sleepSeconds * 1e9;
-            nanosleep(&t, &rem);
-            const double overSleep = VTimer::Seconds() - targetSeconds;
-            if (overSleep > 0.001) {
-                //			vInfo("Overslept " << overSleep << " seconds");
-            }
-        }
-    }
-    return sleepSeconds;
-}
-
-// Shim to call a C++ object from a posix thread start.
-void *VFrameSmooth::Private::ThreadStarter(void *parm) {
+// Shim to call a C++ object from a VThread start.
+int VFrameSmooth::Private::ThreadStarter(void *parm) {
     VFrameSmooth::Private &tw = *(VFrameSmooth::Private *) parm;
     tw.threadFunction();
-    return NULL;
+    return 0;
 }
 
 void VFrameSmooth::Private::threadFunction() {
 
-    int syscallres, mask = 1;
-    pid_t pid = gettid();
-    syscallres = syscall(__NR_sched_setaffinity, pid, sizeof(mask), &mask);
-    if (syscallres) {
-        int num = sysconf(_SC_NPROCESSORS_CONF);
-        vFatal("Failed to set thread affinity with " << num << " cores!");
+    //Set from the thread itself, as VThread only warns when it fails to apply its settings
+    if (!m_warpThread->setAffinity(1)) {
+        vFatal("Failed to set thread affinity with " << VThread::CpuCount() << " cores!");
     }
 
     jint rtn = VrLibJavaVM->AttachCurrentThread(&m_jni, 0);
@@ -728,7 +581,11 @@ VFrameSmooth::~VFrameSmooth() {
 }
 
 int VFrameSmooth::threadId() const {
-    return d->m_warpThread;
+    return d->m_warpThread ? d->m_warpThread->tid() : 0;
+}
+
+const VFrameScheduler &VFrameSmooth::scheduler() const {
+    return d->m_scheduler;
 }
 
 void VFrameSmooth::pause() {
@@ -784,8 +641,6 @@ void VFrameSmooth::Private::warpThreadInit() {
     if (m_eglStatus.m_context == EGL_NO_CONTEXT) {
         vFatal("eglCreateContext failed");
     }
-
-    m_warpThread = gettid();
 }
 
 /*
@@ -1051,7 +906,7 @@ static void UnbindEyeTextures() {
  * Calls getFractionalVsync() multiple times, but this only calls kernel time functions, not java
  * Calls sleepUntilTimePoint() for each eye.
  * May write to the log
- * Writes eyeLog[]
+ * Logs the frame timing to m_scheduler
  * Reads warpSources
  * Reads eyeBufferCount
  * May lock and unlock swapMutex
@@ -1092,85 +947,18 @@ void VFrameSmooth::Private::warpToScreen(const double vsyncBase_, const swapProg
         //LOG( "Eye %i: now=%f  sleepTo=%f", eye, getFractionalVsync(), vsyncBase + swap.deltaVsync[eye] );
         // vInfo( "Vsync %f:%i sleep %f", vsyncBase, eye, secondsToSleep );
 
-        const double sleepTargetVsync = vsyncBase + swap.deltaVsync[eye];
-        double sleepTargetTime = framePointTimeInSeconds(sleepTargetVsync);
-
-        sleepUntilTimePoint(sleepTargetTime, /*false*/true);
+        const double sleepTargetTime = m_scheduler.sleepUntilEye(vsyncBase, swap, eye);
 
         // Check for availability of updated eye renderings
         // now that we are about to render.
-        long long thisEyeBufferNum = 0;
-        int back;
-
         if (eye == 0) {
-            const long long latestEyeBufferNum = m_eyeBufferCount.state();
-            for (back = 0; back < MAX_WARP_SOURCES - 1; back++) {
-                thisEyeBufferNum = latestEyeBufferNum - back;
-                if (thisEyeBufferNum <= 0) {
-                    // just starting, and we don't have any eye buffers to use
-                    //VInfo( "WarpToScreen: No valid Eye Buffers" );
-                    break;
-                }
-                warpSource_t &testWarpSource = m_warpSources[thisEyeBufferNum % MAX_WARP_SOURCES];
-                if (testWarpSource.MinimumVsync > vsyncBase) {
-                    // a full frame got completed in less time than a single eye; don't use it to avoid stuttering
-                    continue;
-                }
-                if (testWarpSource.GpuSync == 0) {
-                    //VInfo( "thisEyeBufferNum %lli had 0 sync", thisEyeBufferNum );
-                    break;
-                }
-
-                if (testWarpSource.WarpParms.Images[eye][0].Pose.LengthSq() < 1e-18f) {
-                    vInfo("Bad Pose.Orientation in bufferNum " << thisEyeBufferNum << "!");
-                    break;
-                }
-
-                const EGLint wait = m_eglStatus.eglClientWaitSyncKHR(m_eglStatus.m_display,
-                                                                     testWarpSource.GpuSync,
-                                                                     EGL_SYNC_FLUSH_COMMANDS_BIT_KHR,
-                                                                     0);
-                if (wait == EGL_TIMEOUT_EXPIRED_KHR) {
-                    continue;
-                }
-                if (wait == EGL_FALSE) {
-                    //VInfo( "eglClientWaitSyncKHR returned EGL_FALSE" );
-                }
-
-                // This buffer set is good to use
-                if (testWarpSource.FirstDisplayedVsync[eye] == 0) {
-                    testWarpSource.FirstDisplayedVsync[eye] = (long long) vsyncBase;
-                }
-                currentWarpSource = testWarpSource;
-                break;
-            }
-
-            // Save this sensor state for the next application rendering frame.
-            // It is important that this always be done, even if we wind up
-            // not rendering anything because there are no current eye buffers.
-            {
-                SwapState state;
-                state.VsyncCount = (long long) vsyncBase;
-                state.EyeBufferCount = thisEyeBufferNum;
-                m_swapVsync.setState(state);
-
-                // Wake the VR thread up if it is blocked on us.
-                // If the other thread happened to be scheduled out right
-                // after locking the mutex, but before waiting on the condition,
-                // we would rather it sleep for another frame than potentially
-                // miss a raster point here in the time warp thread, so use
-                // a trylock() instead of a lock().
-                if (!pthread_mutex_trylock(&m_swapMutex)) {
-                    pthread_cond_signal(&m_swapIsLatched);
-                    pthread_mutex_unlock(&m_swapMutex);
-                }
-            }
+            latchWarpSource(vsyncBase, eye, currentWarpSource);
 
             if (currentWarpSource.WarpParms.Images[eye][0].TexId == 0) {
                 // We don't have anything valid to draw, so just sleep until
                 // the next time point and check again.
                 //VInfo( "WarpToScreen: Nothing valid to draw" );
-                sleepUntilTimePoint(framePointTimeInSeconds(sleepTargetVsync + 1.0f), false);
+                sleepUntilTimePoint(framePointTimeInSeconds(vsyncBase + swap.deltaVsync[eye] + 1.0f), false);
                 break;
             }
         }
@@ -1199,8 +987,7 @@ void VFrameSmooth::Private::warpToScreen(const double vsyncBase_, const swapProg
         VMatrix4f timeWarps[2][2];
         VRotationState sensor[2];
         for (int scan = 0; scan < 2; scan++) {
-            const double vsyncPoint = vsyncBase + swap.predictionPoints[eye][scan];
-            const double timePoint = framePointTimeInSeconds(vsyncPoint);
+            const double timePoint = m_scheduler.predictionTime(vsyncBase, swap, eye, scan);
             sensor[scan] = VRotationSensor::instance()->predictState(timePoint);
             const VMatrix4f warp = CalculateTimeWarpMatrix2(
                     currentWarpSource.WarpParms.Images[eye][0].Pose,
@@ -1319,8 +1106,12 @@ void VFrameSmooth::Private::warpToScreen(const double vsyncBase_, const swapProg
         if (latency > 0.008f) {
             //vError( "Frame " << (int)vsyncBase << "for eye " << eye << " total takes " << (latency*1000) << "ms!");
         }
+        m_scheduler.eyeWarped(eye, sleepTargetTime, justBeforeFinish, postFinish,
+                              m_scheduler.predictionTime(vsyncBase, swap, eye, 0));
     }    // for eye
 
+    m_scheduler.endFrame();
+
     UnbindEyeTextures();
 
     glUseProgram(0);
@@ -1375,8 +1166,7 @@ void VFrameSmooth::Private::warpToScreenSliced(const double vsyncBase, const swa
 
     // Warp each slice to the display surface
     warpSource_t currentWarpSource = {};
-    int back = 0;    // frame back from most recent
-    long long thisEyeBufferNum = 0;
+    double eyeSleepTargetTime = 0.0;
     for (int screenSlice = 0; screenSlice < NUM_SLICES_PER_SCREEN; screenSlice++) {
         const int eye = (int) (screenSlice / NUM_SLICES_PER_EYE);
 
@@ -1384,82 +1174,16 @@ void VFrameSmooth::Private::warpToScreenSliced(const double vsyncBase, const swa
         // rendering this slice.
         const double sleepTargetTime = sliceTimes[screenSlice] - schedulingCushion;
         sleepUntilTimePoint(sleepTargetTime, false);
+        if (screenSlice % NUM_SLICES_PER_EYE == 0) {
+            eyeSleepTargetTime = sleepTargetTime;
+        }
         //const double preFinish = VTimer::Seconds();
 
         //LOG( "slice %i targ %f slept %f", screenSlice, sleepTargetTime, secondsToSleep );
 
         // Check for availability of updated eye renderings now that we are about to render.
         if (screenSlice == 0) {
-            const long long latestEyeBufferNum = m_eyeBufferCount.state();
-            for (back = 0; back < MAX_WARP_SOURCES - 1; back++) {
-                thisEyeBufferNum = latestEyeBufferNum - back;
-                if (thisEyeBufferNum <= 0) {
-                    //VInfo( "WarpToScreen: No valid Eye Buffers" );
-                    // just starting, and we don't have any eye buffers to use
-                    break;
-                }
-
-                warpSource_t &testWarpSource = m_warpSources[thisEyeBufferNum % MAX_WARP_SOURCES];
-                if (testWarpSource.MinimumVsync > vsyncBase) {
-                    // a full frame got completed in less time than a single eye; don't use it to avoid stuttering
-                    continue;
-                }
-
-                if (testWarpSource.GpuSync == 0) {
-                    //VInfo( "thisEyeBufferNum %lli had 0 sync", thisEyeBufferNum );
-                    break;
-                }
-
-//                if ( VQuatf( testWarpSource.WarpParms.Images[eye][0].Pose.Pose.Orientation ).LengthSq() < 1e-18f )
-//                {
-//                    //VInfo( "Bad Predicted.Pose.Orientation!" );
-//                    continue;
-//                }
-
-                if (testWarpSource.WarpParms.Images[eye][0].Pose.LengthSq() < 1e-18f) {
-                    vInfo("Bad Pose.Orientation in bufferNum " << thisEyeBufferNum << "!");
-                    break;
-                }
-
-                const EGLint wait = m_eglStatus.eglClientWaitSyncKHR(m_eglStatus.m_display,
-                                                                     testWarpSource.GpuSync,
-                                                                     EGL_SYNC_FLUSH_COMMANDS_BIT_KHR,
-                                                                     0);
-                if (wait == EGL_TIMEOUT_EXPIRED_KHR) {
-                    continue;
-                }
-                if (wait == EGL_FALSE) {
-                    //VInfo( "eglClientWaitSyncKHR returned EGL_FALSE" );
-                }
-
-                // This buffer set is good to use
-                if (testWarpSource.FirstDisplayedVsync[eye] == 0) {
-                    testWarpSource.FirstDisplayedVsync[eye] = (long long) vsyncBase;
-                }
-                currentWarpSource = testWarpSource;
-                break;
-            }
-
-            // Release the VR thread if it is blocking on a frame being completed.
-            // It is important that this always be done, even if we wind up
-            // not rendering anything because there are no current eye buffers.
-            if (screenSlice == 0) {
-                SwapState state;
-                state.VsyncCount = (long long) vsyncBase;
-                state.EyeBufferCount = thisEyeBufferNum;
-                m_swapVsync.setState(state);
-
-                // Wake the VR thread up if it is blocked on us.
-                // If the other thread happened to be scheduled out right
-                // after locking the mutex, but before waiting on the condition,
-                // we would rather it sleep for another frame than potentially
-                // miss a raster point here in the time warp thread, so use
-                // a trylock() instead of a lock().
-                if (!pthread_mutex_trylock(&m_swapMutex)) {
-                    pthread_cond_signal(&m_swapIsLatched);
-                    pthread_mutex_unlock(&m_swapMutex);
-                }
-            }
+            latchWarpSource(vsyncBase, eye, currentWarpSource);
 
             if (currentWarpSource.WarpParms.Images[eye][0].TexId == 0) {
                 // We don't have anything valid to draw, so just sleep until
@@ -1586,8 +1310,14 @@ void VFrameSmooth::Private::warpToScreenSliced(const double vsyncBase, const swa
         if (latency > 0.008f) {
             vError("Frame %i Eye %i latency %5.3f" << (int) vsyncBase << eye << latency);
         }
+        if (screenSlice % NUM_SLICES_PER_EYE == NUM_SLICES_PER_EYE - 1) {
+            m_scheduler.eyeWarped(eye, eyeSleepTargetTime, justBeforeFinish, postFinish,
+                                  sliceTimes[eye * NUM_SLICES_PER_EYE]);
+        }
     }    // for screenSlice
 
+    m_scheduler.endFrame();
+
     UnbindEyeTextures();
 
     glUseProgram(0);
@@ -1599,6 +1329,70 @@ void VFrameSmooth::Private::warpToScreenSliced(const double vsyncBase, const swa
     }
 }
 
+void VFrameSmooth::Private::latchWarpSource(const double vsyncBase, const int eye,
+                                            warpSource_t &currentWarpSource) {
+    long long thisEyeBufferNum = 0;
+    const long long bufferNum = m_scheduler.selectEyeBuffers(m_eyeBufferCount.state(), thisEyeBufferNum,
+                                                             [&](long long testBufferNum) {
+        const warpSource_t &testWarpSource = m_warpSources[testBufferNum % MAX_WARP_SOURCES];
+        if (testWarpSource.MinimumVsync > vsyncBase) {
+            // a full frame got completed in less time than a single eye; don't use it to avoid stuttering
+            return VFrameScheduler::BufferTooNew;
+        }
+        if (testWarpSource.GpuSync == 0) {
+            //VInfo( "thisEyeBufferNum %lli had 0 sync", testBufferNum );
+            return VFrameScheduler::BufferInvalid;
+        }
+
+        if (testWarpSource.WarpParms.Images[eye][0].Pose.LengthSq() < 1e-18f) {
+            vInfo("Bad Pose.Orientation in bufferNum " << testBufferNum << "!");
+            return VFrameScheduler::BufferInvalid;
+        }
+
+        const EGLint wait = m_eglStatus.eglClientWaitSyncKHR(m_eglStatus.m_display,
+                                                             testWarpSource.GpuSync,
+                                                             EGL_SYNC_FLUSH_COMMANDS_BIT_KHR,
+                                                             0);
+        if (wait == EGL_TIMEOUT_EXPIRED_KHR) {
+            return VFrameScheduler::BufferPending;
+        }
+        if (wait == EGL_FALSE) {
+            //VInfo( "eglClientWaitSyncKHR returned EGL_FALSE" );
+        }
+        return VFrameScheduler::BufferReady;
+    });
+
+    if (bufferNum > 0) {
+        // This buffer set is good to use
+        warpSource_t &warpSource = m_warpSources[bufferNum % MAX_WARP_SOURCES];
+        if (warpSource.FirstDisplayedVsync[eye] == 0) {
+            warpSource.FirstDisplayedVsync[eye] = (long long) vsyncBase;
+        }
+        currentWarpSource = warpSource;
+    }
+    m_scheduler.beginFrame((long long) vsyncBase, bufferNum,
+                           currentWarpSource.WarpParms.Images[eye][0].Pose.timestamp);
+
+    // Save this sensor state for the next application rendering frame.
+    // It is important that this always be done, even if we wind up
+    // not rendering anything because there are no current eye buffers.
+    SwapState state;
+    state.VsyncCount = (long long) vsyncBase;
+    state.EyeBufferCount = thisEyeBufferNum;
+    m_swapVsync.setState(state);
+
+    // Wake the VR thread up if it is blocked on us.
+    // If the other thread happened to be scheduled out right
+    // after locking the mutex, but before waiting on the condition,
+    // we would rather it sleep for another frame than potentially
+    // miss a raster point here in the time warp thread, so use
+    // a trylock() instead of a lock().
+    if (!pthread_mutex_trylock(&m_swapMutex)) {
+        pthread_cond_signal(&m_swapIsLatched);
+        pthread_mutex_unlock(&m_swapMutex);
+    }
+}
+
 static uint64_t GetNanoSecondsUint64() {
     struct timespec now;
     clock_gettime(CLOCK_MONOTONIC, &now);
@@ -1618,8 +1412,7 @@ void VFrameSmooth::Private::warpSwapInternal(const VTimeWarpParms &parms) {
     // Prepare to pass the new eye buffers to the background thread if we are running multi-threaded.
     const long long lastBufferCount = m_eyeBufferCount.state();
     warpSource_t &ws = m_warpSources[(lastBufferCount + 1) % MAX_WARP_SOURCES];
-    ws.MinimumVsync = m_lastSwapVsyncCount + 2 *
-                                             minimumVsyncs;    // don't use it if from same frame to avoid problems with very fast frames
+    ws.MinimumVsync = m_scheduler.minimumVsync(minimumVsyncs);
     ws.FirstDisplayedVsync[0] = 0;            // will be set when it becomes the currentSource
     ws.FirstDisplayedVsync[1] = 0;            // will be set when it becomes the currentSource
     ws.disableChromaticCorrection = (
@@ -1678,11 +1471,7 @@ void VFrameSmooth::Private::warpSwapInternal(const VTimeWarpParms &parms) {
         const uint64_t endSuspendNanoSeconds = GetNanoSecondsUint64();
 
         const SwapState state = m_swapVsync.state();
-        if (state.EyeBufferCount >= lastBufferCount) {
-            // If MinimumVsyncs was increased dynamically, it is necessary
-            // to skip one or more vsyncs just as the change happens.
-            m_lastSwapVsyncCount = std::max(state.VsyncCount, m_lastSwapVsyncCount + minimumVsyncs);
-
+        if (m_scheduler.latch(state, lastBufferCount, minimumVsyncs)) {
             // Sleep for at least one millisecond to make sure the main VR thread
             // cannot completely deny the Android watchdog from getting a time slice.
             const uint64_t suspendNanoSeconds = endSuspendNanoSeconds - startSuspendNanoSeconds;
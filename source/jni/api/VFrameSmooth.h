@@ -3,6 +3,7 @@
 #include "../vglobal.h"
 #include "VDevice.h"
 #include "VKernel.h"
+#include "VFrameScheduler.h"
 
 NV_NAMESPACE_BEGIN
 
@@ -22,6 +23,9 @@ public:
     void	doSmooth( const VTimeWarpParms & parms );
     int threadId() const;
 
+    //The timing of the last frames warped, readable from any thread
+    const VFrameScheduler &scheduler() const;
+
     void pause();
     void setupSurface(EGLSurface surface);
     void resume();
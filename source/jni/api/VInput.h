@@ -79,6 +79,26 @@ enum JoyEvent
     KEYCODE_RSTICK_RIGHT = 207 | BUTTON_JOYPAD_FLAG
 };
 
+// Raw input forwarded from the Java activity, posted as inline event payloads
+struct VJoyAxisInput
+{
+    float sticks[2][2];
+};
+
+struct VTouchInput
+{
+    int action;
+    float x;
+    float y;
+};
+
+struct VKeyInput
+{
+    int key;
+    bool down;
+    int repeatCount;
+};
+
 struct VInput
 {
     VInput()
@@ -2,10 +2,12 @@
 
 #include "VLensDistortion.h"
 #include "VGlGeometry.h"
+#include "VString.h"
 
 NV_NAMESPACE_BEGIN
 
 class VDevice;
+class VDistortionMesh;
 
 class VLensDistortion
 {
@@ -21,9 +23,12 @@ public:
     float               invKArray[MaxCoefficients];
     float               maxInvR;
     static VGlGeometry createDistortionGrid(const VDevice* device,const int numSlicesPerEye, const float fovScale,
-                                             const bool cursorOnly);    
+                                             const bool cursorOnly);
+    static VGlGeometry upload(const VDistortionMesh &mesh);
     static int xxGridNum;
     static int yyGridNum;
+    // Where the meshes are kept between runs, none if empty
+    static VString cacheDirectory;
 };
 
 NV_NAMESPACE_END
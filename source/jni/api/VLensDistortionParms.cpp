@@ -0,0 +1,41 @@
+#include "VLensDistortion.h"
+
+//Kept apart from the GL upload in VLensDistortion.cpp, so that VDistortionMesh builds without GL
+
+NV_NAMESPACE_BEGIN
+
+VLensDistortion::VLensDistortion()
+{
+    for ( int i = 0; i < MaxCoefficients; i++ )
+    {
+        kArray[i] = 0.0f;
+        invKArray[i] = 0.0f;
+    }
+    kArray[0] = 1.0f;
+    invKArray[0] = 1.0f;
+    maxR = 1.0f;
+    maxInvR = 1.0f;
+    chromaticAberration[0] = -0.006f;
+    chromaticAberration[1] = 0.0f;
+    chromaticAberration[2] = 0.014f;
+    chromaticAberration[3] = 0.0f;
+    centMetersPerTanAngler = 0.043875f;
+}
+
+void VLensDistortion::initDistortionParmsByMobileType()
+{
+    centMetersPerTanAngler = 0.0365f;
+    kArray[0] = 1.0f;
+    kArray[1] = 1.029f;
+    kArray[2] = 1.0565f;
+    kArray[3] = 1.088f;
+    kArray[4] = 1.127f;
+    kArray[5] = 1.175f;
+    kArray[6] = 1.232f;
+    kArray[7] = 1.298f;
+    kArray[8] = 1.375f;
+    kArray[9] = 1.464f;
+    kArray[10] = 1.570f;
+}
+
+NV_NAMESPACE_END
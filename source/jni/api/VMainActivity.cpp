@@ -8,6 +8,7 @@
 
 #include "android/JniUtils.h"
 #include "VLog.h"
+#include "VInput.h"
 
 NV_NAMESPACE_BEGIN
 
@@ -423,9 +424,13 @@ void Java_com_vrseen_VrActivity_nativeJoypadAxis(JNIEnv *, jclass, jfloat lx, jf
 {
     // Suspend input until OneTimeInit() has finished to avoid overflowing the message queue on long loads.
     if (vApp->isRunning()) {
-        VVariantArray args;
-        args << lx << ly << rx << ry;
-        vApp->eventLoop().post("joy", args);
+        static const VEventId JoyAxisEvent("joy");
+        VJoyAxisInput input;
+        input.sticks[0][0] = lx;
+        input.sticks[0][1] = ly;
+        input.sticks[1][0] = rx;
+        input.sticks[1][1] = ry;
+        vApp->eventLoop().post(JoyAxisEvent, input);
     }
 }
 
@@ -433,9 +438,12 @@ void Java_com_vrseen_VrActivity_nativeTouch(JNIEnv *, jclass, jint action, jfloa
 {
     // Suspend input until OneTimeInit() has finished to avoid overflowing the message queue on long loads.
     if (vApp->isRunning()) {
-        VVariantArray args;
-        args << action << x << y;
-        vApp->eventLoop().post("touch", args);
+        static const VEventId TouchEvent("touch");
+        VTouchInput input;
+        input.action = action;
+        input.x = x;
+        input.y = y;
+        vApp->eventLoop().post(TouchEvent, input);
     }
 }
 
@@ -443,9 +451,12 @@ void Java_com_vrseen_VrActivity_nativeKeyEvent(JNIEnv *, jclass, jint key, jbool
 {
     // Suspend input until OneTimeInit() has finished to avoid overflowing the message queue on long loads.
     if (vApp->isRunning()) {
-        VVariantArray args;
-        args << key << down << repeatCount;
-        vApp->eventLoop().post("key", args);
+        static const VEventId KeyEvent("key");
+        VKeyInput input;
+        input.key = key;
+        input.down = down;
+        input.repeatCount = repeatCount;
+        vApp->eventLoop().post(KeyEvent, input);
     }
 }
 
@@ -0,0 +1,166 @@
+#include "VRotationHistory.h"
+#include "VLockless.h"
+#include "VLocklessRing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <math.h>
+
+NV_NAMESPACE_BEGIN
+
+struct VRotationHistory::Private
+{
+    VLocklessRing<VRotationState> samples;
+    //Samples before this one were cleared
+    std::atomic<vint64> begin;
+    VLockless<Predictor> predictor;
+
+    Private(uint capacity)
+        : samples(capacity)
+        , begin(0)
+    {
+    }
+
+    vint64 first() const { return std::max(samples.first(), begin.load(std::memory_order_acquire)); }
+
+    //Between the last sample and the one the predictor's window before it
+    VVect3f acceleration(const VRotationState &last, vint64 lastIndex, const Predictor &predictor) const
+    {
+        const vint64 first = this->first();
+        VRotationState previous;
+        if (predictor.accelerationWeight == 0.0f || lastIndex <= first || !samples.at(lastIndex - 1, previous)) {
+            return VVect3f(0.0f, 0.0f, 0.0f);
+        }
+
+        //Samples come at a steady rate, the one before tells how far back to look
+        const double interval = last.timestamp - previous.timestamp;
+        if (interval > 0.0) {
+            const vint64 steps = std::max<vint64>(1, static_cast<vint64>(predictor.accelerationWindow / interval + 0.5));
+            VRotationState older;
+            if (samples.at(std::max(first, lastIndex - steps), older) && older.timestamp < last.timestamp) {
+                previous = older;
+            }
+        }
+        const double span = last.timestamp - previous.timestamp;
+        if (span <= 0.0) {
+            return VVect3f(0.0f, 0.0f, 0.0f);
+        }
+        return (last.gyro - previous.gyro) * static_cast<float>(1.0 / span);
+    }
+};
+
+VRotationHistory::VRotationHistory(uint capacity)
+    : d(new Private(capacity))
+{
+}
+
+VRotationHistory::~VRotationHistory()
+{
+    delete d;
+}
+
+VRotationHistory::Predictor VRotationHistory::predictor() const
+{
+    return d->predictor.state();
+}
+
+void VRotationHistory::setPredictor(const Predictor &predictor)
+{
+    d->predictor.setState(predictor);
+}
+
+void VRotationHistory::append(const VRotationState &state)
+{
+    d->samples.append(state);
+}
+
+void VRotationHistory::clear()
+{
+    d->begin.store(d->samples.count(), std::memory_order_release);
+}
+
+bool VRotationHistory::isEmpty() const
+{
+    return d->samples.count() <= d->first();
+}
+
+VRotationState VRotationHistory::last() const
+{
+    VRotationState state;
+    state.timestamp = 0.0;
+    if (!isEmpty()) {
+        d->samples.last(state);
+    }
+    return state;
+}
+
+VRotationState VRotationHistory::state(double timestamp) const
+{
+    VRotationState after;
+    const vint64 count = d->samples.count();
+    vint64 low = d->first();
+    vint64 high = count - 1;
+    if (high < low || !d->samples.at(high, after)) {
+        return last();
+    }
+
+    if (timestamp >= after.timestamp) {
+        const Predictor predictor = d->predictor.state();
+        return Predict(after, d->acceleration(after, high, predictor), timestamp, predictor);
+    }
+
+    //The last sample at or before timestamp. Samples the writer drops during the search are
+    //treated as older than timestamp, the search then ends on the oldest one left.
+    while (high - low > 1) {
+        const vint64 middle = low + (high - low) / 2;
+        VRotationState sample;
+        if (!d->samples.at(middle, sample) || sample.timestamp <= timestamp) {
+            low = middle;
+        } else {
+            high = middle;
+            after = sample;
+        }
+    }
+
+    VRotationState before;
+    if (!d->samples.at(low, before)) {
+        return after;
+    }
+    if (before.timestamp >= timestamp || after.timestamp <= before.timestamp) {
+        return before;
+    }
+
+    const float t = static_cast<float>((timestamp - before.timestamp) / (after.timestamp - before.timestamp));
+    VRotationState state;
+    state = before.Slerp(after, t);
+    state.gyro = before.gyro + (after.gyro - before.gyro) * t;
+    state.timestamp = timestamp;
+    return state;
+}
+
+VRotationState VRotationHistory::Predict(const VRotationState &state, const VVect3f &acceleration, double timestamp, const Predictor &predictor)
+{
+    VRotationState predicted = state;
+    predicted.timestamp = timestamp;
+    const float speed = state.gyro.length();
+    float interval = std::min(static_cast<float>(timestamp - state.timestamp), predictor.maxInterval);
+    // Choose the shorter interval for slow rotations, to improve stability
+    if (predictor.speedScale > 0.0f) {
+        interval = std::min(interval, predictor.speedScale * speed);
+    }
+    if (interval <= 0.0f) {
+        return predicted;
+    }
+
+    //The mean angular velocity over the interval, assuming a constant acceleration
+    const VVect3f change = acceleration * (predictor.accelerationWeight * interval);
+    const VVect3f velocity = state.gyro + change * 0.5f;
+    const float angle = velocity.length() * interval;
+    if (angle > 0.000001f) {
+        predicted = state * VQuatf(velocity, angle);
+    }
+    predicted.gyro = state.gyro + change;
+    return predicted;
+}
+
+NV_NAMESPACE_END
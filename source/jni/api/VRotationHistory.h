@@ -0,0 +1,63 @@
+#pragma once
+
+#include "VRotationState.h"
+
+NV_NAMESPACE_BEGIN
+
+// The recent samples of the rotation sensor, appended by the sensor thread at up to 1 kHz and
+// queried without locks by the VR and timewarp threads. States in the past are interpolated
+// between the two samples around them, states past the last sample are predicted from it.
+class VRotationHistory
+{
+public:
+    struct Predictor
+    {
+        //Never predicts further ahead than this, in seconds
+        float maxInterval;
+        //Slow rotations are predicted no further than speed * speedScale seconds, which keeps
+        //the view still when the head barely moves. 0 predicts the full interval.
+        float speedScale;
+        //Share of the angular acceleration added to the gyro reading, 0 assumes a constant
+        //angular velocity
+        float accelerationWeight;
+        //The angular acceleration is taken between the last sample and the one this many
+        //seconds before it, which smooths the noise of the gyro
+        float accelerationWindow;
+
+        Predictor()
+            : maxInterval(0.1f)
+            , speedScale(0.2f)
+            , accelerationWeight(0.5f)
+            , accelerationWindow(0.05f)
+        {
+        }
+    };
+
+    //About a second of samples at 1 kHz
+    VRotationHistory(uint capacity = 1024);
+    ~VRotationHistory();
+
+    Predictor predictor() const;
+    void setPredictor(const Predictor &predictor);
+
+    //Timestamps have to increase. Only one thread may append.
+    void append(const VRotationState &state);
+    void clear();
+
+    bool isEmpty() const;
+    VRotationState last() const;
+
+    //The orientation and angular velocity at timestamp. States before the first sample held
+    //are the first sample.
+    VRotationState state(double timestamp) const;
+
+    //Extrapolates from state, taken as the last sample, to timestamp. acceleration is the
+    //estimated angular acceleration.
+    static VRotationState Predict(const VRotationState &state, const VVect3f &acceleration, double timestamp, const Predictor &predictor);
+
+private:
+    NV_DECLARE_PRIVATE
+    NV_DISABLE_COPY(VRotationHistory)
+};
+
+NV_NAMESPACE_END
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "VRotationState.h"
+#include "VRotationHistory.h"
 
 NV_NAMESPACE_BEGIN
 
@@ -18,6 +18,9 @@ public:
 
     VRotationState predictState(double timestamp) const;
 
+    //Samples given to setState(), and how states past the last one are predicted
+    VRotationHistory &history();
+
 private:
     VRotationSensor();
 
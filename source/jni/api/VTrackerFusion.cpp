@@ -0,0 +1,379 @@
+#include "VTrackerFusion.h"
+#include "VArray.h"
+#include "VCircularQueue.h"
+#include "VLog.h"
+
+#include <math.h>
+#include <string.h>
+
+NV_NAMESPACE_BEGIN
+
+namespace {
+
+//Accelerometer and gyro of the three samples of a report
+const int RawCount = 3 * 6;
+const float RawUnit = 0.0001f;
+
+//The samples are packed as signed 21-bit integers
+inline int32_t Unpack21(int32_t value)
+{
+    return (value ^ 0x100000) - 0x100000;
+}
+
+void Unpack(const uint8_t *buffer, int32_t &x, int32_t &y, int32_t &z)
+{
+    x = Unpack21((buffer[0] << 13) | (buffer[1] << 5) | ((buffer[2] & 0xF8) >> 3));
+    y = Unpack21(((buffer[2] & 0x07) << 18) | (buffer[3] << 10) | (buffer[4] << 2) | ((buffer[5] & 0xC0) >> 6));
+    z = Unpack21(((buffer[5] & 0x3F) << 15) | (buffer[6] << 7) | (buffer[7] >> 1));
+}
+
+void Pack(int32_t x, int32_t y, int32_t z, uint8_t *buffer)
+{
+    x &= 0x1FFFFF;
+    y &= 0x1FFFFF;
+    z &= 0x1FFFFF;
+    buffer[0] = x >> 13;
+    buffer[1] = x >> 5;
+    buffer[2] = ((x & 0x1F) << 3) | (y >> 18);
+    buffer[3] = y >> 10;
+    buffer[4] = y >> 2;
+    buffer[5] = ((y & 0x03) << 6) | (z >> 15);
+    buffer[6] = z >> 7;
+    buffer[7] = (z & 0x7F) << 1;
+}
+
+inline int16_t Int16(const uint8_t *buffer)
+{
+    return (int16_t) ((buffer[1] << 8) | buffer[0]);
+}
+
+inline void SetInt16(int16_t value, uint8_t *buffer)
+{
+    buffer[0] = value & 0xFF;
+    buffer[1] = (value >> 8) & 0xFF;
+}
+
+}
+
+bool KTrackerSensorZip::Decode(const uint8_t *buffer, uint size, KTrackerSensorZip &data)
+{
+    if (size < Size) {
+        return false;
+    }
+
+    memset(&data, 0, sizeof(KTrackerSensorZip));
+    data.SampleCount = buffer[1];
+    data.Timestamp = (uint16_t) Int16(buffer + 2);
+    data.LastCommandID = (uint16_t) Int16(buffer + 4);
+    data.Temperature = Int16(buffer + 6);
+
+    const int count = data.SampleCount > 3 ? 3 : data.SampleCount;
+    for (int i = 0; i < count; i++) {
+        RawData &sample = data.Samples[i];
+        Unpack(buffer + 8 + 16 * i, sample.AccelX, sample.AccelY, sample.AccelZ);
+        Unpack(buffer + 16 + 16 * i, sample.GyroX, sample.GyroY, sample.GyroZ);
+    }
+
+    data.MagX = Int16(buffer + 56);
+    data.MagY = Int16(buffer + 58);
+    data.MagZ = Int16(buffer + 60);
+    return true;
+}
+
+void KTrackerSensorZip::encode(uint8_t *buffer) const
+{
+    memset(buffer, 0, Size);
+    buffer[1] = SampleCount;
+    SetInt16(Timestamp, buffer + 2);
+    SetInt16(LastCommandID, buffer + 4);
+    SetInt16(Temperature, buffer + 6);
+    for (int i = 0; i < 3; i++) {
+        const RawData &sample = Samples[i];
+        Pack(sample.AccelX, sample.AccelY, sample.AccelZ, buffer + 8 + 16 * i);
+        Pack(sample.GyroX, sample.GyroY, sample.GyroZ, buffer + 16 + 16 * i);
+    }
+    SetInt16(MagX, buffer + 56);
+    SetInt16(MagY, buffer + 58);
+    SetInt16(MagZ, buffer + 60);
+}
+
+struct VTrackerFusion::Private
+{
+    class Filter: public VCircularQueue<float>
+    {
+    public:
+        Filter(int capacity = 20)
+            : VCircularQueue(capacity)
+            , m_total(0.0f)
+        {
+        }
+
+        void append(float e) {
+            if (isFull()) {
+                float removed = first();
+                m_total -= removed;
+            }
+            m_total += e;
+            VCircularQueue::append(e);
+        }
+
+        float total() const { return m_total; }
+
+        float mean() const { return VCircularQueue::isEmpty() ? 0.0f : (total() / (float) size()); }
+
+    private:
+        float m_total;
+    };
+
+    VRotationState state;
+    bool first;
+    int step;
+    vint64 sampleCount;
+    double firstRealTimeDelta;
+    vuint16 lastTimestamp;
+    vuint32 fullTimestamp;
+    vuint8 lastSampleCount;
+    VVect3f lastAcceleration;
+    VVect3f lastRotationRate;
+    VVect3f gyroOffset;
+    Filter tiltFilter;
+    //Samples converted by processBatch()
+    VArray<float> converted;
+
+    Private()
+        : first(true)
+        , step(0)
+        , sampleCount(0)
+        , firstRealTimeDelta(0.0)
+        , lastTimestamp(0)
+        , fullTimestamp(0)
+        , lastSampleCount(0)
+        , gyroOffset(0.0f, 0.0f, 0.0f)
+    {
+        state.w = 1.0f;
+        state.x = state.y = state.z = 0.0f;
+        state.gyro = VVect3f(0.0f, 0.0f, 0.0f);
+        state.timestamp = 0.0;
+    }
+
+    static void Convert(const KTrackerSensorZip &data, float *samples)
+    {
+        const int32_t *raw = &data.Samples[0].AccelX;
+        for (int i = 0; i < RawCount; i++) {
+            samples[i] = raw[i] * RawUnit;
+        }
+    }
+
+    //samples holds the RawCount values of data, converted
+    void process(const KTrackerSensorZip &data, const float *samples, double now);
+    void updateQ(KTrackerMessage *msg);
+    VVect3f gyrocorrect(const VVect3f &gyro, const VVect3f &accel, const float DeltaT);
+};
+
+void VTrackerFusion::Private::process(const KTrackerSensorZip &data, const float *samples, double now)
+{
+    const float timeUnit = (1.0f / 1000.f);
+
+    if (first) {
+        lastAcceleration = VVect3f(0, 0, 0);
+        lastRotationRate = VVect3f(0, 0, 0);
+        first = false;
+
+        // This is our baseline sensor to host time delta,
+        // it will be adjusted with each new message.
+        fullTimestamp = data.Timestamp;
+        firstRealTimeDelta = now - (fullTimestamp * timeUnit);
+    } else {
+        uint timestampDelta;
+
+        if (data.Timestamp < lastTimestamp) {
+            // The timestamp rolled around the 16 bit counter, so FullTimeStamp
+            // needs a high word increment.
+            fullTimestamp += 0x10000;
+            timestampDelta = ((((int) data.Timestamp) + 0x10000)
+                    - (int) lastTimestamp);
+        } else {
+            timestampDelta = (data.Timestamp - lastTimestamp);
+        }
+        // Update the low word of FullTimeStamp
+        fullTimestamp = (fullTimestamp & ~0xffff) | data.Timestamp;
+
+        // If this timestamp, adjusted by our best known delta, would
+        // have the message arriving in the future, we need to adjust
+        // the delta down.
+        if (fullTimestamp * timeUnit + firstRealTimeDelta > now) {
+            firstRealTimeDelta = now - (fullTimestamp * timeUnit);
+        } else {
+            // Creep the delta by 100 microseconds so we are always pushing
+            // it slightly towards the high clamping case, instead of having to
+            // worry about clock drift in both directions.
+            firstRealTimeDelta += 0.0001;
+        }
+
+        // If we missed a small number of samples, replicate the last sample.
+        if ((timestampDelta > lastSampleCount) && (timestampDelta <= 254)) {
+            KTrackerMessage sensors;
+            sensors.TimeDelta = (timestampDelta - lastSampleCount)
+                    * timeUnit;
+            sensors.Acceleration = lastAcceleration;
+            sensors.RotationRate = lastRotationRate;
+
+            updateQ(&sensors);
+            sampleCount += timestampDelta - lastSampleCount;
+        }
+    }
+
+    KTrackerMessage sensors;
+    int iterations = data.SampleCount;
+
+    if (data.SampleCount > 3) {
+        iterations = 3;
+        sensors.TimeDelta = (data.SampleCount - 2) * timeUnit;
+    } else {
+        sensors.TimeDelta = timeUnit;
+    }
+
+    for (int i = 0; i < iterations; ++i) {
+        const float *sample = samples + 6 * i;
+        sensors.Acceleration = VVect3f(sample[0], sample[1], sample[2]);
+        sensors.RotationRate = VVect3f(sample[3], sample[4], sample[5]);
+
+        updateQ(&sensors);
+
+        // TimeDelta for the last two sample is always fixed.
+        sensors.TimeDelta = timeUnit;
+    }
+
+    sampleCount += data.SampleCount;
+    lastSampleCount = data.SampleCount;
+    lastTimestamp = data.Timestamp;
+    if (iterations > 0) {
+        lastAcceleration = sensors.Acceleration;
+        lastRotationRate = sensors.RotationRate;
+    }
+    state.timestamp = now;
+}
+
+void VTrackerFusion::Private::updateQ(KTrackerMessage *msg)
+{
+    // Put the sensor readings into convenient local variables
+    VVect3f gyro = msg->RotationRate;
+    VVect3f accel = msg->Acceleration;
+    const float DeltaT = msg->TimeDelta;
+    state.gyro = gyrocorrect(gyro, accel, DeltaT);
+
+    // Update the orientation quaternion based on the corrected angular velocity vector
+    float gyro_length = state.gyro.length();
+    if (gyro_length != 0.0f) {
+        float angle = gyro_length * DeltaT;
+        VQuatf q = state * VQuatf(state.gyro.normalized() * sin(angle * 0.5f), angle);
+        state.w = q.w;
+        state.x = q.x;
+        state.y = q.y;
+        state.z = q.z;
+    }
+
+    step++;
+
+    // Normalize error
+    if (step % 500 == 0) {
+        state.Normalize();
+    }
+}
+
+VVect3f VTrackerFusion::Private::gyrocorrect(const VVect3f &gyro, const VVect3f &accel, const float DeltaT)
+{
+    // Small preprocessing
+    VQuatf Qinv = state.Inverted();
+    VVect3f up = Qinv.Rotate(VVect3f(0, 1, 0));
+    VVect3f gyroCorrected = gyro;
+
+    bool EnableGravity = true;
+    bool valid_accel = accel.length() > 0.001f;
+
+    if (EnableGravity && valid_accel) {
+        gyroCorrected -= gyroOffset;
+
+        const float spikeThreshold = 0.01f;
+        const float gravityThreshold = 0.1f;
+        float proportionalGain = 0.25f, integralGain = 0.0f;
+
+        VVect3f accel_normalize = accel.normalized();
+        VVect3f up_normalize = up.normalized();
+        VVect3f correction = accel_normalize.crossProduct(up_normalize);
+        float cosError = accel_normalize.dotProduct(up_normalize);
+        const float Tolerance = 0.00001f;
+        VVect3f tiltCorrection = correction * sqrtf(2.0f / (1 + cosError + Tolerance));
+
+        if (step > 5) {
+            // Spike detection
+            float tiltAngle = up.angleTo(accel);
+            tiltFilter.append(tiltAngle);
+            if (tiltAngle > tiltFilter.mean() + spikeThreshold)
+                proportionalGain = integralGain = 0;
+            // Acceleration detection
+            const float gravity = 9.8f;
+            if (fabs(accel.length() / gravity - 1) > gravityThreshold)
+                integralGain = 0;
+        } else {
+            // Apply full correction at the startup
+            proportionalGain = 1 / DeltaT;
+            integralGain = 0;
+        }
+
+        gyroCorrected += (tiltCorrection * proportionalGain);
+        gyroOffset -= (tiltCorrection * integralGain * DeltaT);
+    } else {
+        vInfo("invalidaccel");
+    }
+
+    return gyroCorrected;
+}
+
+VTrackerFusion::VTrackerFusion()
+    : d(new Private)
+{
+}
+
+VTrackerFusion::~VTrackerFusion()
+{
+    delete d;
+}
+
+void VTrackerFusion::reset()
+{
+    delete d;
+    d = new Private;
+}
+
+void VTrackerFusion::process(const KTrackerSensorZip &data, double now)
+{
+    float samples[RawCount];
+    Private::Convert(data, samples);
+    d->process(data, samples, now);
+}
+
+void VTrackerFusion::processBatch(const KTrackerSensorZip *data, const double *now, uint count)
+{
+    //The raw samples of each report follow each other in memory, so do the converted ones
+    VArray<float> &converted = d->converted;
+    converted.resize(count * RawCount);
+    for (uint i = 0; i < count; i++) {
+        Private::Convert(data[i], converted.data() + i * RawCount);
+    }
+    for (uint i = 0; i < count; i++) {
+        d->process(data[i], converted.data() + i * RawCount, now[i]);
+    }
+}
+
+const VRotationState &VTrackerFusion::state() const
+{
+    return d->state;
+}
+
+vint64 VTrackerFusion::sampleCount() const
+{
+    return d->sampleCount;
+}
+
+NV_NAMESPACE_END
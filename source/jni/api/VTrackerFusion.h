@@ -0,0 +1,70 @@
+#pragma once
+
+#include "VRotationState.h"
+
+NV_NAMESPACE_BEGIN
+
+//A report of the tracker on /dev/ovr0: up to three samples of the accelerometer and gyro, in
+//units of 0.0001 m/s² and 0.0001 rad/s, and the magnetometer
+struct KTrackerSensorZip {
+    //Bytes of a report decoded
+    enum { Size = 62 };
+
+    uint8_t SampleCount;
+    uint16_t Timestamp;
+    uint16_t LastCommandID;
+    int16_t Temperature;
+
+    struct RawData {
+        int32_t AccelX, AccelY, AccelZ;
+        int32_t GyroX, GyroY, GyroZ;
+    };
+    RawData Samples[3];
+
+    int16_t MagX, MagY, MagZ;
+
+    //False if the buffer is too short
+    static bool Decode(const uint8_t *buffer, uint size, KTrackerSensorZip &data);
+    //The inverse of Decode(), into Size bytes, for recording traces
+    void encode(uint8_t *buffer) const;
+};
+
+struct KTrackerMessage {
+    VVect3f Acceleration;
+    VVect3f RotationRate;
+    VVect3f MagneticField;
+    float Temperature;
+    float TimeDelta;
+    double AbsoluteTimeSeconds;
+};
+
+// Integrates the orientation from the reports of the tracker, correcting the gyro with the
+// gravity the accelerometer measures. It depends on nothing but the reports and the time they
+// arrived, so traces recorded on the device can be replayed anywhere.
+class VTrackerFusion
+{
+public:
+    VTrackerFusion();
+    ~VTrackerFusion();
+
+    void reset();
+
+    //now is the time data arrived, in seconds of the monotonic clock
+    void process(const KTrackerSensorZip &data, double now);
+
+    //The same as calling process() for each report, converting all the samples first in loops
+    //the compiler vectorizes
+    void processBatch(const KTrackerSensorZip *data, const double *now, uint count);
+
+    //The state after the last sample processed, stamped with the time it arrived
+    const VRotationState &state() const;
+
+    //Samples the tracker took since the first report, including the ones of missed reports
+    vint64 sampleCount() const;
+
+private:
+    NV_DECLARE_PRIVATE
+    NV_DISABLE_COPY(VTrackerFusion)
+};
+
+NV_NAMESPACE_END
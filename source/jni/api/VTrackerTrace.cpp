@@ -0,0 +1,92 @@
+#include "VTrackerTrace.h"
+#include "VBinaryStream.h"
+#include "VLog.h"
+
+#include <string.h>
+
+NV_NAMESPACE_BEGIN
+
+namespace {
+const char Magic[4] = {'V', 'T', 'R', 'K'};
+const uint Version = 1;
+}
+
+struct VTrackerTrace::Private
+{
+    VBinaryStream stream;
+    uint flags;
+
+    Private(VIODevice *device)
+        : stream(device)
+        , flags(0)
+    {
+        stream.setByteOrder(VBinaryStream::LittleEndian);
+    }
+};
+
+VTrackerTrace::VTrackerTrace(VIODevice *device)
+    : d(new Private(device))
+{
+}
+
+VTrackerTrace::~VTrackerTrace()
+{
+    delete d;
+}
+
+uint VTrackerTrace::flags() const
+{
+    return d->flags;
+}
+
+bool VTrackerTrace::writeHeader(uint flags)
+{
+    d->flags = flags;
+    d->stream.writeRawData(Magic, sizeof(Magic));
+    d->stream << Version << flags;
+    return d->stream.status() == VBinaryStream::Ok;
+}
+
+bool VTrackerTrace::readHeader()
+{
+    char magic[sizeof(Magic)];
+    uint version = 0;
+    if (!d->stream.readRawData(magic, sizeof(magic)) || memcmp(magic, Magic, sizeof(Magic)) != 0) {
+        vWarn("VTrackerTrace: not a trace");
+        return false;
+    }
+    d->stream >> version >> d->flags;
+    if (d->stream.status() != VBinaryStream::Ok || version != Version) {
+        vWarn("VTrackerTrace: unsupported version" << version);
+        return false;
+    }
+    return true;
+}
+
+bool VTrackerTrace::write(const Record &record)
+{
+    d->stream << record.time;
+    d->stream.writeRawData(reinterpret_cast<const char *>(record.packet), sizeof(record.packet));
+    if (d->flags & HasTruth) {
+        d->stream.writeArray(record.truth, 4);
+    }
+    return d->stream.status() == VBinaryStream::Ok;
+}
+
+bool VTrackerTrace::read(Record &record)
+{
+    if (d->stream.atEnd()) {
+        return false;
+    }
+    d->stream >> record.time;
+    d->stream.readRawData(reinterpret_cast<char *>(record.packet), sizeof(record.packet));
+    if (d->flags & HasTruth) {
+        d->stream.readArray(record.truth, 4);
+    } else {
+        record.truth[0] = 1.0f;
+        record.truth[1] = record.truth[2] = record.truth[3] = 0.0f;
+    }
+    return d->stream.status() == VBinaryStream::Ok;
+}
+
+NV_NAMESPACE_END
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "VTrackerFusion.h"
+
+NV_NAMESPACE_BEGIN
+
+class VIODevice;
+
+// Reports of the tracker as they arrived, to replay them off the device. A trace starts with
+// "VTRK", a version and flags, followed by one record per report, in little endian.
+class VTrackerTrace
+{
+public:
+    enum Flag
+    {
+        //Records carry the actual orientation, as synthetic traces and recordings next to an
+        //optical tracker do
+        HasTruth = 0x1
+    };
+
+    struct Record
+    {
+        //Seconds of the monotonic clock the report arrived at
+        double time;
+        uint8_t packet[KTrackerSensorZip::Size];
+        //w, x, y, z
+        float truth[4];
+    };
+
+    VTrackerTrace(VIODevice *device);
+    ~VTrackerTrace();
+
+    uint flags() const;
+
+    bool writeHeader(uint flags);
+    //False if the device doesn't hold a trace
+    bool readHeader();
+
+    bool write(const Record &record);
+    //False at the end of the trace
+    bool read(Record &record);
+
+private:
+    NV_DECLARE_PRIVATE
+    NV_DISABLE_COPY(VTrackerTrace)
+};
+
+NV_NAMESPACE_END
@@ -2,7 +2,9 @@
 
 #include "vglobal.h"
 
+#include <ostream>
 #include <string>
+#include <string.h>
 
 NV_NAMESPACE_BEGIN
 
@@ -26,4 +28,56 @@ public:
     bool isEmpty() const { return empty(); }
 };
 
+// Refers to bytes owned by someone else, usually UTF-8 text, without copying them. The bytes
+// must outlive the view and are not necessarily null-terminated.
+class VByteArrayView
+{
+public:
+    VByteArrayView() : m_data(""), m_size(0) {}
+    VByteArrayView(const char *str) : m_data(str), m_size(strlen(str)) {}
+    VByteArrayView(const char *data, uint size) : m_data(data), m_size(size) {}
+    VByteArrayView(const std::string &str) : m_data(str.data()), m_size(str.size()) {}
+
+    const char *data() const { return m_data; }
+    uint size() const { return m_size; }
+    int length() const { return (int) m_size; }
+    bool isEmpty() const { return m_size == 0; }
+
+    char operator [] (uint i) const { return m_data[i]; }
+    char first() const { return m_data[0]; }
+    char last() const { return m_data[m_size - 1]; }
+
+    VByteArrayView mid(uint from, uint length = 0) const { return VByteArrayView(m_data + from, length ? length : m_size - from); }
+    VByteArrayView left(uint count) const { return VByteArrayView(m_data, count); }
+    VByteArrayView right(uint count) const { return VByteArrayView(m_data + m_size - count, count); }
+
+    bool startsWith(const VByteArrayView &prefix) const { return m_size >= prefix.m_size && memcmp(m_data, prefix.m_data, prefix.m_size) == 0; }
+    bool endsWith(const VByteArrayView &postfix) const { return m_size >= postfix.m_size && memcmp(m_data + m_size - postfix.m_size, postfix.m_data, postfix.m_size) == 0; }
+
+    // Returns -1 if ch isn't found
+    int lastIndexOf(char ch) const
+    {
+        for (int i = length() - 1; i >= 0; i--) {
+            if (m_data[i] == ch) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    VByteArray toByteArray() const { return VByteArray(m_data, m_size); }
+
+    friend bool operator == (const VByteArrayView &view1, const VByteArrayView &view2)
+    {
+        return view1.m_size == view2.m_size && memcmp(view1.m_data, view2.m_data, view1.m_size) == 0;
+    }
+    friend bool operator != (const VByteArrayView &view1, const VByteArrayView &view2) { return !(view1 == view2); }
+
+    friend std::ostream &operator << (std::ostream &out, const VByteArrayView &view) { return out.write(view.m_data, view.m_size); }
+
+private:
+    const char *m_data;
+    uint m_size;
+};
+
 NV_NAMESPACE_END
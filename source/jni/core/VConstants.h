@@ -118,4 +118,8 @@ T VRadToDegree(T rads) { return rads * VConstants<T>::VRTD; }
 template<class T>
 T VDegreeToRad(T rads) { return rads * VConstants<T>::VDTR; }
 
+// acos clamped to its domain, for cosines rounding errors push slightly past 1
+template<class T>
+T VArccos(T value) { return value > T(1) ? T(0) : (value < T(-1) ? VConstants<T>::Pi : acos(value)); }
+
 NV_NAMESPACE_END
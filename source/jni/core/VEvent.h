@@ -1,28 +1,82 @@
 #pragma once
 
+#include "VEventId.h"
+#include "VLog.h"
 #include "VString.h"
 #include "VVariant.h"
 
+#include <string.h>
+
 NV_NAMESPACE_BEGIN
 
 struct VEvent
 {
+    // Size of the inline payload. Payloads are copied into the event itself, so
+    // posting them doesn't box anything into a VVariant.
+    static const uint PayloadCapacity = 32;
+
     VEvent()
+        : payloadSize(0)
     {
     }
 
     VEvent(const VString &name)
-        : name(name)
+        : id(VEventId::Find(name))
+        , name(name)
+        , payloadSize(0)
+    {
+    }
+
+    VEvent(const char *name)
+        : id(VEventId::Find(name))
+        , name(name)
+        , payloadSize(0)
     {
     }
 
-    bool isValid() const { return !name.isEmpty() || isExecutable(); }
+    // Events created from an id carry no name string, use id.name() if it's needed.
+    VEvent(const VEventId &id)
+        : id(id)
+        , payloadSize(0)
+    {
+    }
+
+    template<typename T>
+    VEvent(const VEventId &id, const T &payload)
+        : id(id)
+    {
+        setPayload(payload);
+    }
+
+    bool isValid() const { return id.isValid() || !name.isEmpty() || isExecutable(); }
 
     bool isExecutable() const { return data.isClosure(); }
     void execute() const { data.execute(); }
 
+    bool hasPayload() const { return payloadSize > 0; }
+
+    template<typename T>
+    void setPayload(const T &value)
+    {
+        static_assert(sizeof(T) <= PayloadCapacity, "The payload doesn't fit in a VEvent");
+        static_assert(__has_trivial_copy(T), "The payload must be trivially copyable");
+        memcpy(payloadData, &value, sizeof(T));
+        payloadSize = sizeof(T);
+    }
+
+    template<typename T>
+    const T &payload() const
+    {
+        vAssert(payloadSize == sizeof(T));
+        return *reinterpret_cast<const T *>(payloadData);
+    }
+
+    VEventId id;
     VString name;
     VVariant data;
+
+    uint payloadSize;
+    alignas(8) uchar payloadData[PayloadCapacity];
 };
 
 NV_NAMESPACE_END
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "VArray.h"
+#include "VEvent.h"
+
+#include <functional>
+
+NV_NAMESPACE_BEGIN
+
+// Maps event ids to handlers with a single array lookup.
+class VEventDispatcher
+{
+public:
+    typedef std::function<void(const VEvent &)> Handler;
+
+    void bind(const VEventId &id, const Handler &handler)
+    {
+        vAssert(id.isValid());
+        if (id.value() >= m_handlers.size()) {
+            m_handlers.resize(id.value() + 1);
+        }
+        m_handlers[id.value()] = handler;
+    }
+
+    void unbind(const VEventId &id)
+    {
+        if (id.value() < m_handlers.size()) {
+            m_handlers[id.value()] = nullptr;
+        }
+    }
+
+    bool contains(const VEventId &id) const
+    {
+        return id.value() < m_handlers.size() && m_handlers[id.value()];
+    }
+
+    // Returns false if no handler is bound to the event
+    bool dispatch(const VEvent &event) const
+    {
+        const uint id = event.id.value();
+        if (id == 0 || id >= m_handlers.size() || !m_handlers[id]) {
+            return false;
+        }
+        m_handlers[id](event);
+        return true;
+    }
+
+private:
+    VArray<Handler> m_handlers;
+};
+
+NV_NAMESPACE_END
@@ -0,0 +1,150 @@
+#include "VEventId.h"
+#include "VLog.h"
+#include "VMutex.h"
+
+#include <atomic>
+
+NV_NAMESPACE_BEGIN
+
+namespace {
+
+// FNV-1a over code units, so a Latin-1 string and its UTF-16 copy share a hash
+template<typename C>
+uint HashOf(const C *str, uint length)
+{
+    uint hash = 2166136261u;
+    for (uint i = 0; i < length; i++) {
+        hash ^= static_cast<uint>(str[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+struct Registry
+{
+    static const uint Capacity = 1024;
+    static const uint TableSize = Capacity * 2;
+
+    struct Entry
+    {
+        uint hash;
+        VString name;
+    };
+
+    Registry()
+        : count(0)
+    {
+        for (std::atomic<uint> &slot : table) {
+            slot.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Lookups don't lock. An entry is fully written before its id is published in the table.
+    template<typename S>
+    uint find(const S &name, uint hash) const
+    {
+        for (uint i = 0; i < TableSize; i++) {
+            const uint id = table[(hash + i) & (TableSize - 1)].load(std::memory_order_acquire);
+            if (id == 0) {
+                break;
+            }
+            const Entry &entry = entries[id - 1];
+            if (entry.hash == hash && entry.name == name) {
+                return id;
+            }
+        }
+        return 0;
+    }
+
+    template<typename S>
+    uint insert(const S &name, uint hash)
+    {
+        uint id = find(name, hash);
+        if (id) {
+            return id;
+        }
+
+        VMutex::Locker locker(&mutex);
+        id = find(name, hash);
+        if (id) {
+            return id;
+        }
+
+        const uint index = count.load(std::memory_order_relaxed);
+        if (index >= Capacity) {
+            vError("VEventId: too many event names, failed to register" << name);
+            return 0;
+        }
+        entries[index].hash = hash;
+        entries[index].name = name;
+        id = index + 1;
+        count.store(id, std::memory_order_release);
+
+        uint slot = hash & (TableSize - 1);
+        while (table[slot].load(std::memory_order_relaxed) != 0) {
+            slot = (slot + 1) & (TableSize - 1);
+        }
+        table[slot].store(id, std::memory_order_release);
+        return id;
+    }
+
+    Entry entries[Capacity];
+    std::atomic<uint> table[TableSize];
+    std::atomic<uint> count;
+    VMutex mutex;
+};
+
+Registry &TheRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+}
+
+VEventId::VEventId(const char *name)
+    : m_id(TheRegistry().insert(name, Hash(name)))
+{
+}
+
+VEventId::VEventId(const VString &name)
+    : m_id(TheRegistry().insert(name, Hash(name)))
+{
+}
+
+VEventId VEventId::Find(const char *name)
+{
+    VEventId id;
+    id.m_id = TheRegistry().find(name, Hash(name));
+    return id;
+}
+
+VEventId VEventId::Find(const VString &name)
+{
+    VEventId id;
+    id.m_id = TheRegistry().find(name, Hash(name));
+    return id;
+}
+
+uint VEventId::Hash(const char *name)
+{
+    return HashOf(reinterpret_cast<const uchar *>(name), strlen(name));
+}
+
+uint VEventId::Hash(const VString &name)
+{
+    return HashOf(name.data(), name.length());
+}
+
+uint VEventId::hash() const
+{
+    return m_id ? TheRegistry().entries[m_id - 1].hash : 0;
+}
+
+const VString &VEventId::name() const
+{
+    static const VString EmptyName;
+    return m_id ? TheRegistry().entries[m_id - 1].name : EmptyName;
+}
+
+NV_NAMESPACE_END
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "VString.h"
+
+NV_NAMESPACE_BEGIN
+
+// An interned event name. Names are registered once and then compared and dispatched as
+// 32-bit ids, so the per-event path never builds or compares strings.
+class VEventId
+{
+public:
+    VEventId() : m_id(0) {}
+
+    // Registers the name if it's new
+    explicit VEventId(const char *name);
+    explicit VEventId(const VString &name);
+
+    // Returns an invalid id if the name has never been registered
+    static VEventId Find(const char *name);
+    static VEventId Find(const VString &name);
+
+    static uint Hash(const char *name);
+    static uint Hash(const VString &name);
+
+    bool isValid() const { return m_id != 0; }
+    uint value() const { return m_id; }
+
+    uint hash() const;
+    const VString &name() const;
+
+    bool operator == (const VEventId &id) const { return m_id == id.m_id; }
+    bool operator != (const VEventId &id) const { return m_id != id.m_id; }
+
+private:
+    uint m_id;
+};
+
+NV_NAMESPACE_END
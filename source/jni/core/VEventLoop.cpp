@@ -1,24 +1,63 @@
 #include "VEventLoop.h"
 
 #include <VLog.h>
-#include <VMutex.h>
 #include <VSemaphore.h>
 
+#include <atomic>
+
+#include <pthread.h>
+
 NV_NAMESPACE_BEGIN
 
+namespace {
+
+// A sender blocks until its event is handled, so a thread has one send in flight at most and
+// waits on a semaphore of its own, created on its first send and kept until the thread exits.
+// Concurrent senders can't steal each other's wakeups.
+pthread_key_t CreateCompletionKey()
+{
+    pthread_key_t key;
+    pthread_key_create(&key, [](void *completion) { delete static_cast<VSemaphore *>(completion); });
+    return key;
+}
+
+VSemaphore *ThreadCompletion()
+{
+    static pthread_key_t key = CreateCompletionKey();
+    VSemaphore *completion = static_cast<VSemaphore *>(pthread_getspecific(key));
+    if (completion == nullptr) {
+        completion = new VSemaphore;
+        pthread_setspecific(key, completion);
+    }
+    return completion;
+}
+
+}
+
 struct VEventLoop::Private
 {
+    // A bounded lock-free ring. Every slot carries a sequence number, so producers only
+    // contend on the tail counter and the event thread never takes a lock.
+    struct Node
+    {
+        std::atomic<uint> sequence;
+        VEvent event;
+        VSemaphore *completion;
+    };
+
     Private(int capacity)
         : shutdown(false)
-        , capacity(capacity)
-        , messages(new Node[capacity])
+        , capacity(RoundUpCapacity(capacity))
+        , mask(this->capacity - 1)
+        , messages(new Node[this->capacity])
         , head(0)
         , tail(0)
     {
         vAssert(capacity > 0);
 
-        for (int i = 0; i < capacity; i++) {
-            messages[i].sychronized = false;
+        for (uint i = 0; i < this->capacity; i++) {
+            messages[i].sequence.store(i, std::memory_order_relaxed);
+            messages[i].completion = nullptr;
         }
     }
 
@@ -27,72 +66,96 @@ struct VEventLoop::Private
         delete[] messages;
     }
 
-    bool shutdown;
-    const int capacity;
-
-    struct Node
+    // The sequence scheme needs at least two slots and a power-of-two size to survive wrapping.
+    static uint RoundUpCapacity(int capacity)
     {
-        VEvent event;
-        bool sychronized;
-    };
+        uint result = 2;
+        while (result < static_cast<uint>(capacity)) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    std::atomic<bool> shutdown;
+    const uint capacity;
+    const uint mask;
 
     Node *messages;
 
-    volatile int head;
-    volatile int tail;
-    VMutex mutex;
+    std::atomic<uint> head;
+    std::atomic<uint> tail;
     VSemaphore posted;
-    VSemaphore received;
 
-    bool post(const VEvent &event, bool synchronized)
+    bool post(VEvent &&event, bool synchronized)
     {
-        if (shutdown) {
+        if (shutdown.load(std::memory_order_relaxed)) {
             return false;
         }
 
-        mutex.lock();
-        if (tail - head >= capacity) {
-            mutex.unlock();
-            return false;
+        Node *node;
+        uint pos = tail.load(std::memory_order_relaxed);
+        forever {
+            node = &messages[pos & mask];
+            const uint sequence = node->sequence.load(std::memory_order_acquire);
+            const int diff = static_cast<int>(sequence - pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
         }
-        const int index = tail % capacity;
-        messages[index].event = event;
-        messages[index].sychronized = synchronized;
-        tail++;
-        mutex.lock();
+
+        VSemaphore *completion = synchronized ? ThreadCompletion() : nullptr;
+        node->event = std::move(event);
+        node->completion = completion;
+        node->sequence.store(pos + 1, std::memory_order_release);
 
         posted.post();
-        if (synchronized) {
-            received.wait();
+        if (completion) {
+            completion->wait();
         }
 
         return true;
     }
 
-    bool post(VEvent &&event, bool synchronized)
+    // Consumers claim slots through the head counter, so clear() may run on another thread
+    // while the event thread is draining.
+    bool take(VEvent &event, VSemaphore *&completion)
     {
-        if (shutdown) {
-            return false;
-        }
-
-        mutex.lock();
-        if (tail - head >= capacity) {
-            mutex.unlock();
-            return false;
-        }
-        const int index = tail % capacity;
-        messages[index].event = std::move(event);
-        messages[index].sychronized = synchronized;
-        tail++;
-        mutex.unlock();
-
-        posted.post();
-        if (synchronized) {
-            received.wait();
+        Node *node;
+        uint pos = head.load(std::memory_order_relaxed);
+        forever {
+            node = &messages[pos & mask];
+            const uint sequence = node->sequence.load(std::memory_order_acquire);
+            const int diff = static_cast<int>(sequence - (pos + 1));
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
         }
 
+        event = std::move(node->event);
+        completion = node->completion;
+        node->completion = nullptr;
+        node->sequence.store(pos + capacity, std::memory_order_release);
         return true;
     }
+
+    bool isEmpty() const
+    {
+        const uint pos = head.load(std::memory_order_relaxed);
+        const Node *node = &messages[pos & mask];
+        return static_cast<int>(node->sequence.load(std::memory_order_acquire) - (pos + 1)) < 0;
+    }
 };
 
 VEventLoop::VEventLoop(int capacity)
@@ -110,116 +173,134 @@ void VEventLoop::quit()
     d->shutdown = true;
 }
 
-void VEventLoop::post(const VEvent &event)
+bool VEventLoop::post(const VEvent &event)
 {
-    d->post(event, false);
+    return d->post(VEvent(event), false);
 }
 
-void VEventLoop::post(VEvent &&event)
+bool VEventLoop::post(VEvent &&event)
 {
-    d->post(std::move(event), false);
+    return d->post(std::move(event), false);
 }
 
-void VEventLoop::post(const VString &command, const VVariant &data)
+bool VEventLoop::post(const VString &command, const VVariant &data)
 {
     VEvent event(command);
     event.data = data;
-    d->post(std::move(event), false);
+    return d->post(std::move(event), false);
 }
 
-void VEventLoop::post(const VString &command, VVariant &&data)
+bool VEventLoop::post(const VString &command, VVariant &&data)
 {
     VEvent event(command);
     event.data = std::move(data);
-    d->post(std::move(event), false);
+    return d->post(std::move(event), false);
 }
 
-void VEventLoop::post(const char *command)
+bool VEventLoop::post(const char *command)
 {
     VEvent event(command);
-    d->post(std::move(event), false);
+    return d->post(std::move(event), false);
 }
 
-void VEventLoop::post(const VVariant::Function &func)
+bool VEventLoop::post(const VVariant::Function &func)
 {
     VEvent event;
     event.data = func;
-    d->post(std::move(event), false);
+    return d->post(std::move(event), false);
 }
 
-void VEventLoop::send(const VEvent &event)
+bool VEventLoop::post(const VEventId &id)
 {
-    d->post(event, true);
+    return d->post(VEvent(id), false);
 }
 
-void VEventLoop::send(VEvent &&event)
+bool VEventLoop::send(const VEvent &event)
 {
-    d->post(std::move(event), true);
+    return d->post(VEvent(event), true);
 }
 
-void VEventLoop::send(const VString &command, const VVariant &data)
+bool VEventLoop::send(VEvent &&event)
+{
+    return d->post(std::move(event), true);
+}
+
+bool VEventLoop::send(const VString &command, const VVariant &data)
 {
     VEvent event(command);
     event.data = data;
-    d->post(std::move(event), true);
+    return d->post(std::move(event), true);
 }
 
-void VEventLoop::send(const VString &command, VVariant &&data)
+bool VEventLoop::send(const VString &command, VVariant &&data)
 {
     VEvent event(command);
     event.data = std::move(data);
-    d->post(std::move(event), true);
+    return d->post(std::move(event), true);
 }
 
-void VEventLoop::send(const char *command)
+bool VEventLoop::send(const char *command)
 {
     VEvent event(command);
-    d->post(std::move(event), true);
+    return d->post(std::move(event), true);
 }
 
-void VEventLoop::send(const VVariant::Function &func)
+bool VEventLoop::send(const VVariant::Function &func)
 {
     VEvent event;
     event.data = func;
-    d->post(std::move(event), true);
+    return d->post(std::move(event), true);
+}
+
+bool VEventLoop::send(const VEventId &id)
+{
+    return d->post(VEvent(id), true);
 }
 
 VEvent VEventLoop::next()
 {
-    d->mutex.lock();
-    if (d->tail <= d->head) {
-        d->mutex.unlock();
-        return VEvent();
+    VEvent event;
+    VSemaphore *completion;
+    if (d->take(event, completion) && completion) {
+        completion->post();
     }
+    return event;
+}
 
-    const int index = d->head % d->capacity;
-    VEvent event = std::move(d->messages[index].event);
-    if (d->messages[index].sychronized) {
-        d->received.post();
+int VEventLoop::drain(const Handler &handler, int maxEvents)
+{
+    int count = 0;
+    VEvent event;
+    VSemaphore *completion;
+    while ((maxEvents < 0 || count < maxEvents) && d->take(event, completion)) {
+        handler(event);
+        if (completion) {
+            completion->post();
+        }
+        count++;
     }
-    d->messages[index].sychronized = false;
-    d->head++;
-    d->mutex.unlock();
-
-    return event;
+    return count;
 }
 
 // Returns immediately if there is already a message in the queue.
 void VEventLoop::wait()
 {
-    d->mutex.lock();
-    if (d->tail > d->head) {
-        d->mutex.unlock();
+    if (!d->isEmpty()) {
         return;
     }
-    d->mutex.unlock();
 
     d->posted.wait();
 }
 
 void VEventLoop::clear()
 {
-    d->head = d->tail;
+    VEvent event;
+    VSemaphore *completion;
+    while (d->take(event, completion)) {
+        if (completion) {
+            completion->post();
+        }
+    }
 }
 
 NV_NAMESPACE_END
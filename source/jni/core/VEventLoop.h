@@ -2,6 +2,8 @@
 
 #include "VEvent.h"
 
+#include <functional>
+
 NV_NAMESPACE_BEGIN
 
 class VEventLoop
@@ -12,27 +14,40 @@ public:
 
     void quit();
 
-    //Send out an event
-    void post(const VEvent &event);
-    void post(VEvent &&event);
-    void post(const VString &command, const VVariant &data);
-    void post(const VString &command, VVariant &&data);
-    void post(const char *command);
-    void post(const VVariant::Function &func);
+    //Send out an event. Returns false if the queue is full or has quit.
+    bool post(const VEvent &event);
+    bool post(VEvent &&event);
+    bool post(const VString &command, const VVariant &data);
+    bool post(const VString &command, VVariant &&data);
+    bool post(const char *command);
+    bool post(const VVariant::Function &func);
+    bool post(const VEventId &id);
+
+    template<typename T>
+    bool post(const VEventId &id, const T &payload) { return post(VEvent(id, payload)); }
 
     //Send out an event and wait until it is proceeded
-    void send(const VEvent &event);
-    void send(VEvent &&event);
-    void send(const VString &command, const VVariant &data);
-    void send(const VString &command, VVariant &&data);
-    void send(const char *command);
-    void send(const VVariant::Function &func);
+    bool send(const VEvent &event);
+    bool send(VEvent &&event);
+    bool send(const VString &command, const VVariant &data);
+    bool send(const VString &command, VVariant &&data);
+    bool send(const char *command);
+    bool send(const VVariant::Function &func);
+    bool send(const VEventId &id);
+
+    template<typename T>
+    bool send(const VEventId &id, const T &payload) { return send(VEvent(id, payload)); }
 
     void wait();
     void clear();
 
     VEvent next();
 
+    //Pop up to maxEvents events (all pending ones if maxEvents < 0) and pass them to the handler.
+    //Synchronous senders are released after their event has been handled.
+    typedef std::function<void(const VEvent &)> Handler;
+    int drain(const Handler &handler, int maxEvents = -1);
+
 private:
     NV_DECLARE_PRIVATE
     NV_DISABLE_COPY(VEventLoop)
@@ -0,0 +1,270 @@
+#pragma once
+
+#include "VArray.h"
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+
+NV_NAMESPACE_BEGIN
+
+// Hashing and equality of the keys of a VHash. Specialize it for keys std::hash doesn't know
+// about, or to look entries up by a different type than the key's.
+template<typename Key>
+struct VHashTraits
+{
+    static uint Hash(const Key &key) { return Mix(std::hash<Key>()(key)); }
+    static bool Equal(const Key &key1, const Key &key2) { return key1 == key2; }
+
+    //std::hash is the identity for integers, but VHash uses the low bits as the bucket
+    static uint Mix(size_t value)
+    {
+        uint hash = static_cast<uint>(value ^ (static_cast<vuint64>(value) >> 32));
+        hash ^= hash >> 16;
+        hash *= 0x85ebca6bu;
+        hash ^= hash >> 13;
+        hash *= 0xc2b2ae35u;
+        hash ^= hash >> 16;
+        return hash;
+    }
+};
+
+// An open-addressing hash table. Entries are kept contiguous in no particular order and a
+// power-of-two table of (hash, index) pairs with linear probing finds them, so a lookup usually
+// touches one slot and one entry. Inserting and removing invalidate iterators and pointers.
+template<typename Key, typename Value, typename Traits = VHashTraits<Key>>
+class VHash
+{
+public:
+    typedef Key KeyType;
+    typedef Value ValueType;
+    typedef std::pair<Key, Value> Entry;
+
+    typedef typename VArray<Entry>::iterator Iterator;
+    typedef typename VArray<Entry>::const_iterator ConstIterator;
+
+    VHash() : m_mask(0), m_defaultValue() {}
+
+    bool isEmpty() const { return m_entries.isEmpty(); }
+    uint size() const { return m_entries.size(); }
+
+    void clear()
+    {
+        m_entries.clear();
+        m_slots.clear();
+        m_mask = 0;
+    }
+
+    //Makes room for num entries without rehashing
+    void reserve(uint num)
+    {
+        m_entries.reserve(num);
+        if (num * 2 > m_slots.size()) {
+            uint capacity = MinCapacity;
+            while (capacity < num * 2) {
+                capacity <<= 1;
+            }
+            rehash(capacity);
+        }
+    }
+
+    template<typename LookupKey>
+    bool contains(const LookupKey &key) const { return indexOf(key) >= 0; }
+
+    template<typename LookupKey>
+    Iterator find(const LookupKey &key)
+    {
+        int index = indexOf(key);
+        return index >= 0 ? m_entries.begin() + index : m_entries.end();
+    }
+
+    template<typename LookupKey>
+    ConstIterator find(const LookupKey &key) const
+    {
+        int index = indexOf(key);
+        return index >= 0 ? m_entries.begin() + index : m_entries.end();
+    }
+
+    template<typename LookupKey>
+    const Value &value(const LookupKey &key) const
+    {
+        int index = indexOf(key);
+        return index >= 0 ? m_entries[index].second : m_defaultValue;
+    }
+
+    template<typename LookupKey>
+    const Value &value(const LookupKey &key, const Value &defaultValue) const
+    {
+        int index = indexOf(key);
+        return index >= 0 ? m_entries[index].second : defaultValue;
+    }
+
+    Value &operator[](const Key &key)
+    {
+        const uint hash = Traits::Hash(key);
+        int index = indexOf(key, hash);
+        if (index < 0) {
+            index = append(hash, key, Value());
+        }
+        return m_entries[index].second;
+    }
+
+    const Value &operator[](const Key &key) const { return value(key); }
+
+    //Like VMap, an existing entry keeps its value
+    void insert(const Key &key, const Value &value)
+    {
+        const uint hash = Traits::Hash(key);
+        if (indexOf(key, hash) < 0) {
+            append(hash, key, value);
+        }
+    }
+
+    void insert(const Key &key, Value &&value)
+    {
+        const uint hash = Traits::Hash(key);
+        if (indexOf(key, hash) < 0) {
+            append(hash, key, std::move(value));
+        }
+    }
+
+    template<typename LookupKey>
+    bool remove(const LookupKey &key)
+    {
+        if (m_entries.isEmpty()) {
+            return false;
+        }
+
+        const uint hash = Traits::Hash(key);
+        uint slot = hash & m_mask;
+        for (;;) {
+            const Slot &current = m_slots[slot];
+            if (current.index < 0) {
+                return false;
+            }
+            if (current.hash == hash && Traits::Equal(m_entries[current.index].first, key)) {
+                break;
+            }
+            slot = (slot + 1) & m_mask;
+        }
+
+        const int index = m_slots[slot].index;
+        erase(slot);
+
+        //The last entry fills the hole
+        const int last = m_entries.length() - 1;
+        if (index != last) {
+            uint lastSlot = Traits::Hash(m_entries[last].first) & m_mask;
+            while (m_slots[lastSlot].index != last) {
+                lastSlot = (lastSlot + 1) & m_mask;
+            }
+            m_slots[lastSlot].index = index;
+            m_entries[index] = std::move(m_entries[last]);
+        }
+        m_entries.pop_back();
+        return true;
+    }
+
+    Iterator begin() { return m_entries.begin(); }
+    Iterator end() { return m_entries.end(); }
+    ConstIterator begin() const { return m_entries.begin(); }
+    ConstIterator end() const { return m_entries.end(); }
+
+private:
+    static const uint MinCapacity = 16;
+
+    struct Slot
+    {
+        uint hash;
+        int index;
+    };
+
+    template<typename LookupKey>
+    int indexOf(const LookupKey &key) const
+    {
+        return m_entries.isEmpty() ? -1 : indexOf(key, Traits::Hash(key));
+    }
+
+    template<typename LookupKey>
+    int indexOf(const LookupKey &key, uint hash) const
+    {
+        if (m_slots.isEmpty()) {
+            return -1;
+        }
+        for (uint slot = hash & m_mask; ; slot = (slot + 1) & m_mask) {
+            const Slot &current = m_slots[slot];
+            if (current.index < 0) {
+                return -1;
+            }
+            if (current.hash == hash && Traits::Equal(m_entries[current.index].first, key)) {
+                return current.index;
+            }
+        }
+    }
+
+    template<typename T>
+    int append(uint hash, const Key &key, T &&value)
+    {
+        //At most half full keeps probe sequences short
+        if ((m_entries.size() + 1) * 2 > m_slots.size()) {
+            rehash(m_slots.isEmpty() ? MinCapacity : m_slots.size() * 2);
+        }
+        const int index = m_entries.length();
+        m_entries.push_back(Entry(key, std::forward<T>(value)));
+        place(hash, index);
+        return index;
+    }
+
+    void place(uint hash, int index)
+    {
+        uint slot = hash & m_mask;
+        while (m_slots[slot].index >= 0) {
+            slot = (slot + 1) & m_mask;
+        }
+        m_slots[slot].hash = hash;
+        m_slots[slot].index = index;
+    }
+
+    //Shifts the following slots of the cluster back so that no probe sequence is broken
+    void erase(uint slot)
+    {
+        uint next = slot;
+        for (;;) {
+            m_slots[slot].index = -1;
+            for (;;) {
+                next = (next + 1) & m_mask;
+                if (m_slots[next].index < 0) {
+                    return;
+                }
+                //Moves only if its home isn't cyclically within (slot, next]
+                const uint home = m_slots[next].hash & m_mask;
+                if (((next - home) & m_mask) >= ((next - slot) & m_mask)) {
+                    break;
+                }
+            }
+            m_slots[slot] = m_slots[next];
+            slot = next;
+        }
+    }
+
+    void rehash(uint capacity)
+    {
+        VArray<Slot> slots;
+        slots.swap(m_slots);
+        const Slot empty = {0, -1};
+        m_slots.resize(capacity, empty);
+        m_mask = capacity - 1;
+        for (const Slot &slot : slots) {
+            if (slot.index >= 0) {
+                place(slot.hash, slot.index);
+            }
+        }
+    }
+
+    VArray<Entry> m_entries;
+    VArray<Slot> m_slots;
+    uint m_mask;
+    Value m_defaultValue;
+};
+
+NV_NAMESPACE_END
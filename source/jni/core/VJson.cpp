@@ -1,10 +1,11 @@
 #include "VJson.h"
 
 #include "VByteArray.h"
+#include "VFile.h"
+#include "VJsonReader.h"
 #include "VLog.h"
 
 #include <sstream>
-#include <fstream>
 
 NV_NAMESPACE_BEGIN
 
@@ -52,7 +53,7 @@ VJson::VJson(const VString &value)
 VJson::VJson(VString &&value)
     : m_type(String)
 {
-    m_value.str = new VString(value);
+    m_value.str = new VString(std::move(value));
 }
 
 VJson::VJson(const VJsonArray &array)
@@ -64,7 +65,7 @@ VJson::VJson(const VJsonArray &array)
 VJson::VJson(VJsonArray &&array)
     : m_type(Array)
 {
-    m_value.array = new VJsonArray(array);
+    m_value.array = new VJsonArray(std::move(array));
 }
 
 VJson::VJson(const VJsonObject &object)
@@ -76,7 +77,7 @@ VJson::VJson(const VJsonObject &object)
 VJson::VJson(VJsonObject &&object)
     : m_type(Object)
 {
-    m_value.object = new VJsonObject(object);
+    m_value.object = new VJsonObject(std::move(object));
 }
 
 VJson::VJson(const VJson &source)
@@ -453,21 +454,96 @@ std::ostream &operator<<(std::ostream &out, const VJson &value)
     return out;
 }
 
+namespace {
+
+// Builds a VJson tree from reader callbacks
+class VJsonBuilder : public VJsonHandler
+{
+public:
+    bool onNull() override { add(VJson()); return true; }
+    bool onBool(bool value) override { add(VJson(value)); return true; }
+    bool onNumber(double value) override { add(VJson(value)); return true; }
+    bool onString(const char *str, uint length) override
+    {
+        add(VJson(VString::fromUtf8(VByteArrayView(str, length))));
+        return true;
+    }
+
+    bool onStartObject() override { return open(VJson(VJsonObject())); }
+    bool onKey(const char *key, uint length) override
+    {
+        m_key = VString::fromUtf8(VByteArrayView(key, length));
+        return true;
+    }
+    bool onEndObject(uint) override { m_stack.pop_back(); return true; }
+
+    bool onStartArray() override { return open(VJson(VJsonArray())); }
+    bool onEndArray(uint) override { m_stack.pop_back(); return true; }
+
+    VJson root;
+
+private:
+    VJson *add(VJson &&value)
+    {
+        if (m_stack.isEmpty()) {
+            root = std::move(value);
+            return &root;
+        }
+
+        VJson *parent = m_stack.last();
+        if (parent->isArray()) {
+            VJsonArray &array = parent->array();
+            array.append(std::move(value));
+            return &array.last();
+        }
+
+        VJson &member = parent->object()[m_key];
+        member = std::move(value);
+        return &member;
+    }
+
+    // Containers don't move while they are open, the parent only grows once they are closed
+    bool open(VJson &&container)
+    {
+        m_stack.append(add(std::move(container)));
+        return true;
+    }
+
+    VArray<VJson *> m_stack;
+    VString m_key;
+};
+
+}
+
+VJson VJson::Parse(const char *data, uint length)
+{
+    VJsonReader reader(data, length);
+    VJsonBuilder builder;
+    if (!reader.parse(builder)) {
+        vError("VJson:" << reader.errorMessage() << "at offset" << reader.errorOffset());
+        return VJson();
+    }
+    return std::move(builder.root);
+}
+
 VJson VJson::Parse(const VByteArray &str)
 {
-	std::stringstream s;
-	s << str;
-    VJson json;
-	s >> json;
-	return json;
+    return Parse(str.data(), str.size());
 }
 
 VJson VJson::Load(const VString &path)
 {
-    std::ifstream s(path.toUtf8(), std::ios::binary);
-    VJson json;
-	s >> json;
-    return json;
+    VFile file(path, VFile::ReadOnly);
+    if (!file.isOpen()) {
+        return VJson();
+    }
+
+    // The parser copies what it keeps, so it can read the mapped file directly
+    VMappedView view = file.map();
+    if (view.isNull()) {
+        return Parse(file.readAll());
+    }
+    return Parse(view.data(), view.size());
 }
 
 void VJson::copy(const VJson &source)
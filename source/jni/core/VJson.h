@@ -102,6 +102,8 @@ public:
     friend std::istream &operator>>(std::istream &in, VJson &value);
     friend std::ostream &operator<<(std::ostream &out, const VJson &value);
 
+    //Returns a null value if the text is not valid JSON
+    static VJson Parse(const char *data, uint length);
     static VJson Parse(const VByteArray &str);
     static VJson Load(const VString &path);
 
@@ -0,0 +1,427 @@
+#include "VJsonDocument.h"
+
+#include "VJsonReader.h"
+#include "VLog.h"
+
+#include <fstream>
+#include <stdlib.h>
+#include <string.h>
+
+NV_NAMESPACE_BEGIN
+
+namespace {
+
+const VJsonValue &NullValue()
+{
+    static const VJsonValue value;
+    return value;
+}
+
+// A bump allocator. Memory is only released all at once.
+class Arena
+{
+public:
+    Arena()
+        : m_current(nullptr)
+        , m_used(0)
+        , m_capacity(0)
+        , m_total(0)
+    {
+    }
+
+    ~Arena()
+    {
+        clear();
+    }
+
+    void *allocate(uint size)
+    {
+        m_used = (m_used + 7) & ~7u;
+        if (m_current == nullptr || m_used + size > m_capacity) {
+            const uint capacity = size > ChunkSize - sizeof(Chunk) ? size : ChunkSize - sizeof(Chunk);
+            Chunk *chunk = static_cast<Chunk *>(malloc(sizeof(Chunk) + capacity));
+            chunk->next = m_current;
+            m_current = chunk;
+            m_used = 0;
+            m_capacity = capacity;
+            m_total += sizeof(Chunk) + capacity;
+        }
+
+        void *memory = reinterpret_cast<char *>(m_current + 1) + m_used;
+        m_used += size;
+        return memory;
+    }
+
+    void clear()
+    {
+        while (m_current) {
+            Chunk *next = m_current->next;
+            free(m_current);
+            m_current = next;
+        }
+        m_used = m_capacity = m_total = 0;
+    }
+
+    uint total() const { return m_total; }
+
+private:
+    static const uint ChunkSize = 64 * 1024;
+
+    struct Chunk
+    {
+        Chunk *next;
+        vuint64 align;
+    };
+
+    Chunk *m_current;
+    uint m_used;
+    uint m_capacity;
+    uint m_total;
+};
+
+}
+
+struct VJsonDocument::Private : public VJsonHandler
+{
+    // The key a container is stored under is saved until the container is closed
+    struct Frame
+    {
+        bool object;
+        uint start;
+        const char *key;
+        uint keyLength;
+    };
+
+    Private()
+        : key(nullptr)
+        , keyLength(0)
+    {
+    }
+
+    Arena arena;
+    VJsonValue root;
+
+    // Children of the open containers wait here until their container is closed,
+    // then they are moved into a single arena block.
+    VArray<VJsonValue> elements;
+    VArray<VJsonMember> members;
+    VArray<Frame> stack;
+    const char *key;
+    uint keyLength;
+
+    void add(const VJsonValue &value)
+    {
+        if (stack.isEmpty()) {
+            root = value;
+        } else if (stack.last().object) {
+            VJsonMember member;
+            member.key = key;
+            member.keyLength = keyLength;
+            member.value = value;
+            members.append(member);
+        } else {
+            elements.append(value);
+        }
+    }
+
+    bool onNull() override
+    {
+        add(VJsonValue());
+        return true;
+    }
+
+    bool onBool(bool value) override
+    {
+        VJsonValue json;
+        json.m_type = VJson::Boolean;
+        json.m_value.boolean = value;
+        add(json);
+        return true;
+    }
+
+    bool onNumber(double value) override
+    {
+        VJsonValue json;
+        json.m_type = VJson::Number;
+        json.m_value.number = value;
+        add(json);
+        return true;
+    }
+
+    // Strings point into the text, which was copied into the arena and is decoded in situ
+    bool onString(const char *str, uint length) override
+    {
+        VJsonValue json;
+        json.m_type = VJson::String;
+        json.m_size = length;
+        json.m_value.str = str;
+        add(json);
+        return true;
+    }
+
+    bool onStartObject() override
+    {
+        Frame frame;
+        frame.object = true;
+        frame.start = members.size();
+        frame.key = key;
+        frame.keyLength = keyLength;
+        stack.append(frame);
+        return true;
+    }
+
+    bool onKey(const char *str, uint length) override
+    {
+        key = str;
+        keyLength = length;
+        return true;
+    }
+
+    bool onEndObject(uint memberCount) override
+    {
+        const uint start = stack.last().start;
+        key = stack.last().key;
+        keyLength = stack.last().keyLength;
+        stack.pop_back();
+
+        VJsonValue json;
+        json.m_type = VJson::Object;
+        json.m_size = memberCount;
+        VJsonMember *block = static_cast<VJsonMember *>(arena.allocate(sizeof(VJsonMember) * memberCount));
+        if (memberCount > 0) {
+            memcpy(block, &members[start], sizeof(VJsonMember) * memberCount);
+        }
+        json.m_value.members = block;
+        members.resize(start);
+        add(json);
+        return true;
+    }
+
+    bool onStartArray() override
+    {
+        Frame frame;
+        frame.object = false;
+        frame.start = elements.size();
+        frame.key = key;
+        frame.keyLength = keyLength;
+        stack.append(frame);
+        return true;
+    }
+
+    bool onEndArray(uint elementCount) override
+    {
+        const uint start = stack.last().start;
+        key = stack.last().key;
+        keyLength = stack.last().keyLength;
+        stack.pop_back();
+
+        VJsonValue json;
+        json.m_type = VJson::Array;
+        json.m_size = elementCount;
+        VJsonValue *block = static_cast<VJsonValue *>(arena.allocate(sizeof(VJsonValue) * elementCount));
+        if (elementCount > 0) {
+            memcpy(block, &elements[start], sizeof(VJsonValue) * elementCount);
+        }
+        json.m_value.elements = block;
+        elements.resize(start);
+        add(json);
+        return true;
+    }
+};
+
+bool VJsonValue::toBool() const
+{
+    switch (m_type) {
+    case VJson::Boolean:
+        return m_value.boolean;
+    case VJson::Number:
+        return static_cast<int>(m_value.number) != 0;
+    case VJson::String:
+    case VJson::Array:
+    case VJson::Object:
+        return m_size > 0;
+    default:
+        return false;
+    }
+}
+
+double VJsonValue::toDouble() const
+{
+    if (m_type == VJson::Number) {
+        return m_value.number;
+    }
+
+    if (m_type == VJson::String) {
+        char buffer[64];
+        const uint length = m_size < sizeof(buffer) - 1 ? m_size : sizeof(buffer) - 1;
+        memcpy(buffer, m_value.str, length);
+        buffer[length] = '\0';
+        return strtod(buffer, nullptr);
+    }
+
+    return 0.0;
+}
+
+int VJsonValue::toInt() const
+{
+    return static_cast<int>(toDouble());
+}
+
+VString VJsonValue::toString() const
+{
+    if (m_type == VJson::String) {
+        return VString::fromUtf8(VByteArrayView(m_value.str, m_size));
+    }
+
+    if (m_type == VJson::Number) {
+        return toJson().toString();
+    }
+
+    return VString();
+}
+
+const VJsonValue &VJsonValue::at(uint i) const
+{
+    if (m_type == VJson::Array && i < m_size) {
+        return m_value.elements[i];
+    }
+    if (m_type == VJson::Object && i < m_size) {
+        return m_value.members[i].value;
+    }
+    return NullValue();
+}
+
+const VJsonMember &VJsonValue::member(uint i) const
+{
+    vAssert(m_type == VJson::Object && i < m_size);
+    return m_value.members[i];
+}
+
+const VJsonValue &VJsonValue::value(const char *key) const
+{
+    if (m_type != VJson::Object) {
+        return NullValue();
+    }
+
+    const uint length = strlen(key);
+    for (uint i = 0; i < m_size; i++) {
+        const VJsonMember &member = m_value.members[i];
+        if (member.keyLength == length && memcmp(member.key, key, length) == 0) {
+            return member.value;
+        }
+    }
+    return NullValue();
+}
+
+bool VJsonValue::contains(const char *key) const
+{
+    return &value(key) != &NullValue();
+}
+
+VJson VJsonValue::toJson() const
+{
+    switch (m_type) {
+    case VJson::Boolean:
+        return VJson(m_value.boolean);
+    case VJson::Number:
+        return VJson(m_value.number);
+    case VJson::String:
+        return VJson(toString());
+    case VJson::Array: {
+        VJsonArray array;
+        array.reserve(m_size);
+        for (uint i = 0; i < m_size; i++) {
+            array.append(m_value.elements[i].toJson());
+        }
+        return VJson(std::move(array));
+    }
+    case VJson::Object: {
+        VJsonObject object;
+        for (uint i = 0; i < m_size; i++) {
+            const VJsonMember &member = m_value.members[i];
+            object.insert(VString::fromUtf8(VByteArrayView(member.key, member.keyLength)), member.value.toJson());
+        }
+        return VJson(std::move(object));
+    }
+    default:
+        return VJson();
+    }
+}
+
+VJsonDocument::VJsonDocument()
+    : d(new Private)
+{
+}
+
+VJsonDocument::~VJsonDocument()
+{
+    delete d;
+}
+
+bool VJsonDocument::parse(const char *data, uint length)
+{
+    clear();
+
+    char *text = static_cast<char *>(d->arena.allocate(length));
+    memcpy(text, data, length);
+
+    VJsonReader reader = VJsonReader::InSitu(text, length);
+    if (!reader.parse(*d)) {
+        vError("VJsonDocument:" << reader.errorMessage() << "at offset" << reader.errorOffset());
+        clear();
+        return false;
+    }
+    return true;
+}
+
+bool VJsonDocument::parse(const VByteArray &data)
+{
+    return parse(data.data(), data.size());
+}
+
+bool VJsonDocument::load(const VString &path)
+{
+    std::ifstream file(path.toUtf8(), std::ios::binary);
+    if (!file.is_open()) {
+        clear();
+        return false;
+    }
+
+    file.seekg(0, std::ios::end);
+    const uint length = static_cast<uint>(file.tellg());
+    file.seekg(0, std::ios::beg);
+
+    // Read straight into the arena, no need for another copy of the text
+    clear();
+    char *text = static_cast<char *>(d->arena.allocate(length));
+    file.read(text, length);
+
+    VJsonReader reader = VJsonReader::InSitu(text, length);
+    if (!reader.parse(*d)) {
+        vError("VJsonDocument:" << reader.errorMessage() << "at offset" << reader.errorOffset() << "in" << path);
+        clear();
+        return false;
+    }
+    return true;
+}
+
+const VJsonValue &VJsonDocument::root() const
+{
+    return d->root;
+}
+
+uint VJsonDocument::memoryUsage() const
+{
+    return d->arena.total();
+}
+
+void VJsonDocument::clear()
+{
+    d->arena.clear();
+    d->root = VJsonValue();
+    d->elements.clear();
+    d->members.clear();
+    d->stack.clear();
+}
+
+NV_NAMESPACE_END
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "VJson.h"
+
+NV_NAMESPACE_BEGIN
+
+struct VJsonMember;
+
+// A read-only JSON value owned by a VJsonDocument. Strings are UTF-8 and not null-terminated.
+class VJsonValue
+{
+public:
+    VJsonValue() : m_type(VJson::Null), m_size(0) { m_value.number = 0; }
+
+    VJson::Type type() const { return m_type; }
+    bool isNull() const { return m_type == VJson::Null; }
+    bool isBool() const { return m_type == VJson::Boolean; }
+    bool isNumber() const { return m_type == VJson::Number; }
+    bool isString() const { return m_type == VJson::String; }
+    bool isArray() const { return m_type == VJson::Array; }
+    bool isObject() const { return m_type == VJson::Object; }
+
+    bool toBool() const;
+    double toDouble() const;
+    int toInt() const;
+
+    // UTF-8 string data
+    const char *data() const { return m_type == VJson::String ? m_value.str : ""; }
+    uint length() const { return m_type == VJson::String ? m_size : 0; }
+    VString toString() const;
+
+    //Array/Object functions
+    uint size() const { return m_type == VJson::Array || m_type == VJson::Object ? m_size : 0; }
+
+    const VJsonValue &at(uint i) const;
+    const VJsonValue &operator[](uint i) const { return at(i); }
+    const VJsonValue &operator[](int i) const { return at(i); }
+
+    const VJsonMember &member(uint i) const;
+    const VJsonValue &value(const char *key) const;
+    const VJsonValue &operator[](const char *key) const { return value(key); }
+    bool contains(const char *key) const;
+
+    // Copies the value into a heap-allocated VJson tree
+    VJson toJson() const;
+
+private:
+    friend class VJsonDocument;
+
+    VJson::Type m_type;
+    uint m_size;
+
+    union Value
+    {
+        bool boolean;
+        double number;
+        const char *str;
+        const VJsonValue *elements;
+        const VJsonMember *members;
+    };
+    Value m_value;
+};
+
+struct VJsonMember
+{
+    const char *key;
+    uint keyLength;
+    VJsonValue value;
+};
+
+// A parsed JSON document whose values, containers and strings all come from one arena.
+// The text is copied into the arena once and parsed in situ, and everything is released
+// together with the document.
+class VJsonDocument
+{
+public:
+    VJsonDocument();
+    ~VJsonDocument();
+
+    bool parse(const char *data, uint length);
+    bool parse(const VByteArray &data);
+    bool load(const VString &path);
+
+    const VJsonValue &root() const;
+
+    // Bytes allocated by the arena
+    uint memoryUsage() const;
+
+    void clear();
+
+private:
+    NV_DECLARE_PRIVATE
+    NV_DISABLE_COPY(VJsonDocument)
+};
+
+NV_NAMESPACE_END
@@ -0,0 +1,429 @@
+#include "VJsonReader.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+NV_NAMESPACE_BEGIN
+
+namespace {
+
+const int MaxDepth = 512;
+
+inline bool IsSpace(char ch)
+{
+    return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t';
+}
+
+inline int HexValue(char ch)
+{
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+// Writes a code point as UTF-8 and returns the number of bytes
+inline int EncodeUtf8(uint code, char *out)
+{
+    if (code < 0x80) {
+        out[0] = static_cast<char>(code);
+        return 1;
+    }
+    if (code < 0x800) {
+        out[0] = static_cast<char>(0xC0 | (code >> 6));
+        out[1] = static_cast<char>(0x80 | (code & 0x3F));
+        return 2;
+    }
+    if (code < 0x10000) {
+        out[0] = static_cast<char>(0xE0 | (code >> 12));
+        out[1] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out[2] = static_cast<char>(0x80 | (code & 0x3F));
+        return 3;
+    }
+    out[0] = static_cast<char>(0xF0 | (code >> 18));
+    out[1] = static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (code & 0x3F));
+    return 4;
+}
+
+}
+
+struct VJsonReader::Private
+{
+    Private(const char *data, uint length, char *mutableData)
+        : begin(data)
+        , cur(data)
+        , end(data + length)
+        , mutableData(mutableData)
+        , error(nullptr)
+        , errorOffset(0)
+    {
+    }
+
+    const char *begin;
+    const char *cur;
+    const char *end;
+    char *mutableData;
+    VByteArray scratch;
+
+    const char *error;
+    uint errorOffset;
+
+    bool fail(const char *message)
+    {
+        if (error == nullptr) {
+            error = message;
+            errorOffset = cur - begin;
+        }
+        return false;
+    }
+
+    void skipWhitespace()
+    {
+        while (cur < end && IsSpace(*cur)) {
+            cur++;
+        }
+    }
+
+    bool parseLiteral(const char *literal, uint length)
+    {
+        if (static_cast<uint>(end - cur) < length || memcmp(cur, literal, length) != 0) {
+            return fail("Invalid literal");
+        }
+        cur += length;
+        return true;
+    }
+
+    bool readHex4(uint &code)
+    {
+        if (end - cur < 4) {
+            return fail("Incomplete unicode escape");
+        }
+        code = 0;
+        for (int i = 0; i < 4; i++) {
+            const int value = HexValue(cur[i]);
+            if (value < 0) {
+                return fail("Invalid unicode escape");
+            }
+            code = (code << 4) | value;
+        }
+        cur += 4;
+        return true;
+    }
+
+    // Points str at the decoded string. Strings without escapes are reported straight from
+    // the source, the others are decoded into the scratch buffer or over the source text.
+    bool parseString(const char *&str, uint &length)
+    {
+        cur++;
+        const char *start = cur;
+        while (cur < end && *cur != '"' && *cur != '\\') {
+            cur++;
+        }
+        if (cur >= end) {
+            return fail("Unterminated string");
+        }
+        if (*cur == '"') {
+            str = start;
+            length = cur - start;
+            cur++;
+            return true;
+        }
+
+        char *out;
+        char *outBegin;
+        if (mutableData) {
+            outBegin = mutableData + (start - begin);
+            out = mutableData + (cur - begin);
+        } else {
+            // Find the end of the string first, the decoded text is never longer than that
+            const char *rawEnd = cur;
+            while (rawEnd < end && *rawEnd != '"') {
+                rawEnd += *rawEnd == '\\' ? 2 : 1;
+            }
+            if (rawEnd > end) {
+                rawEnd = end;
+            }
+            scratch.resize(rawEnd - start);
+            outBegin = &scratch[0];
+            memcpy(outBegin, start, cur - start);
+            out = outBegin + (cur - start);
+        }
+
+        while (cur < end && *cur != '"') {
+            if (*cur != '\\') {
+                *out++ = *cur++;
+                continue;
+            }
+
+            cur++;
+            if (cur >= end) {
+                break;
+            }
+            const char escaped = *cur++;
+            switch (escaped) {
+            case '"': *out++ = '"'; break;
+            case '\\': *out++ = '\\'; break;
+            case '/': *out++ = '/'; break;
+            case 'b': *out++ = '\b'; break;
+            case 'f': *out++ = '\f'; break;
+            case 'n': *out++ = '\n'; break;
+            case 'r': *out++ = '\r'; break;
+            case 't': *out++ = '\t'; break;
+            case 'u': {
+                uint code;
+                if (!readHex4(code)) {
+                    return false;
+                }
+                if (code >= 0xD800 && code < 0xDC00) {
+                    uint low;
+                    if (end - cur < 2 || cur[0] != '\\' || cur[1] != 'u') {
+                        return fail("Unpaired surrogate");
+                    }
+                    cur += 2;
+                    if (!readHex4(low) || low < 0xDC00 || low > 0xDFFF) {
+                        return fail("Invalid low surrogate");
+                    }
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                // An escape takes at least six bytes of source, so the output never overtakes the input
+                out += EncodeUtf8(code, out);
+                break;
+            }
+            default:
+                return fail("Invalid escape character");
+            }
+        }
+        if (cur >= end) {
+            return fail("Unterminated string");
+        }
+
+        str = outBegin;
+        length = out - outBegin;
+        cur++;
+        return true;
+    }
+
+    bool parseNumber(double &value)
+    {
+        const char *start = cur;
+        if (cur < end && (*cur == '-' || *cur == '+')) {
+            cur++;
+        }
+        while (cur < end && ((*cur >= '0' && *cur <= '9') || *cur == '.' || *cur == 'e' || *cur == 'E' || *cur == '-' || *cur == '+')) {
+            cur++;
+        }
+
+        // strtod() needs a terminated string, and the source buffer might not be
+        char buffer[64];
+        const uint length = cur - start;
+        if (length == 0 || length >= sizeof(buffer)) {
+            cur = start;
+            return fail("Invalid number");
+        }
+        memcpy(buffer, start, length);
+        buffer[length] = '\0';
+
+        char *numberEnd;
+        value = strtod(buffer, &numberEnd);
+        if (numberEnd != buffer + length) {
+            cur = start + (numberEnd - buffer);
+            return fail("Invalid number");
+        }
+        return true;
+    }
+
+    bool parseValue(VJsonHandler &handler, int depth)
+    {
+        skipWhitespace();
+        if (cur >= end) {
+            return fail("Unexpected end of data");
+        }
+
+        switch (*cur) {
+        case 'n':
+            return parseLiteral("null", 4) && (handler.onNull() || fail("Aborted by handler"));
+        case 't':
+            return parseLiteral("true", 4) && (handler.onBool(true) || fail("Aborted by handler"));
+        case 'f':
+            return parseLiteral("false", 5) && (handler.onBool(false) || fail("Aborted by handler"));
+        case '"': {
+            const char *str;
+            uint length;
+            return parseString(str, length) && (handler.onString(str, length) || fail("Aborted by handler"));
+        }
+        case '[':
+            return parseArray(handler, depth);
+        case '{':
+            return parseObject(handler, depth);
+        default: {
+            double number;
+            return parseNumber(number) && (handler.onNumber(number) || fail("Aborted by handler"));
+        }
+        }
+    }
+
+    bool parseArray(VJsonHandler &handler, int depth)
+    {
+        if (depth >= MaxDepth) {
+            return fail("Too deeply nested");
+        }
+        cur++;
+        if (!handler.onStartArray()) {
+            return fail("Aborted by handler");
+        }
+
+        uint count = 0;
+        skipWhitespace();
+        if (cur < end && *cur == ']') {
+            cur++;
+            return handler.onEndArray(0) || fail("Aborted by handler");
+        }
+
+        forever {
+            if (!parseValue(handler, depth + 1)) {
+                return false;
+            }
+            count++;
+
+            skipWhitespace();
+            if (cur >= end) {
+                return fail("Expect ]");
+            }
+            if (*cur == ',') {
+                cur++;
+            } else if (*cur == ']') {
+                cur++;
+                return handler.onEndArray(count) || fail("Aborted by handler");
+            } else {
+                return fail("Expect , or ]");
+            }
+        }
+    }
+
+    bool parseObject(VJsonHandler &handler, int depth)
+    {
+        if (depth >= MaxDepth) {
+            return fail("Too deeply nested");
+        }
+        cur++;
+        if (!handler.onStartObject()) {
+            return fail("Aborted by handler");
+        }
+
+        uint count = 0;
+        skipWhitespace();
+        if (cur < end && *cur == '}') {
+            cur++;
+            return handler.onEndObject(0) || fail("Aborted by handler");
+        }
+
+        forever {
+            skipWhitespace();
+            if (cur >= end || *cur != '"') {
+                return fail("Expect JSON key string");
+            }
+            const char *key;
+            uint length;
+            if (!parseString(key, length)) {
+                return false;
+            }
+            if (!handler.onKey(key, length)) {
+                return fail("Aborted by handler");
+            }
+
+            skipWhitespace();
+            if (cur >= end || *cur != ':') {
+                return fail("Expect :");
+            }
+            cur++;
+
+            if (!parseValue(handler, depth + 1)) {
+                return false;
+            }
+            count++;
+
+            skipWhitespace();
+            if (cur >= end) {
+                return fail("Expect }");
+            }
+            if (*cur == ',') {
+                cur++;
+            } else if (*cur == '}') {
+                cur++;
+                return handler.onEndObject(count) || fail("Aborted by handler");
+            } else {
+                return fail("Expect , or }");
+            }
+        }
+    }
+};
+
+VJsonReader::VJsonReader(const char *data, uint length)
+    : d(new Private(data, length, nullptr))
+{
+}
+
+VJsonReader::VJsonReader(const VByteArray &data)
+    : d(new Private(data.data(), data.size(), nullptr))
+{
+}
+
+VJsonReader::VJsonReader(VJsonReader &&source)
+    : d(source.d)
+{
+    source.d = nullptr;
+}
+
+VJsonReader::~VJsonReader()
+{
+    delete d;
+}
+
+VJsonReader VJsonReader::InSitu(char *data, uint length)
+{
+    VJsonReader reader(data, length);
+    reader.d->mutableData = data;
+    return reader;
+}
+
+bool VJsonReader::parse(VJsonHandler &handler)
+{
+    d->cur = d->begin;
+    d->error = nullptr;
+    d->errorOffset = 0;
+
+    if (!d->parseValue(handler, 0)) {
+        return false;
+    }
+
+    d->skipWhitespace();
+    if (d->cur < d->end && *d->cur != '\0') {
+        return d->fail("Unexpected data after the root value");
+    }
+    return true;
+}
+
+bool VJsonReader::hasError() const
+{
+    return d->error != nullptr;
+}
+
+const char *VJsonReader::errorMessage() const
+{
+    return d->error ? d->error : "";
+}
+
+uint VJsonReader::errorOffset() const
+{
+    return d->errorOffset;
+}
+
+NV_NAMESPACE_END
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "VByteArray.h"
+
+NV_NAMESPACE_BEGIN
+
+// Receives the values of a JSON text in document order. Strings and keys are UTF-8 and are
+// only valid during the callback. Returning false from any callback stops parsing.
+class VJsonHandler
+{
+public:
+    virtual ~VJsonHandler() {}
+
+    virtual bool onNull() { return true; }
+    virtual bool onBool(bool value) { NV_UNUSED(value); return true; }
+    virtual bool onNumber(double value) { NV_UNUSED(value); return true; }
+    virtual bool onString(const char *str, uint length) { NV_UNUSED(str, length); return true; }
+
+    virtual bool onStartObject() { return true; }
+    virtual bool onKey(const char *key, uint length) { NV_UNUSED(key, length); return true; }
+    virtual bool onEndObject(uint memberCount) { NV_UNUSED(memberCount); return true; }
+
+    virtual bool onStartArray() { return true; }
+    virtual bool onEndArray(uint elementCount) { NV_UNUSED(elementCount); return true; }
+};
+
+// A streaming JSON reader working directly on a memory buffer
+class VJsonReader
+{
+public:
+    VJsonReader(const char *data, uint length);
+    explicit VJsonReader(const VByteArray &data);
+    ~VJsonReader();
+
+    // Parses a mutable buffer in situ: escaped strings are decoded over the source text
+    // instead of a scratch buffer, so the reported strings stay valid as long as the buffer.
+    static VJsonReader InSitu(char *data, uint length);
+
+    VJsonReader(VJsonReader &&source);
+
+    bool parse(VJsonHandler &handler);
+
+    bool hasError() const;
+    const char *errorMessage() const;
+    uint errorOffset() const;
+
+private:
+    NV_DECLARE_PRIVATE
+    NV_DISABLE_COPY(VJsonReader)
+};
+
+NV_NAMESPACE_END
@@ -1,53 +1,131 @@
 #pragma once
 
-#include "VAtomicInt.h"
+#include "vglobal.h"
+
+#include <atomic>
+#include <string.h>
+#include <thread>
 
 NV_NAMESPACE_BEGIN
 
+// A value shared between threads without locks, for small trivially copyable types read far
+// more often than written: sensor states, vsync timings, flags.
+//
+// It is a seqlock over two slots. Writers fill the slot readers are not using and publish it by
+// bumping a sequence number, readers copy the published slot and check with the sequence that
+// no writer came back to it meanwhile. Readers never block writers, and only retry if two writes
+// complete while they copy. Any number of threads may write; they take turns on the sequence.
+//
+// The value is copied word by word through relaxed atomics, so that a torn copy is discarded
+// rather than being a data race.
 template <class E>
 class VLockless
 {
+    //Copied as words, which only holds for trivially copyable types
+    static_assert(__has_trivial_copy(E), "the value must be trivially copyable");
+
 public:
     VLockless()
-        : m_begin(0)
-        , m_end(0)
     {
+        m_sequence.value.store(0, std::memory_order_relaxed);
+        setState(E());
+    }
+
+    VLockless(const E &state)
+    {
+        m_sequence.value.store(0, std::memory_order_relaxed);
+        setState(state);
     }
 
     E state() const
     {
         E state;
-        int begin, end, final;
-        forever {
-            end = m_end.exchangeAddSync(0);
-            state = m_slot[end & 1];
-            begin = m_begin.exchangeAddSync(0);
+        while (!read(state)) {
+        }
+        return state;
+    }
 
-            if (end == begin) {
-                return state;
+    //For threads which can't wait, gives up after a number of torn copies
+    bool tryState(E &state, int retries = 4) const
+    {
+        for (int i = 0; i <= retries; i++) {
+            if (read(state)) {
+                return true;
             }
+        }
+        return false;
+    }
 
-            state = m_slot[(begin & 1) ^ 1];
+    void setState(const E &state)
+    {
+        Word words[WordCount];
+        words[WordCount - 1] = 0;
+        memcpy(words, &state, sizeof(E));
 
-            final = m_begin.exchangeAddSync(0);
-            if (final == begin) {
-                return state;
+        //An odd sequence holds the other writers back. Acquiring it orders the slot stores after
+        //those of the previous writer.
+        uint sequence = m_sequence.value.load(std::memory_order_relaxed);
+        forever {
+            if ((sequence & 1) == 0 && m_sequence.value.compare_exchange_weak(sequence, sequence + 1,
+                                                                               std::memory_order_acquire, std::memory_order_relaxed)) {
+                break;
             }
+            std::this_thread::yield();
+            sequence = m_sequence.value.load(std::memory_order_relaxed);
         }
-        return state;
+        std::atomic_thread_fence(std::memory_order_release);
+
+        Slot &slot = m_slots[((sequence >> 1) + 1) & 1];
+        for (uint i = 0; i < WordCount; i++) {
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        }
+        m_sequence.value.store(sequence + 2, std::memory_order_release);
     }
 
-    void setState(E state)
+private:
+    typedef uint Word;
+    enum { WordCount = (sizeof(E) + sizeof(Word) - 1) / sizeof(Word) };
+
+    bool read(E &state) const
     {
-        const int slot = m_begin.exchangeAddSync(1) & 1;
-        m_slot[slot ^ 1] = state;
-        m_end.exchangeAddSync(1);
+        const uint sequence = m_sequence.value.load(std::memory_order_acquire);
+        const Slot &slot = m_slots[(sequence >> 1) & 1];
+        Word words[WordCount];
+        for (uint i = 0; i < WordCount; i++) {
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        //The slot is only written again by the writer after the next one
+        if (m_sequence.value.load(std::memory_order_relaxed) - (sequence & ~1u) > 2) {
+            return false;
+        }
+        memcpy(&state, words, sizeof(E));
+        return true;
     }
 
-private:
-    mutable VAtomicInt m_begin;
-    mutable VAtomicInt m_end;
-    E m_slot[2];
+    //A cache line apart from each other, so that readers of the published slot don't share one
+    //with a writer filling the other. Padded rather than aligned, as operator new doesn't
+    //honour an alignment over that of max_align_t and VLockless members live on the heap.
+    enum { CacheLine = 64 };
+
+    struct Sequence
+    {
+        char before[CacheLine];
+        std::atomic<uint> value;
+        char after[CacheLine];
+    };
+
+    struct Slot
+    {
+        std::atomic<Word> words[WordCount];
+        char after[CacheLine];
+    };
+
+    Sequence m_sequence;
+    Slot m_slots[2];
+
+    NV_DISABLE_COPY(VLockless)
 };
 
 NV_NAMESPACE_END
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "vglobal.h"
+
+#include <atomic>
+#include <string.h>
+
+NV_NAMESPACE_BEGIN
+
+// The last elements appended by one thread, readable from any number of threads without locks,
+// like a VCircularQueue that only grows at the back and drops from the front when full.
+//
+// Elements are numbered from 0 in the order they were appended. Each slot carries a sequence
+// number telling which element it holds and whether it is being written, so readers copy an
+// element and then check that it wasn't overwritten meanwhile. As in VLockless, elements are
+// copied word by word through relaxed atomics and have to be trivially copyable.
+template <class E>
+class VLocklessRing
+{
+    //Copied as words, which only holds for trivially copyable types
+    static_assert(__has_trivial_copy(E), "the elements must be trivially copyable");
+
+public:
+    //The capacity is rounded up to a power of 2
+    VLocklessRing(uint capacity = 1024)
+    {
+        m_count.value.store(0, std::memory_order_relaxed);
+        m_capacity = 1;
+        while (m_capacity < capacity) {
+            m_capacity <<= 1;
+        }
+        m_slots = new Slot[m_capacity];
+        for (uint i = 0; i < m_capacity; i++) {
+            m_slots[i].sequence.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ~VLocklessRing()
+    {
+        delete[] m_slots;
+    }
+
+    uint capacity() const { return m_capacity; }
+
+    //Elements ever appended, the next element is numbered count()
+    vint64 count() const { return m_count.value.load(std::memory_order_acquire); }
+
+    //Number of the oldest element still held
+    vint64 first() const
+    {
+        const vint64 count = this->count();
+        return count > m_capacity ? count - m_capacity : 0;
+    }
+
+    bool isEmpty() const { return count() == 0; }
+
+    //Only ever from one thread at a time
+    void append(const E &element)
+    {
+        Word words[WordCount];
+        words[WordCount - 1] = 0;
+        memcpy(words, &element, sizeof(E));
+
+        const vint64 index = m_count.value.load(std::memory_order_relaxed);
+        Slot &slot = m_slots[index & (m_capacity - 1)];
+        slot.sequence.store(Sequence(index) - 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (uint i = 0; i < WordCount; i++) {
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        }
+        slot.sequence.store(Sequence(index), std::memory_order_release);
+        m_count.value.store(index + 1, std::memory_order_release);
+    }
+
+    //Copies element number index, false if it isn't there yet or was dropped already
+    bool at(vint64 index, E &element) const
+    {
+        if (index < 0) {
+            return false;
+        }
+        const Slot &slot = m_slots[index & (m_capacity - 1)];
+        const uint sequence = Sequence(index);
+        if (slot.sequence.load(std::memory_order_acquire) != sequence) {
+            return false;
+        }
+        Word words[WordCount];
+        for (uint i = 0; i < WordCount; i++) {
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+            return false;
+        }
+        memcpy(&element, words, sizeof(E));
+        return true;
+    }
+
+    //The newest element, false if none was appended
+    bool last(E &element) const
+    {
+        //Can only fail if the writer went round the whole ring meanwhile
+        forever {
+            const vint64 count = this->count();
+            if (count == 0) {
+                return false;
+            }
+            if (at(count - 1, element)) {
+                return true;
+            }
+        }
+    }
+
+private:
+    typedef uint Word;
+    enum { WordCount = (sizeof(E) + sizeof(Word) - 1) / sizeof(Word) };
+
+    //Even when the slot holds element index, odd while it is written
+    static uint Sequence(vint64 index) { return static_cast<uint>(index + 1) << 1; }
+
+    struct Slot
+    {
+        std::atomic<uint> sequence;
+        std::atomic<Word> words[WordCount];
+    };
+
+    //On a cache line of its own, readers poll it while the writer fills slots. Padded rather
+    //than aligned, as operator new doesn't honour an alignment over that of max_align_t.
+    enum { CacheLine = 64 };
+
+    struct Count
+    {
+        char before[CacheLine];
+        std::atomic<vint64> value;
+        char after[CacheLine];
+    };
+
+    uint m_capacity;
+    Slot *m_slots;
+    Count m_count;
+
+    NV_DISABLE_COPY(VLocklessRing)
+};
+
+NV_NAMESPACE_END
@@ -1,153 +1,744 @@
 #include "VLog.h"
+#include "VArray.h"
+#include "VSemaphore.h"
+#include "VThread.h"
 
-#include <sstream>
+#include <algorithm>
+#include <mutex>
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
 
 #ifdef ANDROID
 #include <android/log.h>
-#else
-#include <iostream>
 #endif
 
 NV_NAMESPACE_BEGIN
 
+namespace {
+    // Arguments are recorded tagged and unformatted, the logger thread turns them into text
+    enum ArgumentType
+    {
+        TextArgument,
+        Utf16Argument,
+        SignedArgument,
+        UnsignedArgument,
+        DoubleArgument,
+        PointerArgument
+    };
+
+    // Messages whose arguments take more are truncated
+    const uint RecordSize = 1024;
+    // Formatted, an argument never takes more than 3 times its record
+    const uint TextSize = RecordSize * 3 + 8;
+
+    struct Record
+    {
+        VLog::Priority priority;
+        const char *file;
+        uint line;
+        uint thread;
+        vint64 time;
+        bool truncated;
+        uint size;
+        uchar data[RecordSize];
+    };
+
+    vint64 Now()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return static_cast<vint64>(now.tv_sec) * 1000000000 + now.tv_nsec;
+    }
+
+    template<typename T>
+    T Read(const uchar *&in)
+    {
+        T value;
+        memcpy(&value, in, sizeof(T));
+        in += sizeof(T);
+        return value;
+    }
+
+    template<typename... Args>
+    void Print(char *&out, const char *end, const char *format, Args... args)
+    {
+        const int length = snprintf(out, end - out, format, args...);
+        out += std::min<int>(std::max(length, 0), end - out - 1);
+    }
+
+    void PrintUtf16(char *&out, const char *end, const char16_t *str, uint size)
+    {
+        for (uint i = 0; i < size && end - out > 4; i++) {
+            uint code = str[i];
+            if (code < 0x80) {
+                *out++ = static_cast<char>(code);
+                continue;
+            }
+            if (code >= 0xd800 && code <= 0xdbff && i + 1 < size && str[i + 1] >= 0xdc00 && str[i + 1] <= 0xdfff) {
+                code = ((code - 0xd800) << 10) + (str[++i] - 0xdc00) + 0x10000;
+            }
+            if (code <= 0x7ff) {
+                *out++ = static_cast<char>(0xc0 | (code >> 6));
+            } else {
+                if (code <= 0xffff) {
+                    *out++ = static_cast<char>(0xe0 | (code >> 12));
+                } else {
+                    *out++ = static_cast<char>(0xf0 | (code >> 18));
+                    *out++ = static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+                }
+                *out++ = static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+            }
+            *out++ = static_cast<char>(0x80 | (code & 0x3f));
+        }
+    }
+
+    // Writes the arguments separated by spaces to text, which holds TextSize bytes
+    VLog::Message Format(const Record &record, char *text)
+    {
+        //Room for the truncation mark and the terminator
+        const char *end = text + TextSize - 5;
+        char *out = text;
+        const uchar *in = record.data;
+        const uchar *last = record.data + record.size;
+        while (in < last) {
+            if (out != text) {
+                *out++ = ' ';
+            }
+            switch (*in++) {
+            case TextArgument: {
+                const uint size = Read<ushort>(in);
+                const uint count = std::min<uint>(size, end - out);
+                memcpy(out, in, count);
+                out += count;
+                in += size;
+                break;
+            }
+            case Utf16Argument: {
+                const uint size = Read<ushort>(in);
+                char16_t units[RecordSize / sizeof(char16_t)];
+                memcpy(units, in, size * sizeof(char16_t));
+                PrintUtf16(out, end, units, size);
+                in += size * sizeof(char16_t);
+                break;
+            }
+            case SignedArgument:
+                Print(out, end, "%lld", Read<long long>(in));
+                break;
+            case UnsignedArgument:
+                Print(out, end, "%llu", Read<ulonglong>(in));
+                break;
+            case DoubleArgument:
+                Print(out, end, "%g", Read<double>(in));
+                break;
+            case PointerArgument:
+                Print(out, end, "%p", Read<const void *>(in));
+                break;
+            }
+        }
+        if (record.truncated) {
+            memcpy(out, " ...", 4);
+            out += 4;
+        }
+        *out = '\0';
+
+        const VLog::Message message = {record.priority, record.file, record.line, record.thread, record.time, text, static_cast<uint>(out - text)};
+        return message;
+    }
+
+    void WriteDefault(const VLog::Message &message)
+    {
+#ifdef ANDROID
+        __android_log_print(message.priority, message.file, "[Line %u] %s", message.line, message.text);
+#else
+        fprintf(stdout, "%s [Line %u] %s\n", message.file, message.line, message.text);
+#endif
+    }
+
+    uint CurrentThreadId()
+    {
+#ifdef ANDROID
+        return gettid();
+#else
+        return syscall(SYS_gettid);
+#endif
+    }
+
+    struct Filter
+    {
+        VByteArray pattern;
+        VLog::Priority priority;
+    };
+
+    struct Filters
+    {
+        std::mutex mutex;
+        VLog::Priority priority;
+        VArray<Filter> patterns;
+
+        Filters() : priority(VLog::Verbose) {}
+
+        VLog::Priority resolve(const char *file) const
+        {
+            VLog::Priority result = priority;
+            uint matched = 0;
+            for (const Filter &filter : patterns) {
+                if (filter.pattern.size() > matched && strstr(file, filter.pattern.data())) {
+                    result = filter.priority;
+                    matched = filter.pattern.size();
+                }
+            }
+            return result;
+        }
+
+        static Filters &Instance()
+        {
+            static Filters filters;
+            return filters;
+        }
+    };
+
+    // A bounded ring in the style of VEventLoop, every slot carries a sequence number. Any
+    // thread produces, the logger thread consumes until it is shut down, the producers after.
+    class Logger
+    {
+    public:
+        static const uint Capacity = 256;
+
+        static Logger &Instance()
+        {
+            //Never destroyed so that static destructors can still log, shut down at exit instead
+            static Logger *logger = new Logger;
+            return *logger;
+        }
+
+        bool post(const Record &record)
+        {
+            Slot *slot;
+            uint pos = m_tail.load(std::memory_order_relaxed);
+            forever {
+                slot = &m_slots[pos & (Capacity - 1)];
+                const uint sequence = slot->sequence.load(std::memory_order_acquire);
+                const int diff = static_cast<int>(sequence - pos);
+                if (diff == 0) {
+                    if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                } else {
+                    pos = m_tail.load(std::memory_order_relaxed);
+                }
+            }
+
+            memcpy(&slot->record, &record, offsetof(Record, data) + record.size);
+            slot->sequence.store(pos + 1, std::memory_order_release);
+
+            //Ordered against shutdown(), which stops the thread and then drains what is left, and
+            //against the logger thread going idle
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_stopped.load(std::memory_order_relaxed)) {
+                if (!isDraining()) {
+                    drain();
+                }
+                return true;
+            }
+
+            //Waking the logger costs a system call, only the first message after it went idle pays it
+            if (m_idle.load(std::memory_order_relaxed) && m_idle.exchange(false, std::memory_order_relaxed)) {
+                m_posted.post();
+            }
+            return true;
+        }
+
+        void flush()
+        {
+            //A sink that logs would wait for itself
+            if (isLoggerThread()) {
+                return;
+            }
+            if (m_stopped.load(std::memory_order_acquire)) {
+                if (!isDraining()) {
+                    drain();
+                }
+                return;
+            }
+            const uint target = m_tail.load(std::memory_order_acquire);
+            m_posted.post();
+            while (static_cast<int>(m_written.load(std::memory_order_acquire) - target) < 0) {
+                usleep(1000);
+            }
+        }
+
+        void write(const Record &record)
+        {
+            std::lock_guard<std::mutex> locker(m_sinkMutex);
+            m_sink(Format(record, m_text));
+#ifndef ANDROID
+            fflush(stdout);
+#endif
+        }
+
+        void setSink(const VLog::Sink &sink)
+        {
+            std::lock_guard<std::mutex> locker(m_sinkMutex);
+            m_sink = sink ? sink : VLog::Sink(WriteDefault);
+        }
+
+        void shutdown()
+        {
+            if (isLoggerThread() || m_stopping.exchange(true)) {
+                return;
+            }
+            m_posted.post();
+            m_thread.wait();
+            m_stopped.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            //Whatever was posted while the thread exited
+            drain();
+        }
+
+        void start()
+        {
+            if (!m_stopped.load(std::memory_order_acquire)) {
+                return;
+            }
+            m_stopping.store(false, std::memory_order_relaxed);
+            if (!m_thread.start()) {
+                m_stopping.store(true, std::memory_order_relaxed);
+                return;
+            }
+            //Until then the producers keep draining the ring themselves
+            m_stopped.store(false, std::memory_order_release);
+        }
+
+        uint dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    private:
+        struct Slot
+        {
+            std::atomic<uint> sequence;
+            Record record;
+        };
+
+        Logger()
+            : m_slots(new Slot[Capacity])
+            , m_head(0)
+            , m_tail(0)
+            , m_written(0)
+            , m_dropped(0)
+            , m_reportedDrops(0)
+            , m_stopping(false)
+            , m_stopped(false)
+            , m_idle(false)
+            , m_drainer(0)
+            , m_sink(WriteDefault)
+            , m_thread(&Logger::Run, this)
+        {
+            for (uint i = 0; i < Capacity; i++) {
+                m_slots[i].sequence.store(i, std::memory_order_relaxed);
+            }
+            m_thread.setName("VLog");
+            if (!m_thread.start()) {
+                //Nothing would consume the ring, the callers write their messages themselves
+                m_stopping = true;
+                m_stopped = true;
+            }
+            atexit(VLog::Shutdown);
+        }
+
+        bool isLoggerThread() const
+        {
+            return m_thread.tid() != 0 && static_cast<uint>(m_thread.tid()) == CurrentThreadId();
+        }
+
+        //A sink that logs once the thread stopped leaves its messages to the drain it runs in
+        bool isDraining() const
+        {
+            return m_drainer.load(std::memory_order_relaxed) == CurrentThreadId();
+        }
+
+        static int Run(void *data)
+        {
+            Logger *logger = static_cast<Logger *>(data);
+            //Drains once more after the request, so that nothing posted before shutdown() is left
+            bool stopping = false;
+            while (!stopping) {
+                //Blocks until a producer finds it idle, or flush() or shutdown() wake it
+                logger->m_idle.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (logger->isEmpty()) {
+                    logger->m_posted.wait();
+                }
+                logger->m_idle.store(false, std::memory_order_relaxed);
+                stopping = logger->m_stopping.load(std::memory_order_acquire);
+                logger->drain();
+            }
+            return 0;
+        }
+
+        bool isEmpty() const
+        {
+            const uint pos = m_head.load(std::memory_order_relaxed);
+            return m_slots[pos & (Capacity - 1)].sequence.load(std::memory_order_relaxed) != pos + 1;
+        }
+
+        //Writes the records posted so far to the sink, on the logger thread or once it stopped
+        void drain()
+        {
+            std::lock_guard<std::mutex> locker(m_sinkMutex);
+            m_drainer.store(CurrentThreadId(), std::memory_order_relaxed);
+            uint pos = m_head.load(std::memory_order_relaxed);
+            forever {
+                Slot &slot = m_slots[pos & (Capacity - 1)];
+                if (slot.sequence.load(std::memory_order_acquire) != pos + 1) {
+                    break;
+                }
+                m_sink(Format(slot.record, m_text));
+                slot.sequence.store(pos + Capacity, std::memory_order_release);
+                pos++;
+                m_head.store(pos, std::memory_order_relaxed);
+                m_written.store(pos, std::memory_order_release);
+            }
+
+            const uint drops = dropped();
+            if (drops != m_reportedDrops) {
+                VLog::Message message = {VLog::Warn, __FILE__, __LINE__, 0, Now(), m_text, 0};
+                message.length = snprintf(m_text, TextSize, "VLog: %u messages dropped", drops - m_reportedDrops);
+                m_sink(message);
+                m_reportedDrops = drops;
+            }
+#ifndef ANDROID
+            fflush(stdout);
+#endif
+            m_drainer.store(0, std::memory_order_relaxed);
+        }
+
+        Slot *m_slots;
+        std::atomic<uint> m_head;
+        std::atomic<uint> m_tail;
+        std::atomic<uint> m_written;
+        std::atomic<uint> m_dropped;
+        uint m_reportedDrops;
+        VSemaphore m_posted;
+        std::atomic<bool> m_stopping;
+        std::atomic<bool> m_stopped;
+        std::atomic<bool> m_idle;
+        std::atomic<uint> m_drainer;
+
+        std::mutex m_sinkMutex;
+        VLog::Sink m_sink;
+        char m_text[TextSize];
+        VThread m_thread;
+    };
+
+}
+
+// The record of a thread is allocated once and reused by every message. A message logged while
+// another is being recorded on the same thread gets a record of its own.
 struct VLog::Private
 {
-    const char *file;
-    uint line;
-    VLog::Priority priority;
-    std::stringstream buffer;
+    Record record;
+    bool busy;
+
+    Private() : busy(false) { record.thread = CurrentThreadId(); }
+
+    static pthread_key_t Key()
+    {
+        static pthread_key_t key = CreateKey();
+        return key;
+    }
+
+    static pthread_key_t CreateKey()
+    {
+        pthread_key_t key;
+        pthread_key_create(&key, [](void *buffer) { delete static_cast<Private *>(buffer); });
+        return key;
+    }
+
+    static Private *Acquire()
+    {
+        const pthread_key_t key = Key();
+        Private *buffer = static_cast<Private *>(pthread_getspecific(key));
+        if (buffer == nullptr) {
+            buffer = new Private;
+            pthread_setspecific(key, buffer);
+        } else if (buffer->busy) {
+            return new Private;
+        }
+        buffer->busy = true;
+        return buffer;
+    }
+
+    void release()
+    {
+        if (busy) {
+            busy = false;
+        } else {
+            delete this;
+        }
+    }
+
+    template<typename T>
+    void append(ArgumentType type, T value)
+    {
+        if (record.truncated || record.size + 1 + sizeof(T) > RecordSize) {
+            record.truncated = true;
+            return;
+        }
+        record.data[record.size] = type;
+        memcpy(record.data + record.size + 1, &value, sizeof(T));
+        record.size += 1 + sizeof(T);
+    }
+
+    //What doesn't fit is cut
+    void append(ArgumentType type, const void *str, uint count, uint unitSize)
+    {
+        const uint header = 1 + sizeof(ushort);
+        if (record.truncated || record.size + header >= RecordSize) {
+            record.truncated = true;
+            return;
+        }
+        const uint room = (RecordSize - record.size - header) / unitSize;
+        if (count > room) {
+            count = room;
+            record.truncated = true;
+        }
+        const ushort size = count;
+        record.data[record.size] = type;
+        memcpy(record.data + record.size + 1, &size, sizeof(size));
+        memcpy(record.data + record.size + header, str, count * unitSize);
+        record.size += header + count * unitSize;
+    }
 };
 
+std::atomic<uint> VLog::Generation(1);
+
 VLog::VLog(const char *file, uint line, VLog::Priority priority)
-    : d(new Private)
+    : d(Private::Acquire())
 {
-    d->file = file;
-    d->line = line;
-    d->priority = priority;
+    d->record.priority = priority;
+    d->record.file = file;
+    d->record.line = line;
+    d->record.truncated = false;
+    d->record.size = 0;
 }
 
 VLog::~VLog()
 {
-#ifdef ANDROID
-    __android_log_print(d->priority, d->file, "[Line %u] %s", d->line, d->buffer.str().data());
-#else
-    std::cout << d->file << " [Line " << d->line << "] " << d->buffer.str() << std::endl;
-#endif
-    delete d;
+    d->record.time = Now();
+    if (d->record.priority >= Fatal) {
+        //The process is about to die, what was logged before is written out first
+        Logger &logger = Logger::Instance();
+        logger.flush();
+        logger.write(d->record);
+    } else {
+        Logger::Instance().post(d->record);
+    }
+    d->release();
 }
 
 VLog &VLog::operator << (char ch)
 {
-    d->buffer << ch << ' ';
+    d->append(TextArgument, &ch, 1, 1);
     return *this;
 }
 
 VLog &VLog::operator << (ulong num)
 {
-    d->buffer << num << ' ';
+    d->append(UnsignedArgument, static_cast<ulonglong>(num));
     return *this;
 }
 
 VLog &VLog::operator << (char16_t ch)
 {
-    d->buffer << ch << ' ';
+    d->append(UnsignedArgument, static_cast<ulonglong>(ch));
     return *this;
 }
 
 VLog &VLog::operator << (char32_t ch)
 {
-    d->buffer << ch << ' ';
+    d->append(UnsignedArgument, static_cast<ulonglong>(ch));
     return *this;
 }
 
 VLog &VLog::operator << (short num)
 {
-    d->buffer << num << ' ';
+    d->append(SignedArgument, static_cast<long long>(num));
     return *this;
 }
 
 VLog &VLog::operator << (ushort num)
 {
-    d->buffer << num << ' ';
+    d->append(UnsignedArgument, static_cast<ulonglong>(num));
     return *this;
 }
 
 VLog &VLog::operator << (int num)
 {
-    d->buffer << num << ' ';
+    d->append(SignedArgument, static_cast<long long>(num));
     return *this;
 }
 
 VLog &VLog::operator << (uint num)
 {
-    d->buffer << num << ' ';
+    d->append(UnsignedArgument, static_cast<ulonglong>(num));
     return *this;
 }
 
 VLog &VLog::operator << (float num)
 {
-    d->buffer << num << ' ';
+    d->append(DoubleArgument, static_cast<double>(num));
     return *this;
 }
 
 VLog &VLog::operator << (double num)
 {
-    d->buffer << num << ' ';
+    d->append(DoubleArgument, num);
     return *this;
 }
 
 VLog &VLog::operator <<(long num)
 {
-    d->buffer << num << ' ';
+    d->append(SignedArgument, static_cast<long long>(num));
     return *this;
 }
 
 VLog &VLog::operator <<(long long num)
 {
-    d->buffer << num << ' ';
+    d->append(SignedArgument, num);
     return *this;
 }
 
 VLog &VLog::operator <<(ulonglong num)
 {
-    d->buffer << num << ' ';
+    d->append(UnsignedArgument, num);
     return *this;
 }
 
 VLog &VLog::operator <<(void *pointer)
 {
-    d->buffer << pointer << ' ';
+    d->append(PointerArgument, static_cast<const void *>(pointer));
     return *this;
 }
 
 VLog &VLog::operator << (const void *pointer)
 {
-    d->buffer << pointer << ' ';
+    d->append(PointerArgument, pointer);
     return *this;
 }
 
 VLog &VLog::operator << (const char *str)
 {
-    d->buffer << str << ' ';
+    if (str == nullptr) {
+        str = "(null)";
+    }
+    d->append(TextArgument, str, strlen(str), 1);
     return *this;
 }
 
 VLog &VLog::operator << (const VString &str)
 {
-    d->buffer << str << ' ';
+    d->append(Utf16Argument, str.data(), str.size(), sizeof(char16_t));
     return *this;
 }
 
 VLog &VLog::operator << (const VByteArray &str)
 {
-    d->buffer << str << ' ';
+    d->append(TextArgument, str.data(), str.size(), 1);
+    return *this;
+}
+
+VLog &VLog::operator << (const VByteArrayView &str)
+{
+    d->append(TextArgument, str.data(), str.size(), 1);
     return *this;
 }
 
 VLog &VLog::operator <<(const std::string &str)
 {
-    d->buffer << str << ' ';
+    d->append(TextArgument, str.data(), str.size(), 1);
     return *this;
 }
 
+void VLog::SetPriority(Priority priority)
+{
+    Filters &filters = Filters::Instance();
+    std::lock_guard<std::mutex> locker(filters.mutex);
+    filters.priority = priority;
+    Generation++;
+}
+
+void VLog::SetPriority(const char *pattern, Priority priority)
+{
+    Filters &filters = Filters::Instance();
+    std::lock_guard<std::mutex> locker(filters.mutex);
+    for (Filter &filter : filters.patterns) {
+        if (filter.pattern == pattern) {
+            filter.priority = priority;
+            Generation++;
+            return;
+        }
+    }
+    Filter filter = {pattern, priority};
+    filters.patterns.append(filter);
+    Generation++;
+}
+
+void VLog::ResetPriorities()
+{
+    Filters &filters = Filters::Instance();
+    std::lock_guard<std::mutex> locker(filters.mutex);
+    filters.priority = Verbose;
+    filters.patterns.clear();
+    Generation++;
+}
+
+uint VLog::Resolve(Site &site)
+{
+    Filters &filters = Filters::Instance();
+    std::lock_guard<std::mutex> locker(filters.mutex);
+    //The generation only changes under the lock
+    const uint state = (Generation.load(std::memory_order_relaxed) << 8) | filters.resolve(site.file);
+    site.state.store(state, std::memory_order_relaxed);
+    return state;
+}
+
+void VLog::SetSink(const Sink &sink)
+{
+    Logger::Instance().setSink(sink);
+}
+
+VLog::Sink VLog::DefaultSink()
+{
+    return WriteDefault;
+}
+
+void VLog::Flush()
+{
+    Logger::Instance().flush();
+}
+
+void VLog::Shutdown()
+{
+    Logger::Instance().shutdown();
+}
+
+void VLog::Init()
+{
+    Logger::Instance().start();
+}
+
+uint VLog::DroppedCount()
+{
+    return Logger::Instance().dropped();
+}
+
 NV_NAMESPACE_END
@@ -3,8 +3,18 @@
 #include "vglobal.h"
 #include "VString.h"
 
+#include <atomic>
+#include <functional>
+
 NV_NAMESPACE_BEGIN
 
+// The calling thread only records the arguments of a message, unformatted, in a buffer of its
+// own and hands the record over through a lock-free ring to a logger thread, which formats it
+// and writes it to the sink. The calling thread doesn't wait for the sink, but it isn't entirely
+// free of allocations and locks: its buffer is allocated on its first message, and again for a
+// message logged while another is being recorded on the same thread, and a call site takes a
+// lock the first time it is reached and after the priorities change. When the ring is full the
+// message is dropped and counted.
 class VLog
 {
 public:
@@ -22,6 +32,28 @@ public:
         Silent,
     };
 
+    struct Message
+    {
+        Priority priority;
+        const char *file;
+        uint line;
+        uint thread;
+        //Nanoseconds on the monotonic clock
+        vint64 time;
+        //Null-terminated
+        const char *text;
+        uint length;
+    };
+
+    typedef std::function<void(const Message &)> Sink;
+
+    //A call site of the logging macros, caching the priority its file is filtered at
+    struct Site
+    {
+        const char *file;
+        std::atomic<uint> state;
+    };
+
     VLog(const char *file, uint line, Priority priority);
     ~VLog();
 
@@ -45,29 +77,70 @@ public:
     VLog &operator << (const char *str);
     VLog &operator << (const VString &str);
     VLog &operator << (const VByteArray &str);
+    VLog &operator << (const VByteArrayView &str);
     VLog &operator << (const std::string &str);
 
+    //Messages below priority are discarded at the call site, Verbose by default
+    static void SetPriority(Priority priority);
+    //Overrides the priority of the files whose path contains pattern, the longest pattern wins
+    static void SetPriority(const char *pattern, Priority priority);
+    static void ResetPriorities();
+
+    static bool IsEnabled(Site &site, Priority priority)
+    {
+        uint state = site.state.load(std::memory_order_relaxed);
+        if ((state >> 8) != (Generation.load(std::memory_order_relaxed) & 0xffffff)) {
+            state = Resolve(site);
+        }
+        return priority >= static_cast<Priority>(state & 0xff);
+    }
+
+    //Runs on the logger thread. An empty sink restores logcat, or stdout off Android.
+    static void SetSink(const Sink &sink);
+    static Sink DefaultSink();
+
+    //Blocks until every message logged so far has reached the sink
+    static void Flush();
+    //Writes out the messages left and stops the logger thread, the messages logged afterwards
+    //are written by the threads logging them. Called at exit.
+    static void Shutdown();
+    //Starts the logger thread again after Shutdown(), which it must not run concurrently with.
+    //The thread is started with the first message otherwise.
+    static void Init();
+
+    //Messages lost because the ring was full
+    static uint DroppedCount();
+
 private:
+    static uint Resolve(Site &site);
+    static std::atomic<uint> Generation;
+
     NV_DECLARE_PRIVATE
     NV_DISABLE_COPY(VLog)
 };
 
-#if 1
-#  define vVerbose(args) { VLog(__FILE__, __LINE__, VLog::Verbose) << args ; }
-#  define vDebug(args) { VLog(__FILE__, __LINE__, VLog::Debug) << args ; }
-#  define vInfo(args) { VLog(__FILE__, __LINE__, VLog::Info) << args ; }
-#  define vWarn(args) { VLog(__FILE__, __LINE__, VLog::Warn) << args ; }
-#  define vError(args) { VLog(__FILE__, __LINE__, VLog::Error) << args ; }
-#  define vFatal(args) { VLog(__FILE__, __LINE__, VLog::Error) << args; __builtin_trap() ; }
-#  define vAssert(expr) { if (!(expr)) { vFatal(#expr); } }
-#else
-#  define vVerbose(args)
-#  define vDebug(args)
-#  define vInfo(args)
-#  define vWarn(args)
-#  define vError(args)
-#  define vFatal(args)
-#  define vAssert(expr)
+// Levels below the minimum are compiled out along with their arguments, e.g. build releases
+// with -DNV_LOG_MINIMUM_PRIORITY=VLog::Info
+#ifndef NV_LOG_MINIMUM_PRIORITY
+#  define NV_LOG_MINIMUM_PRIORITY VLog::Verbose
 #endif
 
+#define vLog(priority, args) {\
+    if ((priority) >= NV_LOG_MINIMUM_PRIORITY) {\
+        static VLog::Site vLogSite = {__FILE__, {0}};\
+        if (VLog::IsEnabled(vLogSite, (priority))) {\
+            VLog(__FILE__, __LINE__, (priority)) << args;\
+        }\
+    }\
+}
+
+#define vVerbose(args) vLog(VLog::Verbose, args)
+#define vDebug(args) vLog(VLog::Debug, args)
+#define vInfo(args) vLog(VLog::Info, args)
+#define vWarn(args) vLog(VLog::Warn, args)
+#define vError(args) vLog(VLog::Error, args)
+//Written out synchronously before trapping
+#define vFatal(args) { VLog(__FILE__, __LINE__, VLog::Fatal) << args; __builtin_trap(); }
+#define vAssert(expr) { if (!(expr)) { vFatal(#expr); } }
+
 NV_NAMESPACE_END
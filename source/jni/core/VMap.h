@@ -23,7 +23,8 @@ public:
 
     const Value &value(const Key &key) const
     {
-        return contains(key) ? ParentType::at(key) : defaultValue;
+        ConstIterator i = ParentType::find(key);
+        return i != ParentType::end() ? i->second : defaultValue;
     }
 
     Value &operator[](const Key &key) { return ParentType::operator[](key); }
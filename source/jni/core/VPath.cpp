@@ -132,6 +132,19 @@ VString VPath::extension() const
     return VString();
 }
 
+VByteArrayView VPath::Extension(const VByteArrayView &path)
+{
+    for (int i = path.length() - 1; i >= 0; i--) {
+        if (path[i] == '/' || path[i] == '\\') {
+            break;
+        }
+        if (path[i] == '.') {
+            return path.mid(i + 1, path.size() - i - 1);
+        }
+    }
+    return VByteArrayView();
+}
+
 VString VPath::fileName() const
 {
     if (isEmpty()) {
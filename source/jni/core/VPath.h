@@ -23,6 +23,8 @@ public:
     bool hasExtension() const;
     void setExtension(const VString &ext);
     VString extension() const;
+    //Same as extension() on a UTF-8 path, the result points into path
+    static VByteArrayView Extension(const VByteArrayView &path);
 
     VString fileName() const;
     VString baseName() const;
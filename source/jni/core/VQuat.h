@@ -202,6 +202,21 @@ public:
         return (*this * sign * a + other * (1-a)).Normalized();
     }
 
+    // Spherical linear interpolation along the shorter arc, from this at 0 to other at 1
+    VQuat Slerp(const VQuat &other, T a) const
+    {
+        T cosAngle = Dot(other);
+        const VQuat target = cosAngle < 0 ? other * T(-1) : other;
+        cosAngle = fabs(cosAngle);
+        // Nearly equal rotations, where sin() of the angle loses precision
+        if (cosAngle > T(0.9995)) {
+            return (*this * (1 - a) + target * a).Normalized();
+        }
+        const T angle = acos(cosAngle);
+        const T rcpSin = T(1) / sin(angle);
+        return *this * (sin((1 - a) * angle) * rcpSin) + target * (sin(a * angle) * rcpSin);
+    }
+
     // Rotate transforms vector in a manner that matches Matrix rotations (counter-clockwise,
     // assuming negative diVRection of the VAxis). Standard formula: q(t) * V * q(t)^-1.
     VVect3<T> Rotate(const VVect3<T>& v) const
@@ -1,6 +1,8 @@
 #include "VSemaphore.h"
 
+#include <errno.h>
 #include <semaphore.h>
+#include <time.h>
 
 NV_NAMESPACE_BEGIN
 
@@ -26,6 +28,25 @@ bool VSemaphore::wait()
     return sem_wait(&d->sem) == 0;
 }
 
+bool VSemaphore::wait(uint msecs)
+{
+    //sem_timedwait() takes an absolute time on the realtime clock
+    timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += msecs / 1000;
+    deadline.tv_nsec += (msecs % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    int result;
+    do {
+        result = sem_timedwait(&d->sem, &deadline);
+    } while (result != 0 && errno == EINTR);
+    return result == 0;
+}
+
 bool VSemaphore::post()
 {
     return sem_post(&d->sem) == 0;
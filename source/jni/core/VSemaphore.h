@@ -11,6 +11,8 @@ public:
     ~VSemaphore();
 
     bool wait();
+    //Returns false if nothing was posted within msecs milliseconds
+    bool wait(uint msecs);
     bool post();
 
     int available() const;
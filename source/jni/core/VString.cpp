@@ -1,11 +1,224 @@
 #include "VString.h"
 
+#include <algorithm>
 #include <stdarg.h>
 #include <sstream>
 
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 NV_NAMESPACE_BEGIN
 
 namespace {
+    // ASCII and Latin-1 text is converted 16 code units at a time, anything else falls back to
+    // the scalar UTF-8 coder one character at a time.
+
+    // Length of the ASCII prefix of a byte string
+    uint AsciiLength(const uchar *str, uint length)
+    {
+        uint i = 0;
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+        for (; i + 16 <= length; i += 16) {
+            const uint8x16_t bytes = vld1q_u8(str + i);
+            const uint8x8_t folded = vorr_u8(vget_low_u8(bytes), vget_high_u8(bytes));
+            if (vget_lane_u64(vreinterpret_u64_u8(folded), 0) & 0x8080808080808080ull) {
+                break;
+            }
+        }
+#elif defined(__SSE2__)
+        for (; i + 16 <= length; i += 16) {
+            if (_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(str + i)))) {
+                break;
+            }
+        }
+#endif
+        while (i < length && str[i] < 0x80) {
+            i++;
+        }
+        return i;
+    }
+
+    // Zero-extends bytes to code units
+    void Widen(const uchar *in, uint length, char16_t *out)
+    {
+        uint i = 0;
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+        for (; i + 16 <= length; i += 16) {
+            const uint8x16_t bytes = vld1q_u8(in + i);
+            vst1q_u16(reinterpret_cast<uint16_t *>(out + i), vmovl_u8(vget_low_u8(bytes)));
+            vst1q_u16(reinterpret_cast<uint16_t *>(out + i + 8), vmovl_u8(vget_high_u8(bytes)));
+        }
+#elif defined(__SSE2__)
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= length; i += 16) {
+            const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_unpacklo_epi8(bytes, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 8), _mm_unpackhi_epi8(bytes, zero));
+        }
+#endif
+        for (; i < length; i++) {
+            out[i] = in[i];
+        }
+    }
+
+    // Truncates code units to bytes
+    void Narrow(const char16_t *in, uint length, char *out)
+    {
+        uint i = 0;
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+        for (; i + 16 <= length; i += 16) {
+            const uint16x8_t low = vld1q_u16(reinterpret_cast<const uint16_t *>(in + i));
+            const uint16x8_t high = vld1q_u16(reinterpret_cast<const uint16_t *>(in + i + 8));
+            vst1q_u8(reinterpret_cast<uint8_t *>(out + i), vcombine_u8(vmovn_u16(low), vmovn_u16(high)));
+        }
+#elif defined(__SSE2__)
+        const __m128i mask = _mm_set1_epi16(0xff);
+        for (; i + 16 <= length; i += 16) {
+            const __m128i low = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)), mask);
+            const __m128i high = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 8)), mask);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(low, high));
+        }
+#endif
+        for (; i < length; i++) {
+            out[i] = static_cast<char>(in[i]);
+        }
+    }
+
+    // Narrows the ASCII prefix of a UTF-16 string and returns its length
+    uint NarrowAscii(const char16_t *in, uint length, char *out)
+    {
+        uint i = 0;
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+        for (; i + 16 <= length; i += 16) {
+            const uint16x8_t low = vld1q_u16(reinterpret_cast<const uint16_t *>(in + i));
+            const uint16x8_t high = vld1q_u16(reinterpret_cast<const uint16_t *>(in + i + 8));
+            const uint16x8_t both = vorrq_u16(low, high);
+            const uint16x4_t folded = vorr_u16(vget_low_u16(both), vget_high_u16(both));
+            if (vget_lane_u64(vreinterpret_u64_u16(folded), 0) & 0xff80ff80ff80ff80ull) {
+                break;
+            }
+            vst1q_u8(reinterpret_cast<uint8_t *>(out + i), vcombine_u8(vmovn_u16(low), vmovn_u16(high)));
+        }
+#elif defined(__SSE2__)
+        const __m128i mask = _mm_set1_epi16(static_cast<short>(0xff80));
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= length; i += 16) {
+            const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 8));
+            const __m128i nonAscii = _mm_and_si128(_mm_or_si128(low, high), mask);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(nonAscii, zero)) != 0xffff) {
+                break;
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(low, high));
+        }
+#endif
+        for (; i < length && in[i] < 0x80; i++) {
+            out[i] = static_cast<char>(in[i]);
+        }
+        return i;
+    }
+
+    // std::u16string::resize() fills one unit at a time, slower than the conversion itself, so
+    // text is converted into a buffer that stays in L1 and appended in bulk
+    const uint ChunkSize = 512;
+
+    void AppendLatin1(std::u16string &str, const uchar *in, uint length)
+    {
+        char16_t buffer[ChunkSize];
+        str.reserve(str.size() + length);
+        while (length > 0) {
+            const uint count = std::min(length, ChunkSize);
+            Widen(in, count, buffer);
+            str.append(buffer, count);
+            in += count;
+            length -= count;
+        }
+    }
+
+    const char16_t ReplacementCharacter = 0xfffd;
+
+    // Decodes the sequence at in, which doesn't start with an ASCII byte. Returns the number of
+    // code units written to out (1 or 2) and advances in.
+    uint DecodeUtf8(const uchar *&in, const uchar *end, char16_t *out)
+    {
+        const uchar lead = *in++;
+        uint following;
+        uint code;
+        uint minimum;
+        if (lead >= 0xc2 && lead <= 0xdf) {
+            following = 1;
+            code = lead & 0x1f;
+            minimum = 0x80;
+        } else if (lead >= 0xe0 && lead <= 0xef) {
+            following = 2;
+            code = lead & 0x0f;
+            minimum = 0x800;
+        } else if (lead >= 0xf0 && lead <= 0xf4) {
+            following = 3;
+            code = lead & 0x07;
+            minimum = 0x10000;
+        } else {
+            //Continuation bytes without a lead, overlong two-byte leads and leads past U+10FFFF
+            *out = ReplacementCharacter;
+            return 1;
+        }
+
+        for (uint i = 0; i < following; i++) {
+            if (in + i == end || (in[i] & 0xc0) != 0x80) {
+                //Resume at the byte that broke the sequence
+                in += i;
+                *out = ReplacementCharacter;
+                return 1;
+            }
+            code = (code << 6) | (in[i] & 0x3f);
+        }
+        in += following;
+
+        if (code < minimum || code > 0x10ffff || (code >= 0xd800 && code <= 0xdfff)) {
+            *out = ReplacementCharacter;
+            return 1;
+        }
+        if (code > 0xffff) {
+            code -= 0x10000;
+            out[0] = static_cast<char16_t>(0xd800 + (code >> 10));
+            out[1] = static_cast<char16_t>(0xdc00 + (code & 0x3ff));
+            return 2;
+        }
+        *out = static_cast<char16_t>(code);
+        return 1;
+    }
+
+    // Encodes the character at in, which isn't ASCII, and advances in. out must have room for 4 bytes.
+    uint EncodeUtf8(const char16_t *&in, const char16_t *end, char *out)
+    {
+        uint code = *in++;
+        if (code >= 0xd800 && code <= 0xdbff && in < end && *in >= 0xdc00 && *in <= 0xdfff) {
+            code = ((code - 0xd800) << 10) + (*in++ - 0xdc00) + 0x10000;
+        } else if (code >= 0xd800 && code <= 0xdfff) {
+            code = ReplacementCharacter;
+        }
+
+        if (code <= 0x7ff) {
+            out[0] = static_cast<char>(0xc0 | (code >> 6));
+            out[1] = static_cast<char>(0x80 | (code & 0x3f));
+            return 2;
+        }
+        if (code <= 0xffff) {
+            out[0] = static_cast<char>(0xe0 | (code >> 12));
+            out[1] = static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+            out[2] = static_cast<char>(0x80 | (code & 0x3f));
+            return 3;
+        }
+        out[0] = static_cast<char>(0xf0 | (code >> 18));
+        out[1] = static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+        out[2] = static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+        out[3] = static_cast<char>(0x80 | (code & 0x3f));
+        return 4;
+    }
+
     template<class C, class T>
     int StringCompare(const C *str1, const T *str2)
     {
@@ -55,19 +268,12 @@ VString::VString(const char *str)
 
 VString::VString(const std::string &str)
 {
-    uint size = str.size();
-    resize(str.size());
-    for (uint i = 0; i < size; i++) {
-        operator [](i) = str.at(i);
-    }
+    assign(str.data(), str.size());
 }
 
 VString::VString(const char *data, uint length)
 {
-    resize(length);
-    for (uint i = 0; i < length; i++) {
-        operator [](i) = data[i];
-    }
+    assign(data, length);
 }
 
 void VString::assign(const char *str)
@@ -82,9 +288,7 @@ void VString::assign(const char *str)
 
 void VString::append(const char *str, uint length)
 {
-    for (uint i = 0; i < length; i++) {
-        append(str[i]);
-    }
+    AppendLatin1(*this, reinterpret_cast<const uchar *>(str), length);
 }
 
 void VString::assign(const char *str, uint size)
@@ -94,10 +298,8 @@ void VString::assign(const char *str, uint size)
         return;
     }
 
-    resize(size);
-    for (uint i = 0; i < size; i++) {
-        operator [](i) = str[i];
-    }
+    clear();
+    AppendLatin1(*this, reinterpret_cast<const uchar *>(str), size);
 }
 
 void VString::assign(const char16_t *str)
@@ -108,9 +310,9 @@ void VString::assign(const char16_t *str)
     }
 
     uint size = 0;
-    while (str[size++]) {}
-    resize(size);
-
+    while (str[size]) {
+        size++;
+    }
     assign(str, size);
 }
 
@@ -244,108 +446,49 @@ VString operator + (char16_t ch, const VString &str)
 
 std::string VString::toStdString() const
 {
-    uint size = this->size();
-    std::string str;
-    str.resize(size);
-    for (uint i = 0; i < size; i++) {
-        str[i] = at(i);
-    }
-    return str;
+    return VStringView(*this).toLatin1();
 }
 
 VByteArray VString::toUtf8() const
 {
-    VByteArray utf8;
-    uint code = 0;
-    for (const char16_t &in : *this) {
-        if (in >= 0xd800 && in <= 0xdbff) {
-            code = ((in - 0xd800) << 10) + 0x10000;
-        } else {
-            if (in >= 0xdc00 && in <= 0xdfff) {
-                code |= in - 0xdc00;
-            } else {
-                code = in;
-            }
-
-            if (code <= 0x7f) {
-                utf8.append(static_cast<char>(code));
-            } else if (code <= 0x7ff) {
-                utf8.append(static_cast<char>(0xc0 | ((code >> 6) & 0x1f)));
-                utf8.append(static_cast<char>(0x80 | (code & 0x3f)));
-            } else if (code <= 0xffff) {
-                utf8.append(static_cast<char>(0xe0 | ((code >> 12) & 0x0f)));
-                utf8.append(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
-                utf8.append(static_cast<char>(0x80 | (code & 0x3f)));
-            } else {
-                utf8.append(static_cast<char>(0xf0 | ((code >> 18) & 0x07)));
-                utf8.append(static_cast<char>(0x80 | ((code >> 12) & 0x3f)));
-                utf8.append(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
-                utf8.append(static_cast<char>(0x80 | (code & 0x3f)));
-            }
-            code = 0;
-        }
-    }
-    return utf8;
+    return VStringView(*this).toUtf8();
 }
 
-VString VString::fromUtf8(const VByteArray &utf8)
+VString VString::fromUtf8(const VByteArrayView &utf8)
 {
+    //A code unit per byte at most
     VString utf16;
-    unsigned int code = 0;
-    int following = 0;
-    for (const uchar &ch : utf8) {
-        if (ch <= 0x7f) {
-            code = ch;
-            following = 0;
-        } else if (ch <= 0xbf) {
-            if (following > 0) {
-                code = (code << 6) | (ch & 0x3f);
-                --following;
-            }
-        } else if (ch <= 0xdf) {
-            code = ch & 0x1f;
-            following = 1;
-        } else if (ch <= 0xef) {
-            code = ch & 0x0f;
-            following = 2;
-        } else {
-            code = ch & 0x07;
-            following = 3;
-        }
-
-        if (following == 0) {
-            if (code > 0xffff) {
-                utf16.append(static_cast<char16_t>(0xd800 + (code >> 10)));
-                utf16.append(static_cast<char16_t>(0xdc00 + (code & 0x03ff)));
-            } else {
-                utf16.append(static_cast<char16_t>(code));
+    utf16.reserve(utf8.size());
+
+    const uchar *in = reinterpret_cast<const uchar *>(utf8.data());
+    const uchar *end = in + utf8.size();
+    char16_t buffer[ChunkSize];
+    //Leaves room for a surrogate pair
+    char16_t *bufferEnd = buffer + ChunkSize - 1;
+    while (in < end) {
+        char16_t *out = buffer;
+        while (in < end && out < bufferEnd) {
+            const uint ascii = AsciiLength(in, std::min<uint>(end - in, bufferEnd - out));
+            Widen(in, ascii, out);
+            in += ascii;
+            out += ascii;
+            if (in < end && out < bufferEnd && *in >= 0x80) {
+                out += DecodeUtf8(in, end, out);
             }
-            code = 0;
         }
+        utf16.basic_string::append(buffer, out - buffer);
     }
     return utf16;
 }
 
 VByteArray VString::toLatin1() const
 {
-    uint size = this->size();
-    VByteArray latin1;
-    latin1.resize(size);
-    for (uint i = 0; i < size; i++) {
-        latin1[i] = at(i);
-    }
-    return latin1;
+    return VStringView(*this).toLatin1();
 }
 
-VString VString::fromLatin1(const VByteArray &latin1)
+VString VString::fromLatin1(const VByteArrayView &latin1)
 {
-    uint size = latin1.size();
-    VString utf16;
-    utf16.resize(size);
-    for (uint i = 0; i < size; i++) {
-        utf16[i] = latin1[i];
-    }
-    return utf16;
+    return VString(latin1.data(), latin1.size());
 }
 
 std::u32string VString::toUcs4() const
@@ -385,7 +528,7 @@ VString VString::fromUcs4(const std::u32string &ucs4)
 
 int VString::compare(const char *str) const
 {
-    return StringCompare(data(), str);
+    return StringCompare(data(), reinterpret_cast<const uchar *>(str));
 }
 
 int VString::icompare(const VString &str) const
@@ -395,7 +538,7 @@ int VString::icompare(const VString &str) const
 
 int VString::icompare(const char *str) const
 {
-    return StringCaseCompare(data(), str);
+    return StringCaseCompare(data(), reinterpret_cast<const uchar *>(str));
 }
 
 VString VString::number(int num)
@@ -438,12 +581,18 @@ void VString::sprintf(const char *format, ...)
 {
     va_list arguments;
     va_start(arguments, format);
-    int length = vsnprintf(nullptr, 0, format, arguments);
-    char *bytes = new char[length + 1];
-    vsprintf(bytes, format, arguments);
+    //The arguments are walked twice
+    va_list copy;
+    va_copy(copy, arguments);
+    int length = vsnprintf(nullptr, 0, format, copy);
+    va_end(copy);
+    if (length > 0) {
+        char *bytes = new char[length + 1];
+        vsnprintf(bytes, length + 1, format, arguments);
+        append(bytes, length);
+        delete[] bytes;
+    }
     va_end(arguments);
-    append(bytes);
-    delete[] bytes;
 }
 
 void VString::stripTrailing(const char *str)
@@ -455,6 +604,47 @@ void VString::stripTrailing(const char *str)
     }
 }
 
+VByteArray VStringView::toUtf8() const
+{
+    //Sized for ASCII first, most strings are
+    VByteArray utf8;
+    utf8.resize(m_size);
+    if (m_size == 0) {
+        return utf8;
+    }
+
+    const char16_t *in = m_data;
+    const char16_t *end = m_data + m_size;
+    uint ascii = NarrowAscii(in, m_size, &utf8[0]);
+    if (ascii == m_size) {
+        return utf8;
+    }
+
+    //A unit takes 3 bytes at most, a surrogate pair 4
+    utf8.resize(ascii + (m_size - ascii) * 3);
+    char *begin = &utf8[0];
+    char *out = begin + ascii;
+    in += ascii;
+    while (in < end) {
+        out += EncodeUtf8(in, end, out);
+        ascii = NarrowAscii(in, end - in, out);
+        in += ascii;
+        out += ascii;
+    }
+    utf8.resize(out - begin);
+    return utf8;
+}
+
+VByteArray VStringView::toLatin1() const
+{
+    VByteArray latin1;
+    latin1.resize(m_size);
+    if (m_size > 0) {
+        Narrow(m_data, m_size, &latin1[0]);
+    }
+    return latin1;
+}
+
 // ***** Implement hash static functions
 
 /*// Hash function
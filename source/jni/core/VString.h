@@ -13,6 +13,7 @@ class VString : public std::u16string
 public:
     VString() {}
 
+    // const char * is taken as Latin-1, use fromUtf8() for UTF-8
     VString(const char *str);
     VString(const char *data, uint length);
     VString(const std::string &str);
@@ -39,7 +40,7 @@ public:
     const VString &operator = (VString &&source);
 
     void append(char16_t ch) { basic_string::operator +=(ch); }
-    void append(const VString &str) { basic_string::append(str.data()); }
+    void append(const VString &str) { basic_string::append(str); }
     void append(const char *str) { append(str, strlen(str)); }
     void append(const char *str, uint length);
 
@@ -81,11 +82,13 @@ public:
 
     std::string toStdString() const;
 
+    // Invalid UTF-8 sequences and unpaired surrogates become U+FFFD
     VByteArray toUtf8() const;
-    static VString fromUtf8(const VByteArray &utf8);
+    static VString fromUtf8(const VByteArrayView &utf8);
 
+    // Like the const char * functions, code units above 0xff are truncated
     VByteArray toLatin1() const;
-    static VString fromLatin1(const VByteArray &latin1);
+    static VString fromLatin1(const VByteArrayView &latin1);
 
     std::u32string toUcs4() const;
     static VString fromUcs4(const std::u32string &ucs4);
@@ -100,7 +103,7 @@ public:
     friend VString operator + (const VString &str, char16_t ch);
     friend VString operator + (char16_t ch, const VString &str);
 
-    int compare(const VString &str) const { return basic_string::compare(str.data()); }
+    int compare(const VString &str) const { return basic_string::compare(str); }
     int compare(const char *str) const;
 
     friend bool operator == (const VString &str1, const VString &str2) { return str1.compare(str2) == 0; }
@@ -128,4 +131,41 @@ public:
     void sprintf(const char *format, ...);
 };
 
+// Refers to UTF-16 text owned by someone else without copying it
+class VStringView
+{
+public:
+    VStringView() : m_data(u""), m_size(0) {}
+    VStringView(const std::u16string &str) : m_data(str.data()), m_size(str.size()) {}
+    VStringView(const char16_t *data, uint size) : m_data(data), m_size(size) {}
+
+    const char16_t *data() const { return m_data; }
+    uint size() const { return m_size; }
+    int length() const { return (int) m_size; }
+    bool isEmpty() const { return m_size == 0; }
+
+    char16_t operator [] (uint i) const { return m_data[i]; }
+
+    VStringView mid(uint from, uint length = 0) const { return VStringView(m_data + from, length ? length : m_size - from); }
+    VStringView left(uint count) const { return VStringView(m_data, count); }
+    VStringView right(uint count) const { return VStringView(m_data + m_size - count, count); }
+
+    bool startsWith(const VStringView &prefix) const { return m_size >= prefix.m_size && memcmp(m_data, prefix.m_data, prefix.m_size * sizeof(char16_t)) == 0; }
+    bool endsWith(const VStringView &postfix) const { return m_size >= postfix.m_size && memcmp(m_data + m_size - postfix.m_size, postfix.m_data, postfix.m_size * sizeof(char16_t)) == 0; }
+
+    VString toString() const { return VString(m_data, m_size); }
+    VByteArray toUtf8() const;
+    VByteArray toLatin1() const;
+
+    friend bool operator == (const VStringView &view1, const VStringView &view2)
+    {
+        return view1.m_size == view2.m_size && memcmp(view1.m_data, view2.m_data, view1.m_size * sizeof(char16_t)) == 0;
+    }
+    friend bool operator != (const VStringView &view1, const VStringView &view2) { return !(view1 == view2); }
+
+private:
+    const char16_t *m_data;
+    uint m_size;
+};
+
 NV_NAMESPACE_END
@@ -2,18 +2,67 @@
 
 #include "vglobal.h"
 #include "VString.h"
-#include "VMap.h"
+#include "VHash.h"
+
+#include <string.h>
 
 NV_NAMESPACE_BEGIN
 
+// Hashes the UTF-16 code units four at a time. A const char * is hashed and compared unit by unit
+// as VString(const char *) would convert it, so it finds the same entries without building a VString.
+template<>
+struct VHashTraits<VString>
+{
+    static uint Hash(const VString &key) { return Hash(key.data(), key.size()); }
+    static uint Hash(const char *key) { return Hash(key, strlen(key)); }
+
+    template<typename Char>
+    static uint Hash(const Char *key, uint length)
+    {
+        vuint64 hash = 0x9e3779b97f4a7c15ull ^ length;
+        uint i = 0;
+        for (; i + 4 <= length; i += 4) {
+            const vuint64 word = Unit(key[i]) | Unit(key[i + 1]) << 16 | Unit(key[i + 2]) << 32 | Unit(key[i + 3]) << 48;
+            hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+            hash ^= hash >> 32;
+        }
+        vuint64 tail = 0;
+        for (; i < length; i++) {
+            tail = tail << 16 | Unit(key[i]);
+        }
+        hash = (hash ^ tail) * 0xc4ceb9fe1a85ec53ull;
+        return static_cast<uint>(hash ^ (hash >> 32));
+    }
+
+    static bool Equal(const VString &key1, const VString &key2)
+    {
+        return key1.size() == key2.size() && memcmp(key1.data(), key2.data(), key1.size() * sizeof(char16_t)) == 0;
+    }
+
+    static bool Equal(const VString &key1, const char *key2)
+    {
+        const uint length = key1.size();
+        for (uint i = 0; i < length; i++) {
+            if (key2[i] == '\0' || key1[i] != static_cast<uchar>(key2[i])) {
+                return false;
+            }
+        }
+        return key2[length] == '\0';
+    }
+
+private:
+    static vuint64 Unit(char16_t ch) { return ch; }
+    static vuint64 Unit(char ch) { return static_cast<uchar>(ch); }
+};
+
 template<class T>
-class VStringHash : public VMap<VString, T>
+class VStringHash : public VHash<VString, T>
 {
 public:
     typedef T ValueType;
-    typedef std::map<VString, T> SelfType;
-    typedef typename std::map<VString, T>::iterator Iterator;
-    typedef typename std::map<VString, T>::const_iterator ConstIterator;
+    typedef VHash<VString, T> SelfType;
+    typedef typename SelfType::Iterator Iterator;
+    typedef typename SelfType::ConstIterator ConstIterator;
 };
 
 NV_NAMESPACE_END
@@ -0,0 +1,567 @@
+#include "VTaskScheduler.h"
+#include "VDeque.h"
+#include "VThread.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include <pthread.h>
+#include <stdio.h>
+
+NV_NAMESPACE_BEGIN
+
+struct VTaskScheduler::Task::Node
+{
+    Function function;
+    VTaskScheduler::Priority priority;
+
+    //Held by the Task handles and by the scheduler until the node has run
+    std::atomic<int> ref;
+    //Dependencies still running, plus one until the node is submitted
+    std::atomic<int> pending;
+    std::atomic<bool> finished;
+    std::atomic<int> waiters;
+
+    //Guards continuations
+    std::atomic_flag lock;
+    VArray<Node *> continuations;
+
+    Node(const Function &function, VTaskScheduler::Priority priority)
+        : function(function)
+        , priority(priority)
+        , ref(2)
+        , pending(1)
+        , finished(false)
+        , waiters(0)
+    {
+        lock.clear();
+    }
+
+    void acquire() { ref.fetch_add(1, std::memory_order_relaxed); }
+
+    void release()
+    {
+        if (ref.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    void lockContinuations()
+    {
+        while (lock.test_and_set(std::memory_order_acquire)) {
+        }
+    }
+
+    void unlockContinuations() { lock.clear(std::memory_order_release); }
+};
+
+namespace {
+
+typedef VTaskScheduler::Task::Node Node;
+
+// The Chase-Lev work-stealing deque. The owner pushes and pops at the bottom without locking,
+// other workers steal from the top.
+class WorkDeque
+{
+public:
+    static const int Capacity = 1024;
+
+    WorkDeque()
+        : m_top(0)
+        , m_bottom(0)
+    {
+        for (std::atomic<Node *> &slot : m_slots) {
+            slot.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    //Returns false if the deque is full
+    bool push(Node *node)
+    {
+        const vint64 bottom = m_bottom.load(std::memory_order_relaxed);
+        const vint64 top = m_top.load(std::memory_order_acquire);
+        if (bottom - top >= Capacity) {
+            return false;
+        }
+        m_slots[bottom & (Capacity - 1)].store(node, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    Node *pop()
+    {
+        const vint64 bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        vint64 top = m_top.load(std::memory_order_relaxed);
+        if (top > bottom) {
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        Node *node = m_slots[bottom & (Capacity - 1)].load(std::memory_order_relaxed);
+        if (top == bottom) {
+            //The last one, a thief may be taking it too
+            if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                node = nullptr;
+            }
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return node;
+    }
+
+    Node *steal()
+    {
+        vint64 top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const vint64 bottom = m_bottom.load(std::memory_order_acquire);
+        if (top >= bottom) {
+            return nullptr;
+        }
+        Node *node = m_slots[top & (Capacity - 1)].load(std::memory_order_relaxed);
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return node;
+    }
+
+private:
+    std::atomic<vint64> m_top;
+    std::atomic<vint64> m_bottom;
+    std::atomic<Node *> m_slots[Capacity];
+};
+
+// Tasks submitted from outside the workers, and all critical and background ones
+class SharedQueue
+{
+public:
+    SharedQueue() : m_size(0) {}
+
+    void push(Node *node)
+    {
+        std::lock_guard<std::mutex> locker(m_mutex);
+        m_nodes.append(node);
+        m_size.fetch_add(1, std::memory_order_release);
+    }
+
+    Node *pop()
+    {
+        if (m_size.load(std::memory_order_acquire) == 0) {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> locker(m_mutex);
+        if (m_nodes.empty()) {
+            return nullptr;
+        }
+        Node *node = m_nodes.front();
+        m_nodes.removeFirst();
+        m_size.fetch_sub(1, std::memory_order_relaxed);
+        return node;
+    }
+
+    bool isEmpty() const { return m_size.load(std::memory_order_acquire) == 0; }
+
+private:
+    std::mutex m_mutex;
+    VDeque<Node *> m_nodes;
+    std::atomic<int> m_size;
+};
+
+}
+
+struct VTaskScheduler::Private
+{
+    class Worker : public VThread
+    {
+    public:
+        Worker(VTaskScheduler::Private *scheduler, int index)
+            : m_scheduler(scheduler)
+            , m_index(index)
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "VTaskWorker%d", index);
+            setName(name);
+        }
+
+        int index() const { return m_index; }
+
+        WorkDeque deque;
+
+    protected:
+        int run() override
+        {
+            pthread_setspecific(m_scheduler->currentWorker, this);
+            m_scheduler->work(this);
+            return 0;
+        }
+
+    private:
+        VTaskScheduler::Private *m_scheduler;
+        int m_index;
+    };
+
+    VArray<Worker *> workers;
+    pthread_key_t currentWorker;
+
+    SharedQueue queues[3];
+    std::atomic<int> backgroundRunning;
+    int backgroundLimit;
+
+    //Idle workers sleep until the epoch changes, it does whenever a task is queued
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    std::atomic<uint> epoch;
+    std::atomic<int> sleeping;
+    std::atomic<bool> quit;
+
+    std::mutex finishMutex;
+    std::condition_variable finishCondition;
+
+    Private(int workerCount, int reservedCpu)
+        : backgroundRunning(0)
+        , epoch(0)
+        , sleeping(0)
+        , quit(false)
+    {
+        pthread_key_create(&currentWorker, nullptr);
+
+        const int cpuCount = VThread::CpuCount();
+        if (reservedCpu >= cpuCount || reservedCpu >= (int) sizeof(ulong) * 8 || cpuCount < 2) {
+            reservedCpu = -1;
+        }
+        if (workerCount <= 0) {
+            workerCount = std::max(1, reservedCpu >= 0 ? cpuCount - 1 : cpuCount);
+        }
+        backgroundLimit = std::max(1, workerCount / 2);
+
+        ulong cpuMask = 0;
+        if (reservedCpu >= 0) {
+            for (int cpu = 0; cpu < cpuCount && cpu < (int) sizeof(ulong) * 8; cpu++) {
+                if (cpu != reservedCpu) {
+                    cpuMask |= 1ul << cpu;
+                }
+            }
+        }
+        for (int i = 0; i < workerCount; i++) {
+            Worker *worker = new Worker(this, i);
+            worker->setAffinity(cpuMask);
+            workers.append(worker);
+        }
+        for (Worker *worker : workers) {
+            worker->start();
+        }
+    }
+
+    ~Private()
+    {
+        quit = true;
+        wake(true);
+        for (Worker *worker : workers) {
+            worker->wait();
+            delete worker;
+        }
+        pthread_key_delete(currentWorker);
+    }
+
+    Worker *current() const { return static_cast<Worker *>(pthread_getspecific(currentWorker)); }
+
+    void wake(bool all = false)
+    {
+        epoch.fetch_add(1);
+        if (sleeping.load() > 0 || all) {
+            {
+                std::lock_guard<std::mutex> locker(sleepMutex);
+            }
+            if (all) {
+                sleepCondition.notify_all();
+            } else {
+                sleepCondition.notify_one();
+            }
+        }
+    }
+
+    void submit(Node *node)
+    {
+        if (node->priority == NormalPriority) {
+            Worker *worker = current();
+            if (worker && worker->deque.push(node)) {
+                wake();
+                return;
+            }
+        }
+        queues[node->priority].push(node);
+        wake();
+    }
+
+    //Drops the submission reference to the dependencies, the last one submits the node
+    void ready(Node *node)
+    {
+        if (node->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            submit(node);
+        }
+    }
+
+    Node *findWork(Worker *self, bool background)
+    {
+        Node *node = queues[CriticalPriority].pop();
+        if (node) {
+            return node;
+        }
+        if (self && (node = self->deque.pop())) {
+            return node;
+        }
+        if ((node = queues[NormalPriority].pop())) {
+            return node;
+        }
+
+        //Starts at a different victim on each worker
+        const int workerCount = workers.length();
+        const int first = self ? self->index() : 0;
+        for (int i = 0; i < workerCount; i++) {
+            Worker *victim = workers[(first + i) % workerCount];
+            if (victim != self && (node = victim->deque.steal())) {
+                return node;
+            }
+        }
+
+        if (background && !queues[BackgroundPriority].isEmpty()) {
+            return queues[BackgroundPriority].pop();
+        }
+        return nullptr;
+    }
+
+    Node *findWorkerTask(Worker *self)
+    {
+        Node *node = findWork(self, false);
+        if (node == nullptr && !queues[BackgroundPriority].isEmpty()) {
+            if (backgroundRunning.fetch_add(1) < backgroundLimit) {
+                node = queues[BackgroundPriority].pop();
+                if (node) {
+                    return node;
+                }
+            }
+            backgroundRunning.fetch_sub(1);
+        }
+        return node;
+    }
+
+    void execute(Node *node)
+    {
+        node->function();
+        node->function = nullptr;
+
+        VArray<Node *> continuations;
+        node->lockContinuations();
+        node->finished.store(true);
+        continuations.swap(node->continuations);
+        node->unlockContinuations();
+
+        for (Node *continuation : continuations) {
+            ready(continuation);
+        }
+        if (node->waiters.load() > 0) {
+            {
+                std::lock_guard<std::mutex> locker(finishMutex);
+            }
+            finishCondition.notify_all();
+        }
+        node->release();
+    }
+
+    void work(Worker *self)
+    {
+        forever {
+            const uint currentEpoch = epoch.load();
+            Node *node = findWorkerTask(self);
+            if (node) {
+                const bool background = node->priority == BackgroundPriority;
+                execute(node);
+                if (background) {
+                    backgroundRunning.fetch_sub(1);
+                }
+                continue;
+            }
+            if (quit.load()) {
+                break;
+            }
+
+            std::unique_lock<std::mutex> locker(sleepMutex);
+            sleeping.fetch_add(1);
+            while (epoch.load() == currentEpoch && !quit.load()) {
+                sleepCondition.wait(locker);
+            }
+            sleeping.fetch_sub(1);
+        }
+    }
+
+    //Anything but background tasks, unless waiting on one: those may take long and the
+    //caller may be on the clock
+    void help(Node *node)
+    {
+        Worker *self = current();
+        const bool background = node->priority == BackgroundPriority;
+        while (!node->finished.load()) {
+            Node *work = findWork(self, background);
+            if (work) {
+                execute(work);
+                continue;
+            }
+
+            node->waiters.fetch_add(1);
+            {
+                std::unique_lock<std::mutex> locker(finishMutex);
+                while (!node->finished.load()) {
+                    finishCondition.wait(locker);
+                }
+            }
+            node->waiters.fetch_sub(1);
+        }
+    }
+};
+
+VTaskScheduler::Task::Task(const Task &source)
+    : m_node(source.m_node)
+{
+    if (m_node) {
+        m_node->acquire();
+    }
+}
+
+VTaskScheduler::Task::~Task()
+{
+    if (m_node) {
+        m_node->release();
+    }
+}
+
+VTaskScheduler::Task &VTaskScheduler::Task::operator = (const Task &source)
+{
+    if (source.m_node) {
+        source.m_node->acquire();
+    }
+    if (m_node) {
+        m_node->release();
+    }
+    m_node = source.m_node;
+    return *this;
+}
+
+VTaskScheduler::Task &VTaskScheduler::Task::operator = (Task &&source)
+{
+    std::swap(m_node, source.m_node);
+    return *this;
+}
+
+bool VTaskScheduler::Task::isFinished() const
+{
+    return m_node && m_node->finished.load(std::memory_order_acquire);
+}
+
+VTaskScheduler::VTaskScheduler(int workerCount, int reservedCpu)
+    : d(new Private(workerCount, reservedCpu))
+{
+}
+
+VTaskScheduler::~VTaskScheduler()
+{
+    delete d;
+}
+
+VTaskScheduler *VTaskScheduler::instance()
+{
+    static VTaskScheduler scheduler;
+    return &scheduler;
+}
+
+int VTaskScheduler::workerCount() const
+{
+    return d->workers.length();
+}
+
+VTaskScheduler::Task VTaskScheduler::spawn(const Function &function, Priority priority)
+{
+    Task::Node *node = new Task::Node(function, priority);
+    d->ready(node);
+    return Task(node);
+}
+
+VTaskScheduler::Task VTaskScheduler::spawn(const Function &function, const VArray<Task> &dependencies, Priority priority)
+{
+    Task::Node *node = new Task::Node(function, priority);
+    for (const Task &dependency : dependencies) {
+        Task::Node *parent = dependency.m_node;
+        if (parent == nullptr) {
+            continue;
+        }
+        parent->lockContinuations();
+        if (!parent->finished.load()) {
+            node->pending.fetch_add(1, std::memory_order_relaxed);
+            parent->continuations.append(node);
+        }
+        parent->unlockContinuations();
+    }
+    d->ready(node);
+    return Task(node);
+}
+
+VTaskScheduler::Task VTaskScheduler::then(const Task &task, const Function &function, Priority priority)
+{
+    VArray<Task> dependencies;
+    dependencies.append(task);
+    return spawn(function, dependencies, priority);
+}
+
+void VTaskScheduler::wait(const Task &task)
+{
+    if (task.m_node) {
+        d->help(task.m_node);
+    }
+}
+
+void VTaskScheduler::wait(const VArray<Task> &tasks)
+{
+    for (const Task &task : tasks) {
+        wait(task);
+    }
+}
+
+void VTaskScheduler::parallelFor(int begin, int end, const RangeFunction &function, int grainSize, Priority priority)
+{
+    const int count = end - begin;
+    if (count <= 0) {
+        return;
+    }
+
+    //A few chunks per thread balance uneven work
+    if (grainSize <= 0) {
+        grainSize = std::max(1, count / ((workerCount() + 1) * 4));
+    }
+    const int chunkCount = (count + grainSize - 1) / grainSize;
+    if (chunkCount == 1) {
+        function(begin, end);
+        return;
+    }
+
+    //Every thread takes the next chunk until none is left, late helpers find nothing to do
+    std::atomic<int> nextChunk(0);
+    auto process = [&]() {
+        for (int chunk = nextChunk.fetch_add(1); chunk < chunkCount; chunk = nextChunk.fetch_add(1)) {
+            const int first = begin + chunk * grainSize;
+            function(first, std::min(first + grainSize, end));
+        }
+    };
+
+    const int helperCount = std::min(chunkCount - 1, workerCount());
+    VArray<Task> helpers;
+    helpers.reserve(helperCount);
+    for (int i = 0; i < helperCount; i++) {
+        helpers.append(spawn(process, priority));
+    }
+    process();
+    wait(helpers);
+}
+
+NV_NAMESPACE_END
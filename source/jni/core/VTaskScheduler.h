@@ -0,0 +1,80 @@
+#pragma once
+
+#include "VArray.h"
+
+#include <functional>
+
+NV_NAMESPACE_BEGIN
+
+// Runs tasks on a pool of worker threads, one per core but the core the timewarp thread is
+// pinned to. Tasks spawned by a worker go to its own deque and idle workers steal from the
+// others. A task may depend on other tasks and only starts once they have all finished. Waiting
+// on a task runs other tasks in the meantime instead of blocking.
+class VTaskScheduler
+{
+public:
+    enum Priority
+    {
+        //Needed for the next frame, taken before anything else
+        CriticalPriority,
+        NormalPriority,
+        //May block on I/O. Run by at most half of the workers at a time, so frame work always
+        //finds one free.
+        BackgroundPriority
+    };
+
+    typedef std::function<void()> Function;
+    typedef std::function<void(int begin, int end)> RangeFunction;
+
+    class Task
+    {
+    public:
+        Task() : m_node(nullptr) {}
+        Task(const Task &source);
+        Task(Task &&source) : m_node(source.m_node) { source.m_node = nullptr; }
+        ~Task();
+
+        Task &operator = (const Task &source);
+        Task &operator = (Task &&source);
+
+        bool isNull() const { return m_node == nullptr; }
+        bool isFinished() const;
+
+        struct Node;
+
+    private:
+        friend class VTaskScheduler;
+        explicit Task(Node *node) : m_node(node) {}
+        Node *m_node;
+    };
+
+    // VFrameSmooth pins the timewarp thread to the first core
+    static const int WarpCpu = 0;
+
+    //A workerCount <= 0 starts a worker per core but reservedCpu. Workers aren't allowed on
+    //reservedCpu, a negative one reserves none.
+    VTaskScheduler(int workerCount = 0, int reservedCpu = WarpCpu);
+    ~VTaskScheduler();
+
+    static VTaskScheduler *instance();
+
+    int workerCount() const;
+
+    Task spawn(const Function &function, Priority priority = NormalPriority);
+    Task spawn(const Function &function, const VArray<Task> &dependencies, Priority priority = NormalPriority);
+    //Continuation, function runs once task has finished
+    Task then(const Task &task, const Function &function, Priority priority = NormalPriority);
+
+    void wait(const Task &task);
+    void wait(const VArray<Task> &tasks);
+
+    //Calls function on consecutive subranges of [begin, end) from the workers and the calling
+    //thread, and returns once the whole range is done. A grainSize <= 0 picks one.
+    void parallelFor(int begin, int end, const RangeFunction &function, int grainSize = 0, Priority priority = CriticalPriority);
+
+private:
+    NV_DECLARE_PRIVATE
+    NV_DISABLE_COPY(VTaskScheduler)
+};
+
+NV_NAMESPACE_END
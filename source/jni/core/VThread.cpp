@@ -1,11 +1,18 @@
 #include "VThread.h"
-#include "VMap.h"
+#include "VHash.h"
 #include "VMutex.h"
 #include "VLog.h"
+#include "VWaitCondition.h"
 
 #include <atomic>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 
 NV_NAMESPACE_BEGIN
 
@@ -27,7 +34,7 @@ public:
     {
         if (thread) {
             m_mutex.lock();
-            m_pool.erase(thread->id());
+            m_pool.remove(thread->id());
             m_mutex.unlock();
         }
     }
@@ -41,10 +48,43 @@ public:
     }
 
 private:
-    VMap<uint, VThread *> m_pool;
+    VHash<uint, VThread *> m_pool;
     mutable VMutex m_mutex;
 };
 
+//Older NDKs have neither gettid() nor sched_setaffinity() in their headers
+pid_t CurrentTid()
+{
+    return syscall(__NR_gettid);
+}
+
+bool SetAffinity(pid_t tid, ulong cpuMask)
+{
+    //Room for 256 cpus, as the kernel wants at least as many bits as it supports
+    ulong mask[256 / (sizeof(ulong) * 8)];
+    memset(mask, cpuMask ? 0 : 0xff, sizeof(mask));
+    if (cpuMask) {
+        mask[0] = cpuMask;
+    }
+    return syscall(__NR_sched_setaffinity, tid, sizeof(mask), mask) == 0;
+}
+
+bool SetScheduling(pid_t tid, VThread::Policy policy, VThread::Priority priority)
+{
+    sched_param param;
+    int nativePolicy = SCHED_OTHER;
+    param.sched_priority = 0;
+    if (policy != VThread::NormalPolicy) {
+        nativePolicy = policy == VThread::FifoPolicy ? SCHED_FIFO : SCHED_RR;
+        param.sched_priority = VThread::GetOSPriority(priority, policy);
+    }
+    if (sched_setscheduler(tid, nativePolicy, &param) != 0) {
+        return false;
+    }
+    //Linux threads have a nice value of their own
+    return policy != VThread::NormalPolicy || setpriority(PRIO_PROCESS, tid, VThread::GetOSPriority(priority)) == 0;
+}
+
 } //anonymous namespace
 
 struct VThread::Private
@@ -55,17 +95,25 @@ struct VThread::Private
     uint stackSize;
     VThread::State state;
     VThread::Priority priority;
+    VThread::Policy policy;
+    ulong affinity;
+    char name[16];
     int exitCode;
+    vint64 cpuTime;
 
     // Thread state flags
     std::atomic<uint> threadFlags;
     std::atomic<int> suspendCount;
 
     pthread_t handle;
+    std::atomic<int> tid;
 
     static VThreadList pool;
 
     VMutex exitMutex;
+    VWaitCondition exitCondition;
+    //Guards the scheduling settings against the thread applying them as it starts
+    VMutex settingsMutex;
 
     Private(VThread *self)
         : self(self)
@@ -74,11 +122,16 @@ struct VThread::Private
         , stackSize(128 * 1024)
         , state(VThread::NotRunning)
         , priority(VThread::NormalPriority)
+        , policy(VThread::NormalPolicy)
+        , affinity(0)
         , exitCode(0)
+        , cpuTime(0)
         , threadFlags(0)
         , suspendCount(0)
         , handle(0)
+        , tid(0)
     {
+        name[0] = '\0';
     }
 
     enum StateFlag
@@ -99,13 +152,19 @@ struct VThread::Private
 
         // Call the virtual run function
         exitCode = self->run();
-        self->exit();
+        self->exit(exitCode);
         return exitCode;
     }
 
+    void applySettings();
+
     static void *StartFunction(void *data)
     {
         Private *d = (Private *) data;
+        //pthread_create() may not have stored the handle yet
+        d->handle = pthread_self();
+        d->applySettings();
+        pool.add(d->self);
         int result = d->run();
         // Signal the thread as done and release it atomically.
         d->threadFlags &= ~(uint) Private::Started;
@@ -120,6 +179,23 @@ struct VThread::Private
 
 VThreadList VThread::Private::pool;
 
+void VThread::Private::applySettings()
+{
+    settingsMutex.lock();
+    tid = CurrentTid();
+    if (name[0] != '\0') {
+        pthread_setname_np(handle, name);
+    }
+    //Threads inherit the settings of their creator, which are left alone unless changed
+    if ((policy != VThread::NormalPolicy || priority != VThread::NormalPriority) && !SetScheduling(tid, policy, priority)) {
+        vWarn("VThread: failed to apply the scheduling policy of" << name << ":" << strerror(errno));
+    }
+    if (affinity != 0 && !SetAffinity(tid, affinity)) {
+        vWarn("VThread: failed to set the affinity of" << name << ":" << strerror(errno));
+    }
+    settingsMutex.unlock();
+}
+
 VThread::VThread()
     : d(new Private(this))
 {
@@ -152,17 +228,55 @@ VThread::Priority VThread::priority() const
     return d->priority;
 }
 
-void VThread::setPriority(VThread::Priority priority)
+bool VThread::setPriority(VThread::Priority priority)
 {
+    d->settingsMutex.lock();
     d->priority = priority;
+    const bool applied = d->tid == 0 || SetScheduling(d->tid, d->policy, priority);
+    d->settingsMutex.unlock();
+    return applied;
+}
+
+VThread::Policy VThread::policy() const
+{
+    return d->policy;
+}
+
+bool VThread::setPolicy(VThread::Policy policy)
+{
+    d->settingsMutex.lock();
+    d->policy = policy;
+    const bool applied = d->tid == 0 || SetScheduling(d->tid, policy, d->priority);
+    d->settingsMutex.unlock();
+    return applied;
+}
+
+ulong VThread::affinity() const
+{
+    return d->affinity;
+}
+
+bool VThread::setAffinity(ulong cpuMask)
+{
+    d->settingsMutex.lock();
+    d->affinity = cpuMask;
+    const bool applied = d->tid == 0 || SetAffinity(d->tid, cpuMask);
+    d->settingsMutex.unlock();
+    return applied;
 }
 
 void VThread::setName(const char *name)
 {
-    int result = pthread_setname_np(d->handle, name);
-    if (result != 0) {
-        vWarn("VThread::setName(\"" << name << "\") failed. Error:" << strerror(result));
+    d->settingsMutex.lock();
+    strncpy(d->name, name, sizeof(d->name) - 1);
+    d->name[sizeof(d->name) - 1] = '\0';
+    if (d->tid != 0) {
+        int result = pthread_setname_np(d->handle, d->name);
+        if (result != 0) {
+            vWarn("VThread::setName(\"" << name << "\") failed. Error:" << strerror(result));
+        }
     }
+    d->settingsMutex.unlock();
 }
 
 bool VThread::start()
@@ -174,16 +288,14 @@ bool VThread::start()
 
     d->exitCode = 0;
     d->suspendCount = 0;
-    d->threadFlags = 0;
     d->exitMutex.lock();
+    d->threadFlags = Private::Started;
+    d->exitMutex.unlock();
 
     pthread_attr_t attr;
     pthread_attr_init(&attr);
     pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
     pthread_attr_setstacksize(&attr, d->stackSize);
-    sched_param sparam;
-    sparam.sched_priority = VThread::GetOSPriority(d->priority);
-    pthread_attr_setschedparam(&attr, &sparam);
 
     int result = pthread_create(&d->handle, &attr, Private::StartFunction, d);
     pthread_attr_destroy(&attr);
@@ -203,12 +315,21 @@ int VThread::run()
 void VThread::exit(int exitCode)
 {
     // Signal this thread object as done and release it's references.
-    d->threadFlags &= ~(uint) Private::Started;
-    d->threadFlags |= Private::Finished;
-    // Release();
-
     d->pool.remove(this);
 
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+
+    d->settingsMutex.lock();
+    d->tid = 0;
+    d->settingsMutex.unlock();
+
+    d->exitMutex.lock();
+    d->exitCode = exitCode;
+    d->cpuTime = time.tv_sec * 1000000000ll + time.tv_nsec;
+    d->threadFlags &= ~(uint) Private::Started;
+    d->threadFlags |= Private::Finished;
+    d->exitCondition.notifyAll();
     d->exitMutex.unlock();
     pthread_exit((void *) exitCode);
 }
@@ -216,6 +337,9 @@ void VThread::exit(int exitCode)
 bool VThread::wait()
 {
     d->exitMutex.lock();
+    while (d->threadFlags & Private::Started) {
+        d->exitCondition.wait(&d->exitMutex);
+    }
     d->exitMutex.unlock();
     return true;
 }
@@ -256,10 +380,53 @@ uint VThread::id() const
     return (uint) d->handle;
 }
 
-int VThread::GetOSPriority(VThread::Priority priority)
+int VThread::tid() const
 {
-    const int minPriority = sched_get_priority_min(SCHED_NORMAL);
-    const int maxPriority = sched_get_priority_max(SCHED_NORMAL);
+    return d->tid;
+}
+
+vint64 VThread::cpuTime() const
+{
+    //The thread can't exit and release its clock while exitMutex is held
+    d->exitMutex.lock();
+    vint64 cpuTime = d->cpuTime;
+    clockid_t clock;
+    if ((d->threadFlags & Private::Started) && d->tid != 0 && pthread_getcpuclockid(d->handle, &clock) == 0) {
+        timespec time;
+        if (clock_gettime(clock, &time) == 0) {
+            cpuTime = time.tv_sec * 1000000000ll + time.tv_nsec;
+        }
+    }
+    d->exitMutex.unlock();
+    return cpuTime;
+}
+
+int VThread::CpuCount()
+{
+    //Configured rather than online, cores of big.LITTLE devices go offline and back
+    const long count = sysconf(_SC_NPROCESSORS_CONF);
+    return count > 0 ? static_cast<int>(count) : 1;
+}
+
+int VThread::GetOSPriority(VThread::Priority priority, VThread::Policy policy)
+{
+    if (policy == NormalPolicy) {
+        //The nice values of the Android THREAD_PRIORITY_* constants
+        switch (priority) {
+        case CriticalPriority: return -8;
+        case HighestPriority: return -4;
+        case AboveNormalPriority: return -2;
+        case NormalPriority: return 0;
+        case BelowNormalPriority: return 5;
+        case LowestPriority: return 10;
+        case IdlePriority: return 19;
+        default: return 0;
+        }
+    }
+
+    const int nativePolicy = policy == FifoPolicy ? SCHED_FIFO : SCHED_RR;
+    const int minPriority = sched_get_priority_min(nativePolicy);
+    const int maxPriority = sched_get_priority_max(nativePolicy);
     switch(priority)
     {
     case CriticalPriority: return minPriority + (maxPriority - minPriority) * 7 / 8;
@@ -273,6 +440,13 @@ int VThread::GetOSPriority(VThread::Priority priority)
     }
 }
 
+vint64 VThread::CurrentCpuTime()
+{
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return time.tv_sec * 1000000000ll + time.tv_nsec;
+}
+
 bool VThread::Sleep(uint secs)
 {
     sleep(secs);
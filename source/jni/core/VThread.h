@@ -27,6 +27,14 @@ public:
         IdlePriority,
     };
 
+    //Realtime policies need CAP_SYS_NICE, on Android the VrLib Java side grants them
+    enum Policy
+    {
+        NormalPolicy,
+        FifoPolicy,
+        RoundRobinPolicy
+    };
+
     VThread();
     VThread(Function function, void *data = nullptr);
 
@@ -35,9 +43,19 @@ public:
     uint stackSize() const;
     void setStackSize(uint size);
 
+    //Scheduling settings are applied when the thread starts, or right away if it is running,
+    //in which case they return whether the system accepted them
     Priority priority() const;
-    void setPriority(Priority priority);
+    bool setPriority(Priority priority);
+
+    Policy policy() const;
+    bool setPolicy(Policy policy);
 
+    //Bit n allows cpu n, 0 allows all of them
+    ulong affinity() const;
+    bool setAffinity(ulong cpuMask);
+
+    //At most 15 characters are kept
     void setName(const char *name);
 
     virtual bool start();
@@ -52,9 +70,17 @@ public:
     bool isSuspended() const;
     State state() const;
     uint id() const;
+    //Kernel thread id, as gettid() returns it on the thread, 0 when not running
+    int tid() const;
+
+    //Nanoseconds spent on a cpu, up to now or to the exit of the thread
+    vint64 cpuTime() const;
 
     static int CpuCount();
-    static int GetOSPriority(Priority priority);
+    //Nice value for the normal policy, sched_priority for the realtime ones
+    static int GetOSPriority(Priority priority, Policy policy = NormalPolicy);
+
+    static vint64 CurrentCpuTime();
 
     static bool Sleep(uint secs);
     static bool MSleep(uint msecs);
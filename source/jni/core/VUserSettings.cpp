@@ -12,11 +12,7 @@ static const char* PROFILE_PATH = "/sdcard/Oculus/userprofile.json";
 void VUserSettings::load()
 {
     // TODO: Switch this over to using a content provider when available.
-    VJson root;
-    std::ifstream fp(PROFILE_PATH, std::ios::binary);
-    if (fp.is_open()) {
-        fp >> root;
-    }
+    VJson root = VJson::Load(PROFILE_PATH);
 
     if (root.isNull()) {
         vWarn("Failed to load user profile \"" << PROFILE_PATH << "\". Using defaults.");
@@ -2,10 +2,30 @@
 
 #include "VLog.h"
 
+#include <atomic>
+#include <new>
 #include <sstream>
 
 NV_NAMESPACE_BEGIN
 
+struct VVariant::SharedArray
+{
+    SharedArray(const VVariantArray &value) : ref(1), value(value) {}
+    SharedArray(VVariantArray &&value) : ref(1), value(std::move(value)) {}
+
+    std::atomic<int> ref;
+    VVariantArray value;
+};
+
+struct VVariant::SharedMap
+{
+    SharedMap(const VVariantMap &value) : ref(1), value(value) {}
+    SharedMap(VVariantMap &&value) : ref(1), value(std::move(value)) {}
+
+    std::atomic<int> ref;
+    VVariantMap value;
+};
+
 VVariant::VVariant()
     : m_type(Null)
 {
@@ -66,97 +86,70 @@ VVariant::VVariant(const void *pointer)
     m_value.pointer = const_cast<void *>(pointer);
 }
 
-VVariant::VVariant(const char *str)
+VVariant::VVariant(const char *value)
     : m_type(String)
 {
-    m_value.str = new VString(str);
+    new (str()) VString(value);
 }
 
-VVariant::VVariant(const VString &str)
+VVariant::VVariant(const VString &value)
     : m_type(String)
 {
-    m_value.str = new VString(str);
+    new (str()) VString(value);
 }
 
-VVariant::VVariant(VString &&str)
+VVariant::VVariant(VString &&value)
     : m_type(String)
 {
-    m_value.str = new VString(std::move(str));
+    new (str()) VString(std::move(value));
 }
 
 VVariant::VVariant(const VVariantArray &array)
     : m_type(Array)
 {
-    m_value.array = new VVariantArray(array);
+    m_value.array = new SharedArray(array);
 }
 
 VVariant::VVariant(VVariantArray &&array)
     : m_type(Array)
 {
-    m_value.array = new VVariantArray(std::move(array));
+    m_value.array = new SharedArray(std::move(array));
 }
 
 VVariant::VVariant(const VVariantMap &map)
     : m_type(Map)
 {
-    m_value.map = new VVariantMap(map);
+    m_value.map = new SharedMap(map);
 }
 
 VVariant::VVariant(VVariantMap &&map)
     : m_type(Map)
 {
-    m_value.map = new VVariantMap(std::move(map));
+    m_value.map = new SharedMap(std::move(map));
 }
 
-VVariant::VVariant(const Function &function)
+VVariant::VVariant(const Function &value)
     : m_type(Closure)
 {
-    m_value.function = new Function(function);
+    new (function()) Function(value);
 }
 
-VVariant::VVariant(VVariant::Function &&function)
+VVariant::VVariant(VVariant::Function &&value)
     : m_type(Closure)
 {
-    m_value.function = new Function(std::move(function));
+    new (function()) Function(std::move(value));
 }
 
 VVariant::VVariant(const VVariant &var)
-    : m_type(var.m_type)
+    : m_type(Null)
 {
-    switch (m_type) {
-    case Null:
-    case Boolean:
-    case Int:
-    case UInt:
-    case LongLong:
-    case ULongLong:
-    case Float:
-    case Double:
-    case Pointer:
-        m_value = var.m_value;
-        break;
-    case String:
-        m_value.str = new VString(*(var.m_value.str));
-        break;
-    case Array:
-        m_value.array = new VVariantArray(*(var.m_value.array));
-        break;
-    case Map:
-        m_value.map = new VVariantMap(*(var.m_value.map));
-        break;
-    case Closure:
-        m_value.function = new Function(*(var.m_value.function));
-        break;
-    default:
-        vAssert("VVariant Does not support such a type.");
-    }
+    copy(var);
 }
 
 VVariant::VVariant(VVariant &&var)
-    : m_type(var.m_type)
-    , m_value(var.m_value)
+    : m_type(Null)
 {
-    var.m_type = Null;
+    move(var);
 }
 
 VVariant::~VVariant()
@@ -186,11 +179,11 @@ bool VVariant::toBool() const
     case Pointer:
         return m_value.pointer;
     case String:
-        return !m_value.str->isEmpty();
+        return !str()->isEmpty();
     case Array:
-        return !m_value.array->isEmpty();
+        return !m_value.array->value.isEmpty();
     case Map:
-        return !m_value.map->isEmpty();
+        return !m_value.map->value.isEmpty();
     default:
         vAssert(false)
         return false;
@@ -217,11 +210,11 @@ int VVariant::toInt() const
     case Double:
         return static_cast<int>(m_value.dreal);
     case String:
-        return m_value.str->toInt();
+        return str()->toInt();
     case Array:
-        return m_value.array->length();
+        return m_value.array->value.length();
     case Map:
-        return static_cast<int>(m_value.map->size());
+        return static_cast<int>(m_value.map->value.size());
     default:
         vWarn("VVariant cast an unexpected type to int");
         return 0;
@@ -248,11 +241,11 @@ uint VVariant::toUInt() const
     case Double:
         return static_cast<uint>(m_value.dreal);
     case String:
-        return m_value.str->toInt();
+        return str()->toInt();
     case Array:
-        return m_value.array->size();
+        return m_value.array->value.size();
     case Map:
-        return m_value.map->size();
+        return m_value.map->value.size();
     default:
         vWarn("VVariant cast an unexpected type to uint");
         return 0;
@@ -319,43 +312,43 @@ const VString &VVariant::toString() const
 {
     vAssert(m_type == String);
     static VString EmptyString;
-    return m_type == String ? *(m_value.str) : EmptyString;
+    return m_type == String ? *str() : EmptyString;
 }
 
 const VVariantArray &VVariant::toArray() const
 {
     vAssert(m_type == Array);
     static VVariantArray EmptyArray;
-    return m_type == Array ? *(m_value.array) : EmptyArray;
+    return m_type == Array ? m_value.array->value : EmptyArray;
 }
 
 const VVariantMap &VVariant::toMap() const
 {
     vAssert(m_type == Map);
     static VVariantMap EmptyMap;
-    return m_type == Map ? *(m_value.map) : EmptyMap;
+    return m_type == Map ? m_value.map->value : EmptyMap;
 }
 
 const VVariant &VVariant::at(uint index) const
 {
     vAssert(m_type == Array);
-    return m_value.array->at(index);
+    return m_value.array->value.at(index);
 }
 
 const VVariant &VVariant::value(const VString &key) const
 {
     vAssert(m_type == Map);
-    return m_value.map->value(key);
+    return m_value.map->value.value(key);
 }
 
 int VVariant::length() const
 {
     if (m_type == Array) {
-        return m_value.array->length();
+        return m_value.array->value.length();
     } else if (m_type == Map) {
-        return (int) m_value.map->size();
+        return (int) m_value.map->value.size();
     } else if (m_type == String) {
-        return m_value.str->length();
+        return str()->length();
     }
     vAssert(false);
     return 0;
@@ -364,11 +357,11 @@ int VVariant::length() const
 uint VVariant::size() const
 {
     if (m_type == Array) {
-        return m_value.array->size();
+        return m_value.array->value.size();
     } else if (m_type == Map) {
-        return m_value.map->size();
+        return m_value.map->value.size();
     } else if (m_type == String) {
-        return m_value.str->size();
+        return str()->size();
     }
     vAssert(false);
     return 0;
@@ -377,69 +370,129 @@ uint VVariant::size() const
 void VVariant::execute() const
 {
     vAssert(isClosure());
-    (*(m_value.function))();
+    (*function())();
 }
 
-void VVariant::release()
+VVariant &VVariant::operator[](uint index)
+{
+    vAssert(m_type == Array);
+    detach();
+    return m_value.array->value[index];
+}
+
+VVariant &VVariant::operator[](const VString &key)
+{
+    vAssert(m_type == Map);
+    detach();
+    return m_value.map->value[key];
+}
+
+void VVariant::copy(const VVariant &source)
 {
+    m_type = source.m_type;
     switch (m_type) {
+    case Null:
+    case Boolean:
+    case Int:
+    case UInt:
+    case LongLong:
+    case ULongLong:
+    case Float:
+    case Double:
+    case Pointer:
+        m_value = source.m_value;
+        break;
     case String:
-        delete m_value.str;
+        new (str()) VString(*source.str());
         break;
     case Array:
-        delete m_value.array;
+        m_value.array = source.m_value.array;
+        m_value.array->ref.fetch_add(1, std::memory_order_relaxed);
         break;
     case Map:
-        delete m_value.map;
+        m_value.map = source.m_value.map;
+        m_value.map->ref.fetch_add(1, std::memory_order_relaxed);
         break;
     case Closure:
-        delete m_value.function;
+        new (function()) Function(*source.function());
         break;
     default:
-        break;
+        vAssert("VVariant Does not support such a type.");
     }
 }
 
-VVariant &VVariant::operator=(const VVariant &var)
+void VVariant::move(VVariant &source)
 {
-    release();
-    m_type = var.m_type;
+    m_type = source.m_type;
     switch (m_type) {
-    case Null:
-    case Boolean:
-    case Int:
-    case UInt:
-    case LongLong:
-    case ULongLong:
-    case Float:
-    case Double:
-    case Pointer:
-        m_value = var.m_value;
+    case String:
+        new (str()) VString(std::move(*source.str()));
+        break;
+    case Closure:
+        new (function()) Function(std::move(*source.function()));
         break;
+    default:
+        m_value = source.m_value;
+        source.m_type = Null;
+        return;
+    }
+    source.release();
+    source.m_type = Null;
+}
+
+void VVariant::release()
+{
+    switch (m_type) {
     case String:
-        m_value.str = new VString(*(var.m_value.str));
+        str()->~VString();
         break;
     case Array:
-        m_value.array = new VVariantArray(*(var.m_value.array));
+        if (m_value.array->ref.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete m_value.array;
+        }
         break;
     case Map:
-        m_value.map = new VVariantMap(*(var.m_value.map));
+        if (m_value.map->ref.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete m_value.map;
+        }
         break;
     case Closure:
-        m_value.function = new Function(*(var.m_value.function));
+        function()->~Function();
         break;
     default:
-        vAssert("VVariant Does not support such a type.");
+        break;
+    }
+}
+
+// Makes a private copy of a shared array or map before it's modified
+void VVariant::detach()
+{
+    if (m_type == Array && m_value.array->ref.load(std::memory_order_acquire) > 1) {
+        SharedArray *shared = new SharedArray(m_value.array->value);
+        release();
+        m_value.array = shared;
+    } else if (m_type == Map && m_value.map->ref.load(std::memory_order_acquire) > 1) {
+        SharedMap *shared = new SharedMap(m_value.map->value);
+        release();
+        m_value.map = shared;
+    }
+}
+
+VVariant &VVariant::operator=(const VVariant &source)
+{
+    if (this != &source) {
+        release();
+        copy(source);
     }
     return *this;
 }
 
 VVariant &VVariant::operator=(VVariant &&source)
 {
-    release();
-    m_type = source.m_type;
-    m_value = source.m_value;
-    source.m_type = Null;
+    if (this != &source) {
+        release();
+        move(source);
+    }
     return *this;
 }
 
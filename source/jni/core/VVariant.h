@@ -5,6 +5,7 @@
 #include "VMap.h"
 
 #include <functional>
+#include <type_traits>
 
 NV_NAMESPACE_BEGIN
 
@@ -96,12 +97,12 @@ public:
     const VVariantArray &toArray() const;
     const VVariantMap &toMap() const;
 
-    VVariant &operator[](uint index) { return (*(m_value.array))[index]; }
+    VVariant &operator[](uint index);
 
     const VVariant &at(uint index) const;
     const VVariant &operator[](uint index) const { return at(index); }
 
-    VVariant &operator[](const VString &key) { return (*(m_value.map))[key]; }
+    VVariant &operator[](const VString &key);
 
     const VVariant &value(const VString &key) const;
     const VVariant &operator[](const VString &key) const { return value(key); }
@@ -116,10 +117,23 @@ public:
     VVariant &operator=(VVariant &&source);
 
 private:
+    void copy(const VVariant &source);
+    void move(VVariant &source);
     void release();
+    void detach();
+
+    struct SharedArray;
+    struct SharedMap;
+
+    VString *str() { return reinterpret_cast<VString *>(&m_value.storage); }
+    const VString *str() const { return reinterpret_cast<const VString *>(&m_value.storage); }
+    Function *function() { return reinterpret_cast<Function *>(&m_value.storage); }
+    const Function *function() const { return reinterpret_cast<const Function *>(&m_value.storage); }
 
     VVariant::Type m_type;
 
+    // Strings and closures are constructed in place, so they only allocate when their own
+    // small-buffer storage overflows. Arrays and maps are shared and copied on write.
     union Value
     {
         bool boolean;
@@ -130,10 +144,10 @@ private:
         float real;
         double dreal;
         void *pointer;
-        VString *str;
-        VVariantArray *array;
-        VVariantMap *map;
-        Function *function;
+        SharedArray *array;
+        SharedMap *map;
+        std::aligned_storage<(sizeof(VString) > sizeof(Function) ? sizeof(VString) : sizeof(Function)),
+            (alignof(VString) > alignof(Function) ? alignof(VString) : alignof(Function))>::type storage;
     };
     Value m_value;
 };
@@ -14,7 +14,6 @@ public:
     VVect2() : x(0), y(0) {}
     VVect2(T x, T y) : x(x), y(y) {}
     VVect2(T s) : x(s), y(s) {}
-    VVect2(const VVect2 &src) : x(src.x), y(src.y) { }
 
     bool operator == (const VVect2 &vect) const { return x == vect.x && y == vect.y; }
     bool operator != (const VVect2 &vect) const { return x != vect.x || y != vect.y; }
@@ -17,7 +17,6 @@ public:
     VVect3() : x(0), y(0), z(0) {}
     VVect3(T x, T y, T z = 0) : x(x), y(y), z(z) {}
     VVect3(T value) : x(value), y(value), z(value) {}
-    VVect3(const VVect3 &src) : x(src.x), y(src.y), z(src.z) {}
 
     bool operator == (const VVect3 &vect) const { return x == vect.x && y == vect.y && z == vect.z; }
     bool operator != (const VVect3 &vect) const { return x != vect.x || y != vect.y || z != vect.z; }
@@ -18,7 +18,6 @@ public:
     VVect4() : x(0), y(0), z(0), w(0) {}
     VVect4(T x, T y, T z, T w) : x(x), y(y), z(z), w(w) {}
     VVect4(T s) : x(s), y(s), z(s), w(s) { }
-    VVect4(const VVect4 &src) : x(src.x), y(src.y), z(src.z), w(src.w) {}
 
     bool operator == (const VVect4 &vect) const { return x == vect.x && y == vect.y && z == vect.z && w == vect.w; }
     bool operator != (const VVect4 &vect) const { return x != vect.x || y != vect.y || z != vect.z || w != vect.w; }
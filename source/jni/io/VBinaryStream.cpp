@@ -5,7 +5,191 @@ NV_NAMESPACE_BEGIN
 
 VBinaryStream::VBinaryStream(VIODevice *device)
     : m_device(device)
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    , m_byteOrder(BigEndian)
+#else
+    , m_byteOrder(LittleEndian)
+#endif
+    , m_status(Ok)
+    , m_begin(nullptr)
+    , m_cur(nullptr)
+    , m_end(nullptr)
+    , m_borrowed(false)
 {
 }
 
+VBinaryStream::~VBinaryStream()
+{
+    if (m_borrowed) {
+        release();
+    } else if (m_cur < m_end && !m_device->isSequential()) {
+        //Hand the unread part of the read-ahead buffer back
+        m_device->seek(m_device->pos() - (m_end - m_cur));
+    }
+}
+
+bool VBinaryStream::readSlow(char *data, uint length)
+{
+    if (m_status != Ok) {
+        memset(data, 0, length);
+        return false;
+    }
+
+    const uint available = m_end - m_cur;
+    if (available < length) {
+        if (length >= ReadAheadSize && !m_borrowed && (m_cur != m_end || !borrow())) {
+            //Large reads bypass the read-ahead buffer
+            memcpy(data, m_cur, available);
+            m_cur = m_end;
+            uint count = available;
+            while (count < length) {
+                vint64 bytes = m_device->read(data + count, length - count);
+                if (bytes <= 0) {
+                    memset(data + count, 0, length - count);
+                    m_status = ReadPastEnd;
+                    return false;
+                }
+                count += bytes;
+            }
+            return true;
+        }
+
+        if (!fill(length)) {
+            memset(data, 0, length);
+            m_cur = m_end;
+            m_status = ReadPastEnd;
+            return false;
+        }
+    }
+
+    memcpy(data, m_cur, length);
+    m_cur += length;
+    return true;
+}
+
+bool VBinaryStream::writeRawData(const char *data, uint length)
+{
+    if (m_status != Ok) {
+        return false;
+    }
+
+    //Writing may move the device's memory
+    if (m_borrowed) {
+        release();
+    }
+
+    uint count = 0;
+    while (count < length) {
+        vint64 bytes = m_device->write(data + count, length - count);
+        if (bytes <= 0) {
+            m_status = WriteFailed;
+            return false;
+        }
+        count += bytes;
+    }
+    return true;
+}
+
+bool VBinaryStream::skipRawData(uint length)
+{
+    if (m_status != Ok) {
+        return false;
+    }
+
+    const uint available = m_end - m_cur;
+    if (available >= length) {
+        m_cur += length;
+        return true;
+    }
+
+    m_cur = m_end;
+    if (m_borrowed) {
+        release();
+    }
+    if (m_device->skip(length - available) < length - available) {
+        m_status = ReadPastEnd;
+        return false;
+    }
+    return true;
+}
+
+const char *VBinaryStream::readView(uint length)
+{
+    if (m_status != Ok) {
+        return nullptr;
+    }
+
+    if (static_cast<uint>(m_end - m_cur) < length && !fill(length)) {
+        m_cur = m_end;
+        m_status = ReadPastEnd;
+        return nullptr;
+    }
+
+    const char *view = m_cur;
+    m_cur += length;
+    return view;
+}
+
+bool VBinaryStream::atEnd() const
+{
+    if (m_cur != m_end) {
+        return false;
+    }
+    //The device hasn't been told about the bytes consumed from its memory yet
+    return m_borrowed ? m_device->bytesAvailable() <= m_end - m_begin : m_device->atEnd();
+}
+
+bool VBinaryStream::borrow()
+{
+    vint64 length;
+    const char *memory = m_device->readBuffer(length);
+    if (memory == nullptr) {
+        return false;
+    }
+    m_begin = m_cur = memory;
+    m_end = memory + length;
+    m_borrowed = true;
+    return true;
+}
+
+void VBinaryStream::release()
+{
+    m_device->skip(m_cur - m_begin);
+    m_begin = m_cur = m_end = nullptr;
+    m_borrowed = false;
+}
+
+bool VBinaryStream::fill(uint length)
+{
+    if (m_borrowed) {
+        //Skip what has been consumed and look again, the device may have more in memory now
+        release();
+        return borrow() && static_cast<uint>(m_end - m_cur) >= length;
+    }
+    if (m_cur == m_end && borrow()) {
+        return static_cast<uint>(m_end - m_cur) >= length;
+    }
+
+    const uint available = m_end - m_cur;
+    if (available > 0 && m_cur != m_buffer.data()) {
+        memmove(&m_buffer[0], m_cur, available);
+    }
+    const uint capacity = length > ReadAheadSize ? length : ReadAheadSize;
+    if (m_buffer.size() < capacity) {
+        m_buffer.resize(capacity);
+    }
+
+    uint filled = available;
+    while (filled < length) {
+        vint64 bytes = m_device->read(&m_buffer[filled], m_buffer.size() - filled);
+        if (bytes <= 0) {
+            break;
+        }
+        filled += bytes;
+    }
+    m_begin = m_cur = m_buffer.data();
+    m_end = m_cur + filled;
+    return filled >= length;
+}
+
 NV_NAMESPACE_END
@@ -3,61 +3,170 @@
 #include "VArray.h"
 #include "VIODevice.h"
 
+#include <string.h>
+#include <type_traits>
+
 NV_NAMESPACE_BEGIN
 
+//Reads and writes trivially copyable values. Reads go through a read-ahead buffer, or straight
+//through the memory of devices that expose it (VBuffer, VFile), so the device must not be read
+//from or written to directly while the stream is reading from it.
 class VBinaryStream
 {
 public:
+    enum ByteOrder
+    {
+        BigEndian,
+        LittleEndian
+    };
+
+    enum Status
+    {
+        Ok,
+        ReadPastEnd,
+        WriteFailed
+    };
+
     VBinaryStream(VIODevice *device);
+    ~VBinaryStream();
+
+    VIODevice *device() const { return m_device; }
+
+    //Applies to arithmetic types only, structures are always copied as they are
+    ByteOrder byteOrder() const { return m_byteOrder; }
+    void setByteOrder(ByteOrder order) { m_byteOrder = order; }
+
+    //Once an operation failed, the following reads and writes fail too until the status is reset
+    Status status() const { return m_status; }
+    void resetStatus() { m_status = Ok; }
 
     template<typename T>
     VBinaryStream &operator>>(T &element)
     {
-        constexpr size_t length = sizeof(T);
-        char buffer[length];
-        uint count = 0;
-        do {
-            count += m_device->read(buffer + count, length - count);
-        } while (count < length);
-        element = *(reinterpret_cast<T *>(buffer));
+        readArray(&element, 1);
         return *this;
     }
 
     template<typename T>
     VBinaryStream &operator<<(const T &element)
     {
-        constexpr size_t length = sizeof(T);
-        const char *data = reinterpret_cast<const char *>(&element);
-        uint count = 0;
-        do {
-            count += m_device->write(data + count, length - count);
-        } while (count < length);
+        writeArray(&element, 1);
         return *this;
     }
 
     template<typename T>
-    bool read(VArray<T> &elements, uint num)
+    bool readArray(T *elements, uint num)
     {
-        size_t byteNum = sizeof(T) * num;
-        if (m_device->bytesAvailable() < byteNum) {
+        static_assert(__has_trivial_copy(T), "VBinaryStream can only read trivially copyable types");
+        if (!readRawData(reinterpret_cast<char *>(elements), sizeof(T) * num)) {
             return false;
         }
+        if (NeedsSwap<T>(m_byteOrder)) {
+            for (uint i = 0; i < num; i++) {
+                Swap(reinterpret_cast<char *>(elements + i), sizeof(T));
+            }
+        }
+        return true;
+    }
 
-        elements.resize(num);
+    template<typename T>
+    bool writeArray(const T *elements, uint num)
+    {
+        static_assert(__has_trivial_copy(T), "VBinaryStream can only write trivially copyable types");
+        if (!NeedsSwap<T>(m_byteOrder)) {
+            return writeRawData(reinterpret_cast<const char *>(elements), sizeof(T) * num);
+        }
 
-        uint count = 0;
-        char *data = reinterpret_cast<char *>(elements.data());
-        do {
-            count += m_device->read(data + count, byteNum - count);
-        } while (count < byteNum);
+        //Swapped in batches on the stack
+        const uint batch = 256 / sizeof(T);
+        T swapped[batch];
+        for (uint i = 0; i < num; i += batch) {
+            const uint count = num - i < batch ? num - i : batch;
+            memcpy(swapped, elements + i, sizeof(T) * count);
+            for (uint j = 0; j < count; j++) {
+                Swap(reinterpret_cast<char *>(swapped + j), sizeof(T));
+            }
+            if (!writeRawData(reinterpret_cast<const char *>(swapped), sizeof(T) * count)) {
+                return false;
+            }
+        }
+        return true;
+    }
 
+    template<typename T>
+    bool read(VArray<T> &elements, uint num)
+    {
+        elements.resize(num);
+        if (!readArray(elements.data(), num)) {
+            elements.clear();
+            return false;
+        }
         return true;
     }
 
-    bool atEnd() const { return m_device->atEnd(); }
+    template<typename T>
+    bool write(const VArray<T> &elements)
+    {
+        return writeArray(elements.data(), elements.size());
+    }
+
+    bool readRawData(char *data, uint length)
+    {
+        if (m_status == Ok && static_cast<uint>(m_end - m_cur) >= length) {
+            memcpy(data, m_cur, length);
+            m_cur += length;
+            return true;
+        }
+        return readSlow(data, length);
+    }
+
+    bool writeRawData(const char *data, uint length);
+    bool skipRawData(uint length);
+
+    //Returns length bytes without copying them if the device exposes its memory. The pointer
+    //is valid until the next operation on the stream. Returns nullptr past the end.
+    const char *readView(uint length);
+
+    bool atEnd() const;
 
 private:
+    static const uint ReadAheadSize = 4096;
+
+    template<typename T>
+    static bool NeedsSwap(ByteOrder order)
+    {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        const ByteOrder nativeOrder = BigEndian;
+#else
+        const ByteOrder nativeOrder = LittleEndian;
+#endif
+        return std::is_arithmetic<T>::value && sizeof(T) > 1 && order != nativeOrder;
+    }
+
+    static void Swap(char *data, uint size)
+    {
+        for (uint i = 0; i < size / 2; i++) {
+            char ch = data[i];
+            data[i] = data[size - 1 - i];
+            data[size - 1 - i] = ch;
+        }
+    }
+
+    bool readSlow(char *data, uint length);
+    bool fill(uint length);
+    bool borrow();
+    void release();
+
     VIODevice *m_device;
+    ByteOrder m_byteOrder;
+    Status m_status;
+
+    //The unread part of the last chunk, which lives either in m_buffer or in the device's memory
+    const char *m_begin;
+    const char *m_cur;
+    const char *m_end;
+    bool m_borrowed;
+    VByteArray m_buffer;
 };
 
 NV_NAMESPACE_END
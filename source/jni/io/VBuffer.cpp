@@ -1,12 +1,60 @@
 #include "VBuffer.h"
 
-#include <sstream>
+#include <stdlib.h>
+#include <string.h>
 
 NV_NAMESPACE_BEGIN
 
 struct VBuffer::Private
 {
-    std::stringstream data;
+    char *data;
+    uint capacity;
+    uint begin;
+    uint end;
+
+    Private()
+        : data(nullptr)
+        , capacity(0)
+        , begin(0)
+        , end(0)
+    {
+    }
+
+    ~Private()
+    {
+        free(data);
+    }
+
+    uint size() const
+    {
+        return end - begin;
+    }
+
+    //Makes room for length more bytes after end
+    void prepare(uint length)
+    {
+        if (capacity - end >= length) {
+            return;
+        }
+
+        const uint used = size();
+        if (capacity - used >= length && begin >= used) {
+            //Enough room once the consumed bytes are dropped, and the moved block doesn't overlap
+            memcpy(data, data + begin, used);
+        } else {
+            uint newCapacity = capacity > 64 ? capacity : 64;
+            while (newCapacity - used < length) {
+                newCapacity *= 2;
+            }
+            char *newData = static_cast<char *>(malloc(newCapacity));
+            memcpy(newData, data + begin, used);
+            free(data);
+            data = newData;
+            capacity = newCapacity;
+        }
+        begin = 0;
+        end = used;
+    }
 };
 
 VBuffer::VBuffer()
@@ -14,6 +62,12 @@ VBuffer::VBuffer()
 {
 }
 
+VBuffer::VBuffer(uint capacity)
+    : d(new Private)
+{
+    reserve(capacity);
+}
+
 VBuffer::~VBuffer()
 {
     delete d;
@@ -21,31 +75,80 @@ VBuffer::~VBuffer()
 
 vint64 VBuffer::bytesAvailable() const
 {
-    vint64 curPos = d->data.tellg();
-    d->data.seekg(0, std::ios::end);
-    vint64 pos = d->data.tellg();
-    d->data.seekg(curPos);
-    return pos - curPos;
+    return d->size();
 }
 
 vint64 VBuffer::size() const
 {
-    std::streampos curPos = d->data.tellg();
-    d->data.seekg(0, std::ios::end);
-    vint64 pos = d->data.tellg();
-    d->data.seekg(curPos);
-    return pos;
+    return d->size();
 }
 
-vint64 VBuffer::readData(char *data, vint64 maxSize)
+uint VBuffer::capacity() const
+{
+    return d->capacity;
+}
+
+void VBuffer::reserve(uint capacity)
+{
+    if (capacity > d->size()) {
+        d->prepare(capacity - d->size());
+    }
+}
+
+void VBuffer::clear()
 {
-    return d->data.readsome(data, maxSize);
+    d->begin = d->end = 0;
+}
+
+const char *VBuffer::data() const
+{
+    return d->data + d->begin;
+}
+
+vint64 VBuffer::skip(vint64 maxSize)
+{
+    const uint length = maxSize < d->size() ? maxSize : d->size();
+    d->begin += length;
+    if (d->begin == d->end) {
+        d->begin = d->end = 0;
+    }
+    return length;
+}
+
+const char *VBuffer::readBuffer(vint64 &length)
+{
+    length = d->size();
+    return d->data ? d->data + d->begin : "";
+}
+
+vint64 VBuffer::writev(const Segment *segments, uint count)
+{
+    uint total = 0;
+    for (uint i = 0; i < count; i++) {
+        total += segments[i].size;
+    }
 
+    d->prepare(total);
+    for (uint i = 0; i < count; i++) {
+        memcpy(d->data + d->end, segments[i].data, segments[i].size);
+        d->end += segments[i].size;
+    }
+    return total;
+}
+
+vint64 VBuffer::readData(char *data, vint64 maxSize)
+{
+    const uint length = maxSize < d->size() ? maxSize : d->size();
+    memcpy(data, d->data + d->begin, length);
+    skip(length);
+    return length;
 }
 
 vint64 VBuffer::writeData(const char *data, vint64 maxSize)
 {
-    d->data.write(data, maxSize);
+    d->prepare(maxSize);
+    memcpy(d->data + d->end, data, maxSize);
+    d->end += maxSize;
     return maxSize;
 }
 
@@ -4,15 +4,37 @@
 
 NV_NAMESPACE_BEGIN
 
+//A contiguous growable byte queue. Written bytes are appended at the end and read from
+//the front, consumed bytes are discarded, so size() is the number of bytes still held.
 class VBuffer : public VIODevice
 {
 public:
+    struct Segment
+    {
+        const char *data;
+        uint size;
+    };
+
     VBuffer();
+    explicit VBuffer(uint capacity);
     ~VBuffer();
 
     vint64 bytesAvailable() const override;
     vint64 size() const override;
 
+    uint capacity() const;
+    void reserve(uint capacity);
+    void clear();
+
+    //Unread bytes, valid until the next write
+    const char *data() const;
+    //Consumes bytes already read through data()
+    vint64 skip(vint64 maxSize) override;
+    const char *readBuffer(vint64 &length) override;
+
+    //Appends all the segments with at most one reallocation
+    vint64 writev(const Segment *segments, uint count);
+
 protected:
     vint64 readData(char *data, vint64 maxSize) override;
     vint64 writeData(const char *data, vint64 maxSize) override;
@@ -3,7 +3,10 @@
 
 #include <fstream>
 
+#include <fcntl.h>
+#include <limits.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 
 NV_NAMESPACE_BEGIN
@@ -12,6 +15,33 @@ struct VFile::Private
 {
     VString path;
     std::fstream data;
+    //Opened on the first map() call
+    int fd;
+    //Backs readBuffer()
+    VMappedView view;
+    vint64 viewOffset;
+    //Looked up once by size() or map(), -1 until then and once the file is written to
+    vint64 size;
+
+    Private()
+        : fd(-1)
+        , viewOffset(0)
+        , size(-1)
+    {
+    }
+
+    ~Private()
+    {
+        closeDescriptor();
+    }
+
+    void closeDescriptor()
+    {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
 };
 
 VFile::VFile()
@@ -63,6 +93,7 @@ bool VFile::open(VIODevice::OpenMode mode)
         std_mode |= std::ios_base::trunc;
     }
     d->data.open(d->path.toUtf8(), std_mode);
+    d->size = -1;
 
     return d->data.is_open() && VIODevice::open(mode);
 }
@@ -70,6 +101,128 @@ bool VFile::open(VIODevice::OpenMode mode)
 void VFile::close()
 {
     d->data.close();
+    d->view = VMappedView();
+    d->closeDescriptor();
+    d->size = -1;
+    VIODevice::close();
+}
+
+vint64 VFile::bytesAvailable() const
+{
+    if (!isReadable()) {
+        return 0;
+    }
+    vint64 available = size() - pos();
+    return available > 0 ? available : 0;
+}
+
+vint64 VFile::size() const
+{
+    if (d->size >= 0) {
+        return d->size;
+    }
+    if (isWritable()) {
+        d->data.flush();
+    }
+    struct stat info;
+    if (stat(d->path.toUtf8().data(), &info) != 0) {
+        return 0;
+    }
+    d->size = info.st_size;
+    return d->size;
+}
+
+vint64 VFile::pos() const
+{
+    vint64 pos = isReadable() ? d->data.tellg() : d->data.tellp();
+    return pos > 0 ? pos : 0;
+}
+
+bool VFile::seek(vint64 pos)
+{
+    d->data.clear();
+    if (isReadable()) {
+        d->data.seekg(pos);
+    }
+    if (isWritable()) {
+        d->data.seekp(pos);
+    }
+    return !d->data.fail();
+}
+
+vint64 VFile::skip(vint64 maxSize)
+{
+    const vint64 available = bytesAvailable();
+    const vint64 length = maxSize < available ? maxSize : available;
+    if (length > 0) {
+        seek(pos() + length);
+    }
+    return length;
+}
+
+const char *VFile::readBuffer(vint64 &length)
+{
+    length = 0;
+    if (!isReadable()) {
+        return nullptr;
+    }
+
+    const vint64 pos = this->pos();
+    const vint64 viewEnd = d->viewOffset + d->view.size();
+    if (d->view.isNull() || pos < d->viewOffset || pos > viewEnd || (pos == viewEnd && size() > viewEnd)) {
+        d->view = map(pos);
+        d->viewOffset = pos;
+        if (d->view.isNull()) {
+            return nullptr;
+        }
+    }
+
+    length = d->view.size() - (pos - d->viewOffset);
+    return d->view.data() + (pos - d->viewOffset);
+}
+
+VMappedView VFile::map(vint64 offset, vint64 size)
+{
+    if (!isReadable()) {
+        vWarn("VFile: only files opened for reading can be mapped");
+        return VMappedView();
+    }
+
+    if (d->fd < 0) {
+        d->fd = ::open(d->path.toUtf8().data(), O_RDONLY);
+        if (d->fd < 0) {
+            vWarn("VFile: failed to open" << d->path << "for mapping");
+            return VMappedView();
+        }
+    }
+
+    if (d->size < 0) {
+        struct stat info;
+        if (fstat(d->fd, &info) != 0) {
+            return VMappedView();
+        }
+        d->size = info.st_size;
+    }
+    if (size < 0) {
+        size = d->size - offset;
+    }
+    if (offset < 0 || size <= 0 || offset + size > d->size) {
+        return VMappedView();
+    }
+
+    //mmap() wants the offset aligned to pages
+    const vint64 pageSize = sysconf(_SC_PAGESIZE);
+    const vint64 alignedOffset = offset & ~(pageSize - 1);
+    const size_t length = size + (offset - alignedOffset);
+    void *region = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, d->fd, alignedOffset);
+    if (region == MAP_FAILED) {
+        vWarn("VFile: failed to map" << d->path);
+        return VMappedView();
+    }
+
+    //Views are usually consumed at once, start reading ahead now
+    madvise(region, length, MADV_WILLNEED);
+    return VMappedView(region, length, static_cast<const char *>(region) + (offset - alignedOffset), size);
 }
 
 bool VFile::exists() const
@@ -82,6 +235,23 @@ bool VFile::Exists(const VString &path)
     return access(path.toUtf8().data(), F_OK) == 0;
 }
 
+bool VFile::Exists(const VByteArrayView &path)
+{
+    //Views aren't null-terminated
+    char buffer[PATH_MAX];
+    if (path.size() >= sizeof(buffer)) {
+        return false;
+    }
+    memcpy(buffer, path.data(), path.size());
+    buffer[path.size()] = '\0';
+    return access(buffer, F_OK) == 0;
+}
+
+bool VFile::Exists(const char *path)
+{
+    return access(path, F_OK) == 0;
+}
+
 bool VFile::IsReadable(const VString &path)
 {
     return access(path.toUtf8().data(), R_OK) == 0;
@@ -94,12 +264,19 @@ bool VFile::IsWritable(const VString &path)
 
 vint64 VFile::readData(char *data, vint64 maxSize)
 {
-    return d->data.readsome(data, maxSize);
+    //readsome() only returns what is already buffered, which may be nothing
+    d->data.read(data, maxSize);
+    vint64 count = d->data.gcount();
+    if (d->data.eof()) {
+        d->data.clear();
+    }
+    return count;
 }
 
 vint64 VFile::writeData(const char *data, vint64 maxSize)
 {
     d->data.write(data, maxSize);
+    d->size = -1;
     return maxSize;
 }
 
@@ -17,8 +17,23 @@ public:
     bool open(OpenMode mode) override;
     void close() override;
 
+    vint64 bytesAvailable() const override;
+    vint64 size() const override;
+    vint64 pos() const override;
+    bool seek(vint64 pos) override;
+    vint64 skip(vint64 maxSize) override;
+
+    //Served from a mapping of the rest of the file
+    const char *readBuffer(vint64 &length) override;
+
+    //Read-only views stay valid after the file is closed
+    VMappedView map(vint64 offset = 0, vint64 size = -1) override;
+
     bool exists() const;
     static bool Exists(const VString &path);
+    //UTF-8 paths are passed on as they are
+    static bool Exists(const VByteArrayView &path);
+    static bool Exists(const char *path);
 
     static bool IsReadable(const VString &path);
     static bool IsWritable(const VString &path);
@@ -104,6 +104,17 @@ VByteArray VIODevice::readAll()
 {
     VByteArray data;
 
+    //Read everything at once if the size is known
+    vint64 available = bytesAvailable();
+    if (available > 0) {
+        data.resize(available);
+        vint64 length = readData(&data[0], available);
+        data.resize(length > 0 ? length : 0);
+        if (length < available) {
+            return data;
+        }
+    }
+
     char buffer[4096];
     vint64 length = 0;
     forever {
@@ -116,6 +127,32 @@ VByteArray VIODevice::readAll()
     return data;
 }
 
+vint64 VIODevice::skip(vint64 maxSize)
+{
+    char buffer[4096];
+    vint64 skipped = 0;
+    while (skipped < maxSize) {
+        vint64 length = readData(buffer, maxSize - skipped < 4096 ? maxSize - skipped : 4096);
+        if (length <= 0) {
+            break;
+        }
+        skipped += length;
+    }
+    return skipped;
+}
+
+const char *VIODevice::readBuffer(vint64 &length)
+{
+    length = 0;
+    return nullptr;
+}
+
+VMappedView VIODevice::map(vint64 offset, vint64 size)
+{
+    NV_UNUSED(offset, size);
+    return VMappedView();
+}
+
 vint64 VIODevice::write(const char *data)
 {
     vint64 size = strlen(data);
@@ -3,6 +3,7 @@
 #include "VByteArray.h"
 #include "VFlags.h"
 #include "VString.h"
+#include "VMappedView.h"
 
 NV_NAMESPACE_BEGIN
 
@@ -55,6 +56,15 @@ public:
     vint64 read(char *data, vint64 maxSize) { return readData(data, maxSize); }
     VByteArray read(vint64 maxSize);
     VByteArray readAll();
+    virtual vint64 skip(vint64 maxSize);
+
+    //Devices keeping their unread bytes in memory return them without copying, others return nullptr.
+    //The pointer is valid until the device is written to, or the bytes are read or skipped.
+    virtual const char *readBuffer(vint64 &length);
+
+    //Maps size bytes from offset (or up to the end if size is negative) without copying.
+    //Returns a null view if the device can't be mapped.
+    virtual VMappedView map(vint64 offset = 0, vint64 size = -1);
 
     vint64 write(const char *data, vint64 maxSize) { return writeData(data, maxSize); }
     vint64 write(const char *data);
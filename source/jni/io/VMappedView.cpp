@@ -0,0 +1,100 @@
+#include "VMappedView.h"
+
+#include <atomic>
+#include <sys/mman.h>
+
+NV_NAMESPACE_BEGIN
+
+struct VMappedView::Region
+{
+    Region(void *address, size_t length) : ref(1), address(address), length(length) {}
+    ~Region() { munmap(address, length); }
+
+    std::atomic<int> ref;
+    void *address;
+    size_t length;
+};
+
+VMappedView::VMappedView()
+    : m_region(nullptr)
+    , m_data(nullptr)
+    , m_size(0)
+{
+}
+
+VMappedView::VMappedView(void *region, size_t regionLength, const char *data, uint size)
+    : m_region(new Region(region, regionLength))
+    , m_data(data)
+    , m_size(size)
+{
+}
+
+VMappedView::VMappedView(const VMappedView &source)
+    : m_region(source.m_region)
+    , m_data(source.m_data)
+    , m_size(source.m_size)
+{
+    if (m_region) {
+        m_region->ref++;
+    }
+}
+
+VMappedView::VMappedView(VMappedView &&source)
+    : m_region(source.m_region)
+    , m_data(source.m_data)
+    , m_size(source.m_size)
+{
+    source.m_region = nullptr;
+    source.m_data = nullptr;
+    source.m_size = 0;
+}
+
+VMappedView::~VMappedView()
+{
+    release();
+}
+
+VByteArray VMappedView::toByteArray() const
+{
+    return m_data ? VByteArray(m_data, m_size) : VByteArray();
+}
+
+VMappedView &VMappedView::operator=(const VMappedView &source)
+{
+    if (this != &source) {
+        if (source.m_region) {
+            source.m_region->ref++;
+        }
+        release();
+        m_region = source.m_region;
+        m_data = source.m_data;
+        m_size = source.m_size;
+    }
+    return *this;
+}
+
+VMappedView &VMappedView::operator=(VMappedView &&source)
+{
+    if (this != &source) {
+        release();
+        m_region = source.m_region;
+        m_data = source.m_data;
+        m_size = source.m_size;
+        source.m_region = nullptr;
+        source.m_data = nullptr;
+        source.m_size = 0;
+    }
+    return *this;
+}
+
+void VMappedView::release()
+{
+    if (m_region && --m_region->ref == 0) {
+        delete m_region;
+    }
+    m_region = nullptr;
+    m_data = nullptr;
+    m_size = 0;
+}
+
+NV_NAMESPACE_END
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "VByteArray.h"
+
+NV_NAMESPACE_BEGIN
+
+// A read-only view of a memory-mapped region. Copies share the mapping, which is
+// released with the last view, so a view may outlive the device it was mapped from.
+class VMappedView
+{
+public:
+    VMappedView();
+    VMappedView(const VMappedView &source);
+    VMappedView(VMappedView &&source);
+    ~VMappedView();
+
+    bool isNull() const { return m_data == nullptr; }
+
+    const char *data() const { return m_data; }
+    const uchar *bytes() const { return reinterpret_cast<const uchar *>(m_data); }
+    uint size() const { return m_size; }
+
+    VByteArray toByteArray() const;
+
+    VMappedView &operator=(const VMappedView &source);
+    VMappedView &operator=(VMappedView &&source);
+
+private:
+    friend class VFile;
+    //Takes over a region returned by mmap()
+    VMappedView(void *region, size_t regionLength, const char *data, uint size);
+
+    void release();
+
+    struct Region;
+    Region *m_region;
+    const char *m_data;
+    uint m_size;
+};
+
+NV_NAMESPACE_END
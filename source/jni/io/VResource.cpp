@@ -15,11 +15,11 @@ struct VResource::Private
 
     void load()
     {
+        //Resources are probed for, so a missing one is left to whoever needs it to report
         const VZipFile &apk = vApp->apkFile();
-        exists = apk.contains(path);
-        if (exists) {
-            data = apk.read(path);
-        }
+        const VByteArray utf8 = path.toUtf8();
+        const VByteArrayView entry(utf8);
+        exists = apk.contains(entry) && apk.read(entry, data);
     }
 };
 
@@ -2,19 +2,284 @@
 #include "VString.h"
 #include "VLog.h"
 
-#include <3rdparty/minizip/unzip.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
 
 NV_NAMESPACE_BEGIN
 
+namespace {
+
+const vuint32 LocalHeaderSignature = 0x04034b50;
+const vuint32 CentralHeaderSignature = 0x02014b50;
+const vuint32 EndOfCentralDirSignature = 0x06054b50;
+
+const uint LocalHeaderSize = 30;
+const uint CentralHeaderSize = 46;
+const uint EndOfCentralDirSize = 22;
+
+const vuint16 MethodStored = 0;
+const vuint16 MethodDeflated = 8;
+
+inline vuint16 ReadUInt16(const uchar *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+inline vuint32 ReadUInt32(const uchar *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<vuint32>(p[3]) << 24);
+}
+
+inline char ToLower(char ch)
+{
+    return (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+}
+
+// FNV-1a over the lower-cased path, lookups are case insensitive like unzLocateFile() used to be
+vuint32 HashPath(const char *path, uint length)
+{
+    vuint32 hash = 2166136261u;
+    for (uint i = 0; i < length; i++) {
+        hash ^= static_cast<uchar>(ToLower(path[i]));
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool EqualPath(const char *a, const char *b, uint length)
+{
+    for (uint i = 0; i < length; i++) {
+        if (ToLower(a[i]) != ToLower(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
 struct VZipFile::Private
 {
-    unzFile handle;
+    struct Entry
+    {
+        VByteArray name;
+        vuint32 hash;
+        vuint16 method;
+        uint compressedSize;
+        uint uncompressedSize;
+        uint localHeaderOffset;
+    };
+
+    Private()
+        : fd(-1)
+        , mapped(nullptr)
+        , fileSize(0)
+    {
+    }
+
+    int fd;
+    const uchar *mapped;
+    size_t fileSize;
+
+    VArray<Entry> entries;
+    // Open addressing, each slot holds an index into entries or -1
+    VArray<int> table;
+
+    bool readAt(uint offset, void *buffer, uint length) const
+    {
+        if (static_cast<size_t>(offset) + length > fileSize) {
+            return false;
+        }
+        if (mapped) {
+            memcpy(buffer, mapped + offset, length);
+            return true;
+        }
+
+        char *out = static_cast<char *>(buffer);
+        while (length > 0) {
+            const ssize_t bytes = pread(fd, out, length, offset);
+            if (bytes <= 0) {
+                return false;
+            }
+            out += bytes;
+            offset += bytes;
+            length -= bytes;
+        }
+        return true;
+    }
+
+    bool readCentralDirectory()
+    {
+        // The end of central directory record sits at the end, followed by a comment of up to 64KB
+        const uint tailSize = fileSize < EndOfCentralDirSize + 0xFFFF ? fileSize : EndOfCentralDirSize + 0xFFFF;
+        if (tailSize < EndOfCentralDirSize) {
+            return false;
+        }
+        VByteArray tail;
+        tail.resize(tailSize);
+        if (!readAt(fileSize - tailSize, &tail[0], tailSize)) {
+            return false;
+        }
+
+        const uchar *tailData = reinterpret_cast<const uchar *>(tail.data());
+        const uchar *record = nullptr;
+        for (int i = tailSize - EndOfCentralDirSize; i >= 0; i--) {
+            if (ReadUInt32(tailData + i) == EndOfCentralDirSignature) {
+                record = tailData + i;
+                break;
+            }
+        }
+        if (record == nullptr) {
+            vWarn("VZipFile: end of central directory not found");
+            return false;
+        }
+
+        const uint entryCount = ReadUInt16(record + 10);
+        const uint directorySize = ReadUInt32(record + 12);
+        const uint directoryOffset = ReadUInt32(record + 16);
+        if (entryCount == 0xFFFF || directoryOffset == 0xFFFFFFFF) {
+            vWarn("VZipFile: ZIP64 archives are not supported");
+            return false;
+        }
+
+        VByteArray directory;
+        directory.resize(directorySize);
+        if (directorySize > 0 && !readAt(directoryOffset, &directory[0], directorySize)) {
+            vWarn("VZipFile: central directory is out of range");
+            return false;
+        }
+
+        entries.reserve(entryCount);
+        const uchar *p = reinterpret_cast<const uchar *>(directory.data());
+        const uchar *end = p + directorySize;
+        for (uint i = 0; i < entryCount; i++) {
+            if (end - p < static_cast<int>(CentralHeaderSize) || ReadUInt32(p) != CentralHeaderSignature) {
+                vWarn("VZipFile: corrupted central directory");
+                return false;
+            }
+
+            const vuint16 flags = ReadUInt16(p + 8);
+            const uint nameLength = ReadUInt16(p + 28);
+            const uint extraLength = ReadUInt16(p + 30);
+            const uint commentLength = ReadUInt16(p + 32);
+            if (end - p < static_cast<int>(CentralHeaderSize + nameLength)) {
+                vWarn("VZipFile: corrupted central directory");
+                return false;
+            }
+
+            Entry entry;
+            entry.name.assign(reinterpret_cast<const char *>(p + CentralHeaderSize), nameLength);
+            entry.hash = HashPath(entry.name.data(), nameLength);
+            entry.method = ReadUInt16(p + 10);
+            entry.compressedSize = ReadUInt32(p + 20);
+            entry.uncompressedSize = ReadUInt32(p + 24);
+            entry.localHeaderOffset = ReadUInt32(p + 42);
+            p += CentralHeaderSize + nameLength + extraLength + commentLength;
+
+            // Encrypted entries can't be read anyway
+            if (flags & 1) {
+                continue;
+            }
+            entries.append(std::move(entry));
+        }
+
+        uint capacity = 16;
+        while (capacity < entries.size() * 2) {
+            capacity <<= 1;
+        }
+        table.assign(capacity, -1);
+        const uint mask = capacity - 1;
+        for (uint i = 0; i < entries.size(); i++) {
+            uint slot = entries[i].hash & mask;
+            while (table[slot] >= 0) {
+                slot = (slot + 1) & mask;
+            }
+            table[slot] = i;
+        }
+        return true;
+    }
+
+    const Entry *find(const VByteArrayView &path) const
+    {
+        if (table.isEmpty()) {
+            return nullptr;
+        }
+
+        const vuint32 hash = HashPath(path.data(), path.size());
+        const uint mask = table.size() - 1;
+        for (uint slot = hash & mask; table[slot] >= 0; slot = (slot + 1) & mask) {
+            const Entry &entry = entries[table[slot]];
+            if (entry.hash == hash && entry.name.size() == path.size() && EqualPath(entry.name.data(), path.data(), path.size())) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    // Skips the local header, whose extra field may differ from the one in the central directory
+    bool dataOffset(const Entry &entry, uint &offset) const
+    {
+        uchar header[LocalHeaderSize];
+        if (!readAt(entry.localHeaderOffset, header, LocalHeaderSize) || ReadUInt32(header) != LocalHeaderSignature) {
+            return false;
+        }
+        offset = entry.localHeaderOffset + LocalHeaderSize + ReadUInt16(header + 26) + ReadUInt16(header + 28);
+        return static_cast<size_t>(offset) + entry.compressedSize <= fileSize;
+    }
+
+    // Decompresses an entry into output, which must hold uncompressedSize bytes.
+    // Each call has its own inflate stream, so different threads may extract at the same time.
+    bool extract(const Entry &entry, void *output) const
+    {
+        uint offset;
+        if (!dataOffset(entry, offset)) {
+            return false;
+        }
+
+        if (entry.method == MethodStored) {
+            return entry.uncompressedSize == entry.compressedSize && readAt(offset, output, entry.uncompressedSize);
+        }
+        if (entry.method != MethodDeflated) {
+            vWarn("VZipFile: unsupported compression method" << entry.method);
+            return false;
+        }
+
+        VByteArray compressed;
+        const uchar *input;
+        if (mapped) {
+            input = mapped + offset;
+        } else {
+            compressed.resize(entry.compressedSize);
+            if (entry.compressedSize > 0 && !readAt(offset, &compressed[0], entry.compressedSize)) {
+                return false;
+            }
+            input = reinterpret_cast<const uchar *>(compressed.data());
+        }
+
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        // Negative window bits: raw deflate data without a zlib header
+        if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+            return false;
+        }
+        stream.next_in = const_cast<Bytef *>(input);
+        stream.avail_in = entry.compressedSize;
+        stream.next_out = static_cast<Bytef *>(output);
+        stream.avail_out = entry.uncompressedSize;
+        const int ret = inflate(&stream, Z_FINISH);
+        inflateEnd(&stream);
+        return ret == Z_STREAM_END && stream.total_out == entry.uncompressedSize;
+    }
 };
 
 VZipFile::VZipFile()
     : d(new Private)
 {
-    d->handle = nullptr;
 }
 
 VZipFile::VZipFile(const VString &packageName)
@@ -31,76 +296,119 @@ VZipFile::~VZipFile()
 
 bool VZipFile::open(const VString &packageName)
 {
-    VByteArray latin1 = packageName.toLatin1();
-    vInfo("VZipFile is opening" << latin1);
-    d->handle = unzOpen(latin1.c_str());
-    return d->handle != nullptr;
+    close();
+
+    VByteArray path = packageName.toUtf8();
+    vInfo("VZipFile is opening" << path);
+    d->fd = ::open(path.c_str(), O_RDONLY);
+    if (d->fd < 0) {
+        vWarn("VZipFile: failed to open" << path);
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(d->fd, &info) != 0) {
+        close();
+        return false;
+    }
+    d->fileSize = info.st_size;
+
+    // Falls back to pread() if the address space is too fragmented for the whole package
+    if (d->fileSize > 0) {
+        void *mapped = mmap(nullptr, d->fileSize, PROT_READ, MAP_SHARED, d->fd, 0);
+        if (mapped != MAP_FAILED) {
+            d->mapped = static_cast<const uchar *>(mapped);
+        } else {
+            vWarn("VZipFile: failed to map" << path << ", reading with pread()");
+        }
+    }
+
+    if (!d->readCentralDirectory()) {
+        vWarn("VZipFile:" << path << "is not a valid zip file");
+        close();
+        return false;
+    }
+    return true;
 }
 
 bool VZipFile::isOpen() const
 {
-    return d->handle != nullptr;
+    return d->fd >= 0;
 }
 
 void VZipFile::close()
 {
-    if (d->handle) {
-        unzClose(d->handle);
+    if (d->mapped) {
+        munmap(const_cast<uchar *>(d->mapped), d->fileSize);
+        d->mapped = nullptr;
+    }
+    if (d->fd >= 0) {
+        ::close(d->fd);
+        d->fd = -1;
     }
+    d->fileSize = 0;
+    d->entries.clear();
+    d->table.clear();
 }
 
 bool VZipFile::contains(const VString &filePath) const
 {
-    VByteArray path = filePath.toUtf8();
-    const int locateRet = unzLocateFile(d->handle, path.c_str(), 2/* case insensitive */);
-    if (locateRet != UNZ_OK) {
-        vInfo("File '" << path << "' not found in apk!");
-        return false;
-    }
+    return d->find(filePath.toUtf8()) != nullptr;
+}
 
-    const int openRet = unzOpenCurrentFile(d->handle);
-    if (openRet != UNZ_OK) {
-        vWarn("Error opening file '" << path << "' from apk!");
-        return false;
-    }
+bool VZipFile::contains(const VByteArrayView &filePath) const
+{
+    return d->find(filePath) != nullptr;
+}
 
-    unzCloseCurrentFile(d->handle);
-    return true;
+bool VZipFile::contains(const char *filePath) const
+{
+    return d->find(filePath) != nullptr;
 }
 
-bool VZipFile::read(const VString &filePath, void *&buffer, uint &length) const
+uint VZipFile::size(const VString &filePath) const
 {
-    if (d->handle == nullptr) {
-        vError("VZipFile is not open");
-        return false;
-    }
+    return size(VByteArrayView(filePath.toUtf8()));
+}
 
-    VByteArray path = filePath.toUtf8();
-    const int locateRet = unzLocateFile(d->handle, path.data(), 2 /* case insensitive */);
-    if (locateRet != UNZ_OK) {
-        vWarn("File '" << path << "' not found in apk!");
-        return false;
+uint VZipFile::size(const VByteArrayView &filePath) const
+{
+    const Private::Entry *entry = d->find(filePath);
+    return entry ? entry->uncompressedSize : 0;
+}
+
+uint VZipFile::size(const char *filePath) const
+{
+    return size(VByteArrayView(filePath));
+}
+
+VArray<VString> VZipFile::entries() const
+{
+    VArray<VString> names;
+    names.reserve(d->entries.size());
+    for (const Private::Entry &entry : d->entries) {
+        names.append(VString::fromUtf8(entry.name));
     }
+    return names;
+}
 
-    unz_file_info info;
-    const int getRet = unzGetCurrentFileInfo(d->handle, &info, NULL, 0, NULL, 0, NULL, 0);
-    if (getRet != UNZ_OK) {
-        vWarn("File info error reading '" << path << "' from apk!");
+bool VZipFile::read(const VString &filePath, void *&buffer, uint &length) const
+{
+    if (!isOpen()) {
+        vError("VZipFile is not open");
         return false;
     }
-    const int openRet = unzOpenCurrentFile(d->handle);
-    if (openRet != UNZ_OK) {
-        vWarn("Error opening file '" << path << "' from apk!");
+
+    const Private::Entry *entry = d->find(filePath.toUtf8());
+    if (entry == nullptr) {
+        vWarn("File '" << filePath << "' not found in apk!");
         return false;
     }
 
-    length = info.uncompressed_size;
+    length = entry->uncompressedSize;
     buffer = malloc(length);
-
-    const int readRet = unzReadCurrentFile(d->handle, buffer, length);
-    unzCloseCurrentFile(d->handle);
-    if (readRet <= 0) {
-        vWarn("Error reading file '" << path << "' from apk!");
+    if (!d->extract(*entry, buffer)) {
+        vWarn("Error reading file '" << filePath << "' from apk!");
         free(buffer);
         buffer = NULL;
         length = 0;
@@ -111,81 +419,90 @@ bool VZipFile::read(const VString &filePath, void *&buffer, uint &length) const
 
 bool VZipFile::read(const VString &filePath, VIODevice *output) const
 {
-    if (d->handle == nullptr) {
-        vError("VZipFile is not open");
-        return false;
+    const VByteArray utf8 = filePath.toUtf8();
+    const VByteArrayView path(utf8);
+    const void *data;
+    uint length;
+    if (map(path, data, length)) {
+        output->write(static_cast<const char *>(data), length);
+        return true;
     }
 
-    VByteArray path = filePath.toUtf8();
-    const int locateRet = unzLocateFile(d->handle, path.data(), 2 /* case insensitive */);
-    if (locateRet != UNZ_OK) {
-        vWarn("File '" << path << "' not found in apk!");
+    VByteArray buffer;
+    if (!read(path, buffer)) {
         return false;
     }
+    output->write(buffer.data(), buffer.size());
+    return true;
+}
 
-    unz_file_info info;
-    const int getRet = unzGetCurrentFileInfo(d->handle, &info, NULL, 0, NULL, 0, NULL, 0);
-    if (getRet != UNZ_OK) {
-        vWarn("File info error reading '" << path << "' from apk!");
+bool VZipFile::read(const VString &filePath, VByteArray &data) const
+{
+    return read(VByteArrayView(filePath.toUtf8()), data);
+}
+
+bool VZipFile::read(const char *filePath, VByteArray &data) const
+{
+    return read(VByteArrayView(filePath), data);
+}
+
+bool VZipFile::read(const VByteArrayView &filePath, VByteArray &data) const
+{
+    if (!isOpen()) {
+        vError("VZipFile is not open");
         return false;
     }
-    const int openRet = unzOpenCurrentFile(d->handle);
-    if (openRet != UNZ_OK) {
-        vWarn("Error opening file '" << path << "' from apk!");
+
+    const Private::Entry *entry = d->find(filePath);
+    if (entry == nullptr) {
+        vWarn("File '" << filePath << "' not found in apk!");
         return false;
     }
 
-    void *buffer = malloc(info.uncompressed_size);
-    const int readRet = unzReadCurrentFile(d->handle, buffer, info.uncompressed_size);
-    unzCloseCurrentFile(d->handle);
-    if (readRet <= 0) {
-        free(buffer);
-        vWarn("Error reading file '" << path << "' from apk!");
+    data.resize(entry->uncompressedSize);
+    if (entry->uncompressedSize > 0 && !d->extract(*entry, &data[0])) {
+        vWarn("Error reading file '" << filePath << "' from apk!");
+        data.clear();
         return false;
     }
-
-    output->write(static_cast<char *>(buffer), info.uncompressed_size);
-    free(buffer);
-
     return true;
 }
 
 VByteArray VZipFile::read(const VString &filePath) const
 {
-    if (d->handle == nullptr) {
-        vError("VZipFile is not open");
-        return VByteArray();
-    }
+    VByteArray buffer;
+    read(filePath, buffer);
+    return buffer;
+}
 
-    VByteArray path = filePath.toUtf8();
-    const int locateRet = unzLocateFile(d->handle, path.data(), 2 /* case insensitive */);
-    if (locateRet != UNZ_OK) {
-        vWarn("File '" << path << "' not found in apk!");
-        return VByteArray();
-    }
+bool VZipFile::map(const VString &filePath, const void *&data, uint &length) const
+{
+    return map(VByteArrayView(filePath.toUtf8()), data, length);
+}
 
-    unz_file_info info;
-    const int getRet = unzGetCurrentFileInfo(d->handle, &info, NULL, 0, NULL, 0, NULL, 0);
-    if (getRet != UNZ_OK) {
-        vWarn("File info error reading '" << path << "' from apk!");
-        return VByteArray();
-    }
-    const int openRet = unzOpenCurrentFile(d->handle);
-    if (openRet != UNZ_OK) {
-        vWarn("Error opening file '" << path << "' from apk!");
-        return VByteArray();
+bool VZipFile::map(const char *filePath, const void *&data, uint &length) const
+{
+    return map(VByteArrayView(filePath), data, length);
+}
+
+bool VZipFile::map(const VByteArrayView &filePath, const void *&data, uint &length) const
+{
+    if (d->mapped == nullptr) {
+        return false;
     }
 
-    VByteArray buffer;
-    buffer.resize(info.uncompressed_size);
-    const int readRet = unzReadCurrentFile(d->handle, &buffer[0], info.uncompressed_size);
-    unzCloseCurrentFile(d->handle);
-    if (readRet <= 0) {
-        vWarn("Error reading file '" << path << "' from apk!");
-        return VByteArray();
+    const Private::Entry *entry = d->find(filePath);
+    if (entry == nullptr || entry->method != MethodStored || entry->compressedSize != entry->uncompressedSize) {
+        return false;
     }
 
-    return buffer;
+    uint offset;
+    if (!d->dataOffset(*entry, offset)) {
+        return false;
+    }
+    data = d->mapped + offset;
+    length = entry->uncompressedSize;
+    return true;
 }
 
 NV_NAMESPACE_END
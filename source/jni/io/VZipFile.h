@@ -2,11 +2,14 @@
 
 #include "VIODevice.h"
 #include "VByteArray.h"
+#include "VArray.h"
 
 NV_NAMESPACE_BEGIN
 
 class VString;
 
+// The central directory is indexed once when the package is opened. All the reading
+// functions are const and position-independent, so they can be called from any thread.
 class VZipFile
 {
 public:
@@ -18,12 +21,28 @@ public:
     bool isOpen() const;
     void close();
 
+    // Entry names are UTF-8, the overloads taking bytes look them up without converting the path
     bool contains(const VString &filePath) const;
+    bool contains(const VByteArrayView &filePath) const;
+    bool contains(const char *filePath) const;
+    uint size(const VString &filePath) const;
+    uint size(const VByteArrayView &filePath) const;
+    uint size(const char *filePath) const;
+    VArray<VString> entries() const;
 
     bool read(const VString &filePath, void *&buffer, uint &length) const;
     bool read(const VString &filePath, VIODevice *output) const;
+    bool read(const VString &filePath, VByteArray &data) const;
+    bool read(const VByteArrayView &filePath, VByteArray &data) const;
+    bool read(const char *filePath, VByteArray &data) const;
     VByteArray read(const VString &filePath) const;
 
+    // Points data at a stored (uncompressed) entry inside the mapped package, no copy is made.
+    // Returns false if the entry is compressed or the package could not be mapped.
+    bool map(const VString &filePath, const void *&data, uint &length) const;
+    bool map(const VByteArrayView &filePath, const void *&data, uint &length) const;
+    bool map(const char *filePath, const void *&data, uint &length) const;
+
 private:
     NV_DECLARE_PRIVATE
     NV_DISABLE_COPY(VZipFile)
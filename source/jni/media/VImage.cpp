@@ -1,6 +1,17 @@
 #include "VImage.h"
+#include "VFile.h"
+#include "VArray.h"
+#include "VTaskScheduler.h"
 
 #include <math.h>
+#include <algorithm>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include <3rdparty/stb/stb_image.h>
 #include <3rdparty/stb/stb_image_write.h>
 
@@ -17,6 +28,7 @@ struct VImage::Private
         : data(nullptr)
         , width(0)
         , height(0)
+        , compress(4)
     {
     }
 
@@ -29,12 +41,30 @@ struct VImage::Private
 
     void load(const VPath &path)
     {
-        data = stbi_load(path.toUtf8().data(), &width, &height, &compress, 4);
+        //Decode straight from the page cache instead of going through stdio
+        VFile file(path, VFile::ReadOnly);
+        VMappedView view = file.map();
+        if (view.isNull()) {
+            clear();
+            data = stbi_load(path.toUtf8().data(), &width, &height, &compress, 4);
+            return;
+        }
+        load(view.bytes(), view.size());
     }
 
-    void load(const VByteArray &encoded)
+    void load(const uchar *encoded, uint length)
     {
-        data = stbi_load_from_memory(reinterpret_cast<const uchar *>(encoded.data()), encoded.size(), &width, &height, &compress, 4);
+        clear();
+        data = stbi_load_from_memory(encoded, length, &width, &height, &compress, 4);
+    }
+
+    void clear()
+    {
+        if (data) {
+            free(data);
+            data = nullptr;
+        }
+        width = height = 0;
     }
 };
 
@@ -75,7 +105,7 @@ VImage::VImage(uchar *decoded, int width, int height)
 VImage::VImage(const VByteArray &encoded)
     : d(new Private)
 {
-    d->load(encoded);
+    d->load(reinterpret_cast<const uchar *>(encoded.data()), encoded.size());
 }
 
 VImage::~VImage()
@@ -91,22 +121,29 @@ bool VImage::load(const VPath &path)
 
 bool VImage::load(const VByteArray &data)
 {
-    d->load(data);
+    d->load(reinterpret_cast<const uchar *>(data.data()), data.size());
+    return isValid();
+}
+
+bool VImage::load(const uchar *data, uint length)
+{
+    d->load(data, length);
     return isValid();
 }
 
 bool VImage::write(const VPath &path) const
 {
+    //Pixels are always decoded to RGBA, whatever the source had
     if (path.endsWith(".png")) {
-        stbi_write_png(path.toUtf8().data(), d->width, d->height, d->compress, d->data, 0);
+        stbi_write_png(path.toUtf8().data(), d->width, d->height, 4, d->data, 0);
         return true;
     }
     if (path.endsWith(".bmp")) {
-        stbi_write_bmp(path.toUtf8().data(), d->width, d->height, d->compress, d->data);
+        stbi_write_bmp(path.toUtf8().data(), d->width, d->height, 4, d->data);
         return true;
     }
     if (path.endsWith(".tga")) {
-        stbi_write_tga(path.toUtf8().data(), d->width, d->height, d->compress, d->data);
+        stbi_write_tga(path.toUtf8().data(), d->width, d->height, 4, d->data);
         return true;
     }
     return false;
@@ -149,7 +186,9 @@ VColor VImage::at(int x, int y) const
     return pixels[index];
 }
 
-static float SRGBToLinear(float c)
+namespace {
+
+float SRGBToLinear(float c)
 {
     const float a = 0.055f;
     if (c <= 0.04045f) {
@@ -159,9 +198,19 @@ static float SRGBToLinear(float c)
     }
 }
 
-static const float BICUBIC_SHARPEN = 0.75f; // same as default PhotoShop bicubic filter
+float LinearToSRGB(float c)
+{
+    const float a = 0.055f;
+    if (c <= 0.0031308f) {
+        return c * 12.92f;
+    } else {
+        return (1.0f + a) * powf(c, (1.0f / 2.4f)) - a;
+    }
+}
+
+const float BICUBIC_SHARPEN = 0.75f; // same as default PhotoShop bicubic filter
 
-static void FilterWeights(float s, VImage::Filter filter, float weights[4])
+void FilterWeights(float s, VImage::Filter filter, float weights[4])
 {
     switch (filter) {
     case VImage::NearestFilter: {
@@ -183,121 +232,335 @@ static void FilterWeights(float s, VImage::Filter filter, float weights[4])
     }
 }
 
-static float LinearToSRGB(float c)
+// Linear values are quantized finely enough for the table to round like powf() would, give or take one step
+const int LinearTableSize = 1 << 14;
+
+// Without srgb, the tables only scale between bytes and [0, 1]
+struct ColorTables
 {
-    const float a = 0.055f;
-    if (c <= 0.0031308f) {
-        return c * 12.92f;
-    } else {
-        return (1.0f + a) * powf(c, (1.0f / 2.4f)) - a;
+    float toLinear[256];
+    uchar toSRGB[LinearTableSize];
+
+    ColorTables(bool srgb)
+    {
+        for (int i = 0; i < 256; i++) {
+            const float value = i * (1.0f / 255.0f);
+            toLinear[i] = srgb ? SRGBToLinear(value) : value;
+        }
+        for (int i = 0; i < LinearTableSize; i++) {
+            const float value = i * (1.0f / (LinearTableSize - 1));
+            const float gamma = srgb ? LinearToSRGB(value) : value;
+            toSRGB[i] = (uchar) std::min(std::max(0, (int) (gamma * 255.0f + 0.5f)), 255);
+        }
     }
+};
+
+const ColorTables &Tables(bool srgb = true)
+{
+    static const ColorTables srgbTables(true);
+    static const ColorTables linearTables(false);
+    return srgb ? srgbTables : linearTables;
 }
 
-void VImage::resize(int newWidth, int newHeight, Filter filter)
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+
+typedef float32x4_t Float4;
+inline Float4 Zero4() { return vdupq_n_f32(0.0f); }
+inline Float4 Load4(const float *p) { return vld1q_f32(p); }
+inline void Store4(float *p, Float4 v) { vst1q_f32(p, v); }
+inline Float4 Add4(Float4 a, Float4 b) { return vaddq_f32(a, b); }
+inline Float4 MulAdd4(Float4 sum, Float4 v, float w) { return vmlaq_n_f32(sum, v, w); }
+inline Float4 Mul4(Float4 v, float w) { return vmulq_n_f32(v, w); }
+// Rounds v * scale to the nearest integer, clamped to [0, max]
+inline void Index4(Float4 v, float scale, int max, int *index)
 {
-    int footprintMin = 0;
-    int footprintMax = 0;
-    int offsetX = 0;
-    int offsetY = 0;
-    switch (filter) {
-    case NearestFilter: {
-        footprintMin = 0;
-        footprintMax = 0;
-        offsetX = d->width;
-        offsetY = d->height;
-        break;
-    }
-    case LinearFilter: {
-        footprintMin = 0;
-        footprintMax = 1;
-        offsetX = d->width - newWidth;
-        offsetY = d->height - newHeight;
-        break;
-    }
-    case CubicFilter: {
-        footprintMin = -1;
-        footprintMax = 2;
-        offsetX = d->width - newWidth;
-        offsetY = d->height - newHeight;
-        break;
+    const int32x4_t rounded = vcvtq_s32_f32(vmlaq_n_f32(vdupq_n_f32(0.5f), v, scale));
+    vst1q_s32(index, vminq_s32(vmaxq_s32(rounded, vdupq_n_s32(0)), vdupq_n_s32(max)));
+}
+
+#elif defined(__SSE2__)
+
+typedef __m128 Float4;
+inline Float4 Zero4() { return _mm_setzero_ps(); }
+inline Float4 Load4(const float *p) { return _mm_loadu_ps(p); }
+inline void Store4(float *p, Float4 v) { _mm_storeu_ps(p, v); }
+inline Float4 Add4(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+inline Float4 MulAdd4(Float4 sum, Float4 v, float w) { return _mm_add_ps(sum, _mm_mul_ps(v, _mm_set1_ps(w))); }
+inline Float4 Mul4(Float4 v, float w) { return _mm_mul_ps(v, _mm_set1_ps(w)); }
+inline void Index4(Float4 v, float scale, int max, int *index)
+{
+    const __m128 clamped = _mm_min_ps(_mm_max_ps(_mm_mul_ps(v, _mm_set1_ps(scale)), _mm_setzero_ps()), _mm_set1_ps((float) max));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(index), _mm_cvtps_epi32(clamped));
+}
+
+#else
+
+struct Float4 { float v[4]; };
+inline Float4 Zero4() { Float4 r = {{0.0f, 0.0f, 0.0f, 0.0f}}; return r; }
+inline Float4 Load4(const float *p) { Float4 r = {{p[0], p[1], p[2], p[3]}}; return r; }
+inline void Store4(float *p, Float4 v) { p[0] = v.v[0]; p[1] = v.v[1]; p[2] = v.v[2]; p[3] = v.v[3]; }
+inline Float4 Add4(Float4 a, Float4 b) { Float4 r = {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}}; return r; }
+inline Float4 MulAdd4(Float4 sum, Float4 v, float w) { Float4 r = {{sum.v[0] + v.v[0] * w, sum.v[1] + v.v[1] * w, sum.v[2] + v.v[2] * w, sum.v[3] + v.v[3] * w}}; return r; }
+inline Float4 Mul4(Float4 v, float w) { Float4 r = {{v.v[0] * w, v.v[1] * w, v.v[2] * w, v.v[3] * w}}; return r; }
+inline void Index4(Float4 v, float scale, int max, int *index)
+{
+    for (int i = 0; i < 4; i++) {
+        index[i] = std::min(std::max(0, (int) (v.v[i] * scale + 0.5f)), max);
     }
+}
+
+#endif
+
+inline Float4 LinearPixel(const ColorTables &tables, const uchar *pixel)
+{
+    const float linear[4] = {tables.toLinear[pixel[0]], tables.toLinear[pixel[1]], tables.toLinear[pixel[2]], tables.toLinear[pixel[3]]};
+    return Load4(linear);
+}
+
+inline void StoreSRGB(const ColorTables &tables, Float4 linear, uchar *pixel)
+{
+    int index[4];
+    Index4(linear, LinearTableSize - 1, LinearTableSize - 1, index);
+    pixel[0] = tables.toSRGB[index[0]];
+    pixel[1] = tables.toSRGB[index[1]];
+    pixel[2] = tables.toSRGB[index[2]];
+    pixel[3] = tables.toSRGB[index[3]];
+}
+
+// Kaiser-windowed sinc sampled at the six source pixels around each output pixel of a halving,
+// as mipmap tools usually use it: three output pixels wide, alpha 4
+const int KaiserTapCount = 6;
+
+float BesselI0(float x)
+{
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (int k = 1; k < 20; k++) {
+        term *= (x * 0.5f) / k;
+        sum += term * term;
     }
+    return sum;
+}
 
-    uchar *scaled = (uchar *) malloc(newWidth * newHeight * 4);
+struct KaiserKernel
+{
+    float weight[KaiserTapCount];
 
-    float *srcLinear = (float *) malloc(d->width * d->height * 4 * sizeof(float));
-    float *scaledLinear = (float *) malloc(newWidth * newHeight * 4 * sizeof(float));
+    KaiserKernel()
+    {
+        const float width = 3.0f;
+        const float alpha = 4.0f;
+        float total = 0.0f;
+        for (int t = 0; t < KaiserTapCount; t++) {
+            //Distance from the output pixel center in output pixels
+            const float x = (t - (KaiserTapCount - 1) * 0.5f) * 0.5f;
+            const float sinc = sinf((float) M_PI * x) / ((float) M_PI * x);
+            const float r = x / (width * 0.5f);
+            weight[t] = sinc * BesselI0(alpha * sqrtf(1.0f - r * r)) / BesselI0(alpha);
+            total += weight[t];
+        }
+        for (int t = 0; t < KaiserTapCount; t++) {
+            weight[t] /= total;
+        }
+    }
+};
+
+// Source positions and weights of every output column or row, clamped to the edges
+struct FilterTaps
+{
+    int count;
+    VArray<int> index;
+    VArray<float> weight;
 
-    float table[256];
-    for (int i = 0; i < 256; i++) {
-        table[i] = SRGBToLinear(i * (1.0f / 255.0f));
+    // Kaiser halving as mip levels do, rounding down and never below one pixel
+    FilterTaps(int srcSize, const KaiserKernel &kaiser)
+        : count(KaiserTapCount)
+    {
+        const int dstSize = std::max(1, srcSize >> 1);
+        index.resize(dstSize * count);
+        weight.resize(dstSize * count);
+        for (int i = 0; i < dstSize; i++) {
+            const int first = i * 2 - (count - 2) / 2;
+            for (int t = 0; t < count; t++) {
+                index[i * count + t] = std::min(std::max(0, first + t), srcSize - 1);
+                weight[i * count + t] = kaiser.weight[t];
+            }
+        }
     }
 
-    for (int y = 0; y < d->height; y++) {
-        for (int x = 0; x < d->width; x++) {
-            for (int c = 0; c < 4; c++) {
-                srcLinear[(y * d->width + x) * 4 + c] = table[d->data[(y * d->width + x) * 4 + c]];
+    FilterTaps(int srcSize, int dstSize, VImage::Filter filter)
+    {
+        int footprintMin = 0;
+        int offset = 0;
+        switch (filter) {
+        case VImage::NearestFilter:
+            footprintMin = 0;
+            count = 1;
+            offset = srcSize;
+            break;
+        case VImage::LinearFilter:
+            footprintMin = 0;
+            count = 2;
+            offset = srcSize - dstSize;
+            break;
+        case VImage::CubicFilter:
+            footprintMin = -1;
+            count = 4;
+            offset = srcSize - dstSize;
+            break;
+        }
+
+        index.resize(dstSize * count);
+        weight.resize(dstSize * count);
+        for (int i = 0; i < dstSize; i++) {
+            const int src = (i * srcSize * 2 + offset) / (dstSize * 2);
+            const float position = ((float) i * srcSize * 2.0f + offset) / (dstSize * 2.0f);
+            float weights[4] = {0.0f};
+            FilterWeights(position - floorf(position), filter, weights);
+            for (int t = 0; t < count; t++) {
+                index[i * count + t] = std::min(std::max(0, src + footprintMin + t), srcSize - 1);
+                weight[i * count + t] = weights[t];
             }
         }
     }
+};
 
-    auto FracFloat = [](float x){
-        return x - floorf(x);
-    };
+// Splits rows into bands processed by the task scheduler and the calling thread. Small jobs stay
+// on the calling thread.
+template<typename Function>
+void ParallelRows(int rows, int pixelsPerRow, const Function &function)
+{
+    const int minPixelsPerBand = 64 * 1024;
+    VTaskScheduler *scheduler = VTaskScheduler::instance();
+    int bandNum = std::min(scheduler->workerCount() + 1, rows);
+    bandNum = std::min(bandNum, std::max(1, (int) ((longlong) rows * pixelsPerRow / minPixelsPerBand)));
+    if (bandNum <= 1) {
+        function(0, rows);
+        return;
+    }
 
-    for (int y = 0; y < newHeight; y++) {
-        const int srcY = (y * d->height * 2 + offsetY) / (newHeight * 2);
-        const float fracY = FracFloat(((float) y * d->height * 2.0f + offsetY) / (newHeight * 2.0f));
+    //Bands keep filtered source rows between output rows, so they are few and long
+    const int bandSize = (rows + bandNum - 1) / bandNum;
+    scheduler->parallelFor(0, rows, function, bandSize);
+}
 
-        float weightsY[4] = {0.0};
-        FilterWeights(fracY, filter, weightsY);
+// Separable filtering: source rows are filtered horizontally once and kept while the next output
+// rows still need them, then the output row is a weighted sum of up to eight of them.
+void ResizeRows(const ColorTables &tables, const uchar *src, int srcWidth, uchar *dst, int dstWidth, const FilterTaps &tapsX, const FilterTaps &tapsY, int firstRow, int lastRow)
+{
+    const int rowLength = dstWidth * 4;
+
+    // Taps of a row are consecutive source rows, so they never share a slot
+    const int slotNum = 8;
+    VArray<float> cache;
+    cache.resize(rowLength * slotNum);
+    int cachedRows[slotNum] = {-1, -1, -1, -1, -1, -1, -1, -1};
+
+    // When the taps read each source pixel more than once, it is cheaper to convert the row first
+    const bool linearizeRow = srcWidth < dstWidth * tapsX.count;
+    VArray<float> linearRow;
+    if (linearizeRow) {
+        linearRow.resize(srcWidth * 4);
+    }
 
-        for (int x = 0; x < newWidth; x++) {
-            const int srcX = ( x * d->width * 2 + offsetX ) / ( newWidth * 2 );
-            const float fracX = FracFloat(((float) x * d->width * 2.0f + offsetX) / (newWidth * 2.0f));
-
-            float weightsX[4] = {0.0};
-            FilterWeights(fracX, filter, weightsX);
-
-            float fR = 0.0f;
-            float fG = 0.0f;
-            float fB = 0.0f;
-            float fA = 0.0f;
-
-            for (int fpY = footprintMin; fpY <= footprintMax; fpY++) {
-                const float wY = weightsY[fpY - footprintMin];
-
-                for (int fpX = footprintMin; fpX <= footprintMax; fpX++) {
-                    const float wX = weightsX[fpX - footprintMin];
-                    const float wXY = wX * wY;
-
-                    const int cx = std::min(std::max(0, srcX + fpX), d->width - 1);
-                    const int cy = std::min(std::max(0, srcY + fpY), d->height - 1);
-                    fR += srcLinear[(cy * d->width + cx) * 4 + 0] * wXY;
-                    fG += srcLinear[(cy * d->width + cx) * 4 + 1] * wXY;
-                    fB += srcLinear[(cy * d->width + cx) * 4 + 2] * wXY;
-                    fA += srcLinear[(cy * d->width + cx) * 4 + 3] * wXY;
+    for (int y = firstRow; y < lastRow; y++) {
+        const float *rows[slotNum];
+        const float *weightsY = &tapsY.weight[y * tapsY.count];
+        for (int t = 0; t < tapsY.count; t++) {
+            const int srcY = tapsY.index[y * tapsY.count + t];
+            const int slot = srcY & (slotNum - 1);
+            float *row = &cache[slot * rowLength];
+            if (cachedRows[slot] != srcY) {
+                const uchar *in = src + srcY * srcWidth * 4;
+                const int *index = tapsX.index.data();
+                const float *weight = tapsX.weight.data();
+                if (linearizeRow) {
+                    for (int i = 0; i < srcWidth * 4; i++) {
+                        linearRow[i] = tables.toLinear[in[i]];
+                    }
+                    const float *linear = linearRow.data();
+                    for (int x = 0; x < dstWidth; x++) {
+                        Float4 sum = Zero4();
+                        for (int i = 0; i < tapsX.count; i++) {
+                            sum = MulAdd4(sum, Load4(linear + index[i] * 4), weight[i]);
+                        }
+                        Store4(row + x * 4, sum);
+                        index += tapsX.count;
+                        weight += tapsX.count;
+                    }
+                } else {
+                    for (int x = 0; x < dstWidth; x++) {
+                        Float4 sum = Zero4();
+                        for (int i = 0; i < tapsX.count; i++) {
+                            sum = MulAdd4(sum, LinearPixel(tables, in + index[i] * 4), weight[i]);
+                        }
+                        Store4(row + x * 4, sum);
+                        index += tapsX.count;
+                        weight += tapsX.count;
+                    }
                 }
+                cachedRows[slot] = srcY;
             }
+            rows[t] = row;
+        }
 
-            scaledLinear[(y * newWidth + x) * 4 + 0] = fR;
-            scaledLinear[(y * newWidth + x) * 4 + 1] = fG;
-            scaledLinear[(y * newWidth + x) * 4 + 2] = fB;
-            scaledLinear[(y * newWidth + x) * 4 + 3] = fA;
+        uchar *out = dst + y * rowLength;
+        for (int i = 0; i < rowLength; i += 4) {
+            Float4 sum = Mul4(Load4(rows[0] + i), weightsY[0]);
+            for (int t = 1; t < tapsY.count; t++) {
+                sum = MulAdd4(sum, Load4(rows[t] + i), weightsY[t]);
+            }
+            StoreSRGB(tables, sum, out + i);
         }
     }
+}
 
-    for (int y = 0; y < newHeight; y++) {
+// 2x2 box filter halving each dimension, with edges repeated when a dimension is 1
+void QuarterRows(const ColorTables &tables, const uchar *in, int width, int height, uchar *out, int firstRow, int lastRow)
+{
+    const int newWidth = std::max(1, width >> 1);
+    for (int y = firstRow; y < lastRow; y++) {
+        const uchar *row0 = in + y * 2 * width * 4;
+        const uchar *row1 = in + std::min(y * 2 + 1, height - 1) * width * 4;
+        uchar *out_p = out + y * newWidth * 4;
         for (int x = 0; x < newWidth; x++) {
-            for (int c = 0; c < 4; c++) {
-                const float gamma = LinearToSRGB( scaledLinear[ ( y * newWidth + x ) * 4 + c ] );
-                scaled[(y * newWidth + x) * 4 + c] = ( unsigned char ) std::min(std::max(0, (int) (gamma * 255.0f + 0.5f)), 255);
-            }
+            const int x0 = x * 2 * 4;
+            const int x1 = std::min(x * 2 + 1, width - 1) * 4;
+            Float4 sum = Add4(Add4(LinearPixel(tables, row0 + x0), LinearPixel(tables, row0 + x1)),
+                              Add4(LinearPixel(tables, row1 + x0), LinearPixel(tables, row1 + x1)));
+            StoreSRGB(tables, Mul4(sum, 0.25f), out_p);
+            out_p += 4;
         }
     }
+}
 
-    free(scaledLinear);
-    free(srcLinear);
+}
+
+void VImage::resize(int newWidth, int newHeight, Filter filter)
+{
+    const FilterTaps tapsX(d->width, newWidth, filter);
+    const FilterTaps tapsY(d->height, newHeight, filter);
+
+    uchar *scaled = (uchar *) malloc(newWidth * newHeight * 4);
+    const uchar *src = d->data;
+    const int srcWidth = d->width;
+
+    if (filter == NearestFilter) {
+        // A single tap of weight one converts to linear and back to the same value
+        ParallelRows(newHeight, newWidth, [&](int firstRow, int lastRow) {
+            for (int y = firstRow; y < lastRow; y++) {
+                const vuint32 *in = reinterpret_cast<const vuint32 *>(src) + tapsY.index[y] * srcWidth;
+                vuint32 *out = reinterpret_cast<vuint32 *>(scaled) + y * newWidth;
+                for (int x = 0; x < newWidth; x++) {
+                    out[x] = in[tapsX.index[x]];
+                }
+            }
+        });
+    } else {
+        ParallelRows(newHeight, newWidth * tapsX.count, [&](int firstRow, int lastRow) {
+            ResizeRows(Tables(), src, srcWidth, scaled, newWidth, tapsX, tapsY, firstRow, lastRow);
+        });
+    }
 
     free(d->data);
     d->data = scaled;
@@ -307,44 +570,94 @@ void VImage::resize(int newWidth, int newHeight, Filter filter)
 
 void VImage::quarter(bool srgb)
 {
-    float table[256];
-    if (srgb) {
-        for (int i = 0; i < 256; i++) {
-            table[i] = SRGBToLinear(i * (1.0f / 255.0f));
-        }
-    }
-
     const int width = this->width();
     const int height = this->height();
     const int newWidth = std::max(1, width >> 1);
     const int newHeight = std::max(1, height >> 1);
     uchar *out = (uchar *) malloc(newWidth * newHeight * 4);
-    uchar *out_p = out;
-    for (int y = 0; y < newHeight; y++) {
-        const uchar *in_p = d->data + y * 2 * width * 4;
-        for (int x = 0; x < newWidth; x++) {
-            for (int i = 0; i < 4; i++) {
-                if (srgb) {
-                    const float linear = (table[in_p[i]]
-                            + table[in_p[4 + i]]
-                            + table[in_p[width * 4 + i]]
-                            + table[in_p[width * 4 + 4 + i]]) * 0.25f;
-                    const float gamma = LinearToSRGB(linear);
-                    out_p[i] = (uchar) std::min(std::max(0, (int) (gamma * 255.0f + 0.5f)), 255);
-                } else {
-                    out_p[i] = (in_p[i] + in_p[4 + i] + in_p[width * 4 + i] + in_p[width * 4 + 4 + i]) >> 2;
+    const uchar *in = d->data;
+
+    ParallelRows(newHeight, newWidth * 4, [&](int firstRow, int lastRow) {
+        if (srgb) {
+            QuarterRows(Tables(), in, width, height, out, firstRow, lastRow);
+            return;
+        }
+        for (int y = firstRow; y < lastRow; y++) {
+            const uchar *row0 = in + y * 2 * width * 4;
+            const uchar *row1 = in + std::min(y * 2 + 1, height - 1) * width * 4;
+            uchar *out_p = out + y * newWidth * 4;
+            for (int x = 0; x < newWidth; x++) {
+                const int x0 = x * 2 * 4;
+                const int x1 = std::min(x * 2 + 1, width - 1) * 4;
+                for (int i = 0; i < 4; i++) {
+                    out_p[i] = (row0[x0 + i] + row0[x1 + i] + row1[x0 + i] + row1[x1 + i]) >> 2;
                 }
+                out_p += 4;
             }
-            out_p += 4;
-            in_p += 8;
         }
-    }
+    });
+
     free(d->data);
     d->data = out;
     d->width = newWidth;
     d->height = newHeight;
 }
 
+VMipChain VImage::buildMipChain(bool srgb, VMipChain::Filter filter) const
+{
+    VMipChain chain;
+    buildMipChain(chain, srgb, filter);
+    return chain;
+}
+
+void VImage::buildMipChain(VMipChain &chain, bool srgb, VMipChain::Filter filter) const
+{
+    if (!isValid()) {
+        chain.clear();
+        return;
+    }
+
+    chain.allocate(d->width, d->height);
+    const int rowLength = d->width * 4;
+    if (chain.levelCount() == 1) {
+        memcpy(chain.levelData(0), d->data, length());
+        return;
+    }
+
+    // Each level needs the whole previous one, so the rows of a level are spread over the cores
+    // and the small levels at the end run on this thread
+    const ColorTables &tables = Tables(srgb);
+    for (int i = 1; i < chain.levelCount(); i++) {
+        const int srcWidth = chain.width(i - 1);
+        const int srcHeight = chain.height(i - 1);
+        const int dstWidth = chain.width(i);
+        const int dstHeight = chain.height(i);
+        uchar *dst = chain.levelData(i);
+        if (filter == VMipChain::BoxFilter) {
+            // The first level is read from the image and copied while its rows are in the cache
+            const uchar *src = i == 1 ? d->data : chain.level(i - 1);
+            ParallelRows(dstHeight, dstWidth * 4, [&](int firstRow, int lastRow) {
+                if (i == 1) {
+                    const int lastSrcRow = lastRow == dstHeight ? srcHeight : lastRow * 2;
+                    memcpy(chain.levelData(0) + firstRow * 2 * rowLength, d->data + firstRow * 2 * rowLength, (lastSrcRow - firstRow * 2) * rowLength);
+                }
+                QuarterRows(tables, src, srcWidth, srcHeight, dst, firstRow, lastRow);
+            });
+        } else {
+            if (i == 1) {
+                memcpy(chain.levelData(0), d->data, length());
+            }
+            const uchar *src = chain.level(i - 1);
+            static const KaiserKernel kaiser;
+            const FilterTaps tapsX(srcWidth, kaiser);
+            const FilterTaps tapsY(srcHeight, kaiser);
+            ParallelRows(dstHeight, dstWidth * tapsX.count, [&](int firstRow, int lastRow) {
+                ResizeRows(tables, src, srcWidth, dst, dstWidth, tapsX, tapsY, firstRow, lastRow);
+            });
+        }
+    }
+}
+
 bool VImage::operator==(const VImage &source) const
 {
     if (width() != source.width() || height() != source.height()) {
@@ -2,6 +2,7 @@
 
 #include "VPath.h"
 #include "VColor.h"
+#include "VMipChain.h"
 
 NV_NAMESPACE_BEGIN
 
@@ -27,6 +28,7 @@ public:
 
     bool load(const VPath &path);
     bool load(const VByteArray &data);
+    bool load(const uchar *data, uint length);
 
     bool write(const VPath &path) const;
 
@@ -43,6 +45,10 @@ public:
     void resize(int width, int height, Filter filter = NearestFilter);
     void quarter(bool srgb);
 
+    //Filters in linear space if srgb is set. Levels are built from the previous one.
+    VMipChain buildMipChain(bool srgb, VMipChain::Filter filter = VMipChain::BoxFilter) const;
+    void buildMipChain(VMipChain &chain, bool srgb, VMipChain::Filter filter = VMipChain::BoxFilter) const;
+
     bool operator==(const VImage &source) const;
 
 private:
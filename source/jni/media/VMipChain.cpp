@@ -0,0 +1,55 @@
+#include "VMipChain.h"
+
+#include <algorithm>
+
+NV_NAMESPACE_BEGIN
+
+VMipChain::VMipChain()
+    : m_width(0)
+    , m_height(0)
+{
+}
+
+void VMipChain::clear()
+{
+    m_width = m_height = 0;
+    m_offsets.clear();
+    m_data.clear();
+}
+
+int VMipChain::width(int level) const
+{
+    return std::max(1, m_width >> level);
+}
+
+int VMipChain::height(int level) const
+{
+    return std::max(1, m_height >> level);
+}
+
+int VMipChain::LevelCount(int width, int height)
+{
+    int count = 1;
+    for (int size = std::max(width, height); size > 1; size >>= 1) {
+        count++;
+    }
+    return count;
+}
+
+void VMipChain::allocate(int width, int height)
+{
+    m_width = width;
+    m_height = height;
+
+    const int count = LevelCount(width, height);
+    m_offsets.resize(count);
+    uint length = 0;
+    for (int i = 0; i < count; i++) {
+        m_offsets[i] = length;
+        length += levelLength(i);
+    }
+    //Shrinking or growing within the capacity doesn't reallocate
+    m_data.resize(length);
+}
+
+NV_NAMESPACE_END
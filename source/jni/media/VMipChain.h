@@ -0,0 +1,49 @@
+#pragma once
+
+#include "VArray.h"
+
+NV_NAMESPACE_BEGIN
+
+// RGBA8 mip levels of an image down to 1x1, largest first and packed one after another in a
+// single allocation, the layout glTexImage2D() uploads level by level. Rebuilding into an
+// existing chain reuses its memory.
+class VMipChain
+{
+public:
+    enum Filter
+    {
+        BoxFilter,
+        KaiserFilter
+    };
+
+    VMipChain();
+
+    bool isEmpty() const { return m_offsets.isEmpty(); }
+    void clear();
+
+    int levelCount() const { return m_offsets.length(); }
+    int width(int level = 0) const;
+    int height(int level = 0) const;
+
+    const uchar *level(int i) const { return m_data.data() + m_offsets[i]; }
+    uint levelLength(int i) const { return width(i) * height(i) * 4; }
+    uint offset(int i) const { return m_offsets[i]; }
+
+    const uchar *data() const { return m_data.data(); }
+    uint length() const { return m_data.size(); }
+
+    static int LevelCount(int width, int height);
+
+private:
+    friend class VImage;
+    //Lays out the levels of a width x height image, keeping the memory already allocated
+    void allocate(int width, int height);
+    uchar *levelData(int i) { return m_data.data() + m_offsets[i]; }
+
+    int m_width;
+    int m_height;
+    VArray<uint> m_offsets;
+    VArray<uchar> m_data;
+};
+
+NV_NAMESPACE_END
@@ -5,12 +5,10 @@
 #include "VResource.h"
 #include "VStandardPath.h"
 #include "VModule.h"
-#include "VMap.h"
+#include "VStringHash.h"
 #include "App.h"
 
 #include <list>
-#include <fstream>
-#include <sstream>
 
 NV_NAMESPACE_BEGIN
 
@@ -32,7 +30,7 @@ NV_ADD_MODULE(VSoundModule)
 
 struct VSoundManager::Private
 {
-    VMap<VString, VString> soundMap;
+    VStringHash<VString> soundMap;
 
     void loadSoundAssetsFromJsonObject(const VString &url, const VJson &dataFile)
     {
@@ -68,10 +66,7 @@ struct VSoundManager::Private
             vFatal("VSoundManager::LoadSoundAssetsFromPackage failed to read" << jsonFilePath);
         }
 
-        std::stringstream buffer;
-        buffer << jsonFile.data();
-        VJson data;
-        buffer >> data;
+        VJson data = VJson::Parse(jsonFile.data());
         if (data.isNull()) {
             vFatal("VSoundManager::LoadSoundAssetsFromPackage failed json parse on" << jsonFilePath);
         }
@@ -105,9 +100,7 @@ void VSoundManager::loadSoundAssets()
 	// First look for sound definition using SearchPaths for dev
 	VString foundPath;
     if (GetFullPath(searchPaths, DEV_SOUNDS_RELATIVE, foundPath)) {
-        std::ifstream fp(foundPath.toStdString(), std::ios::binary);
-		VJson dataFile;
-		fp >> dataFile;
+		VJson dataFile = VJson::Load(foundPath);
         if (dataFile.isNull()) {
             vFatal("VSoundManager::LoadSoundAssets failed to load JSON meta file:" << foundPath);
 		}
@@ -125,7 +118,7 @@ void VSoundManager::loadSoundAssets()
 		}
 	}
 
-    if (d->soundMap.empty()) {
+    if (d->soundMap.isEmpty()) {
         vFatal("SoundManger - failed to load any sound definition files!");
 	}
 }
@@ -138,7 +131,7 @@ bool  VSoundManager::hasSound(const VString &soundName)
 
 bool  VSoundManager::getSound(const VString &soundName, VString & outSound)
 {
-    std::map<VString, VString>::const_iterator soundMapping = d->soundMap.find(soundName);
+    VStringHash<VString>::ConstIterator soundMapping = d->soundMap.find(soundName);
     if (soundMapping != d->soundMap.end()) {
         outSound = soundMapping->second;
 		return true;
@@ -0,0 +1,549 @@
+#include "VTextureContainer.h"
+
+#include "VFile.h"
+#include "VLog.h"
+#include "VTexture.h"
+
+#include <algorithm>
+#include <string.h>
+
+NV_NAMESPACE_BEGIN
+
+//The levels VTexture has containers skip, kept out of VTexture.cpp so that it can be used without GL
+int VTexture::skippedMipLevels = 0;
+
+namespace {
+
+// The GL enums of the formats read, without including the GL headers
+enum
+{
+    GL_TEXTURE_2D = 0x0DE1,
+    GL_TEXTURE_CUBE_MAP = 0x8513,
+    GL_UNSIGNED_BYTE = 0x1401,
+    GL_RED = 0x1903,
+    GL_RGB = 0x1907,
+    GL_RGBA = 0x1908,
+    GL_R8 = 0x8229,
+    GL_SRGB8 = 0x8C41,
+    GL_SRGB8_ALPHA8 = 0x8C43,
+    GL_COMPRESSED_RGBA_S3TC_DXT1_EXT = 0x83F1,
+    GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG = 0x8C00,
+    GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG = 0x8C02,
+    GL_ATC_RGB_AMD = 0x8C92,
+    GL_ATC_RGBA_EXPLICIT_ALPHA_AMD = 0x8C93,
+    GL_ETC1_RGB8_OES = 0x8D64,
+    GL_COMPRESSED_RGB8_ETC2 = 0x9274,
+    GL_COMPRESSED_SRGB8_ETC2 = 0x9275,
+    GL_COMPRESSED_RGBA8_ETC2_EAC = 0x9278,
+    GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC = 0x9279,
+    GL_COMPRESSED_RGBA_ASTC_4x4_KHR = 0x93B0,
+    GL_COMPRESSED_RGBA_ASTC_6x6_KHR = 0x93B4,
+    GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR = 0x93D0,
+    GL_COMPRESSED_SRGB8_ALPHA8_ASTC_6x6_KHR = 0x93D4
+};
+
+// Larger than this would overflow the sizes of the levels
+const vuint32 MaxSize = 32768;
+
+int MaxLevelCount(int width, int height)
+{
+    int count = 1;
+    for (int size = std::max(width, height); size > 1; size >>= 1) {
+        count++;
+    }
+    return count;
+}
+
+/*
+
+PVR Container Format
+
+Offset    Size       Name           Description
+0x0000    4 [DWORD]  Version        0x03525650
+0x0004    4 [DWORD]  Flags          0x0000 if no flags set
+                                    0x0002 if colors within the texture
+0x0008    8 [Union]  Pixel Format   This can either be one of several predetermined enumerated
+                                    values (a DWORD) or a 4-character array and a 4-byte array (8 bytes).
+                                    If the most significant 4 bytes of the 64-bit (8-byte) value are all zero,
+                                    then it indicates that it is the enumeration with the following values:
+                                    Value  Pixel Type
+                                    0      PVRTC 2bpp RGB
+                                    1      PVRTC 2bpp RGBA
+                                    2      PVRTC 4bpp RGB
+                                    3      PVRTC 4bpp RGBA
+                                    4      PVRTC-II 2bpp
+                                    5      PVRTC-II 4bpp
+                                    6      ETC1
+                                    7      DXT1 / BC1
+                                    8      DXT2
+                                    9      DXT3 / BC2
+                                    10     DXT4
+                                    11     DXT5 / BC3
+                                    12     BC4
+                                    13     BC5
+                                    14     BC6
+                                    15     BC7
+                                    16     UYVY
+                                    17     YUY2
+                                    18     BW1bpp
+                                    19     R9G9B9E5 Shared Exponent
+                                    20     RGBG8888
+                                    21     GRGB8888
+                                    22     ETC2 RGB
+                                    23     ETC2 RGBA
+                                    24     ETC2 RGB A1
+                                    25     EAC R11 Unsigned
+                                    26     EAC R11 Signed
+                                    27     EAC RG11 Unsigned
+                                    28     EAC RG11 Signed
+                                    If the most significant 4 bytes are not zero then the 8-byte character array
+                                    indicates the pixel format as follows:
+                                    The least significant 4 bytes indicate channel order, such as:
+                                    { 'b', 'g', 'r', 'a' } or { 'b', 'g', 'r', '\0' }
+                                    The most significant 4 bytes indicate the width of each channel in bits, as follows:
+                                    { 4, 4, 4, 4 } or { 2, 2, 2, 2 }, or {5, 5, 5, 0 }
+0x0010  4 [DWORD]    Color Space    This is an enumerated field, currently two values:
+                                    Value   Color Space
+                                    0       Linear RGB
+                                    1       Standard RGB
+0x0014  4 [DWORD]    Channel Type   This is another enumerated field:
+                                    Value   Data Type
+                                    0       Unsigned Byte Normalized
+                                    1       Signed Byte Normalized
+                                    2       Unsigned Byte
+                                    3       Signed Byte
+                                    4       Unsigned Short Normalized
+                                    5       Signed Short Normalized
+                                    6       Unsigned Short
+                                    7       Signed Short
+                                    8       Unsigned Integer Normalized
+                                    9       Signed Integer Normalized
+                                    10      Unsigned Integer
+                                    11      Signed Integer
+                                    12      Float (no size specified)
+0x0018  4 [DWORD]    Height         Height of the image.
+0x001C  4 [DWORD]    Width          Width of the image.
+0x0020  4 [DWORD]    Depth          Depth of the image, in pixels.
+0x0024  4 [DWORD]    Surface Count  The number of surfaces to this texture, used for texture arrays.
+0x0028  4 [DWORD]    Face Count     The number of faces to this texture, used for cube maps.
+0x002C  4 [DWORD]    MIP-Map Count  The number of MIP-Map levels, including a top level.
+0x0030  4 [DWORD]    Metadata Size  The size, in bytes, of meta data that immediately follows this header.
+
+The levels follow the meta data, largest first, with the faces of each one after another.
+
+*/
+
+#pragma pack(1)
+struct PvrHeader
+{
+    vuint32 version;
+    vuint32 flags;
+    vuint64 pixelFormat;
+    vuint32 colorSpace;
+    vuint32 channelType;
+    vuint32 height;
+    vuint32 width;
+    vuint32 depth;
+    vuint32 numSurfaces;
+    vuint32 numFaces;
+    vuint32 mipMapCount;
+    vuint32 metaDataSize;
+};
+#pragma pack()
+
+/*
+
+KTX Container Format
+
+KTX is a format for storing textures for OpenGL and OpenGL ES applications.
+It is distinguished by the simplicity of the loader required to instantiate
+a GL texture object from the file contents.
+
+Byte[12] identifier
+vuint32 endianness
+vuint32 glType
+vuint32 glTypeSize
+vuint32 glFormat
+Uint32 glInternalFormat
+Uint32 glBaseInternalFormat
+vuint32 pixelWidth
+vuint32 pixelHeight
+vuint32 pixelDepth
+vuint32 numberOfArrayElements
+vuint32 numberOfFaces
+vuint32 numberOfMipmapLevels
+vuint32 bytesOfKeyValueData
+
+for each keyValuePair that fits in bytesOfKeyValueData
+    vuint32   keyAndValueByteSize
+    Byte     keyAndValue[keyAndValueByteSize]
+    Byte     valuePadding[3 - ((keyAndValueByteSize + 3) % 4)]
+end
+
+for each mipmap_level in numberOfMipmapLevels*
+    vuint32 imageSize;
+    for each array_element in numberOfArrayElements*
+       for each face in numberOfFaces
+           for each z_slice in pixelDepth*
+               for each row or row_of_blocks in pixelHeight*
+                   for each pixel or block_of_pixels in pixelWidth
+                       Byte data[format-specific-number-of-bytes]**
+                   end
+               end
+           end
+           Byte cubePadding[0-3]
+       end
+    end
+    Byte mipPadding[3 - ((imageSize + 3) % 4)]
+end
+
+*/
+
+#pragma pack(1)
+struct KtxHeader
+{
+    uchar identifier[12];
+    vuint32 endianness;
+    vuint32 glType;
+    vuint32 glTypeSize;
+    vuint32 glFormat;
+    vuint32 glInternalFormat;
+    vuint32 glBaseInternalFormat;
+    vuint32 pixelWidth;
+    vuint32 pixelHeight;
+    vuint32 pixelDepth;
+    vuint32 numberOfArrayElements;
+    vuint32 numberOfFaces;
+    vuint32 numberOfMipmapLevels;
+    vuint32 bytesOfKeyValueData;
+};
+#pragma pack()
+
+}
+
+struct VTextureContainer::Format
+{
+    uint internalFormat;
+    uint srgbFormat;
+    uint format;
+    // In pixels, 1 for uncompressed formats
+    int blockSize;
+    int blockBytes;
+    int minBlocks;
+    vuint64 pvrFormat;
+
+    uint levelSize(int width, int height, bool paddedRows) const
+    {
+        const uint blocksX = std::max((width + blockSize - 1) / blockSize, minBlocks);
+        const uint blocksY = std::max((height + blockSize - 1) / blockSize, minBlocks);
+        uint rowBytes = blocksX * blockBytes;
+        if (paddedRows && blockSize == 1) {
+            rowBytes = (rowBytes + 3) & ~3u;
+        }
+        return rowBytes * blocksY;
+    }
+};
+
+namespace {
+
+// ETC2 before ETC1, as an sRGB ETC1 texture is uploaded as ETC2
+const VTextureContainer::Format Formats[] = {
+    {GL_R8, GL_R8, GL_RED, 1, 1, 1, 0},
+    {GL_RGB, GL_SRGB8, GL_RGB, 1, 3, 1, 0},
+    {GL_RGBA, GL_SRGB8_ALPHA8, GL_RGBA, 1, 4, 1, 578721384203708274ull},
+    {GL_COMPRESSED_RGB8_ETC2, GL_COMPRESSED_SRGB8_ETC2, GL_RGB, 4, 8, 1, 22},
+    {GL_ETC1_RGB8_OES, GL_COMPRESSED_SRGB8_ETC2, GL_RGB, 4, 8, 1, 6},
+    {GL_COMPRESSED_RGBA8_ETC2_EAC, GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC, GL_RGBA, 4, 16, 1, 23},
+    {GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG, GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG, GL_RGB, 4, 8, 2, 2},
+    {GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG, GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG, GL_RGBA, 4, 8, 2, 3},
+    {GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, GL_RGBA, 4, 8, 1, 0},
+    {GL_ATC_RGB_AMD, GL_ATC_RGB_AMD, GL_RGB, 4, 8, 1, 0},
+    {GL_ATC_RGBA_EXPLICIT_ALPHA_AMD, GL_ATC_RGBA_EXPLICIT_ALPHA_AMD, GL_RGBA, 4, 16, 1, 0},
+    {GL_COMPRESSED_RGBA_ASTC_4x4_KHR, GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR, GL_RGBA, 4, 16, 1, 0},
+    {GL_COMPRESSED_RGBA_ASTC_6x6_KHR, GL_COMPRESSED_SRGB8_ALPHA8_ASTC_6x6_KHR, GL_RGBA, 6, 16, 1, 0}
+};
+
+const VTextureContainer::Format *FindGlFormat(uint internalFormat)
+{
+    for (const VTextureContainer::Format &format : Formats) {
+        if (format.internalFormat == internalFormat || format.srgbFormat == internalFormat) {
+            return &format;
+        }
+    }
+    return nullptr;
+}
+
+const VTextureContainer::Format *FindPvrFormat(vuint64 pvrFormat)
+{
+    for (const VTextureContainer::Format &format : Formats) {
+        if (format.pvrFormat == pvrFormat && pvrFormat != 0) {
+            return &format;
+        }
+    }
+    return nullptr;
+}
+
+}
+
+VTextureContainer::VTextureContainer()
+    : m_type(Invalid)
+    , m_format(nullptr)
+    , m_width(0)
+    , m_height(0)
+    , m_faceCount(0)
+    , m_levelCount(0)
+    , m_skippedLevels(0)
+{
+}
+
+void VTextureContainer::clear()
+{
+    m_type = Invalid;
+    m_format = nullptr;
+    m_width = m_height = 0;
+    m_faceCount = m_levelCount = m_skippedLevels = 0;
+    m_levels.clear();
+    m_view = VMappedView();
+}
+
+bool VTextureContainer::parse(const uchar *data, uint size, int skipLevels, int maxLevels)
+{
+    clear();
+    bool parsed = false;
+    if (size >= 4 && memcmp(data, "\xABKTX", 4) == 0) {
+        parsed = parseKtx(data, size);
+        m_type = Ktx;
+    } else if (size >= 4 && memcmp(data, "PVR\x03", 4) == 0) {
+        parsed = parsePvr(data, size);
+        m_type = Pvr;
+    } else {
+        vWarn("VTextureContainer: neither a KTX nor a PVR file");
+    }
+    if (!parsed) {
+        clear();
+        return false;
+    }
+
+    // Every level is checked above, including the ones left out
+    const int levelCount = m_levels.size() / m_faceCount;
+    m_skippedLevels = std::min(std::max(skipLevels, 0), levelCount - 1);
+    m_levelCount = levelCount - m_skippedLevels;
+    if (maxLevels > 0) {
+        m_levelCount = std::min(m_levelCount, maxLevels);
+    }
+    m_levels.erase(m_levels.begin() + (m_skippedLevels + m_levelCount) * m_faceCount, m_levels.end());
+    m_levels.erase(m_levels.begin(), m_levels.begin() + m_skippedLevels * m_faceCount);
+    for (Level &level : m_levels) {
+        level.level -= m_skippedLevels;
+    }
+    m_width = m_levels.first().width;
+    m_height = m_levels.first().height;
+    return true;
+}
+
+bool VTextureContainer::load(const VString &path, int skipLevels, int maxLevels)
+{
+    VFile file(path, VFile::ReadOnly);
+    VMappedView view = file.map();
+    if (view.isNull()) {
+        vWarn("VTextureContainer: failed to map " << path);
+        clear();
+        return false;
+    }
+    if (!parse(view.bytes(), view.size(), skipLevels, maxLevels)) {
+        vWarn("VTextureContainer: failed to load " << path);
+        return false;
+    }
+    m_view = std::move(view);
+    return true;
+}
+
+bool VTextureContainer::parseKtx(const uchar *data, uint size)
+{
+    static const uchar FileIdentifier[12] = {
+        171, 75, 84, 88, 32, 49, 49, 187, 13, 10, 26, 10
+    };
+
+    if (size < sizeof(KtxHeader)) {
+        vWarn("Invalid KTX file");
+        return false;
+    }
+    const KtxHeader *header = reinterpret_cast<const KtxHeader *>(data);
+    if (memcmp(header->identifier, FileIdentifier, sizeof(FileIdentifier)) != 0) {
+        vWarn("Invalid KTX file");
+        return false;
+    }
+    // only support little endian
+    if (header->endianness != 0x04030201) {
+        vWarn("KTX file has wrong endianess");
+        return false;
+    }
+    // only support compressed or unsigned byte
+    if (header->glType != 0 && header->glType != GL_UNSIGNED_BYTE) {
+        vWarn("KTX file has unsupported glType " << header->glType);
+        return false;
+    }
+    // no support for texture arrays
+    if (header->numberOfArrayElements != 0) {
+        vWarn("KTX file has unsupported number of array elements " << header->numberOfArrayElements);
+        return false;
+    }
+    if (header->pixelDepth > 1) {
+        vWarn("KTX file has unsupported depth " << header->pixelDepth);
+        return false;
+    }
+    // glFormat is 0 for compressed formats, but isn't always written so
+    m_format = FindGlFormat(header->glInternalFormat);
+    if (m_format == nullptr || (header->glType == 0) != (m_format->blockSize > 1)
+            || (header->glType != 0 && header->glFormat != m_format->format)) {
+        vWarn("KTX file has unsupported glFormat " << header->glFormat << ", glInternalFormat " << header->glInternalFormat);
+        return false;
+    }
+    if (header->numberOfFaces != 1 && header->numberOfFaces != 6) {
+        vWarn("KTX file has unsupported number of faces " << header->numberOfFaces);
+        return false;
+    }
+    const vuint32 width = header->pixelWidth;
+    const vuint32 height = header->pixelHeight;
+    if (width == 0 || width > MaxSize || height == 0 || height > MaxSize
+            || (header->numberOfFaces == 6 && width != height)) {
+        vWarn("Invalid KTX texture size (" << width << "x" << height << ")");
+        return false;
+    }
+    // 0 asks for the levels to be generated
+    const int levelCount = std::max(1u, header->numberOfMipmapLevels);
+    if (header->numberOfMipmapLevels > (vuint32) MaxLevelCount(width, height)) {
+        vWarn("KTX file has too many mip levels " << header->numberOfMipmapLevels);
+        return false;
+    }
+
+    // skip the key value data
+    vuint64 offset = sizeof(KtxHeader) + (vuint64) header->bytesOfKeyValueData;
+    m_faceCount = header->numberOfFaces;
+    for (int i = 0; i < levelCount; i++) {
+        if (offset + 4 > size) {
+            vWarn("KTX mip level " << i << " exceeds buffer size");
+            return false;
+        }
+        vuint32 imageSize;
+        memcpy(&imageSize, data + offset, 4);
+        offset += 4;
+
+        const int levelWidth = std::max(1u, width >> i);
+        const int levelHeight = std::max(1u, height >> i);
+        if (imageSize != m_format->levelSize(levelWidth, levelHeight, true)) {
+            vWarn("KTX mip level " << i << " has the wrong size " << imageSize);
+            return false;
+        }
+        for (int face = 0; face < m_faceCount; face++) {
+            if (offset + imageSize > size) {
+                vWarn("KTX mip level " << i << " exceeds buffer size (" << imageSize << " > " << (size - std::min<vuint64>(offset, size)) << ")");
+                return false;
+            }
+            Level level = {i, face, levelWidth, levelHeight, data + offset, imageSize};
+            m_levels.append(level);
+            // cubePadding and mipPadding
+            offset += (imageSize + 3) & ~3u;
+        }
+    }
+
+    return true;
+}
+
+bool VTextureContainer::parsePvr(const uchar *data, uint size)
+{
+    if (size < sizeof(PvrHeader)) {
+        vWarn("Invalid PVR file");
+        return false;
+    }
+    const PvrHeader *header = reinterpret_cast<const PvrHeader *>(data);
+    if (header->version != 0x03525650) {
+        vWarn("Invalid PVR file version");
+        return false;
+    }
+    m_format = FindPvrFormat(header->pixelFormat);
+    if (m_format == nullptr) {
+        vWarn("Unknown PVR texture format " << header->pixelFormat);
+        return false;
+    }
+    if (header->numSurfaces > 1 || header->depth > 1) {
+        vWarn("PVR file has unsupported " << header->numSurfaces << " surfaces of depth " << header->depth);
+        return false;
+    }
+    if (header->numFaces != 1 && header->numFaces != 6) {
+        vWarn("PVR file has unsupported number of faces " << header->numFaces);
+        return false;
+    }
+    const vuint32 width = header->width;
+    const vuint32 height = header->height;
+    if (width == 0 || width > MaxSize || height == 0 || height > MaxSize
+            || (header->numFaces == 6 && width != height)) {
+        vWarn("Invalid PVR texture size (" << width << "x" << height << ")");
+        return false;
+    }
+    const int levelCount = std::max(1u, header->mipMapCount);
+    if (header->mipMapCount > (vuint32) MaxLevelCount(width, height)) {
+        vWarn("PVR file has too many mip levels " << header->mipMapCount);
+        return false;
+    }
+
+    // skip the metadata
+    vuint64 offset = sizeof(PvrHeader) + (vuint64) header->metaDataSize;
+    m_faceCount = header->numFaces;
+    for (int i = 0; i < levelCount; i++) {
+        const int levelWidth = std::max(1u, width >> i);
+        const int levelHeight = std::max(1u, height >> i);
+        const uint levelSize = m_format->levelSize(levelWidth, levelHeight, false);
+        for (int face = 0; face < m_faceCount; face++) {
+            if (offset + levelSize > size) {
+                vWarn("PVR mip level " << i << " exceeds buffer size (" << levelSize << " > " << (size - std::min<vuint64>(offset, size)) << ")");
+                return false;
+            }
+            Level level = {i, face, levelWidth, levelHeight, data + offset, levelSize};
+            m_levels.append(level);
+            offset += levelSize;
+        }
+    }
+
+    return true;
+}
+
+uint VTextureContainer::glTarget() const
+{
+    return m_faceCount == 6 ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+}
+
+uint VTextureContainer::glInternalFormat(bool srgb) const
+{
+    if (m_format == nullptr) {
+        return 0;
+    }
+    return srgb ? m_format->srgbFormat : m_format->internalFormat;
+}
+
+uint VTextureContainer::glFormat() const
+{
+    return m_format ? m_format->format : 0;
+}
+
+uint VTextureContainer::glType() const
+{
+    return m_format && m_format->blockSize == 1 ? GL_UNSIGNED_BYTE : 0;
+}
+
+uint VTextureContainer::size() const
+{
+    uint total = 0;
+    for (const Level &level : m_levels) {
+        total += level.size;
+    }
+    return total;
+}
+
+uint VTextureContainer::LevelSize(uint glInternalFormat, int width, int height, bool paddedRows)
+{
+    const Format *format = FindGlFormat(glInternalFormat);
+    return format ? format->levelSize(width, height, paddedRows) : 0;
+}
+
+NV_NAMESPACE_END
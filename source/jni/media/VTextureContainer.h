@@ -0,0 +1,90 @@
+#pragma once
+
+#include "VArray.h"
+#include "VMappedView.h"
+#include "VString.h"
+
+NV_NAMESPACE_BEGIN
+
+// The levels of a KTX 1 or PVR 3 texture, read in place without GL. Every size and offset is
+// checked when the container is parsed, so the levels are spans of the data given, or of the
+// file mapped, that can be uploaded as they are. The largest levels can be left out for devices
+// short of memory. The GL enums are kept as they are passed to glTexImage2D() and
+// glCompressedTexImage2D().
+class VTextureContainer
+{
+public:
+    enum Type
+    {
+        Invalid,
+        Ktx,
+        Pvr
+    };
+
+    struct Level
+    {
+        // From the first level kept
+        int level;
+        // 0 to 5 for the faces of a cube map
+        int face;
+        int width;
+        int height;
+        const uchar *data;
+        uint size;
+    };
+
+    VTextureContainer();
+
+    // The data must outlive the container. Leaves out skipLevels of the largest levels, as long
+    // as one is left, and keeps at most maxLevels of the rest, 0 for all of them.
+    bool parse(const uchar *data, uint size, int skipLevels = 0, int maxLevels = 0);
+    // Parses the mapping of a file, kept until the container is cleared
+    bool load(const VString &path, int skipLevels = 0, int maxLevels = 0);
+    void clear();
+
+    bool isValid() const { return m_type != Invalid; }
+    Type type() const { return m_type; }
+
+    // Of the first level kept
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    bool isCubeMap() const { return m_faceCount == 6; }
+    int faceCount() const { return m_faceCount; }
+    int levelCount() const { return m_levelCount; }
+    int skippedLevels() const { return m_skippedLevels; }
+
+    uint glTarget() const;
+    uint glInternalFormat(bool srgb = false) const;
+    uint glFormat() const;
+    // 0 for compressed formats
+    uint glType() const;
+    bool isCompressed() const { return glType() == 0; }
+
+    // Largest first, the faces of each level one after another
+    const VArray<Level> &levels() const { return m_levels; }
+    const Level &level(int level, int face = 0) const { return m_levels[level * m_faceCount + face]; }
+    // Of the levels kept
+    uint size() const;
+
+    // Bytes of a width x height level of a supported format, or 0. KTX pads uncompressed rows
+    // to 4 bytes.
+    static uint LevelSize(uint glInternalFormat, int width, int height, bool paddedRows = false);
+
+    struct Format;
+
+private:
+    bool parseKtx(const uchar *data, uint size);
+    bool parsePvr(const uchar *data, uint size);
+
+    Type m_type;
+    const Format *m_format;
+    int m_width;
+    int m_height;
+    int m_faceCount;
+    int m_levelCount;
+    int m_skippedLevels;
+    VArray<Level> m_levels;
+    VMappedView m_view;
+};
+
+NV_NAMESPACE_END
@@ -0,0 +1,917 @@
+#include "VTextureEncoder.h"
+
+#include "VImage.h"
+#include "VTaskScheduler.h"
+
+#include <algorithm>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+NV_NAMESPACE_BEGIN
+
+namespace {
+
+enum
+{
+    GL_COMPRESSED_RGB8_ETC2 = 0x9274,
+    GL_COMPRESSED_SRGB8_ETC2 = 0x9275,
+    GL_COMPRESSED_RGBA8_ETC2_EAC = 0x9278,
+    GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC = 0x9279,
+    GL_COMPRESSED_RGBA_ASTC_6x6_KHR = 0x93B4,
+    GL_COMPRESSED_SRGB8_ALPHA8_ASTC_6x6_KHR = 0x93D4
+};
+
+// Errors are sums of squares of 8 bit differences, exact in floats for up to 16 pixels
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+
+typedef float32x4_t Float4;
+inline Float4 Set4(float v) { return vdupq_n_f32(v); }
+inline Float4 Load4(const float *p) { return vld1q_f32(p); }
+inline void Store4(float *p, Float4 v) { vst1q_f32(p, v); }
+inline Float4 Add4(Float4 a, Float4 b) { return vaddq_f32(a, b); }
+inline Float4 SquaredDifference4(Float4 a, Float4 b) { const Float4 d = vsubq_f32(a, b); return vmulq_f32(d, d); }
+
+#elif defined(__SSE2__)
+
+typedef __m128 Float4;
+inline Float4 Set4(float v) { return _mm_set1_ps(v); }
+inline Float4 Load4(const float *p) { return _mm_loadu_ps(p); }
+inline void Store4(float *p, Float4 v) { _mm_storeu_ps(p, v); }
+inline Float4 Add4(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+inline Float4 SquaredDifference4(Float4 a, Float4 b) { const Float4 d = _mm_sub_ps(a, b); return _mm_mul_ps(d, d); }
+
+#else
+
+struct Float4 { float v[4]; };
+inline Float4 Set4(float v) { Float4 r = {{v, v, v, v}}; return r; }
+inline Float4 Load4(const float *p) { Float4 r = {{p[0], p[1], p[2], p[3]}}; return r; }
+inline void Store4(float *p, Float4 v) { p[0] = v.v[0]; p[1] = v.v[1]; p[2] = v.v[2]; p[3] = v.v[3]; }
+inline Float4 Add4(Float4 a, Float4 b) { Float4 r = {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}}; return r; }
+inline Float4 SquaredDifference4(Float4 a, Float4 b)
+{
+    Float4 r;
+    for (int i = 0; i < 4; i++) {
+        r.v[i] = (a.v[i] - b.v[i]) * (a.v[i] - b.v[i]);
+    }
+    return r;
+}
+
+#endif
+
+// The lane of the smallest error, the first of equal ones
+inline int MinLane(Float4 errors, uint &min)
+{
+    float lanes[4];
+    Store4(lanes, errors);
+    int lane = 0;
+    for (int i = 1; i < 4; i++) {
+        if (lanes[i] < lanes[lane]) {
+            lane = i;
+        }
+    }
+    min = (uint) lanes[lane];
+    return lane;
+}
+
+inline int Clamp255(int value)
+{
+    return std::min(std::max(value, 0), 255);
+}
+
+// Of a color quantized to bits, by bit replication
+inline int Expand(int value, int bits)
+{
+    return (value << (8 - bits)) | (value >> (2 * bits - 8));
+}
+
+inline int Quantize(float value, int bits)
+{
+    const int max = (1 << bits) - 1;
+    return std::min(std::max((int) floorf(value * max / 255.0f + 0.5f), 0), max);
+}
+
+// The pixels of a block, the ones past the image repeat its edges
+void ReadBlock(const uchar *rgba, int width, int height, int blockX, int blockY, int size, uchar *pixels)
+{
+    for (int y = 0; y < size; y++) {
+        const uchar *row = rgba + std::min(blockY * size + y, height - 1) * width * 4;
+        for (int x = 0; x < size; x++) {
+            memcpy(pixels + (y * size + x) * 4, row + std::min(blockX * size + x, width - 1) * 4, 4);
+        }
+    }
+}
+
+void StoreBigEndian(vuint64 bits, uchar *out)
+{
+    for (int i = 0; i < 8; i++) {
+        out[i] = (uchar) (bits >> (56 - i * 8));
+    }
+}
+
+// ETC1 and ETC2 RGB
+
+// The lanes of each table are +a, +b, -a and -b, the modifier index of the block
+const int EtcModifiers[8][2] = {
+    {2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}
+};
+
+// Pixels (y * 4 + x) of the halves of a block, left and right, or top and bottom when flipped
+const int EtcHalves[2][2][8] = {
+    {{0, 1, 4, 5, 8, 9, 12, 13}, {2, 3, 6, 7, 10, 11, 14, 15}},
+    {{0, 1, 2, 3, 4, 5, 6, 7}, {8, 9, 10, 11, 12, 13, 14, 15}}
+};
+
+inline int EtcModifier(int table, int lane)
+{
+    const int modifier = EtcModifiers[table][lane & 1];
+    return lane < 2 ? modifier : -modifier;
+}
+
+struct EtcHalf
+{
+    // Quantized
+    int color[3];
+    int table;
+    uchar lanes[8];
+    uint error;
+};
+
+// Picks the table and the modifier of each pixel of a half for the least error, if it is below
+// the one of fit
+void FitModifiers(const uchar *pixels, const int *half, int bits, const int *color, EtcHalf &fit)
+{
+    int base[3];
+    for (int c = 0; c < 3; c++) {
+        base[c] = Expand(color[c], bits);
+    }
+
+    for (int table = 0; table < 8; table++) {
+        Float4 candidates[3];
+        for (int c = 0; c < 3; c++) {
+            const float values[4] = {
+                (float) Clamp255(base[c] + EtcModifier(table, 0)), (float) Clamp255(base[c] + EtcModifier(table, 1)),
+                (float) Clamp255(base[c] + EtcModifier(table, 2)), (float) Clamp255(base[c] + EtcModifier(table, 3))
+            };
+            candidates[c] = Load4(values);
+        }
+
+        uchar lanes[8];
+        uint error = 0;
+        for (int i = 0; i < 8 && error < fit.error; i++) {
+            const uchar *pixel = pixels + half[i] * 4;
+            Float4 sum = SquaredDifference4(candidates[0], Set4(pixel[0]));
+            sum = Add4(sum, SquaredDifference4(candidates[1], Set4(pixel[1])));
+            sum = Add4(sum, SquaredDifference4(candidates[2], Set4(pixel[2])));
+            uint min;
+            lanes[i] = MinLane(sum, min);
+            error += min;
+        }
+        if (error < fit.error) {
+            fit.error = error;
+            fit.table = table;
+            memcpy(fit.color, color, sizeof(fit.color));
+            memcpy(fit.lanes, lanes, sizeof(fit.lanes));
+        }
+    }
+}
+
+// The base color the modifiers picked center on, as the pixels were not clamped
+void RefitColor(const uchar *pixels, const int *half, int bits, EtcHalf &fit)
+{
+    float sum[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 8; i++) {
+        const int modifier = EtcModifier(fit.table, fit.lanes[i]);
+        for (int c = 0; c < 3; c++) {
+            sum[c] += pixels[half[i] * 4 + c] - modifier;
+        }
+    }
+    int color[3];
+    for (int c = 0; c < 3; c++) {
+        color[c] = Quantize(sum[c] / 8.0f, bits);
+    }
+    if (memcmp(color, fit.color, sizeof(color)) != 0) {
+        FitModifiers(pixels, half, bits, color, fit);
+    }
+}
+
+void EncodeHalf(const uchar *pixels, const int *half, int bits, VTextureEncoder::Quality quality, EtcHalf &fit)
+{
+    float sum[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 8; i++) {
+        for (int c = 0; c < 3; c++) {
+            sum[c] += pixels[half[i] * 4 + c];
+        }
+    }
+    int average[3];
+    for (int c = 0; c < 3; c++) {
+        average[c] = Quantize(sum[c] / 8.0f, bits);
+    }
+
+    fit.error = UINT_MAX;
+    FitModifiers(pixels, half, bits, average, fit);
+    if (quality == VTextureEncoder::HighQuality) {
+        const int max = (1 << bits) - 1;
+        for (int dr = -1; dr <= 1; dr++) {
+            for (int dg = -1; dg <= 1; dg++) {
+                for (int db = -1; db <= 1; db++) {
+                    const int color[3] = {average[0] + dr, average[1] + dg, average[2] + db};
+                    if ((dr || dg || db) && color[0] >= 0 && color[0] <= max && color[1] >= 0 && color[1] <= max && color[2] >= 0 && color[2] <= max) {
+                        FitModifiers(pixels, half, bits, color, fit);
+                    }
+                }
+            }
+        }
+    }
+    if (quality != VTextureEncoder::FastQuality) {
+        RefitColor(pixels, half, bits, fit);
+    }
+}
+
+// The individual or differential mode of ETC1. Returns false if the colors of the halves are too
+// far apart for the differential mode and the second one had to be moved.
+bool EncodeEtc1(const uchar *pixels, int flip, bool differential, VTextureEncoder::Quality quality, vuint64 &block, uint &error)
+{
+    const int bits = differential ? 5 : 4;
+    EtcHalf halves[2];
+    EncodeHalf(pixels, EtcHalves[flip][0], bits, quality, halves[0]);
+    EncodeHalf(pixels, EtcHalves[flip][1], bits, quality, halves[1]);
+
+    bool fits = true;
+    if (differential) {
+        int color[3];
+        for (int c = 0; c < 3; c++) {
+            color[c] = std::min(std::max(halves[1].color[c], halves[0].color[c] - 4), halves[0].color[c] + 3);
+            fits = fits && color[c] == halves[1].color[c];
+        }
+        if (!fits) {
+            halves[1].error = UINT_MAX;
+            FitModifiers(pixels, EtcHalves[flip][1], bits, color, halves[1]);
+        }
+    }
+
+    block = 0;
+    for (int c = 0; c < 3; c++) {
+        const int shift = 56 - c * 8;
+        if (differential) {
+            block |= (vuint64) ((halves[0].color[c] << 3) | ((halves[1].color[c] - halves[0].color[c]) & 7)) << shift;
+        } else {
+            block |= (vuint64) ((halves[0].color[c] << 4) | halves[1].color[c]) << shift;
+        }
+    }
+    block |= (vuint64) ((halves[0].table << 5) | (halves[1].table << 2) | (differential << 1) | flip) << 32;
+    for (int h = 0; h < 2; h++) {
+        for (int i = 0; i < 8; i++) {
+            // The indices go down the columns, the sign in the upper half word
+            const int pixel = EtcHalves[flip][h][i];
+            const int bit = (pixel & 3) * 4 + (pixel >> 2);
+            block |= (vuint64) (halves[h].lanes[i] >> 1) << (16 + bit);
+            block |= (vuint64) (halves[h].lanes[i] & 1) << bit;
+        }
+    }
+    error = halves[0].error + halves[1].error;
+    return fits;
+}
+
+// Colors of the origin, of x = 4 and of y = 4 of the ETC2 planar mode, in 6, 7 and 6 bits
+struct Planar
+{
+    int color[3][3];
+};
+
+const int PlanarBits[3] = {6, 7, 6};
+
+uint PlanarError(const uchar *pixels, const Planar &planar)
+{
+    int o[3], h[3], v[3];
+    for (int c = 0; c < 3; c++) {
+        o[c] = Expand(planar.color[0][c], PlanarBits[c]);
+        h[c] = Expand(planar.color[1][c], PlanarBits[c]);
+        v[c] = Expand(planar.color[2][c], PlanarBits[c]);
+    }
+    uint error = 0;
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            for (int c = 0; c < 3; c++) {
+                const int d = Clamp255((x * (h[c] - o[c]) + y * (v[c] - o[c]) + 4 * o[c] + 2) >> 2) - pixels[(y * 4 + x) * 4 + c];
+                error += d * d;
+            }
+        }
+    }
+    return error;
+}
+
+// Least squares planes through the pixels, for smooth gradients that the modifiers would band
+vuint64 EncodePlanar(const uchar *pixels, VTextureEncoder::Quality quality, uint &error)
+{
+    Planar planar;
+    for (int c = 0; c < 3; c++) {
+        float mean = 0.0f;
+        float slopeX = 0.0f;
+        float slopeY = 0.0f;
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 4; x++) {
+                const float value = pixels[(y * 4 + x) * 4 + c];
+                mean += value;
+                slopeX += (x - 1.5f) * value;
+                slopeY += (y - 1.5f) * value;
+            }
+        }
+        // Sum of (x - 1.5)^2 over the block
+        mean /= 16.0f;
+        slopeX /= 20.0f;
+        slopeY /= 20.0f;
+        const float origin = mean - 1.5f * slopeX - 1.5f * slopeY;
+        planar.color[0][c] = Quantize(origin, PlanarBits[c]);
+        planar.color[1][c] = Quantize(origin + 4.0f * slopeX, PlanarBits[c]);
+        planar.color[2][c] = Quantize(origin + 4.0f * slopeY, PlanarBits[c]);
+    }
+    error = PlanarError(pixels, planar);
+
+    if (quality == VTextureEncoder::HighQuality) {
+        // Rounding each color on its own isn't the best for the plane
+        for (int i = 0; i < 3; i++) {
+            for (int c = 0; c < 3; c++) {
+                for (int delta = -1; delta <= 1; delta += 2) {
+                    Planar candidate = planar;
+                    candidate.color[i][c] += delta;
+                    if (candidate.color[i][c] < 0 || candidate.color[i][c] >= (1 << PlanarBits[c])) {
+                        continue;
+                    }
+                    const uint candidateError = PlanarError(pixels, candidate);
+                    if (candidateError < error) {
+                        error = candidateError;
+                        planar = candidate;
+                    }
+                }
+            }
+        }
+    }
+
+    const int ro = planar.color[0][0], go = planar.color[0][1], bo = planar.color[0][2];
+    const int rh = planar.color[1][0], gh = planar.color[1][1], bh = planar.color[1][2];
+    const int rv = planar.color[2][0], gv = planar.color[2][1], bv = planar.color[2][2];
+    uchar bytes[8];
+    bytes[0] = (uchar) ((ro << 1) | (go >> 6));
+    bytes[1] = (uchar) (((go & 63) << 1) | (bo >> 5));
+    bytes[2] = (uchar) ((((bo >> 3) & 3) << 3) | ((bo >> 1) & 3));
+    bytes[3] = (uchar) (((bo & 1) << 7) | ((rh >> 1) << 2) | 2 | (rh & 1));
+    bytes[4] = (uchar) ((gh << 1) | (bh >> 5));
+    bytes[5] = (uchar) (((bh & 31) << 3) | (rv >> 3));
+    bytes[6] = (uchar) (((rv & 7) << 5) | (gv >> 2));
+    bytes[7] = (uchar) (((gv & 3) << 6) | bv);
+
+    // The planar mode is told apart by the differential red and green staying within 0 to 31
+    // and the blue overflowing, with the bits left free
+    for (int i = 0; i < 2; i++) {
+        const int base = (bytes[i] >> 3) & 15;
+        const int delta = (bytes[i] & 3) - (bytes[i] & 4);
+        if (base + delta < 0) {
+            bytes[i] |= 0x80;
+        }
+    }
+    if (((bytes[2] >> 3) & 3) + (bytes[2] & 3) < 4) {
+        bytes[2] |= 0x04;
+    } else {
+        bytes[2] |= 0xE0;
+    }
+
+    vuint64 block = 0;
+    for (int i = 0; i < 8; i++) {
+        block = (block << 8) | bytes[i];
+    }
+    return block;
+}
+
+vuint64 EncodeEtc2(const uchar *pixels, VTextureEncoder::Quality quality)
+{
+    vuint64 best = 0;
+    uint bestError = UINT_MAX;
+    for (int flip = 0; flip < 2; flip++) {
+        vuint64 block;
+        uint error;
+        const bool fits = EncodeEtc1(pixels, flip, true, quality, block, error);
+        if (error < bestError) {
+            best = block;
+            bestError = error;
+        }
+        // Halves of distant colors may be better off with the individual mode
+        if (!fits || quality != VTextureEncoder::FastQuality) {
+            EncodeEtc1(pixels, flip, false, quality, block, error);
+            if (error < bestError) {
+                best = block;
+                bestError = error;
+            }
+        }
+    }
+    if (quality != VTextureEncoder::FastQuality && bestError > 0) {
+        uint error;
+        const vuint64 block = EncodePlanar(pixels, quality, error);
+        if (error < bestError) {
+            best = block;
+        }
+    }
+    return best;
+}
+
+// EAC alpha of ETC2 RGBA8
+
+// The lanes of each table in the order of the indices of the block
+const int EacModifiers[16][8] = {
+    {-3, -6, -9, -15, 2, 5, 8, 14},
+    {-3, -7, -10, -13, 2, 6, 9, 12},
+    {-2, -5, -8, -13, 1, 4, 7, 12},
+    {-2, -4, -6, -13, 1, 3, 5, 12},
+    {-3, -6, -8, -12, 2, 5, 7, 11},
+    {-3, -7, -9, -11, 2, 6, 8, 10},
+    {-4, -7, -8, -11, 3, 6, 7, 10},
+    {-3, -5, -8, -11, 2, 4, 7, 10},
+    {-2, -6, -8, -10, 1, 5, 7, 9},
+    {-2, -5, -8, -10, 1, 4, 7, 9},
+    {-2, -4, -8, -10, 1, 3, 7, 9},
+    {-2, -5, -7, -10, 1, 4, 6, 9},
+    {-3, -4, -7, -10, 2, 3, 6, 9},
+    {-1, -2, -3, -10, 0, 1, 2, 9},
+    {-4, -6, -8, -9, 3, 5, 7, 8},
+    {-3, -5, -7, -9, 2, 4, 6, 8}
+};
+
+// Table 13 has a modifier of 0 for blocks of a single alpha
+const int EacExactTable = 13;
+const int EacExactLane = 4;
+
+// The error of the best modifiers of the pixels, stopping at limit
+uint FitAlpha(const uchar *pixels, int base, int multiplier, int table, uchar *lanes, uint limit)
+{
+    float values[8];
+    for (int i = 0; i < 8; i++) {
+        values[i] = (float) Clamp255(base + EacModifiers[table][i] * multiplier);
+    }
+    const Float4 low = Load4(values);
+    const Float4 high = Load4(values + 4);
+
+    uint error = 0;
+    for (int i = 0; i < 16 && error < limit; i++) {
+        // Indices go down the columns
+        const Float4 alpha = Set4(pixels[((i & 3) * 4 + (i >> 2)) * 4 + 3]);
+        const Float4 lowErrors = SquaredDifference4(low, alpha);
+        const Float4 highErrors = SquaredDifference4(high, alpha);
+        uint lowMin, highMin;
+        const int lowLane = MinLane(lowErrors, lowMin);
+        const int highLane = MinLane(highErrors, highMin);
+        if (highMin < lowMin) {
+            lanes[i] = highLane + 4;
+            error += highMin;
+        } else {
+            lanes[i] = lowLane;
+            error += lowMin;
+        }
+    }
+    return error;
+}
+
+vuint64 EncodeAlpha(const uchar *pixels, VTextureEncoder::Quality quality)
+{
+    int min = 255;
+    int max = 0;
+    for (int i = 0; i < 16; i++) {
+        min = std::min(min, (int) pixels[i * 4 + 3]);
+        max = std::max(max, (int) pixels[i * 4 + 3]);
+    }
+
+    int bestBase = min;
+    int bestMultiplier = 1;
+    int bestTable = EacExactTable;
+    uchar bestLanes[16];
+    memset(bestLanes, EacExactLane, sizeof(bestLanes));
+
+    if (min != max) {
+        const int range = quality == VTextureEncoder::FastQuality ? 0 : (quality == VTextureEncoder::NormalQuality ? 1 : 2);
+        uint bestError = UINT_MAX;
+        uchar lanes[16];
+        for (int table = 0; table < 16 && bestError > 0; table++) {
+            // The span of the table over the span of the alpha
+            const int low = EacModifiers[table][3];
+            const int high = EacModifiers[table][7];
+            const int multiplier = std::min(std::max((int) floorf((float) (max - min) / (high - low) + 0.5f), 1), 15);
+            for (int m = std::max(multiplier - range, 1); m <= std::min(multiplier + range, 15); m++) {
+                const int center = (int) floorf((max + min) * 0.5f - m * (high + low) * 0.5f + 0.5f);
+                for (int base = std::max(center - range, 0); base <= std::min(center + range, 255); base++) {
+                    const uint error = FitAlpha(pixels, base, m, table, lanes, bestError);
+                    if (error < bestError) {
+                        bestError = error;
+                        bestBase = base;
+                        bestMultiplier = m;
+                        bestTable = table;
+                        memcpy(bestLanes, lanes, sizeof(lanes));
+                    }
+                }
+            }
+        }
+    }
+
+    vuint64 block = ((vuint64) bestBase << 56) | ((vuint64) bestMultiplier << 52) | ((vuint64) bestTable << 48);
+    for (int i = 0; i < 16; i++) {
+        block |= (vuint64) bestLanes[i] << (45 - i * 3);
+    }
+    return block;
+}
+
+// ASTC 6x6: a single partition of LDR endpoints in 8 bits, with a 4x4 grid of weights in 3 bits
+// for RGB or 2 bits for RGBA. Other weight and endpoint ranges need trits or quints.
+
+const int AstcSize = 6;
+const int AstcGridSize = 4;
+const int AstcTexels = AstcSize * AstcSize;
+const int AstcGridPoints = AstcGridSize * AstcGridSize;
+
+// Block modes of a 4x4 grid, 3 and 2 bit weights
+const int AstcRgbMode = 0x53;
+const int AstcRgbaMode = 0x42;
+// LDR RGB direct and RGBA direct endpoints
+const int AstcRgbEndpoints = 8;
+const int AstcRgbaEndpoints = 12;
+
+// Of the weights quantized, out of 64
+const int AstcWeights3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+const int AstcWeights2[4] = {0, 21, 43, 64};
+
+// The grid points around each texel and their weights out of 16, as the decoder interpolates
+struct AstcInfill
+{
+    int point[AstcTexels][4];
+    int weight[AstcTexels][4];
+
+    AstcInfill()
+    {
+        const int step = (1024 + AstcSize / 2) / (AstcSize - 1);
+        for (int t = 0; t < AstcSize; t++) {
+            for (int s = 0; s < AstcSize; s++) {
+                const int gs = (step * s * (AstcGridSize - 1) + 32) >> 6;
+                const int gt = (step * t * (AstcGridSize - 1) + 32) >> 6;
+                const int fs = gs & 15;
+                const int ft = gt & 15;
+                const int first = (gs >> 4) + (gt >> 4) * AstcGridSize;
+                const int texel = t * AstcSize + s;
+                const int w11 = (fs * ft + 8) >> 4;
+                weight[texel][0] = 16 - fs - ft + w11;
+                weight[texel][1] = fs - w11;
+                weight[texel][2] = ft - w11;
+                weight[texel][3] = w11;
+                // Past the grid only with no weight
+                point[texel][0] = first;
+                point[texel][1] = std::min(first + 1, AstcGridPoints - 1);
+                point[texel][2] = std::min(first + AstcGridSize, AstcGridPoints - 1);
+                point[texel][3] = std::min(first + AstcGridSize + 1, AstcGridPoints - 1);
+            }
+        }
+    }
+
+    int texelWeight(const int *grid, int texel) const
+    {
+        int sum = 8;
+        for (int i = 0; i < 4; i++) {
+            sum += grid[point[texel][i]] * weight[texel][i];
+        }
+        return sum >> 4;
+    }
+};
+
+inline int AstcInterpolate(int e0, int e1, int weight)
+{
+    return ((((e0 << 8) | e0) * (64 - weight) + ((e1 << 8) | e1) * weight + 32) >> 6) >> 8;
+}
+
+void SetBits(uchar *block, int position, int count, uint value)
+{
+    for (int i = 0; i < count; i++) {
+        if ((value >> i) & 1) {
+            block[(position + i) >> 3] |= 1 << ((position + i) & 7);
+        }
+    }
+}
+
+struct AstcFit
+{
+    int endpoints[2][4];
+    int grid[AstcGridPoints];
+    uint error;
+};
+
+// Weights of the grid for the endpoints, and the error of the block decoded
+void FitAstcWeights(const uchar *pixels, const AstcInfill &infill, int channels, int weightBits, AstcFit &fit)
+{
+    const int *levels = weightBits == 3 ? AstcWeights3 : AstcWeights2;
+    const int levelCount = 1 << weightBits;
+
+    float axis[4];
+    float length = 0.0f;
+    for (int c = 0; c < channels; c++) {
+        axis[c] = (float) (fit.endpoints[1][c] - fit.endpoints[0][c]);
+        length += axis[c] * axis[c];
+    }
+
+    // Where each texel lies between the endpoints, spread to the grid points it takes from
+    float sums[AstcGridPoints] = {};
+    float totals[AstcGridPoints] = {};
+    for (int texel = 0; texel < AstcTexels; texel++) {
+        float position = 0.0f;
+        if (length > 0.0f) {
+            for (int c = 0; c < channels; c++) {
+                position += (pixels[texel * 4 + c] - fit.endpoints[0][c]) * axis[c];
+            }
+            position = std::min(std::max(position / length, 0.0f), 1.0f);
+        }
+        for (int i = 0; i < 4; i++) {
+            sums[infill.point[texel][i]] += position * infill.weight[texel][i];
+            totals[infill.point[texel][i]] += infill.weight[texel][i];
+        }
+    }
+    for (int point = 0; point < AstcGridPoints; point++) {
+        const float target = totals[point] > 0.0f ? 64.0f * sums[point] / totals[point] : 0.0f;
+        int best = 0;
+        for (int level = 1; level < levelCount; level++) {
+            if (fabsf(levels[level] - target) < fabsf(levels[best] - target)) {
+                best = level;
+            }
+        }
+        fit.grid[point] = best;
+    }
+
+    int unquantized[AstcGridPoints];
+    for (int point = 0; point < AstcGridPoints; point++) {
+        unquantized[point] = levels[fit.grid[point]];
+    }
+    fit.error = 0;
+    for (int texel = 0; texel < AstcTexels; texel++) {
+        const int weight = infill.texelWeight(unquantized, texel);
+        for (int c = 0; c < channels; c++) {
+            const int d = AstcInterpolate(fit.endpoints[0][c], fit.endpoints[1][c], weight) - pixels[texel * 4 + c];
+            fit.error += d * d;
+        }
+    }
+}
+
+// Endpoints in 8 bits, ordered so that the decoder doesn't take them for blue contracted ones
+void SetAstcEndpoints(const float endpoints[2][4], int channels, AstcFit &fit)
+{
+    int sums[2] = {0, 0};
+    for (int e = 0; e < 2; e++) {
+        for (int c = 0; c < 4; c++) {
+            fit.endpoints[e][c] = c < channels ? Clamp255((int) floorf(endpoints[e][c] + 0.5f)) : 255;
+        }
+        sums[e] = fit.endpoints[e][0] + fit.endpoints[e][1] + fit.endpoints[e][2];
+    }
+    if (sums[1] < sums[0]) {
+        for (int c = 0; c < 4; c++) {
+            std::swap(fit.endpoints[0][c], fit.endpoints[1][c]);
+        }
+    }
+}
+
+void EncodeAstc(const uchar *pixels, VTextureEncoder::Quality quality, uchar *block)
+{
+    static const AstcInfill infill;
+
+    bool opaque = true;
+    for (int texel = 0; texel < AstcTexels && opaque; texel++) {
+        opaque = pixels[texel * 4 + 3] == 255;
+    }
+    const int channels = opaque ? 3 : 4;
+    const int weightBits = opaque ? 3 : 2;
+
+    // The principal axis of the colors, by power iteration
+    float mean[4] = {};
+    for (int texel = 0; texel < AstcTexels; texel++) {
+        for (int c = 0; c < channels; c++) {
+            mean[c] += pixels[texel * 4 + c];
+        }
+    }
+    for (int c = 0; c < channels; c++) {
+        mean[c] /= AstcTexels;
+    }
+    float covariance[4][4] = {};
+    for (int texel = 0; texel < AstcTexels; texel++) {
+        for (int i = 0; i < channels; i++) {
+            for (int j = 0; j < channels; j++) {
+                covariance[i][j] += (pixels[texel * 4 + i] - mean[i]) * (pixels[texel * 4 + j] - mean[j]);
+            }
+        }
+    }
+    float axis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[4] = {};
+        float length = 0.0f;
+        for (int i = 0; i < channels; i++) {
+            for (int j = 0; j < channels; j++) {
+                next[i] += covariance[i][j] * axis[j];
+            }
+            length = std::max(length, fabsf(next[i]));
+        }
+        if (length == 0.0f) {
+            break;
+        }
+        for (int i = 0; i < channels; i++) {
+            axis[i] = next[i] / length;
+        }
+    }
+    float norm = 0.0f;
+    for (int c = 0; c < channels; c++) {
+        norm += axis[c] * axis[c];
+    }
+
+    float minProjection = 0.0f;
+    float maxProjection = 0.0f;
+    for (int texel = 0; texel < AstcTexels && norm > 0.0f; texel++) {
+        float projection = 0.0f;
+        for (int c = 0; c < channels; c++) {
+            projection += (pixels[texel * 4 + c] - mean[c]) * axis[c];
+        }
+        minProjection = std::min(minProjection, projection / norm);
+        maxProjection = std::max(maxProjection, projection / norm);
+    }
+    float endpoints[2][4];
+    for (int c = 0; c < channels; c++) {
+        endpoints[0][c] = mean[c] + axis[c] * minProjection;
+        endpoints[1][c] = mean[c] + axis[c] * maxProjection;
+    }
+
+    AstcFit best;
+    SetAstcEndpoints(endpoints, channels, best);
+    FitAstcWeights(pixels, infill, channels, weightBits, best);
+
+    // Least squares endpoints for the weights the texels ended up with
+    const int refits = quality == VTextureEncoder::FastQuality ? 0 : (quality == VTextureEncoder::NormalQuality ? 1 : 3);
+    AstcFit fit = best;
+    const int *levels = weightBits == 3 ? AstcWeights3 : AstcWeights2;
+    for (int refit = 0; refit < refits && best.error > 0; refit++) {
+        int unquantized[AstcGridPoints];
+        for (int point = 0; point < AstcGridPoints; point++) {
+            unquantized[point] = levels[fit.grid[point]];
+        }
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ap[4] = {}, bp[4] = {};
+        for (int texel = 0; texel < AstcTexels; texel++) {
+            const float b = infill.texelWeight(unquantized, texel) / 64.0f;
+            const float a = 1.0f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int c = 0; c < channels; c++) {
+                ap[c] += a * pixels[texel * 4 + c];
+                bp[c] += b * pixels[texel * 4 + c];
+            }
+        }
+        const float determinant = aa * bb - ab * ab;
+        if (fabsf(determinant) < 1e-6f) {
+            break;
+        }
+        for (int c = 0; c < channels; c++) {
+            endpoints[0][c] = (bb * ap[c] - ab * bp[c]) / determinant;
+            endpoints[1][c] = (aa * bp[c] - ab * ap[c]) / determinant;
+        }
+        SetAstcEndpoints(endpoints, channels, fit);
+        FitAstcWeights(pixels, infill, channels, weightBits, fit);
+        if (fit.error < best.error) {
+            best = fit;
+        }
+    }
+
+    memset(block, 0, 16);
+    SetBits(block, 0, 11, opaque ? AstcRgbMode : AstcRgbaMode);
+    // A single partition
+    SetBits(block, 11, 2, 0);
+    SetBits(block, 13, 4, opaque ? AstcRgbEndpoints : AstcRgbaEndpoints);
+    for (int c = 0; c < channels; c++) {
+        SetBits(block, 17 + c * 16, 8, best.endpoints[0][c]);
+        SetBits(block, 17 + c * 16 + 8, 8, best.endpoints[1][c]);
+    }
+    // The weights go down from the top of the block
+    for (int point = 0; point < AstcGridPoints; point++) {
+        for (int bit = 0; bit < weightBits; bit++) {
+            if ((best.grid[point] >> bit) & 1) {
+                const int position = 127 - (point * weightBits + bit);
+                block[position >> 3] |= 1 << (position & 7);
+            }
+        }
+    }
+}
+
+// Splits rows of blocks into bands encoded by the task scheduler and the calling thread. Small
+// images stay on the calling thread.
+template<typename Function>
+void ParallelRows(int rows, int blocksPerRow, const Function &function)
+{
+    const int minBlocksPerBand = 1024;
+    VTaskScheduler *scheduler = VTaskScheduler::instance();
+    if (rows <= 1 || (longlong) rows * blocksPerRow < 2 * minBlocksPerBand) {
+        function(0, rows);
+        return;
+    }
+    const int grainSize = std::max(1, minBlocksPerBand / std::max(blocksPerRow, 1));
+    scheduler->parallelFor(0, rows, function, grainSize, VTaskScheduler::NormalPriority);
+}
+
+}
+
+VTextureEncoder::VTextureEncoder(Format format, Quality quality)
+    : m_format(format)
+    , m_quality(quality)
+{
+}
+
+int VTextureEncoder::blockSize() const
+{
+    return m_format == Astc6x6 ? AstcSize : 4;
+}
+
+int VTextureEncoder::blockBytes() const
+{
+    return m_format == Etc2Rgb ? 8 : 16;
+}
+
+uint VTextureEncoder::glInternalFormat(bool srgb) const
+{
+    switch (m_format) {
+    case Etc2Rgb:
+        return srgb ? GL_COMPRESSED_SRGB8_ETC2 : GL_COMPRESSED_RGB8_ETC2;
+    case Etc2Rgba:
+        return srgb ? GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC : GL_COMPRESSED_RGBA8_ETC2_EAC;
+    case Astc6x6:
+        return srgb ? GL_COMPRESSED_SRGB8_ALPHA8_ASTC_6x6_KHR : GL_COMPRESSED_RGBA_ASTC_6x6_KHR;
+    }
+    return 0;
+}
+
+uint VTextureEncoder::encodedSize(int width, int height) const
+{
+    const int size = blockSize();
+    return ((width + size - 1) / size) * ((height + size - 1) / size) * blockBytes();
+}
+
+void VTextureEncoder::encode(const uchar *rgba, int width, int height, uchar *blocks) const
+{
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    const int size = blockSize();
+    const int bytes = blockBytes();
+    const int blocksX = (width + size - 1) / size;
+    const int blocksY = (height + size - 1) / size;
+    const Format format = m_format;
+    const Quality quality = m_quality;
+    ParallelRows(blocksY, blocksX, [=](int begin, int end) {
+        uchar pixels[AstcTexels * 4];
+        for (int y = begin; y < end; y++) {
+            uchar *block = blocks + y * blocksX * bytes;
+            for (int x = 0; x < blocksX; x++, block += bytes) {
+                ReadBlock(rgba, width, height, x, y, size, pixels);
+                switch (format) {
+                case Etc2Rgb:
+                    StoreBigEndian(EncodeEtc2(pixels, quality), block);
+                    break;
+                case Etc2Rgba:
+                    StoreBigEndian(EncodeAlpha(pixels, quality), block);
+                    StoreBigEndian(EncodeEtc2(pixels, quality), block + 8);
+                    break;
+                case Astc6x6:
+                    EncodeAstc(pixels, quality, block);
+                    break;
+                }
+            }
+        }
+    });
+}
+
+VByteArray VTextureEncoder::encode(const VImage &image) const
+{
+    VByteArray blocks(encodedSize(image.width(), image.height()));
+    if (!blocks.empty()) {
+        encode(image.data(), image.width(), image.height(), reinterpret_cast<uchar *>(&blocks[0]));
+    }
+    return blocks;
+}
+
+VByteArray VTextureEncoder::encode(const VMipChain &chain) const
+{
+    uint size = 0;
+    for (int i = 0; i < chain.levelCount(); i++) {
+        size += encodedSize(chain.width(i), chain.height(i));
+    }
+    VByteArray blocks(size);
+    uint offset = 0;
+    for (int i = 0; i < chain.levelCount(); i++) {
+        encode(chain.level(i), chain.width(i), chain.height(i), reinterpret_cast<uchar *>(&blocks[0]) + offset);
+        offset += encodedSize(chain.width(i), chain.height(i));
+    }
+    return blocks;
+}
+
+NV_NAMESPACE_END
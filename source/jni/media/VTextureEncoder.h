@@ -0,0 +1,58 @@
+#pragma once
+
+#include "VByteArray.h"
+
+NV_NAMESPACE_BEGIN
+
+class VImage;
+class VMipChain;
+
+// Compresses RGBA8 images on the CPU into ETC2 or ASTC blocks, for textures made at runtime such
+// as photos, which take 4 to 8 times the memory and bandwidth when uploaded uncompressed. Rows of
+// blocks are encoded on the workers of VTaskScheduler. The blocks are laid out the way
+// glCompressedTexImage2D() takes them, and VTexture::loadEncoded() uploads them.
+class VTextureEncoder
+{
+public:
+    enum Format
+    {
+        Etc2Rgb,
+        // EAC alpha followed by the ETC2 colors in each block
+        Etc2Rgba,
+        // 6x6 blocks of a single partition with a 4x4 grid of weights. Quick to encode and half
+        // the size of ETC2, at a lower quality.
+        Astc6x6
+    };
+
+    enum Quality
+    {
+        // Colors of each half block from its average
+        FastQuality,
+        // Colors refitted to the modifiers picked, and the ETC2 planar mode for smooth blocks
+        NormalQuality,
+        // Colors searched around the average of each half block
+        HighQuality
+    };
+
+    VTextureEncoder(Format format = Etc2Rgb, Quality quality = NormalQuality);
+
+    Format format() const { return m_format; }
+    Quality quality() const { return m_quality; }
+
+    int blockSize() const;
+    int blockBytes() const;
+    uint glInternalFormat(bool srgb = true) const;
+    uint encodedSize(int width, int height) const;
+
+    // Encodes width x height RGBA8 pixels into the encodedSize() bytes of blocks
+    void encode(const uchar *rgba, int width, int height, uchar *blocks) const;
+    VByteArray encode(const VImage &image) const;
+    // The levels of the chain one after another
+    VByteArray encode(const VMipChain &chain) const;
+
+private:
+    Format m_format;
+    Quality m_quality;
+};
+
+NV_NAMESPACE_END
@@ -14,6 +14,7 @@
 // - in-world text really should sort with all other transparent surfaces
 //
 #include "BitmapFont.h"
+#include "VTextLayout.h"
 #include "VAlgorithm.h"
 
 #include <errno.h>
@@ -26,7 +27,6 @@
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
-#include <sstream>
 
 #include "VPath.h"
 #include "VJson.h"
@@ -82,25 +82,7 @@ char const* SDFFontFragmentShaderSrc =
 				"	gl_FragColor.w = oColor.w * ( clamp( distance, ALPHA_MIN, ALPHA_MAX ) - ALPHA_MIN ) / ( ALPHA_MAX - ALPHA_MIN );\n"
 				"}\n";
 
-class FontGlyphType {
-public:
-	FontGlyphType() :
-			CharCode(0), X(0.0f), Y(0.0f), Width(0.0f), Height(0.0f), AdvanceX(
-					0.0f), AdvanceY(0.0f), BearingX(0.0f), BearingY(0.0f) {
-	}
-
-	int32_t CharCode;
-	float X;
-	float Y;
-	float Width;
-	float Height;
-	float AdvanceX;
-	float AdvanceY;
-	float BearingX;
-	float BearingY;
-};
-
-class FontInfoType {
+class FontInfoType: public FontMetricsType {
 public:
 	static int FNT_FILE_VERSION;
 
@@ -111,12 +93,10 @@ public:
 
 	FontInfoType() :
 			NaturalWidth(0.0f), NaturalHeight(0.0f), HorizontalPad(0), VerticalPad(
-					0), FontHeight(0), ScaleFactorX(1.0f), ScaleFactorY(1.0f), TweakScale(
-					1.0f), CenterOffset(0.0f), MaxAscent(0.0f), MaxDescent(0.0f) {
+					0), TweakScale(1.0f) {
 	}
 
     bool Load(const VZipFile &languagePackageFile, const VString &fileName);
-	FontGlyphType const & GlyphForCharCode(uint32_t const charCode) const;
 
 	std::string FontName; // name of the font (not necessarily the file name)
 	std::string CommandLine; // command line used to generate this font
@@ -125,15 +105,7 @@ public:
 	float NaturalHeight; // height of the font image before downsampling to SDF
 	float HorizontalPad; // horizontal padding for all glyphs
 	float VerticalPad; // vertical padding for all glyphs
-	float FontHeight; // vertical distance between two baselines (i.e. two lines of text)
-	float ScaleFactorX; // x-axis scale factor
-	float ScaleFactorY; // y-axis scale factor
 	float TweakScale; // additional scale factor used to tweak the size of other-language fonts
-	float CenterOffset; // +/- value applied to "center" distance in the signed distance field. Range [-1,1]. A negative offset will make the font appear bolder.
-	float MaxAscent; // maximum ascent of any character
-	float MaxDescent; // maximum descent of any character
-    VArray<FontGlyphType> Glyphs; // info about each glyph in the font
-    VArray<int32_t> CharCodeMap; // index by character code to get the index of a glyph for the character
 
 private:
     bool LoadFromPackage(const VZipFile &packageFile, const VString &fileName);
@@ -219,18 +191,7 @@ private:
 //
 class BitmapFontSurfaceLocal: public BitmapFontSurface {
 public:
-	struct fontVertex_t {
-		fontVertex_t() :
-				xyz(0.0f), s(0.0f), t(0.0f), rgba(), fontParms() {
-		}
-
-        VVect3f xyz;
-		float s;
-		float t;
-		uchar rgba[4];
-		uchar fontParms[4];
-	};
-
+	typedef VTextLayout::Vertex fontVertex_t;
 	typedef unsigned short fontIndex_t;
 
 	BitmapFontSurfaceLocal();
@@ -251,6 +212,11 @@ public:
             fontParms_t const & flags, VVect3f const & pos, float const scale,
             VVect4f const & color, const VString &text);
 
+	int AddStaticText3D(BitmapFont const & font, const fontParms_t & flags,
+            const VVect3f & pos, VVect3f const & normal, VVect3f const & up,
+            float const scale, VVect4f const & color, const VString &text) override;
+	void RemoveStaticText3D(int const id) override;
+
 	// transform the billboarded font strings
     virtual void Finish(VMatrix4f const & viewMatrix);
 
@@ -266,79 +232,27 @@ private:
 	int CurVertex; // reset every Render()
 	int CurIndex; // reset every Render()
 
-	struct vertexBlockFlags_t {
-		bool FaceCamera; // true to always face the camera
+	// Text is laid out once while it stays the same. A layout is in the plane of the text, its
+	// vertex block is placed in world space by the axes of the text once the view is known.
+	VTextLayoutCache LayoutCache;
+	VTextBatch VertexBlocks;
+
+	// Text that doesn't move, placed in world space once into a vertex buffer of its own
+	struct staticText_t {
+		int Id;
+		VTextLayout Layout;
+		VVect3f Pos;
+		VVect3f Right;
+		VVect3f Up;
+		uint Color;
 	};
 
-	// The vertices in a vertex block are in local space and pre-scaled.  They are transformed into
-	// world space and stuffed into the VBO before rendering (once the current MVP is known).
-	// The vertices can be pivoted around the Pivot point to face the camera, then an additional
-	// rotation applied.
-	class VertexBlockType {
-	public:
-		VertexBlockType() :
-				Font(NULL), Verts(NULL), NumVerts(0), Pivot(0.0f), Rotation(), Billboard(
-						true), TrackRoll(false) {
-		}
-
-		VertexBlockType(VertexBlockType const & other) :
-				Font(NULL), Verts(NULL), NumVerts(0), Pivot(0.0f), Rotation(), Billboard(
-						true), TrackRoll(false) {
-			Copy(other);
-		}
-
-		VertexBlockType & operator=(VertexBlockType const & other) {
-			Copy(other);
-			return *this;
-		}
-
-		void Copy(VertexBlockType const & other) {
-			if (&other == this) {
-				return;
-			}
-			delete[] Verts;
-			Font = other.Font;
-			Verts = other.Verts;
-			NumVerts = other.NumVerts;
-			Pivot = other.Pivot;
-			Rotation = other.Rotation;
-			Billboard = other.Billboard;
-			TrackRoll = other.TrackRoll;
-
-			other.Font = NULL;
-			other.Verts = NULL;
-			other.NumVerts = 0;
-		}
-
-		VertexBlockType(BitmapFont const & font, int const numVerts,
-                VVect3f const & pivot, VQuatf const & rot, bool const billboard,
-				bool const trackRoll) :
-				Font(&font), NumVerts(numVerts), Pivot(pivot), Rotation(rot), Billboard(
-						billboard), TrackRoll(trackRoll) {
-			Verts = new fontVertex_t[numVerts];
-		}
-
-		~VertexBlockType() {
-			Free();
-		}
-
-		void Free() {
-			Font = NULL;
-			delete[] Verts;
-			Verts = NULL;
-			NumVerts = 0;
-		}
-
-		mutable BitmapFont const * Font; // the font used to render text into this vertex block
-		mutable fontVertex_t * Verts; // the vertices
-		mutable int NumVerts; // the number of vertices in the block
-        VVect3f Pivot; // postion this vertex block can be rotated around
-        VQuatf Rotation; // additional rotation to apply
-		bool Billboard; // true to always face the camera
-		bool TrackRoll; // if true, when billboarded, roll with the camera
-	};
+	VArray<staticText_t> StaticTexts;
+	VGlGeometry StaticGeo;
+	int NextStaticId;
+	bool StaticDirty; // rebuilt on the next Finish()
 
-	VArray<VertexBlockType> VertexBlocks; // each pointer in the array points to an allocated block ov
+	void BuildStaticGeo();
 
 	// We cast BitmapFont to BitmapFontLocal internally so that we do not have to expose
 	// a lot of BitmapFontLocal methods in the BitmapFont interface just so BitmapFontSurfaceLocal
@@ -351,30 +265,6 @@ private:
 	}
 };
 
-//==============================
-// ftoi
-#if defined( OVR_CPU_X86_64 )
-inline int ftoi( float const f )
-{
-	return _mm_cvtt_ss2si( _mm_set_ss( f ) );
-}
-#elif defined( OVR_CPU_x86 )
-inline int ftoi( float const f )
-{
-	int i;
-	__asm
-	{
-		fld f
-		fistp i
-	}
-	return i;
-}
-#else
-inline int ftoi(float const f) {
-	return (int) f;
-}
-#endif
-
 //==============================
 // FileSize
 static size_t FileSize(FILE * f) {
@@ -410,19 +300,9 @@ bool FontInfoType::LoadFromPackage(const VZipFile &packageFile, const VString &f
 		return false;
 	}
 
-	size_t fsize;
-
-	unsigned char * buffer = NULL;
-	// copy to a zero-terminated buffer for JSON parser
-	fsize = length + 1;
-	buffer = new unsigned char[fsize];
-	memcpy(buffer, packageBuffer, length);
-	buffer[length] = '\0';
-	free(packageBuffer);
-
 	// try to load from the buffer -- this may fail due to an invalid version
-	bool r = LoadFromBuffer(buffer, fsize);
-	delete[] buffer;
+	bool r = LoadFromBuffer(packageBuffer, length);
+	free(packageBuffer);
 	return r;
 }
 
@@ -442,11 +322,7 @@ bool FontInfoType::Load(const VZipFile &languagePackageFile, const VString &file
 // FontInfoType::LoadFromBuffer
 bool FontInfoType::LoadFromBuffer(void const * buffer,
 		size_t const bufferSize) {
-    NV_UNUSED(bufferSize);
-	std::stringstream s;
-	s << reinterpret_cast<char const *>(buffer);
-	VJson jsonRoot;
-	s >> jsonRoot;
+	VJson jsonRoot = VJson::Parse(static_cast<const char *>(buffer), bufferSize);
     if (jsonRoot.isNull()) {
 		vWarn("JSON Error");
 		return false;
@@ -602,28 +478,6 @@ bool FontInfoType::LoadFromBuffer(void const * buffer,
 	return true;
 }
 
-//==============================
-// FontInfoType::GlyphForCharCode
-FontGlyphType const & FontInfoType::GlyphForCharCode(
-		uint32_t const charCode) const {
-	if (charCode >= CharCodeMap.size()) {
-		static FontGlyphType emptyGlyph;
-		return emptyGlyph;
-	}
-	const int glyphIndex = CharCodeMap[charCode];
-
-	if (glyphIndex < 0 || glyphIndex >= Glyphs.length()) {
-		vWarn("FontInfoType::GlyphForCharCode FAILED TO FIND GLYPH FOR CHARACTER!");
-		vWarn("FontInfoType::GlyphForCharCode: charCode " << charCode << " yielding " << glyphIndex);
-		vWarn("FontInfoType::GlyphForCharCode: CharCodeMap size " << CharCodeMap.size() << " Glyphs size " << Glyphs.length());
-
-		return Glyphs['*'];
-	}
-
-	vAssert( glyphIndex >= 0 && glyphIndex < Glyphs.length());
-	return Glyphs[glyphIndex];
-}
-
 //==================================================================================================
 // BitmapFontLocal
 //==================================================================================================
@@ -836,6 +690,7 @@ bool BitmapFontLocal::LoadImageFromBuffer(const VString &imageName, const uchar
 		vWarn("BitmapFontLocal::Load: failed to load '" << imageName << "'");
 		return false;
 	}
+	FontInfo.DistanceScale = ImageWidth / FontInfoType::DEFAULT_SCALE_FACTOR;
 
 	vInfo("BitmapFontLocal::LoadImageFromBuffer: success");
 	return true;
@@ -924,86 +779,8 @@ void BitmapFontLocal::CalcTextMetrics(const VString &text, size_t & len,
         float & width, float & height, float & firstAscent, float & lastDescent,
         float & fontHeight, float * lineWidths, int const maxLines,
         int & numLines) const {
-	len = 0;
-	numLines = 0;
-	width = 0.0f;
-	height = 0.0f;
-
-	if (lineWidths == NULL || maxLines <= 0) {
-		return;
-	}
-    if (text.isEmpty()) {
-		return;
-	}
-
-	float maxLineAscent = 0.0f;
-	float maxLineDescent = 0.0f;
-	firstAscent = 0.0f;
-	lastDescent = 0.0f;
-	fontHeight = FontInfo.FontHeight * FontInfo.ScaleFactorY;
-	numLines = 0;
-	int charsOnLine = 0;
-	lineWidths[0] = 0.0f;
-
-    std::u32string ucs4 = text.toUcs4();
-    std::u32string::iterator p = ucs4.begin();
-    for (;; len++) {
-        uint charCode = *p;
-        p++;
-		if (charCode == '\r') {
-			continue; // skip carriage returns
-		}
-		if (charCode == '\n' || charCode == '\0') {
-			// keep track of the widest line, which will be the width of the entire text block
-			if (lineWidths[numLines] > width) {
-				width = lineWidths[numLines];
-			}
-
-			firstAscent = (numLines == 0) ? maxLineAscent : firstAscent;
-			lastDescent = (charsOnLine > 0) ? maxLineDescent : lastDescent;
-			charsOnLine = 0;
-
-			if (numLines < maxLines - 1) {
-				// if we're not out of array space, advance and zero the width
-				numLines++;
-				lineWidths[numLines] = 0.0f;
-				maxLineAscent = 0.0f;
-				maxLineDescent = 0.0f;
-			}
-			if (charCode == '\0') {
-				break;
-			}
-			continue;
-		}
-
-		charsOnLine++;
-
-		FontGlyphType const & g = GlyphForCharCode(charCode);
-		lineWidths[numLines] += g.AdvanceX * FontInfo.ScaleFactorX;
-
-		if (numLines == 0) {
-			if (g.BearingY > maxLineAscent) {
-				maxLineAscent = g.BearingY;
-			}
-		} else {
-			// all lines after the first line are full height
-			maxLineAscent = FontInfo.FontHeight;
-		}
-		float descent = g.Height - g.BearingY;
-		if (descent > maxLineDescent) {
-			maxLineDescent = descent;
-		}
-	}
-
-	vAssert( numLines >= 1);
-
-	firstAscent *= FontInfo.ScaleFactorY;
-	lastDescent *= FontInfo.ScaleFactorY;
-	height = firstAscent;
-	height += (numLines - 1) * FontInfo.FontHeight * FontInfo.ScaleFactorY;
-	height += lastDescent;
-
-	vAssert( numLines <= maxLines);
+	FontInfo.CalcTextMetrics(text.toUcs4(), len, width, height, firstAscent,
+			lastDescent, fontHeight, lineWidths, maxLines, numLines);
 }
 
 //==================================================================================================
@@ -1013,46 +790,24 @@ void BitmapFontLocal::CalcTextMetrics(const VString &text, size_t & len,
 //==============================
 // BitmapFontSurfaceLocal::BitmapFontSurface
 BitmapFontSurfaceLocal::BitmapFontSurfaceLocal() :
-		Vertices(NULL), MaxVertices(0), MaxIndices(0), CurVertex(0), CurIndex(0) {
+		Vertices(NULL), MaxVertices(0), MaxIndices(0), CurVertex(0), CurIndex(0), NextStaticId(
+				0), StaticDirty(false) {
 }
 
 //==============================
 // BitmapFontSurfaceLocal::~BitmapFontSurfaceLocal
 BitmapFontSurfaceLocal::~BitmapFontSurfaceLocal() {
 	Geo.destroy();
+	StaticGeo.destroy();
 	delete[] Vertices;
 	Vertices = NULL;
 }
 
 //==============================
-// BitmapFontSurfaceLocal::Init
-// Initializes the surface VBO
-void BitmapFontSurfaceLocal::Init(const int maxVertices) {
-	assert(
-			Geo.vertexBuffer == 0 && Geo.indexBuffer == 0 && Geo.vertexArrayObject == 0);
-	assert( Vertices == NULL);
-	if (Vertices != NULL) {
-		delete[] Vertices;
-		Vertices = NULL;
-	}
-	assert( maxVertices % 4 == 0);
-
-	MaxVertices = maxVertices;
-	MaxIndices = (maxVertices / 4) * 6;
-
-	Vertices = new fontVertex_t[maxVertices];
-	const int vertexByteCount = maxVertices * sizeof(fontVertex_t);
-
-	// font VAO
-    VEglDriver::glGenVertexArraysOES(1, &Geo.vertexArrayObject);
-    VEglDriver::glBindVertexArrayOES(Geo.vertexArrayObject);
-
-	// vertex buffer
-	glGenBuffers(1, &Geo.vertexBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, Geo.vertexBuffer);
-	glBufferData(GL_ARRAY_BUFFER, vertexByteCount, (void*) Vertices,
-			GL_DYNAMIC_DRAW);
-
+// SetFontVertexAttribs
+// points the attributes of the bound vertex array at the vertex buffer bound
+static void SetFontVertexAttribs() {
+	typedef BitmapFontSurfaceLocal::fontVertex_t fontVertex_t;
 
 	glEnableVertexAttribArray(VERTEX_POSITION); // x, y and z
 	glVertexAttribPointer(VERTEX_POSITION, 3, GL_FLOAT,
@@ -1073,12 +828,14 @@ void BitmapFontSurfaceLocal::Init(const int maxVertices) {
 	glVertexAttribPointer(FONT_PARMS, 4,
 			GL_UNSIGNED_BYTE, GL_TRUE, sizeof(fontVertex_t),
 			(void*) offsetof( fontVertex_t, fontParms ));
+}
 
-	fontIndex_t * indices = new fontIndex_t[MaxIndices];
-	const int indexByteCount = MaxIndices * sizeof(fontIndex_t);
-
-	// indices never change
-	int numQuads = MaxIndices / 6;
+//==============================
+// CreateQuadIndices
+// two triangles for each quad of four vertices
+static BitmapFontSurfaceLocal::fontIndex_t * CreateQuadIndices(int const numQuads) {
+	BitmapFontSurfaceLocal::fontIndex_t * indices =
+			new BitmapFontSurfaceLocal::fontIndex_t[numQuads * 6];
 	int v = 0;
 	for (int i = 0; i < numQuads; i++) {
 		indices[i * 6 + 0] = v + 2;
@@ -1089,6 +846,43 @@ void BitmapFontSurfaceLocal::Init(const int maxVertices) {
 		indices[i * 6 + 5] = v + 0;
 		v += 4;
 	}
+	return indices;
+}
+
+//==============================
+// BitmapFontSurfaceLocal::Init
+// Initializes the surface VBO
+void BitmapFontSurfaceLocal::Init(const int maxVertices) {
+	assert(
+			Geo.vertexBuffer == 0 && Geo.indexBuffer == 0 && Geo.vertexArrayObject == 0);
+	assert( Vertices == NULL);
+	if (Vertices != NULL) {
+		delete[] Vertices;
+		Vertices = NULL;
+	}
+	assert( maxVertices % 4 == 0);
+
+	MaxVertices = maxVertices;
+	MaxIndices = (maxVertices / 4) * 6;
+
+	Vertices = new fontVertex_t[maxVertices];
+	const int vertexByteCount = maxVertices * sizeof(fontVertex_t);
+
+	// font VAO
+    VEglDriver::glGenVertexArraysOES(1, &Geo.vertexArrayObject);
+    VEglDriver::glBindVertexArrayOES(Geo.vertexArrayObject);
+
+	// vertex buffer
+	glGenBuffers(1, &Geo.vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, Geo.vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertexByteCount, (void*) Vertices,
+			GL_DYNAMIC_DRAW);
+
+	SetFontVertexAttribs();
+
+	// indices never change
+	fontIndex_t * indices = CreateQuadIndices(MaxIndices / 6);
+	const int indexByteCount = MaxIndices * sizeof(fontIndex_t);
 
 	glGenBuffers(1, &Geo.indexBuffer);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Geo.indexBuffer);
@@ -1107,14 +901,6 @@ void BitmapFontSurfaceLocal::Init(const int maxVertices) {
 	vInfo("BitmapFontSurfaceLocal::Init: success");
 }
 
-//==============================
-// ColorToABGR
-int32_t ColorToABGR(VVect4f const & color) {
-	// format is ABGR
-	return (ftoi(color.w * 255.0f) << 24) | (ftoi(color.z * 255.0f) << 16)
-			| (ftoi(color.y * 255.0f) << 8) | ftoi(color.x * 255.0f);
-}
-
 //==============================
 // BitmapFontSurfaceLocal::DrawText3D
 void BitmapFontSurfaceLocal::DrawText3D(BitmapFont const & font,
@@ -1125,172 +911,20 @@ void BitmapFontSurfaceLocal::DrawText3D(BitmapFont const & font,
 		return; // nothing to do here, move along
 	}
 
-	// TODO: multiple line support -- we would need to calculate the horizontal width
-	// for each string ending in \n
-	size_t len;
-	float width;
-	float height;
-	float ascent;
-	float descent;
-	float fontHeight;
-	int const MAX_LINES = 128;
-	float lineWidths[MAX_LINES];
-	int numLines;
-	AsLocal(font).CalcTextMetrics(text, len, width, height, ascent, descent,
-			fontHeight, lineWidths, MAX_LINES, numLines);
-//	LOG( "BitmapFontSurfaceLocal::DrawText3D( \"%s\" %s %s ) : width = %.2f, height = %.2f, numLines = %i, fh = %.2f",
-//			text, ( parms.AlignVert == VERTICAL_CENTER ) ? "cv" : ( ( parms.AlignVert == VERTICAL_BOTTOM ) ? "bv" : "tv" ),
-// 			( parms.AlignHoriz == HORIZONTAL_CENTER ) ? "ch" : ( ( parms.AlignVert == HORIZONTAL_LEFT ) ? "lh" : "rh" ),
-//			width, height, numLines, AsLocal( font ).GetFontInfo().FontHeight );
-	if (len == 0) {
-		return;
-	}
-
     vAssert(normal.isNormalized());
     vAssert(up.isNormalized());
 
-	const FontInfoType & fontInfo = AsLocal(font).GetFontInfo();
-
-	float imageWidth = (float) AsLocal(font).GetImageWidth();
-	float const xScale = AsLocal(font).GetFontInfo().ScaleFactorX * scale;
-	float const yScale = AsLocal(font).GetFontInfo().ScaleFactorY * scale;
-
-	// allocate a vertex block
-	size_t numVerts = 4 * len;
-    VertexBlockType vb(font, numVerts, pos, VQuatf(), parms.Billboard,
-			parms.TrackRoll);
+	// the layout is only redone when the text changes, scale, color and orientation are applied
+	// when the vertex block is placed
+	VTextLayout const & layout = LayoutCache.layout(AsLocal(font).GetFontInfo(),
+			parms, text);
 
     VVect3f const right = up.crossProduct(normal);
     VVect3f const r = (parms.Billboard) ? VVect3f(1.0f, 0.0f, 0.0f) : right;
     VVect3f const u = (parms.Billboard) ? VVect3f(0.0f, 1.0f, 0.0f) : up;
 
-    VVect3f curPos(0.0f);
-	switch (parms.AlignVert) {
-	case VERTICAL_BASELINE:
-		break;
-
-	case VERTICAL_CENTER: {
-		float const vofs = (height * 0.5f) - ascent;
-		curPos += u * (vofs * scale);
-		break;
-	}
-	case VERTICAL_CENTER_FIXEDHEIGHT: {
-		// for fixed height, we must adjust single-line text by the max ascent because fonts
-		// are rendered according to their baseline. For multiline text, the first line
-		// contributes max ascent only while the other lines are adjusted by font height.
-		float const ma = AsLocal(font).GetFontInfo().MaxAscent;
-		float const md = AsLocal(font).GetFontInfo().MaxDescent;
-		float const fh = AsLocal(font).GetFontInfo().FontHeight;
-		float const adjust = (ma - md) * 0.5f;
-		float const vofs = (fh * (numLines - 1) * 0.5f) - adjust;
-		curPos += u * (vofs * yScale);
-		break;
-	}
-	case VERTICAL_TOP: {
-		float const vofs = height - ascent;
-		curPos += u * (vofs * scale);
-		break;
-	}
-	}
-
-    VVect3f basePos = curPos;
-	switch (parms.AlignHoriz) {
-	case HORIZONTAL_LEFT:
-		break;
-
-	case HORIZONTAL_CENTER: {
-		curPos -= r * (lineWidths[0] * 0.5f * scale);
-		break;
-	}
-	case HORIZONTAL_RIGHT: {
-		curPos -= r * (lineWidths[0] * scale);
-		break;
-	}
-	}
-
-    VVect3f lineInc = u * (fontInfo.FontHeight * yScale);
-	float const distanceScale = imageWidth / FontInfoType::DEFAULT_SCALE_FACTOR;
-	const uint8_t fontParms[4] =
-			{
-                    (uint8_t) (VAlgorithm::Clamp(
-							parms.AlphaCenter + fontInfo.CenterOffset, 0.0f,
-                            1.0f) * 255), (uint8_t) (VAlgorithm::Clamp(
-							parms.ColorCenter + fontInfo.CenterOffset, 0.0f,
-                            1.0f) * 255), (uint8_t) (VAlgorithm::Clamp(
-							distanceScale, 1.0f, 255.0f)), 0 };
-
-	int iColor = ColorToABGR(color);
-
-	int curLine = 0;
-	fontVertex_t * v = vb.Verts;
-    std::u32string ucs4Text = text.toUcs4();
-    std::u32string::iterator p = ucs4Text.begin();
-	size_t i = 0;
-    uint32_t charCode = *p;
-    for (; charCode != '\0'; i++, charCode = *(++p)) {
-		vAssert( i < len);
-		if (charCode == '\n' && curLine < numLines && curLine < MAX_LINES) {
-			// move to next line
-			curLine++;
-			basePos -= lineInc;
-			curPos = basePos;
-			switch (parms.AlignHoriz) {
-			case HORIZONTAL_LEFT:
-				break;
-
-			case HORIZONTAL_CENTER: {
-				curPos -= r * (lineWidths[curLine] * 0.5f * scale);
-				break;
-			}
-			case HORIZONTAL_RIGHT: {
-				curPos -= r * (lineWidths[curLine] * scale);
-				break;
-			}
-			}
-		}
-
-		FontGlyphType const & g = AsLocal(font).GlyphForCharCode(charCode);
-
-		float s0 = g.X;
-		float t0 = g.Y;
-		float s1 = (g.X + g.Width);
-		float t1 = (g.Y + g.Height);
-
-		float bearingX = g.BearingX * xScale;
-		float bearingY = g.BearingY * yScale;
-
-		float rw = (g.Width + g.BearingX) * xScale;
-		float rh = (g.Height - g.BearingY) * yScale;
-
-		// lower left
-		v[i * 4 + 0].xyz = curPos + (r * bearingX) - (u * rh);
-		v[i * 4 + 0].s = s0;
-		v[i * 4 + 0].t = t1;
-		*(vuint32*) (&v[i * 4 + 0].rgba[0]) = iColor;
-		*(vuint32*) (&v[i * 4 + 0].fontParms[0]) = *(vuint32*) (&fontParms[0]);
-		// upper left
-		v[i * 4 + 1].xyz = curPos + (r * bearingX) + (u * bearingY);
-		v[i * 4 + 1].s = s0;
-		v[i * 4 + 1].t = t0;
-		*(vuint32*) (&v[i * 4 + 1].rgba[0]) = iColor;
-		*(vuint32*) (&v[i * 4 + 1].fontParms[0]) = *(vuint32*) (&fontParms[0]);
-		// upper right
-		v[i * 4 + 2].xyz = curPos + (r * rw) + (u * bearingY);
-		v[i * 4 + 2].s = s1;
-		v[i * 4 + 2].t = t0;
-		*(vuint32*) (&v[i * 4 + 2].rgba[0]) = iColor;
-		*(vuint32*) (&v[i * 4 + 2].fontParms[0]) = *(vuint32*) (&fontParms[0]);
-		// lower right
-		v[i * 4 + 3].xyz = curPos + (r * rw) - (u * rh);
-		v[i * 4 + 3].s = s1;
-		v[i * 4 + 3].t = t1;
-		*(vuint32*) (&v[i * 4 + 3].rgba[0]) = iColor;
-		*(vuint32*) (&v[i * 4 + 3].fontParms[0]) = *(vuint32*) (&fontParms[0]);
-		// advance to start of next char
-		curPos += r * (g.AdvanceX * xScale);
-	}
-	// add the new vertex block to the array of vertex blocks
-	VertexBlocks.append(vb);
+	VertexBlocks.add(layout, pos, r * scale, u * scale,
+			VTextLayout::ColorToAbgr(color), parms.Billboard, parms.TrackRoll);
 }
 
 //==============================
@@ -1318,22 +952,92 @@ void BitmapFontSurfaceLocal::DrawTextBillboarded3D(BitmapFont const & font,
             VVect3f(0.0f, -1.0f, 0.0f), scale, color, text);
 }
 
-//==============================================================
-// vbSort_t
-// small structure that is used to sort vertex blocks by their distance to the camera
-//==============================================================
-struct vbSort_t {
-	int VertexBlockIndex;
-	float DistanceSquared;
-};
+//==============================
+// BitmapFontSurfaceLocal::AddStaticText3D
+int BitmapFontSurfaceLocal::AddStaticText3D(BitmapFont const & font,
+        fontParms_t const & parms, VVect3f const & pos,
+        VVect3f const & normal, VVect3f const & up, float const scale,
+        VVect4f const & color, const VString &text) {
+	if (parms.Billboard) {
+		vWarn("BitmapFontSurfaceLocal::AddStaticText3D: billboarded text can't be static");
+		return -1;
+	}
+    if (text.isEmpty()) {
+		return -1;
+	}
+
+    vAssert(normal.isNormalized());
+    vAssert(up.isNormalized());
+
+	staticText_t staticText;
+	staticText.Id = NextStaticId++;
+	staticText.Layout.layout(AsLocal(font).GetFontInfo(), parms, text);
+	staticText.Pos = pos;
+	staticText.Right = up.crossProduct(normal) * scale;
+	staticText.Up = up * scale;
+	staticText.Color = VTextLayout::ColorToAbgr(color);
+	StaticTexts.append(staticText);
+	StaticDirty = true;
+	return staticText.Id;
+}
 
 //==============================
-// VertexBlockSortFn
-// sort function for vertex blocks
-int VertexBlockSortFn(void const * a, void const * b) {
-	return ftoi(
-			((vbSort_t const*) a)->DistanceSquared
-					- ((vbSort_t const*) b)->DistanceSquared);
+// BitmapFontSurfaceLocal::RemoveStaticText3D
+void BitmapFontSurfaceLocal::RemoveStaticText3D(int const id) {
+	for (int i = 0; i < StaticTexts.length(); ++i) {
+		if (StaticTexts[i].Id == id) {
+			StaticTexts.removeAt(i);
+			StaticDirty = true;
+			return;
+		}
+	}
+}
+
+//==============================
+// BitmapFontSurfaceLocal::BuildStaticGeo
+// place the static text in world space and upload it to its own VBO
+void BitmapFontSurfaceLocal::BuildStaticGeo() {
+	StaticDirty = false;
+
+	VTextBatch batch;
+	for (staticText_t const & staticText : StaticTexts) {
+		batch.add(staticText.Layout, staticText.Pos, staticText.Right,
+				staticText.Up, staticText.Color, false, false);
+	}
+
+	// the indices are 16 bit
+	int const maxVertices = std::min(batch.quadCount() * 4, 65536);
+	VArray<fontVertex_t> vertices;
+	vertices.resize(maxVertices);
+	int const numVerts = batch.place(VMatrix4f(), vertices.data(), maxVertices);
+	StaticGeo.indexCount = (numVerts / 4) * 6;
+	if (numVerts == 0) {
+		return;
+	}
+
+	if (StaticGeo.vertexArrayObject == 0) {
+	    VEglDriver::glGenVertexArraysOES(1, &StaticGeo.vertexArrayObject);
+		glGenBuffers(1, &StaticGeo.vertexBuffer);
+		glGenBuffers(1, &StaticGeo.indexBuffer);
+	    VEglDriver::glBindVertexArrayOES(StaticGeo.vertexArrayObject);
+		glBindBuffer(GL_ARRAY_BUFFER, StaticGeo.vertexBuffer);
+		SetFontVertexAttribs();
+	} else {
+	    VEglDriver::glBindVertexArrayOES(StaticGeo.vertexArrayObject);
+		glBindBuffer(GL_ARRAY_BUFFER, StaticGeo.vertexBuffer);
+	}
+
+	glBufferData(GL_ARRAY_BUFFER, numVerts * sizeof(fontVertex_t),
+			(void*) vertices.data(), GL_STATIC_DRAW);
+
+	fontIndex_t * indices = CreateQuadIndices(numVerts / 4);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, StaticGeo.indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+			StaticGeo.indexCount * sizeof(fontIndex_t), (void*) indices,
+			GL_STATIC_DRAW);
+	delete[] indices;
+
+    VEglDriver::glBindVertexArrayOES(0);
 }
 
 //==============================
@@ -1346,69 +1050,19 @@ void BitmapFontSurfaceLocal::Finish(VMatrix4f const & viewMatrix) {
 
 	//SPAM( "BitmapFontSurfaceLocal::Finish" );
 
-    VMatrix4f invViewMatrix = viewMatrix.inverted(); // if the view is never scaled or sheared we could use Transposed() here instead
-    VVect3f viewPos = invViewMatrix.translation();
-
-	// sort vertex blocks indices based on distance to pivot
-	int const MAX_VERTEX_BLOCKS = 256;
-	vbSort_t vbSort[MAX_VERTEX_BLOCKS];
-	int const n = VertexBlocks.length();
-	for (int i = 0; i < n; ++i) {
-		vbSort[i].VertexBlockIndex = i;
-		VertexBlockType & vb = VertexBlocks[i];
-		vbSort[i].DistanceSquared = (vb.Pivot - viewPos).lengthSquared();
+	if (StaticDirty) {
+		BuildStaticGeo();
 	}
 
-	qsort(vbSort, n, sizeof(vbSort[0]), VertexBlockSortFn);
-
-	// transform the vertex blocks into the vertices array
-	CurIndex = 0;
-	CurVertex = 0;
-
 	// TODO:
 	// To add multiple-font-per-surface support, we need to add a 3rd component to s and t,
 	// then get the font for each vertex block, and set the texture index on each vertex in
 	// the third texture coordinate.
-	for (int i = 0; i < VertexBlocks.length(); ++i) {
-		VertexBlockType & vb = VertexBlocks[vbSort[i].VertexBlockIndex];
-        VMatrix4f transform;
-		if (vb.Billboard) {
-			if (vb.TrackRoll) {
-				transform = invViewMatrix;
-			} else {
-                VVect3f textNormal = viewPos - vb.Pivot;
-				float const len = textNormal.length();
-                if (len < VConstantsf::SmallestNonDenormal) {
-					vb.Free();
-					continue;
-				}
-				textNormal *= 1.0f / len;
-                transform = VMatrix4f::CreateFromBasisVectors(textNormal,
-                        VVect3f(0.0f, 1.0f, 0.0f));
-			}
-			transform.setTranslation(vb.Pivot);
-        } else {
-			transform.setTranslation(vb.Pivot);
-		}
-
-		for (int j = 0; j < vb.NumVerts; j++) {
-			fontVertex_t const & v = vb.Verts[j];
-            Vertices[CurVertex].xyz = transform.transform(v.xyz);
-			Vertices[CurVertex].s = v.s;
-			Vertices[CurVertex].t = v.t;
-			*(vuint32*) (&Vertices[CurVertex].rgba[0]) = *(vuint32*) (&v.rgba[0]);
-			*(vuint32*) (&Vertices[CurVertex].fontParms[0]) =
-					*(vuint32*) (&v.fontParms[0]);
-			CurVertex++;
-		}
-		CurIndex += (vb.NumVerts / 2) * 3;
-		// free this vertex block
-		vb.Free();
-	}
-	// remove all elements from the vertex block (but don't free the memory since it's likely to be
-	// needed on the next frame.
-	VertexBlocks.clear();
+	CurVertex = VertexBlocks.place(viewMatrix, Vertices, MaxVertices);
+	CurIndex = (CurVertex / 4) * 6;
 
+	// the layouts of the text drawn this frame are kept for the next one
+	LayoutCache.update();
 
     VEglDriver::glBindVertexArrayOES(Geo.vertexArrayObject);
 	glBindBuffer(GL_ARRAY_BUFFER, Geo.vertexBuffer);
@@ -1453,6 +1107,10 @@ void BitmapFontSurfaceLocal::Render3D(BitmapFont const & font,
 	glUniform4fv(AsLocal(font).GetFontProgram().uniformColor, 1, textColor);
 
 	// draw all font vertices
+	if (StaticGeo.indexCount > 0) {
+	    VEglDriver::glBindVertexArrayOES(StaticGeo.vertexArrayObject);
+		glDrawElements(GL_TRIANGLES, StaticGeo.indexCount, GL_UNSIGNED_SHORT, NULL);
+	}
     VEglDriver::glBindVertexArrayOES(Geo.vertexArrayObject);
 	glDrawElements(GL_TRIANGLES, Geo.indexCount, GL_UNSIGNED_SHORT, NULL);
     VEglDriver::glBindVertexArrayOES(0);
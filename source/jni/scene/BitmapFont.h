@@ -92,6 +92,14 @@ public:
             fontParms_t const & flags, VVect3f const & pos, float const scale,
             VVect4f const & color, const VString &text) = 0;
 
+	// Text that doesn't move is laid out into a vertex buffer of its own once, rather than every
+	// frame, and drawn until it is removed. Billboarded text can't be static. Returns an id to
+	// remove the text with, or -1 if nothing was added.
+	virtual int AddStaticText3D(BitmapFont const & font, const fontParms_t & flags,
+            const VVect3f & pos, VVect3f const & normal, VVect3f const & up,
+            float const scale, VVect4f const & color, const VString &text) = 0;
+	virtual void RemoveStaticText3D(int const id) = 0;
+
     virtual void Finish(VMatrix4f const & viewMatrix) = 0;
 
 	virtual void Render3D(BitmapFont const & font,
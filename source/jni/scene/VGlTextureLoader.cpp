@@ -0,0 +1,36 @@
+#include "VGlTextureLoader.h"
+
+#include "VEglDriver.h"
+#include "VFile.h"
+#include "VResource.h"
+
+NV_NAMESPACE_BEGIN
+
+bool VGlTextureLoader::load(const VString &path, const VTexture::Flags &flags, VTextureCache::Texture &texture)
+{
+    // The cache keeps failures apart rather than the default texture
+    VTexture loaded;
+    if (VResource::Exist(path)) {
+        loaded.load(VResource(path), flags | VTexture::NoDefault);
+    } else {
+        VFile file(path, VFile::ReadOnly);
+        loaded.load(file, flags | VTexture::NoDefault);
+    }
+    if (loaded.id() == 0) {
+        return false;
+    }
+
+    texture.id = loaded.id();
+    texture.target = loaded.target();
+    texture.width = loaded.width();
+    texture.height = loaded.height();
+    texture.size = loaded.memorySize();
+    return true;
+}
+
+void VGlTextureLoader::destroy(const VTextureCache::Texture &texture)
+{
+    glDeleteTextures(1, &texture.id);
+}
+
+NV_NAMESPACE_END
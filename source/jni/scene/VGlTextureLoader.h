@@ -0,0 +1,16 @@
+#pragma once
+
+#include "VTextureCache.h"
+
+NV_NAMESPACE_BEGIN
+
+// Loads the textures of VTextureCache with VTexture on the context current on the render thread.
+// Paths found in the application package are loaded from it, the others from the file system.
+class VGlTextureLoader : public VTextureCache::Loader
+{
+public:
+    bool load(const VString &path, const VTexture::Flags &flags, VTextureCache::Texture &texture) override;
+    void destroy(const VTextureCache::Texture &texture) override;
+};
+
+NV_NAMESPACE_END
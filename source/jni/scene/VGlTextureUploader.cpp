@@ -0,0 +1,209 @@
+#include "VGlTextureUploader.h"
+
+#include "VEglDriver.h"
+
+NV_NAMESPACE_BEGIN
+
+struct VGlTextureUploader::Private
+{
+    bool sharedContext;
+    EGLDisplay display;
+    EGLContext shareContext;
+    EGLConfig config;
+    EGLint clientVersion;
+
+    EGLContext context;
+    EGLSurface surface;
+    bool attached;
+
+    //Given out when no fence could be created and the uploads were finished instead
+    int finished;
+
+    Private(bool sharedContext)
+        : sharedContext(sharedContext)
+        , display(eglGetCurrentDisplay())
+        , shareContext(eglGetCurrentContext())
+        , config(nullptr)
+        , clientVersion(GL_ES_VERSION)
+        , context(EGL_NO_CONTEXT)
+        , surface(EGL_NO_SURFACE)
+        , attached(false)
+        , finished(0)
+    {
+    }
+
+    bool createContext()
+    {
+        if (display == EGL_NO_DISPLAY || shareContext == EGL_NO_CONTEXT) {
+            vWarn("VGlTextureUploader: no context to share");
+            return false;
+        }
+
+        const EGLint configAttribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, GL_ES_VERSION >= 3 ? EGL_OPENGL_ES3_BIT_KHR : EGL_OPENGL_ES2_BIT,
+            EGL_NONE
+        };
+        EGLint numConfigs = 0;
+        if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0) {
+            vWarn("VGlTextureUploader: eglChooseConfig failed: " << VEglDriver::getEglErrorString());
+            return false;
+        }
+        eglQueryContext(display, shareContext, EGL_CONTEXT_CLIENT_VERSION, &clientVersion);
+
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_CLIENT_VERSION, clientVersion,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, shareContext, contextAttribs);
+        if (context == EGL_NO_CONTEXT) {
+            vWarn("VGlTextureUploader: eglCreateContext failed: " << VEglDriver::getEglErrorString());
+            return false;
+        }
+
+        const EGLint surfaceAttribs[] = {
+            EGL_WIDTH, 1,
+            EGL_HEIGHT, 1,
+            EGL_NONE
+        };
+        surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+        if (surface == EGL_NO_SURFACE) {
+            vWarn("VGlTextureUploader: eglCreatePbufferSurface failed: " << VEglDriver::getEglErrorString());
+            return false;
+        }
+
+        if (eglMakeCurrent(display, surface, surface, context) == EGL_FALSE) {
+            vWarn("VGlTextureUploader: eglMakeCurrent failed: " << VEglDriver::getEglErrorString());
+            return false;
+        }
+        return true;
+    }
+
+    void destroyContext()
+    {
+        if (context != EGL_NO_CONTEXT && eglGetCurrentContext() == context) {
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        }
+        if (surface != EGL_NO_SURFACE) {
+            eglDestroySurface(display, surface);
+            surface = EGL_NO_SURFACE;
+        }
+        if (context != EGL_NO_CONTEXT) {
+            eglDestroyContext(display, context);
+            context = EGL_NO_CONTEXT;
+        }
+    }
+};
+
+VGlTextureUploader::VGlTextureUploader(bool sharedContext)
+    : d(new Private(sharedContext))
+{
+}
+
+VGlTextureUploader::~VGlTextureUploader()
+{
+    d->destroyContext();
+    delete d;
+}
+
+void VGlTextureUploader::attach()
+{
+    if (d->sharedContext) {
+        d->attached = d->createContext();
+        if (!d->attached) {
+            d->destroyContext();
+        }
+    } else {
+        d->attached = eglGetCurrentContext() != EGL_NO_CONTEXT;
+    }
+}
+
+void VGlTextureUploader::detach()
+{
+    if (d->sharedContext) {
+        d->destroyContext();
+    }
+    d->attached = false;
+}
+
+uint VGlTextureUploader::create(const VTextureStreamer::Image &image)
+{
+    NV_UNUSED(image);
+    if (!d->attached) {
+        return 0;
+    }
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    return texture;
+}
+
+void VGlTextureUploader::upload(uint texture, const VTextureStreamer::Image &image, const VTextureStreamer::Image::Level &level, int y, int height)
+{
+    const GLenum target = image.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + level.face : GL_TEXTURE_2D;
+    const uchar *data = image.data() + level.offset;
+    glBindTexture(image.target, texture);
+
+    if (image.isCompressed()) {
+        glCompressedTexImage2D(target, level.level, image.internalFormat, level.width, level.height, 0, level.size, data);
+    } else if (y == 0 && height == level.height) {
+        glTexImage2D(target, level.level, image.internalFormat, level.width, level.height, 0, image.format, image.type, data);
+    } else {
+        // Rows spread over frames, the level is allocated with the first ones
+        if (y == 0) {
+            glTexImage2D(target, level.level, image.internalFormat, level.width, level.height, 0, image.format, image.type, nullptr);
+        }
+        const uint rowBytes = level.size / level.height;
+        glTexSubImage2D(target, level.level, 0, y, level.width, height, image.format, image.type, data + y * rowBytes);
+    }
+
+    glBindTexture(image.target, 0);
+}
+
+VGlTextureUploader::Fence VGlTextureUploader::finish(uint texture, const VTextureStreamer::Image &image)
+{
+    glBindTexture(image.target, texture);
+    if (image.target == GL_TEXTURE_2D) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    }
+    // Surfaces look pretty terrible without trilinear filtering
+    glTexParameteri(image.target, GL_TEXTURE_MIN_FILTER, image.levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(image.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(image.target, GL_TEXTURE_MAX_LEVEL, image.levelCount - 1);
+    glBindTexture(image.target, 0);
+
+    if (VEglDriver::logErrorsEnum("VGlTextureUploader")) {
+        return nullptr;
+    }
+
+    const EGLSyncKHR sync = VEglDriver::eglCreateSyncKHR(d->display, EGL_SYNC_FENCE_KHR, nullptr);
+    if (sync == EGL_NO_SYNC_KHR) {
+        glFinish();
+        return &d->finished;
+    }
+    // The fence only signals once the commands before it are submitted
+    glFlush();
+    return sync;
+}
+
+bool VGlTextureUploader::isSignaled(Fence fence)
+{
+    if (fence == &d->finished) {
+        return true;
+    }
+    return VEglDriver::eglClientWaitSyncKHR(d->display, fence, 0, 0) == EGL_CONDITION_SATISFIED_KHR;
+}
+
+void VGlTextureUploader::release(Fence fence)
+{
+    if (fence != &d->finished) {
+        VEglDriver::eglDestroySyncKHR(d->display, fence);
+    }
+}
+
+void VGlTextureUploader::destroy(uint texture)
+{
+    glDeleteTextures(1, &texture);
+}
+
+NV_NAMESPACE_END
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "VTextureStreamer.h"
+
+NV_NAMESPACE_BEGIN
+
+// Uploads the textures of VTextureStreamer with GLES 3 and signals them with EGL fences, which
+// the render thread can poll. With sharedContext, attach() creates a context sharing the one
+// current when the uploader is constructed, for VTextureStreamer's loader thread. Otherwise it
+// uploads on the context current on the thread calling update().
+class VGlTextureUploader : public VTextureStreamer::Uploader
+{
+public:
+    explicit VGlTextureUploader(bool sharedContext);
+    ~VGlTextureUploader();
+
+    void attach() override;
+    void detach() override;
+
+    uint create(const VTextureStreamer::Image &image) override;
+    void upload(uint texture, const VTextureStreamer::Image &image, const VTextureStreamer::Image::Level &level, int y, int height) override;
+    Fence finish(uint texture, const VTextureStreamer::Image &image) override;
+    bool isSignaled(Fence fence) override;
+    void release(Fence fence) override;
+    void destroy(uint texture) override;
+
+private:
+    NV_DECLARE_PRIVATE
+    NV_DISABLE_COPY(VGlTextureUploader)
+};
+
+NV_NAMESPACE_END
@@ -0,0 +1,505 @@
+#include "VTextLayout.h"
+
+#include "VAlgorithm.h"
+#include "VConstants.h"
+#include "VLog.h"
+#include "VStringHash.h"
+
+#include <algorithm>
+#include <string.h>
+
+NV_NAMESPACE_BEGIN
+
+//==============================
+// FontMetricsType::GlyphForCharCode
+FontGlyphType const & FontMetricsType::GlyphForCharCode(
+		uint32_t const charCode) const {
+	if (charCode >= CharCodeMap.size()) {
+		static FontGlyphType emptyGlyph;
+		return emptyGlyph;
+	}
+	const int glyphIndex = CharCodeMap[charCode];
+
+	if (glyphIndex < 0 || glyphIndex >= Glyphs.length()) {
+		vWarn("FontInfoType::GlyphForCharCode FAILED TO FIND GLYPH FOR CHARACTER!");
+		vWarn("FontInfoType::GlyphForCharCode: charCode " << charCode << " yielding " << glyphIndex);
+		vWarn("FontInfoType::GlyphForCharCode: CharCodeMap size " << CharCodeMap.size() << " Glyphs size " << Glyphs.length());
+
+		return Glyphs['*'];
+	}
+
+	vAssert( glyphIndex >= 0 && glyphIndex < Glyphs.length());
+	return Glyphs[glyphIndex];
+}
+
+//==============================
+// FontMetricsType::CalcTextMetrics
+void FontMetricsType::CalcTextMetrics(const std::u32string &text, size_t & len,
+        float & width, float & height, float & firstAscent, float & lastDescent,
+        float & fontHeight, float * lineWidths, int const maxLines,
+        int & numLines) const {
+	len = 0;
+	numLines = 0;
+	width = 0.0f;
+	height = 0.0f;
+
+	if (lineWidths == NULL || maxLines <= 0) {
+		return;
+	}
+    if (text.empty()) {
+		return;
+	}
+
+	float maxLineAscent = 0.0f;
+	float maxLineDescent = 0.0f;
+	firstAscent = 0.0f;
+	lastDescent = 0.0f;
+	fontHeight = FontHeight * ScaleFactorY;
+	numLines = 0;
+	int charsOnLine = 0;
+	lineWidths[0] = 0.0f;
+
+    for (;; len++) {
+        uint charCode = len < text.size() ? text[len] : '\0';
+		if (charCode == '\r') {
+			continue; // skip carriage returns
+		}
+		if (charCode == '\n' || charCode == '\0') {
+			// keep track of the widest line, which will be the width of the entire text block
+			if (lineWidths[numLines] > width) {
+				width = lineWidths[numLines];
+			}
+
+			firstAscent = (numLines == 0) ? maxLineAscent : firstAscent;
+			lastDescent = (charsOnLine > 0) ? maxLineDescent : lastDescent;
+			charsOnLine = 0;
+
+			if (numLines < maxLines - 1) {
+				// if we're not out of array space, advance and zero the width
+				numLines++;
+				lineWidths[numLines] = 0.0f;
+				maxLineAscent = 0.0f;
+				maxLineDescent = 0.0f;
+			}
+			if (charCode == '\0') {
+				break;
+			}
+			continue;
+		}
+
+		charsOnLine++;
+
+		FontGlyphType const & g = GlyphForCharCode(charCode);
+		lineWidths[numLines] += g.AdvanceX * ScaleFactorX;
+
+		if (numLines == 0) {
+			if (g.BearingY > maxLineAscent) {
+				maxLineAscent = g.BearingY;
+			}
+		} else {
+			// all lines after the first line are full height
+			maxLineAscent = FontHeight;
+		}
+		float descent = g.Height - g.BearingY;
+		if (descent > maxLineDescent) {
+			maxLineDescent = descent;
+		}
+	}
+
+	vAssert( numLines >= 1);
+
+	firstAscent *= ScaleFactorY;
+	lastDescent *= ScaleFactorY;
+	height = firstAscent;
+	height += (numLines - 1) * FontHeight * ScaleFactorY;
+	height += lastDescent;
+
+	vAssert( numLines <= maxLines);
+}
+
+VTextLayout::VTextLayout()
+    : m_fontParms(0)
+    , m_lineCount(0)
+    , m_width(0.0f)
+    , m_height(0.0f)
+{
+}
+
+void VTextLayout::layout(const FontMetricsType &font, const fontParms_t &parms, const VString &text)
+{
+    clear();
+    if (text.isEmpty()) {
+        return;
+    }
+
+    const std::u32string ucs4 = text.toUcs4();
+    size_t len;
+    float ascent;
+    float descent;
+    float fontHeight;
+    const int MaxLines = 128;
+    float lineWidths[MaxLines];
+    int numLines;
+    font.CalcTextMetrics(ucs4, len, m_width, m_height, ascent, descent, fontHeight, lineWidths, MaxLines, numLines);
+    if (len == 0) {
+        return;
+    }
+    m_lineCount = numLines;
+
+    //As DrawText3D placed the text at a scale of 1, along x to the right and y up
+    const float xScale = font.ScaleFactorX;
+    const float yScale = font.ScaleFactorY;
+    float x = 0.0f;
+    float y = 0.0f;
+    switch (parms.AlignVert) {
+    case VERTICAL_BASELINE:
+        break;
+    case VERTICAL_CENTER:
+        y += m_height * 0.5f - ascent;
+        break;
+    case VERTICAL_CENTER_FIXEDHEIGHT: {
+        //Single-line text is adjusted by the max ascent as fonts are rendered from their baseline,
+        //the other lines of multiline text by the font height
+        const float adjust = (font.MaxAscent - font.MaxDescent) * 0.5f;
+        y += (font.FontHeight * (numLines - 1) * 0.5f - adjust) * yScale;
+        break;
+    }
+    case VERTICAL_TOP:
+        y += m_height - ascent;
+        break;
+    }
+
+    const float baseX = x;
+    int curLine = 0;
+    auto alignLine = [&]() {
+        switch (parms.AlignHoriz) {
+        case HORIZONTAL_LEFT:
+            break;
+        case HORIZONTAL_CENTER:
+            x -= lineWidths[curLine] * 0.5f;
+            break;
+        case HORIZONTAL_RIGHT:
+            x -= lineWidths[curLine];
+            break;
+        }
+    };
+    alignLine();
+
+    const uchar fontParms[4] = {
+        (uchar) (VAlgorithm::Clamp(parms.AlphaCenter + font.CenterOffset, 0.0f, 1.0f) * 255),
+        (uchar) (VAlgorithm::Clamp(parms.ColorCenter + font.CenterOffset, 0.0f, 1.0f) * 255),
+        (uchar) VAlgorithm::Clamp(font.DistanceScale, 1.0f, 255.0f),
+        0
+    };
+    memcpy(&m_fontParms, fontParms, sizeof(m_fontParms));
+
+    m_quads.reserve(len);
+    for (size_t i = 0; i < ucs4.size() && ucs4[i] != '\0'; i++) {
+        const uint32_t charCode = ucs4[i];
+        if (charCode == '\n') {
+            if (curLine < numLines - 1) {
+                curLine++;
+                y -= font.FontHeight * yScale;
+                x = baseX;
+                alignLine();
+            }
+            continue;
+        }
+        //Line endings take no room, CalcTextMetrics doesn't count them either
+        if (charCode == '\r') {
+            continue;
+        }
+
+        const FontGlyphType &g = font.GlyphForCharCode(charCode);
+        Quad quad;
+        quad.left = x + g.BearingX * xScale;
+        quad.right = x + (g.Width + g.BearingX) * xScale;
+        quad.bottom = y - (g.Height - g.BearingY) * yScale;
+        quad.top = y + g.BearingY * yScale;
+        quad.s0 = g.X;
+        quad.t0 = g.Y;
+        quad.s1 = g.X + g.Width;
+        quad.t1 = g.Y + g.Height;
+        m_quads.append(quad);
+
+        x += g.AdvanceX * xScale;
+    }
+}
+
+void VTextLayout::clear()
+{
+    m_quads.clear();
+    m_fontParms = 0;
+    m_lineCount = 0;
+    m_width = 0.0f;
+    m_height = 0.0f;
+}
+
+void VTextLayout::place(const VVect3f &origin, const VVect3f &right, const VVect3f &up, uint color, Vertex *vertices) const
+{
+    Vertex *v = vertices;
+    for (const Quad &quad : m_quads) {
+        const VVect3f left = origin + right * quad.left;
+        const VVect3f rightEdge = origin + right * quad.right;
+        const VVect3f bottom = up * quad.bottom;
+        const VVect3f top = up * quad.top;
+
+        v[0].xyz = left + bottom;
+        v[0].s = quad.s0;
+        v[0].t = quad.t1;
+        v[1].xyz = left + top;
+        v[1].s = quad.s0;
+        v[1].t = quad.t0;
+        v[2].xyz = rightEdge + top;
+        v[2].s = quad.s1;
+        v[2].t = quad.t0;
+        v[3].xyz = rightEdge + bottom;
+        v[3].s = quad.s1;
+        v[3].t = quad.t1;
+        for (int i = 0; i < 4; i++) {
+            memcpy(v[i].rgba, &color, sizeof(color));
+            memcpy(v[i].fontParms, &m_fontParms, sizeof(m_fontParms));
+        }
+        v += 4;
+    }
+}
+
+uint VTextLayout::ColorToAbgr(const VVect4f &color)
+{
+    return ((uint) (int) (color.w * 255.0f) << 24) | ((uint) (int) (color.z * 255.0f) << 16)
+            | ((uint) (int) (color.y * 255.0f) << 8) | (uint) (int) (color.x * 255.0f);
+}
+
+namespace {
+
+struct LayoutKey
+{
+    const FontMetricsType *font;
+    VString text;
+    int alignHoriz;
+    int alignVert;
+    float alphaCenter;
+    float colorCenter;
+
+    LayoutKey(const FontMetricsType &font, const fontParms_t &parms, const VString &text)
+        : font(&font)
+        , text(text)
+        , alignHoriz(parms.AlignHoriz)
+        , alignVert(parms.AlignVert)
+        , alphaCenter(parms.AlphaCenter)
+        , colorCenter(parms.ColorCenter)
+    {
+    }
+};
+
+//The scale, color, orientation and billboarding of text are applied when it's placed
+struct LayoutKeyTraits
+{
+    static uint Hash(const LayoutKey &key)
+    {
+        uint hash = VHashTraits<VString>::Hash(key.text);
+        hash ^= VHashTraits<const FontMetricsType *>::Hash(key.font) + 0x9e3779b9u + (hash << 6) + (hash >> 2);
+        hash ^= VHashTraits<int>::Mix(key.alignHoriz | key.alignVert << 8) + 0x9e3779b9u + (hash << 6) + (hash >> 2);
+        return hash;
+    }
+
+    static bool Equal(const LayoutKey &key1, const LayoutKey &key2)
+    {
+        return key1.font == key2.font && key1.alignHoriz == key2.alignHoriz && key1.alignVert == key2.alignVert
+                && key1.alphaCenter == key2.alphaCenter && key1.colorCenter == key2.colorCenter
+                && VHashTraits<VString>::Equal(key1.text, key2.text);
+    }
+};
+
+}
+
+VTextLayoutCache::Stats::Stats()
+    : layouts(0)
+    , quads(0)
+    , hits(0)
+    , misses(0)
+    , evicted(0)
+{
+}
+
+struct VTextLayoutCache::Private
+{
+    struct Entry
+    {
+        VTextLayout layout;
+        //Frame it was last asked for
+        int frame;
+    };
+
+    //Entries are pointed to as the layouts given out must survive the table growing
+    VHash<LayoutKey, Entry *, LayoutKeyTraits> entries;
+    int framesToKeep;
+    int frame;
+    int quads;
+
+    //The last frame ended
+    Stats stats;
+    //Of the frame going on
+    Stats current;
+
+    Private(int framesToKeep)
+        : framesToKeep(std::max(framesToKeep, 1))
+        , frame(0)
+        , quads(0)
+    {
+    }
+};
+
+VTextLayoutCache::VTextLayoutCache(int framesToKeep)
+    : d(new Private(framesToKeep))
+{
+}
+
+VTextLayoutCache::~VTextLayoutCache()
+{
+    clear();
+    delete d;
+}
+
+const VTextLayout &VTextLayoutCache::layout(const FontMetricsType &font, const fontParms_t &parms, const VString &text)
+{
+    const LayoutKey key(font, parms, text);
+    Private::Entry *entry = d->entries.value(key, nullptr);
+    if (entry) {
+        d->current.hits++;
+    } else {
+        d->current.misses++;
+        entry = new Private::Entry;
+        entry->layout.layout(font, parms, text);
+        d->entries.insert(key, entry);
+        d->quads += entry->layout.quadCount();
+    }
+    entry->frame = d->frame;
+    return entry->layout;
+}
+
+void VTextLayoutCache::update()
+{
+    d->frame++;
+
+    //Text that wasn't drawn lately is likely to have changed, its layout is of no use any more
+    VArray<LayoutKey> stale;
+    for (const auto &entry : d->entries) {
+        if (d->frame - entry.second->frame > d->framesToKeep) {
+            stale.append(entry.first);
+        }
+    }
+    for (const LayoutKey &key : stale) {
+        Private::Entry *entry = d->entries.value(key);
+        d->quads -= entry->layout.quadCount();
+        d->entries.remove(key);
+        delete entry;
+    }
+
+    d->stats.hits = d->current.hits;
+    d->stats.misses = d->current.misses;
+    d->stats.evicted = stale.length();
+    d->current = Stats();
+}
+
+void VTextLayoutCache::clear()
+{
+    for (const auto &entry : d->entries) {
+        delete entry.second;
+    }
+    d->entries.clear();
+    d->quads = 0;
+}
+
+VTextLayoutCache::Stats VTextLayoutCache::stats() const
+{
+    Stats stats = d->stats;
+    stats.layouts = d->entries.size();
+    stats.quads = d->quads;
+    return stats;
+}
+
+VTextBatch::VTextBatch()
+    : m_quadCount(0)
+{
+}
+
+void VTextBatch::add(const VTextLayout &layout, const VVect3f &pivot, const VVect3f &right, const VVect3f &up,
+                     uint color, bool billboard, bool trackRoll)
+{
+    if (layout.isEmpty()) {
+        return;
+    }
+    Block block;
+    block.layout = &layout;
+    block.pivot = pivot;
+    block.right = right;
+    block.up = up;
+    block.color = color;
+    block.billboard = billboard;
+    block.trackRoll = trackRoll;
+    block.distanceSquared = 0.0f;
+    m_blocks.append(block);
+    m_quadCount += layout.quadCount();
+}
+
+void VTextBatch::clear()
+{
+    m_blocks.clear();
+    m_quadCount = 0;
+}
+
+int VTextBatch::place(const VMatrix4f &viewMatrix, VTextLayout::Vertex *vertices, int maxVertices)
+{
+    // if the view is never scaled or sheared we could use Transposed() here instead
+    const VMatrix4f invViewMatrix = viewMatrix.inverted();
+    const VVect3f viewPos = invViewMatrix.translation();
+
+    const int n = m_blocks.length();
+    m_order.resize(n);
+    for (int i = 0; i < n; i++) {
+        m_order[i] = i;
+        m_blocks[i].distanceSquared = (m_blocks[i].pivot - viewPos).lengthSquared();
+    }
+    std::stable_sort(m_order.begin(), m_order.end(), [this](int a, int b) {
+        return m_blocks[a].distanceSquared < m_blocks[b].distanceSquared;
+    });
+
+    //Each block is a rotation about its pivot at most, so its axes are turned once rather than
+    //every vertex transformed by a full matrix
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        const Block &block = m_blocks[m_order[i]];
+        VVect3f right = block.right;
+        VVect3f up = block.up;
+        if (block.billboard) {
+            VMatrix4f rotation;
+            if (block.trackRoll) {
+                rotation = invViewMatrix;
+            } else {
+                VVect3f textNormal = viewPos - block.pivot;
+                const float len = textNormal.length();
+                if (len < VConstantsf::SmallestNonDenormal) {
+                    continue;
+                }
+                textNormal *= 1.0f / len;
+                rotation = VMatrix4f::CreateFromBasisVectors(textNormal, VVect3f(0.0f, 1.0f, 0.0f));
+            }
+            rotation.setTranslation(VVect3f(0.0f));
+            right = rotation.transform(block.right);
+            up = rotation.transform(block.up);
+        }
+
+        const int blockVertices = block.layout->quadCount() * 4;
+        if (count + blockVertices > maxVertices) {
+            vWarn("VTextBatch: " << m_quadCount * 4 << " vertices of text, " << maxVertices << " fit");
+            break;
+        }
+        block.layout->place(block.pivot, right, up, block.color, vertices + count);
+        count += blockVertices;
+    }
+    clear();
+    return count;
+}
+
+NV_NAMESPACE_END
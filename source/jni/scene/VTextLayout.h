@@ -0,0 +1,187 @@
+#pragma once
+
+#include "BitmapFont.h"
+
+#include <string>
+
+NV_NAMESPACE_BEGIN
+
+class FontGlyphType {
+public:
+	FontGlyphType() :
+			CharCode(0), X(0.0f), Y(0.0f), Width(0.0f), Height(0.0f), AdvanceX(
+					0.0f), AdvanceY(0.0f), BearingX(0.0f), BearingY(0.0f) {
+	}
+
+	int32_t CharCode;
+	float X;
+	float Y;
+	float Width;
+	float Height;
+	float AdvanceX;
+	float AdvanceY;
+	float BearingX;
+	float BearingY;
+};
+
+// The part of a font that text is laid out with, without its texture
+class FontMetricsType {
+public:
+	FontMetricsType() :
+			FontHeight(0), ScaleFactorX(1.0f), ScaleFactorY(1.0f), CenterOffset(
+					0.0f), MaxAscent(0.0f), MaxDescent(0.0f), DistanceScale(1.0f) {
+	}
+
+	FontGlyphType const & GlyphForCharCode(uint32_t const charCode) const;
+
+	// See BitmapFont::CalcTextMetrics()
+	void CalcTextMetrics(const std::u32string &text, size_t & len, float & width,
+			float & height, float & ascent, float & descent, float & fontHeight,
+			float * lineWidths, int const maxLines, int & numLines) const;
+
+	float FontHeight; // vertical distance between two baselines (i.e. two lines of text)
+	float ScaleFactorX; // x-axis scale factor
+	float ScaleFactorY; // y-axis scale factor
+	float CenterOffset; // +/- value applied to "center" distance in the signed distance field. Range [-1,1]. A negative offset will make the font appear bolder.
+	float MaxAscent; // maximum ascent of any character
+	float MaxDescent; // maximum descent of any character
+	float DistanceScale; // width of the font image over the default scale factor
+	VArray<FontGlyphType> Glyphs; // info about each glyph in the font
+	VArray<int32_t> CharCodeMap; // index by character code to get the index of a glyph for the character
+};
+
+// The quads of the glyphs of a string, laid out without GL in the plane of the text at a scale of
+// 1. Each quad spans the right and up axes of the text, so that the same layout can be placed
+// at any position, orientation, scale and color by a transform of its corners.
+class VTextLayout
+{
+public:
+    // As the vertex buffer of BitmapFontSurface takes them
+    struct Vertex
+    {
+        Vertex() : xyz(0.0f), s(0.0f), t(0.0f), rgba(), fontParms() {}
+
+        VVect3f xyz;
+        float s;
+        float t;
+        uchar rgba[4];
+        uchar fontParms[4];
+    };
+
+    // Left, bottom, right and top along the axes of the text, and the texture coordinates
+    struct Quad
+    {
+        float left;
+        float bottom;
+        float right;
+        float top;
+        float s0;
+        float t0;
+        float s1;
+        float t1;
+    };
+
+    VTextLayout();
+
+    void layout(const FontMetricsType &font, const fontParms_t &parms, const VString &text);
+    void clear();
+
+    bool isEmpty() const { return m_quads.isEmpty(); }
+    int quadCount() const { return m_quads.length(); }
+    const VArray<Quad> &quads() const { return m_quads; }
+    int lineCount() const { return m_lineCount; }
+    // Of the widest line and of every line, at a scale of 1
+    float width() const { return m_width; }
+    float height() const { return m_height; }
+
+    // Four vertices a quad, lower left, upper left, upper right and lower right, at origin + right
+    // * x + up * y. right and up carry the scale of the text.
+    void place(const VVect3f &origin, const VVect3f &right, const VVect3f &up, uint color, Vertex *vertices) const;
+
+    // ABGR, as the vertices take it
+    static uint ColorToAbgr(const VVect4f &color);
+
+private:
+    VArray<Quad> m_quads;
+    uint m_fontParms;
+    int m_lineCount;
+    float m_width;
+    float m_height;
+};
+
+// Keeps the layouts of the text drawn in the last frames, so that text that doesn't change is
+// laid out once rather than every frame. Layouts are looked up by font, string, alignment and
+// font parms, and stay valid until the next update().
+class VTextLayoutCache
+{
+public:
+    struct Stats
+    {
+        Stats();
+
+        int layouts;
+        int quads;
+        // Of the last frame update() ended
+        int hits;
+        int misses;
+        int evicted;
+    };
+
+    // Layouts not used for framesToKeep frames are dropped
+    explicit VTextLayoutCache(int framesToKeep = 1);
+    ~VTextLayoutCache();
+
+    const VTextLayout &layout(const FontMetricsType &font, const fontParms_t &parms, const VString &text);
+
+    // Once a frame, after the layouts of the frame were placed
+    void update();
+    void clear();
+
+    Stats stats() const;
+
+private:
+    NV_DECLARE_PRIVATE
+    NV_DISABLE_COPY(VTextLayoutCache)
+};
+
+// The text drawn in a frame, placed into vertices once the view is known. Billboarded text is
+// turned to face the camera around its pivot, and the blocks of text are ordered by their
+// distance to the camera, nearest first.
+class VTextBatch
+{
+public:
+    VTextBatch();
+
+    // The layout must stay valid until the batch is placed. right and up carry the scale, and
+    // are the x and y axes that billboarded text is turned from.
+    void add(const VTextLayout &layout, const VVect3f &pivot, const VVect3f &right, const VVect3f &up,
+             uint color, bool billboard, bool trackRoll);
+    void clear();
+
+    bool isEmpty() const { return m_blocks.isEmpty(); }
+    int blockCount() const { return m_blocks.length(); }
+    int quadCount() const { return m_quadCount; }
+
+    // Writes the quads of the blocks that fit in maxVertices vertices, returns how many vertices
+    // were written and clears the batch
+    int place(const VMatrix4f &viewMatrix, VTextLayout::Vertex *vertices, int maxVertices);
+
+private:
+    struct Block
+    {
+        const VTextLayout *layout;
+        VVect3f pivot;
+        VVect3f right;
+        VVect3f up;
+        uint color;
+        bool billboard;
+        bool trackRoll;
+        float distanceSquared;
+    };
+
+    VArray<Block> m_blocks;
+    VArray<int> m_order;
+    int m_quadCount;
+};
+
+NV_NAMESPACE_END
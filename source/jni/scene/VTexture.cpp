@@ -5,8 +5,8 @@
 #include "VImage.h"
 #include "VPath.h"
 #include "VResource.h"
-
-#include <fstream>
+#include "VTextureContainer.h"
+#include "VTextureEncoder.h"
 
 #define GL_COMPRESSED_RGBA_ASTC_4x4_KHR            0x93B0
 #define GL_COMPRESSED_RGBA_ASTC_5x4_KHR            0x93B1
@@ -145,7 +145,11 @@ static bool TextureFormatToGlFormat(const int format, const bool useSrgbFormat,
 
     case Texture_ASTC_6x6:
         glFormat = GL_RGBA;
-        glInternalFormat = GL_COMPRESSED_RGBA_ASTC_6x6_KHR;
+        if (useSrgbFormat) {
+            glInternalFormat = GL_COMPRESSED_SRGB8_ALPHA8_ASTC_6x6_KHR;
+        } else {
+            glInternalFormat = GL_COMPRESSED_RGBA_ASTC_6x6_KHR;
+        }
         return true;
 
     case Texture_ATC_RGB:
@@ -161,73 +165,6 @@ static bool TextureFormatToGlFormat(const int format, const bool useSrgbFormat,
 	return false;
 }
 
-static bool GlFormatToTextureFormat(int &format, GLenum glFormat, GLenum glInternalFormat)
-{
-    if (glFormat == GL_RED && glInternalFormat == GL_R8) {
-		format = Texture_R;
-		return true;
-	}
-
-    if (glFormat == GL_RGB && (glInternalFormat == GL_RGB || glInternalFormat == GL_SRGB8)) {
-		format = Texture_RGB;
-		return true;
-	}
-
-    if (glFormat == GL_RGBA && (glInternalFormat == GL_RGBA || glInternalFormat == GL_SRGB8_ALPHA8)) {
-		format = Texture_RGBA;
-		return true;
-	}
-
-    if ((glFormat == 0 || glFormat == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) && glInternalFormat == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) {
-		format = Texture_DXT1;
-		return true;
-	}
-
-    if ((glFormat == 0 || glFormat == GL_RGB) && glInternalFormat == GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG)
-	{
-		format = Texture_PVR4bRGB;
-		return true;
-	}
-
-    if ((glFormat == 0 || glFormat == GL_RGBA) && glInternalFormat == GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG)
-	{
-		format = Texture_PVR4bRGBA;
-		return true;
-	}
-
-    if ((glFormat == 0 || glFormat == GL_RGB) && (glInternalFormat == GL_ETC1_RGB8_OES || glInternalFormat == GL_COMPRESSED_SRGB8_ETC2))
-	{
-		format = Texture_ETC1;
-		return true;
-	}
-
-    if ((glFormat == 0 || glFormat == GL_RGB) && (glInternalFormat == GL_COMPRESSED_RGB8_ETC2 || glInternalFormat == GL_COMPRESSED_SRGB8_ETC2))
-	{
-		format = Texture_ETC2_RGB;
-		return true;
-	}
-
-    if ((glFormat == 0 || glFormat == GL_RGBA) && (glInternalFormat == GL_COMPRESSED_RGBA8_ETC2_EAC || glInternalFormat == GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC))
-	{
-		format = Texture_ETC2_RGBA;
-		return true;
-	}
-
-    if ((glFormat == 0 || glFormat == GL_RGB) && glInternalFormat == GL_ATC_RGB_AMD)
-	{
-		format = Texture_ATC_RGB;
-		return true;
-	}
-
-    if ((glFormat == 0 || glFormat == GL_RGBA) && glInternalFormat == GL_ATC_RGBA_EXPLICIT_ALPHA_AMD)
-	{
-		format = Texture_ATC_RGBA;
-		return true;
-    }
-
-	return false;
-}
-
 static int32_t CalculateTextureSize(int format, int width, int height)
 {
     switch (format & Texture_TypeMask) {
@@ -293,267 +230,43 @@ struct AstcHeader
     uchar zsize[3];
 };
 
-/*
-
-PVR Container Format
-
-Offset    Size       Name           Description
-0x0000    4 [DWORD]  Version        0x03525650
-0x0004    4 [DWORD]  Flags          0x0000 if no flags set
-                                    0x0002 if colors within the texture
-0x0008    8 [Union]  Pixel Format   This can either be one of several predetermined enumerated
-                                    values (a DWORD) or a 4-character array and a 4-byte array (8 bytes).
-                                    If the most significant 4 bytes of the 64-bit (8-byte) value are all zero,
-                                    then it indicates that it is the enumeration with the following values:
-                                    Value  Pixel Type
-                                    0      PVRTC 2bpp RGB
-                                    1      PVRTC 2bpp RGBA
-                                    2      PVRTC 4bpp RGB
-                                    3      PVRTC 4bpp RGBA
-                                    4      PVRTC-II 2bpp
-                                    5      PVRTC-II 4bpp
-                                    6      ETC1
-                                    7      DXT1 / BC1
-                                    8      DXT2
-                                    9      DXT3 / BC2
-                                    10     DXT4
-                                    11     DXT5 / BC3
-                                    12     BC4
-                                    13     BC5
-                                    14     BC6
-                                    15     BC7
-                                    16     UYVY
-                                    17     YUY2
-                                    18     BW1bpp
-                                    19     R9G9B9E5 Shared Exponent
-                                    20     RGBG8888
-                                    21     GRGB8888
-                                    22     ETC2 RGB
-                                    23     ETC2 RGBA
-                                    24     ETC2 RGB A1
-                                    25     EAC R11 Unsigned
-                                    26     EAC R11 Signed
-                                    27     EAC RG11 Unsigned
-                                    28     EAC RG11 Signed
-                                    If the most significant 4 bytes are not zero then the 8-byte character array
-                                    indicates the pixel format as follows:
-                                    The least significant 4 bytes indicate channel order, such as:
-                                    { 'b', 'g', 'r', 'a' } or { 'b', 'g', 'r', '\0' }
-                                    The most significant 4 bytes indicate the width of each channel in bits, as follows:
-                                    { 4, 4, 4, 4 } or { 2, 2, 2, 2 }, or {5, 5, 5, 0 }
-0x0010  4 [DWORD]    Color Space    This is an enumerated field, currently two values:
-                                    Value   Color Space
-                                    0       Linear RGB
-                                    1       Standard RGB
-0x0014  4 [DWORD]    Channel Type   This is another enumerated field:
-                                    Value   Data Type
-                                    0       Unsigned Byte Normalized
-                                    1       Signed Byte Normalized
-                                    2       Unsigned Byte
-                                    3       Signed Byte
-                                    4       Unsigned Short Normalized
-                                    5       Signed Short Normalized
-                                    6       Unsigned Short
-                                    7       Signed Short
-                                    8       Unsigned Integer Normalized
-                                    9       Signed Integer Normalized
-                                    10      Unsigned Integer
-                                    11      Signed Integer
-                                    12      Float (no size specified)
-0x0018  4 [DWORD]    Height         Height of the image.
-0x001C  4 [DWORD]    Width          Width of the image.
-0x0020  4 [DWORD]    Depth          Depth of the image, in pixels.
-0x0024  4 [DWORD]    Surface Count  The number of surfaces to this texture, used for texture arrays.
-0x0028  4 [DWORD]    Face Count     The number of faces to this texture, used for cube maps.
-0x002C  4 [DWORD]    MIP-Map Count  The number of MIP-Map levels, including a top level.
-0x0030  4 [DWORD]    Metadata Size  The size, in bytes, of meta data that immediately follows this header.
-
-*/
-
-#pragma pack(1)
-struct PvrHeader
-{
-    vuint32 version;
-    vuint32 flags;
-    vuint64 pixelFormat;
-    vuint32 colorSpace;
-    vuint32 channelType;
-    vuint32 height;
-    vuint32 width;
-    vuint32 depth;
-    vuint32 numSurfaces;
-    vuint32 numFaces;
-    vuint32 mipMapCount;
-    vuint32 metaDataSize;
-};
-#pragma pack()
-
-unsigned char * LoadPVRBuffer( const char * fileName, int & width, int & height )
-{
-	width = 0;
-	height = 0;
-
-    std::fstream fileBuffer;
-    fileBuffer.open(fileName);
-    fileBuffer.seekg(0, std::ios_base::end);
-    uint fileLength = 0;
-    fileLength = fileBuffer.tellg();
-    fileBuffer.seekg(0, std::ios_base::beg);
-    void *buffer = NULL;
-    buffer = malloc(fileLength);
-    fileBuffer.read(reinterpret_cast<std::istream::char_type*>(buffer), fileLength);
-    if ( fileLength < ( int )( sizeof( PvrHeader ) ) )
-	{
-		vInfo("Invalid PVR file");
-        free( (void *)buffer );
-        buffer = NULL;
-        fileLength = 0;
-		return NULL;
-	}
-
-    const PvrHeader & header = *( PvrHeader * )buffer;
-    if ( header.version != 0x03525650 )
-	{
-		vInfo("Invalid PVR file version");
-        free( (void *)buffer );
-        buffer = NULL;
-        fileLength = 0;
-		return NULL;
-	}
-
-	int format = 0;
-    switch ( header.pixelFormat )
-	{
-        case 578721384203708274ull:	format = Texture_RGBA;		break;
-		default:
-            vInfo("Unknown PVR texture format " << header.pixelFormat << "lu, size " << width << "x" << height);
-            free( (void *)buffer );
-            buffer = NULL;
-            fileLength = 0;
-			return NULL;
-	}
-
-	// skip the metadata
-    const vuint32 startTex = sizeof( PvrHeader ) + header.metaDataSize;
-    if ( ( startTex < sizeof( PvrHeader ) ) || ( startTex >= static_cast< size_t >( fileLength ) ) )
-	{
-		vInfo("Invalid PVR header sizes");
-        free( (void *)buffer );
-        buffer = NULL;
-        fileLength = 0;
-		return NULL;
-	}
-
-    size_t mipSize = CalculateTextureSize( format, header.width, header.height );
-
-    const int outBufferSizeBytes = fileLength - startTex;
-
-	if ( outBufferSizeBytes < 0 || mipSize > static_cast< size_t >( outBufferSizeBytes ) )
-	{
-        free( (void *)buffer );
-        buffer = NULL;
-        fileLength = 0;
-		return NULL;
-	}
-
-    width = header.width;
-    height = header.height;
-
-	// skip the metadata
-	unsigned char * outBuffer = ( unsigned char * )malloc( outBufferSizeBytes );
-    memcpy( outBuffer, ( unsigned char * )buffer + startTex, outBufferSizeBytes );
-    free( (void *)buffer );
-    buffer = NULL;
-    fileLength = 0;
-
-	return outBuffer;
-}
-
-
-/*
-
-KTX Container Format
-
-KTX is a format for storing textures for OpenGL and OpenGL ES applications.
-It is distinguished by the simplicity of the loader required to instantiate
-a GL texture object from the file contents.
-
-Byte[12] identifier
-vuint32 endianness
-vuint32 glType
-vuint32 glTypeSize
-vuint32 glFormat
-Uint32 glInternalFormat
-Uint32 glBaseInternalFormat
-vuint32 pixelWidth
-vuint32 pixelHeight
-vuint32 pixelDepth
-vuint32 numberOfArrayElements
-vuint32 numberOfFaces
-vuint32 numberOfMipmapLevels
-vuint32 bytesOfKeyValueData
-
-for each keyValuePair that fits in bytesOfKeyValueData
-    vuint32   keyAndValueByteSize
-    Byte     keyAndValue[keyAndValueByteSize]
-    Byte     valuePadding[3 - ((keyAndValueByteSize + 3) % 4)]
-end
-
-for each mipmap_level in numberOfMipmapLevels*
-    vuint32 imageSize;
-    for each array_element in numberOfArrayElements*
-       for each face in numberOfFaces
-           for each z_slice in pixelDepth*
-               for each row or row_of_blocks in pixelHeight*
-                   for each pixel or block_of_pixels in pixelWidth
-                       Byte data[format-specific-number-of-bytes]**
-                   end
-               end
-           end
-           Byte cubePadding[0-3]
-       end
-    end
-    Byte mipPadding[3 - ((imageSize + 3) % 4)]
-end
-
-*/
-
-#pragma pack(1)
-struct KtxHeader
-{
-    uchar identifier[12];
-    vuint32 endianness;
-    vuint32 glType;
-    vuint32 glTypeSize;
-    vuint32 glFormat;
-    vuint32 glInternalFormat;
-    vuint32 glBaseInternalFormat;
-    vuint32 pixelWidth;
-    vuint32 pixelHeight;
-    vuint32 pixelDepth;
-    vuint32 numberOfArrayElements;
-    vuint32 numberOfFaces;
-    vuint32 numberOfMipmapLevels;
-    vuint32 bytesOfKeyValueData;
-};
-#pragma pack()
-
 struct VTexture::Private
 {
     uint id;
     uint target;
     int width;
     int height;
+    // Of the levels uploaded
+    uint memorySize;
+    int levelCount;
 
     Private()
         : id(0)
         , target(0)
         , width(0)
         , height(0)
+        , memorySize(0)
+        , levelCount(0)
     {
     }
 
     void load(const VPath &path, const VByteArray &data, const VTexture::Flags &flags)
+    {
+        load(path, reinterpret_cast<const uchar *>(data.data()), data.size(), flags);
+    }
+
+    void load(VFile &file, const VTexture::Flags &flags)
+    {
+        // Textures are parsed and uploaded straight from the mapped file
+        VMappedView view = file.map();
+        if (view.isNull()) {
+            load(file.path(), file.readAll(), flags);
+        } else {
+            load(file.path(), view.bytes(), view.size(), flags);
+        }
+    }
+
+    void load(const VPath &path, const uchar *data, uint size, const VTexture::Flags &flags)
     {
         VString ext = path.extension();
         if (ext.isEmpty()) {
@@ -561,7 +274,7 @@ struct VTexture::Private
         }
         ext = ext.toLower();
 
-        if (ext.isEmpty() || data.isEmpty()) {
+        if (ext.isEmpty() || size == 0) {
             // can't load anything from an empty buffer
             return;
         }
@@ -569,22 +282,20 @@ struct VTexture::Private
         if (ext == "jpg" || ext == "tga" || ext == "png" || ext == "bmp"
             || ext == "psd" || ext == "gif" || ext == "hdr" || ext == "pic") {
             // Uncompressed files loaded by stb_image
-            VImage image(data);
-            if (image.isValid()) {
+            VImage image;
+            if (image.load(data, size)) {
                 width = image.width();
                 height = image.height();
-                create2D(Texture_RGBA, image.data(), image.length(), 1, flags & VTexture::UseSRGB, false);
-
-                if (!(flags & VTexture::NoMipmaps)) {
-                    glBindTexture(target, id);
-                    glGenerateMipmap(target);
-                    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+                if (flags & VTexture::NoMipmaps) {
+                    create2D(Texture_RGBA, image.data(), image.length(), 1, flags & VTexture::UseSRGB);
+                } else {
+                    // Gamma-correct levels built on the CPU, uploaded together with the base
+                    VMipChain chain = image.buildMipChain(flags & VTexture::UseSRGB);
+                    create2D(Texture_RGBA, chain.data(), chain.length(), chain.levelCount(), flags & VTexture::UseSRGB);
                 }
             }
-        } else if (ext == "pvr") {
-            loadPVR(data, flags & VTexture::UseSRGB, flags & VTexture::NoMipmaps);
-        } else if (ext == "ktx") {
-            loadKTX(data, flags & VTexture::UseSRGB, flags & VTexture::NoMipmaps);
+        } else if (ext == "pvr" || ext == "ktx") {
+            loadContainer(data, size, flags & VTexture::UseSRGB, flags & VTexture::NoMipmaps);
         } else {
             vWarn("unsupported file extension " << ext);
         }
@@ -605,12 +316,12 @@ struct VTexture::Private
                 };
                 const size_t dataSize = CalculateTextureSize(Texture_RGB, width, height);
                 width = height = 8;
-                create2D(Texture_RGB, defaultTexture, dataSize, 1, true, false);
+                create2D(Texture_RGB, defaultTexture, dataSize, 1, true);
             }
         }
     }
 
-    void create2D(int format, const uchar *data, uint dataSize, int mipCount, bool useSrgbFormat, bool imageSizeStored)
+    void create2D(int format, const uchar *data, uint dataSize, int mipCount, bool useSrgbFormat)
     {
         GLenum glFormat;
         GLenum glInternalFormat;
@@ -632,6 +343,8 @@ struct VTexture::Private
         GLuint texId;
         glGenTextures(1, &texId);
         glBindTexture(GL_TEXTURE_2D, texId);
+        memorySize = 0;
+        levelCount = 0;
 
         const uchar *level = data;
         const uchar *endOfBuffer = level + dataSize;
@@ -639,20 +352,7 @@ struct VTexture::Private
         int w = width;
         int h = height;
         for (int i = 0; i < mipCount; i++) {
-            int32_t mipSize = CalculateTextureSize(format, w, h);
-            if (imageSizeStored) {
-                mipSize = * (const size_t *) level;
-
-                level += 4;
-                if (level > endOfBuffer) {
-                    vWarn("Image data exceeds buffer size");
-                    glBindTexture(GL_TEXTURE_2D, 0);
-                    id = texId;
-                    target = GL_TEXTURE_2D;
-                    return;
-                }
-            }
-
+            const int32_t mipSize = CalculateTextureSize(format, w, h);
             if (mipSize <= 0 || mipSize > endOfBuffer - level) {
                 vWarn("Mip level " << i << " exceeds buffer size (" << mipSize << " > " << (endOfBuffer - level) << ")");
                 glBindTexture(GL_TEXTURE_2D, 0);
@@ -670,17 +370,8 @@ struct VTexture::Private
             }
 
             level += mipSize;
-            if (imageSizeStored) {
-                level += 3 - ((mipSize + 3) % 4);
-                if (level > endOfBuffer) {
-                    vWarn("Image data exceeds buffer size");
-                    glBindTexture(GL_TEXTURE_2D, 0);
-
-                    id = texId;
-                    target = GL_TEXTURE_2D;
-                    return;
-                }
-            }
+            memorySize += mipSize;
+            levelCount++;
 
             w >>= 1;
             h >>= 1;
@@ -710,220 +401,59 @@ struct VTexture::Private
         target = GL_TEXTURE_2D;
     }
 
-    void createCube(const int format, const uchar *data, uint dataSize, const int mipCount, const bool useSrgbFormat, const bool imageSizeStored)
+    // KTX and PVR files, every level checked by the container and uploaded from where it lies
+    void loadContainer(const uchar *data, uint size, bool useSrgbFormat, bool noMipMaps)
     {
-        vAssert(width == height);
-
-        if (mipCount <= 0) {
-            vInfo("Invalid mip count " << mipCount);
-            return;
-        }
+        width = 0;
+        height = 0;
+        memorySize = 0;
+        levelCount = 0;
 
-        // larger than this would require mipSize below to be a larger type
-        height = width;
-        if (width <= 0 || width > 32768) {
-            vInfo("Invalid texture size (" << width << "x" << height << ")");
+        VTextureContainer container;
+        if (!container.parse(data, size, VTexture::skippedMipLevels, noMipMaps ? 1 : 0)) {
             return;
         }
+        width = container.width();
+        height = container.height();
 
-        GLenum glFormat;
-        GLenum glInternalFormat;
-        if (!TextureFormatToGlFormat(format, useSrgbFormat, glFormat, glInternalFormat)) {
-            return;
-        }
+        const GLenum glTarget = container.glTarget();
+        const GLenum glInternalFormat = container.glInternalFormat(useSrgbFormat);
 
         GLuint texId;
         glGenTextures(1, &texId);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, texId);
-
-        const uchar *level = data;
-        const uchar *endOfBuffer = level + dataSize;
-
-        for (int i = 0; i < mipCount; i++) {
-            const int w = width >> i;
-            int32_t mipSize = CalculateTextureSize(format, w, w);
-            if (imageSizeStored) {
-                mipSize = * (const size_t *) level;
-                level += 4;
-                if (level > endOfBuffer) {
-                    vWarn("Image data exceeds buffer size");
-                    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-
-                    id = texId;
-                    target = GL_TEXTURE_CUBE_MAP;
-                    return;
-                }
-            }
-
-            for (int side = 0; side < 6; side++) {
-                if (mipSize <= 0 || mipSize > endOfBuffer - level) {
-                    vWarn("Mip level " << i << " exceeds buffer size (" << mipSize << " > " << endOfBuffer - level << ")");
-                    glBindTexture( GL_TEXTURE_CUBE_MAP, 0);
+        glBindTexture(glTarget, texId);
 
-                    id = texId;
-                    target = GL_TEXTURE_CUBE_MAP;
-                    return;
-                }
-
-                if (format & Texture_Compressed) {
-                    glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, i, glInternalFormat, w, w, 0, mipSize, level);
-                } else {
-                    glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + side, i, glInternalFormat, w, w, 0, glFormat, GL_UNSIGNED_BYTE, level);
-                }
-
-                level += mipSize;
-                if (imageSizeStored) {
-                    level += 3 - ((mipSize + 3) % 4);
-                    if (level > endOfBuffer) {
-                        vWarn("Image data exceeds buffer size");
-                        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-
-                        id = texId;
-                        target = GL_TEXTURE_CUBE_MAP;
-                        return;
-                    }
-                }
+        for (const VTextureContainer::Level &level : container.levels()) {
+            const GLenum faceTarget = container.isCubeMap() ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + level.face : GL_TEXTURE_2D;
+            if (container.isCompressed()) {
+                glCompressedTexImage2D(faceTarget, level.level, glInternalFormat, level.width, level.height, 0, level.size, level.data);
+            } else {
+                glTexImage2D(faceTarget, level.level, glInternalFormat, level.width, level.height, 0, container.glFormat(), container.glType(), level.data);
             }
         }
 
+        if (glTarget == GL_TEXTURE_2D) {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        }
         // Surfaces look pretty terrible without trilinear filtering
-        if (mipCount <= 1) {
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        if (container.levelCount() <= 1) {
+            glTexParameteri(glTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         } else {
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(glTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         }
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(glTarget, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // Levels left out of a file would otherwise leave the texture incomplete
+        glTexParameteri(glTarget, GL_TEXTURE_MAX_LEVEL, container.levelCount() - 1);
 
         VEglDriver::logErrorsEnum("Texture load");
 
-        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        glBindTexture(glTarget, 0);
 
         id = texId;
-        target = GL_TEXTURE_CUBE_MAP;
-    }
-
-    void loadPVR(const VByteArray &buffer, bool useSrgbFormat, bool noMipMaps)
-    {
-        width = 0;
-        height = 0;
-
-        if (buffer.size() < sizeof(PvrHeader)) {
-            vWarn("Invalid PVR file");
-            return;
-        }
-
-        const PvrHeader *header = reinterpret_cast<const PvrHeader *>(buffer.data());
-        if (header->version != 0x03525650) {
-            vWarn("Invalid PVR file version");
-            return;
-        }
-
-        int format = 0;
-        switch (header->pixelFormat) {
-        case 2: format = Texture_PVR4bRGB; break;
-        case 3: format = Texture_PVR4bRGBA; break;
-        case 6: format = Texture_ETC1; break;
-        case 22: format = Texture_ETC2_RGB; break;
-        case 23: format = Texture_ETC2_RGBA; break;
-        case 578721384203708274ull: format = Texture_RGBA; break;
-        default:
-            vWarn("Unknown PVR texture format " << header->pixelFormat << "lu, size " << width << "x" << height);
-            return;
-        }
-
-        // skip the metadata
-        const vuint32 startTex = sizeof(PvrHeader) + header->metaDataSize;
-        if ((startTex < sizeof(PvrHeader)) || (startTex >= buffer.size())) {
-            vWarn("Invalid PVR header sizes");
-            return;
-        }
-
-        const vuint32 mipCount = (noMipMaps) ? 1 : std::max(1u, header->mipMapCount);
-
-        width = header->width;
-        height = header->height;
-
-        const uchar *data = reinterpret_cast<const uchar *>(buffer.data());
-        if (header->numFaces == 1) {
-            create2D(format, data + startTex, buffer.size() - startTex, mipCount, useSrgbFormat, false);
-        } else if (header->numFaces == 6) {
-            createCube(format, data + startTex, buffer.size() - startTex, mipCount, useSrgbFormat, false);
-        } else {
-            vWarn("PVR file has unsupported number of faces " << header->numFaces);
-
-            width = 0;
-            height = 0;
-        }
-    }
-
-    void loadKTX(const VByteArray &buffer, bool useSrgbFormat, bool noMipMaps)
-    {
-        width = 0;
-        height = 0;
-
-        if (buffer.size() < sizeof(KtxHeader)) {
-            vWarn("Invalid KTX file");
-            return;
-        }
-
-        const uchar fileIdentifier[12] = {
-            171, 75, 84, 88, 32, 49, 49, 187, 13, 10, 26, 10
-        };
-
-        const KtxHeader *header = reinterpret_cast<const KtxHeader *>(buffer.data());
-        if (memcmp(header->identifier, fileIdentifier, sizeof(fileIdentifier)) != 0) {
-            vWarn("Invalid KTX file");
-            return;
-        }
-
-        // only support little endian
-        if (header->endianness != 0x04030201) {
-            vWarn("KTX file has wrong endianess");
-            return;
-        }
-
-        // only support compressed or unsigned byte
-        if (header->glType != 0 && header->glType != GL_UNSIGNED_BYTE) {
-            vWarn("KTX file has unsupported glType " << header->glType);
-            return;
-        }
-
-        // no support for texture arrays
-        if (header->numberOfArrayElements != 0) {
-            vWarn("KTX file has unsupported number of array elements " << header->numberOfArrayElements);
-            return;
-        }
-
-        // derive the texture format from the GL format
-        int format = 0;
-        if (!GlFormatToTextureFormat(format, header->glFormat, header->glInternalFormat)) {
-            vWarn("KTX file has unsupported glFormat " << header->glFormat << ", glInternalFormat " << header->glInternalFormat);
-            return;
-        }
-
-        // skip the key value data
-        const uintptr_t startTex = sizeof(KtxHeader) + header->bytesOfKeyValueData;
-        if ((startTex < sizeof(KtxHeader)) || (startTex >= buffer.size())) {
-            vWarn("Invalid KTX header sizes");
-            return;
-        }
-
-        width = header->pixelWidth;
-        height = header->pixelHeight;
-
-        const vuint32 mipCount = noMipMaps ? 1 : std::max(1u, header->numberOfMipmapLevels);
-
-        const uchar *bufferData = reinterpret_cast<const uchar *>(buffer.data());
-        if (header->numberOfFaces == 1) {
-            create2D(format, bufferData + startTex, buffer.size() - startTex, mipCount, useSrgbFormat, true);
-        } else if (header->numberOfFaces == 6) {
-            createCube(format, bufferData + startTex, buffer.size() - startTex, mipCount, useSrgbFormat, true);
-        } else {
-            vWarn("KTX file has unsupported number of faces " << header->numberOfFaces);
-
-            width = 0;
-            height = 0;
-        }
+        target = glTarget;
+        memorySize = container.size();
+        levelCount = container.levelCount();
     }
 };
 
@@ -954,6 +484,8 @@ VTexture::VTexture(const VTexture &source)
     d->target = source.target();
     d->width = source.width();
     d->height = source.height();
+    d->memorySize = source.memorySize();
+    d->levelCount = source.d->levelCount;
 }
 
 VTexture::VTexture(VTexture &&source)
@@ -965,7 +497,7 @@ VTexture::VTexture(VTexture &&source)
 VTexture::VTexture(VFile &file, const Flags &flags)
     : d(new Private)
 {
-    d->load(file.path(), file.readAll(), flags);
+    d->load(file, flags);
 }
 
 VTexture::VTexture(const VResource &resource, const Flags &flags)
@@ -990,7 +522,7 @@ VTexture::~VTexture()
 
 void VTexture::load(VFile &file, const VTexture::Flags &flags)
 {
-    d->load(file.path(), file.readAll(), flags);
+    d->load(file, flags);
 }
 
 void VTexture::load(const VResource &resource, const VTexture::Flags &flags)
@@ -1008,7 +540,14 @@ void VTexture::loadRgba(const uchar *data, int width, int height, bool useSrgb)
     const size_t dataSize = CalculateTextureSize(Texture_RGBA, width, height);
     d->width = width;
     d->height = height;
-    d->create2D(Texture_RGBA, data, dataSize, 1, useSrgb, false);
+    d->create2D(Texture_RGBA, data, dataSize, 1, useSrgb);
+}
+
+void VTexture::loadMipChain(const VMipChain &chain, bool useSrgb)
+{
+    d->width = chain.width();
+    d->height = chain.height();
+    d->create2D(Texture_RGBA, chain.data(), chain.length(), chain.levelCount(), useSrgb);
 }
 
 void VTexture::loadRed(const uchar *data, int width, int height)
@@ -1016,7 +555,7 @@ void VTexture::loadRed(const uchar *data, int width, int height)
     const size_t dataSize = CalculateTextureSize(Texture_R, width, height);
     d->width = width;
     d->height = height;
-    d->create2D(Texture_R, data, dataSize, 1, false, false);
+    d->create2D(Texture_R, data, dataSize, 1, false);
 }
 
 void VTexture::loadAstc(const uchar *data, uint size, int numPlanes)
@@ -1043,7 +582,21 @@ void VTexture::loadAstc(const uchar *data, uint size, int numPlanes)
 
     d->width = ((int) header->xsize[2] << 16) | ((int) header->xsize[1] << 8) | ((int) header->xsize[0]);
     d->height = ((int) header->ysize[2] << 16) | ((int) header->ysize[1] << 8) | ((int) header->ysize[0]);
-    d->create2D(format, data, size, 1, false, false);
+    d->create2D(format, data, size, 1, false);
+}
+
+void VTexture::loadEncoded(const VTextureEncoder &encoder, const VByteArray &blocks, int width, int height, int levelCount, bool useSrgb)
+{
+    TextureFormat format = Texture_ETC2_RGB;
+    if (encoder.format() == VTextureEncoder::Etc2Rgba) {
+        format = Texture_ETC2_RGBA;
+    } else if (encoder.format() == VTextureEncoder::Astc6x6) {
+        format = Texture_ASTC_6x6;
+    }
+
+    d->width = width;
+    d->height = height;
+    d->create2D(format, reinterpret_cast<const uchar *>(blocks.data()), blocks.size(), levelCount, useSrgb);
 }
 
 VTexture &VTexture::operator=(const VTexture &source)
@@ -1052,6 +605,8 @@ VTexture &VTexture::operator=(const VTexture &source)
     d->target = source.target();
     d->width = source.width();
     d->height = source.height();
+    d->memorySize = source.memorySize();
+    d->levelCount = source.d->levelCount;
     return *this;
 }
 
@@ -1083,6 +638,11 @@ int VTexture::height() const
     return d->height;
 }
 
+uint VTexture::memorySize() const
+{
+    return d->memorySize;
+}
+
 void VTexture::clamp()
 {
     glBindTexture(d->target, d->id);
@@ -1126,6 +686,41 @@ void VTexture::buildMipmaps()
     glBindTexture(d->target, d->id);
     glGenerateMipmap(d->target);
     glBindTexture(d->target, 0);
+
+    // The levels below the base come to about a third of it, levels already there are replaced
+    if (d->levelCount == 1) {
+        d->memorySize += d->memorySize / 3;
+    }
+    d->levelCount = 1;
+    for (int size = d->width > d->height ? d->width : d->height; size > 1; size >>= 1) {
+        d->levelCount++;
+    }
+}
+
+unsigned char * LoadPVRBuffer( const char * fileName, int & width, int & height )
+{
+    width = 0;
+    height = 0;
+
+    VTextureContainer container;
+    // callers only use the base level
+    if (!container.load(fileName, 0, 1) || container.type() != VTextureContainer::Pvr || container.glInternalFormat() != GL_RGBA) {
+        vInfo("Invalid PVR file " << fileName);
+        return NULL;
+    }
+
+    const VTextureContainer::Level &level = container.level(0);
+    unsigned char * outBuffer = ( unsigned char * )malloc( level.size );
+    if ( outBuffer == NULL )
+    {
+        vWarn("LoadPVRBuffer: can't allocate " << level.size << " bytes for " << fileName);
+        return NULL;
+    }
+    memcpy( outBuffer, level.data, level.size );
+
+    width = container.width();
+    height = container.height();
+    return outBuffer;
 }
 
 NV_NAMESPACE_END
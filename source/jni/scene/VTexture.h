@@ -6,7 +6,9 @@
 NV_NAMESPACE_BEGIN
 
 class VFile;
+class VMipChain;
 class VResource;
+class VTextureEncoder;
 
 class VTexture
 {
@@ -45,8 +47,12 @@ public:
     void load(const VString &format, const VByteArray &data, const Flags &flags = NoDefault);
 
     void loadRgba(const uchar *data, int width, int height, bool useSrgb = true);
+    //The chain can be built on another thread, only the upload needs the GL context
+    void loadMipChain(const VMipChain &chain, bool useSrgb = true);
     void loadRed(const uchar *data, int width, int height);
     void loadAstc(const uchar *data, uint size, int numPlanes);
+    //Blocks of the encoder, the levels of a width x height image one after another
+    void loadEncoded(const VTextureEncoder &encoder, const VByteArray &blocks, int width, int height, int levelCount = 1, bool useSrgb = true);
 
     VTexture &operator=(const VTexture &source);
     VTexture &operator=(VTexture &&source);
@@ -57,6 +63,8 @@ public:
 
     int width() const;
     int height() const;
+    // Bytes of the levels uploaded, as the formats lay them out
+    uint memorySize() const;
 
     void clamp();
     void clamp(int maxLod);
@@ -68,6 +76,9 @@ public:
 
     void buildMipmaps();
 
+    // Largest levels left out of the KTX and PVR files loaded, for devices short of memory
+    static int skippedMipLevels;
+
 private:
     NV_DECLARE_PRIVATE
 };
@@ -0,0 +1,300 @@
+#include "VTextureCache.h"
+
+#include "VLog.h"
+#include "VMap.h"
+
+#include <algorithm>
+#include <utility>
+
+NV_NAMESPACE_BEGIN
+
+VTextureCache::Texture::Texture()
+    : id(0)
+    , target(0)
+    , width(0)
+    , height(0)
+    , size(0)
+{
+}
+
+VTextureCache::Stats::Stats()
+    : textures(0)
+    , resident(0)
+    , residentBytes(0)
+    , maxResidentBytes(0)
+    , budget(0)
+    , hits(0)
+    , misses(0)
+    , evictions(0)
+    , failures(0)
+    , loadedBytes(0)
+    , evictedBytes(0)
+    , frames(0)
+    , totalHits(0)
+    , totalMisses(0)
+    , totalEvictions(0)
+{
+}
+
+double VTextureCache::Stats::hitRate() const
+{
+    const int requests = hits + misses;
+    return requests > 0 ? (double) hits / requests : 1.0;
+}
+
+struct VTextureCache::Private
+{
+    struct Entry
+    {
+        VString path;
+        VTexture::Flags flags;
+        Texture texture;
+        bool resident;
+        bool failed;
+        //Frame it was last asked for
+        int frame;
+        //Resident ones, most recently used first
+        Entry *newer;
+        Entry *older;
+
+        Entry(const VString &path, const VTexture::Flags &flags)
+            : path(path)
+            , flags(flags)
+            , resident(false)
+            , failed(false)
+            , frame(-1)
+            , newer(nullptr)
+            , older(nullptr)
+        {
+        }
+    };
+
+    typedef std::pair<VString, int> Key;
+
+    Loader *loader;
+    vuint64 budget;
+    VMap<Key, Entry *> entries;
+    Entry *newest;
+    Entry *oldest;
+    int frame;
+
+    //Totals and the last frame ended
+    Stats stats;
+    //Of the frame going on
+    Stats current;
+
+    Private(Loader *loader, vuint64 budget)
+        : loader(loader)
+        , budget(budget)
+        , newest(nullptr)
+        , oldest(nullptr)
+        , frame(0)
+    {
+    }
+
+    Entry *find(const VString &path, const VTexture::Flags &flags) const
+    {
+        VMap<Key, Entry *>::ConstIterator entry = entries.find(Key(path, flags));
+        return entry != entries.end() ? entry->second : nullptr;
+    }
+
+    void unlink(Entry *entry)
+    {
+        if (entry->newer) {
+            entry->newer->older = entry->older;
+        } else {
+            newest = entry->older;
+        }
+        if (entry->older) {
+            entry->older->newer = entry->newer;
+        } else {
+            oldest = entry->newer;
+        }
+        entry->newer = nullptr;
+        entry->older = nullptr;
+    }
+
+    void pushNewest(Entry *entry)
+    {
+        entry->older = newest;
+        entry->newer = nullptr;
+        if (newest) {
+            newest->newer = entry;
+        } else {
+            oldest = entry;
+        }
+        newest = entry;
+    }
+
+    void destroy(Entry *entry)
+    {
+        if (!entry->resident) {
+            return;
+        }
+        unlink(entry);
+        loader->destroy(entry->texture);
+        entry->resident = false;
+        entry->texture.id = 0;
+        stats.residentBytes -= entry->texture.size;
+        stats.resident--;
+    }
+
+    //The least recently used, until size bytes more fit the budget. The textures of the
+    //current frame stay, they are the most recent ones.
+    void evict(uint size)
+    {
+        if (budget == 0) {
+            return;
+        }
+        while (oldest && oldest->frame != frame && stats.residentBytes + size > budget) {
+            Entry *entry = oldest;
+            current.evictedBytes += entry->texture.size;
+            current.evictions++;
+            destroy(entry);
+        }
+    }
+
+    void load(Entry *entry)
+    {
+        //Sized from the last time it was resident, room can be made before loading
+        evict(entry->texture.size);
+
+        Texture texture;
+        if (!loader->load(entry->path, entry->flags, texture) || texture.id == 0) {
+            vWarn("VTextureCache: failed to load " << entry->path);
+            entry->failed = true;
+            entry->texture = Texture();
+            current.failures++;
+            return;
+        }
+        entry->texture = texture;
+        entry->resident = true;
+        pushNewest(entry);
+        stats.resident++;
+        stats.residentBytes += texture.size;
+        current.loadedBytes += texture.size;
+
+        //The new texture is of the current frame, only older ones go
+        evict(0);
+        stats.maxResidentBytes = std::max(stats.maxResidentBytes, stats.residentBytes);
+    }
+};
+
+VTextureCache::VTextureCache(Loader *loader, vuint64 budget)
+    : d(new Private(loader, budget))
+{
+}
+
+VTextureCache::~VTextureCache()
+{
+    clear();
+    delete d->loader;
+    delete d;
+}
+
+VTextureCache::Texture VTextureCache::texture(const VString &path, const VTexture::Flags &flags)
+{
+    Private::Entry *entry = d->find(path, flags);
+    if (entry == nullptr) {
+        entry = new Private::Entry(path, flags);
+        d->entries.insert(Private::Key(path, flags), entry);
+    }
+    entry->frame = d->frame;
+
+    if (entry->resident) {
+        d->current.hits++;
+        d->unlink(entry);
+        d->pushNewest(entry);
+    } else {
+        d->current.misses++;
+        if (!entry->failed) {
+            d->load(entry);
+        }
+    }
+    return entry->texture;
+}
+
+bool VTextureCache::contains(const VString &path, const VTexture::Flags &flags) const
+{
+    return d->find(path, flags) != nullptr;
+}
+
+bool VTextureCache::isResident(const VString &path, const VTexture::Flags &flags) const
+{
+    const Private::Entry *entry = d->find(path, flags);
+    return entry && entry->resident;
+}
+
+void VTextureCache::remove(const VString &path, const VTexture::Flags &flags)
+{
+    Private::Entry *entry = d->find(path, flags);
+    if (entry) {
+        d->destroy(entry);
+        d->entries.remove(Private::Key(path, flags));
+        delete entry;
+    }
+}
+
+void VTextureCache::evictAll()
+{
+    while (d->oldest) {
+        d->current.evictedBytes += d->oldest->texture.size;
+        d->current.evictions++;
+        d->destroy(d->oldest);
+    }
+}
+
+void VTextureCache::clear()
+{
+    for (const auto &entry : d->entries) {
+        d->destroy(entry.second);
+        delete entry.second;
+    }
+    d->entries.clear();
+}
+
+vuint64 VTextureCache::budget() const
+{
+    return d->budget;
+}
+
+void VTextureCache::setBudget(vuint64 budget)
+{
+    d->budget = budget;
+}
+
+void VTextureCache::update()
+{
+    //Nothing is drawn with the textures of the frame ended any more
+    d->frame++;
+    d->evict(0);
+
+    Stats &stats = d->stats;
+    const Stats &current = d->current;
+    stats.hits = current.hits;
+    stats.misses = current.misses;
+    stats.evictions = current.evictions;
+    stats.failures = current.failures;
+    stats.loadedBytes = current.loadedBytes;
+    stats.evictedBytes = current.evictedBytes;
+    stats.totalHits += current.hits;
+    stats.totalMisses += current.misses;
+    stats.totalEvictions += current.evictions;
+    stats.frames++;
+    d->current = Stats();
+}
+
+VTextureCache::Stats VTextureCache::stats() const
+{
+    Stats stats = d->stats;
+    stats.textures = d->entries.size();
+    stats.budget = d->budget;
+    return stats;
+}
+
+VTextureCache::Loader *VTextureCache::loader() const
+{
+    return d->loader;
+}
+
+NV_NAMESPACE_END
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "VTexture.h"
+
+NV_NAMESPACE_BEGIN
+
+// Owns the textures loaded from files and keeps the GPU memory they take within a budget. Each
+// texture is accounted at the bytes of the levels uploaded. When the resident ones go over the
+// budget, the least recently used are destroyed and loaded again from their path the next time
+// they are asked for. The textures asked for since the last update() are never evicted, so the
+// ids given out stay valid for the frame drawing them.
+//
+// Used from the render thread. The GL side is a Loader, so the accounting can run against a
+// recording one without a context.
+class VTextureCache
+{
+public:
+    struct Texture
+    {
+        Texture();
+
+        uint id;
+        uint target;
+        int width;
+        int height;
+        // Of every level and face uploaded
+        uint size;
+    };
+
+    class Loader
+    {
+    public:
+        virtual ~Loader() {}
+
+        // Returns false on failure
+        virtual bool load(const VString &path, const VTexture::Flags &flags, Texture &texture) = 0;
+        virtual void destroy(const Texture &texture) = 0;
+    };
+
+    struct Stats
+    {
+        Stats();
+
+        // Known, resident or not
+        int textures;
+        int resident;
+        vuint64 residentBytes;
+        vuint64 maxResidentBytes;
+        vuint64 budget;
+
+        // Of the last frame update() ended
+        int hits;
+        int misses;
+        int evictions;
+        int failures;
+        vuint64 loadedBytes;
+        vuint64 evictedBytes;
+
+        // Since the cache was created
+        int frames;
+        vuint64 totalHits;
+        vuint64 totalMisses;
+        vuint64 totalEvictions;
+
+        // Hits out of the textures asked for in the last frame, 1 if none were
+        double hitRate() const;
+    };
+
+    // Takes ownership of loader. A budget of 0 is no limit.
+    explicit VTextureCache(Loader *loader, vuint64 budget = 0);
+    // Destroys the textures resident
+    ~VTextureCache();
+
+    // Loads the texture on a miss, evicting what is over the budget first. A texture that
+    // failed to load has an id of 0 and is not tried again until it is removed.
+    Texture texture(const VString &path, const VTexture::Flags &flags = VTexture::NoDefault);
+    bool contains(const VString &path, const VTexture::Flags &flags = VTexture::NoDefault) const;
+    bool isResident(const VString &path, const VTexture::Flags &flags = VTexture::NoDefault) const;
+
+    // Destroys the texture and forgets it
+    void remove(const VString &path, const VTexture::Flags &flags = VTexture::NoDefault);
+    // Destroys every texture resident, they load again when asked for
+    void evictAll();
+    void clear();
+
+    vuint64 budget() const;
+    // Evicts down to the new budget on the next update()
+    void setBudget(vuint64 budget);
+
+    // Once a frame: ends the stats of the frame and evicts what is over the budget, now that
+    // the textures of the frame are no longer drawn
+    void update();
+
+    Stats stats() const;
+    Loader *loader() const;
+
+private:
+    NV_DECLARE_PRIVATE
+    NV_DISABLE_COPY(VTextureCache)
+};
+
+NV_NAMESPACE_END
@@ -0,0 +1,712 @@
+#include "VTextureStreamer.h"
+
+#include "VFile.h"
+#include "VImage.h"
+#include "VLog.h"
+#include "VMutex.h"
+#include "VPath.h"
+#include "VTaskScheduler.h"
+#include "VTextureContainer.h"
+#include "VThread.h"
+#include "VTimer.h"
+#include "VWaitCondition.h"
+
+#include <algorithm>
+#include <atomic>
+
+NV_NAMESPACE_BEGIN
+
+namespace {
+
+// The GL enums of the images decoded, without including the GL headers
+enum
+{
+    GL_TEXTURE_2D = 0x0DE1,
+    GL_UNSIGNED_BYTE = 0x1401,
+    GL_RGBA = 0x1908,
+    GL_SRGB8_ALPHA8 = 0x8C43
+};
+
+// The levels are kept as offsets of data, which image holds on to
+bool ParseContainer(const uchar *data, uint size, const VTexture::Flags &flags, VTextureStreamer::Image &image)
+{
+    VTextureContainer container;
+    if (!container.parse(data, size, VTexture::skippedMipLevels, (flags & VTexture::NoMipmaps) ? 1 : 0)) {
+        return false;
+    }
+    image.target = container.glTarget();
+    image.format = container.glFormat();
+    image.internalFormat = container.glInternalFormat(flags & VTexture::UseSRGB);
+    image.type = container.glType();
+    image.width = container.width();
+    image.height = container.height();
+    image.levelCount = container.levelCount();
+    for (const VTextureContainer::Level &level : container.levels()) {
+        VTextureStreamer::Image::Level span = {level.level, level.face, level.width, level.height, (uint) (level.data - data), level.size};
+        image.levels.append(span);
+    }
+    return true;
+}
+
+// Until uploads are measured, about the slowest of mobile GPUs
+const double InitialBytesPerSecond = 256.0 * 1024 * 1024;
+
+bool IsContainer(const VString &ext)
+{
+    return ext == "ktx" || ext == "pvr";
+}
+
+VString FormatOf(const VString &path)
+{
+    VString ext = VPath(path).extension();
+    if (ext.isEmpty()) {
+        ext = path;
+    }
+    return ext.toLower();
+}
+
+// Parses a container in place, data is kept by image, or decodes an image into its mip chain
+bool Parse(const VString &ext, const uchar *data, uint size, const VTexture::Flags &flags, VTextureStreamer::Image &image)
+{
+    if (ext.isEmpty() || size == 0) {
+        return false;
+    }
+
+    if (IsContainer(ext)) {
+        return ParseContainer(data, size, flags, image);
+    } else if (ext == "jpg" || ext == "tga" || ext == "png" || ext == "bmp"
+               || ext == "psd" || ext == "gif" || ext == "hdr" || ext == "pic") {
+        VImage decoded;
+        if (!decoded.load(data, size)) {
+            return false;
+        }
+        const bool srgb = flags & VTexture::UseSRGB;
+        if (flags & VTexture::NoMipmaps) {
+            image.bytes = VByteArray(reinterpret_cast<const char *>(decoded.data()), decoded.length());
+            image.target = GL_TEXTURE_2D;
+            image.format = GL_RGBA;
+            image.internalFormat = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA;
+            image.type = GL_UNSIGNED_BYTE;
+            image.width = decoded.width();
+            image.height = decoded.height();
+            image.levelCount = 1;
+            VTextureStreamer::Image::Level level = {0, 0, image.width, image.height, 0, decoded.length()};
+            image.levels.append(level);
+        } else {
+            VMipChain chain;
+            decoded.buildMipChain(chain, srgb);
+            image.setMipChain(std::move(chain), srgb);
+        }
+        return true;
+    }
+
+    vWarn("unsupported file extension " << ext);
+    return false;
+}
+
+}
+
+VTextureStreamer::Image::Image()
+    : target(GL_TEXTURE_2D)
+    , format(0)
+    , internalFormat(0)
+    , type(0)
+    , width(0)
+    , height(0)
+    , levelCount(0)
+{
+}
+
+const uchar *VTextureStreamer::Image::data() const
+{
+    if (!mipChain.isEmpty()) {
+        return mipChain.data();
+    }
+    if (!bytes.empty()) {
+        return reinterpret_cast<const uchar *>(bytes.data());
+    }
+    return view.bytes();
+}
+
+uint VTextureStreamer::Image::size() const
+{
+    uint total = 0;
+    for (const Level &level : levels) {
+        total += level.size;
+    }
+    return total;
+}
+
+void VTextureStreamer::Image::setMipChain(VMipChain &&chain, bool srgb)
+{
+    mipChain = std::move(chain);
+    target = GL_TEXTURE_2D;
+    format = GL_RGBA;
+    internalFormat = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA;
+    type = GL_UNSIGNED_BYTE;
+    width = mipChain.width();
+    height = mipChain.height();
+    levelCount = mipChain.levelCount();
+    levels.clear();
+    for (int i = 0; i < levelCount; i++) {
+        Level level = {i, 0, mipChain.width(i), mipChain.height(i), mipChain.offset(i), mipChain.levelLength(i)};
+        levels.append(level);
+    }
+}
+
+bool VTextureStreamer::Decode(const VString &path, const VTexture::Flags &flags, Image &image)
+{
+    VFile file(path, VFile::ReadOnly);
+    VMappedView view = file.map();
+    VByteArray bytes;
+    if (view.isNull()) {
+        bytes = file.readAll();
+    }
+
+    const VString ext = FormatOf(path);
+    bool parsed;
+    if (IsContainer(ext)) {
+        // Uploaded straight from the mapping
+        image.view = std::move(view);
+        image.bytes = std::move(bytes);
+        parsed = Parse(ext, image.data(), image.view.isNull() ? image.bytes.size() : image.view.size(), flags, image);
+    } else if (view.isNull()) {
+        parsed = Parse(ext, reinterpret_cast<const uchar *>(bytes.data()), bytes.size(), flags, image);
+    } else {
+        parsed = Parse(ext, view.bytes(), view.size(), flags, image);
+    }
+    if (!parsed) {
+        vWarn("Failed to load " << path);
+    }
+    return parsed;
+}
+
+bool VTextureStreamer::Decode(const VString &format, const uchar *data, uint size, const VTexture::Flags &flags, Image &image)
+{
+    const VString ext = FormatOf(format);
+    if (IsContainer(ext)) {
+        image.bytes = VByteArray(reinterpret_cast<const char *>(data), size);
+        data = image.data();
+    }
+    return Parse(ext, data, size, flags, image);
+}
+
+struct VTextureStreamer::Handle::Node
+{
+    //Held by the handles and by the streamer until the texture is ready
+    std::atomic<int> ref;
+    std::atomic<int> state;
+    uint placeholder;
+    uint id;
+    uint target;
+    int width;
+    int height;
+
+    Node(uint placeholder)
+        : ref(1)
+        , state(Loading)
+        , placeholder(placeholder)
+        , id(0)
+        , target(GL_TEXTURE_2D)
+        , width(0)
+        , height(0)
+    {
+    }
+
+    void acquire() { ref.fetch_add(1, std::memory_order_relaxed); }
+
+    void release()
+    {
+        if (ref.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    //Only the streamer still holds it
+    bool isAbandoned() const { return ref.load(std::memory_order_acquire) == 1; }
+};
+
+VTextureStreamer::Handle::Handle(const Handle &source)
+    : m_node(source.m_node)
+{
+    if (m_node) {
+        m_node->acquire();
+    }
+}
+
+VTextureStreamer::Handle::~Handle()
+{
+    if (m_node) {
+        m_node->release();
+    }
+}
+
+VTextureStreamer::Handle &VTextureStreamer::Handle::operator = (const Handle &source)
+{
+    if (source.m_node) {
+        source.m_node->acquire();
+    }
+    if (m_node) {
+        m_node->release();
+    }
+    m_node = source.m_node;
+    return *this;
+}
+
+VTextureStreamer::Handle &VTextureStreamer::Handle::operator = (Handle &&source)
+{
+    std::swap(m_node, source.m_node);
+    return *this;
+}
+
+VTextureStreamer::Handle::State VTextureStreamer::Handle::state() const
+{
+    return m_node ? static_cast<State>(m_node->state.load(std::memory_order_acquire)) : Failed;
+}
+
+uint VTextureStreamer::Handle::id() const
+{
+    if (m_node == nullptr) {
+        return 0;
+    }
+    return isReady() ? m_node->id : m_node->placeholder;
+}
+
+uint VTextureStreamer::Handle::target() const
+{
+    return isReady() ? m_node->target : (uint) GL_TEXTURE_2D;
+}
+
+int VTextureStreamer::Handle::width() const
+{
+    return isReady() ? m_node->width : 0;
+}
+
+int VTextureStreamer::Handle::height() const
+{
+    return isReady() ? m_node->height : 0;
+}
+
+VTextureStreamer::Settings::Settings()
+    : bytesPerFrame(4 * 1024 * 1024)
+    , secondsPerFrame(0.002)
+    , maxDecoding(4)
+    , loaderThread(false)
+    , scheduler(nullptr)
+{
+}
+
+VTextureStreamer::Stats::Stats()
+    : loading(0)
+    , ready(0)
+    , failed(0)
+    , canceled(0)
+    , frames(0)
+    , bytesUploaded(0)
+    , lastFrameBytes(0)
+    , maxFrameBytes(0)
+    , lastFrameSeconds(0.0)
+    , maxFrameSeconds(0.0)
+{
+}
+
+struct VTextureStreamer::Private
+{
+    struct Job
+    {
+        Handle handle;
+        Decoder decoder;
+        Image image;
+        VTaskScheduler::Task task;
+
+        uint texture;
+        // The next rows to upload
+        uint level;
+        int row;
+        Uploader::Fence fence;
+        bool canceled;
+
+        Job(Handle::Node *node, const Decoder &decoder)
+            : handle(node)
+            , decoder(decoder)
+            , texture(0)
+            , level(0)
+            , row(0)
+            , fence(nullptr)
+            , canceled(false)
+        {
+        }
+    };
+
+    Uploader *uploader;
+    Settings settings;
+    VTaskScheduler *scheduler;
+
+    //Render thread only, every job not done yet and the ones not decoding yet
+    VArray<Job *> jobs;
+    VArray<Job *> queued;
+    //Decoding or waiting for their upload to finish
+    std::atomic<int> inFlight;
+
+    //Guards decoded, uploaded and stats
+    VMutex mutex;
+    VArray<Job *> decoded;
+    //Waiting for their fences, or failed without one
+    VArray<Job *> uploaded;
+    Stats stats;
+
+    //Upload thread only
+    Job *current;
+    //Measured, to split levels to fit secondsPerFrame
+    double bytesPerSecond;
+
+    VThread *thread;
+    VWaitCondition frameCondition;
+    bool frame;
+    bool quit;
+
+    Private(Uploader *uploader, const Settings &settings)
+        : uploader(uploader)
+        , settings(settings)
+        , scheduler(settings.scheduler ? settings.scheduler : VTaskScheduler::instance())
+        , inFlight(0)
+        , current(nullptr)
+        , bytesPerSecond(InitialBytesPerSecond)
+        , thread(nullptr)
+        , frame(false)
+        , quit(false)
+    {
+    }
+
+    Handle load(const Decoder &decoder, uint placeholder)
+    {
+        Handle::Node *node = new Handle::Node(placeholder);
+        Handle handle(node);
+        node->acquire();
+        Job *job = new Job(node, decoder);
+        jobs.append(job);
+        queued.append(job);
+        dispatch();
+        return handle;
+    }
+
+    void dispatch()
+    {
+        while (!queued.isEmpty() && inFlight.load(std::memory_order_acquire) < settings.maxDecoding) {
+            Job *job = queued.first();
+            queued.removeFirst();
+            if (job->handle.m_node->isAbandoned()) {
+                job->canceled = true;
+                done(job);
+                continue;
+            }
+            inFlight.fetch_add(1, std::memory_order_relaxed);
+            job->task = scheduler->spawn([this, job]() {
+                const bool ok = job->decoder(job->image) && !job->image.levels.isEmpty();
+                VMutex::Locker locker(&mutex);
+                if (ok) {
+                    decoded.append(job);
+                } else {
+                    job->image = Image();
+                    uploaded.append(job);
+                    inFlight.fetch_sub(1, std::memory_order_release);
+                }
+            }, VTaskScheduler::BackgroundPriority);
+        }
+    }
+
+    // The upload of the job is over, the render thread takes it from here
+    void uploadDone(Job *job)
+    {
+        if (job->fence == nullptr && !job->canceled) {
+            vWarn("VTextureStreamer: failed to upload a texture");
+        }
+        Handle::Node *node = job->handle.m_node;
+        node->target = job->image.target;
+        node->width = job->image.width;
+        node->height = job->image.height;
+        job->image = Image();
+        current = nullptr;
+
+        VMutex::Locker locker(&mutex);
+        uploaded.append(job);
+        inFlight.fetch_sub(1, std::memory_order_release);
+    }
+
+    // A frame's worth of uploads, on the thread uploading
+    void uploadFrame()
+    {
+        const double start = VTimer::Seconds();
+        const uint budget = settings.bytesPerFrame;
+        uint bytes = 0;
+        int chunks = 0;
+        for (;;) {
+            if (current == nullptr) {
+                VMutex::Locker locker(&mutex);
+                if (decoded.isEmpty()) {
+                    break;
+                }
+                current = decoded.first();
+                decoded.removeFirst();
+            }
+
+            Job *job = current;
+            if (job->handle.m_node->isAbandoned()) {
+                job->canceled = true;
+                uploadDone(job);
+                continue;
+            }
+
+            const Image &image = job->image;
+            if (job->texture == 0) {
+                job->texture = uploader->create(image);
+                if (job->texture == 0) {
+                    uploadDone(job);
+                    continue;
+                }
+            }
+
+            const Image::Level &level = image.levels[job->level];
+            int rows = level.height - job->row;
+            uint chunkBytes = level.size;
+            if (!image.isCompressed()) {
+                //Split uncompressed levels into rows to fit what is left of the budget
+                const uint rowBytes = level.size / level.height;
+                double allowed = rows * (double) rowBytes;
+                if (budget > 0) {
+                    allowed = std::min(allowed, budget > bytes ? (double) (budget - bytes) : 0.0);
+                }
+                if (settings.secondsPerFrame > 0.0) {
+                    const double left = settings.secondsPerFrame - (VTimer::Seconds() - start);
+                    allowed = std::min(allowed, std::max(left, 0.0) * bytesPerSecond);
+                }
+                rows = std::min(rows, (int) (allowed / rowBytes));
+                if (rows == 0) {
+                    if (chunks > 0) {
+                        break;
+                    }
+                    rows = 1;
+                }
+                chunkBytes = rows * rowBytes;
+            } else if (budget > 0 && chunks > 0 && bytes + chunkBytes > budget) {
+                break;
+            }
+
+            const double chunkStart = VTimer::Seconds();
+            uploader->upload(job->texture, image, level, job->row, rows);
+            const double chunkSeconds = VTimer::Seconds() - chunkStart;
+            bytes += chunkBytes;
+            chunks++;
+            //Too small a chunk mostly measures the call
+            if (chunkBytes >= 64 * 1024 && chunkSeconds > 0.0) {
+                bytesPerSecond = bytesPerSecond * 0.75 + chunkBytes / chunkSeconds * 0.25;
+            }
+
+            job->row += rows;
+            if (job->row == level.height) {
+                job->row = 0;
+                job->level++;
+                if (job->level == image.levels.size()) {
+                    job->fence = uploader->finish(job->texture, image);
+                    uploadDone(job);
+                }
+            }
+
+            if (settings.secondsPerFrame > 0.0 && VTimer::Seconds() - start >= settings.secondsPerFrame) {
+                break;
+            }
+        }
+
+        const double seconds = VTimer::Seconds() - start;
+        VMutex::Locker locker(&mutex);
+        stats.frames++;
+        stats.bytesUploaded += bytes;
+        stats.lastFrameBytes = bytes;
+        stats.maxFrameBytes = std::max(stats.maxFrameBytes, bytes);
+        stats.lastFrameSeconds = seconds;
+        stats.maxFrameSeconds = std::max(stats.maxFrameSeconds, seconds);
+    }
+
+    // Render thread, the job is ready, failed or canceled
+    void done(Job *job)
+    {
+        Handle::Node *node = job->handle.m_node;
+        if (job->fence) {
+            uploader->release(job->fence);
+        }
+        const bool canceled = job->canceled || node->isAbandoned();
+        const bool ready = job->fence && !canceled;
+        if (ready) {
+            node->id = job->texture;
+            node->state.store(Handle::Ready, std::memory_order_release);
+        } else {
+            if (job->texture) {
+                uploader->destroy(job->texture);
+            }
+            node->state.store(Handle::Failed, std::memory_order_release);
+        }
+
+        {
+            VMutex::Locker locker(&mutex);
+            if (ready) {
+                stats.ready++;
+            } else if (canceled) {
+                stats.canceled++;
+            } else {
+                stats.failed++;
+            }
+        }
+        jobs.removeOne(job);
+        delete job;
+    }
+
+    void resolve()
+    {
+        VArray<Job *> pending;
+        {
+            VMutex::Locker locker(&mutex);
+            pending.swap(uploaded);
+        }
+
+        VArray<Job *> waiting;
+        for (Job *job : pending) {
+            if (job->fence && !uploader->isSignaled(job->fence)) {
+                waiting.append(job);
+            } else {
+                done(job);
+            }
+        }
+
+        if (!waiting.isEmpty()) {
+            VMutex::Locker locker(&mutex);
+            waiting.append(uploaded);
+            uploaded.swap(waiting);
+        }
+    }
+
+    static int LoaderThread(void *data)
+    {
+        Private *d = static_cast<Private *>(data);
+        d->uploader->attach();
+        for (;;) {
+            {
+                VMutex::Locker locker(&d->mutex);
+                while (!d->quit && !d->frame) {
+                    d->frameCondition.wait(&d->mutex);
+                }
+                if (d->quit) {
+                    break;
+                }
+                d->frame = false;
+            }
+            d->uploadFrame();
+        }
+        d->uploader->detach();
+        return 0;
+    }
+};
+
+VTextureStreamer::VTextureStreamer(Uploader *uploader, const Settings &settings)
+    : d(new Private(uploader, settings))
+{
+    if (settings.loaderThread) {
+        d->thread = new VThread(&Private::LoaderThread, d);
+        d->thread->setName("TextureLoader");
+        d->thread->setPriority(VThread::BelowNormalPriority);
+        d->thread->start();
+    } else {
+        uploader->attach();
+    }
+}
+
+VTextureStreamer::~VTextureStreamer()
+{
+    if (d->thread) {
+        {
+            VMutex::Locker locker(&d->mutex);
+            d->quit = true;
+            d->frameCondition.notify();
+        }
+        d->thread->wait();
+        delete d->thread;
+    } else {
+        d->uploader->detach();
+    }
+
+    //The textures not handed over are deleted from the render thread, which shares them
+    for (Private::Job *job : d->jobs) {
+        if (!job->task.isNull()) {
+            d->scheduler->wait(job->task);
+        }
+    }
+    for (Private::Job *job : d->jobs) {
+        if (job->fence) {
+            d->uploader->release(job->fence);
+        }
+        if (job->texture) {
+            d->uploader->destroy(job->texture);
+        }
+        job->handle.m_node->state.store(Handle::Failed, std::memory_order_release);
+        delete job;
+    }
+
+    delete d->uploader;
+    delete d;
+}
+
+VTextureStreamer::Handle VTextureStreamer::load(const VString &path, const VTexture::Flags &flags, uint placeholder)
+{
+    return d->load([path, flags](Image &image) {
+        return Decode(path, flags, image);
+    }, placeholder);
+}
+
+VTextureStreamer::Handle VTextureStreamer::load(const VString &format, const VByteArray &data, const VTexture::Flags &flags, uint placeholder)
+{
+    return d->load([format, data, flags](Image &image) {
+        return Decode(format, reinterpret_cast<const uchar *>(data.data()), data.size(), flags, image);
+    }, placeholder);
+}
+
+VTextureStreamer::Handle VTextureStreamer::load(const Decoder &decoder, uint placeholder)
+{
+    return d->load(decoder, placeholder);
+}
+
+void VTextureStreamer::update()
+{
+    d->resolve();
+    d->dispatch();
+    if (d->thread) {
+        VMutex::Locker locker(&d->mutex);
+        d->frame = true;
+        d->frameCondition.notify();
+    } else {
+        d->uploadFrame();
+    }
+}
+
+bool VTextureStreamer::isIdle() const
+{
+    return d->jobs.isEmpty();
+}
+
+VTextureStreamer::Stats VTextureStreamer::stats() const
+{
+    VMutex::Locker locker(&d->mutex);
+    Stats stats = d->stats;
+    stats.loading = d->jobs.size();
+    return stats;
+}
+
+const VTextureStreamer::Settings &VTextureStreamer::settings() const
+{
+    return d->settings;
+}
+
+VTextureStreamer::Uploader *VTextureStreamer::uploader() const
+{
+    return d->uploader;
+}
+
+NV_NAMESPACE_END
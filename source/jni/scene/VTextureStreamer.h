@@ -0,0 +1,194 @@
+#pragma once
+
+#include "VArray.h"
+#include "VByteArray.h"
+#include "VMappedView.h"
+#include "VMipChain.h"
+#include "VTexture.h"
+
+#include <functional>
+
+NV_NAMESPACE_BEGIN
+
+class VTaskScheduler;
+
+// Loads textures without stalling the frame. Files are read and decoded on the workers of
+// VTaskScheduler, then uploaded a level or a few rows at a time, at most bytesPerFrame and
+// secondsPerFrame each frame, on a loader thread with its own context or on the thread calling
+// update(). A texture is handed over once the fence behind its uploads has signaled, which
+// update() polls without waiting. Until then its handle gives the placeholder.
+//
+// load(), update() and the destructor are called from the render thread. The GL side is an
+// Uploader, so the scheduling can run against a recording one without a context.
+class VTextureStreamer
+{
+public:
+    // What a texture is uploaded from, decoded on a worker. The GL enums are kept as they are
+    // passed to glTexImage2D() and glCompressedTexImage2D().
+    struct Image
+    {
+        Image();
+
+        struct Level
+        {
+            int level;
+            // 0 to 5 for the faces of a cube map
+            int face;
+            int width;
+            int height;
+            // From data()
+            uint offset;
+            uint size;
+        };
+
+        uint target;
+        uint format;
+        uint internalFormat;
+        // 0 for compressed formats
+        uint type;
+        int width;
+        int height;
+        int levelCount;
+        VArray<Level> levels;
+
+        // Levels decoded into a mip chain, or straight from a mapped or loaded container
+        VMipChain mipChain;
+        VMappedView view;
+        VByteArray bytes;
+
+        bool isCompressed() const { return type == 0; }
+        const uchar *data() const;
+        uint size() const;
+
+        // RGBA levels of chain
+        void setMipChain(VMipChain &&chain, bool srgb);
+    };
+
+    // Decodes a file or buffer in jpg, png or another format of stb_image, ktx or pvr. Images
+    // are decoded to RGBA with their mip levels built unless flags has NoMipmaps. Containers
+    // leave out the largest VTexture::skippedMipLevels, as VTexture does.
+    static bool Decode(const VString &path, const VTexture::Flags &flags, Image &image);
+    static bool Decode(const VString &format, const uchar *data, uint size, const VTexture::Flags &flags, Image &image);
+
+    // Calls to the GL, all but isSignaled() on the thread uploading
+    class Uploader
+    {
+    public:
+        typedef void *Fence;
+
+        virtual ~Uploader() {}
+
+        // On the thread uploading before the first call and after the last one
+        virtual void attach() {}
+        virtual void detach() {}
+
+        // Returns 0 on failure
+        virtual uint create(const Image &image) = 0;
+        // Rows [y, y + height) of the level. Compressed levels are uploaded whole.
+        virtual void upload(uint texture, const Image &image, const Image::Level &level, int y, int height) = 0;
+        // After the last level, returns the fence signaled once the uploads completed
+        virtual Fence finish(uint texture, const Image &image) = 0;
+        // Called by update(), mustn't block
+        virtual bool isSignaled(Fence fence) = 0;
+        virtual void release(Fence fence) = 0;
+        virtual void destroy(uint texture) = 0;
+    };
+
+    class Handle
+    {
+    public:
+        enum State
+        {
+            Loading,
+            Ready,
+            Failed
+        };
+
+        Handle() : m_node(nullptr) {}
+        Handle(const Handle &source);
+        Handle(Handle &&source) : m_node(source.m_node) { source.m_node = nullptr; }
+        ~Handle();
+
+        Handle &operator = (const Handle &source);
+        Handle &operator = (Handle &&source);
+
+        bool isNull() const { return m_node == nullptr; }
+        State state() const;
+        bool isReady() const { return state() == Ready; }
+
+        // The placeholder until the texture is ready
+        uint id() const;
+        uint target() const;
+        int width() const;
+        int height() const;
+
+        struct Node;
+
+    private:
+        friend class VTextureStreamer;
+        explicit Handle(Node *node) : m_node(node) {}
+        Node *m_node;
+    };
+
+    typedef std::function<bool(Image &image)> Decoder;
+
+    struct Settings
+    {
+        Settings();
+
+        // Uploaded each frame at most, 0 for no limit. The first upload of a frame goes ahead
+        // either way so that a level larger than the budget is still uploaded.
+        uint bytesPerFrame;
+        double secondsPerFrame;
+        // Decoded images waiting for their upload take memory, no more than this many are
+        // decoding or waiting at a time
+        int maxDecoding;
+        // Upload on a thread of its own, otherwise update() uploads
+        bool loaderThread;
+        // VTaskScheduler::instance() if null
+        VTaskScheduler *scheduler;
+    };
+
+    struct Stats
+    {
+        Stats();
+
+        int loading;
+        int ready;
+        int failed;
+        // Released before they were ready
+        int canceled;
+
+        int frames;
+        vuint64 bytesUploaded;
+        uint lastFrameBytes;
+        uint maxFrameBytes;
+        double lastFrameSeconds;
+        double maxFrameSeconds;
+    };
+
+    // Takes ownership of uploader
+    explicit VTextureStreamer(Uploader *uploader, const Settings &settings = Settings());
+    ~VTextureStreamer();
+
+    Handle load(const VString &path, const VTexture::Flags &flags = VTexture::NoDefault, uint placeholder = 0);
+    Handle load(const VString &format, const VByteArray &data, const VTexture::Flags &flags = VTexture::NoDefault, uint placeholder = 0);
+    Handle load(const Decoder &decoder, uint placeholder = 0);
+
+    // Once a frame: hands over the textures whose fences signaled, starts decoding the next
+    // ones and lets a frame's budget be uploaded
+    void update();
+
+    // Nothing loading
+    bool isIdle() const;
+    Stats stats() const;
+
+    const Settings &settings() const;
+    Uploader *uploader() const;
+
+private:
+    NV_DECLARE_PRIVATE
+    NV_DISABLE_COPY(VTextureStreamer)
+};
+
+NV_NAMESPACE_END
@@ -0,0 +1,272 @@
+#include "test.h"
+
+#include <VBuffer.h>
+#include <VByteArray.h>
+#include <VDistortionMesh.h>
+
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+
+NV_USING_NAMESPACE
+
+namespace {
+
+//The per-vertex evaluation VLensDistortion used to do, to check the vectorized one against
+
+float EvalCatmullRomSpline(float const *K, float scaledVal, int NumSegments)
+{
+    float scaledValFloor = floorf(scaledVal);
+    scaledValFloor = std::max(0.0f, std::min((float) (NumSegments - 1), scaledValFloor));
+    float t = scaledVal - scaledValFloor;
+    int k = (int) scaledValFloor;
+
+    float p0 = 0.0f;
+    float p1 = 0.0f;
+    float m0 = 0.0f;
+    float m1 = 0.0f;
+
+    if (k == 0) {
+        p0 = 1.0f;
+        m0 = K[1] - K[0];
+        p1 = K[1];
+        m1 = 0.5f * (K[2] - K[0]);
+    } else if (k < NumSegments - 2) {
+        p0 = K[k];
+        m0 = 0.5f * (K[k + 1] - K[k - 1]);
+        p1 = K[k + 1];
+        m1 = 0.5f * (K[k + 2] - K[k]);
+    } else if (k == NumSegments - 2) {
+        p0 = K[k];
+        m0 = 0.5f * (K[k + 1] - K[k - 1]);
+        p1 = K[k + 1];
+        m1 = K[k + 1] - K[k];
+    } else if (k == NumSegments - 1) {
+        p0 = K[k];
+        m0 = K[k] - K[k - 1];
+        p1 = p0 + m0;
+        m1 = m0;
+    }
+
+    float omt = 1.0f - t;
+    return (p0 * (1.0f + 2.0f * t) + m0 * t) * omt * omt
+            + (p1 * (1.0f + 2.0f * omt) - m1 * omt) * t * t;
+}
+
+void WarpTexCoordChroma(const VDistortionMesh::Parms &parms, const float in[2], float red[2], float green[2], float blue[2])
+{
+    float theta[2];
+    for (int i = 0; i < 2; i++) {
+        const float unit = in[i];
+        const float ndc = 2.0f * (unit - 0.5f);
+        const float pixels = ndc * parms.heightbyPixels * 0.5f;
+        const float meters = pixels * parms.widthbyMeters / parms.widthbyPixels;
+        theta[i] = meters / parms.lens.centMetersPerTanAngler;
+    }
+
+    const VLensDistortion &lens = parms.lens;
+    const float rsq = theta[0] * theta[0] + theta[1] * theta[1];
+    const int NumSegments = 11;
+    const float scale = EvalCatmullRomSpline(lens.kArray, (float) (NumSegments - 1) * rsq / (lens.maxR * lens.maxR), NumSegments);
+    const float redScale = scale * (1.0f + lens.chromaticAberration[0] + rsq * lens.chromaticAberration[1]);
+    const float blueScale = scale * (1.0f + lens.chromaticAberration[2] + rsq * lens.chromaticAberration[3]);
+    for (int i = 0; i < 2; i++) {
+        red[i] = redScale * theta[i];
+        green[i] = scale * theta[i];
+        blue[i] = blueScale * theta[i];
+    }
+}
+
+void ReferenceTexCoords(const VDistortionMesh::Parms &parms, int tessellationsX, int tessellationsY, float *buf)
+{
+    const float aspect = parms.widthbyPixels * 0.5 / parms.heightbyPixels;
+
+    const float horizontalShiftLeftMeters = -((parms.lensDistance / 2) - (parms.widthbyMeters / 4)) + parms.xxOffsetbyMeters;
+    const float horizontalShiftRightMeters = ((parms.lensDistance / 2) - (parms.widthbyMeters / 4)) + parms.xxOffsetbyMeters;
+    const float horizontalShiftViewLeft = 2 * aspect * horizontalShiftLeftMeters / parms.widthbyMeters;
+    const float horizontalShiftViewRight = 2 * aspect * horizontalShiftRightMeters / parms.widthbyMeters;
+
+    for (int eye = 0; eye < 2; eye++) {
+        for (int y = 0; y <= tessellationsY; y++) {
+            const float yf = (float) y / (float) tessellationsY;
+            for (int x = 0; x <= tessellationsX; x++) {
+                const int vertNum = y * (tessellationsX + 1) * 2 + eye * (tessellationsX + 1) + x;
+                const float xf = (float) x / (float) tessellationsX;
+                float *v = &buf[vertNum * 6];
+                const float inTex[2] = {(eye ? horizontalShiftViewLeft : horizontalShiftViewRight) + xf * aspect + (1.0f - aspect) * 0.5f, yf};
+                WarpTexCoordChroma(parms, inTex, &v[0], &v[2], &v[4]);
+            }
+        }
+    }
+}
+
+VDistortionMesh::Parms TestParms()
+{
+    VDistortionMesh::Parms parms;
+    //Far enough out for the corners to go past maxR
+    parms.lens.maxR = 1.2f;
+    parms.xxOffsetbyMeters = 0.001f;
+    return parms;
+}
+
+void test()
+{
+    const VDistortionMesh::Parms parms = TestParms();
+
+    //The same as evaluating each vertex on its own, including the partial groups at the end of rows
+    const int grids[][2] = {{32, 32}, {33, 17}, {1, 1}, {128, 128}};
+    for (const auto &grid : grids) {
+        const int count = (grid[0] + 1) * (grid[1] + 1) * 2 * 6;
+        VArray<float> expected;
+        expected.resize(count);
+        VArray<float> actual;
+        actual.resize(count + 1);
+        actual[count] = 12345.0f;
+        ReferenceTexCoords(parms, grid[0], grid[1], expected.data());
+        VDistortionMesh::WarpTexCoords(parms, grid[0], grid[1], actual.data());
+        assert(actual[count] == 12345.0f);
+        for (int i = 0; i < count; i++) {
+            assert(fabs(actual[i] - expected[i]) <= 1e-5f * std::max(1.0f, fabs(expected[i])));
+        }
+    }
+
+    //Both eyes of each slice, two triangles per quad
+    VDistortionMesh mesh;
+    assert(mesh.generate(parms, 32, 32, 4, 1.0f, false));
+    assert(mesh.vertexCount() == 2 * 4 * 9 * 33);
+    assert(mesh.indices.size() == 2 * 32 * 32 * 6);
+    for (ushort index : mesh.indices) {
+        assert(index < mesh.vertexCount());
+    }
+    const float *last = &mesh.vertices[(mesh.vertexCount() - 1) * VDistortionMesh::AttribCount];
+    assert(last[0] == 1.0f && last[1] == 1.0f && last[8] == 1.0f && last[9] == 1.0f);
+
+    //The cursor only covers the middle of each eye
+    VDistortionMesh cursor;
+    assert(cursor.generate(parms, 32, 32, 1, 1.0f, true));
+    assert(!cursor.indices.isEmpty() && cursor.indices.size() < mesh.indices.size() / 10);
+
+    VDistortionMesh tooLarge;
+    assert(!tooLarge.generate(parms, VDistortionMesh::MaxGridSize * 2, 32, 1, 1.0f, false));
+    assert(tooLarge.vertices.isEmpty());
+    //Within MaxGridSize, but thin slices repeat too many columns for ushort indices
+    assert(!tooLarge.generate(parms, VDistortionMesh::MaxGridSize, VDistortionMesh::MaxGridSize,
+                              VDistortionMesh::MaxGridSize, 1.0f, false));
+    assert(tooLarge.vertices.isEmpty());
+    assert(!tooLarge.generate(parms, 4, 4, 8, 1.0f, false));
+
+    //The key changes with anything the mesh depends on
+    const vuint64 key = VDistortionMesh::Key(parms, 32, 32, 4, 1.0f, false);
+    assert(key == VDistortionMesh::Key(parms, 32, 32, 4, 1.0f, false));
+    assert(key != VDistortionMesh::Key(parms, 64, 32, 4, 1.0f, false));
+    assert(key != VDistortionMesh::Key(parms, 32, 32, 1, 1.0f, false));
+    assert(key != VDistortionMesh::Key(parms, 32, 32, 4, 1.1f, false));
+    assert(key != VDistortionMesh::Key(parms, 32, 32, 4, 1.0f, true));
+    VDistortionMesh::Parms other = parms;
+    other.lens.kArray[5] += 0.001f;
+    assert(key != VDistortionMesh::Key(other, 32, 32, 4, 1.0f, false));
+    other = parms;
+    other.widthbyPixels = 1920;
+    assert(key != VDistortionMesh::Key(other, 32, 32, 4, 1.0f, false));
+
+    VBuffer buffer;
+    assert(mesh.save(&buffer, key));
+    const VByteArray saved(buffer.data(), buffer.size());
+
+    VDistortionMesh loaded;
+    assert(loaded.load(&buffer, key));
+    assert(loaded.vertices == mesh.vertices);
+    assert(loaded.indices == mesh.indices);
+
+    buffer.write(saved.data(), saved.size());
+    assert(!loaded.load(&buffer, key + 1));
+
+    //Nor from a truncated file
+    buffer.clear();
+    buffer.write(saved.data(), saved.size() - 2);
+    assert(!loaded.load(&buffer, key));
+    assert(loaded.vertices.isEmpty());
+
+    //Nor with an index past the vertices
+    VByteArray corrupt = saved;
+    corrupt[corrupt.size() - 2] = (char) 0xff;
+    corrupt[corrupt.size() - 1] = (char) 0xff;
+    buffer.clear();
+    buffer.write(corrupt.data(), corrupt.size());
+    assert(!loaded.load(&buffer, key));
+    assert(loaded.vertices.isEmpty() && loaded.indices.isEmpty());
+
+    //Generated the first time, loaded the next
+    VString name;
+    name.sprintf("./distortion-%016llx.mesh", key);
+    remove(name.toUtf8().data());
+
+    VDistortionMesh created;
+    assert(created.create(parms, 32, 32, 4, 1.0f, false, VString(".")));
+    assert(created.vertices == mesh.vertices);
+    VDistortionMesh cached;
+    assert(cached.create(parms, 32, 32, 4, 1.0f, false, VString("./")));
+    assert(cached.indices == mesh.indices);
+    remove(name.toUtf8().data());
+}
+
+ADD_TEST(VDistortionMesh, test)
+
+//Generates the meshes VFrameSmooth does, warp and slices, at growing densities, evaluating the
+//lens per vertex as VLensDistortion used to and four vertices at a time, then loading them
+//back from the cache.
+//
+//    unittest VDistortionMeshBenchmark
+void benchmark()
+{
+    typedef std::chrono::steady_clock Clock;
+    const VDistortionMesh::Parms parms = TestParms();
+    const int sizes[] = {32, 64, 128};
+    for (int size : sizes) {
+        const int repeat = 4096 / size;
+        const int count = (size + 1) * (size + 1) * 2 * 6;
+        VArray<float> texCoords;
+        texCoords.resize(count);
+
+        auto start = Clock::now();
+        for (int i = 0; i < repeat; i++) {
+            ReferenceTexCoords(parms, size, size, texCoords.data());
+        }
+        const double reference = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / repeat;
+
+        start = Clock::now();
+        for (int i = 0; i < repeat; i++) {
+            VDistortionMesh::WarpTexCoords(parms, size, size, texCoords.data());
+        }
+        const double vectorized = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / repeat;
+
+        start = Clock::now();
+        VDistortionMesh warp;
+        VDistortionMesh slices;
+        for (int i = 0; i < repeat; i++) {
+            warp.generate(parms, size, size, 1, 1.0f, false);
+            slices.generate(parms, size, size, 4, 1.0f, false);
+        }
+        const double generating = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / repeat;
+
+        const vuint64 key = VDistortionMesh::Key(parms, size, size, 1, 1.0f, false);
+        VBuffer buffer;
+        warp.save(&buffer, key);
+        const VByteArray saved(buffer.data(), buffer.size());
+        start = Clock::now();
+        for (int i = 0; i < repeat; i++) {
+            buffer.write(saved.data(), saved.size());
+            warp.load(&buffer, key);
+        }
+        const double loading = std::chrono::duration<double, std::micro>(Clock::now() - start).count() / repeat;
+
+        vInfo("VDistortionMeshBenchmark: " << size << "x" << size << ": lens " << reference << " us evaluated per vertex, "
+              << vectorized << " us four at a time, " << reference / vectorized << "x; warp and slice meshes "
+              << generating << " us, loading " << saved.size() / 1024 << " KB " << loading << " us");
+    }
+}
+
+ADD_TEST(VDistortionMeshBenchmark, benchmark)
+
+}
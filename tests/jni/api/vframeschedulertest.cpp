@@ -0,0 +1,295 @@
+#include "test.h"
+
+#include <VFrameScheduler.h>
+#include <VFrameSimulator.h>
+#include <VJson.h>
+
+#include <fstream>
+#include <math.h>
+#include <sstream>
+#include <stdlib.h>
+
+NV_USING_NAMESPACE
+
+namespace {
+
+bool Near(double a, double b, double epsilon = 1e-6)
+{
+    return fabs(a - b) < epsilon;
+}
+
+void vsyncTiming()
+{
+    VSimulatedFrameClock clock(60.0);
+    VFrameScheduler scheduler(&clock);
+    const double period = 1.0 / 60.0;
+    assert(scheduler.clock() == &clock);
+    assert(Near(clock.period(), period));
+    assert(Near(scheduler.fractionalVsync(), 60.0));
+
+    clock.advance(period * 0.5);
+    assert(Near(scheduler.fractionalVsync(), 60.5));
+    assert(clock.vsyncState().vsyncCount == 60);
+    assert(Near(scheduler.framePointTimeInSeconds(61.0), 1.0 + period));
+
+    //Sleeping only goes forward
+    assert(scheduler.sleepUntilTimePoint(0.5, false) < 0.0f);
+    assert(Near(clock.seconds(), 1.0 + period * 0.5));
+    assert(scheduler.sleepUntilTimePoint(1.0 + period * 2, true) > 0.0f);
+    assert(Near(scheduler.fractionalVsync(), 62.0));
+
+    //Each eye is warped at its point of the frame, and predicted for its own scan
+    const swapProgram_t &swap = spAsyncFrontBufferPortrait;
+    assert(Near(scheduler.sleepUntilEye(62.0, swap, 0), scheduler.framePointTimeInSeconds(62.5)));
+    assert(Near(scheduler.fractionalVsync(), 62.5));
+    assert(Near(scheduler.predictionTime(62.0, swap, 1, 0), scheduler.framePointTimeInSeconds(63.5)));
+}
+
+ADD_TEST(VFrameClock, vsyncTiming)
+
+void selection()
+{
+    VSimulatedFrameClock clock;
+    VFrameScheduler scheduler(&clock);
+    long long considered = -1;
+
+    //Nothing submitted yet
+    assert(scheduler.selectEyeBuffers(0, considered, [](long long) { return VFrameScheduler::BufferReady; }) == 0);
+    assert(considered == 0);
+
+    //The newest finished one
+    auto pending = [](long long bufferNum) {
+        return bufferNum == 5 ? VFrameScheduler::BufferPending : VFrameScheduler::BufferReady;
+    };
+    assert(scheduler.selectEyeBuffers(5, considered, pending) == 4);
+    assert(considered == 4);
+
+    //No further back than the warp sources kept
+    assert(scheduler.selectEyeBuffers(5, considered, [](long long) { return VFrameScheduler::BufferTooNew; }) == 0);
+    assert(considered == 5 - (VFrameScheduler::MAX_WARP_SOURCES - 2));
+
+    //Nor past an invalid one
+    auto invalid = [](long long bufferNum) {
+        return bufferNum == 5 ? VFrameScheduler::BufferInvalid : VFrameScheduler::BufferReady;
+    };
+    assert(scheduler.selectEyeBuffers(5, considered, invalid) == 0);
+    assert(considered == 5);
+
+    //The main thread waits until the warp thread has looked at its previous buffers
+    assert(scheduler.minimumVsync(1) == 2);
+    SwapState state;
+    state.VsyncCount = 10;
+    state.EyeBufferCount = 1;
+    assert(!scheduler.latch(state, 2, 1));
+    assert(scheduler.minimumVsync(1) == 2);
+    state.EyeBufferCount = 2;
+    assert(scheduler.latch(state, 2, 1));
+    assert(scheduler.minimumVsync(1) == 12);
+
+    //Raising the minimum vsyncs skips vsyncs
+    state.EyeBufferCount = 3;
+    assert(scheduler.latch(state, 3, 3));
+    assert(scheduler.minimumVsync(1) == 15);
+}
+
+ADD_TEST(VFrameScheduler, selection)
+
+void stats()
+{
+    VArray<float> values;
+    for (int i = 100; i > 0; i--) {
+        values.append(i);
+    }
+    const VFrameScheduler::Percentiles percentiles = VFrameScheduler::Percentile(values);
+    assert(percentiles.p50 == 50.0f);
+    assert(percentiles.p90 == 90.0f);
+    assert(percentiles.p99 == 99.0f);
+    assert(percentiles.max == 100.0f);
+
+    VSimulatedFrameClock clock;
+    VFrameScheduler scheduler(&clock, 8);
+    const double period = clock.period();
+    const long long bufferNums[] = {1, 1, 0, 2};
+    for (int i = 0; i < 4; i++) {
+        const long long vsync = 61 + i;
+        const double frameTime = scheduler.framePointTimeInSeconds(vsync);
+        scheduler.beginFrame(vsync, bufferNums[i], frameTime - period);
+        for (int eye = 0; eye < 2; eye++) {
+            const double sleepTarget = frameTime + period * 0.5 * eye;
+            //The right eye of the last frame completes too late for a front buffer
+            const double complete = i == 3 && eye == 1 ? period * 0.75 : period * 0.25;
+            scheduler.eyeWarped(eye, sleepTarget, sleepTarget + 0.001, sleepTarget + complete, sleepTarget + period * 0.5);
+        }
+        scheduler.endFrame();
+    }
+
+    const VArray<VFrameScheduler::FrameTiming> frames = scheduler.frames();
+    assert(frames.size() == 4);
+    assert(!frames[0].skipped && frames[1].skipped && frames[2].skipped && !frames[3].skipped);
+    assert(Near(frames[0].poseLatencySeconds, period, 1e-5));
+    assert(frames[2].poseLatencySeconds == 0.0f);
+    assert(Near(frames[3].issueFinish[1], 0.001, 1e-5));
+
+    const VFrameScheduler::Stats stats = scheduler.stats();
+    assert(stats.frames == 4);
+    assert(stats.skipped == 2);
+    assert(stats.late == 1);
+    assert(Near(stats.poseLatency.p50, period, 1e-5));
+    assert(Near(stats.completeFinish.p50, period * 0.25, 1e-5));
+    assert(Near(stats.completeFinish.max, period * 0.75, 1e-5));
+    assert(Near(stats.prediction.max, period * 0.5, 1e-5));
+
+    std::stringstream csv;
+    scheduler.writeCsv(csv);
+    std::string line;
+    int lines = 0;
+    std::getline(csv, line);
+    assert(line.compare(0, 16, "vsync,bufferNum,") == 0);
+    while (std::getline(csv, line)) {
+        lines++;
+    }
+    assert(lines == 4);
+
+    std::stringstream text;
+    text << scheduler.toJson();
+    VJson json;
+    text >> json;
+    assert(json["stats"]["frames"].toInt() == 4);
+    assert(json["stats"]["late"].toInt() == 1);
+    assert(json["frames"].size() == 4);
+    assert(json["frames"][1]["skipped"].toBool());
+    assert(json["frames"][3]["completeFinish"].size() == 2);
+
+    //Only the last frames are kept
+    for (int i = 0; i < 20; i++) {
+        scheduler.beginFrame(100 + i, 3 + i, 0.0);
+        scheduler.endFrame();
+    }
+    const VArray<VFrameScheduler::FrameTiming> last = scheduler.frames();
+    assert(last.size() == 8);
+    assert(last[0].vsync == 112 && last[7].vsync == 119);
+
+    scheduler.clearLog();
+    assert(scheduler.frames().isEmpty());
+    assert(scheduler.stats().frames == 0);
+}
+
+ADD_TEST(VFrameSchedulerStats, stats)
+
+void simulate()
+{
+    //An application well within the frame rate shows a new frame each vsync, a frame after it
+    //sampled the pose
+    VFrameSimulator::Settings settings;
+    settings.jitterSeconds = 0.0;
+    settings.spikeProbability = 0.0;
+    settings.frames = 120;
+    VFrameSimulator simulator(settings);
+    const VFrameSimulator::Result result = simulator.run();
+    const double period = 1.0 / settings.refreshRate;
+    assert(result.stats.frames == 120);
+    assert(result.stats.skipped <= 2);
+    assert(result.stats.late == 0);
+    assert(result.submitted >= 118);
+    assert(result.stats.poseLatency.max < period * 2.5);
+    assert(result.predictionError.max < 0.001f);
+    assert(simulator.scheduler().frames().size() == 120);
+
+    //One that takes a frame and a half shows each of its frames twice
+    settings.cpuSeconds = period * 1.5;
+    VFrameSimulator slow(settings);
+    const VFrameSimulator::Result slowResult = slow.run();
+    assert(slowResult.stats.skipped >= 55 && slowResult.stats.skipped <= 65);
+    assert(slowResult.submitted <= 62);
+
+    //The same frames for the same seed
+    settings.jitterSeconds = 0.002;
+    settings.spikeProbability = 0.05;
+    VFrameSimulator a(settings);
+    VFrameSimulator b(settings);
+    const VFrameSimulator::Result resultA = a.run();
+    const VFrameSimulator::Result resultB = b.run();
+    assert(resultA.stats.skipped == resultB.stats.skipped);
+    assert(resultA.stats.poseLatency.p99 == resultB.stats.poseLatency.p99);
+}
+
+ADD_TEST(VFrameSimulator, simulate)
+
+//Simulates the swap programs and prediction points against a light and a heavy application,
+//and reports percentiles of the pose latency and the prediction error. The timing of the first
+//one is written to VFRAME_CSV and VFRAME_JSON if they are set.
+//
+//    unittest VFrameSchedulerBenchmark
+void benchmark()
+{
+    struct Program
+    {
+        const char *name;
+        swapProgram_t swap;
+        bool frontBuffer;
+    };
+    Program programs[] = {
+        {"async front buffer", spAsyncFrontBufferPortrait, true},
+        {"async swapped buffer", spAsyncSwappedBufferPortrait, false},
+        {"front buffer, predicting a quarter frame short", spAsyncFrontBufferPortrait, true},
+        {"swapped buffer, predicting a frame short", spAsyncSwappedBufferPortrait, false},
+    };
+    for (int eye = 0; eye < 2; eye++) {
+        for (int scan = 0; scan < 2; scan++) {
+            programs[2].swap.predictionPoints[eye][scan] -= 0.25f;
+            programs[3].swap.predictionPoints[eye][scan] -= 1.0f;
+        }
+    }
+
+    struct Load
+    {
+        const char *name;
+        double cpuSeconds;
+        double spikeProbability;
+    };
+    const Load loads[] = {
+        {"light", 0.008, 0.01},
+        {"heavy", 0.014, 0.05},
+    };
+
+    const float ms = 1000.0f;
+    bool traced = false;
+    for (const Program &program : programs) {
+        for (const Load &load : loads) {
+            VFrameSimulator::Settings settings;
+            settings.swap = program.swap;
+            settings.frontBuffer = program.frontBuffer;
+            settings.cpuSeconds = load.cpuSeconds;
+            settings.spikeProbability = load.spikeProbability;
+            settings.frames = 3600;
+            VFrameSimulator simulator(settings);
+            const VFrameSimulator::Result result = simulator.run();
+            const VFrameScheduler::Stats &stats = result.stats;
+            vInfo("VFrameSchedulerBenchmark: " << program.name << ", " << load.name << " application: "
+                  << stats.skipped << " of " << stats.frames << " frames skipped, " << stats.late << " late");
+            vInfo("VFrameSchedulerBenchmark:     pose latency p50 " << stats.poseLatency.p50 * ms << " p90 "
+                  << stats.poseLatency.p90 * ms << " p99 " << stats.poseLatency.p99 * ms << " max "
+                  << stats.poseLatency.max * ms << " ms, prediction error p50 " << result.predictionError.p50 * ms
+                  << " p99 " << result.predictionError.p99 * ms << " ms");
+
+            if (traced) {
+                continue;
+            }
+            traced = true;
+            const char *csv = getenv("VFRAME_CSV");
+            if (csv != nullptr) {
+                std::ofstream out(csv);
+                simulator.scheduler().writeCsv(out);
+            }
+            const char *json = getenv("VFRAME_JSON");
+            if (json != nullptr) {
+                std::ofstream out(json);
+                out << simulator.scheduler().toJson();
+            }
+        }
+    }
+}
+
+ADD_TEST(VFrameSchedulerBenchmark, benchmark)
+
+}
@@ -0,0 +1,323 @@
+#include "test.h"
+
+#include <VLocklessRing.h>
+#include <VRotationHistory.h>
+
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+NV_USING_NAMESPACE
+
+namespace {
+
+struct Element
+{
+    vint64 index;
+    double values[4];
+
+    Element(vint64 index = 0)
+        : index(index)
+    {
+        for (int i = 0; i < 4; i++) {
+            values[i] = index * 4.0 + i;
+        }
+    }
+
+    bool isConsistent() const
+    {
+        for (int i = 0; i < 4; i++) {
+            if (values[i] != index * 4.0 + i) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+//VQuat::Angle() through acos can't resolve the fractions of a milliradian compared here
+float Angle(const VQuatf &a, const VQuatf &b)
+{
+    const VQuatf difference = a.Inverted() * b;
+    const float sine = sqrtf(difference.x * difference.x + difference.y * difference.y + difference.z * difference.z);
+    return 2.0f * atan2f(sine, fabsf(difference.w));
+}
+
+//Body-frame angular velocity of a head looking around, in radians per second
+VVect3f HeadVelocity(double time)
+{
+    return VVect3f(0.8f * sin(time * 2.1) + 0.3f * sin(time * 7.3),
+                   2.5f * sin(time * 1.3) * sin(time * 0.37) + 0.6f * sin(time * 5.9),
+                   0.2f * sin(time * 3.7));
+}
+
+//Samples of a rotation integrated from velocity, every interval seconds
+template <class Velocity>
+std::vector<VRotationState> Trace(double duration, double interval, Velocity velocity)
+{
+    std::vector<VRotationState> trace;
+    VRotationState state;
+    state = VQuatf();
+    const int steps = 10;
+    for (double time = 0.0; time < duration; time += interval) {
+        state.timestamp = time;
+        state.gyro = velocity(time);
+        trace.push_back(state);
+        for (int i = 0; i < steps; i++) {
+            const VVect3f gyro = velocity(time + (i + 0.5) * interval / steps);
+            const float speed = gyro.length();
+            if (speed > 0.0f) {
+                state = state * VQuatf(gyro, speed * static_cast<float>(interval / steps));
+            }
+        }
+    }
+    return trace;
+}
+
+void test()
+{
+    //The ring keeps the last capacity elements
+    {
+        VLocklessRing<Element> ring(5);
+        assert(ring.capacity() == 8);
+        assert(ring.isEmpty() && ring.count() == 0 && ring.first() == 0);
+        Element element;
+        assert(!ring.last(element) && !ring.at(0, element));
+
+        for (vint64 i = 0; i < 20; i++) {
+            ring.append(Element(i));
+        }
+        assert(ring.count() == 20 && ring.first() == 12);
+        assert(ring.last(element) && element.index == 19);
+        assert(!ring.at(11, element) && !ring.at(20, element) && !ring.at(-1, element));
+        for (vint64 i = 12; i < 20; i++) {
+            assert(ring.at(i, element) && element.index == i && element.isConsistent());
+        }
+    }
+
+    //Readers only see whole elements, numbered as asked, while the writer goes round the ring
+    {
+        const vint64 appends = 200000;
+        VLocklessRing<Element> ring(64);
+        std::atomic<bool> writing(true);
+        std::atomic<int> wrong(0);
+        std::thread writer([&]() {
+            for (vint64 i = 0; i < appends; i++) {
+                ring.append(Element(i));
+            }
+            writing = false;
+        });
+        std::vector<std::thread> readers;
+        for (int r = 0; r < 2; r++) {
+            readers.push_back(std::thread([&, r]() {
+                vint64 newest = -1;
+                while (writing) {
+                    Element element;
+                    const vint64 index = ring.count() - 1 - r * 32;
+                    if (ring.at(index, element) && (element.index != index || !element.isConsistent())) {
+                        wrong++;
+                    }
+                    if (ring.last(element)) {
+                        if (element.index < newest || !element.isConsistent()) {
+                            wrong++;
+                        }
+                        newest = element.index;
+                    }
+                }
+            }));
+        }
+        writer.join();
+        for (std::thread &reader : readers) {
+            reader.join();
+        }
+        assert(wrong == 0);
+    }
+
+    //Rotating about y at a steady rate, states in between samples are exact
+    const float rate = 1.5f;
+    VRotationHistory history(16);
+    assert(history.isEmpty() && history.last().timestamp == 0.0);
+    for (int i = 0; i < 40; i++) {
+        VRotationState state;
+        state = VQuatf(VAxis_Y, rate * i * 0.001f);
+        state.gyro = VVect3f(0.0f, rate, 0.0f);
+        state.timestamp = 10.0 + i * 0.001;
+        history.append(state);
+    }
+    assert(!history.isEmpty() && history.last().timestamp == 10.0 + 39 * 0.001);
+    for (int i = 24; i < 39; i++) {
+        const double offsets[] = {0.0, 0.00025, 0.0005, 0.0009};
+        for (double offset : offsets) {
+            const double timestamp = 10.0 + i * 0.001 + offset;
+            const VRotationState state = history.state(timestamp);
+            assert(state.timestamp == timestamp);
+            assert(Angle(state, VQuatf(VAxis_Y, rate * static_cast<float>(timestamp - 10.0))) < 0.0005f);
+            assert(fabs(state.gyro.y - rate) < 0.0001f);
+        }
+    }
+
+    //Before the oldest sample held it is that sample
+    {
+        const VRotationState state = history.state(9.0);
+        assert(state.timestamp == 10.0 + 24 * 0.001);
+    }
+
+    //Past the last sample it keeps rotating
+    {
+        const VRotationState state = history.state(10.039 + 0.02);
+        assert(Angle(state, VQuatf(VAxis_Y, rate * 0.059f)) < 0.001f);
+    }
+
+    //Without acceleration, prediction is the former constant gyro prediction
+    {
+        VRotationHistory::Predictor predictor;
+        predictor.accelerationWeight = 0.0f;
+        VRotationState pose;
+        pose = VQuatf(VVect3f(1.0f, 2.0f, 0.5f), 0.7f);
+        pose.gyro = VVect3f(0.3f, -1.2f, 0.4f);
+        pose.timestamp = 3.0;
+        const float intervals[] = {0.0f, 0.005f, 0.02f, 0.3f};
+        for (float interval : intervals) {
+            const float speed = pose.gyro.length();
+            const float dt = std::min(std::max(std::min(interval, 0.2f * speed), 0.0f), 0.1f);
+            const VQuatf expected = pose * VQuatf(pose.gyro, speed * dt);
+            const VRotationState predicted = VRotationHistory::Predict(pose, VVect3f(5.0f, 5.0f, 5.0f), pose.timestamp + interval, predictor);
+            assert(Angle(predicted, expected) < 0.0001f);
+            assert(predicted.timestamp == pose.timestamp + interval);
+        }
+    }
+
+    //Prediction of a speeding up rotation improves with the acceleration
+    {
+        auto speedingUp = [](double time) { return VVect3f(0.0f, static_cast<float>(1.0 + 20.0 * time), 0.0f); };
+        const std::vector<VRotationState> trace = Trace(0.1, 0.001, speedingUp);
+        VRotationHistory accelerating;
+        for (int i = 0; i <= 50; i++) {
+            accelerating.append(trace[i]);
+        }
+        const VRotationState &truth = trace[70];
+        VRotationHistory::Predictor predictor;
+        predictor.accelerationWeight = 0.0f;
+        accelerating.setPredictor(predictor);
+        const float constantError = Angle(accelerating.state(truth.timestamp), truth);
+        predictor.accelerationWeight = 1.0f;
+        accelerating.setPredictor(predictor);
+        const float acceleratedError = Angle(accelerating.state(truth.timestamp), truth);
+        assert(acceleratedError < constantError * 0.2f);
+    }
+
+    //Cleared samples are gone, new ones are kept
+    history.clear();
+    assert(history.isEmpty() && history.last().timestamp == 0.0);
+    {
+        VRotationState state;
+        state = VQuatf();
+        state.timestamp = 20.0;
+        history.append(state);
+        assert(!history.isEmpty() && history.state(19.0).timestamp == 20.0);
+    }
+}
+
+ADD_TEST(VRotationHistory, test)
+
+//Reads a recorded trace, one "timestamp,w,x,y,z,gx,gy,gz" line per sample
+bool LoadTrace(const char *path, std::vector<VRotationState> &trace)
+{
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        return false;
+    }
+    VRotationState state;
+    while (fscanf(file, "%lf,%f,%f,%f,%f,%f,%f,%f", &state.timestamp, &state.w, &state.x, &state.y, &state.z, &state.gyro.x, &state.gyro.y, &state.gyro.z) == 8) {
+        trace.push_back(state);
+    }
+    fclose(file);
+    return trace.size() > 1;
+}
+
+//Mean error in degrees of the poses predicted horizon seconds after each sample, against the
+//sample recorded then
+double PredictionError(const std::vector<VRotationState> &trace, double horizon, float accelerationWeight)
+{
+    VRotationHistory history;
+    VRotationHistory::Predictor predictor;
+    predictor.accelerationWeight = accelerationWeight;
+    history.setPredictor(predictor);
+
+    double total = 0.0;
+    int count = 0;
+    uint future = 0;
+    for (uint i = 0; i < trace.size(); i++) {
+        history.append(trace[i]);
+        while (future < trace.size() && trace[future].timestamp < trace[i].timestamp + horizon) {
+            future++;
+        }
+        if (future == trace.size()) {
+            break;
+        }
+        if (i < 100) {
+            continue;
+        }
+        total += Angle(history.state(trace[future].timestamp), trace[future]);
+        count++;
+    }
+    return count > 0 ? total / count * 180.0 / M_PI : 0.0;
+}
+
+void benchmark()
+{
+    std::vector<VRotationState> trace;
+    const char *path = getenv("VROTATION_TRACE");
+    if (path != nullptr && LoadTrace(path, trace)) {
+        vInfo("VRotationHistory: " << trace.size() << " samples from " << path);
+    } else {
+        //A minute of 1 kHz samples, with timing jitter and gyro noise as a phone's sensors give
+        trace = Trace(60.0, 0.001, HeadVelocity);
+        std::mt19937 random(7);
+        std::normal_distribution<float> noise(0.0f, 0.02f);
+        std::uniform_real_distribution<double> jitter(-0.0002, 0.0002);
+        for (VRotationState &state : trace) {
+            state.timestamp += jitter(random);
+            state.gyro += VVect3f(noise(random), noise(random), noise(random));
+        }
+        vInfo("VRotationHistory: " << trace.size() << " synthetic samples, set VROTATION_TRACE to replay a recording");
+    }
+
+    const double horizons[] = {0.01, 0.02, 0.04};
+    const float weights[] = {0.0f, 0.25f, 0.5f, 0.75f, 1.0f};
+    for (double horizon : horizons) {
+        for (float weight : weights) {
+            vInfo("VRotationHistory: " << horizon * 1000 << " ms ahead, acceleration weight " << weight << ": "
+                  << PredictionError(trace, horizon, weight) << " degrees mean error");
+        }
+    }
+
+    VRotationHistory history;
+    for (const VRotationState &state : trace) {
+        history.append(state);
+    }
+    const double last = history.last().timestamp;
+    const int queries = 200000;
+    float sum = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < queries; i++) {
+        sum += history.state(last - (i % 997) * 0.0005).w;
+    }
+    const double past = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / queries;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < queries; i++) {
+        sum += history.state(last + (i % 40) * 0.001).w;
+    }
+    const double ahead = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / queries;
+    assert(sum != 0.0f);
+    vInfo("VRotationHistory: " << past << " ns per interpolated state, " << ahead << " ns per predicted state");
+}
+
+ADD_TEST(VRotationHistoryBenchmark, benchmark)
+
+}
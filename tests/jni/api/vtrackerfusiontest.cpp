@@ -0,0 +1,334 @@
+#include "test.h"
+
+#include <VBuffer.h>
+#include <VFile.h>
+#include <VTrackerFusion.h>
+#include <VTrackerTrace.h>
+
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+NV_USING_NAMESPACE
+
+namespace {
+
+const float Gravity = 9.8f;
+
+float Angle(const VQuatf &a, const VQuatf &b)
+{
+    const VQuatf difference = a.Inverted() * b;
+    const float sine = sqrtf(difference.x * difference.x + difference.y * difference.y + difference.z * difference.z);
+    return 2.0f * atan2f(sine, fabsf(difference.w));
+}
+
+//Angle between the up directions of a and b, the error the accelerometer can correct
+float Tilt(const VQuatf &a, const VQuatf &b)
+{
+    return a.Inverted().Rotate(VVect3f(0, 1, 0)).angleTo(b.Inverted().Rotate(VVect3f(0, 1, 0)));
+}
+
+int32_t Raw(float value)
+{
+    return static_cast<int32_t>(floorf(value / 0.0001f + 0.5f));
+}
+
+void SetSample(KTrackerSensorZip &data, int i, const VVect3f &accel, const VVect3f &gyro)
+{
+    KTrackerSensorZip::RawData &sample = data.Samples[i];
+    sample.AccelX = Raw(accel.x);
+    sample.AccelY = Raw(accel.y);
+    sample.AccelZ = Raw(accel.z);
+    sample.GyroX = Raw(gyro.x);
+    sample.GyroY = Raw(gyro.y);
+    sample.GyroZ = Raw(gyro.z);
+}
+
+//A report of single sample, with the accelerometer seeing gravity from orientation
+KTrackerSensorZip Report(uint16_t timestamp, const VQuatf &orientation, const VVect3f &gyro)
+{
+    KTrackerSensorZip data;
+    memset(&data, 0, sizeof(data));
+    data.SampleCount = 1;
+    data.Timestamp = timestamp;
+    SetSample(data, 0, orientation.Inverted().Rotate(VVect3f(0, Gravity, 0)), gyro);
+    return data;
+}
+
+//Writes the reports a tracker on a moving head sends for duration seconds, with the actual
+//orientation. The gyro has a bias and noise, the host reads reports late, sometimes several
+//samples at once, and sometimes misses some.
+void WriteSyntheticTrace(VIODevice *device, double duration)
+{
+    VTrackerTrace trace(device);
+    trace.writeHeader(VTrackerTrace::HasTruth);
+
+    std::mt19937 random(11);
+    std::normal_distribution<float> gyroNoise(0.0f, 0.005f);
+    std::normal_distribution<float> accelNoise(0.0f, 0.05f);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    const VVect3f bias(0.004f, -0.003f, 0.002f);
+    auto velocity = [](double time) {
+        return VVect3f(0.8f * sin(time * 2.1) + 0.3f * sin(time * 7.3),
+                       2.5f * sin(time * 1.3) * sin(time * 0.37) + 0.6f * sin(time * 5.9),
+                       0.2f * sin(time * 3.7));
+    };
+
+    const double dt = 0.001;
+    const int samples = static_cast<int>(duration / dt);
+    VQuatf orientation;
+    double host = 0.0;
+    //The tracker's millisecond counter, close to wrapping around
+    uint16_t timestamp = 65000;
+    for (int sample = 0; sample < samples;) {
+        double roll = uniform(random);
+        const int count = roll < 0.9 ? 1 : (roll < 0.97 ? 2 : 3);
+        const bool missed = uniform(random) < 0.005;
+
+        KTrackerSensorZip data;
+        memset(&data, 0, sizeof(data));
+        data.SampleCount = count;
+        data.Timestamp = timestamp;
+        data.Temperature = 2500;
+        for (int i = 0; i < count; i++) {
+            const double time = (sample + i) * dt;
+            const VVect3f rate = velocity(time + dt * 0.5);
+            const VVect3f accel = orientation.Inverted().Rotate(VVect3f(0, Gravity, 0));
+            SetSample(data, i, accel + VVect3f(accelNoise(random), accelNoise(random), accelNoise(random)),
+                      rate + bias + VVect3f(gyroNoise(random), gyroNoise(random), gyroNoise(random)));
+            for (int step = 0; step < 10; step++) {
+                const VVect3f substep = velocity(time + (step + 0.5) * dt / 10);
+                orientation = orientation * VQuatf(substep, substep.length() * static_cast<float>(dt / 10));
+            }
+        }
+        sample += count;
+        timestamp += count;
+
+        host = std::max(host, sample * dt + 0.0005 + uniform(random) * 0.001);
+        if (missed) {
+            continue;
+        }
+        VTrackerTrace::Record record;
+        record.time = host;
+        data.encode(record.packet);
+        record.truth[0] = orientation.w;
+        record.truth[1] = orientation.x;
+        record.truth[2] = orientation.y;
+        record.truth[3] = orientation.z;
+        trace.write(record);
+    }
+}
+
+void test()
+{
+    //Reports survive a round trip through the wire format, down to the extremes of 21 bits
+    {
+        KTrackerSensorZip data;
+        memset(&data, 0, sizeof(data));
+        data.SampleCount = 3;
+        data.Timestamp = 0xBEEF;
+        data.LastCommandID = 513;
+        data.Temperature = -1234;
+        const int32_t values[] = {0, 1, -1, 1048575, -1048576, 98000, -31415};
+        int32_t *raw = &data.Samples[0].AccelX;
+        for (int i = 0; i < 18; i++) {
+            raw[i] = values[i % 7];
+        }
+        data.MagX = -300;
+        data.MagY = 7;
+        data.MagZ = 32767;
+
+        uint8_t buffer[KTrackerSensorZip::Size];
+        data.encode(buffer);
+        KTrackerSensorZip decoded;
+        assert(KTrackerSensorZip::Decode(buffer, sizeof(buffer), decoded));
+        assert(decoded.SampleCount == 3 && decoded.Timestamp == 0xBEEF);
+        assert(decoded.LastCommandID == 513 && decoded.Temperature == -1234);
+        assert(decoded.MagX == -300 && decoded.MagY == 7 && decoded.MagZ == 32767);
+        assert(memcmp(decoded.Samples, data.Samples, sizeof(data.Samples)) == 0);
+        assert(!KTrackerSensorZip::Decode(buffer, sizeof(buffer) - 1, decoded));
+
+        //Only the samples the report holds are read
+        buffer[1] = 1;
+        assert(KTrackerSensorZip::Decode(buffer, sizeof(buffer), decoded));
+        assert(decoded.Samples[0].GyroZ == data.Samples[0].GyroZ && decoded.Samples[1].AccelX == 0);
+    }
+
+    //A sensor lying still stays level
+    {
+        VTrackerFusion fusion;
+        for (int i = 0; i < 2000; i++) {
+            fusion.process(Report(i, VQuatf(), VVect3f(0, 0, 0)), i * 0.001);
+        }
+        assert(fusion.sampleCount() == 2000);
+        assert(Angle(fusion.state(), VQuatf()) < 0.001f);
+        assert(fusion.state().timestamp == 1.999);
+    }
+
+    //It starts level whatever way it is held, and gravity pulls the drifting gyro back
+    {
+        const VQuatf held(VVect3f(1, 0, 0.5f), 0.5f);
+        VTrackerFusion fusion;
+        fusion.process(Report(0, held, VVect3f(0, 0, 0)), 0.0);
+        for (int i = 1; i < 6; i++) {
+            fusion.process(Report(i, held, VVect3f(0, 0, 0)), i * 0.001);
+        }
+        assert(Tilt(fusion.state(), held) < 0.01f);
+
+        for (int i = 6; i < 5000; i++) {
+            fusion.process(Report(i, held, VVect3f(0.02f, 0, 0)), i * 0.001);
+        }
+        assert(Tilt(fusion.state(), held) < 0.1f);
+    }
+
+    //Missed samples are filled with the last one, across the wrap of the counter
+    {
+        const float rate = 1.0f;
+        VTrackerFusion fusion;
+        uint16_t timestamp = 65530;
+        for (int i = 0; i < 100; i++) {
+            fusion.process(Report(timestamp, VQuatf(), VVect3f(0, rate, 0)), i * 0.001);
+            timestamp += (i == 50) ? 10 : 1;
+        }
+        assert(fusion.sampleCount() == 109);
+        assert(fabs(fusion.state().gyro.y - rate) < 0.01f);
+    }
+
+    //Traces go through memory as they go through files, and the batch gives the same states
+    {
+        VBuffer buffer;
+        WriteSyntheticTrace(&buffer, 2.0);
+
+        VTrackerTrace trace(&buffer);
+        assert(trace.readHeader() && trace.flags() == VTrackerTrace::HasTruth);
+        std::vector<KTrackerSensorZip> reports;
+        std::vector<double> times;
+        VTrackerTrace::Record record;
+        VTrackerFusion fusion;
+        float maxTilt = 0.0f;
+        while (trace.read(record)) {
+            KTrackerSensorZip data;
+            assert(KTrackerSensorZip::Decode(record.packet, sizeof(record.packet), data));
+            reports.push_back(data);
+            times.push_back(record.time);
+            fusion.process(data, record.time);
+            const VQuatf truth(record.truth[1], record.truth[2], record.truth[3], record.truth[0]);
+            maxTilt = std::max(maxTilt, Tilt(fusion.state(), truth));
+        }
+        assert(reports.size() > 1500);
+        assert(fusion.sampleCount() >= 1997);
+        assert(maxTilt < 0.05f);
+
+        VTrackerFusion batch;
+        batch.processBatch(reports.data(), times.data(), 100);
+        batch.processBatch(reports.data() + 100, times.data() + 100, reports.size() - 100);
+        const VRotationState &a = fusion.state();
+        const VRotationState &b = batch.state();
+        assert(a.w == b.w && a.x == b.x && a.y == b.y && a.z == b.z);
+        assert(a.gyro.x == b.gyro.x && a.timestamp == b.timestamp);
+        assert(batch.sampleCount() == fusion.sampleCount());
+
+        fusion.reset();
+        assert(fusion.sampleCount() == 0 && fusion.state().w == 1.0f);
+
+        VBuffer garbage;
+        garbage.write("VTRX\1\0\0\0\0\0\0\0", 12);
+        VTrackerTrace notTrace(&garbage);
+        assert(!notTrace.readHeader());
+    }
+}
+
+ADD_TEST(VTrackerFusion, test)
+
+//Replays a trace, VTRACKER_TRACE or a synthetic minute of head motion, and reports the cost of
+//decoding and fusing each report and how far the orientation drifts from the actual one.
+//
+//    unittest VTrackerReplay
+void replay()
+{
+    VBuffer synthetic;
+    VFile file;
+    VIODevice *device = &synthetic;
+    const char *path = getenv("VTRACKER_TRACE");
+    if (path != nullptr) {
+        if (!file.open(path, VFile::ReadOnly)) {
+            vInfo("VTrackerReplay: can't open " << path);
+            return;
+        }
+        device = &file;
+    } else {
+        WriteSyntheticTrace(&synthetic, 60.0);
+    }
+
+    std::vector<VTrackerTrace::Record> records;
+    VTrackerTrace trace(device);
+    if (!trace.readHeader()) {
+        return;
+    }
+    VTrackerTrace::Record record;
+    while (trace.read(record)) {
+        records.push_back(record);
+    }
+    const bool hasTruth = trace.flags() & VTrackerTrace::HasTruth;
+    vInfo("VTrackerReplay: " << records.size() << " reports from " << (path ? path : "a synthetic trace"));
+    if (records.empty()) {
+        return;
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    std::vector<KTrackerSensorZip> reports(records.size());
+    std::vector<double> times(records.size());
+    auto start = Clock::now();
+    for (uint i = 0; i < records.size(); i++) {
+        KTrackerSensorZip::Decode(records[i].packet, sizeof(records[i].packet), reports[i]);
+        times[i] = records[i].time;
+    }
+    const double decoding = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    //Each report as it arrives, with the drift measured after each
+    VTrackerFusion fusion;
+    double fusing = 0.0;
+    double totalError = 0.0;
+    float maxError = 0.0f;
+    float maxTilt = 0.0f;
+    for (uint i = 0; i < reports.size(); i++) {
+        start = Clock::now();
+        fusion.process(reports[i], times[i]);
+        fusing += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        if (hasTruth) {
+            const VQuatf truth(records[i].truth[1], records[i].truth[2], records[i].truth[3], records[i].truth[0]);
+            const float error = Angle(fusion.state(), truth);
+            totalError += error;
+            maxError = std::max(maxError, error);
+            maxTilt = std::max(maxTilt, Tilt(fusion.state(), truth));
+        }
+    }
+
+    //In batches, the way the sensor thread would drain a queue of reports
+    const uint batchSize = 64;
+    VTrackerFusion batch;
+    start = Clock::now();
+    for (uint i = 0; i < reports.size(); i += batchSize) {
+        batch.processBatch(reports.data() + i, times.data() + i, std::min<uint>(batchSize, reports.size() - i));
+    }
+    const double batching = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    const double count = reports.size();
+    vInfo("VTrackerReplay: " << decoding / count << " ns to decode, " << fusing / count << " ns to fuse a report, "
+          << batching / count << " ns in batches of " << batchSize << ", "
+          << fusion.sampleCount() << " samples fused");
+    vInfo("VTrackerReplay: " << count * 1e9 / (decoding + fusing) << " reports per second, "
+          << count * 1e9 / (decoding + batching) << " in batches");
+    if (hasTruth) {
+        const float degrees = 180.0f / M_PI;
+        vInfo("VTrackerReplay: drift " << totalError / count * degrees << " degrees on average, "
+              << maxError * degrees << " at most, tilt " << maxTilt * degrees << " at most");
+    }
+}
+
+ADD_TEST(VTrackerReplay, replay)
+
+}
@@ -0,0 +1,98 @@
+#include "test.h"
+
+#include <VEventDispatcher.h>
+#include <VEventLoop.h>
+
+NV_USING_NAMESPACE
+
+namespace {
+
+struct Position
+{
+    float x;
+    float y;
+    int flags;
+};
+
+void test()
+{
+    //Interning
+    {
+        VEventId unknown = VEventId::Find("veventidtest-unknown");
+        assert(!unknown.isValid());
+
+        VEventId id1("veventidtest-command");
+        VEventId id2(VString("veventidtest-command"));
+        assert(id1.isValid());
+        assert(id1 == id2);
+        assert(id1.name() == "veventidtest-command");
+        assert(id1.hash() == VEventId::Hash("veventidtest-command"));
+        assert(VEventId::Hash("veventidtest-command") == VEventId::Hash(VString("veventidtest-command")));
+        assert(VEventId::Find("veventidtest-command") == id1);
+        assert(VEventId::Find(VString("veventidtest-command")) == id1);
+
+        VEventId id3("veventidtest-other");
+        assert(id3 != id1);
+    }
+
+    //Named events resolve to registered ids
+    {
+        VEventId id("veventidtest-named");
+        VEvent event("veventidtest-named");
+        assert(event.id == id);
+        assert(event.isValid());
+
+        VEvent unnamed(id);
+        assert(unnamed.isValid());
+        assert(unnamed.name.isEmpty());
+    }
+
+    //Inline payloads
+    {
+        VEventId id("veventidtest-position");
+        VEventLoop loop(4);
+        Position position = {1.5f, -2.0f, 7};
+        loop.post(id, position);
+
+        VEvent event = loop.next();
+        assert(event.id == id);
+        assert(event.hasPayload());
+        assert(event.data.isNull());
+        const Position &received = event.payload<Position>();
+        assert(received.x == 1.5f);
+        assert(received.y == -2.0f);
+        assert(received.flags == 7);
+    }
+
+    //Dispatch table
+    {
+        VEventId plus("veventidtest-plus");
+        VEventId minus("veventidtest-minus");
+        VEventId ignored("veventidtest-ignored");
+
+        int result = 0;
+        VEventDispatcher dispatcher;
+        dispatcher.bind(plus, [&](const VEvent &event) {
+            result += event.payload<int>();
+        });
+        dispatcher.bind(minus, [&](const VEvent &event) {
+            result -= event.payload<int>();
+        });
+        assert(dispatcher.contains(plus));
+        assert(!dispatcher.contains(ignored));
+
+        assert(dispatcher.dispatch(VEvent(plus, 5)));
+        assert(dispatcher.dispatch(VEvent(minus, 2)));
+        assert(!dispatcher.dispatch(VEvent(ignored)));
+        assert(!dispatcher.dispatch(VEvent("veventidtest-unregistered")));
+        assert(result == 3);
+
+        dispatcher.unbind(plus);
+        assert(!dispatcher.dispatch(VEvent(plus, 5)));
+        assert(result == 3);
+    }
+}
+
+ADD_TEST(VEventId, test)
+
+}
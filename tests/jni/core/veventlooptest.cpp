@@ -3,7 +3,10 @@
 #include <VEventLoop.h>
 #include <VSemaphore.h>
 
+#include <atomic>
+#include <chrono>
 #include <thread>
+#include <vector>
 
 NV_USING_NAMESPACE
 
@@ -72,8 +75,163 @@ void test()
         assert(result == 10);
         release.wait();
     }
+
+    //drain() hands out a whole batch in order
+    {
+        VEventLoop loop(100);
+        for (int i = 0; i < 10; i++) {
+            loop.post("batch", i);
+        }
+
+        int expected = 0;
+        int count = loop.drain([&](const VEvent &event) {
+            assert(event.name == "batch");
+            assert(event.data.toInt() == expected);
+            expected++;
+        }, 4);
+        assert(count == 4);
+
+        count = loop.drain([&](const VEvent &event) {
+            assert(event.data.toInt() == expected);
+            expected++;
+        });
+        assert(count == 6);
+        assert(expected == 10);
+        assert(!loop.next().isValid());
+    }
+
+    //Posting into a full queue drops the event
+    {
+        VEventLoop loop(4);
+        for (int i = 0; i < 4; i++) {
+            assert(loop.post("full", i));
+        }
+        assert(!loop.post("full", 4));
+        int count = loop.drain([](const VEvent &) {});
+        assert(count == 4);
+    }
+
+    //Concurrent senders are each released by their own event
+    {
+        const int senderNum = 4;
+        const int sendNum = 100;
+        VEventLoop loop(8);
+        std::atomic<int> handled(0);
+        std::atomic<bool> stop(false);
+        std::thread receiver([&]{
+            while (!stop) {
+                loop.wait();
+                loop.drain([&](const VEvent &event) {
+                    if (event.name == "sync") {
+                        handled++;
+                    }
+                });
+            }
+        });
+
+        std::vector<std::thread> senders;
+        for (int i = 0; i < senderNum; i++) {
+            senders.push_back(std::thread([&]{
+                for (int j = 0; j < sendNum; j++) {
+                    int before = handled;
+                    loop.send("sync");
+                    assert(handled > before);
+                }
+            }));
+        }
+        for (std::thread &sender : senders) {
+            sender.join();
+        }
+        assert(handled == senderNum * sendNum);
+
+        stop = true;
+        loop.post("wake");
+        receiver.join();
+    }
+}
+
+void benchmark()
+{
+    const int eventNum = 200000;
+    const int maxProducers = std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+
+    for (int producerNum = 1; producerNum <= maxProducers; producerNum++) {
+        VEventLoop loop(4096);
+        std::atomic<int> received(0);
+        std::atomic<bool> stop(false);
+        std::thread consumer([&]{
+            while (!stop || received < eventNum) {
+                loop.wait();
+                received += loop.drain([](const VEvent &) {});
+            }
+        });
+
+        const int perProducer = eventNum / producerNum;
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> producers;
+        for (int i = 0; i < producerNum; i++) {
+            const int num = i == producerNum - 1 ? eventNum - perProducer * i : perProducer;
+            producers.push_back(std::thread([&loop, num]{
+                VEvent event("benchmark");
+                for (int j = 0; j < num; j++) {
+                    // Retry on a full queue so that every event gets through
+                    while (!loop.post(event)) {
+                        std::this_thread::yield();
+                    }
+                }
+            }));
+        }
+        for (std::thread &producer : producers) {
+            producer.join();
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        stop = true;
+        loop.post("wake");
+        consumer.join();
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        vInfo("VEventLoop: " << producerNum << " producer(s), " << (int) (eventNum / seconds) << " posts/sec");
+    }
+
+    //Named events with boxed data against interned ids with inline payloads
+    {
+        const int postNum = 4096;
+        const int rounds = 50;
+        VEventLoop loop(postNum);
+        VEventId id("benchmark");
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; i++) {
+            for (int j = 0; j < postNum; j++) {
+                VVariantArray args;
+                args << j << 1.0f << 2.0f;
+                loop.post("benchmark", std::move(args));
+            }
+            loop.drain([](const VEvent &event) {
+                assert(event.name == "benchmark");
+            });
+        }
+        auto middle = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; i++) {
+            for (int j = 0; j < postNum; j++) {
+                float args[3] = {static_cast<float>(j), 1.0f, 2.0f};
+                loop.post(id, args);
+            }
+            loop.drain([&](const VEvent &event) {
+                assert(event.id == id);
+            });
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        double named = std::chrono::duration<double>(middle - start).count();
+        double interned = std::chrono::duration<double>(end - middle).count();
+        vInfo("VEventLoop: named events " << (int) (postNum * rounds / named) << " posts/sec, "
+              << "interned events " << (int) (postNum * rounds / interned) << " posts/sec");
+    }
 }
 
 ADD_TEST(VEventLoop, test)
+ADD_TEST(VEventLoopBenchmark, benchmark)
 
 }
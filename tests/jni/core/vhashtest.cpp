@@ -0,0 +1,198 @@
+#include "test.h"
+
+#include <VHash.h>
+#include <VMap.h>
+#include <VStringHash.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <stdio.h>
+
+NV_USING_NAMESPACE
+
+namespace {
+
+void test()
+{
+    VHash<int, int> hash;
+    assert(hash.isEmpty());
+    assert(hash.size() == 0);
+    assert(!hash.contains(1));
+    assert(hash.value(1) == 0);
+    assert(hash.value(1, -1) == -1);
+    assert(hash.find(1) == hash.end());
+    assert(!hash.remove(1));
+
+    //Compared against std::map through growth, collisions and removals in every position
+    std::map<int, int> expected;
+    for (int i = 0; i < 5000; i++) {
+        const int key = (i * 7919) % 3001 - 1500;
+        if (i % 3 == 2) {
+            assert(hash.remove(key) == (expected.erase(key) == 1));
+        } else {
+            hash[key] = i;
+            expected[key] = i;
+        }
+        assert(hash.size() == expected.size());
+    }
+    for (const std::pair<const int, int> &pair : expected) {
+        assert(hash.contains(pair.first));
+        assert(hash.value(pair.first) == pair.second);
+        assert(hash.find(pair.first)->second == pair.second);
+    }
+    uint count = 0;
+    for (const std::pair<int, int> &entry : hash) {
+        assert(expected.at(entry.first) == entry.second);
+        count++;
+    }
+    assert(count == expected.size());
+
+    //Like VMap, insert() doesn't replace an existing value
+    hash.clear();
+    assert(hash.isEmpty());
+    hash.insert(5, 1);
+    hash.insert(5, 2);
+    assert(hash.value(5) == 1);
+    hash[5] = 3;
+    assert(hash[5] == 3);
+
+    //Removing everything leaves no stale slot behind
+    hash.clear();
+    hash.reserve(1000);
+    for (int i = 0; i < 1000; i++) {
+        hash[i * 16] = i;
+    }
+    for (int i = 0; i < 1000; i++) {
+        assert(hash.remove(i * 16));
+        assert(!hash.contains(i * 16));
+        assert(hash.size() == (uint) (999 - i));
+    }
+    assert(hash.isEmpty());
+    assert(!hash.contains(0));
+
+    VHash<uint, VString *> pointers;
+    assert(pointers.value(7) == nullptr);
+}
+
+ADD_TEST(VHash, test)
+
+void testStringHash()
+{
+    VStringHash<int> hash;
+    hash["apple"] = 1;
+    hash[VString("banana")] = 2;
+    hash.insert(VString("cherry"), 3);
+    assert(hash.size() == 3);
+
+    //Lookups by const char * don't build a VString and agree with VString keys
+    assert(VHashTraits<VString>::Hash("banana") == VHashTraits<VString>::Hash(VString("banana")));
+    assert(hash.contains("apple"));
+    assert(hash.value("banana") == 2);
+    assert(hash.value(VString("cherry")) == 3);
+    assert(!hash.contains("appl"));
+    assert(!hash.contains("apples"));
+    assert(!hash.contains(""));
+    assert(hash.value("durian", -1) == -1);
+    assert(hash.find("cherry")->second == 3);
+
+    hash[""] = 4;
+    assert(hash.contains(""));
+    assert(hash.value(VString()) == 4);
+
+    VString unicode;
+    unicode.append(char16_t(0x4e2d));
+    unicode.append(char16_t(0x6587));
+    hash[unicode] = 5;
+    assert(hash.value(unicode) == 5);
+
+    assert(hash.remove("apple"));
+    assert(!hash.contains(VString("apple")));
+    assert(hash.size() == 4);
+
+    const VStringHash<int> &constHash = hash;
+    assert(constHash["banana"] == 2);
+    assert(constHash["apple"] == 0);
+    assert(constHash.size() == 4);
+}
+
+ADD_TEST(VStringHash, testStringHash)
+
+double Nanoseconds(std::chrono::steady_clock::time_point start, uint operations)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / operations;
+}
+
+void benchmark()
+{
+    for (uint keyNum = 10; keyNum <= 1000000; keyNum *= 10) {
+        VArray<VString> keys;
+        VArray<VByteArray> rawKeys;
+        keys.reserve(keyNum);
+        rawKeys.reserve(keyNum);
+        for (uint i = 0; i < keyNum; i++) {
+            char key[64];
+            sprintf(key, "res/raw/sound_%u_effect.wav", i * 2654435761u);
+            keys.append(VString(key));
+            rawKeys.append(VByteArray(key));
+        }
+        //Each key is looked up about a million times in total whatever the size
+        const uint lookups = std::max(keyNum, 1000000u);
+
+        VMap<VString, int> map;
+        auto start = std::chrono::steady_clock::now();
+        for (uint i = 0; i < keyNum; i++) {
+            map.insert(keys[i], i);
+        }
+        const double mapInsert = Nanoseconds(start, keyNum);
+
+        int sum = 0;
+        start = std::chrono::steady_clock::now();
+        for (uint i = 0; i < lookups; i++) {
+            sum += map.value(keys[i % keyNum]);
+        }
+        const double mapLookup = Nanoseconds(start, lookups);
+
+        start = std::chrono::steady_clock::now();
+        for (uint i = 0; i < lookups; i++) {
+            sum += map.value(VString(rawKeys[i % keyNum].c_str()));
+        }
+        const double mapRawLookup = Nanoseconds(start, lookups);
+
+        VStringHash<int> hash;
+        start = std::chrono::steady_clock::now();
+        for (uint i = 0; i < keyNum; i++) {
+            hash.insert(keys[i], i);
+        }
+        const double hashInsert = Nanoseconds(start, keyNum);
+
+        start = std::chrono::steady_clock::now();
+        for (uint i = 0; i < lookups; i++) {
+            sum -= hash.value(keys[i % keyNum]);
+        }
+        const double hashLookup = Nanoseconds(start, lookups);
+
+        start = std::chrono::steady_clock::now();
+        for (uint i = 0; i < lookups; i++) {
+            sum -= hash.value(rawKeys[i % keyNum].c_str());
+        }
+        const double hashRawLookup = Nanoseconds(start, lookups);
+
+        start = std::chrono::steady_clock::now();
+        int misses = 0;
+        for (uint i = 0; i < lookups; i++) {
+            misses += hash.contains("res/raw/missing.wav") ? 0 : 1;
+        }
+        const double hashMiss = Nanoseconds(start, lookups);
+
+        assert(sum == 0 && misses == (int) lookups);
+        vInfo("VHash: " << keyNum << " keys, insert " << mapInsert << " -> " << hashInsert
+              << " ns, lookup " << mapLookup << " -> " << hashLookup
+              << " ns, const char * lookup " << mapRawLookup << " -> " << hashRawLookup
+              << " ns, miss " << hashMiss << " ns (VMap -> VStringHash)");
+    }
+}
+
+ADD_TEST(VHashBenchmark, benchmark)
+
+}
@@ -5,6 +5,10 @@
 #include <iomanip>
 
 #include <VJson.h>
+#include <VJsonDocument.h>
+#include <VJsonReader.h>
+
+#include <chrono>
 
 using namespace std;
 NV_USING_NAMESPACE
@@ -125,8 +129,186 @@ void test()
         assert(json.isObject());
         assert(json.size() == 0);
     }
+
+    //Parse from memory
+    {
+        VJson json = VJson::Parse(u8"{\"test\" : [1, -2.5e2, true, null, \"いつも好きです\"], \"empty\": {}}");
+        assert(json.isObject());
+        const VJson &test = json.value("test");
+        assert(test.size() == 5);
+        assert(test[0].toInt() == 1);
+        assert(test[1].toDouble() == -250.0);
+        assert(test[2].toBool());
+        assert(test[3].isNull());
+        assert(test[4].toString() == u"いつも好きです");
+        assert(json.value("empty").isObject());
+
+        assert(VJson::Parse("[1, 2").isNull());
+        assert(VJson::Parse("{\"key\" 1}").isNull());
+        assert(VJson::Parse("[1] 2").isNull());
+    }
+
+    //Escape sequences
+    {
+        VJson json = VJson::Parse("[\"quote\\\" slash\\/ backslash\\\\ tab\\t\", \"\\u00e9\\u4e2d\"]");
+        assert(json.at(0).toString() == "quote\" slash/ backslash\\ tab\t");
+        assert(json.at(1).toString() == u"\u00e9\u4e2d");
+
+        //A surrogate pair becomes one 4-byte UTF-8 sequence and back
+        VJson emoji = VJson::Parse("[\"\\ud83d\\ude00\"]");
+        assert(emoji.at(0).toString() == u"\U0001F600");
+    }
+
+    //SAX-style reading
+    {
+        struct Counter : public VJsonHandler
+        {
+            Counter() : objects(0), arrays(0), keys(0), numbers(0), sum(0) {}
+
+            bool onStartObject() override { objects++; return true; }
+            bool onStartArray() override { arrays++; return true; }
+            bool onKey(const char *key, uint length) override
+            {
+                keys++;
+                lastKey.assign(key, length);
+                return true;
+            }
+            bool onNumber(double value) override
+            {
+                numbers++;
+                sum += value;
+                return true;
+            }
+
+            int objects;
+            int arrays;
+            int keys;
+            int numbers;
+            double sum;
+            std::string lastKey;
+        };
+
+        VByteArray text = "{\"a\": [1, 2, {\"b\": 3}], \"c\\n\": 4}";
+        VJsonReader reader(text);
+        Counter counter;
+        assert(reader.parse(counter));
+        assert(!reader.hasError());
+        assert(counter.objects == 2);
+        assert(counter.arrays == 1);
+        assert(counter.keys == 3);
+        assert(counter.numbers == 4);
+        assert(counter.sum == 10);
+        assert(counter.lastKey == "c\n");
+
+        //In situ decoding writes over the source text
+        VByteArray copy = text;
+        VJsonReader inSitu = VJsonReader::InSitu(&copy[0], copy.size());
+        Counter inSituCounter;
+        assert(inSitu.parse(inSituCounter));
+        assert(inSituCounter.lastKey == "c\n");
+
+        //Handlers can stop parsing
+        struct Stopper : public VJsonHandler
+        {
+            bool onNumber(double value) override { return value < 2; }
+        };
+        Stopper stopper;
+        VJsonReader stopped(text);
+        assert(!stopped.parse(stopper));
+        assert(stopped.hasError());
+    }
+
+    //Arena-backed documents
+    {
+        VJsonDocument document;
+        assert(document.parse(u8"{\"name\": \"いつも\", \"list\": [1, \"two\\t\", [3]], \"flag\": false}"));
+        const VJsonValue &root = document.root();
+        assert(root.isObject());
+        assert(root.size() == 3);
+        assert(root["name"].toString() == u"いつも");
+        assert(root["list"].size() == 3);
+        assert(root["list"][0].toInt() == 1);
+        assert(root["list"][1].toString() == "two\t");
+        assert(root["list"][2][0].toInt() == 3);
+        assert(root.contains("flag"));
+        assert(!root["flag"].toBool());
+        assert(!root.contains("what"));
+        assert(root["what"].isNull());
+        assert(document.memoryUsage() > 0);
+
+        VJson json = root.toJson();
+        assert(json.value("name").toString() == u"いつも");
+        assert(json.value("list").at(2).at(0).toInt() == 3);
+
+        assert(!document.parse("{\"broken\": "));
+        assert(document.root().isNull());
+    }
+}
+
+VByteArray GenerateCatalog(int itemNum)
+{
+    stringstream s;
+    s << "{\"version\": 1, \"items\": [";
+    for (int i = 0; i < itemNum; i++) {
+        if (i > 0) {
+            s << ", ";
+        }
+        s << "{\"id\": " << i
+          << ", \"title\": \"Panorama #" << i << " \\\"sunset\\\"\""
+          << ", \"url\": \"/sdcard/Oculus/360Photos/pano_" << i << ".jpg\""
+          << ", \"rating\": " << (i % 50) / 10.0
+          << ", \"favorite\": " << (i % 3 == 0 ? "true" : "false")
+          << ", \"tags\": [\"outdoor\", \"travel\", \"" << i % 7 << "\"]}";
+    }
+    s << "]}";
+    return s.str();
+}
+
+template<typename Parse>
+void benchmark(const char *name, const VByteArray &catalog, const Parse &parse)
+{
+    const int rounds = 3;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        parse();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    vInfo("VJson " << name << ": " << catalog.size() * rounds / seconds / (1024 * 1024) << " MB/s");
+}
+
+void benchmark()
+{
+    VByteArray catalog = GenerateCatalog(20000);
+    vInfo("VJson catalog size: " << catalog.size() / 1024 << " KB");
+
+    benchmark("istream parser", catalog, [&]{
+        stringstream s;
+        s << catalog;
+        VJson json;
+        s >> json;
+        assert(json.value("items").size() == 20000);
+    });
+
+    benchmark("VJson::Parse", catalog, [&]{
+        VJson json = VJson::Parse(catalog);
+        assert(json.value("items").size() == 20000);
+    });
+
+    benchmark("VJsonReader", catalog, [&]{
+        VJsonHandler handler;
+        VJsonReader reader(catalog);
+        assert(reader.parse(handler));
+    });
+
+    benchmark("VJsonDocument", catalog, [&]{
+        VJsonDocument document;
+        assert(document.parse(catalog));
+        assert(document.root()["items"].size() == 20000);
+    });
 }
 
 ADD_TEST(VJson, test)
+ADD_TEST(VJsonBenchmark, benchmark)
 
 }
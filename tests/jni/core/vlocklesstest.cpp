@@ -0,0 +1,276 @@
+#include "test.h"
+
+#include <VAtomicInt.h>
+#include <VLockless.h>
+#include <VMutex.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+NV_USING_NAMESPACE
+
+namespace {
+
+//About the size of VRotationState, every field derives from serial and writer
+struct Sample
+{
+    vint64 serial;
+    uint writer;
+    float values[9];
+    double check;
+
+    Sample(vint64 serial = 0, uint writer = 0)
+        : serial(serial)
+        , writer(writer)
+        , check(serial * 3.0 + writer)
+    {
+        for (int i = 0; i < 9; i++) {
+            values[i] = static_cast<float>((serial + i) % 1000) + writer;
+        }
+    }
+
+    bool isConsistent() const
+    {
+        if (check != serial * 3.0 + writer) {
+            return false;
+        }
+        for (int i = 0; i < 9; i++) {
+            if (values[i] != static_cast<float>((serial + i) % 1000) + writer) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+struct Odd
+{
+    char bytes[7];
+};
+
+void test()
+{
+    //Values round trip, whatever their size
+    {
+        VLockless<bool> flag;
+        assert(flag.state() == false);
+        flag.setState(true);
+        assert(flag.state() == true);
+
+        VLockless<double> time(1.5);
+        assert(time.state() == 1.5);
+        time.setState(-2.25);
+        double value = 0.0;
+        assert(time.tryState(value, 0));
+        assert(value == -2.25);
+
+        VLockless<Odd> odd;
+        Odd bytes = {{1, 2, 3, 4, 5, 6, 7}};
+        odd.setState(bytes);
+        for (int i = 0; i < 7; i++) {
+            assert(odd.state().bytes[i] == i + 1);
+        }
+
+        VLockless<Sample> sample;
+        assert(sample.state().isConsistent() && sample.state().serial == 0);
+        for (int i = 1; i < 5; i++) {
+            sample.setState(Sample(i, 3));
+            assert(sample.state().serial == i && sample.state().isConsistent());
+        }
+    }
+
+    //The slots and the sequence don't share cache lines, by padding that holds on the heap too
+    assert(alignof(VLockless<bool>) < 64);
+    assert(sizeof(VLockless<bool>) >= 3 * 64);
+    VLockless<bool> *heap = new VLockless<bool>(true);
+    assert(heap->state());
+    delete heap;
+
+    //Several writers and readers: readers only see whole values, and values of a writer in the
+    //order it wrote them
+    {
+        const int writerCount = 2;
+        const int readerCount = 3;
+        const vint64 writes = 100000;
+        VLockless<Sample> shared;
+        std::atomic<int> writing(writerCount);
+        std::atomic<int> torn(0);
+        std::atomic<int> reordered(0);
+        std::atomic<vint64> reads(0);
+        std::atomic<vint64> gaveUp(0);
+
+        std::vector<std::thread> threads;
+        for (int w = 0; w < writerCount; w++) {
+            threads.push_back(std::thread([&, w]() {
+                for (vint64 i = 1; i <= writes; i++) {
+                    shared.setState(Sample(i, w + 1));
+                }
+                writing--;
+            }));
+        }
+        for (int r = 0; r < readerCount; r++) {
+            threads.push_back(std::thread([&, r]() {
+                vint64 last[writerCount + 1] = {0};
+                vint64 count = 0;
+                while (writing > 0) {
+                    Sample sample;
+                    if (r == 0) {
+                        if (!shared.tryState(sample, 0)) {
+                            gaveUp++;
+                            continue;
+                        }
+                    } else {
+                        sample = shared.state();
+                    }
+                    count++;
+                    if (!sample.isConsistent()) {
+                        torn++;
+                    }
+                    if (sample.serial < last[sample.writer]) {
+                        reordered++;
+                    }
+                    last[sample.writer] = sample.serial;
+                }
+                reads += count;
+            }));
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+
+        assert(torn == 0);
+        assert(reordered == 0);
+        const Sample last = shared.state();
+        assert(last.isConsistent() && last.serial == writes);
+        vDebug("VLockless: " << reads.load() << "reads," << gaveUp.load() << "given up");
+    }
+}
+
+ADD_TEST(VLockless, test)
+
+namespace reference {
+
+//The former implementation, single writer only
+template <class E>
+class TwoSlotLockless
+{
+public:
+    TwoSlotLockless() : m_begin(0), m_end(0) {}
+
+    E state() const
+    {
+        E state;
+        int begin, end, final;
+        forever {
+            end = m_end.exchangeAddSync(0);
+            state = m_slot[end & 1];
+            begin = m_begin.exchangeAddSync(0);
+            if (end == begin) {
+                return state;
+            }
+            state = m_slot[(begin & 1) ^ 1];
+            final = m_begin.exchangeAddSync(0);
+            if (final == begin) {
+                return state;
+            }
+        }
+    }
+
+    void setState(const E &state)
+    {
+        const int slot = m_begin.exchangeAddSync(1) & 1;
+        m_slot[slot ^ 1] = state;
+        m_end.exchangeAddSync(1);
+    }
+
+private:
+    mutable VAtomicInt m_begin;
+    mutable VAtomicInt m_end;
+    E m_slot[2];
+};
+
+template <class E>
+class Locked
+{
+public:
+    E state() const
+    {
+        m_mutex.lock();
+        E state = m_state;
+        m_mutex.unlock();
+        return state;
+    }
+
+    void setState(const E &state)
+    {
+        m_mutex.lock();
+        m_state = state;
+        m_mutex.unlock();
+    }
+
+private:
+    mutable VMutex m_mutex;
+    E m_state;
+};
+
+}
+
+//Nanoseconds per read on the reading threads while a writer updates the value, as a 1 kHz sensor
+//does or as fast as it can
+template <class Shared>
+double ReadCost(int readerCount, bool flood)
+{
+    Shared shared;
+    std::atomic<bool> running(true);
+    std::thread writer([&]() {
+        for (vint64 i = 1; running; i++) {
+            shared.setState(Sample(i, 1));
+            if (!flood) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    });
+
+    const int reads = 200000;
+    std::atomic<double> total(0.0);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < readerCount; r++) {
+        readers.push_back(std::thread([&]() {
+            double sum = 0.0;
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < reads; i++) {
+                sum += shared.state().check;
+            }
+            const double nanoseconds = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            assert(sum >= 0.0);
+            double expected = total.load();
+            while (!total.compare_exchange_weak(expected, expected + nanoseconds / reads)) {
+            }
+        }));
+    }
+    for (std::thread &reader : readers) {
+        reader.join();
+    }
+    running = false;
+    writer.join();
+    return total.load() / readerCount;
+}
+
+void benchmark()
+{
+    const int readerCounts[] = {1, 3};
+    for (int readerCount : readerCounts) {
+        for (int flood = 0; flood < 2; flood++) {
+            vInfo("VLockless: " << readerCount << " reader(s), writer " << (flood ? "flooding" : "at 1 kHz") << ": "
+                  << ReadCost<reference::Locked<Sample>>(readerCount, flood) << " ns per read with a mutex, "
+                  << ReadCost<reference::TwoSlotLockless<Sample>>(readerCount, flood) << " ns two-slot, "
+                  << ReadCost<VLockless<Sample>>(readerCount, flood) << " ns seqlock");
+        }
+    }
+}
+
+ADD_TEST(VLocklessBenchmark, benchmark)
+
+}
@@ -0,0 +1,250 @@
+#include "test.h"
+
+#include <VLog.h>
+#include <VSemaphore.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+NV_USING_NAMESPACE
+
+namespace {
+
+struct Capture
+{
+    std::mutex mutex;
+    std::vector<std::string> texts;
+    std::vector<VLog::Priority> priorities;
+
+    VLog::Sink sink()
+    {
+        return [this](const VLog::Message &message) {
+            std::lock_guard<std::mutex> locker(mutex);
+            assert(message.text[message.length] == '\0');
+            texts.push_back(std::string(message.text, message.length));
+            priorities.push_back(message.priority);
+        };
+    }
+};
+
+void test()
+{
+    Capture capture;
+    VLog::SetSink(capture.sink());
+
+    //Values are separated by spaces
+    {
+        int negative = -42;
+        ulonglong big = 18446744073709551615ull;
+        vWarn("VLog:" << negative << 7u << big << 2.5 << 'x' << VString(u"é\U0001F600") << std::string("end"));
+        VLog::Flush();
+        assert(capture.texts.size() == 1);
+        assert(capture.texts[0] == "VLog: -42 7 18446744073709551615 2.5 x \xc3\xa9\xf0\x9f\x98\x80 end");
+        assert(capture.priorities[0] == VLog::Warn);
+    }
+
+    //Messages are truncated, not dropped, when too long
+    {
+        std::string longText(5000, 'a');
+        vError(longText);
+        VLog::Flush();
+        assert(capture.texts.size() == 2);
+        assert(capture.texts[1].size() > 500 && capture.texts[1].size() < 5000);
+    }
+
+    //Arguments of filtered messages aren't evaluated
+    {
+        int evaluated = 0;
+        VLog::SetPriority("vlogtest.cpp", VLog::Warn);
+        vDebug("filtered" << ++evaluated);
+        vWarn("kept" << ++evaluated);
+        VLog::SetPriority("core/vlogtest.cpp", VLog::Verbose);
+        vDebug("longer pattern" << ++evaluated);
+        VLog::SetPriority("core/vlogtest.cpp", VLog::Error);
+        vWarn("filtered again" << ++evaluated);
+        VLog::ResetPriorities();
+        VLog::SetPriority(VLog::Silent);
+        vError("silenced" << ++evaluated);
+        VLog::ResetPriorities();
+        VLog::Flush();
+        assert(evaluated == 2);
+        assert(capture.texts.size() == 4);
+        assert(capture.texts[2] == "kept 1");
+        assert(capture.texts[3] == "longer pattern 2");
+    }
+
+    //Messages from concurrent threads all arrive, in order per thread
+    {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++) {
+            threads.push_back(std::thread([t]() {
+                for (int i = 0; i < 50; i++) {
+                    vWarn("thread" << t << i);
+                    if (i % 10 == 9) {
+                        VLog::Flush();
+                    }
+                }
+            }));
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        VLog::Flush();
+        assert(capture.texts.size() == 4 + 4 * 50);
+        int next[4] = {0, 0, 0, 0};
+        for (uint i = 4; i < capture.texts.size(); i++) {
+            int t, n;
+            assert(sscanf(capture.texts[i].c_str(), "thread %d %d", &t, &n) == 2);
+            assert(n == next[t]);
+            next[t]++;
+        }
+    }
+
+    //The logger doesn't wait for more messages, nor for a flush, to write a lone one
+    {
+        vWarn("lone");
+        bool written = false;
+        for (int i = 0; i < 1000 && !written; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            std::lock_guard<std::mutex> locker(capture.mutex);
+            written = capture.texts.size() == 4 + 4 * 50 + 1;
+        }
+        assert(written);
+        assert(capture.texts.back() == "lone");
+    }
+
+    //A stalled sink makes the ring overflow, the callers carry on and the losses are counted
+    {
+        VSemaphore entered;
+        VSemaphore resume;
+        std::atomic<bool> stalled(true);
+        VLog::SetSink([&](const VLog::Message &) {
+            if (stalled) {
+                stalled = false;
+                entered.post();
+                resume.wait();
+            }
+        });
+        vError("stall");
+        entered.wait();
+
+        const uint dropped = VLog::DroppedCount();
+        for (int i = 0; i < 1000; i++) {
+            vWarn("overflow" << i);
+        }
+        assert(VLog::DroppedCount() - dropped >= 1000 - 256);
+        resume.post();
+        VLog::Flush();
+    }
+
+    VLog::SetSink(VLog::Sink());
+}
+
+ADD_TEST(VLog, test)
+
+void shutdown()
+{
+    Capture capture;
+    const VLog::Sink captured = capture.sink();
+    std::thread::id writer;
+    VLog::SetSink([&captured, &writer](const VLog::Message &message) {
+        writer = std::this_thread::get_id();
+        captured(message);
+        if (strcmp(message.text, "echo") == 0) {
+            vWarn("echoed");
+        }
+    });
+
+    vWarn("before");
+    VLog::Shutdown();
+    assert(capture.texts.size() == 1 && capture.texts[0] == "before");
+
+    //Later messages are written by the threads logging them, a sink that logs included
+    vWarn("after");
+    assert(capture.texts.size() == 2 && capture.texts[1] == "after");
+    assert(writer == std::this_thread::get_id());
+    vWarn("echo");
+    assert(capture.texts.size() == 4 && capture.texts[3] == "echoed");
+
+    VLog::Shutdown();
+    VLog::Flush();
+
+    //The tests after this one log through the thread again
+    VLog::Init();
+    vWarn("restarted");
+    VLog::Flush();
+    assert(capture.texts.size() == 5 && capture.texts[4] == "restarted");
+    assert(writer != std::this_thread::get_id());
+    VLog::Init();
+
+    VLog::SetSink(VLog::Sink());
+}
+
+ADD_TEST(VLogShutdown, shutdown)
+
+double Nanoseconds(std::chrono::steady_clock::time_point start, uint calls)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+}
+
+void benchmark()
+{
+    //What a call cost before: a heap allocated stringstream, written out synchronously
+    FILE *null = fopen("/dev/null", "w");
+    assert(null != nullptr);
+    const uint calls = 100;
+    const uint rounds = 200;
+    double synchronous = 0.0;
+    for (uint round = 0; round < rounds; round++) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint i = 0; i < calls; i++) {
+            std::stringstream *buffer = new std::stringstream;
+            *buffer << "Frame" << ' ' << i << ' ' << "took" << ' ' << 16.6 << ' ' << "ms" << ' ';
+            fprintf(null, "%s [Line %u] %s\n", __FILE__, __LINE__, buffer->str().data());
+            fflush(null);
+            delete buffer;
+        }
+        synchronous += Nanoseconds(start, calls) / rounds;
+    }
+
+    //The ring holds 256 messages, it's drained between rounds so that none is dropped
+    VLog::SetSink([null](const VLog::Message &message) {
+        fprintf(null, "%s [Line %u] %s\n", message.file, message.line, message.text);
+    });
+    const uint dropped = VLog::DroppedCount();
+    double asynchronous = 0.0;
+    for (uint round = 0; round < rounds; round++) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint i = 0; i < calls; i++) {
+            vWarn("Frame" << i << "took" << 16.6 << "ms");
+        }
+        asynchronous += Nanoseconds(start, calls) / rounds;
+        VLog::Flush();
+    }
+    assert(VLog::DroppedCount() == dropped);
+
+    VLog::SetPriority("vlogtest.cpp", VLog::Error);
+    auto start = std::chrono::steady_clock::now();
+    for (uint i = 0; i < calls * rounds; i++) {
+        vWarn("Frame" << i << "took" << 16.6 << "ms");
+    }
+    const double filtered = Nanoseconds(start, calls * rounds);
+    VLog::ResetPriorities();
+
+    VLog::Flush();
+    VLog::SetSink(VLog::Sink());
+    fclose(null);
+
+    vInfo("VLog: " << synchronous << " -> " << asynchronous << " ns per call on the calling thread, "
+          << filtered << " ns per filtered call (stringstream and synchronous write -> VLog)");
+}
+
+ADD_TEST(VLogBenchmark, benchmark)
+
+}
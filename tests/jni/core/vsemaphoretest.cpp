@@ -33,6 +33,12 @@ void test()
     finished.wait();
 
     assert(result == 200);
+
+    //Timed wait
+    VSemaphore timed;
+    assert(!timed.wait(10u));
+    timed.post();
+    assert(timed.wait(10u));
 }
 
 ADD_TEST(VSemaphore, test)
@@ -1,6 +1,7 @@
 #include "test.h"
 
 #include <VString.h>
+#include <chrono>
 #include <string>
 
 NV_USING_NAMESPACE
@@ -296,4 +297,309 @@ void test()
 
 ADD_TEST(VString, test)
 
+// Character by character references, the way VString converted text before it was vectorized
+VByteArray ScalarToUtf8(const VString &str)
+{
+    VByteArray utf8;
+    for (uint i = 0; i < str.size(); i++) {
+        uint code = str[i];
+        if (code >= 0xd800 && code <= 0xdbff && i + 1 < str.size() && str[i + 1] >= 0xdc00 && str[i + 1] <= 0xdfff) {
+            code = ((code - 0xd800) << 10) + (str[++i] - 0xdc00) + 0x10000;
+        } else if (code >= 0xd800 && code <= 0xdfff) {
+            code = 0xfffd;
+        }
+
+        if (code <= 0x7f) {
+            utf8.append(static_cast<char>(code));
+        } else if (code <= 0x7ff) {
+            utf8.append(static_cast<char>(0xc0 | (code >> 6)));
+            utf8.append(static_cast<char>(0x80 | (code & 0x3f)));
+        } else if (code <= 0xffff) {
+            utf8.append(static_cast<char>(0xe0 | (code >> 12)));
+            utf8.append(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+            utf8.append(static_cast<char>(0x80 | (code & 0x3f)));
+        } else {
+            utf8.append(static_cast<char>(0xf0 | (code >> 18)));
+            utf8.append(static_cast<char>(0x80 | ((code >> 12) & 0x3f)));
+            utf8.append(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+            utf8.append(static_cast<char>(0x80 | (code & 0x3f)));
+        }
+    }
+    return utf8;
+}
+
+VString ScalarFromUtf8(const VByteArray &utf8)
+{
+    VString utf16;
+    uint code = 0;
+    int following = 0;
+    for (const char &byte : utf8) {
+        const uchar ch = byte;
+        if (ch <= 0x7f) {
+            code = ch;
+            following = 0;
+        } else if (ch <= 0xbf) {
+            code = (code << 6) | (ch & 0x3f);
+            --following;
+        } else if (ch <= 0xdf) {
+            code = ch & 0x1f;
+            following = 1;
+        } else if (ch <= 0xef) {
+            code = ch & 0x0f;
+            following = 2;
+        } else {
+            code = ch & 0x07;
+            following = 3;
+        }
+
+        if (following == 0) {
+            if (code > 0xffff) {
+                code -= 0x10000;
+                utf16.append(static_cast<char16_t>(0xd800 + (code >> 10)));
+                utf16.append(static_cast<char16_t>(0xdc00 + (code & 0x03ff)));
+            } else {
+                utf16.append(static_cast<char16_t>(code));
+            }
+        }
+    }
+    return utf16;
+}
+
+VString ScalarFromLatin1(const char *str, uint length)
+{
+    VString utf16;
+    utf16.resize(length);
+    for (uint i = 0; i < length; i++) {
+        utf16[i] = static_cast<uchar>(str[i]);
+    }
+    return utf16;
+}
+
+VByteArray ScalarToLatin1(const VString &str)
+{
+    VByteArray latin1;
+    latin1.resize(str.size());
+    for (uint i = 0; i < str.size(); i++) {
+        latin1[i] = static_cast<char>(str[i]);
+    }
+    return latin1;
+}
+
+// Mostly ASCII with asciiPercent, the rest spread over 2, 3 and 4-byte UTF-8 sequences
+VString RandomText(uint length, int asciiPercent, uint &seed)
+{
+    VString str;
+    while (str.size() < length) {
+        seed = seed * 1103515245u + 12345u;
+        const uint random = seed >> 8;
+        if ((int) (random % 100) < asciiPercent) {
+            str.append(static_cast<char16_t>(0x20 + random / 100 % 0x5f));
+        } else if (random % 3 == 0) {
+            str.append(static_cast<char16_t>(0x80 + random / 100 % 0x780));
+        } else if (random % 3 == 1) {
+            char16_t unit = static_cast<char16_t>(0x800 + random / 100 % 0xf800);
+            str.append(unit >= 0xd800 && unit <= 0xdfff ? char16_t(0x4e2d) : unit);
+        } else {
+            const uint code = random / 100 % 0x100000;
+            str.append(static_cast<char16_t>(0xd800 + (code >> 10)));
+            str.append(static_cast<char16_t>(0xdc00 + (code & 0x3ff)));
+        }
+    }
+    return str;
+}
+
+void testTranscoding()
+{
+    //Round trips at every length around the 16-unit blocks, with non-ASCII in every position
+    uint seed = 1;
+    for (int asciiPercent = 0; asciiPercent <= 100; asciiPercent += 20) {
+        for (uint length = 0; length < 80; length++) {
+            const VString str = RandomText(length, asciiPercent, seed);
+            const VByteArray utf8 = str.toUtf8();
+            assert(utf8 == ScalarToUtf8(str));
+            assert(VString::fromUtf8(utf8) == str);
+            assert(ScalarFromUtf8(utf8) == str);
+
+            const VByteArray latin1 = ScalarToLatin1(str);
+            assert(str.toLatin1() == latin1);
+            assert(VString::fromLatin1(latin1) == ScalarFromLatin1(latin1.data(), latin1.size()));
+            assert(VString(latin1.data(), latin1.size()) == VString::fromLatin1(latin1));
+        }
+    }
+
+    //Every Latin-1 byte is zero-extended, not sign-extended
+    {
+        char bytes[256];
+        for (int i = 0; i < 256; i++) {
+            bytes[i] = static_cast<char>(i);
+        }
+        VString str(bytes, 256);
+        for (int i = 0; i < 256; i++) {
+            assert(str[i] == i);
+        }
+        assert(str.toLatin1() == VByteArray(bytes, 256));
+
+        VString appended("prefix");
+        appended.append(bytes + 128, 128);
+        assert(appended.size() == 6 + 128);
+        assert(appended[6] == 0x80 && appended.back() == 0xff);
+
+        const char *accented = "\xe9t\xe9";
+        VString latin1(accented);
+        assert(latin1.length() == 3 && latin1[0] == 0xe9);
+        assert(latin1 == accented);
+        assert(latin1.compare("\xe9t\xe8") > 0);
+        assert(latin1.compare("\x7ft\xe9") > 0);
+        assert(latin1.toUtf8() == "\xc3\xa9t\xc3\xa9");
+    }
+
+    //Characters outside the BMP are one 4-byte sequence
+    {
+        VString emoji(u"a\U0001F600b");
+        assert(emoji.size() == 4);
+        assert(emoji.toUtf8() == "a\xF0\x9F\x98\x80" "b");
+        assert(VString::fromUtf8(VByteArray("\xF0\x9F\x98\x80")) == u"\U0001F600");
+        assert(VString::fromUtf8(VByteArray("\xF4\x8F\xBF\xBF")) == u"\U0010FFFF");
+    }
+
+    //Malformed UTF-8 becomes U+FFFD and decoding resumes at the next possible character
+    {
+        struct
+        {
+            const char *utf8;
+            const char16_t *utf16;
+        } cases[] = {
+            {"\x80", u"\ufffd"},
+            {"a\xbfz", u"a\ufffdz"},
+            {"\xc3", u"\ufffd"},
+            {"\xc3z", u"\ufffdz"},
+            {"\xe4\xb8", u"\ufffd"},
+            {"\xe4\xb8z\xe4\xb8\xad", u"\ufffdz\u4e2d"},
+            {"\xc0\xaf", u"\ufffd\ufffd"},
+            {"\xe0\x80\xaf", u"\ufffd"},
+            {"\xed\xa0\x80", u"\ufffd"},
+            {"\xf4\x90\x80\x80", u"\ufffd"},
+            {"\xf8\x88\x80\x80\x80", u"\ufffd\ufffd\ufffd\ufffd\ufffd"},
+            {"\xff", u"\ufffd"},
+        };
+        for (const auto &test : cases) {
+            assert(VString::fromUtf8(VByteArray(test.utf8)) == test.utf16);
+        }
+
+        //Unpaired surrogates can't be encoded
+        VString lone;
+        lone.append(char16_t(0xd83d));
+        lone.append('x');
+        lone.append(char16_t(0xde00));
+        assert(lone.toUtf8() == "\xef\xbf\xbdx\xef\xbf\xbd");
+    }
+
+    //Views
+    {
+        const VByteArray bytes("res/raw/efigs.fnt");
+        VByteArrayView view(bytes);
+        assert(view.data() == bytes.data());
+        assert(view.size() == bytes.size());
+        assert(view == "res/raw/efigs.fnt");
+        assert(view.startsWith("res/"));
+        assert(view.endsWith(".fnt"));
+        assert(!view.endsWith("res/raw/efigs.fnt.fnt"));
+        assert(view.mid(8) == "efigs.fnt");
+        assert(view.mid(8, 5) == "efigs");
+        assert(view.left(3) == "res");
+        assert(view.right(3) == "fnt");
+        assert(view.lastIndexOf('/') == 7);
+        assert(view.lastIndexOf('?') == -1);
+        assert(view.toByteArray() == bytes);
+        assert(VByteArrayView().isEmpty());
+
+        const VString str(u"\u79c1\u306fnervgear");
+        VStringView strView(str);
+        assert(strView.data() == str.data());
+        assert(strView.mid(2) == VStringView(u"nervgear", 8));
+        assert(strView.left(2).toUtf8() == "\xe7\xa7\x81\xe3\x81\xaf");
+        assert(strView.right(4).toLatin1() == "gear");
+        assert(strView.startsWith(VStringView(str.data(), 1)));
+        assert(strView.endsWith(VStringView(u"gear", 4)));
+        assert(strView.toString() == str);
+    }
+}
+
+ADD_TEST(VStringTranscoding, testTranscoding)
+
+double GigabytesPerSecond(std::chrono::steady_clock::time_point start, double bytes)
+{
+    return bytes / std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+void benchmark()
+{
+    //Small enough for the allocations to stay off mmap(), which would dominate otherwise
+    const uint length = 4096;
+    const uint rounds = 5000;
+    const char *names[] = {"ASCII", "mixed"};
+    const int asciiPercents[] = {100, 90};
+    for (int i = 0; i < 2; i++) {
+        uint seed = 7;
+        const VString str = RandomText(length, asciiPercents[i], seed);
+        const VByteArray utf8 = str.toUtf8();
+        const VByteArray latin1 = str.toLatin1();
+        uint check = 0;
+
+        //UTF-16 bytes are counted for each direction so the numbers compare
+        const double bytes = double(str.size()) * sizeof(char16_t) * rounds;
+        auto start = std::chrono::steady_clock::now();
+        for (uint round = 0; round < rounds; round++) {
+            check += ScalarToUtf8(str).size();
+        }
+        const double scalarToUtf8 = GigabytesPerSecond(start, bytes);
+        start = std::chrono::steady_clock::now();
+        for (uint round = 0; round < rounds; round++) {
+            check -= str.toUtf8().size();
+        }
+        const double toUtf8 = GigabytesPerSecond(start, bytes);
+
+        start = std::chrono::steady_clock::now();
+        for (uint round = 0; round < rounds; round++) {
+            check += ScalarFromUtf8(utf8).size();
+        }
+        const double scalarFromUtf8 = GigabytesPerSecond(start, bytes);
+        start = std::chrono::steady_clock::now();
+        for (uint round = 0; round < rounds; round++) {
+            check -= VString::fromUtf8(utf8).size();
+        }
+        const double fromUtf8 = GigabytesPerSecond(start, bytes);
+
+        start = std::chrono::steady_clock::now();
+        for (uint round = 0; round < rounds; round++) {
+            check += ScalarFromLatin1(latin1.data(), latin1.size()).size();
+        }
+        const double scalarFromLatin1 = GigabytesPerSecond(start, bytes);
+        start = std::chrono::steady_clock::now();
+        for (uint round = 0; round < rounds; round++) {
+            check -= VString(latin1.data(), latin1.size()).size();
+        }
+        const double fromLatin1 = GigabytesPerSecond(start, bytes);
+
+        start = std::chrono::steady_clock::now();
+        for (uint round = 0; round < rounds; round++) {
+            check += ScalarToLatin1(str).size();
+        }
+        const double scalarToLatin1 = GigabytesPerSecond(start, bytes);
+        start = std::chrono::steady_clock::now();
+        for (uint round = 0; round < rounds; round++) {
+            check -= str.toLatin1().size();
+        }
+        const double toLatin1 = GigabytesPerSecond(start, bytes);
+
+        assert(check == 0);
+        vInfo("VString: " << names[i] << " text, toUtf8 " << scalarToUtf8 << " -> " << toUtf8
+              << " GB/s, fromUtf8 " << scalarFromUtf8 << " -> " << fromUtf8
+              << " GB/s, VString(const char *) " << scalarFromLatin1 << " -> " << fromLatin1
+              << " GB/s, toLatin1 " << scalarToLatin1 << " -> " << toLatin1 << " GB/s (scalar -> VString)");
+    }
+}
+
+ADD_TEST(VStringBenchmark, benchmark)
+
 }
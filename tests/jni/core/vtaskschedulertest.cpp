@@ -0,0 +1,275 @@
+#include "test.h"
+
+#include <VTaskScheduler.h>
+#include <VImage.h>
+#include <VJson.h>
+#include <VThread.h>
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+NV_USING_NAMESPACE
+
+namespace {
+
+void test()
+{
+    VTaskScheduler scheduler(3, -1);
+    assert(scheduler.workerCount() == 3);
+
+    //A task runs once and can be waited on more than once
+    {
+        std::atomic<int> runs(0);
+        VTaskScheduler::Task task = scheduler.spawn([&]() { runs++; });
+        assert(!task.isNull());
+        scheduler.wait(task);
+        scheduler.wait(task);
+        assert(task.isFinished());
+        assert(runs == 1);
+    }
+
+    //Dependencies finish first, whatever order they run in
+    {
+        std::atomic<int> finished(0);
+        VArray<VTaskScheduler::Task> dependencies;
+        for (int i = 0; i < 16; i++) {
+            dependencies.append(scheduler.spawn([&]() {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                finished++;
+            }));
+        }
+        int seen = -1;
+        VTaskScheduler::Task task = scheduler.spawn([&]() { seen = finished; }, dependencies);
+        scheduler.wait(task);
+        assert(seen == 16);
+
+        //A finished dependency or a null task doesn't hold anything back
+        dependencies.append(VTaskScheduler::Task());
+        VTaskScheduler::Task late = scheduler.spawn([&]() { seen = -2; }, dependencies);
+        scheduler.wait(late);
+        assert(seen == -2);
+    }
+
+    //Continuations chain
+    {
+        std::vector<int> order;
+        VTaskScheduler::Task task = scheduler.spawn([&]() { order.push_back(1); });
+        for (int i = 2; i <= 5; i++) {
+            task = scheduler.then(task, [&order, i]() { order.push_back(i); });
+        }
+        scheduler.wait(task);
+        assert(order == std::vector<int>({1, 2, 3, 4, 5}));
+    }
+
+    //Tasks spawning and waiting on tasks don't deadlock, more of them than there are workers
+    {
+        std::atomic<int> leaves(0);
+        VArray<VTaskScheduler::Task> roots;
+        for (int i = 0; i < 8; i++) {
+            roots.append(scheduler.spawn([&]() {
+                VArray<VTaskScheduler::Task> children;
+                for (int j = 0; j < 64; j++) {
+                    children.append(scheduler.spawn([&]() { leaves++; }));
+                }
+                scheduler.wait(children);
+            }));
+        }
+        scheduler.wait(roots);
+        assert(leaves == 8 * 64);
+    }
+
+    //Background tasks don't take every worker, critical ones still get through
+    {
+        std::atomic<bool> release(false);
+        std::atomic<int> blocked(0);
+        VArray<VTaskScheduler::Task> loads;
+        for (int i = 0; i < 6; i++) {
+            loads.append(scheduler.spawn([&]() {
+                blocked++;
+                while (!release) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }, VTaskScheduler::BackgroundPriority));
+        }
+        std::atomic<bool> ran(false);
+        VTaskScheduler::Task critical = scheduler.spawn([&]() { ran = true; }, VTaskScheduler::CriticalPriority);
+        scheduler.wait(critical);
+        assert(ran);
+        assert(blocked <= 1);
+        release = true;
+        scheduler.wait(loads);
+        assert(blocked == 6);
+    }
+
+    //Every index is visited exactly once
+    {
+        const int sizes[] = {0, 1, 7, 100, 10000};
+        const int grains[] = {0, 1, 3, 64, 100000};
+        for (int size : sizes) {
+            for (int grain : grains) {
+                std::vector<std::atomic<int>> visits(size + 10);
+                for (std::atomic<int> &visit : visits) {
+                    visit = 0;
+                }
+                scheduler.parallelFor(10, size + 10, [&](int begin, int end) {
+                    assert(begin < end);
+                    for (int i = begin; i < end; i++) {
+                        visits[i]++;
+                    }
+                }, grain);
+                for (int i = 0; i < size + 10; i++) {
+                    assert(visits[i] == (i >= 10 ? 1 : 0));
+                }
+            }
+        }
+    }
+
+    //Nested parallelFor from the workers
+    {
+        std::atomic<int> sum(0);
+        scheduler.parallelFor(0, 16, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                scheduler.parallelFor(0, 100, [&](int first, int last) {
+                    sum += last - first;
+                }, 10);
+            }
+        }, 1);
+        assert(sum == 1600);
+    }
+
+    assert(VTaskScheduler::instance() == VTaskScheduler::instance());
+    assert(VTaskScheduler::instance()->workerCount() >= 1);
+}
+
+ADD_TEST(VTaskScheduler, test)
+
+double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+VImage MakeImage(int width, int height)
+{
+    uchar *pixels = (uchar *) malloc(width * height * 4);
+    uint seed = 7;
+    for (int i = 0; i < width * height * 4; i++) {
+        seed = seed * 1103515245u + 12345u;
+        pixels[i] = (uchar) (((i >> 2) % width) + (seed >> 28));
+    }
+    return VImage(pixels, width, height);
+}
+
+std::string MakeJson(int index)
+{
+    std::stringstream json;
+    json << "{\"index\": " << index << ", \"models\": [";
+    for (int i = 0; i < 200; i++) {
+        json << (i ? ", " : "") << "{\"name\": \"model" << i << "\", \"position\": [" << i * 0.5 << ", 1.5, -2.25], \"visible\": true}";
+    }
+    json << "]}";
+    return json.str();
+}
+
+//Fork/join overhead against a thread per job, and the speedup on work the SDK does while loading
+void benchmark()
+{
+    VTaskScheduler *scheduler = VTaskScheduler::instance();
+
+    {
+        const int count = 100000;
+        std::atomic<int> runs(0);
+        VArray<VTaskScheduler::Task> tasks;
+        tasks.reserve(count);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            tasks.append(scheduler->spawn([&]() { runs++; }));
+        }
+        scheduler->wait(tasks);
+        const double taskSeconds = Seconds(start);
+        assert(runs == count);
+
+        const int threadCount = 1000;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < threadCount; i++) {
+            std::thread([&]() { runs++; }).join();
+        }
+        const double threadSeconds = Seconds(start);
+
+        const int calls = 10000;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; i++) {
+            scheduler->parallelFor(0, 64, [&](int begin, int end) { runs += end - begin; }, 8);
+        }
+        const double forSeconds = Seconds(start);
+
+        vInfo("VTaskScheduler: " << taskSeconds / count * 1e9 << " ns per empty task, "
+              << forSeconds / calls * 1e9 << " ns per parallelFor, "
+              << threadSeconds / threadCount * 1e9 << " ns per std::thread started and joined");
+    }
+
+    {
+        const VImage source = MakeImage(512, 512);
+        const int count = 40;
+        std::vector<VImage> images(count, source);
+        auto start = std::chrono::steady_clock::now();
+        for (VImage &image : images) {
+            image.resize(256, 256, VImage::CubicFilter);
+        }
+        const double serial = Seconds(start);
+
+        std::vector<VImage> parallelImages(count, source);
+        start = std::chrono::steady_clock::now();
+        scheduler->parallelFor(0, count, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                parallelImages[i].resize(256, 256, VImage::CubicFilter);
+            }
+        }, 1);
+        const double parallel = Seconds(start);
+        assert(parallelImages[count - 1].width() == 256);
+
+        vInfo("VTaskScheduler: " << count << " images 512x512 to 256x256 " << serial * 1e3 << " -> "
+              << parallel * 1e3 << " ms, x" << serial / parallel);
+    }
+
+    {
+        const int count = 64;
+        std::vector<std::string> documents;
+        for (int i = 0; i < count; i++) {
+            documents.push_back(MakeJson(i));
+        }
+        std::vector<VJson> parsed(count);
+        auto parse = [&](int i) {
+            std::stringstream stream(documents[i]);
+            stream >> parsed[i];
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            parse(i);
+        }
+        const double serial = Seconds(start);
+
+        parsed.assign(count, VJson());
+        start = std::chrono::steady_clock::now();
+        scheduler->parallelFor(0, count, [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                parse(i);
+            }
+        }, 1);
+        const double parallel = Seconds(start);
+        for (int i = 0; i < count; i++) {
+            assert(parsed[i].value("index").toInt() == i);
+        }
+
+        vInfo("VTaskScheduler: " << count << " json documents " << serial * 1e3 << " -> "
+              << parallel * 1e3 << " ms, x" << serial / parallel << " on " << VThread::CpuCount() << " cpus");
+    }
+}
+
+ADD_TEST(VTaskSchedulerBenchmark, benchmark)
+
+}
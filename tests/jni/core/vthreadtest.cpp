@@ -0,0 +1,165 @@
+#include "test.h"
+
+#include <VSemaphore.h>
+#include <VThread.h>
+
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+NV_USING_NAMESPACE
+
+namespace {
+
+// Reports what the system says about the thread it runs on, then waits to be released
+class ProbeThread : public VThread
+{
+public:
+    ProbeThread()
+        : probedTid(0)
+        , nice(0)
+        , cpuMask(0)
+        , spin(0)
+    {
+        name[0] = '\0';
+    }
+
+    void probe()
+    {
+        probedTid = syscall(__NR_gettid);
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        errno = 0;
+        nice = getpriority(PRIO_PROCESS, 0);
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        sched_getaffinity(0, sizeof(set), &set);
+        cpuMask = 0;
+        for (uint cpu = 0; cpu < sizeof(ulong) * 8; cpu++) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpuMask |= 1ul << cpu;
+            }
+        }
+    }
+
+    int probedTid;
+    char name[16];
+    int nice;
+    ulong cpuMask;
+    //Nanoseconds of cpu time to burn before exiting
+    vint64 spin;
+
+    VSemaphore probed;
+    VSemaphore release;
+
+protected:
+    int run() override
+    {
+        probe();
+        probed.post();
+        release.wait();
+        probe();
+        probed.post();
+        release.wait();
+
+        const vint64 start = CurrentCpuTime();
+        volatile uint sum = 0;
+        while (CurrentCpuTime() - start < spin) {
+            for (int i = 0; i < 1000; i++) {
+                sum += i;
+            }
+        }
+        return 7;
+    }
+};
+
+void test()
+{
+    const int cpuCount = VThread::CpuCount();
+    assert(cpuCount >= 1);
+    const ulong lastCpu = 1ul << (std::min<int>(cpuCount, sizeof(ulong) * 8) - 1);
+
+    ProbeThread thread;
+    thread.setName("VThreadTestProbeThread");
+    thread.setPriority(VThread::BelowNormalPriority);
+    thread.setAffinity(lastCpu);
+    assert(thread.tid() == 0);
+    thread.spin = 20 * 1000 * 1000;
+
+    //Settings made before start are applied as the thread starts
+    assert(thread.start());
+    thread.probed.wait();
+    assert(thread.tid() == thread.probedTid);
+    assert(strcmp(thread.name, "VThreadTestProb") == 0);
+    assert(thread.nice == VThread::GetOSPriority(VThread::BelowNormalPriority));
+    assert(thread.cpuMask == lastCpu);
+
+    //and right away once it runs
+    assert(thread.setPriority(VThread::IdlePriority));
+    assert(thread.setAffinity(1));
+    thread.setName("Renamed");
+    thread.release.post();
+    thread.probed.wait();
+    assert(thread.nice == 19);
+    assert(thread.cpuMask == 1);
+    assert(strcmp(thread.name, "Renamed") == 0);
+    assert(thread.priority() == VThread::IdlePriority && thread.affinity() == 1);
+
+    //Realtime scheduling needs privileges the tests may not have
+    if (thread.setPolicy(VThread::FifoPolicy)) {
+        assert(sched_getscheduler(thread.probedTid) == SCHED_FIFO);
+        sched_param param;
+        sched_getparam(thread.probedTid, &param);
+        assert(param.sched_priority == VThread::GetOSPriority(VThread::IdlePriority, VThread::FifoPolicy));
+        assert(thread.setPolicy(VThread::RoundRobinPolicy));
+        assert(sched_getscheduler(thread.probedTid) == SCHED_RR);
+        assert(thread.setPolicy(VThread::NormalPolicy));
+        assert(sched_getscheduler(thread.probedTid) == SCHED_OTHER);
+    } else {
+        assert(errno == EPERM);
+        assert(sched_getscheduler(thread.probedTid) == SCHED_OTHER);
+    }
+    assert(getpriority(PRIO_PROCESS, thread.probedTid) == 19);
+
+    //Cpu time is counted while running and kept after the exit
+    const vint64 before = thread.cpuTime();
+    assert(before > 0 && before < thread.spin);
+    thread.release.post();
+    assert(thread.wait());
+    assert(thread.isFinished());
+    assert(thread.tid() == 0);
+    assert(thread.cpuTime() >= thread.spin);
+    assert(thread.cpuTime() < thread.spin * 50);
+
+    //Realtime priorities stay in the range of the policy
+    for (int priority = VThread::CriticalPriority; priority <= VThread::IdlePriority; priority++) {
+        const int fifo = VThread::GetOSPriority(static_cast<VThread::Priority>(priority), VThread::FifoPolicy);
+        assert(fifo >= sched_get_priority_min(SCHED_FIFO) && fifo <= sched_get_priority_max(SCHED_FIFO));
+        if (priority > VThread::CriticalPriority) {
+            assert(fifo <= VThread::GetOSPriority(static_cast<VThread::Priority>(priority - 1), VThread::FifoPolicy));
+            assert(VThread::GetOSPriority(static_cast<VThread::Priority>(priority)) > VThread::GetOSPriority(static_cast<VThread::Priority>(priority - 1)));
+        }
+    }
+
+    //Threads without changed settings keep the ones they inherit
+    {
+        std::atomic<int> nice(-100);
+        VThread plain([](void *data) -> int {
+            errno = 0;
+            *static_cast<std::atomic<int> *>(data) = getpriority(PRIO_PROCESS, 0);
+            return 0;
+        }, &nice);
+        assert(plain.start());
+        assert(plain.wait());
+        assert(nice == getpriority(PRIO_PROCESS, 0));
+    }
+}
+
+ADD_TEST(VThread, test)
+
+}
@@ -2,6 +2,8 @@
 
 #include <VVariant.h>
 
+#include <chrono>
+
 NV_USING_NAMESPACE
 
 namespace {
@@ -120,8 +122,143 @@ void test()
         assert(var.value("fang").toInt() == 1994);
         assert(var.value("yun").toInt() == var.value("zhe").toInt());
     }
+
+    //Copies of arrays and maps share their data until one of them is modified
+    {
+        VVariantArray array;
+        array << 1 << 2 << 3;
+        VVariant var(array);
+        VVariant copy(var);
+        assert(&copy.toArray() == &var.toArray());
+
+        copy[0] = 100;
+        assert(&copy.toArray() != &var.toArray());
+        assert(copy.at(0).toInt() == 100);
+        assert(var.at(0).toInt() == 1);
+
+        VVariantMap map;
+        map["key"] = "value";
+        VVariant mapVar(map);
+        VVariant mapCopy;
+        mapCopy = mapVar;
+        assert(&mapCopy.toMap() == &mapVar.toMap());
+
+        mapCopy["key"] = "changed";
+        assert(mapCopy.value("key").toString() == "changed");
+        assert(mapVar.value("key").toString() == "value");
+
+        VVariant moved(std::move(mapCopy));
+        assert(mapCopy.isNull());
+        assert(moved.value("key").toString() == "changed");
+    }
+
+    //Strings and closures
+    {
+        VVariant str("short");
+        VVariant copy(str);
+        assert(copy.toString() == "short");
+        VVariant moved(std::move(copy));
+        assert(copy.isNull());
+        assert(moved.toString() == "short");
+        moved = str;
+        moved = moved;
+        assert(moved.toString() == "short");
+
+        int count = 0;
+        VVariant closure(VVariant::Function([&count]{ count++; }));
+        VVariant closureCopy(closure);
+        closure();
+        closureCopy();
+        VVariant closureMoved(std::move(closureCopy));
+        assert(closureCopy.isNull());
+        closureMoved();
+        assert(count == 3);
+    }
+}
+
+template<typename Create>
+void benchmark(const char *name, const Create &create)
+{
+    const int num = 100000;
+    VVariant source = create();
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        VArray<VVariant> copies;
+        copies.reserve(num);
+        for (int i = 0; i < num; i++) {
+            copies.append(source);
+        }
+        auto copied = std::chrono::steady_clock::now();
+
+        VArray<VVariant> moves;
+        moves.reserve(num);
+        for (VVariant &copy : copies) {
+            moves.append(std::move(copy));
+        }
+        auto moved = std::chrono::steady_clock::now();
+
+        copies.clear();
+        moves.clear();
+        auto destroyed = std::chrono::steady_clock::now();
+
+        double copy = std::chrono::duration<double, std::micro>(copied - start).count();
+        double move = std::chrono::duration<double, std::micro>(moved - copied).count();
+        double destroy = std::chrono::duration<double, std::micro>(destroyed - moved).count();
+        vInfo("VVariant " << name << ": copy " << num / copy << " M/s, move " << num / move << " M/s, destroy " << num / destroy << " M/s");
+    }
+}
+
+// Deep copies are what copying a VVariant used to cost for non-scalar types
+template<typename T>
+void benchmarkDeepCopy(const char *name, const T &value)
+{
+    const int num = 100000;
+    VArray<T *> copies;
+    copies.reserve(num);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num; i++) {
+        copies.append(new T(value));
+    }
+    auto copied = std::chrono::steady_clock::now();
+    for (T *copy : copies) {
+        delete copy;
+    }
+    auto destroyed = std::chrono::steady_clock::now();
+
+    double copy = std::chrono::duration<double, std::micro>(copied - start).count();
+    double destroy = std::chrono::duration<double, std::micro>(destroyed - copied).count();
+    vInfo("Heap-allocated " << name << ": copy " << num / copy << " M/s, destroy " << num / destroy << " M/s");
+}
+
+void benchmark()
+{
+    VVariantArray array;
+    for (int i = 0; i < 16; i++) {
+        array << i << "element";
+    }
+    VVariantMap map;
+    for (int i = 0; i < 16; i++) {
+        map[VString::number(i)] = i;
+    }
+    VVariant::Function function = []{};
+
+    benchmark("Int", []{ return VVariant(1994); });
+    benchmark("Double", []{ return VVariant(3.14); });
+    benchmark("Pointer", []{ return VVariant(static_cast<void *>(nullptr)); });
+    benchmark("String", []{ return VVariant("surfaceChanged"); });
+    benchmark("Array", [&]{ return VVariant(array); });
+    benchmark("Map", [&]{ return VVariant(map); });
+    benchmark("Closure", [&]{ return VVariant(function); });
+
+    benchmarkDeepCopy("VString", VString("surfaceChanged"));
+    benchmarkDeepCopy("VVariantArray", array);
+    benchmarkDeepCopy("VVariantMap", map);
+    benchmarkDeepCopy("Function", function);
 }
 
 ADD_TEST(VVariant, test)
+ADD_TEST(VVariantBenchmark, benchmark)
 
 }
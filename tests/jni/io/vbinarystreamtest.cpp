@@ -2,11 +2,44 @@
 
 #include <VBuffer.h>
 #include <VBinaryStream.h>
+#include <VFile.h>
+
+#include <chrono>
+#include <string.h>
 
 NV_USING_NAMESPACE
 
 namespace {
 
+//A pipe-like device handing out a few bytes at a time and no memory
+class TrickleDevice : public VIODevice
+{
+public:
+    TrickleDevice() : m_pos(0) { open(ReadWrite); }
+
+    bool isSequential() const override { return true; }
+    vint64 bytesAvailable() const override { return m_data.size() - m_pos; }
+
+protected:
+    vint64 readData(char *data, vint64 maxSize) override
+    {
+        vint64 length = std::min<vint64>(std::min<vint64>(maxSize, 3), m_data.size() - m_pos);
+        memcpy(data, m_data.data() + m_pos, length);
+        m_pos += length;
+        return length;
+    }
+
+    vint64 writeData(const char *data, vint64 maxSize) override
+    {
+        m_data.insert(m_data.size(), data, maxSize);
+        return maxSize;
+    }
+
+private:
+    VByteArray m_data;
+    uint m_pos;
+};
+
 void test()
 {
     {
@@ -94,8 +127,225 @@ void test()
             assert(nums[i] == output[i]);
         }
     }
+
+    {
+        //Reading past the end fails instead of spinning
+        VBuffer buffer;
+        VBinaryStream stream(&buffer);
+        assert(stream.atEnd());
+        int number = 1;
+        stream >> number;
+        assert(number == 0);
+        assert(stream.status() == VBinaryStream::ReadPastEnd);
+
+        stream << 5;
+        assert(stream.status() == VBinaryStream::ReadPastEnd);
+        stream.resetStatus();
+        stream << 5 << (short) 6;
+        short little = 0;
+        stream >> number >> little;
+        assert(stream.status() == VBinaryStream::Ok);
+        assert(number == 5 && little == 6);
+        assert(stream.atEnd());
+
+        VArray<int> output;
+        assert(!stream.read(output, 1));
+        assert(output.isEmpty());
+    }
+
+    {
+        VBuffer buffer;
+        VBinaryStream stream(&buffer);
+        stream.setByteOrder(VBinaryStream::BigEndian);
+        stream << (uint) 0x01020304 << (ushort) 0x0506 << 1.5f;
+        assert(buffer.size() == 10);
+        assert(memcmp(buffer.data(), "\x01\x02\x03\x04\x05\x06", 6) == 0);
+
+        uint number;
+        ushort little;
+        float real;
+        stream >> number >> little >> real;
+        assert(number == 0x01020304 && little == 0x0506 && real == 1.5f);
+
+        VArray<uint> nums;
+        for (uint i = 0; i < 1000; i++) {
+            nums.append(i * 0x01010101);
+        }
+        stream.write(nums);
+        stream.setByteOrder(VBinaryStream::LittleEndian);
+        stream >> number;
+        assert(number == 0);
+        stream >> number;
+        assert(number == 0x01010101);
+        stream.setByteOrder(VBinaryStream::BigEndian);
+        VArray<uint> output;
+        assert(stream.read(output, 998));
+        for (uint i = 0; i < 998; i++) {
+            assert(output[i] == nums[i + 2]);
+        }
+    }
+
+    {
+        //Views point straight into the buffer
+        VBuffer buffer;
+        buffer.write("0123456789");
+        VBinaryStream stream(&buffer);
+        const char *view = stream.readView(4);
+        assert(view == buffer.data());
+        assert(stream.skipRawData(2));
+        view = stream.readView(4);
+        assert(memcmp(view, "6789", 4) == 0);
+        assert(stream.readView(1) == nullptr);
+        assert(stream.status() == VBinaryStream::ReadPastEnd);
+    }
+
+    {
+        TrickleDevice device;
+        VBinaryStream stream(&device);
+        VArray<int> nums;
+        for (int i = 0; i < 5000; i++) {
+            nums.append(i);
+        }
+        stream.write(nums);
+        stream << 1.25;
+
+        int first;
+        stream >> first;
+        assert(first == 0);
+        assert(stream.skipRawData(sizeof(int)));
+        VArray<int> output;
+        assert(stream.read(output, 4998));
+        for (int i = 0; i < 4998; i++) {
+            assert(output[i] == i + 2);
+        }
+        double real;
+        stream >> real;
+        assert(real == 1.25);
+        assert(stream.atEnd());
+    }
+
+    {
+        {
+            VFile file("vbinarystreamtest.bin", VFile::WriteOnly);
+            VBinaryStream stream(&file);
+            for (int i = 0; i < 10000; i++) {
+                stream << i;
+            }
+            stream << 0.5;
+        }
+
+        VFile file("vbinarystreamtest.bin", VFile::ReadOnly);
+        {
+            VBinaryStream stream(&file);
+            int number;
+            for (int i = 0; i < 100; i++) {
+                stream >> number;
+                assert(number == i);
+            }
+        }
+        //The stream gave back what it didn't consume
+        assert(file.pos() == 400);
+
+        VBinaryStream stream(&file);
+        VArray<int> output;
+        assert(stream.read(output, 9900));
+        assert(output[0] == 100 && output[9899] == 9999);
+        double real;
+        stream >> real;
+        assert(real == 0.5);
+        assert(stream.atEnd());
+        int number;
+        stream >> number;
+        assert(stream.status() == VBinaryStream::ReadPastEnd);
+    }
+    remove("vbinarystreamtest.bin");
 }
 
 ADD_TEST(VBinaryStream, test)
 
+struct Vertex
+{
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+
+//What reading element by element used to cost: one virtual call per field
+void ReadLegacy(VIODevice *device, float &value)
+{
+    char *data = reinterpret_cast<char *>(&value);
+    uint count = 0;
+    do {
+        count += device->read(data + count, sizeof(float) - count);
+    } while (count < sizeof(float));
+}
+
+void benchmark()
+{
+    const uint vertexNum = 1024 * 1024;
+    const double megabytes = vertexNum * sizeof(Vertex) / (1024.0 * 1024.0);
+    VArray<Vertex> vertices;
+    vertices.resize(vertexNum);
+    for (uint i = 0; i < vertexNum; i++) {
+        float *fields = vertices[i].position;
+        for (int j = 0; j < 8; j++) {
+            fields[j] = i * 8 + j;
+        }
+    }
+
+    {
+        VFile file("vbinarystreambenchmark.bin", VFile::WriteOnly);
+        VBinaryStream stream(&file);
+        stream.write(vertices);
+    }
+
+    VArray<Vertex> output;
+    output.resize(vertexNum);
+    for (int device = 0; device < 2; device++) {
+        double seconds[3];
+        for (int method = 0; method < 3; method++) {
+            VBuffer buffer;
+            VFile file;
+            VIODevice *input = &buffer;
+            if (device == 0) {
+                buffer.write(reinterpret_cast<const char *>(vertices.data()), vertices.size() * sizeof(Vertex));
+            } else {
+                file.open("vbinarystreambenchmark.bin", VFile::ReadOnly);
+                input = &file;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            if (method == 0) {
+                for (Vertex &vertex : output) {
+                    float *fields = vertex.position;
+                    for (int j = 0; j < 8; j++) {
+                        ReadLegacy(input, fields[j]);
+                    }
+                }
+            } else if (method == 1) {
+                VBinaryStream stream(input);
+                for (Vertex &vertex : output) {
+                    float *fields = vertex.position;
+                    for (int j = 0; j < 8; j++) {
+                        stream >> fields[j];
+                    }
+                }
+            } else {
+                VBinaryStream stream(input);
+                stream.readArray(output.data(), vertexNum);
+            }
+            seconds[method] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            assert(output[vertexNum - 1].uv[1] == vertices[vertexNum - 1].uv[1]);
+        }
+
+        vInfo("VBinaryStream (" << (device == 0 ? "VBuffer" : "VFile") << "): legacy "
+              << (int) (megabytes / seconds[0]) << " MB/s, per field " << (int) (megabytes / seconds[1])
+              << " MB/s, bulk " << (int) (megabytes / seconds[2]) << " MB/s");
+    }
+
+    remove("vbinarystreambenchmark.bin");
+}
+
+ADD_TEST(VBinaryStreamBenchmark, benchmark)
+
 }
@@ -2,6 +2,10 @@
 
 #include <VBuffer.h>
 
+#include <chrono>
+#include <sstream>
+#include <string.h>
+
 NV_USING_NAMESPACE
 
 namespace {
@@ -33,8 +37,137 @@ void test()
             assert(bytes[i] == output[i]);
         }
     }
+
+    {
+        VBuffer buffer(1000);
+        assert(buffer.capacity() >= 1000);
+        assert(buffer.size() == 0);
+
+        buffer.write("0123456789");
+        assert(buffer.size() == 10);
+        assert(memcmp(buffer.data(), "0123456789", 10) == 0);
+
+        char out[4];
+        assert(buffer.read(out, 4) == 4);
+        assert(memcmp(out, "0123", 4) == 0);
+        assert(buffer.bytesAvailable() == 6);
+        assert(memcmp(buffer.data(), "456789", 6) == 0);
+
+        buffer.skip(2);
+        assert(memcmp(buffer.data(), "6789", 4) == 0);
+        buffer.skip(100);
+        assert(buffer.size() == 0);
+        assert(buffer.read(out, 4) == 0);
+
+        buffer.write("abc");
+        buffer.clear();
+        assert(buffer.size() == 0);
+    }
+
+    {
+        //Interleaved reads and writes keep the byte order across compaction and growth
+        VBuffer buffer;
+        VByteArray expected;
+        VByteArray output;
+        char chunk[100];
+        for (int round = 0; round < 200; round++) {
+            for (int i = 0; i < 100; i++) {
+                chunk[i] = static_cast<char>(round * 31 + i);
+            }
+            const uint length = 1 + (round * 7) % 100;
+            buffer.write(chunk, length);
+            expected.append(chunk, length);
+
+            char out[64];
+            const vint64 count = buffer.read(out, 1 + (round * 13) % 64);
+            output.append(out, count);
+        }
+        output += buffer.readAll();
+        assert(output == expected);
+    }
+
+    {
+        VBuffer buffer;
+        VBuffer::Segment segments[] = {{"header:", 7}, {"body", 4}, {"", 0}, {";", 1}};
+        assert(buffer.writev(segments, 4) == 12);
+        assert(buffer.capacity() >= 12);
+        assert(buffer.readAll() == "header:body;");
+    }
 }
 
 ADD_TEST(VBuffer, test)
 
+//Small records as written by VBinaryStream, with a size query before every read
+void benchmark()
+{
+    const int recordNum = 4 * 1024 * 1024;
+    const int rounds = 4;
+    const int batch = 1024;
+    char record[16];
+    for (int i = 0; i < 16; i++) {
+        record[i] = static_cast<char>(i);
+    }
+    const double megabytes = recordNum * 16.0 * rounds / (1024.0 * 1024.0);
+
+    uint checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        std::stringstream stream;
+        for (int i = 0; i < recordNum; i += batch) {
+            for (int j = 0; j < batch; j++) {
+                stream.write(record, 16);
+            }
+            for (int j = 0; j < batch; j++) {
+                std::streampos pos = stream.tellg();
+                stream.seekg(0, std::ios::end);
+                std::streampos end = stream.tellg();
+                stream.seekg(pos);
+                if (end - pos >= 16) {
+                    char out[16];
+                    stream.readsome(out, 16);
+                    checksum += out[j % 16];
+                }
+            }
+        }
+    }
+    double streamSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        VBuffer buffer;
+        for (int i = 0; i < recordNum; i += batch) {
+            for (int j = 0; j < batch; j++) {
+                buffer.write(record, 16);
+            }
+            for (int j = 0; j < batch; j++) {
+                if (buffer.bytesAvailable() >= 16) {
+                    char out[16];
+                    buffer.read(out, 16);
+                    checksum -= out[j % 16];
+                }
+            }
+        }
+    }
+    double bufferSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    assert(checksum == 0);
+
+    //Header, payload and padding queued as one append
+    VByteArray payload(4096 - 24, 'x');
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        VBuffer buffer;
+        for (int i = 0; i < recordNum / 256; i++) {
+            VBuffer::Segment segments[] = {{record, 16}, {payload.data(), payload.size()}, {record, 8}};
+            buffer.writev(segments, 3);
+        }
+        checksum += buffer.size();
+    }
+    double writevSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    vInfo("VBuffer: stringstream " << (int) (megabytes / streamSeconds) << " MB/s, VBuffer " << (int) (megabytes / bufferSeconds)
+          << " MB/s, writev " << (int) (megabytes / writevSeconds) << " MB/s");
+}
+
+ADD_TEST(VBufferBenchmark, benchmark)
+
 }
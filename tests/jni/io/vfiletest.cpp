@@ -5,6 +5,13 @@
 #endif
 
 #include <VFile.h>
+#include <VImage.h>
+
+#include <3rdparty/stb/stb_image_write.h>
+
+#include <chrono>
+#include <fstream>
+#include <string.h>
 
 NV_USING_NAMESPACE
 
@@ -57,7 +64,10 @@ void test()
             VFile file("test.bin", VFile::WriteOnly | VFile::Append);
             assert(file.isOpen());
             assert(file.openMode() & VFile::Append);
+            assert(file.size() == 512);
             assert(file.write(bytes + 512, 512) == 512);
+            //The size is looked up again after a write
+            assert(file.size() == 1024);
         }
 
         {
@@ -68,6 +78,48 @@ void test()
                 assert(data[i] == bytes[i]);
             }
         }
+
+        {
+            VFile file("test.bin", VFile::ReadOnly);
+            assert(file.size() == 1024);
+            assert(file.bytesAvailable() == 1024);
+            char buffer[1000];
+            assert(file.read(buffer, 1000) == 1000);
+            assert(file.pos() == 1000);
+            assert(file.bytesAvailable() == 24);
+            assert(file.read(buffer, 1000) == 24);
+            assert(file.atEnd());
+            assert(file.read(buffer, 1000) == 0);
+            assert(file.seek(512));
+            assert(file.read(buffer, 4) == 4);
+            assert(memcmp(buffer, bytes + 512, 4) == 0);
+        }
+
+        VMappedView view;
+        {
+            VFile file("test.bin", VFile::ReadOnly);
+            VMappedView whole = file.map();
+            assert(!whole.isNull());
+            assert(whole.size() == 1024);
+            assert(memcmp(whole.data(), bytes, 1024) == 0);
+
+            //Offsets don't have to be aligned to pages
+            VMappedView part = file.map(1000, 24);
+            assert(part.size() == 24);
+            assert(memcmp(part.data(), bytes + 1000, 24) == 0);
+            assert(part.toByteArray() == VByteArray(bytes + 1000, 24));
+
+            assert(file.map(1000, 25).isNull());
+            assert(file.map(2048).isNull());
+            view = part;
+        }
+        //The view outlives the file
+        assert(memcmp(view.data(), bytes + 1000, 24) == 0);
+
+        {
+            VFile file("test.bin", VFile::WriteOnly | VFile::Append);
+            assert(file.map().isNull());
+        }
     }
 
     remove("test.bin");
@@ -75,4 +127,102 @@ void test()
 
 ADD_TEST(VFile, test)
 
+VByteArray ReadWithStream(const char *path)
+{
+    std::ifstream file(path, std::ios::binary);
+    file.seekg(0, std::ios::end);
+    VByteArray data(static_cast<uint>(file.tellg()), '\0');
+    file.seekg(0, std::ios::beg);
+    file.read(&data[0], data.size());
+    return data;
+}
+
+uint Checksum(const char *data, uint size)
+{
+    uint sum = 0;
+    for (uint i = 0; i < size; i++) {
+        sum += static_cast<uchar>(data[i]);
+    }
+    return sum;
+}
+
+//Loads 100MB of textures and images, copied out of fstream or consumed from mapped views
+void benchmark()
+{
+    const int textureNum = 17;
+    const uint textureSize = 4 * 1024 * 1024;
+    const int imageNum = 8;
+    const int imageWidth = 1024;
+
+    char path[64];
+    {
+        const uchar identifier[12] = {171, 75, 84, 88, 32, 49, 49, 187, 13, 10, 26, 10};
+        VByteArray texture(textureSize, '\0');
+        memcpy(&texture[0], identifier, sizeof(identifier));
+        for (uint i = 64; i < textureSize; i++) {
+            texture[i] = static_cast<char>(i * 7);
+        }
+        for (int i = 0; i < textureNum; i++) {
+            sprintf(path, "vfilebenchmark%d.ktx", i);
+            VFile file(path, VFile::WriteOnly);
+            file.write(texture);
+        }
+
+        VArray<uchar> pixels;
+        pixels.resize(imageWidth * imageWidth * 4);
+        for (uint i = 0; i < pixels.size(); i++) {
+            pixels[i] = static_cast<uchar>(i ^ (i >> 12));
+        }
+        for (int i = 0; i < imageNum; i++) {
+            sprintf(path, "vfilebenchmark%d.tga", i);
+            stbi_write_tga(path, imageWidth, imageWidth, 4, pixels.data());
+        }
+    }
+    const double megabytes = (textureNum * textureSize + imageNum * imageWidth * imageWidth * 4.0) / (1024.0 * 1024.0);
+
+    uint streamSum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < textureNum; i++) {
+        sprintf(path, "vfilebenchmark%d.ktx", i);
+        VByteArray data = ReadWithStream(path);
+        streamSum += Checksum(data.data(), data.size());
+    }
+    for (int i = 0; i < imageNum; i++) {
+        sprintf(path, "vfilebenchmark%d.tga", i);
+        VImage image(ReadWithStream(path));
+        assert(image.isValid());
+    }
+    double streamSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint mappedSum = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < textureNum; i++) {
+        sprintf(path, "vfilebenchmark%d.ktx", i);
+        VFile file(path, VFile::ReadOnly);
+        VMappedView view = file.map();
+        mappedSum += Checksum(view.data(), view.size());
+    }
+    for (int i = 0; i < imageNum; i++) {
+        sprintf(path, "vfilebenchmark%d.tga", i);
+        VImage image;
+        image.load(VPath(path));
+        assert(image.isValid());
+    }
+    double mappedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    assert(streamSum == mappedSum);
+
+    vInfo("VFile: fstream " << (int) (megabytes / streamSeconds) << " MB/s, mapped " << (int) (megabytes / mappedSeconds) << " MB/s");
+
+    for (int i = 0; i < textureNum; i++) {
+        sprintf(path, "vfilebenchmark%d.ktx", i);
+        remove(path);
+    }
+    for (int i = 0; i < imageNum; i++) {
+        sprintf(path, "vfilebenchmark%d.tga", i);
+        remove(path);
+    }
+}
+
+ADD_TEST(VFileBenchmark, benchmark)
+
 }
@@ -0,0 +1,241 @@
+#include "test.h"
+
+#include <VZipFile.h>
+#include <VString.h>
+
+#include <3rdparty/minizip/zip.h>
+#include <3rdparty/minizip/unzip.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+NV_USING_NAMESPACE
+
+namespace {
+
+VByteArray MakeContent(int seed, uint size)
+{
+    // Half random, half repeated text so that deflate has something to do
+    VByteArray content;
+    content.resize(size);
+    uint state = seed * 2654435761u + 1;
+    for (uint i = 0; i < size; i++) {
+        if ((i / 64) % 2 == 0) {
+            state = state * 1103515245u + 12345u;
+            content[i] = static_cast<char>(state >> 16);
+        } else {
+            content[i] = "vrseen sdk "[i % 11];
+        }
+    }
+    return content;
+}
+
+VByteArray EntryName(int i)
+{
+    char name[64];
+    sprintf(name, "assets/dir%d/File%03d.bin", i % 4, i);
+    return name;
+}
+
+// Odd entries are stored, even ones deflated
+void MakeZip(const char *path, int entryNum, uint entrySize)
+{
+    zipFile zip = zipOpen(path, APPEND_STATUS_CREATE);
+    assert(zip != nullptr);
+    for (int i = 0; i < entryNum; i++) {
+        VByteArray content = MakeContent(i, entrySize + i);
+        zip_fileinfo info;
+        memset(&info, 0, sizeof(info));
+        const int method = (i % 2) ? 0 : Z_DEFLATED;
+        assert(zipOpenNewFileInZip(zip, EntryName(i).c_str(), &info, nullptr, 0, nullptr, 0, nullptr, method, Z_DEFAULT_COMPRESSION) == ZIP_OK);
+        assert(zipWriteInFileInZip(zip, content.data(), content.size()) == ZIP_OK);
+        assert(zipCloseFileInZip(zip) == ZIP_OK);
+    }
+    assert(zipClose(zip, nullptr) == ZIP_OK);
+}
+
+void test()
+{
+    const char *path = "vzipfiletest.zip";
+    const int entryNum = 32;
+    MakeZip(path, entryNum, 4096);
+
+    {
+        VZipFile zip;
+        assert(!zip.isOpen());
+        assert(!zip.contains("assets/dir0/File000.bin"));
+        assert(!zip.open("nonexistent.zip"));
+        assert(!zip.isOpen());
+    }
+
+    {
+        VZipFile zip(path);
+        assert(zip.isOpen());
+        assert(zip.entries().size() == (uint) entryNum);
+
+        assert(zip.contains("assets/dir1/File001.bin"));
+        assert(zip.contains("ASSETS/Dir1/file001.BIN"));
+        assert(!zip.contains("assets/dir1/File002.bin"));
+        assert(zip.contains(VString("assets/dir1/File001.bin")));
+        assert(zip.contains(VByteArrayView("assets/dir1/File001.bin.tmp", 23)));
+        assert(zip.size("assets/dir2/File002.bin") == 4096 + 2);
+        assert(zip.size("missing") == 0);
+
+        for (int i = 0; i < entryNum; i++) {
+            VString name = VString::fromUtf8(EntryName(i));
+            VByteArray expected = MakeContent(i, 4096 + i);
+
+            VByteArray data;
+            assert(zip.read(name, data));
+            assert(data == expected);
+            assert(zip.read(name) == expected);
+
+            void *buffer = nullptr;
+            uint length = 0;
+            assert(zip.read(name, buffer, length));
+            assert(length == expected.size());
+            assert(memcmp(buffer, expected.data(), length) == 0);
+            free(buffer);
+
+            const void *view = nullptr;
+            length = 0;
+            if (i % 2) {
+                assert(zip.map(name, view, length));
+                assert(length == expected.size());
+                assert(memcmp(view, expected.data(), length) == 0);
+            } else {
+                assert(!zip.map(name, view, length));
+            }
+        }
+
+        VByteArray data;
+        assert(!zip.read("missing", data));
+
+        // Every thread reads every entry, they must not disturb each other
+        std::atomic<int> failures(0);
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 4; t++) {
+            readers.push_back(std::thread([&]{
+                for (int round = 0; round < 4; round++) {
+                    for (int i = 0; i < entryNum; i++) {
+                        if (zip.read(VString::fromUtf8(EntryName(i))) != MakeContent(i, 4096 + i)) {
+                            failures++;
+                        }
+                    }
+                }
+            }));
+        }
+        for (std::thread &reader : readers) {
+            reader.join();
+        }
+        assert(failures == 0);
+
+        zip.close();
+        assert(!zip.isOpen());
+        assert(!zip.contains("assets/dir1/File001.bin"));
+    }
+
+    remove(path);
+}
+
+// Loads every asset of the package from 1..N threads. The minizip handle can only be shared
+// behind a lock, which is what VZipFile used to amount to.
+void benchmark()
+{
+    const char *path = "vzipfilebenchmark.zip";
+    const int entryNum = 512;
+    const uint entrySize = 64 * 1024;
+    MakeZip(path, entryNum, entrySize);
+
+    VArray<VString> names;
+    for (int i = 0; i < entryNum; i++) {
+        names.append(VString::fromUtf8(EntryName(i)));
+    }
+    const double megabytes = entryNum * (entrySize + entryNum / 2.0) / (1024.0 * 1024.0);
+    const int maxThreads = std::max(2u, std::min(8u, std::thread::hardware_concurrency()));
+
+    {
+        unzFile handle = unzOpen(path);
+        assert(handle != nullptr);
+        std::mutex mutex;
+
+        for (int threadNum = 1; threadNum <= maxThreads; threadNum *= 2) {
+            std::atomic<int> next(0);
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threadNum; t++) {
+                workers.push_back(std::thread([&]{
+                    VByteArray buffer;
+                    for (int i = next++; i < entryNum; i = next++) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        VByteArray name = names[i].toUtf8();
+                        if (unzLocateFile(handle, name.c_str(), 2) != UNZ_OK) {
+                            continue;
+                        }
+                        unz_file_info info;
+                        unzGetCurrentFileInfo(handle, &info, nullptr, 0, nullptr, 0, nullptr, 0);
+                        unzOpenCurrentFile(handle);
+                        buffer.resize(info.uncompressed_size);
+                        unzReadCurrentFile(handle, &buffer[0], info.uncompressed_size);
+                        unzCloseCurrentFile(handle);
+                    }
+                }));
+            }
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            vInfo("minizip: " << threadNum << " thread(s), " << (int) (megabytes / seconds) << " MB/s");
+        }
+        unzClose(handle);
+    }
+
+    VZipFile zip(path);
+    assert(zip.isOpen());
+
+    // With views, stored entries are only paged in; sum a byte per page to pay for that
+    for (int useMap = 0; useMap < 2; useMap++) {
+        for (int threadNum = 1; threadNum <= maxThreads; threadNum *= 2) {
+            std::atomic<int> next(0);
+            std::atomic<uint> checksum(0);
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> workers;
+            for (int t = 0; t < threadNum; t++) {
+                workers.push_back(std::thread([&]{
+                    VByteArray buffer;
+                    uint sum = 0;
+                    for (int i = next++; i < entryNum; i = next++) {
+                        const void *view;
+                        uint length;
+                        if (useMap && zip.map(names[i], view, length)) {
+                            const uchar *bytes = static_cast<const uchar *>(view);
+                            for (uint j = 0; j < length; j += 4096) {
+                                sum += bytes[j];
+                            }
+                        } else if (zip.read(names[i], buffer)) {
+                            sum += static_cast<uchar>(buffer[0]);
+                        }
+                    }
+                    checksum += sum;
+                }));
+            }
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            vInfo("VZipFile" << (useMap ? " (mapped)" : "") << ": " << threadNum << " thread(s), " << (int) (megabytes / seconds) << " MB/s");
+        }
+    }
+
+    remove(path);
+}
+
+}
+
+ADD_TEST(VZipFile, test)
+ADD_TEST(VZipFileBenchmark, benchmark)
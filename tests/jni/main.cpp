@@ -1,6 +1,7 @@
 #include "test.h"
 
 #include <time.h>
+#include <algorithm>
 #include <iostream>
 
 using namespace std;
@@ -12,7 +13,8 @@ list<TestUnit> &Tests()
     return tests;
 }
 
-int main()
+//Runs the tests named on the command line, or all of them
+int main(int argc, char *argv[])
 {
     vInfo("NervGear Test");
     vInfo("======================");
@@ -20,6 +22,9 @@ int main()
 
     const list<TestUnit> &tests = Tests();
     for (const TestUnit &test : tests) {
+        if (argc > 1 && find(argv + 1, argv + argc, test.name) == argv + argc) {
+            continue;
+        }
         vInfo("Testing " << test.name << " ...");
         (*test.function)();
         vInfo(test.name << " has been tested.");
@@ -38,12 +43,12 @@ int main()
 extern "C" {
     jint Java_com_vrseen_unittest_MainActivity_exec(JNIEnv *, jclass, jobject)
     {
-        return main();
+        return main(0, nullptr);
     }
 
     jint Java_com_vrseen_SourceTest_exec(JNIEnv *, jclass, jobject)
     {
-        return main();
+        return main(0, nullptr);
     }
 }
 
@@ -2,6 +2,12 @@
 
 #include <VImage.h>
 
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+
 NV_USING_NAMESPACE
 
 #define VARRAY_LENGTH 1000
@@ -65,6 +71,360 @@ void test()
     }
 }
 
-ADD_TEST(VArray, test)
+ADD_TEST(VImage, test)
+
+//The straightforward 2D implementation the optimized kernels are checked against
+namespace reference {
+
+float SRGBToLinear(float c)
+{
+    return c <= 0.04045f ? c * (1.0f / 12.92f) : powf((c + 0.055f) * (1.0f / 1.055f), 2.4f);
+}
+
+float LinearToSRGB(float c)
+{
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+uchar ToByte(float linear)
+{
+    return (uchar) std::min(std::max(0, (int) (LinearToSRGB(linear) * 255.0f + 0.5f)), 255);
+}
+
+void FilterWeights(float s, VImage::Filter filter, float weights[4])
+{
+    const float sharpen = 0.75f;
+    switch (filter) {
+    case VImage::NearestFilter:
+        weights[0] = 1.0f;
+        break;
+    case VImage::LinearFilter:
+        weights[0] = 1.0f - s;
+        weights[1] = s;
+        break;
+    case VImage::CubicFilter:
+        weights[0] = ((((+0.0f - sharpen) * s + (+0.0f + 2.0f * sharpen)) * s + -sharpen) * s + 0.0f);
+        weights[1] = ((((+2.0f - sharpen) * s + (-3.0f + 1.0f * sharpen)) * s + 0.0f) * s + 1.0f);
+        weights[2] = ((((-2.0f + sharpen) * s + (+3.0f - 2.0f * sharpen)) * s + sharpen) * s + 0.0f);
+        weights[3] = ((((+0.0f + sharpen) * s + (+0.0f - 1.0f * sharpen)) * s + 0.0f) * s + 0.0f);
+        break;
+    }
+}
+
+VArray<uchar> Resize(const uchar *src, int width, int height, int newWidth, int newHeight, VImage::Filter filter)
+{
+    int footprintMin = 0;
+    int footprintMax = 0;
+    int offsetX = width - newWidth;
+    int offsetY = height - newHeight;
+    if (filter == VImage::NearestFilter) {
+        offsetX = width;
+        offsetY = height;
+    } else if (filter == VImage::LinearFilter) {
+        footprintMax = 1;
+    } else {
+        footprintMin = -1;
+        footprintMax = 2;
+    }
+
+    float table[256];
+    for (int i = 0; i < 256; i++) {
+        table[i] = SRGBToLinear(i / 255.0f);
+    }
+
+    VArray<uchar> scaled;
+    scaled.resize(newWidth * newHeight * 4);
+    for (int y = 0; y < newHeight; y++) {
+        const int srcY = (y * height * 2 + offsetY) / (newHeight * 2);
+        const float posY = ((float) y * height * 2.0f + offsetY) / (newHeight * 2.0f);
+        float weightsY[4] = {0.0f};
+        FilterWeights(posY - floorf(posY), filter, weightsY);
+
+        for (int x = 0; x < newWidth; x++) {
+            const int srcX = (x * width * 2 + offsetX) / (newWidth * 2);
+            const float posX = ((float) x * width * 2.0f + offsetX) / (newWidth * 2.0f);
+            float weightsX[4] = {0.0f};
+            FilterWeights(posX - floorf(posX), filter, weightsX);
+
+            float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            for (int fpY = footprintMin; fpY <= footprintMax; fpY++) {
+                for (int fpX = footprintMin; fpX <= footprintMax; fpX++) {
+                    const float weight = weightsX[fpX - footprintMin] * weightsY[fpY - footprintMin];
+                    const int cx = std::min(std::max(0, srcX + fpX), width - 1);
+                    const int cy = std::min(std::max(0, srcY + fpY), height - 1);
+                    for (int c = 0; c < 4; c++) {
+                        sum[c] += table[src[(cy * width + cx) * 4 + c]] * weight;
+                    }
+                }
+            }
+            for (int c = 0; c < 4; c++) {
+                scaled[(y * newWidth + x) * 4 + c] = ToByte(sum[c]);
+            }
+        }
+    }
+    return scaled;
+}
+
+VArray<uchar> Quarter(const uchar *src, int width, int height)
+{
+    const int newWidth = std::max(1, width >> 1);
+    const int newHeight = std::max(1, height >> 1);
+    VArray<uchar> out;
+    out.resize(newWidth * newHeight * 4);
+    for (int y = 0; y < newHeight; y++) {
+        const int y0 = y * 2;
+        const int y1 = std::min(y * 2 + 1, height - 1);
+        for (int x = 0; x < newWidth; x++) {
+            const int x0 = x * 2;
+            const int x1 = std::min(x * 2 + 1, width - 1);
+            for (int c = 0; c < 4; c++) {
+                const float linear = (SRGBToLinear(src[(y0 * width + x0) * 4 + c] / 255.0f)
+                        + SRGBToLinear(src[(y0 * width + x1) * 4 + c] / 255.0f)
+                        + SRGBToLinear(src[(y1 * width + x0) * 4 + c] / 255.0f)
+                        + SRGBToLinear(src[(y1 * width + x1) * 4 + c] / 255.0f)) * 0.25f;
+                out[(y * newWidth + x) * 4 + c] = ToByte(linear);
+            }
+        }
+    }
+    return out;
+}
+
+}
+
+VImage MakeImage(int width, int height, uint seed)
+{
+    uchar *pixels = (uchar *) malloc(width * height * 4);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uchar *pixel = pixels + (y * width + x) * 4;
+            seed = seed * 1103515245u + 12345u;
+            //Smooth gradients with some noise and hard edges, so every filter has something to do
+            pixel[0] = (uchar) (x * 255 / std::max(1, width - 1));
+            pixel[1] = (uchar) (y * 255 / std::max(1, height - 1));
+            pixel[2] = (uchar) (seed >> 16);
+            pixel[3] = ((x / 7 + y / 5) & 1) ? 255 : 0;
+        }
+    }
+    return VImage(pixels, width, height);
+}
+
+int MaxDifference(const uchar *a, const uchar *b, uint length)
+{
+    int difference = 0;
+    for (uint i = 0; i < length; i++) {
+        difference = std::max(difference, std::abs(a[i] - b[i]));
+    }
+    return difference;
+}
+
+void testKernels()
+{
+    const int sizes[][4] = {
+        {64, 48, 31, 17},
+        {64, 48, 128, 100},
+        {37, 1, 90, 3},
+        {1, 1, 2, 5},
+        {300, 200, 150, 100},
+        {513, 257, 511, 259}
+    };
+    const VImage::Filter filters[] = {VImage::NearestFilter, VImage::LinearFilter, VImage::CubicFilter};
+
+    for (const int *size : sizes) {
+        for (VImage::Filter filter : filters) {
+            VImage image = MakeImage(size[0], size[1], size[0] * 7 + size[1]);
+            VArray<uchar> expected = reference::Resize(image.data(), size[0], size[1], size[2], size[3], filter);
+            image.resize(size[2], size[3], filter);
+            assert(image.width() == size[2] && image.height() == size[3]);
+            const int difference = MaxDifference(image.data(), expected.data(), expected.size());
+            //Nearest copies pixels, the others may round differently by one step
+            assert(difference <= (filter == VImage::NearestFilter ? 0 : 1));
+        }
+
+        VImage image = MakeImage(size[0], size[1], size[1]);
+        VArray<uchar> expected = reference::Quarter(image.data(), size[0], size[1]);
+        image.quarter(true);
+        assert(MaxDifference(image.data(), expected.data(), expected.size()) <= 1);
+    }
+
+    VImage image = MakeImage(4, 2, 1);
+    VImage copy = image;
+    image.quarter(false);
+    assert(image.width() == 2 && image.height() == 1);
+    const uchar *src = copy.data();
+    for (int c = 0; c < 4; c++) {
+        assert(image.data()[c] == (src[c] + src[4 + c] + src[16 + c] + src[20 + c]) >> 2);
+    }
+}
+
+ADD_TEST(VImageKernels, testKernels)
+
+//Panorama to thumbnail and half size, reported in output megapixels per second
+void benchmark()
+{
+    const int width = 4096;
+    const int height = 2048;
+    const VImage source = MakeImage(width, height, 1);
+    const int targets[][2] = {{2048, 1024}, {512, 256}};
+    const VImage::Filter filters[] = {VImage::NearestFilter, VImage::LinearFilter, VImage::CubicFilter};
+    const char *names[] = {"nearest", "linear", "cubic"};
+
+    for (const int *target : targets) {
+        for (int f = 0; f < 3; f++) {
+            const int rounds = 3;
+            double seconds = 0.0;
+            for (int i = 0; i < rounds; i++) {
+                VImage image = source;
+                auto start = std::chrono::steady_clock::now();
+                image.resize(target[0], target[1], filters[f]);
+                seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / rounds;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            reference::Resize(source.data(), width, height, target[0], target[1], filters[f]);
+            double referenceSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            const double megapixels = target[0] * target[1] / 1e6;
+            vInfo("VImage: " << width << "x" << height << " to " << target[0] << "x" << target[1] << " " << names[f] << " "
+                  << megapixels / seconds << " Mpix/s, reference " << megapixels / referenceSeconds << " Mpix/s");
+        }
+    }
+
+    VImage image = source;
+    auto start = std::chrono::steady_clock::now();
+    image.quarter(true);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    vInfo("VImage: quarter " << (width / 2) * (height / 2) / 1e6 / seconds << " Mpix/s");
+}
+
+ADD_TEST(VImageBenchmark, benchmark)
+
+void testMipChain()
+{
+    VMipChain empty = VImage().buildMipChain(true);
+    assert(empty.isEmpty());
+    assert(empty.levelCount() == 0);
+
+    assert(VMipChain::LevelCount(1, 1) == 1);
+    assert(VMipChain::LevelCount(2, 1) == 2);
+    assert(VMipChain::LevelCount(256, 256) == 9);
+    assert(VMipChain::LevelCount(300, 17) == 9);
+
+    const int sizes[][2] = {{256, 256}, {300, 17}, {1, 37}, {1, 1}, {513, 257}};
+    for (const int *size : sizes) {
+        const VImage image = MakeImage(size[0], size[1], size[0] + size[1]);
+        for (int srgb = 0; srgb < 2; srgb++) {
+            const VMipChain chain = image.buildMipChain(srgb);
+            assert(chain.levelCount() == VMipChain::LevelCount(size[0], size[1]));
+            assert(chain.width() == size[0] && chain.height() == size[1]);
+            assert(memcmp(chain.level(0), image.data(), image.length()) == 0);
+
+            //Levels are packed as the texture upload walks them
+            uint offset = 0;
+            for (int i = 0; i < chain.levelCount(); i++) {
+                assert(chain.width(i) == std::max(1, size[0] >> i));
+                assert(chain.height(i) == std::max(1, size[1] >> i));
+                assert(chain.offset(i) == offset);
+                assert(chain.level(i) == chain.data() + offset);
+                offset += chain.levelLength(i);
+            }
+            assert(chain.length() == offset);
+            assert(chain.width(chain.levelCount() - 1) == 1 && chain.height(chain.levelCount() - 1) == 1);
+
+            //A box level is a quarter of the one above it
+            for (int i = 1; i < chain.levelCount(); i++) {
+                VImage previous(static_cast<uchar *>(malloc(chain.levelLength(i - 1))), chain.width(i - 1), chain.height(i - 1));
+                memcpy(const_cast<uchar *>(previous.data()), chain.level(i - 1), chain.levelLength(i - 1));
+                previous.quarter(srgb);
+                assert(previous.width() == chain.width(i) && previous.height() == chain.height(i));
+                //The chain rounds where quarter(false) truncates
+                assert(MaxDifference(previous.data(), chain.level(i), chain.levelLength(i)) <= 1);
+            }
+
+            //Same layout whatever the filter
+            const VMipChain kaiser = image.buildMipChain(srgb, VMipChain::KaiserFilter);
+            assert(kaiser.levelCount() == chain.levelCount());
+            assert(kaiser.length() == chain.length());
+        }
+    }
+
+    uchar *pixels = (uchar *) malloc(64 * 32 * 4);
+    for (int i = 0; i < 64 * 32; i++) {
+        pixels[i * 4 + 0] = 200;
+        pixels[i * 4 + 1] = 100;
+        pixels[i * 4 + 2] = 10;
+        pixels[i * 4 + 3] = 255;
+    }
+    //Kaiser's negative lobes must not show on flat areas
+    const VImage flat(pixels, 64, 32);
+    VMipChain chain;
+    flat.buildMipChain(chain, true, VMipChain::KaiserFilter);
+    for (int i = 0; i < chain.levelCount(); i++) {
+        for (uint j = 0; j < chain.levelLength(i); j += 4) {
+            assert(MaxDifference(chain.level(i) + j, pixels, 4) <= 1);
+        }
+    }
+
+    //Rebuilding the same size reuses the allocation
+    const uchar *data = chain.data();
+    flat.buildMipChain(chain, false);
+    assert(chain.data() == data);
+    const VImage small = MakeImage(16, 16, 3);
+    small.buildMipChain(chain, true);
+    assert(chain.data() == data);
+    assert(chain.levelCount() == 5);
+}
+
+ADD_TEST(VImageMipChain, testMipChain)
+
+// Decoding a texture and preparing its mip levels, as VTexture does before uploading. quarter()
+// stands for building the levels one buffer at a time. Best of a few rounds, the rest is noise.
+void benchmarkMipChain()
+{
+    const int sizes[][2] = {{2048, 2048}, {4096, 2048}};
+    for (const int *size : sizes) {
+        const char *path = "vimagemipbenchmark.tga";
+        assert(MakeImage(size[0], size[1], 5).write(path));
+
+        double decodeSeconds = 1e9;
+        double quarterSeconds = 1e9;
+        double boxSeconds = 1e9;
+        double kaiserSeconds = 1e9;
+        VMipChain chain;
+        for (int i = 0; i < 5; i++) {
+            auto start = std::chrono::steady_clock::now();
+            VImage image;
+            image.load(VPath(path));
+            decodeSeconds = std::min(decodeSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            if (!image.isValid()) {
+                continue;
+            }
+
+            VImage levels = image;
+            start = std::chrono::steady_clock::now();
+            VArray<VImage> copies;
+            while (levels.width() > 1 || levels.height() > 1) {
+                levels.quarter(true);
+                copies.append(levels);
+            }
+            quarterSeconds = std::min(quarterSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+            start = std::chrono::steady_clock::now();
+            image.buildMipChain(chain, true);
+            boxSeconds = std::min(boxSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+            start = std::chrono::steady_clock::now();
+            image.buildMipChain(chain, true, VMipChain::KaiserFilter);
+            kaiserSeconds = std::min(kaiserSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        remove(path);
+
+        vInfo("VImage: " << size[0] << "x" << size[1] << " decode " << decodeSeconds * 1000
+              << " ms, quarter per level " << quarterSeconds * 1000
+              << " ms, box chain " << boxSeconds * 1000
+              << " ms, kaiser chain " << kaiserSeconds * 1000 << " ms");
+    }
+}
+
+ADD_TEST(VImageMipChainBenchmark, benchmarkMipChain)
 
 }
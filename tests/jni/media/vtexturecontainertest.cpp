@@ -0,0 +1,361 @@
+#include "test.h"
+
+#include <VTextureContainer.h>
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+NV_USING_NAMESPACE
+
+namespace {
+
+const uint GL_TEXTURE_2D = 0x0DE1;
+const uint GL_TEXTURE_CUBE_MAP = 0x8513;
+const uint GL_UNSIGNED_BYTE = 0x1401;
+const uint GL_RGB = 0x1907;
+const uint GL_RGBA = 0x1908;
+const uint GL_SRGB8_ALPHA8 = 0x8C43;
+const uint GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG = 0x8C02;
+const uint GL_COMPRESSED_RGB8_ETC2 = 0x9274;
+const uint GL_COMPRESSED_SRGB8_ETC2 = 0x9275;
+const uint GL_COMPRESSED_RGBA_ASTC_6x6_KHR = 0x93B4;
+
+void Append32(std::string &data, vuint32 value)
+{
+    data.append(reinterpret_cast<const char *>(&value), 4);
+}
+
+struct Ktx
+{
+    uint glType;
+    uint glFormat;
+    uint glInternalFormat;
+    uint width;
+    uint height;
+    uint depth;
+    uint arrayElements;
+    uint faces;
+    uint keyValueBytes;
+    VArray<uint> levelSizes;
+
+    Ktx(uint glInternalFormat, uint width, uint height, uint faces = 1)
+        : glType(0)
+        , glFormat(0)
+        , glInternalFormat(glInternalFormat)
+        , width(width)
+        , height(height)
+        , depth(0)
+        , arrayElements(0)
+        , faces(faces)
+        , keyValueBytes(8)
+    {
+    }
+
+    // The byte of each level and face is level * 16 + face
+    std::string build(int levelCount = -1) const
+    {
+        std::string ktx;
+        const uchar identifier[12] = {171, 75, 84, 88, 32, 49, 49, 187, 13, 10, 26, 10};
+        ktx.append(reinterpret_cast<const char *>(identifier), sizeof(identifier));
+        Append32(ktx, 0x04030201);
+        Append32(ktx, glType);
+        Append32(ktx, 1);
+        Append32(ktx, glFormat);
+        Append32(ktx, glInternalFormat);
+        Append32(ktx, glFormat);
+        Append32(ktx, width);
+        Append32(ktx, height);
+        Append32(ktx, depth);
+        Append32(ktx, arrayElements);
+        Append32(ktx, faces);
+        Append32(ktx, levelCount < 0 ? levelSizes.size() : levelCount);
+        Append32(ktx, keyValueBytes);
+        ktx.append(std::min(keyValueBytes, 64u), 'k');
+        for (uint level = 0; level < levelSizes.size(); level++) {
+            Append32(ktx, levelSizes[level]);
+            for (uint face = 0; face < faces; face++) {
+                ktx.append(levelSizes[level], (char) (level * 16 + face));
+                ktx.append(3 - ((levelSizes[level] + 3) % 4), 0);
+            }
+        }
+        return ktx;
+    }
+};
+
+std::string MakePvr(vuint64 pixelFormat, int width, int height, int faces, int mipCount, uint dataSize, uint surfaces = 1)
+{
+    std::string pvr;
+    Append32(pvr, 0x03525650);
+    Append32(pvr, 0);
+    pvr.append(reinterpret_cast<const char *>(&pixelFormat), 8);
+    Append32(pvr, 0);
+    Append32(pvr, 0);
+    Append32(pvr, height);
+    Append32(pvr, width);
+    Append32(pvr, 1);
+    Append32(pvr, surfaces);
+    Append32(pvr, faces);
+    Append32(pvr, mipCount);
+    Append32(pvr, 4);
+    pvr.append(4, 'm');
+    for (uint i = 0; i < dataSize; i++) {
+        pvr.append(1, (char) i);
+    }
+    return pvr;
+}
+
+bool Parse(VTextureContainer &container, const std::string &data, int skipLevels = 0, int maxLevels = 0)
+{
+    return container.parse(reinterpret_cast<const uchar *>(data.data()), data.size(), skipLevels, maxLevels);
+}
+
+const uchar *Bytes(const std::string &data)
+{
+    return reinterpret_cast<const uchar *>(data.data());
+}
+
+void test()
+{
+    //ETC2 16x16 with all its levels
+    Ktx etc2(GL_COMPRESSED_RGB8_ETC2, 16, 16);
+    etc2.levelSizes << 128 << 32 << 8 << 8 << 8;
+    const std::string ktx = etc2.build();
+
+    VTextureContainer container;
+    assert(!container.isValid());
+    assert(Parse(container, ktx));
+    assert(container.isValid() && container.type() == VTextureContainer::Ktx);
+    assert(container.width() == 16 && container.height() == 16);
+    assert(container.levelCount() == 5 && container.faceCount() == 1 && !container.isCubeMap());
+    assert(container.skippedLevels() == 0);
+    assert(container.glTarget() == GL_TEXTURE_2D);
+    assert(container.glInternalFormat() == GL_COMPRESSED_RGB8_ETC2);
+    assert(container.glInternalFormat(true) == GL_COMPRESSED_SRGB8_ETC2);
+    assert(container.glFormat() == GL_RGB && container.glType() == 0 && container.isCompressed());
+    assert(container.size() == 128 + 32 + 8 + 8 + 8);
+
+    //The levels are spans of the data, after their image sizes
+    const VArray<VTextureContainer::Level> &levels = container.levels();
+    assert(levels.size() == 5);
+    assert(levels[0].data == Bytes(ktx) + 64 + 8 + 4 && levels[0].size == 128);
+    assert(levels[1].data == Bytes(ktx) + 64 + 8 + 4 + 128 + 4);
+    assert(levels[1].width == 8 && levels[1].height == 8 && levels[1].data[0] == 16);
+    assert(levels[4].width == 1 && levels[4].height == 1 && levels[4].size == 8 && levels[4].data[7] == 64);
+    assert(&container.level(2) == &levels[2]);
+
+    //The largest levels are left out, numbered from the first kept
+    assert(Parse(container, ktx, 2));
+    assert(container.skippedLevels() == 2 && container.levelCount() == 3);
+    assert(container.width() == 4 && container.height() == 4);
+    assert(container.level(0).level == 0 && container.level(0).data[0] == 32);
+    assert(container.size() == 24);
+
+    //At least one level is kept
+    assert(Parse(container, ktx, 10));
+    assert(container.skippedLevels() == 4 && container.levelCount() == 1 && container.width() == 1);
+    assert(Parse(container, ktx, 1, 1));
+    assert(container.levelCount() == 1 && container.width() == 8 && container.size() == 32);
+    assert(Parse(container, ktx, -1, 2));
+    assert(container.skippedLevels() == 0 && container.levelCount() == 2);
+
+    //No mip levels given means a single one
+    Ktx single(GL_COMPRESSED_RGB8_ETC2, 16, 8);
+    single.levelSizes << 64;
+    assert(Parse(container, single.build(0)));
+    assert(container.levelCount() == 1 && container.width() == 16 && container.height() == 8);
+
+    //Uncompressed rows are padded to 4 bytes
+    Ktx rgb(GL_RGB, 5, 2);
+    rgb.glType = GL_UNSIGNED_BYTE;
+    rgb.glFormat = GL_RGB;
+    rgb.levelSizes << 32 << 8 << 4;
+    assert(Parse(container, rgb.build()));
+    assert(!container.isCompressed() && container.glType() == GL_UNSIGNED_BYTE && container.glFormat() == GL_RGB);
+    assert(container.level(1).width == 2 && container.level(1).height == 1);
+    rgb.levelSizes[0] = 30;
+    assert(!Parse(container, rgb.build()));
+
+    //Cube maps have their faces one after another in each level
+    Ktx cube(GL_RGBA, 4, 4, 6);
+    cube.glType = GL_UNSIGNED_BYTE;
+    cube.glFormat = GL_RGBA;
+    cube.levelSizes << 64 << 16 << 4;
+    const std::string cubeKtx = cube.build();
+    assert(Parse(container, cubeKtx));
+    assert(container.isCubeMap() && container.glTarget() == GL_TEXTURE_CUBE_MAP);
+    assert(container.levels().size() == 18);
+    assert(container.level(1, 5).face == 5 && container.level(1, 5).width == 2 && container.level(1, 5).data[0] == 16 + 5);
+    assert(container.glInternalFormat(true) == GL_SRGB8_ALPHA8);
+    assert(Parse(container, cubeKtx, 1));
+    assert(container.levels().size() == 12 && container.level(0, 3).data[0] == 16 + 3);
+
+    //Formats the old loader left out
+    Ktx astc(GL_COMPRESSED_RGBA_ASTC_6x6_KHR, 16, 16);
+    astc.levelSizes << 9 * 16;
+    assert(Parse(container, astc.build()));
+    assert(container.glFormat() == GL_RGBA);
+
+    //PVR levels follow each other, without their sizes
+    const std::string pvr = MakePvr(22, 8, 8, 1, 4, 32 + 8 + 8 + 8);
+    assert(Parse(container, pvr));
+    assert(container.type() == VTextureContainer::Pvr);
+    assert(container.glInternalFormat() == GL_COMPRESSED_RGB8_ETC2);
+    assert(container.levelCount() == 4);
+    assert(container.level(0).data == Bytes(pvr) + 52 + 4 && container.level(0).size == 32);
+    assert(container.level(3).data == Bytes(pvr) + 52 + 4 + 48 && container.level(3).width == 1);
+    assert(Parse(container, pvr, 3));
+    assert(container.width() == 1 && container.size() == 8 && container.level(0).data[0] == 48);
+
+    //PVRTC levels are 2x2 blocks at least
+    assert(Parse(container, MakePvr(3, 8, 8, 1, 4, 32 * 4)));
+    assert(container.glInternalFormat() == GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG && container.size() == 128);
+    assert(Parse(container, MakePvr(578721384203708274ull, 2, 2, 6, 2, 6 * 16 + 6 * 4)));
+    assert(container.glInternalFormat() == GL_RGBA && container.isCubeMap());
+
+    //Clearing forgets everything
+    container.clear();
+    assert(!container.isValid() && container.levels().isEmpty() && container.width() == 0);
+}
+
+ADD_TEST(VTextureContainer, test)
+
+void invalid()
+{
+    VTextureContainer container;
+
+    //Every truncation of a valid file fails without reading past its end
+    Ktx etc2(GL_COMPRESSED_RGB8_ETC2, 16, 16);
+    etc2.levelSizes << 128 << 32 << 8 << 8 << 8;
+    const std::string ktx = etc2.build();
+    const std::string pvr = MakePvr(22, 8, 8, 1, 4, 32 + 8 + 8 + 8);
+    for (uint size = 0; size < ktx.size(); size++) {
+        //A copy of that size alone, so that valgrind or ASan sees the reads past its end
+        const std::string truncated = ktx.substr(0, size);
+        assert(!Parse(container, truncated));
+        assert(!container.isValid());
+    }
+    for (uint size = 0; size < pvr.size(); size++) {
+        assert(!Parse(container, pvr.substr(0, size)));
+    }
+
+    //Levels of the wrong size
+    Ktx wrongSize = etc2;
+    wrongSize.levelSizes[1] = 64;
+    assert(!Parse(container, wrongSize.build()));
+    std::string huge = ktx;
+    const vuint32 hugeSize = 0xFFFFFFF0;
+    memcpy(&huge[64 + 8], &hugeSize, 4);
+    assert(!Parse(container, huge));
+
+    //Key value data past the end, or overflowing the offsets
+    Ktx overflow = etc2;
+    overflow.keyValueBytes = 0xFFFFFFFC;
+    assert(!Parse(container, overflow.build()));
+
+    //More levels than 16x16 has
+    Ktx tooMany = etc2;
+    tooMany.levelSizes << 8;
+    assert(!Parse(container, tooMany.build()));
+
+    //Cube maps are square, and have 6 faces
+    Ktx cube(GL_COMPRESSED_RGB8_ETC2, 16, 8, 6);
+    cube.levelSizes << 64;
+    assert(!Parse(container, cube.build()));
+    cube.width = 8;
+    cube.faces = 3;
+    assert(!Parse(container, cube.build()));
+
+    //Neither 3D textures nor arrays
+    Ktx volume = etc2;
+    volume.depth = 4;
+    assert(!Parse(container, volume.build()));
+    Ktx array = etc2;
+    array.arrayElements = 2;
+    assert(!Parse(container, array.build()));
+    assert(!Parse(container, MakePvr(22, 8, 8, 1, 1, 32 * 2, 2)));
+
+    //Unknown formats and types, or compressed formats given a type
+    Ktx unknown = etc2;
+    unknown.glInternalFormat = 0x1234;
+    assert(!Parse(container, unknown.build()));
+    Ktx typed = etc2;
+    typed.glType = GL_UNSIGNED_BYTE;
+    assert(!Parse(container, typed.build()));
+    Ktx untyped(GL_RGBA, 2, 2);
+    untyped.glFormat = GL_RGBA;
+    untyped.levelSizes << 16;
+    assert(!Parse(container, untyped.build()));
+    untyped.glType = GL_UNSIGNED_BYTE;
+    untyped.glFormat = GL_RGB;
+    assert(!Parse(container, untyped.build()));
+    assert(!Parse(container, MakePvr(12345, 8, 8, 1, 1, 64)));
+
+    //Sizes
+    Ktx empty(GL_COMPRESSED_RGB8_ETC2, 0, 16);
+    empty.levelSizes << 0;
+    assert(!Parse(container, empty.build()));
+    assert(!Parse(container, MakePvr(22, 65536, 1, 1, 1, 0)));
+
+    //Neither KTX nor PVR
+    assert(!Parse(container, "not a texture"));
+    std::string endian = ktx;
+    endian[12] = 4;
+    endian[15] = 1;
+    assert(!Parse(container, endian));
+    std::string version = pvr;
+    version[3] = 2;
+    assert(!Parse(container, version));
+
+    //Nothing was kept of the failures
+    assert(!container.isValid() && container.levels().isEmpty());
+}
+
+ADD_TEST(VTextureContainerInvalid, invalid)
+
+void load()
+{
+    Ktx etc2(GL_COMPRESSED_RGB8_ETC2, 16, 16);
+    etc2.levelSizes << 128 << 32 << 8 << 8 << 8;
+    const std::string ktx = etc2.build();
+
+    const char *path = "./vtexturecontainertest.ktx";
+    FILE *file = fopen(path, "wb");
+    assert(file);
+    fwrite(ktx.data(), 1, ktx.size(), file);
+    fclose(file);
+
+    //The levels are spans of the mapping, which the container keeps
+    VTextureContainer container;
+    assert(container.load(path, 1));
+    remove(path);
+    assert(container.levelCount() == 4 && container.width() == 8);
+    assert(container.level(0).data[0] == 16 && container.level(3).data[7] == 64);
+
+    VTextureContainer copy = container;
+    container.clear();
+    assert(copy.level(1).data[0] == 32);
+
+    assert(!container.load("./vtexturecontainertest.missing"));
+    assert(!container.isValid());
+}
+
+ADD_TEST(VTextureContainerLoad, load)
+
+void levelSize()
+{
+    assert(VTextureContainer::LevelSize(GL_COMPRESSED_RGB8_ETC2, 16, 16) == 128);
+    assert(VTextureContainer::LevelSize(GL_COMPRESSED_RGB8_ETC2, 1, 1) == 8);
+    assert(VTextureContainer::LevelSize(GL_COMPRESSED_SRGB8_ETC2, 6, 5) == 32);
+    assert(VTextureContainer::LevelSize(GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG, 1, 1) == 32);
+    assert(VTextureContainer::LevelSize(GL_COMPRESSED_RGBA_ASTC_6x6_KHR, 7, 6) == 32);
+    assert(VTextureContainer::LevelSize(GL_RGB, 5, 2) == 30);
+    assert(VTextureContainer::LevelSize(GL_RGB, 5, 2, true) == 32);
+    assert(VTextureContainer::LevelSize(GL_RGBA, 5, 2, true) == 40);
+    assert(VTextureContainer::LevelSize(0x1234, 16, 16) == 0);
+}
+
+ADD_TEST(VTextureContainerLevelSize, levelSize)
+
+}
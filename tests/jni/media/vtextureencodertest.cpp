@@ -0,0 +1,530 @@
+#include "test.h"
+
+#include <VImage.h>
+#include <VTextureEncoder.h>
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+NV_USING_NAMESPACE
+
+namespace {
+
+//Decoders of the blocks, written from the Khronos specification apart from the encoder
+namespace decoder {
+
+vuint64 ReadBigEndian(const uchar *block)
+{
+    vuint64 bits = 0;
+    for (int i = 0; i < 8; i++) {
+        bits = (bits << 8) | block[i];
+    }
+    return bits;
+}
+
+int Clamp(int value)
+{
+    return std::min(std::max(value, 0), 255);
+}
+
+int Bits(vuint64 bits, int position, int count)
+{
+    return (int) ((bits >> position) & ((1u << count) - 1));
+}
+
+//Individual, differential and planar blocks into 4x4 RGBA pixels, false for the T and H modes
+bool DecodeEtc2(const uchar *block, uchar *pixels)
+{
+    static const int tables[8][2] = {{2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+    const vuint64 bits = ReadBigEndian(block);
+    const bool differential = Bits(bits, 33, 1) != 0;
+    const bool flip = Bits(bits, 32, 1) != 0;
+
+    int colors[2][3];
+    for (int c = 0; c < 3; c++) {
+        const int shift = 59 - c * 8;
+        if (differential) {
+            const int base = Bits(bits, shift, 5);
+            const int delta = Bits(bits, shift - 3, 3) - (Bits(bits, shift - 1, 1) << 3);
+            const int second = base + delta;
+            if (second < 0 || second > 31) {
+                if (c < 2) {
+                    return false;
+                }
+                //Planar
+                const int ro = Bits(bits, 57, 6);
+                const int go = (Bits(bits, 56, 1) << 6) | Bits(bits, 49, 6);
+                const int bo = (Bits(bits, 48, 1) << 5) | (Bits(bits, 43, 2) << 3) | (Bits(bits, 40, 2) << 1) | Bits(bits, 39, 1);
+                const int rh = (Bits(bits, 34, 5) << 1) | Bits(bits, 32, 1);
+                const int gh = Bits(bits, 25, 7);
+                const int bh = Bits(bits, 19, 6);
+                const int rv = Bits(bits, 13, 6);
+                const int gv = Bits(bits, 6, 7);
+                const int bv = Bits(bits, 0, 6);
+                const int o[3] = {(ro << 2) | (ro >> 4), (go << 1) | (go >> 6), (bo << 2) | (bo >> 4)};
+                const int h[3] = {(rh << 2) | (rh >> 4), (gh << 1) | (gh >> 6), (bh << 2) | (bh >> 4)};
+                const int v[3] = {(rv << 2) | (rv >> 4), (gv << 1) | (gv >> 6), (bv << 2) | (bv >> 4)};
+                for (int y = 0; y < 4; y++) {
+                    for (int x = 0; x < 4; x++) {
+                        for (int k = 0; k < 3; k++) {
+                            pixels[(y * 4 + x) * 4 + k] = (uchar) Clamp((x * (h[k] - o[k]) + y * (v[k] - o[k]) + 4 * o[k] + 2) >> 2);
+                        }
+                        pixels[(y * 4 + x) * 4 + 3] = 255;
+                    }
+                }
+                return true;
+            }
+            colors[0][c] = (base << 3) | (base >> 2);
+            colors[1][c] = (second << 3) | (second >> 2);
+        } else {
+            colors[0][c] = Bits(bits, shift + 1, 4) * 17;
+            colors[1][c] = Bits(bits, shift - 3, 4) * 17;
+        }
+    }
+
+    const int table[2] = {Bits(bits, 37, 3), Bits(bits, 34, 3)};
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            const int half = flip ? y / 2 : x / 2;
+            const int index = x * 4 + y;
+            const int magnitude = tables[table[half]][Bits(bits, index, 1)];
+            const int modifier = Bits(bits, 16 + index, 1) ? -magnitude : magnitude;
+            for (int c = 0; c < 3; c++) {
+                pixels[(y * 4 + x) * 4 + c] = (uchar) Clamp(colors[half][c] + modifier);
+            }
+            pixels[(y * 4 + x) * 4 + 3] = 255;
+        }
+    }
+    return true;
+}
+
+void DecodeEac(const uchar *block, uchar *pixels)
+{
+    static const int tables[16][8] = {
+        {-3, -6, -9, -15, 2, 5, 8, 14}, {-3, -7, -10, -13, 2, 6, 9, 12}, {-2, -5, -8, -13, 1, 4, 7, 12},
+        {-2, -4, -6, -13, 1, 3, 5, 12}, {-3, -6, -8, -12, 2, 5, 7, 11}, {-3, -7, -9, -11, 2, 6, 8, 10},
+        {-4, -7, -8, -11, 3, 6, 7, 10}, {-3, -5, -8, -11, 2, 4, 7, 10}, {-2, -6, -8, -10, 1, 5, 7, 9},
+        {-2, -5, -8, -10, 1, 4, 7, 9}, {-2, -4, -8, -10, 1, 3, 7, 9}, {-2, -5, -7, -10, 1, 4, 6, 9},
+        {-3, -4, -7, -10, 2, 3, 6, 9}, {-1, -2, -3, -10, 0, 1, 2, 9}, {-4, -6, -8, -9, 3, 5, 7, 8},
+        {-3, -5, -7, -9, 2, 4, 6, 8}
+    };
+    const vuint64 bits = ReadBigEndian(block);
+    const int base = Bits(bits, 56, 8);
+    const int multiplier = Bits(bits, 52, 4);
+    const int table = Bits(bits, 48, 4);
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            const int index = Bits(bits, 45 - (x * 4 + y) * 3, 3);
+            pixels[(y * 4 + x) * 4 + 3] = (uchar) Clamp(base + tables[table][index] * multiplier);
+        }
+    }
+}
+
+int BlockBit(const uchar *block, int position)
+{
+    return (block[position >> 3] >> (position & 7)) & 1;
+}
+
+int BlockBits(const uchar *block, int position, int count)
+{
+    int value = 0;
+    for (int i = 0; i < count; i++) {
+        value |= BlockBit(block, position + i) << i;
+    }
+    return value;
+}
+
+//Single partition blocks of one plane with weights and endpoints in whole bits, into 6x6 RGBA
+//pixels. False for the other blocks.
+bool DecodeAstc6x6(const uchar *block, uchar *pixels)
+{
+    const int mode = BlockBits(block, 0, 11);
+    if ((mode & 3) == 0 || ((mode >> 2) & 3) != 0 || (mode >> 9) != 0 || BlockBits(block, 11, 2) != 0) {
+        return false;
+    }
+    const int gridX = ((mode >> 7) & 3) + 4;
+    const int gridY = ((mode >> 5) & 3) + 2;
+    const int range = (((mode >> 4) & 1) | ((mode & 3) << 1)) - 2;
+    //Ranges of 2, 4 and 8 levels and of 16 and 32 with the high precision bit
+    const int weightBits = range == 0 ? 1 : (range == 2 ? 2 : (range == 5 ? 3 : 0));
+    const int endpointMode = BlockBits(block, 13, 4);
+    if (weightBits == 0 || (endpointMode != 8 && endpointMode != 12)) {
+        return false;
+    }
+    const int valueCount = endpointMode == 8 ? 6 : 8;
+    if (17 + valueCount * 8 + gridX * gridY * weightBits > 128) {
+        return false;
+    }
+
+    int values[8];
+    for (int i = 0; i < valueCount; i++) {
+        values[i] = BlockBits(block, 17 + i * 8, 8);
+    }
+    int endpoints[2][4];
+    const bool contracted = values[1] + values[3] + values[5] < values[0] + values[2] + values[4];
+    for (int e = 0; e < 2; e++) {
+        //Blue contraction swaps the endpoints
+        const int *v = values + (contracted ? 1 - e : e);
+        endpoints[e][0] = contracted ? (v[0] + v[4]) >> 1 : v[0];
+        endpoints[e][1] = contracted ? (v[2] + v[4]) >> 1 : v[2];
+        endpoints[e][2] = v[4];
+        endpoints[e][3] = valueCount == 8 ? v[6] : 255;
+    }
+
+    int grid[64];
+    for (int i = 0; i < gridX * gridY; i++) {
+        int value = 0;
+        for (int bit = 0; bit < weightBits; bit++) {
+            value |= BlockBit(block, 127 - (i * weightBits + bit)) << bit;
+        }
+        int unquantized = 0;
+        for (int shift = 6 - weightBits; shift > -weightBits; shift -= weightBits) {
+            unquantized |= shift >= 0 ? value << shift : value >> -shift;
+        }
+        grid[i] = unquantized > 32 ? unquantized + 1 : unquantized;
+    }
+
+    const int size = 6;
+    const int step = (1024 + size / 2) / (size - 1);
+    for (int t = 0; t < size; t++) {
+        for (int s = 0; s < size; s++) {
+            const int gs = (step * s * (gridX - 1) + 32) >> 6;
+            const int gt = (step * t * (gridY - 1) + 32) >> 6;
+            const int js = gs >> 4, fs = gs & 15;
+            const int jt = gt >> 4, ft = gt & 15;
+            const int w11 = (fs * ft + 8) >> 4;
+            const int w10 = ft - w11;
+            const int w01 = fs - w11;
+            const int w00 = 16 - fs - ft + w11;
+            const int v0 = js + jt * gridX;
+            int weight = grid[v0] * w00 + 8;
+            if (w01) {
+                weight += grid[v0 + 1] * w01;
+            }
+            if (w10) {
+                weight += grid[v0 + gridX] * w10;
+            }
+            if (w11) {
+                weight += grid[v0 + gridX + 1] * w11;
+            }
+            weight >>= 4;
+            for (int c = 0; c < 4; c++) {
+                const int e0 = (endpoints[0][c] << 8) | endpoints[0][c];
+                const int e1 = (endpoints[1][c] << 8) | endpoints[1][c];
+                pixels[(t * size + s) * 4 + c] = (uchar) ((((e0 * (64 - weight) + e1 * weight + 32) >> 6)) >> 8);
+            }
+        }
+    }
+    return true;
+}
+
+//The blocks of an encoder into width x height RGBA pixels. False if any block is of a mode the
+//decoders leave out.
+bool Decode(const VTextureEncoder &encoder, const uchar *blocks, int width, int height, uchar *rgba)
+{
+    const int size = encoder.blockSize();
+    const int blocksX = (width + size - 1) / size;
+    const int blocksY = (height + size - 1) / size;
+    uchar pixels[6 * 6 * 4];
+    for (int by = 0; by < blocksY; by++) {
+        for (int bx = 0; bx < blocksX; bx++) {
+            const uchar *block = blocks + (by * blocksX + bx) * encoder.blockBytes();
+            switch (encoder.format()) {
+            case VTextureEncoder::Etc2Rgb:
+                if (!DecodeEtc2(block, pixels)) {
+                    return false;
+                }
+                break;
+            case VTextureEncoder::Etc2Rgba:
+                if (!DecodeEtc2(block + 8, pixels)) {
+                    return false;
+                }
+                DecodeEac(block, pixels);
+                break;
+            case VTextureEncoder::Astc6x6:
+                if (!DecodeAstc6x6(block, pixels)) {
+                    return false;
+                }
+                break;
+            }
+            for (int y = 0; y < size && by * size + y < height; y++) {
+                for (int x = 0; x < size && bx * size + x < width; x++) {
+                    memcpy(rgba + ((by * size + y) * width + bx * size + x) * 4, pixels + (y * size + x) * 4, 4);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+}
+
+//Peak signal to noise ratio of the channels given, in dB
+double Psnr(const uchar *a, const uchar *b, int pixelCount, int channels)
+{
+    double sum = 0.0;
+    for (int i = 0; i < pixelCount; i++) {
+        for (int c = 0; c < channels; c++) {
+            const double d = a[i * 4 + c] - b[i * 4 + c];
+            sum += d * d;
+        }
+    }
+    if (sum == 0.0) {
+        return 99.0;
+    }
+    return 10.0 * log10(255.0 * 255.0 * pixelCount * channels / sum);
+}
+
+//Smooth shading, texture, noise and hard edges like a photo, with soft alpha if asked
+VImage MakePhoto(int width, int height, uint seed, bool alpha)
+{
+    uchar *pixels = (uchar *) malloc(width * height * 4);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uchar *pixel = pixels + (y * width + x) * 4;
+            seed = seed * 1103515245u + 12345u;
+            const int noise = (int) ((seed >> 16) & 7) - 4;
+            const float u = (float) x / width;
+            const float v = (float) y / height;
+            const int edge = ((x / 37 + y / 29) & 1) ? 40 : 0;
+            pixel[0] = (uchar) decoder::Clamp((int) (60 + 120 * u + 30 * sinf(v * 9.0f)) + edge + noise);
+            pixel[1] = (uchar) decoder::Clamp((int) (90 + 80 * v + 25 * sinf((u + v) * 14.0f)) + noise);
+            pixel[2] = (uchar) decoder::Clamp((int) (150 - 90 * u * v + 20 * cosf(u * 21.0f)) + edge / 2 + noise);
+            pixel[3] = alpha ? (uchar) decoder::Clamp((int) (255 * (0.5f + 0.5f * sinf(u * 6.0f + v * 4.0f)))) : 255;
+        }
+    }
+    return VImage(pixels, width, height);
+}
+
+VArray<uchar> Encode(const VTextureEncoder &encoder, const uchar *rgba, int width, int height)
+{
+    VArray<uchar> blocks;
+    blocks.resize(encoder.encodedSize(width, height));
+    encoder.encode(rgba, width, height, blocks.data());
+    return blocks;
+}
+
+//Encodes and decodes an image, the PSNR of the channels of the format
+double RoundTrip(const VTextureEncoder &encoder, const VImage &image)
+{
+    const int width = image.width();
+    const int height = image.height();
+    const VArray<uchar> blocks = Encode(encoder, image.data(), width, height);
+    VArray<uchar> decoded;
+    decoded.resize(width * height * 4);
+    assert(decoder::Decode(encoder, blocks.data(), width, height, decoded.data()));
+    const int channels = encoder.format() == VTextureEncoder::Etc2Rgb ? 3 : 4;
+    return Psnr(image.data(), decoded.data(), width * height, channels);
+}
+
+void testSizes()
+{
+    VTextureEncoder etc;
+    assert(etc.format() == VTextureEncoder::Etc2Rgb && etc.quality() == VTextureEncoder::NormalQuality);
+    assert(etc.blockSize() == 4 && etc.blockBytes() == 8);
+    assert(etc.encodedSize(5, 3) == 2 * 8);
+    assert(etc.glInternalFormat() == 0x9275 && etc.glInternalFormat(false) == 0x9274);
+
+    VTextureEncoder etcAlpha(VTextureEncoder::Etc2Rgba);
+    assert(etcAlpha.blockSize() == 4 && etcAlpha.blockBytes() == 16);
+    assert(etcAlpha.encodedSize(16, 16) == 16 * 16);
+    assert(etcAlpha.glInternalFormat() == 0x9279 && etcAlpha.glInternalFormat(false) == 0x9278);
+
+    VTextureEncoder astc(VTextureEncoder::Astc6x6, VTextureEncoder::FastQuality);
+    assert(astc.blockSize() == 6 && astc.blockBytes() == 16);
+    assert(astc.encodedSize(13, 7) == 3 * 2 * 16);
+    assert(astc.glInternalFormat() == 0x93D4 && astc.glInternalFormat(false) == 0x93B4);
+}
+
+ADD_TEST(VTextureEncoderSizes, testSizes)
+
+void testConstant()
+{
+    const VTextureEncoder::Format formats[] = {VTextureEncoder::Etc2Rgb, VTextureEncoder::Etc2Rgba, VTextureEncoder::Astc6x6};
+    const VTextureEncoder::Quality qualities[] = {VTextureEncoder::FastQuality, VTextureEncoder::NormalQuality, VTextureEncoder::HighQuality};
+    const uchar colors[][4] = {{0, 0, 0, 255}, {255, 255, 255, 255}, {200, 37, 90, 128}, {13, 140, 251, 0}};
+    for (VTextureEncoder::Format format : formats) {
+        for (VTextureEncoder::Quality quality : qualities) {
+            const VTextureEncoder encoder(format, quality);
+            for (const uchar *color : colors) {
+                uchar rgba[12 * 12 * 4];
+                for (int i = 0; i < 12 * 12; i++) {
+                    memcpy(rgba + i * 4, color, 4);
+                }
+                const VArray<uchar> blocks = Encode(encoder, rgba, 12, 12);
+                uchar decoded[12 * 12 * 4];
+                assert(decoder::Decode(encoder, blocks.data(), 12, 12, decoded));
+                for (int i = 0; i < 12 * 12; i++) {
+                    for (int c = 0; c < 3; c++) {
+                        assert(abs(decoded[i * 4 + c] - color[c]) <= 4);
+                    }
+                    if (format == VTextureEncoder::Etc2Rgb) {
+                        assert(decoded[i * 4 + 3] == 255);
+                    } else if (format == VTextureEncoder::Etc2Rgba || color[3] == 255) {
+                        //A single alpha is exact in EAC, and in ASTC as long as it is opaque
+                        assert(decoded[i * 4 + 3] == color[3]);
+                    } else {
+                        assert(abs(decoded[i * 4 + 3] - color[3]) <= 1);
+                    }
+                }
+            }
+        }
+    }
+}
+
+ADD_TEST(VTextureEncoderConstant, testConstant)
+
+void testGradient()
+{
+    //Smooth gradients band with the modifiers and are left to the planar mode
+    uchar rgba[16 * 16 * 4];
+    for (int y = 0; y < 16; y++) {
+        for (int x = 0; x < 16; x++) {
+            uchar *pixel = rgba + (y * 16 + x) * 4;
+            pixel[0] = (uchar) (40 + x * 9);
+            pixel[1] = (uchar) (200 - y * 7);
+            pixel[2] = (uchar) (60 + x * 3 + y * 5);
+            pixel[3] = 255;
+        }
+    }
+
+    const VTextureEncoder fast(VTextureEncoder::Etc2Rgb, VTextureEncoder::FastQuality);
+    const VTextureEncoder normal(VTextureEncoder::Etc2Rgb, VTextureEncoder::NormalQuality);
+    const VArray<uchar> blocks = Encode(normal, rgba, 16, 16);
+    int planar = 0;
+    for (int i = 0; i < 16; i++) {
+        const uchar *block = blocks.data() + i * 8;
+        const int blue = block[2] >> 3;
+        const int delta = (block[2] & 3) - (block[2] & 4);
+        planar += (block[3] & 2) && (blue + delta < 0 || blue + delta > 31);
+    }
+    assert(planar >= 12);
+
+    uchar decoded[16 * 16 * 4];
+    assert(decoder::Decode(normal, blocks.data(), 16, 16, decoded));
+    const double normalPsnr = Psnr(rgba, decoded, 16 * 16, 3);
+    const VArray<uchar> fastBlocks = Encode(fast, rgba, 16, 16);
+    assert(decoder::Decode(fast, fastBlocks.data(), 16, 16, decoded));
+    const double fastPsnr = Psnr(rgba, decoded, 16 * 16, 3);
+    assert(normalPsnr > 42.0);
+    assert(normalPsnr > fastPsnr);
+}
+
+ADD_TEST(VTextureEncoderGradient, testGradient)
+
+void testQuality()
+{
+    const VImage photo = MakePhoto(97, 61, 7, false);
+    const VImage photoAlpha = MakePhoto(97, 61, 11, true);
+    const VTextureEncoder::Format formats[] = {VTextureEncoder::Etc2Rgb, VTextureEncoder::Etc2Rgba, VTextureEncoder::Astc6x6};
+    //ASTC 6x6 takes half the bits of ETC2 for a pixel
+    const double minimums[] = {35.0, 35.0, 31.0};
+    for (int f = 0; f < 3; f++) {
+        const VImage &image = formats[f] == VTextureEncoder::Etc2Rgb ? photo : photoAlpha;
+        const double fast = RoundTrip(VTextureEncoder(formats[f], VTextureEncoder::FastQuality), image);
+        const double normal = RoundTrip(VTextureEncoder(formats[f], VTextureEncoder::NormalQuality), image);
+        const double high = RoundTrip(VTextureEncoder(formats[f], VTextureEncoder::HighQuality), image);
+        vInfo("VTextureEncoder: format " << formats[f] << " fast " << fast << " dB, normal " << normal << " dB, high " << high << " dB");
+        assert(fast > minimums[f] - 2.0);
+        assert(normal > minimums[f]);
+        assert(normal >= fast - 0.1);
+        assert(high >= normal - 0.1);
+    }
+
+    //The opaque ASTC blocks take 3 bit weights, and the ones with alpha 2 bits
+    const VTextureEncoder astc(VTextureEncoder::Astc6x6);
+    VArray<uchar> blocks = Encode(astc, photo.data(), 12, 12);
+    assert(decoder::BlockBits(blocks.data(), 0, 11) == 0x53 && decoder::BlockBits(blocks.data(), 13, 4) == 8);
+    blocks = Encode(astc, photoAlpha.data(), 12, 12);
+    assert(decoder::BlockBits(blocks.data(), 0, 11) == 0x42 && decoder::BlockBits(blocks.data(), 13, 4) == 12);
+}
+
+ADD_TEST(VTextureEncoderQuality, testQuality)
+
+void testThreads()
+{
+    //Large enough to be split among the workers, the same as the rows encoded one band at a time
+    const int width = 320;
+    const int height = 320;
+    const VImage image = MakePhoto(width, height, 3, true);
+    const VTextureEncoder::Format formats[] = {VTextureEncoder::Etc2Rgb, VTextureEncoder::Etc2Rgba, VTextureEncoder::Astc6x6};
+    for (VTextureEncoder::Format format : formats) {
+        const VTextureEncoder encoder(format, VTextureEncoder::FastQuality);
+        const VByteArray blocks = encoder.encode(image);
+        assert(blocks.size() == encoder.encodedSize(width, height));
+
+        const int size = encoder.blockSize();
+        VArray<uchar> bands;
+        for (int y = 0; y < height; y += size) {
+            const int rows = std::min(size, height - y);
+            const VArray<uchar> band = Encode(encoder, image.data() + y * width * 4, width, rows);
+            bands.append(band);
+        }
+        assert(bands.size() == blocks.size());
+        assert(memcmp(bands.data(), blocks.data(), bands.size()) == 0);
+    }
+}
+
+ADD_TEST(VTextureEncoderThreads, testThreads)
+
+void testMipChain()
+{
+    const VImage image = MakePhoto(40, 24, 5, false);
+    const VMipChain chain = image.buildMipChain(true);
+    const VTextureEncoder encoder(VTextureEncoder::Etc2Rgb, VTextureEncoder::FastQuality);
+    const VByteArray blocks = encoder.encode(chain);
+
+    uint offset = 0;
+    for (int i = 0; i < chain.levelCount(); i++) {
+        const VArray<uchar> level = Encode(encoder, chain.level(i), chain.width(i), chain.height(i));
+        assert(offset + level.size() <= blocks.size());
+        assert(memcmp(blocks.data() + offset, level.data(), level.size()) == 0);
+        offset += level.size();
+    }
+    assert(offset == blocks.size());
+    //40x24, 20x12, 10x6, 5x3, 2x1 and 1x1
+    assert(offset == (10 * 6 + 5 * 3 + 3 * 2 + 2 + 1 + 1) * 8u);
+}
+
+ADD_TEST(VTextureEncoderMipChain, testMipChain)
+
+//Photo sized images in each format and quality, reported in megapixels per second
+//    unittest VTextureEncoderBenchmark
+void benchmark()
+{
+    const int width = 1024;
+    const int height = 1024;
+    const VImage photo = MakePhoto(width, height, 1, false);
+    const VImage photoAlpha = MakePhoto(width, height, 2, true);
+    const VTextureEncoder::Format formats[] = {VTextureEncoder::Etc2Rgb, VTextureEncoder::Etc2Rgba, VTextureEncoder::Astc6x6};
+    const char *formatNames[] = {"ETC2 RGB", "ETC2 RGBA", "ASTC 6x6"};
+    const VTextureEncoder::Quality qualities[] = {VTextureEncoder::FastQuality, VTextureEncoder::NormalQuality, VTextureEncoder::HighQuality};
+    const char *qualityNames[] = {"fast", "normal", "high"};
+
+    for (int f = 0; f < 3; f++) {
+        const VImage &image = formats[f] == VTextureEncoder::Etc2Rgb ? photo : photoAlpha;
+        for (int q = 0; q < 3; q++) {
+            const VTextureEncoder encoder(formats[f], qualities[q]);
+            VArray<uchar> blocks;
+            blocks.resize(encoder.encodedSize(width, height));
+            double seconds = 1e9;
+            for (int i = 0; i < 3; i++) {
+                auto start = std::chrono::steady_clock::now();
+                encoder.encode(image.data(), width, height, blocks.data());
+                seconds = std::min(seconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+            VArray<uchar> decoded;
+            decoded.resize(width * height * 4);
+            decoder::Decode(encoder, blocks.data(), width, height, decoded.data());
+            const double psnr = Psnr(image.data(), decoded.data(), width * height, formats[f] == VTextureEncoder::Etc2Rgb ? 3 : 4);
+            vInfo("VTextureEncoder: " << formatNames[f] << " " << qualityNames[q] << " " << width << "x" << height << " "
+                  << seconds * 1000 << " ms, " << width * height / 1e6 / seconds << " Mpix/s, " << psnr << " dB");
+        }
+    }
+}
+
+ADD_TEST(VTextureEncoderBenchmark, benchmark)
+
+}
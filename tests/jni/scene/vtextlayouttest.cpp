@@ -0,0 +1,344 @@
+#include "test.h"
+
+#include <VArray.h>
+#include <VTextLayout.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+NV_USING_NAMESPACE
+
+namespace {
+
+//Glyphs of the same size for the printable ASCII characters, the font image is not needed to lay text out
+FontMetricsType MakeFont()
+{
+    FontMetricsType font;
+    font.FontHeight = 1.2f;
+    font.ScaleFactorX = 2.0f;
+    font.ScaleFactorY = 3.0f;
+    font.MaxAscent = 0.8f;
+    font.MaxDescent = 0.2f;
+    font.DistanceScale = 2.0f;
+    font.CharCodeMap.resize(127);
+    for (int i = 0; i < font.CharCodeMap.length(); i++) {
+        font.CharCodeMap[i] = -1;
+    }
+    for (int c = 32; c < 127; c++) {
+        FontGlyphType g;
+        g.CharCode = c;
+        g.X = (c - 32) * 0.01f;
+        g.Y = 0.5f;
+        g.Width = 0.5f;
+        g.Height = 1.0f;
+        g.AdvanceX = 0.6f;
+        g.BearingX = 0.05f;
+        g.BearingY = 0.8f;
+        font.CharCodeMap[c] = font.Glyphs.length();
+        font.Glyphs.append(g);
+    }
+    return font;
+}
+
+bool Near(float a, float b)
+{
+    return fabs(a - b) < 1e-4f;
+}
+
+bool Near(const VVect3f &a, const VVect3f &b)
+{
+    return Near(a.x, b.x) && Near(a.y, b.y) && Near(a.z, b.z);
+}
+
+bool QuadIs(const VTextLayout::Quad &quad, float left, float bottom, float right, float top)
+{
+    return Near(quad.left, left) && Near(quad.bottom, bottom) && Near(quad.right, right) && Near(quad.top, top);
+}
+
+void testLayout()
+{
+    const FontMetricsType font = MakeFont();
+    fontParms_t parms;
+
+    VTextLayout layout;
+    layout.layout(font, parms, "AB");
+    assert(layout.quadCount() == 2 && layout.lineCount() == 1);
+    //Bearing and size scaled by 2 across and 3 up, from the baseline
+    assert(QuadIs(layout.quads()[0], 0.1f, -0.6f, 1.1f, 2.4f));
+    assert(QuadIs(layout.quads()[1], 1.3f, -0.6f, 2.3f, 2.4f));
+    const char A = 'A' - 32;
+    assert(Near(layout.quads()[0].s0, A * 0.01f) && Near(layout.quads()[0].s1, A * 0.01f + 0.5f));
+    assert(Near(layout.quads()[0].t0, 0.5f) && Near(layout.quads()[0].t1, 1.5f));
+    assert(Near(layout.width(), 2.4f) && Near(layout.height(), 3.0f));
+
+    //Each line centered on its own, line endings take no room
+    parms.AlignHoriz = HORIZONTAL_CENTER;
+    layout.layout(font, parms, "A\r\nBC");
+    assert(layout.quadCount() == 3);
+    assert(QuadIs(layout.quads()[0], -0.5f, -0.6f, 0.5f, 2.4f));
+    assert(QuadIs(layout.quads()[1], -1.1f, -4.2f, -0.1f, -1.2f));
+    assert(QuadIs(layout.quads()[2], 0.1f, -4.2f, 1.1f, -1.2f));
+
+    parms.AlignHoriz = HORIZONTAL_RIGHT;
+    parms.AlignVert = VERTICAL_CENTER;
+    layout.layout(font, parms, "AB");
+    //Half the height of 3 less the ascent of 2.4
+    assert(QuadIs(layout.quads()[1], -1.1f, -1.5f, -0.1f, 1.5f));
+
+    parms.AlignVert = VERTICAL_TOP;
+    layout.layout(font, parms, "A\nB");
+    //Moved up by the height of both lines less the ascent of the first, as DrawText3D did
+    assert(layout.lineCount() == 2 && Near(layout.height(), 6.6f));
+    assert(Near(layout.quads()[0].top, 6.6f) && Near(layout.quads()[1].top, 3.0f));
+
+    layout.layout(font, parms, "");
+    assert(layout.isEmpty() && layout.lineCount() == 0);
+
+    //The vertices as BitmapFontSurface draws them
+    parms = fontParms_t();
+    layout.layout(font, parms, "A");
+    VTextLayout::Vertex v[4];
+    const uint color = VTextLayout::ColorToAbgr(VVect4f(1.0f, 0.5f, 0.0f, 1.0f));
+    assert(color == 0xff007fff);
+    layout.place(VVect3f(10.0f, 0.0f, 0.0f), VVect3f(0.0f, 0.0f, -1.0f), VVect3f(0.0f, 2.0f, 0.0f), color, v);
+    assert(Near(v[0].xyz, VVect3f(10.0f, -1.2f, -0.1f)));
+    assert(Near(v[1].xyz, VVect3f(10.0f, 4.8f, -0.1f)) && Near(v[1].t, 0.5f));
+    assert(Near(v[2].xyz, VVect3f(10.0f, 4.8f, -1.1f)));
+    assert(Near(v[3].xyz, VVect3f(10.0f, -1.2f, -1.1f)) && Near(v[3].t, 1.5f));
+    for (const VTextLayout::Vertex &vertex : v) {
+        assert(vertex.rgba[0] == 255 && vertex.rgba[1] == 127 && vertex.rgba[2] == 0 && vertex.rgba[3] == 255);
+        assert(vertex.fontParms[0] == 108 && vertex.fontParms[1] == 127 && vertex.fontParms[2] == 2 && vertex.fontParms[3] == 0);
+    }
+}
+
+ADD_TEST(VTextLayoutQuads, testLayout)
+
+//Placed by a full matrix a vertex, as BitmapFontSurface did before the layouts were kept
+VVect3f PlaceByMatrix(const VMatrix4f &viewMatrix, const VVect3f &pivot, const VVect3f &local, bool billboard, bool trackRoll)
+{
+    const VMatrix4f invViewMatrix = viewMatrix.inverted();
+    const VVect3f viewPos = invViewMatrix.translation();
+    VMatrix4f transform;
+    if (billboard) {
+        if (trackRoll) {
+            transform = invViewMatrix;
+        } else {
+            VVect3f textNormal = viewPos - pivot;
+            textNormal *= 1.0f / textNormal.length();
+            transform = VMatrix4f::CreateFromBasisVectors(textNormal, VVect3f(0.0f, 1.0f, 0.0f));
+        }
+    }
+    transform.setTranslation(pivot);
+    return transform.transform(local);
+}
+
+void testPlacement()
+{
+    const FontMetricsType font = MakeFont();
+    fontParms_t parms;
+    parms.AlignHoriz = HORIZONTAL_CENTER;
+    parms.AlignVert = VERTICAL_CENTER;
+    VTextLayout layout;
+    layout.layout(font, parms, "Hello\nworld");
+
+    const VMatrix4f viewMatrix = VMatrix4f::LookAtRH(VVect3f(1.0f, 1.6f, 2.0f), VVect3f(0.0f, 0.0f, -3.0f), VVect3f(0.2f, 1.0f, 0.0f).normalized());
+    const VVect3f pivot(0.5f, 1.0f, -4.0f);
+    const float scale = 0.25f;
+    const VVect3f up = VVect3f(0.0f, 1.0f, 0.0f);
+    const VVect3f right = up.crossProduct(VVect3f(0.0f, 0.0f, 1.0f));
+    const int numVerts = layout.quadCount() * 4;
+
+    //Local vertices at the origin, as DrawText3D built them
+    VArray<VTextLayout::Vertex> billboardLocal;
+    billboardLocal.resize(numVerts);
+    layout.place(VVect3f(0.0f), VVect3f(scale, 0.0f, 0.0f), VVect3f(0.0f, scale, 0.0f), 0, billboardLocal.data());
+    VArray<VTextLayout::Vertex> fixedLocal;
+    fixedLocal.resize(numVerts);
+    layout.place(VVect3f(0.0f), right * scale, up * scale, 0, fixedLocal.data());
+
+    for (int mode = 0; mode < 3; mode++) {
+        const bool billboard = mode > 0;
+        const bool trackRoll = mode == 2;
+        VTextBatch batch;
+        batch.add(layout, pivot, billboard ? VVect3f(scale, 0.0f, 0.0f) : right * scale,
+                  billboard ? VVect3f(0.0f, scale, 0.0f) : up * scale, 0xffffffff, billboard, trackRoll);
+        assert(batch.blockCount() == 1 && batch.quadCount() == 10);
+
+        VArray<VTextLayout::Vertex> vertices;
+        vertices.resize(numVerts);
+        assert(batch.place(viewMatrix, vertices.data(), numVerts) == numVerts);
+        assert(batch.isEmpty());
+        const VArray<VTextLayout::Vertex> &local = billboard ? billboardLocal : fixedLocal;
+        for (int i = 0; i < numVerts; i++) {
+            assert(Near(vertices[i].xyz, PlaceByMatrix(viewMatrix, pivot, local[i].xyz, billboard, trackRoll)));
+            assert(vertices[i].s == local[i].s && vertices[i].t == local[i].t);
+        }
+    }
+}
+
+ADD_TEST(VTextLayoutPlacement, testPlacement)
+
+void testOrder()
+{
+    const FontMetricsType font = MakeFont();
+    fontParms_t parms;
+    VArray<VTextLayout> layouts;
+    layouts.resize(300);
+
+    //More blocks than the 256 BitmapFontSurface could sort, nearest first whatever order they came in
+    VTextBatch batch;
+    for (int i = 0; i < 300; i++) {
+        const int distance = (i * 7) % 300;
+        layouts[i].layout(font, parms, VString::number(distance));
+        batch.add(layouts[i], VVect3f(0.0f, 0.0f, -1.0f - distance), VVect3f(1.0f, 0.0f, 0.0f), VVect3f(0.0f, 1.0f, 0.0f),
+                  0xffffffff, false, false);
+    }
+    //Nothing to draw
+    batch.add(VTextLayout(), VVect3f(0.0f), VVect3f(1.0f, 0.0f, 0.0f), VVect3f(0.0f, 1.0f, 0.0f), 0, false, false);
+    assert(batch.blockCount() == 300);
+
+    VArray<VTextLayout::Vertex> vertices;
+    vertices.resize(batch.quadCount() * 4);
+    assert(batch.place(VMatrix4f(), vertices.data(), vertices.length()) == vertices.length());
+    float z = 1.0f;
+    for (const VTextLayout::Vertex &vertex : vertices) {
+        assert(vertex.xyz.z <= z);
+        z = vertex.xyz.z;
+    }
+    assert(vertices[0].xyz.z == -1.0f && vertices.last().xyz.z == -300.0f);
+
+    //The blocks that don't fit are left out whole
+    batch.add(layouts[1], VVect3f(0.0f, 0.0f, -1.0f), VVect3f(1.0f, 0.0f, 0.0f), VVect3f(0.0f, 1.0f, 0.0f), 0, false, false);
+    batch.add(layouts[0], VVect3f(0.0f, 0.0f, -2.0f), VVect3f(1.0f, 0.0f, 0.0f), VVect3f(0.0f, 1.0f, 0.0f), 0, false, false);
+    //"7" then "0"
+    assert(batch.place(VMatrix4f(), vertices.data(), 6) == 4);
+    assert(vertices[0].xyz.z == -1.0f);
+}
+
+ADD_TEST(VTextLayoutOrder, testOrder)
+
+void testCache()
+{
+    const FontMetricsType font = MakeFont();
+    const FontMetricsType otherFont = MakeFont();
+    fontParms_t parms;
+    VTextLayoutCache cache;
+
+    const VTextLayout &fps = cache.layout(font, parms, "60 fps");
+    assert(fps.quadCount() == 6);
+    assert(&cache.layout(font, parms, "60 fps") == &fps);
+    //Keyed by font, text and the parms that change the layout
+    assert(&cache.layout(otherFont, parms, "60 fps") != &fps);
+    fontParms_t centered = parms;
+    centered.AlignHoriz = HORIZONTAL_CENTER;
+    assert(&cache.layout(font, centered, "60 fps") != &fps);
+    fontParms_t billboard = parms;
+    billboard.Billboard = true;
+    billboard.TrackRoll = true;
+    assert(&cache.layout(font, billboard, "60 fps") == &fps);
+
+    //Layouts stay where they are as others are added
+    for (int i = 0; i < 100; i++) {
+        cache.layout(font, parms, VString::number(i));
+    }
+    assert(&cache.layout(font, parms, "60 fps") == &fps && fps.quadCount() == 6);
+
+    cache.update();
+    VTextLayoutCache::Stats stats = cache.stats();
+    assert(stats.layouts == 103 && stats.hits == 3 && stats.misses == 103 && stats.evicted == 0);
+    assert(stats.quads == 6 * 3 + 10 + 90 * 2);
+
+    //Text not drawn in the last frame goes
+    cache.layout(font, parms, "60 fps");
+    cache.update();
+    cache.layout(font, parms, "60 fps");
+    cache.layout(font, parms, "59 fps");
+    cache.update();
+    stats = cache.stats();
+    assert(stats.layouts == 2 && stats.hits == 1 && stats.misses == 1 && stats.evicted == 0);
+    cache.update();
+    assert(cache.stats().evicted == 2 && cache.stats().layouts == 0 && cache.stats().quads == 0);
+
+    VTextLayoutCache keeping(3);
+    keeping.layout(font, parms, "a");
+    keeping.update();
+    keeping.update();
+    keeping.update();
+    assert(keeping.stats().layouts == 1);
+    keeping.update();
+    assert(keeping.stats().layouts == 0);
+}
+
+ADD_TEST(VTextLayoutCache, testCache)
+
+//Laying out and placing labels of 16 characters every frame, reported in microseconds a frame
+//    unittest VTextLayoutBenchmark
+void benchmark()
+{
+    const FontMetricsType font = MakeFont();
+    fontParms_t parms;
+    parms.AlignHoriz = HORIZONTAL_CENTER;
+    parms.AlignVert = VERTICAL_CENTER;
+    const VMatrix4f viewMatrix = VMatrix4f::LookAtRH(VVect3f(0.0f, 1.6f, 0.0f), VVect3f(0.0f, 1.6f, -1.0f), VVect3f(0.0f, 1.0f, 0.0f));
+    const int labelCounts[] = {1, 10, 100, 1000};
+    const int frames = 100;
+
+    for (int labelCount : labelCounts) {
+        VArray<VString> labels;
+        VArray<VVect3f> positions;
+        for (int i = 0; i < labelCount; i++) {
+            char label[32];
+            snprintf(label, sizeof(label), "Label %04d %05.1f", i, i * 0.5f);
+            labels.append(label);
+            positions.append(VVect3f(sinf(i * 0.1f) * 5.0f, (i % 20) * 0.1f, -2.0f - i * 0.01f));
+        }
+        VArray<VTextLayout::Vertex> vertices;
+        vertices.resize(labelCount * 16 * 4);
+
+        //As every frame laid the text out again before
+        VArray<VTextLayout> layouts;
+        layouts.resize(labelCount);
+        VTextBatch batch;
+        double layoutSeconds = 0.0;
+        double placeSeconds = 0.0;
+        for (int frame = 0; frame < frames; frame++) {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < labelCount; i++) {
+                layouts[i].layout(font, parms, labels[i]);
+                batch.add(layouts[i], positions[i], VVect3f(0.01f, 0.0f, 0.0f), VVect3f(0.0f, 0.01f, 0.0f), 0xffffffff, true, false);
+            }
+            auto laidOut = std::chrono::steady_clock::now();
+            assert(batch.place(viewMatrix, vertices.data(), vertices.length()) == vertices.length());
+            layoutSeconds += std::chrono::duration<double>(laidOut - start).count();
+            placeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - laidOut).count();
+        }
+
+        VTextLayoutCache cache;
+        double cachedSeconds = 0.0;
+        double cachedPlaceSeconds = 0.0;
+        for (int frame = 0; frame < frames; frame++) {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < labelCount; i++) {
+                batch.add(cache.layout(font, parms, labels[i]), positions[i], VVect3f(0.01f, 0.0f, 0.0f), VVect3f(0.0f, 0.01f, 0.0f),
+                          0xffffffff, true, false);
+            }
+            auto laidOut = std::chrono::steady_clock::now();
+            assert(batch.place(viewMatrix, vertices.data(), vertices.length()) == vertices.length());
+            cache.update();
+            cachedSeconds += std::chrono::duration<double>(laidOut - start).count();
+            cachedPlaceSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - laidOut).count();
+        }
+        assert(cache.stats().hits == labelCount && cache.stats().layouts == labelCount);
+
+        const double us = 1e6 / frames;
+        vInfo("VTextLayout: " << labelCount << " labels, laid out every frame " << layoutSeconds * us << " us + finish "
+              << placeSeconds * us << " us, cached " << cachedSeconds * us << " us + finish " << cachedPlaceSeconds * us << " us");
+    }
+}
+
+ADD_TEST(VTextLayoutBenchmark, benchmark)
+
+}
@@ -0,0 +1,247 @@
+#include "test.h"
+
+#include <VArray.h>
+#include <VTextureCache.h>
+
+#include <algorithm>
+
+NV_USING_NAMESPACE
+
+namespace {
+
+const uint GL_TEXTURE_2D = 0x0DE1;
+
+// What the loader did, kept by the test as the cache deletes its loader
+struct Record
+{
+    Record() : loads(0), nextId(1) {}
+
+    int loads;
+    uint nextId;
+    VArray<uint> live;
+    VArray<uint> destroyed;
+    VArray<VString> loadedPaths;
+};
+
+// Textures of a size given by the digits at the end of their path, "missing" paths fail
+class RecordingLoader : public VTextureCache::Loader
+{
+public:
+    explicit RecordingLoader(Record &record) : record(record) {}
+
+    bool load(const VString &path, const VTexture::Flags &flags, VTextureCache::Texture &texture) override
+    {
+        NV_UNUSED(flags);
+        record.loads++;
+        record.loadedPaths.append(path);
+        if (path.startsWith("missing")) {
+            return false;
+        }
+        uint size = 0;
+        for (int i = 0; i < path.length(); i++) {
+            if (path[i] >= '0' && path[i] <= '9') {
+                size = size * 10 + (path[i] - '0');
+            }
+        }
+        texture.id = record.nextId++;
+        texture.target = GL_TEXTURE_2D;
+        texture.width = 16;
+        texture.height = 16;
+        texture.size = size;
+        record.live.append(texture.id);
+        return true;
+    }
+
+    void destroy(const VTextureCache::Texture &texture) override
+    {
+        auto live = std::find(record.live.begin(), record.live.end(), texture.id);
+        assert(live != record.live.end());
+        record.live.erase(live);
+        record.destroyed.append(texture.id);
+    }
+
+    Record &record;
+};
+
+void testHits()
+{
+    Record record;
+    VTextureCache cache(new RecordingLoader(record));
+    assert(cache.budget() == 0);
+
+    VTextureCache::Texture a = cache.texture("a100");
+    assert(a.id != 0 && a.target == GL_TEXTURE_2D && a.size == 100);
+    assert(cache.texture("a100").id == a.id);
+    assert(cache.texture("b200").size == 200);
+    //Flags make a texture of their own
+    assert(cache.texture("a100", VTexture::UseSRGB).id != a.id);
+    assert(cache.contains("a100") && cache.isResident("a100", VTexture::UseSRGB));
+    assert(!cache.contains("c300"));
+    assert(record.loads == 3);
+
+    cache.update();
+    VTextureCache::Stats stats = cache.stats();
+    assert(stats.textures == 3 && stats.resident == 3);
+    assert(stats.residentBytes == 400 && stats.maxResidentBytes == 400);
+    assert(stats.hits == 1 && stats.misses == 3 && stats.evictions == 0);
+    assert(stats.loadedBytes == 400);
+    assert(stats.hitRate() == 0.25);
+    assert(stats.frames == 1);
+
+    cache.texture("a100");
+    cache.texture("b200");
+    cache.update();
+    stats = cache.stats();
+    assert(stats.hits == 2 && stats.misses == 0 && stats.loadedBytes == 0);
+    assert(stats.hitRate() == 1.0);
+    assert(stats.totalHits == 3 && stats.totalMisses == 3 && stats.frames == 2);
+
+    //Nothing asked for
+    cache.update();
+    assert(cache.stats().hitRate() == 1.0 && cache.stats().hits == 0);
+    assert(record.loads == 3 && record.destroyed.isEmpty());
+}
+
+ADD_TEST(VTextureCacheHits, testHits)
+
+void testEviction()
+{
+    Record record;
+    VTextureCache cache(new RecordingLoader(record), 300);
+
+    cache.texture("a100");
+    cache.update();
+    cache.texture("b100");
+    cache.update();
+    cache.texture("c100");
+    cache.update();
+    //a is the least recently used once used before b and c
+    const uint a = cache.texture("a100").id;
+    cache.update();
+    assert(cache.stats().residentBytes == 300 && cache.stats().evictions == 0);
+
+    //b goes to make room for d
+    cache.texture("d100");
+    assert(!cache.isResident("b100") && cache.isResident("a100") && cache.isResident("c100"));
+    assert(cache.stats().residentBytes == 300);
+    cache.update();
+    VTextureCache::Stats stats = cache.stats();
+    assert(stats.evictions == 1 && stats.evictedBytes == 100 && stats.misses == 1);
+    assert(stats.maxResidentBytes == 300);
+
+    //Loaded again from its path, under a new id
+    const uint b = cache.texture("b100").id;
+    assert(b != 0 && record.loadedPaths.last() == "b100" && record.loads == 5);
+    assert(!cache.isResident("c100"));
+    assert(std::find(record.live.begin(), record.live.end(), a) != record.live.end());
+    cache.update();
+    assert(cache.stats().totalEvictions == 2 && cache.stats().totalMisses == 5 && cache.stats().totalHits == 1);
+    assert(record.live.size() == 3);
+}
+
+ADD_TEST(VTextureCacheEviction, testEviction)
+
+void testFrame()
+{
+    Record record;
+    VTextureCache cache(new RecordingLoader(record), 250);
+
+    //The textures drawn in a frame stay until it ends, over the budget if need be
+    const char *paths[] = {"a100", "b100", "c100", "d100", "e100"};
+    for (const char *path : paths) {
+        assert(cache.texture(path).id != 0);
+    }
+    assert(cache.stats().residentBytes == 500 && cache.stats().maxResidentBytes == 500);
+    assert(record.destroyed.isEmpty());
+
+    //Then the oldest ones go
+    cache.update();
+    VTextureCache::Stats stats = cache.stats();
+    assert(stats.residentBytes == 200 && stats.resident == 2);
+    assert(stats.evictions == 3 && stats.evictedBytes == 300);
+    assert(!cache.isResident("a100") && !cache.isResident("b100") && !cache.isResident("c100"));
+    assert(cache.isResident("d100") && cache.isResident("e100"));
+
+    //Smaller budgets take effect at the end of the frame
+    cache.setBudget(100);
+    assert(cache.isResident("d100"));
+    cache.texture("e100");
+    cache.update();
+    assert(cache.isResident("e100") && !cache.isResident("d100"));
+
+    //A texture larger than the budget is loaded for the frame that asks for it
+    assert(cache.texture("f400").id != 0);
+    assert(!cache.isResident("e100"));
+    cache.update();
+    assert(cache.stats().residentBytes == 0 && cache.stats().resident == 0);
+    assert(record.live.isEmpty());
+
+    cache.setBudget(0);
+    for (const char *path : paths) {
+        cache.texture(path);
+    }
+    cache.update();
+    assert(cache.stats().resident == 5 && cache.stats().evictions == 0);
+}
+
+ADD_TEST(VTextureCacheFrame, testFrame)
+
+void testFailures()
+{
+    Record record;
+    VTextureCache cache(new RecordingLoader(record), 1000);
+
+    VTextureCache::Texture missing = cache.texture("missing");
+    assert(missing.id == 0 && missing.size == 0);
+    assert(cache.contains("missing") && !cache.isResident("missing"));
+    //Not tried again every frame
+    assert(cache.texture("missing").id == 0);
+    assert(record.loads == 1);
+    cache.update();
+    VTextureCache::Stats stats = cache.stats();
+    assert(stats.failures == 1 && stats.misses == 2 && stats.residentBytes == 0);
+
+    //Until it is removed
+    cache.remove("missing");
+    assert(!cache.contains("missing"));
+    cache.texture("missing");
+    assert(record.loads == 2);
+}
+
+ADD_TEST(VTextureCacheFailures, testFailures)
+
+void testOwnership()
+{
+    Record record;
+    {
+        VTextureCache cache(new RecordingLoader(record));
+        cache.texture("a100");
+        cache.texture("b200");
+        cache.texture("c300");
+
+        cache.remove("b200");
+        assert(!cache.contains("b200") && record.destroyed.size() == 1);
+        assert(cache.stats().residentBytes == 400);
+
+        //Known still, loaded again when asked for
+        cache.evictAll();
+        assert(record.live.isEmpty() && cache.stats().residentBytes == 0);
+        assert(cache.contains("a100") && !cache.isResident("a100"));
+        cache.update();
+        assert(cache.stats().evictions == 2 && cache.stats().evictedBytes == 400);
+
+        cache.texture("a100");
+        cache.clear();
+        assert(record.live.isEmpty() && cache.stats().textures == 0);
+
+        cache.texture("d400");
+        cache.texture("e500");
+    }
+    //The cache owns its textures
+    assert(record.live.isEmpty());
+    assert(record.destroyed.size() == 6);
+}
+
+ADD_TEST(VTextureCacheOwnership, testOwnership)
+
+}
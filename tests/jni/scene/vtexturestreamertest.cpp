@@ -0,0 +1,480 @@
+#include "test.h"
+
+#include <VTextureStreamer.h>
+#include <VTaskScheduler.h>
+#include <VThread.h>
+#include <VTimer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+NV_USING_NAMESPACE
+
+namespace {
+
+const uint GL_TEXTURE_2D = 0x0DE1;
+const uint GL_TEXTURE_CUBE_MAP = 0x8513;
+const uint GL_RGBA = 0x1908;
+const uint GL_SRGB8_ALPHA8 = 0x8C43;
+const uint GL_COMPRESSED_RGB8_ETC2 = 0x9274;
+
+// Records the calls of the streamer instead of uploading. Fences signal after they were polled
+// fenceLatency times, and uploads can take the time of a given bandwidth.
+class RecordingUploader : public VTextureStreamer::Uploader
+{
+public:
+    struct Upload
+    {
+        uint texture;
+        int level;
+        int face;
+        int y;
+        int height;
+        uint bytes;
+    };
+
+    RecordingUploader()
+        : fenceLatency(2)
+        , bytesPerSecond(0.0)
+        , attached(0)
+        , detached(0)
+        , attachThread(0)
+        , uploadThread(0)
+        , nextTexture(100)
+        , fences(0)
+        , failCreate(false)
+    {
+    }
+
+    void attach() override
+    {
+        attached++;
+        attachThread = VThread::currentThreadId();
+    }
+
+    void detach() override { detached++; }
+
+    uint create(const VTextureStreamer::Image &) override
+    {
+        if (failCreate) {
+            return 0;
+        }
+        created.append(nextTexture);
+        return nextTexture++;
+    }
+
+    void upload(uint texture, const VTextureStreamer::Image &image, const VTextureStreamer::Image::Level &level, int y, int height) override
+    {
+        uploadThread = VThread::currentThreadId();
+        const uint bytes = image.isCompressed() ? level.size : level.size / level.height * height;
+        Upload upload = {texture, level.level, level.face, y, height, bytes};
+        uploads.append(upload);
+        if (bytesPerSecond > 0.0) {
+            const double end = VTimer::Seconds() + bytes / bytesPerSecond;
+            while (VTimer::Seconds() < end) {
+            }
+        }
+    }
+
+    Fence finish(uint texture, const VTextureStreamer::Image &) override
+    {
+        finished.append(texture);
+        fences++;
+        return new int(fenceLatency);
+    }
+
+    bool isSignaled(Fence fence) override
+    {
+        int *polls = static_cast<int *>(fence);
+        return (*polls)-- <= 0;
+    }
+
+    void release(Fence fence) override
+    {
+        fences--;
+        delete static_cast<int *>(fence);
+    }
+
+    void destroy(uint texture) override { destroyed.append(texture); }
+
+    int fenceLatency;
+    double bytesPerSecond;
+
+    std::atomic<int> attached;
+    std::atomic<int> detached;
+    uint attachThread;
+    uint uploadThread;
+
+    uint nextTexture;
+    VArray<uint> created;
+    VArray<Upload> uploads;
+    VArray<uint> finished;
+    VArray<uint> destroyed;
+    std::atomic<int> fences;
+    bool failCreate;
+};
+
+void Append32(std::string &data, vuint32 value)
+{
+    data.append(reinterpret_cast<const char *>(&value), 4);
+}
+
+// A 32 bit TGA, which stb_image decodes
+VByteArray MakeTga(int width, int height)
+{
+    std::string tga;
+    const uchar header[18] = {0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                              (uchar) width, (uchar) (width >> 8), (uchar) height, (uchar) (height >> 8), 32, 0x28};
+    tga.append(reinterpret_cast<const char *>(header), sizeof(header));
+    for (int i = 0; i < width * height; i++) {
+        const char pixel[4] = {(char) i, (char) (i >> 8), 0, (char) 255};
+        tga.append(pixel, 4);
+    }
+    return VByteArray(tga);
+}
+
+VByteArray MakeKtx(uint glType, uint glFormat, uint glInternalFormat, int width, int height, int faces,
+                   const VArray<uint> &levelSizes)
+{
+    std::string ktx;
+    const uchar identifier[12] = {171, 75, 84, 88, 32, 49, 49, 187, 13, 10, 26, 10};
+    ktx.append(reinterpret_cast<const char *>(identifier), sizeof(identifier));
+    Append32(ktx, 0x04030201);
+    Append32(ktx, glType);
+    Append32(ktx, 1);
+    Append32(ktx, glFormat);
+    Append32(ktx, glInternalFormat);
+    Append32(ktx, glFormat);
+    Append32(ktx, width);
+    Append32(ktx, height);
+    Append32(ktx, 0);
+    Append32(ktx, 0);
+    Append32(ktx, faces);
+    Append32(ktx, levelSizes.size());
+    //Some key value data to skip
+    Append32(ktx, 8);
+    ktx.append(8, 'k');
+    for (uint level = 0; level < levelSizes.size(); level++) {
+        Append32(ktx, levelSizes[level]);
+        for (int face = 0; face < faces; face++) {
+            ktx.append(levelSizes[level], (char) (level * 16 + face));
+            ktx.append(3 - ((levelSizes[level] + 3) % 4), 0);
+        }
+    }
+    return VByteArray(ktx);
+}
+
+VByteArray MakePvr(vuint64 pixelFormat, int width, int height, int faces, int mipCount, uint dataSize)
+{
+    std::string pvr;
+    Append32(pvr, 0x03525650);
+    Append32(pvr, 0);
+    pvr.append(reinterpret_cast<const char *>(&pixelFormat), 8);
+    Append32(pvr, 0);
+    Append32(pvr, 0);
+    Append32(pvr, height);
+    Append32(pvr, width);
+    Append32(pvr, 1);
+    Append32(pvr, 1);
+    Append32(pvr, faces);
+    Append32(pvr, mipCount);
+    Append32(pvr, 4);
+    pvr.append(4, 'm');
+    pvr.append(dataSize, 'p');
+    return VByteArray(pvr);
+}
+
+bool Decode(const char *format, const VByteArray &data, const VTexture::Flags &flags, VTextureStreamer::Image &image)
+{
+    return VTextureStreamer::Decode(format, reinterpret_cast<const uchar *>(data.data()), data.size(), flags, image);
+}
+
+void decode()
+{
+    //Images are decoded to RGBA with their mip levels
+    const VByteArray tga = MakeTga(8, 4);
+    VTextureStreamer::Image image;
+    assert(Decode("tga", tga, VTexture::UseSRGB, image));
+    assert(image.target == GL_TEXTURE_2D);
+    assert(image.internalFormat == GL_SRGB8_ALPHA8 && image.format == GL_RGBA && !image.isCompressed());
+    assert(image.width == 8 && image.height == 4);
+    assert(image.levelCount == 4 && image.levels.size() == 4);
+    assert(image.levels[1].width == 4 && image.levels[1].height == 2 && image.levels[1].size == 32);
+    assert(image.levels[3].width == 1 && image.levels[3].height == 1);
+    assert(image.size() == 128 + 32 + 8 + 4);
+    assert(image.data()[image.levels[0].offset + 3] == 255);
+
+    VTextureStreamer::Image single;
+    assert(Decode("tga", tga, VTexture::NoMipmaps, single));
+    assert(single.internalFormat == GL_RGBA);
+    assert(single.levels.size() == 1 && single.size() == 128);
+    assert(memcmp(single.data(), image.data(), 128) == 0);
+
+    //KTX levels are uploaded from the file, after their image sizes
+    VArray<uint> levelSizes;
+    levelSizes << 128 << 32 << 8 << 8 << 8;
+    const VByteArray ktx = MakeKtx(0, GL_RGBA, GL_COMPRESSED_RGB8_ETC2, 16, 16, 1, levelSizes);
+    VTextureStreamer::Image compressed;
+    assert(Decode("ktx", ktx, VTexture::NoDefault, compressed));
+    assert(compressed.isCompressed());
+    assert(compressed.internalFormat == GL_COMPRESSED_RGB8_ETC2);
+    assert(compressed.levels.size() == 5);
+    assert(compressed.levels[0].offset == 64 + 8 + 4);
+    assert(compressed.levels[1].offset == 64 + 8 + 4 + 128 + 4);
+    assert(compressed.levels[4].width == 1 && compressed.levels[4].size == 8);
+    assert(compressed.data()[compressed.levels[2].offset] == 32);
+
+    VTextureStreamer::Image srgb;
+    assert(Decode("ktx", ktx, VTexture::Flags(VTexture::UseSRGB) | VTexture::NoMipmaps, srgb));
+    assert(srgb.internalFormat == GL_COMPRESSED_RGB8_ETC2 + 1);
+    assert(srgb.levels.size() == 1);
+
+    VArray<uint> cubeSizes;
+    cubeSizes << 16 * 16 * 4;
+    VTextureStreamer::Image cube;
+    assert(Decode("ktx", MakeKtx(0x1401, GL_RGBA, GL_RGBA, 16, 16, 6, cubeSizes), VTexture::NoDefault, cube));
+    assert(cube.target == GL_TEXTURE_CUBE_MAP);
+    assert(cube.levels.size() == 6 && cube.levels[5].face == 5);
+    assert(cube.data()[cube.levels[5].offset] == 5);
+
+    //PVR levels follow each other, faces within levels
+    VTextureStreamer::Image pvr;
+    assert(Decode("pvr", MakePvr(22, 8, 8, 1, 4, 32 + 8 + 8 + 8), VTexture::NoDefault, pvr));
+    assert(pvr.internalFormat == GL_COMPRESSED_RGB8_ETC2);
+    assert(pvr.levels.size() == 4);
+    assert(pvr.levels[0].offset == 52 + 4 && pvr.levels[0].size == 32);
+    assert(pvr.levels[3].offset == 52 + 4 + 48 && pvr.levels[3].width == 1);
+
+    //Nothing is read past the end
+    VTextureStreamer::Image truncated;
+    assert(!Decode("pvr", MakePvr(22, 8, 8, 1, 4, 32 + 8 + 8), VTexture::NoDefault, truncated));
+    VByteArray shortKtx = ktx;
+    shortKtx.resize(ktx.size() - 2);
+    assert(!Decode("ktx", shortKtx, VTexture::NoDefault, truncated));
+    assert(!Decode("ktx", MakeKtx(0, GL_RGBA, GL_COMPRESSED_RGB8_ETC2, 16, 16, 1, VArray<uint>() << 64), VTexture::NoDefault, truncated));
+    assert(!Decode("ktx", MakeKtx(0, GL_RGBA, GL_COMPRESSED_RGB8_ETC2, 16, 16, 3, levelSizes), VTexture::NoDefault, truncated));
+    assert(!Decode("pvr", MakePvr(12345, 8, 8, 1, 1, 64), VTexture::NoDefault, truncated));
+    assert(!Decode("jpg", VByteArray("not a jpeg"), VTexture::NoDefault, truncated));
+    assert(!Decode("dds", tga, VTexture::NoDefault, truncated));
+}
+
+ADD_TEST(VTextureStreamerDecode, decode)
+
+// Updates until the handles are ready or failed, as the render thread would each frame
+int Run(VTextureStreamer &streamer, int maxFrames = 2000)
+{
+    int frames = 0;
+    while (!streamer.isIdle() && frames < maxFrames) {
+        streamer.update();
+        frames++;
+        VThread::MSleep(1);
+    }
+    return frames;
+}
+
+void stream()
+{
+    VTextureStreamer::Settings settings;
+    settings.bytesPerFrame = 64;
+    settings.secondsPerFrame = 0.0;
+    RecordingUploader *uploader = new RecordingUploader;
+    VTextureStreamer *streamer = new VTextureStreamer(uploader, settings);
+    assert(uploader->attached == 1);
+
+    //Rows of an uncompressed level are spread over frames to fit the budget
+    VTextureStreamer::Handle image = streamer->load("tga", MakeTga(8, 4), VTexture::NoMipmaps, 7);
+    assert(image.state() == VTextureStreamer::Handle::Loading);
+    assert(image.id() == 7 && image.target() == GL_TEXTURE_2D);
+    while (uploader->finished.isEmpty()) {
+        streamer->update();
+        VThread::MSleep(1);
+    }
+    assert(uploader->uploads.size() == 2);
+    assert(uploader->uploads[0].y == 0 && uploader->uploads[0].height == 2 && uploader->uploads[0].bytes == 64);
+    assert(uploader->uploads[1].y == 2 && uploader->uploads[1].height == 2);
+    assert(streamer->stats().maxFrameBytes == 64);
+
+    //Handed over once the fence signaled
+    streamer->update();
+    streamer->update();
+    assert(image.id() == 7);
+    streamer->update();
+    assert(image.isReady());
+    assert(image.id() == 100 && image.width() == 8 && image.height() == 4);
+    assert(uploader->fences == 0);
+    assert(streamer->isIdle());
+
+    //A compressed level larger than the budget is uploaded on its own
+    VArray<uint> levelSizes;
+    levelSizes << 128 << 32 << 8 << 8 << 8;
+    VTextureStreamer::Handle compressed = streamer->load("ktx", MakeKtx(0, GL_RGBA, GL_COMPRESSED_RGB8_ETC2, 16, 16, 1, levelSizes));
+    uploader->uploads.clear();
+    Run(*streamer);
+    assert(compressed.isReady());
+    assert(uploader->uploads.size() == 5);
+    assert(streamer->stats().maxFrameBytes == 128);
+
+    //The textures nobody waits for anymore are dropped, wherever they are
+    uploader->uploads.clear();
+    streamer->load("tga", MakeTga(64, 64));
+    VTextureStreamer::Handle uploading = streamer->load("tga", MakeTga(64, 64));
+    while (uploader->uploads.isEmpty()) {
+        streamer->update();
+        VThread::MSleep(1);
+    }
+    uploading = VTextureStreamer::Handle();
+    Run(*streamer);
+    VTextureStreamer::Stats stats = streamer->stats();
+    assert(stats.ready == 2 && stats.canceled == 2 && stats.failed == 0);
+    assert(uploader->uploads.size() == 1);
+    assert(uploader->destroyed.size() == uploader->created.size() - 2);
+
+    //Failures keep the placeholder
+    VTextureStreamer::Handle missing = streamer->load("/nonexistent/texture.png", VTexture::NoDefault, 9);
+    VTextureStreamer::Handle broken = streamer->load("ktx", VByteArray("KTX"), VTexture::NoDefault, 9);
+    uploader->failCreate = true;
+    VTextureStreamer::Handle uncreated = streamer->load("tga", MakeTga(4, 4), VTexture::NoDefault, 9);
+    Run(*streamer);
+    assert(missing.state() == VTextureStreamer::Handle::Failed && missing.id() == 9);
+    assert(broken.state() == VTextureStreamer::Handle::Failed);
+    assert(uncreated.state() == VTextureStreamer::Handle::Failed && uncreated.id() == 9);
+    assert(streamer->stats().failed == 3);
+    uploader->failCreate = false;
+
+    //Custom decoders
+    VTextureStreamer::Handle custom = streamer->load([](VTextureStreamer::Image &image) {
+        return Decode("tga", MakeTga(2, 2), VTexture::NoMipmaps, image);
+    });
+    Run(*streamer);
+    assert(custom.isReady() && custom.width() == 2);
+
+    //What is still loading is let go with the streamer
+    VTextureStreamer::Handle pending = streamer->load("tga", MakeTga(16, 16));
+    delete streamer;
+    assert(pending.state() == VTextureStreamer::Handle::Failed);
+}
+
+ADD_TEST(VTextureStreamer, stream)
+
+void loaderThread()
+{
+    VTextureStreamer::Settings settings;
+    settings.loaderThread = true;
+    settings.bytesPerFrame = 1024;
+    RecordingUploader *uploader = new RecordingUploader;
+    VTextureStreamer *streamer = new VTextureStreamer(uploader, settings);
+
+    VArray<VTextureStreamer::Handle> handles;
+    for (int i = 0; i < 16; i++) {
+        handles.append(streamer->load("tga", MakeTga(16 + i, 16)));
+    }
+    Run(*streamer);
+    for (const VTextureStreamer::Handle &handle : handles) {
+        assert(handle.isReady());
+    }
+    assert(uploader->attached == 1);
+    assert(uploader->attachThread != VThread::currentThreadId());
+    assert(uploader->uploadThread == uploader->attachThread);
+    assert(streamer->stats().maxFrameBytes <= 1024);
+    assert(streamer->stats().ready == 16);
+
+    delete streamer;
+}
+
+ADD_TEST(VTextureStreamerThread, loaderThread)
+
+//Loads a scene's worth of textures, from thumbnails to a pano, through an uploader taking the
+//time of 1 GB/s, and reports how long the frames were held up by uploads and how many frames
+//the textures took to show up, without a budget and with a few.
+//
+//    unittest VTextureStreamerBenchmark
+void benchmark()
+{
+    struct Budget
+    {
+        const char *name;
+        uint bytesPerFrame;
+        double secondsPerFrame;
+    };
+    const Budget budgets[] = {
+        {"unlimited", 0, 0.0},
+        {"16 MB", 16 * 1024 * 1024, 0.0},
+        {"4 MB", 4 * 1024 * 1024, 0.0},
+        {"1 MB", 1024 * 1024, 0.0},
+        {"2 ms", 0, 0.002},
+        {"4 MB, 2 ms", 4 * 1024 * 1024, 0.002},
+    };
+
+    // Synthetic images, so that the numbers are about the scheduling and not stb_image
+    struct Texture
+    {
+        int size;
+        int count;
+    };
+    const Texture textures[] = {{128, 48}, {512, 8}, {1024, 4}, {4096, 1}};
+    const double FrameSeconds = 1.0 / 90.0;
+
+    for (const Budget &budget : budgets) {
+        VTextureStreamer::Settings settings;
+        settings.bytesPerFrame = budget.bytesPerFrame;
+        settings.secondsPerFrame = budget.secondsPerFrame;
+        RecordingUploader *uploader = new RecordingUploader;
+        uploader->bytesPerSecond = 1e9;
+        VTextureStreamer streamer(uploader, settings);
+
+        VArray<VTextureStreamer::Handle> handles;
+        for (const Texture &texture : textures) {
+            const int size = texture.size;
+            for (int i = 0; i < texture.count; i++) {
+                handles.append(streamer.load([size](VTextureStreamer::Image &image) {
+                    image.width = size;
+                    image.height = size;
+                    image.format = image.internalFormat = GL_RGBA;
+                    image.type = 0x1401;
+                    image.levelCount = 1;
+                    image.bytes.resize(size * size * 4);
+                    VTextureStreamer::Image::Level level = {0, 0, size, size, 0, (uint) size * size * 4};
+                    image.levels.append(level);
+                    return true;
+                }));
+            }
+        }
+
+        VArray<int> readyFrame;
+        readyFrame.resize(handles.size());
+        VArray<float> frameMs;
+        int frame = 0;
+        while (!streamer.isIdle() && frame < 2000) {
+            const double start = VTimer::Seconds();
+            streamer.update();
+            const double seconds = VTimer::Seconds() - start;
+            frameMs.append(seconds * 1000.0);
+            frame++;
+            for (uint i = 0; i < handles.size(); i++) {
+                if (readyFrame[i] == 0 && handles[i].isReady()) {
+                    readyFrame[i] = frame;
+                }
+            }
+            //The rest of a 90 Hz frame
+            if (seconds < FrameSeconds) {
+                VThread::MSleep((uint) ((FrameSeconds - seconds) * 1000.0));
+            }
+        }
+
+        std::sort(frameMs.begin(), frameMs.end());
+        std::sort(readyFrame.begin(), readyFrame.end());
+        const VTextureStreamer::Stats stats = streamer.stats();
+        vInfo("VTextureStreamerBenchmark: " << budget.name << ": " << stats.ready << " textures, "
+              << stats.bytesUploaded / (1024 * 1024) << " MB in " << frame << " frames, update p50 "
+              << frameMs[frameMs.size() / 2] << " p99 " << frameMs[frameMs.size() * 99 / 100] << " max "
+              << frameMs.last() << " ms, first texture after " << readyFrame.first() << " frames, half after "
+              << readyFrame[readyFrame.size() / 2] << ", all after " << readyFrame.last());
+    }
+}
+
+ADD_TEST(VTextureStreamerBenchmark, benchmark)
+
+}
@@ -30,12 +30,12 @@ struct TestUnit
 std::list<TestUnit> &Tests();
 
 #define ADD_TEST(name, test) namespace {\
-    struct TestAdder\
+    struct name##TestAdder\
     {\
-        TestAdder()\
+        name##TestAdder()\
         {\
             Tests().push_back(TestUnit(#name, test));\
         }\
     };\
-    TestAdder adder;\
+    name##TestAdder name##Adder;\
 }